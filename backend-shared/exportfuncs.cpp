@@ -1,4 +1,5 @@
 // SPDX-License-Identifier: GPL-2.0
+#include <QFile>
 #include <QFileInfo>
 #include <QDir>
 #include <QtConcurrent>
@@ -16,27 +17,32 @@
 #include "exportfuncs.h"
 
 #if !defined(SUBSURFACE_MOBILE)
-void exportProfile(QString filename, bool selected_only)
+void exportProfile(QString filename, bool selected_only, int scale, const std::function<bool(int, int)> &progress)
 {
 	struct dive *dive;
 	int i;
-	int count = 0;
-	if (!filename.endsWith(".png", Qt::CaseInsensitive))
+	std::vector<const struct dive *> dives;
+	std::vector<QString> filenames;
+	if (!filename.endsWith(".png", Qt::CaseInsensitive) && !filename.endsWith(".svg", Qt::CaseInsensitive))
 		filename = filename.append(".png");
 	QFileInfo fi(filename);
 
 	for_each_dive (i, dive) {
 		if (selected_only && !dive->selected)
 			continue;
-		if (count)
-			exportProfile(dive, fi.path() + QDir::separator() + fi.completeBaseName().append(QString("-%1.").arg(count)) + fi.suffix());
+		if (!dives.empty())
+			filenames.push_back(fi.path() + QDir::separator() + fi.completeBaseName().append(QString("-%1.").arg(dives.size())) + fi.suffix());
 		else
-			exportProfile(dive, filename);
-		++count;
+			filenames.push_back(filename);
+		dives.push_back(dive);
 	}
+	exportProfiles(dives, filenames, scale, progress);
 }
 
-void export_TeX(const char *filename, bool selected_only, bool plain)
+// The document is written to the file dive by dive, so that it is never kept in memory
+// as a whole. The profile images, which take most of the time, are rendered first.
+// If that is cancelled, the incomplete file is removed.
+void export_TeX(const char *filename, bool selected_only, bool plain, const std::function<bool(int, int)> &progress)
 {
 	FILE *f;
 	QDir texdir = QFileInfo(filename).dir();
@@ -49,6 +55,26 @@ void export_TeX(const char *filename, bool selected_only, bool plain)
 
 	struct membuffer buf = {};
 
+	f = subsurface_fopen(filename, "w+");
+	if (!f) {
+		report_error(qPrintable(gettextFromC::tr("Can't open file %s")), filename);
+		return;
+	}
+
+	std::vector<const struct dive *> profileDives;
+	std::vector<QString> profileFiles;
+	for_each_dive (i, dive) {
+		if (selected_only && !dive->selected)
+			continue;
+		profileDives.push_back(dive);
+		profileFiles.push_back(texdir.filePath(QString("profile%1.png").arg(dive->number)));
+	}
+	if (!exportProfiles(profileDives, profileFiles, 4, progress)) {
+		fclose(f);
+		QFile::remove(QFile::decodeName(filename));
+		return;
+	}
+
 	if (plain) {
 		ssrf = "";
 		put_format(&buf, "\\input subsurfacetemplate\n");
@@ -93,7 +119,6 @@ void export_TeX(const char *filename, bool selected_only, bool plain)
 		if (selected_only && !dive->selected)
 			continue;
 
-		exportProfile(dive, texdir.filePath(QString("profile%1.png").arg(dive->number)));
 		struct tm tm;
 		utc_mkdate(dive->when, &tm);
 
@@ -217,7 +242,7 @@ void export_TeX(const char *filename, bool selected_only, bool plain)
 		dive->maxdepth.mm ? put_format(&buf, "\\def\\%sdepth{%.1f\\%sdepthunit}\n", ssrf, get_depth_units(dive->maxdepth.mm, NULL, &unit), ssrf) : put_format(&buf, "\\def\\%sdepth{}\n", ssrf);
 
 		put_format(&buf, "\\%spage\n", ssrf);
-
+		flush_buffer_if_full(&buf, f, 64 * 1024);
 	}
 
 	if (plain)
@@ -225,15 +250,9 @@ void export_TeX(const char *filename, bool selected_only, bool plain)
 	else
 		put_format(&buf, "\\end{document}\n");
 
-	f = subsurface_fopen(filename, "w+");
-	if (!f) {
-		report_error(qPrintable(gettextFromC::tr("Can't open file %s")), filename);
-	} else {
-		flush_buffer(&buf, f); /*check for writing errors? */
-		fclose(f);
-	}
+	flush_buffer(&buf, f); /*check for writing errors? */
+	fclose(f);
 	free_buffer(&buf);
-
 }
 
 void export_depths(const char *filename, bool selected_only)
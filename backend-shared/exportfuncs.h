@@ -4,11 +4,15 @@
 
 #include <QString>
 #include <QFuture>
+#include <functional>
+#include <vector>
 
 struct dive_site;
 
-void exportProfile(QString filename, bool selected_only);
-void export_TeX(const char *filename, bool selected_only, bool plain);
+// The progress callbacks are called with the number of done and total dives.
+// Returning true cancels the export.
+void exportProfile(QString filename, bool selected_only, int scale = 4, const std::function<bool(int, int)> &progress = {});
+void export_TeX(const char *filename, bool selected_only, bool plain, const std::function<bool(int, int)> &progress = {});
 void export_depths(const char *filename, bool selected_only);
 std::vector<const dive_site *> getDiveSitesToExport(bool selectedOnly);
 QFuture<int> exportUsingStyleSheet(QString filename, bool doExport, int units, QString stylesheet, bool anonymize);
@@ -17,12 +21,17 @@ QFuture<int> exportUsingStyleSheet(QString filename, bool doExport, int units, Q
 // prepareDivesForUploadDiveShare
 
 // WARNING
-// exportProfile uses the UI and are therefore different between
+// exportProfile and exportProfiles use the UI and are therefore different between
 // Desktop (UI) and Mobile (QML)
 // In order to solve this difference, the actual implementations
 // are done in
 // desktop-widgets/divelogexportdialog.cpp and
 // mobile-widgets/qmlmanager.cpp
 void exportProfile(const struct dive *dive, const QString filename);
+// Write the profiles of many dives, PNG or SVG depending on the file name.
+// The images are scale times the size of the profile on screen.
+// Returns false if the export was cancelled.
+bool exportProfiles(const std::vector<const struct dive *> &dives, const std::vector<QString> &filenames, int scale,
+		    const std::function<bool(int, int)> &progress = {});
 
 #endif // EXPORT_FUNCS_H
@@ -23,6 +23,16 @@ void importDives(struct dive_table *dives, struct trip_table *trips, struct dive
 	execute(new ImportDives(dives, trips, sites, presets, flags, source));
 }
 
+// The reloaded dives replace dives that may be referenced by commands on the
+// undo stack. Therefore, the stack is cleared and the command run right away.
+void reloadDives(struct git_dive_changes *changes)
+{
+	clear();
+	ReloadDives cmd(changes);
+	if (cmd.workToBeDone())
+		static_cast<QUndoCommand &>(cmd).redo();
+}
+
 void deleteDive(const QVector<struct dive*> &divesToDelete)
 {
 	execute(new DeleteDive(divesToDelete));
@@ -10,6 +10,7 @@
 #include <vector>
 
 struct DiveAndLocation;
+struct git_dive_changes;
 struct FilterData;
 
 // We put everything in a namespace, so that we can shorten names without polluting the global namespace
@@ -23,6 +24,8 @@ void setClean();			// Call after save - this marks a state where no changes need
 bool isClean();				// Any changes need to be saved?
 QAction *undoAction(QObject *parent);	// Create an undo action.
 QAction *redoAction(QObject *parent);	// Create an redo action.
+void undo();				// Undo the last command
+void redo();				// Redo the last undone command
 QString changesMade();			// return a string with the texts from all commands on the undo stack -> for commit message
 
 // 2) Dive-list related commands
@@ -35,6 +38,7 @@ void addDive(dive *d, bool autogroup, bool newNumber);
 void importDives(struct dive_table *dives, struct trip_table *trips,
 		 struct dive_site_table *sites, filter_preset_table_t *filter_presets,
 		 int flags, const QString &source); // The tables are consumed!
+void reloadDives(struct git_dive_changes *changes); // The tables are consumed! Clears the undo stack.
 void deleteDive(const QVector<struct dive*> &divesToDelete);
 void shiftTime(const std::vector<dive *> &changedDives, int amount);
 void renumberDives(const QVector<QPair<dive *, int>> &divesToRenumber);
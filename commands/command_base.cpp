@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
 
 #include "command_base.h"
+#include "core/memusage.h"
 #include "core/qthelper.h" // for updateWindowTitle()
 #include "core/subsurface-qt/divelistnotifier.h"
 #include <QVector>
@@ -9,14 +10,23 @@ namespace Command {
 
 static QUndoStack undoStack;
 
-// forward declaration
+// forward declarations
 QString changesMade();
+void undo();
+void redo();
+
+// The commands don't know their size, so only the number of commands is reported
+static void reportMemoryUsage(struct mem_usage *usage, void *)
+{
+	usage->objects = undoStack.count();
+}
 
 // General commands
 void init()
 {
 	QObject::connect(&undoStack, &QUndoStack::cleanChanged, &updateWindowTitle);
 	changesCallback = &changesMade;
+	memusage_register(MEM_UNDO_STACK, &reportMemoryUsage, &undoStack);
 }
 
 void clear()
@@ -40,14 +50,34 @@ QUndoStack *getUndoStack()
 	return &undoStack;
 }
 
+// Commands that edit many dives send their notifications in one go. For this purpose,
+// the actions execute undo and redo inside a dive list transaction.
 QAction *undoAction(QObject *parent)
 {
-	return undoStack.createUndoAction(parent, QCoreApplication::translate("Command", "&Undo"));
+	QAction *action = undoStack.createUndoAction(parent, QCoreApplication::translate("Command", "&Undo"));
+	QObject::disconnect(action, &QAction::triggered, &undoStack, &QUndoStack::undo);
+	QObject::connect(action, &QAction::triggered, &undo);
+	return action;
 }
 
 QAction *redoAction(QObject *parent)
 {
-	return undoStack.createRedoAction(parent, QCoreApplication::translate("Command", "&Redo"));
+	QAction *action = undoStack.createRedoAction(parent, QCoreApplication::translate("Command", "&Redo"));
+	QObject::disconnect(action, &QAction::triggered, &undoStack, &QUndoStack::redo);
+	QObject::connect(action, &QAction::triggered, &redo);
+	return action;
+}
+
+void undo()
+{
+	DiveListTransaction transaction;
+	undoStack.undo();
+}
+
+void redo()
+{
+	DiveListTransaction transaction;
+	undoStack.redo();
 }
 
 QString diveNumberOrDate(struct dive *d)
@@ -94,7 +124,10 @@ QString changesMade()
 bool execute(Base *cmd)
 {
 	if (cmd->workToBeDone()) {
-		undoStack.push(cmd);
+		{
+			DiveListTransaction transaction;
+			undoStack.push(cmd);
+		}
 		emit diveListNotifier.commandExecuted();
 		return true;
 	} else {
@@ -153,7 +153,7 @@ struct DiveSiteDeleter {
 	void operator()(dive_site *ds) { free_dive_site(ds); }
 };
 struct EventDeleter {
-	void operator()(event *ev) { free(ev); }
+	void operator()(event *ev) { free_event(ev); }
 };
 
 // Owning pointers to dive, dive_trip, dive_site and event objects.
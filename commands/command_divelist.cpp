@@ -2,9 +2,11 @@
 
 #include "command_divelist.h"
 #include "core/divelist.h"
+#include "core/git-access.h"
 #include "core/qthelper.h"
 #include "core/selection.h"
 #include "core/subsurface-qt/divelistnotifier.h"
+#include "qt-models/divelocationmodel.h"
 #include "qt-models/filtermodels.h"
 #include "../profile-widget/profilewidget2.h"
 #include "core/divefilter.h"
@@ -254,7 +256,7 @@ static void renumberDives(QVector<QPair<dive *, int>> &divesToRenumber)
 	}
 
 	// Send signals.
-	emit diveListNotifier.divesChanged(dives, DiveField::NR);
+	diveListNotifier.changeDives(dives, DiveField::NR);
 }
 
 // This helper function moves a dive to a trip. The old trip is recorded in the
@@ -585,6 +587,95 @@ void ImportDives::undoit()
 	std::reverse(filterPresetsToAdd.begin(), filterPresetsToAdd.end());
 }
 
+ReloadDives::ReloadDives(struct git_dive_changes *changes)
+{
+	setText(Command::Base::tr("reload dives"));
+
+	for (int i = 0; i < changes->trips.nr; ++i) {
+		dive_trip *trip = changes->trips.trips[i];
+		std::array<unsigned char, 20> id;
+		std::copy(trip->git_id, trip->git_id + 20, id.begin());
+		tripIds.push_back({ trip, id });
+		divesToAdd.trips.emplace_back(trip);
+	}
+	changes->trips.nr = 0;
+
+	divesToAdd.dives.reserve(changes->dives.nr);
+	for (int i = 0; i < changes->dives.nr; ++i) {
+		OwningDivePtr divePtr(changes->dives.dives[i]);
+		std::array<unsigned char, 20> id;
+		std::copy(divePtr->git_id, divePtr->git_id + 20, id.begin());
+		diveIds.push_back({ divePtr.get(), id });
+		divePtr->selected = false;
+		// Contrary to the other commands, the loader already put the dives into their
+		// trips and sites. Take them out, so that addDive() doesn't count them twice.
+		dive_trip *trip = unregister_dive_from_trip(divePtr.get());
+		dive_site *site = unregister_dive_from_dive_site(divePtr.get());
+		divesToAdd.dives.push_back({ std::move(divePtr), trip, site });
+	}
+	changes->dives.nr = 0;
+
+	divesToRemove.dives.assign(changes->removed.dives, changes->removed.dives + changes->removed.nr);
+	changes->removed.nr = 0;
+
+	sitesAdded.assign(changes->added_sites.dive_sites, changes->added_sites.dive_sites + changes->added_sites.nr);
+	changes->added_sites.nr = 0;
+	for (int i = 0; i < changes->changed_sites.nr; ++i)
+		sitesChanged.emplace_back(changes->changed_sites.dive_sites[i]);
+	changes->changed_sites.nr = 0;
+}
+
+bool ReloadDives::workToBeDone()
+{
+	return !divesToAdd.dives.empty() || !divesToRemove.dives.empty() || !sitesAdded.empty() || !sitesChanged.empty();
+}
+
+void ReloadDives::redoit()
+{
+	// The new sites are already registered, so only the frontend has to be informed.
+	// Do this in the order of the table, so that the indices are correct.
+	std::vector<std::pair<int, dive_site *>> added;
+	for (dive_site *ds: sitesAdded)
+		added.push_back({ get_divesite_idx(ds, &dive_site_table), ds });
+	std::sort(added.begin(), added.end());
+	for (auto &entry: added)
+		emit diveListNotifier.diveSiteAdded(entry.second, entry.first);
+	sitesAdded.clear();
+
+	for (OwningDiveSitePtr &changed: sitesChanged) {
+		dive_site *ds = get_dive_site_by_uuid(changed->uuid, &dive_site_table);
+		if (!ds)
+			continue;
+		copy_dive_site(changed.get(), ds);
+		for (int field: { LocationInformationModel::NAME, LocationInformationModel::DESCRIPTION, LocationInformationModel::NOTES,
+				  LocationInformationModel::LOCATION, LocationInformationModel::TAXONOMY })
+			emit diveListNotifier.diveSiteChanged(ds, field);
+	}
+	sitesChanged.clear();
+
+	dive *oldCurrent = current_dive;
+	timestamp_t when = oldCurrent ? oldCurrent->when : 0;
+
+	// The removed dives and trips are freed when leaving this function
+	DivesAndTripsToAdd removed = removeDives(divesToRemove);
+	addDives(divesToAdd);
+	sort_trip_table(&trip_table);
+
+	for (auto &entry: diveIds)
+		std::copy(entry.second.begin(), entry.second.end(), entry.first->git_id);
+	for (auto &entry: tripIds)
+		std::copy(entry.second.begin(), entry.second.end(), entry.first->git_id);
+
+	// If the current dive was replaced, select the dive at its place
+	if (oldCurrent && !current_dive)
+		select_single_dive(find_next_visible_dive(when));
+}
+
+void ReloadDives::undoit()
+{
+	// Never on the undo stack
+}
+
 DeleteDive::DeleteDive(const QVector<struct dive*> &divesToDeleteIn)
 {
 	divesToDelete.dives = std::vector<dive *>(divesToDeleteIn.begin(), divesToDeleteIn.end());
@@ -632,9 +723,11 @@ void ShiftTime::redoit()
 	std::vector<dive_trip *> trips;
 	for (dive *d: diveList) {
 		d->when += timeChanged;
-		if (d->divetrip && std::find(trips.begin(), trips.end(), d->divetrip) == trips.end())
+		if (d->divetrip)
 			trips.push_back(d->divetrip);
 	}
+	std::sort(trips.begin(), trips.end());
+	trips.erase(std::unique(trips.begin(), trips.end()), trips.end());
 
 	// Changing times may have unsorted the dive and trip tables
 	sort_dive_table(&dive_table);
@@ -644,8 +737,8 @@ void ShiftTime::redoit()
 
 	// Send signals
 	QVector<dive *> dives = QVector<dive *>::fromStdVector(diveList);
-	emit diveListNotifier.divesTimeChanged(timeChanged, dives);
-	emit diveListNotifier.divesChanged(dives, DiveField::DATETIME);
+	diveListNotifier.changeDivesTime(timeChanged, dives);
+	diveListNotifier.changeDives(dives, DiveField::DATETIME);
 
 	// Select the changed dives
 	setSelection(diveList, diveList[0]);
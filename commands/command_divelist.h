@@ -8,6 +8,9 @@
 #include "core/filterpreset.h"
 
 #include <QVector>
+#include <array>
+
+struct git_dive_changes;
 
 // We put everything in a namespace, so that we can shorten names without polluting the global namespace
 namespace Command {
@@ -121,6 +124,28 @@ private:
 	std::vector<int>		filterPresetsToRemove;
 };
 
+// Apply the result of an incremental reload of a git logbook. This can't be
+// undone: the command is executed right away and never put on the undo stack.
+class ReloadDives : public DiveListBase {
+public:
+	// Note: the tables of changes are consumed - after the call they will be empty.
+	ReloadDives(struct git_dive_changes *changes);
+private:
+	void undoit() override;
+	void redoit() override;
+	bool workToBeDone() override;
+
+	DivesAndTripsToAdd		divesToAdd;
+	DivesAndSitesToRemove		divesToRemove;
+	std::vector<dive_site *>	sitesAdded;
+	std::vector<OwningDiveSitePtr>	sitesChanged;
+
+	// The dives and trips were just loaded, so they are up to date with the
+	// git tree. Keep their ids, which are reset when they are added.
+	std::vector<std::pair<dive *, std::array<unsigned char, 20>>> diveIds;
+	std::vector<std::pair<dive_trip *, std::array<unsigned char, 20>>> tripIds;
+};
+
 class DeleteDive : public DiveListBase {
 public:
 	DeleteDive(const QVector<dive *> &divesToDelete);
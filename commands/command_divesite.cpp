@@ -35,7 +35,7 @@ static std::vector<dive_site *> addDiveSites(std::vector<OwningDiveSitePtr> &sit
 		emit diveListNotifier.diveSiteAdded(res.back(), idx); // Inform frontend of new dive site.
 	}
 
-	emit diveListNotifier.divesChanged(changedDives, DiveField::DIVESITE);
+	diveListNotifier.changeDives(changedDives, DiveField::DIVESITE);
 
 	// Clear vector of unused owning pointers
 	sites.clear();
@@ -66,7 +66,7 @@ static std::vector<OwningDiveSitePtr> removeDiveSites(std::vector<dive_site *> &
 		emit diveListNotifier.diveSiteDeleted(ds, idx); // Inform frontend of removed dive site.
 	}
 
-	emit diveListNotifier.divesChanged(changedDives, DiveField::DIVESITE);
+	diveListNotifier.changeDives(changedDives, DiveField::DIVESITE);
 
 	sites.clear();
 
@@ -99,18 +99,21 @@ ImportDiveSites::ImportDiveSites(struct dive_site_table *sites, const QString &s
 {
 	setText(Command::Base::tr("import dive sites from %1").arg(source));
 
+	struct dive_site_hash hash;
+	build_dive_site_hash(&hash, &dive_site_table);
 	for (int i = 0; i < sites->nr; ++i) {
 		struct dive_site *new_ds = sites->dive_sites[i];
 
 		// Don't import dive sites that already exist. Currently we only check for
 		// the same name. We might want to be smarter here and merge dive site data, etc.
-		struct dive_site *old_ds = get_same_dive_site(new_ds);
+		struct dive_site *old_ds = get_same_dive_site_hashed(new_ds, &hash);
 		if (old_ds) {
 			free_dive_site(new_ds);
 			continue;
 		}
 		sitesToAdd.emplace_back(new_ds);
 	}
+	free_dive_site_hash(&hash);
 
 	// All site have been consumed
 	sites->nr = 0;
@@ -369,7 +372,7 @@ void MergeDiveSites::redo()
 			divesChanged.push_back(site->dives.dives[i]);
 		}
 	}
-	emit diveListNotifier.divesChanged(divesChanged, DiveField::DIVESITE);
+	diveListNotifier.changeDives(divesChanged, DiveField::DIVESITE);
 }
 
 void MergeDiveSites::undo()
@@ -388,7 +391,7 @@ void MergeDiveSites::undo()
 
 	sitesToRemove = addDiveSites(sitesToAdd);
 
-	emit diveListNotifier.divesChanged(divesChanged, DiveField::DIVESITE);
+	diveListNotifier.changeDives(divesChanged, DiveField::DIVESITE);
 }
 
 ApplyGPSFixes::ApplyGPSFixes(const std::vector<DiveAndLocation> &fixes)
@@ -7,6 +7,8 @@
 #include "core/selection.h"
 #include "core/subsurface-string.h"
 #include "core/tag.h"
+#include "core/arena.h"
+#include "core/samplecolumns.h"
 #include "qt-models/weightsysteminfomodel.h"
 #include "qt-models/tankinfomodel.h"
 #ifdef SUBSURFACE_MOBILE
@@ -42,7 +44,7 @@ T EditDefaultSetter<T, ID, PTR>::data(struct dive *d) const
 template <DiveField::Flags ID, char *dive::*PTR>
 void EditStringSetter<ID, PTR>::set(struct dive *d, QString v) const
 {
-	free(d->*PTR);
+	arena_free(d->*PTR);
 	d->*PTR = copy_qstring(v);
 }
 
@@ -137,6 +139,12 @@ bool EditBase<T>::workToBeDone()
 	return num_dives > 0;
 }
 
+// Edits of fields that are not part of the fulltext index don't have to re-register the dive.
+static bool isIndexedField(DiveField id)
+{
+	return id.notes || id.divemaster || id.buddy || id.suit || id.tags || id.divesite;
+}
+
 template<typename T>
 void EditBase<T>::undo()
 {
@@ -145,20 +153,22 @@ void EditBase<T>::undo()
 		return;
 	}
 
+	DiveField id = fieldId();
+	bool indexed = isIndexedField(id);
 	for (dive *d: dives) {
 		set(d, value);
-		fulltext_register(d); // Update the fulltext cache
+		if (indexed)
+			fulltext_register(d); // Update the fulltext cache
 		invalidate_dive_cache(d); // Ensure that dive is written in git_save()
 	}
 
 	std::swap(old, value);
 
 	// Send signals.
-	DiveField id = fieldId();
 #if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
-	emit diveListNotifier.divesChanged(QVector<dive *>(dives.begin(), dives.end()), id);
+	diveListNotifier.changeDives(QVector<dive *>(dives.begin(), dives.end()), id);
 #else
-	emit diveListNotifier.divesChanged(QVector<dive *>::fromStdVector(dives), id);
+	diveListNotifier.changeDives(QVector<dive *>::fromStdVector(dives), id);
 #endif
 
 	setSelection(selectedDives, current);
@@ -552,9 +562,9 @@ void EditTagsBase::undo()
 	// Send signals.
 	DiveField id = fieldId();
 #if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
-	emit diveListNotifier.divesChanged(QVector<dive *>(dives.begin(), dives.end()), id);
+	diveListNotifier.changeDives(QVector<dive *>(dives.begin(), dives.end()), id);
 #else
-	emit diveListNotifier.divesChanged(QVector<dive *>::fromStdVector(dives), id);
+	diveListNotifier.changeDives(QVector<dive *>::fromStdVector(dives), id);
 #endif
 	setSelection(selectedDives, current);
 }
@@ -597,7 +607,7 @@ QStringList EditBuddies::data(struct dive *d) const
 void EditBuddies::set(struct dive *d, const QStringList &v) const
 {
 	QString text = v.join(", ");
-	free(d->buddy);
+	arena_free(d->buddy);
 	d->buddy = copy_qstring(text);
 }
 
@@ -615,7 +625,7 @@ QStringList EditDiveMaster::data(struct dive *d) const
 void EditDiveMaster::set(struct dive *d, const QStringList &v) const
 {
 	QString text = v.join(", ");
-	free(d->divemaster);
+	arena_free(d->divemaster);
 	d->divemaster = copy_qstring(text);
 }
 
@@ -627,7 +637,7 @@ QString EditDiveMaster::fieldName() const
 static void swapCandQString(QString &q, char *&c)
 {
 	QString tmp(c);
-	free(c);
+	arena_free(c);
 	c = copy_qstring(q);
 	q = std::move(tmp);
 }
@@ -776,11 +786,11 @@ void PasteDives::undo()
 	fields.chill = what.chill;
 	fields.divesite = what.divesite;
 	fields.tags = what.tags;
-	emit diveListNotifier.divesChanged(divesToNotify, fields);
+	diveListNotifier.changeDives(divesToNotify, fields);
 	if (what.cylinders)
-		emit diveListNotifier.cylindersReset(divesToNotify);
+		diveListNotifier.resetCylinders(divesToNotify);
 	if (what.weights)
-		emit diveListNotifier.weightsystemsReset(divesToNotify);
+		diveListNotifier.resetWeightsystems(divesToNotify);
 }
 
 // Redo and undo do the same
@@ -790,6 +800,15 @@ void PasteDives::redo()
 }
 
 // ***** ReplanDive *****
+// The dive computers that are not in the dive are kept in compact storage.
+// Profiles of long rebreather dives may have many thousand samples and each
+// replan and profile edit puts one more copy on the undo stack.
+static void packDcs(struct divecomputer *dc)
+{
+	for (; dc; dc = dc->next)
+		pack_samples(dc);
+}
+
 ReplanDive::ReplanDive(dive *source, bool edit_profile) : d(current_dive),
 	when(0),
 	maxdepth({0}),
@@ -827,7 +846,7 @@ ReplanDive::~ReplanDive()
 {
 	clear_cylinder_table(&cylinders);
 	free_dive_dcs(&dc);
-	free(notes);
+	arena_free(notes);
 }
 
 bool ReplanDive::workToBeDone()
@@ -846,13 +865,15 @@ void ReplanDive::undo()
 	std::swap(d->surface_pressure, surface_pressure);
 	std::swap(d->duration, duration);
 	std::swap(d->salinity, salinity);
+	load_samples(d);
+	packDcs(&dc);
 	fixup_dive(d);
 
 	QVector<dive *> divesToNotify = { d };
 	// Note that we have to emit cylindersReset before divesChanged, because the divesChanged
 	// updates the DivePlotDataModel, which is out-of-sync and gets confused.
-	emit diveListNotifier.cylindersReset(divesToNotify);
-	emit diveListNotifier.divesChanged(divesToNotify, DiveField::DATETIME | DiveField::DURATION | DiveField::DEPTH | DiveField::MODE |
+	diveListNotifier.resetCylinders(divesToNotify);
+	diveListNotifier.changeDives(divesToNotify, DiveField::DATETIME | DiveField::DURATION | DiveField::DEPTH | DiveField::MODE |
 							  DiveField::NOTES | DiveField::SALINITY | DiveField::ATM_PRESS);
 }
 
@@ -1237,7 +1258,7 @@ EditCylinder::EditCylinder(int index, cylinder_t cylIn, EditCylinderType typeIn,
 	for (int i = 0; i < (int)indexes.size(); ++i) {
 		switch (type) {
 		case EditCylinderType::TYPE:
-			free((void *)cyl[i].type.description);
+			arena_free((void *)cyl[i].type.description);
 			cyl[i].type = cylIn.type;
 			cyl[i].type.description = copy_qstring(description);
 			cyl[i].cylinder_use = cylIn.cylinder_use;
@@ -1273,6 +1294,35 @@ void EditCylinder::undo()
 
 #ifdef SUBSURFACE_MOBILE
 
+// Most edits on mobile don't touch the profile. Only keep one copy of the samples
+// and events of such dive computers. On exchange of the dives, they are moved
+// back into the dive that is in the dive table.
+static bool sameSamples(const struct divecomputer *a, const struct divecomputer *b)
+{
+	if (a->sample_repo || b->sample_repo || a->packed_samples || b->packed_samples)
+		return false;
+	if (a->samples != b->samples || memcmp(a->sample, b->sample, a->samples * sizeof(struct sample)))
+		return false;
+	const struct event *eva = a->events, *evb = b->events;
+	for (; eva && evb; eva = eva->next, evb = evb->next) {
+		if (!same_event(eva, evb))
+			return false;
+	}
+	return eva == evb;
+}
+
+static void swapSamples(struct divecomputer *a, struct divecomputer *b)
+{
+	std::swap(a->samples, b->samples);
+	std::swap(a->alloc_samples, b->alloc_samples);
+	std::swap(a->sample, b->sample);
+	std::swap(a->sample_repo, b->sample_repo);
+	std::swap(a->sample_blob_id, b->sample_blob_id);
+	std::swap(a->sample_reload_repo, b->sample_reload_repo);
+	std::swap(a->packed_samples, b->packed_samples);
+	std::swap(a->events, b->events);
+}
+
 EditDive::EditDive(dive *oldDiveIn, dive *newDiveIn, dive_site *createDs, dive_site *editDs, location_t dsLocationIn)
 	: oldDive(oldDiveIn)
 	, newDive(newDiveIn)
@@ -1336,6 +1386,19 @@ EditDive::EditDive(dive *oldDiveIn, dive *newDiveIn, dive_site *createDs, dive_s
 		changedFields |= DiveField::SALINITY;
 
 	newDive->dive_site = nullptr; // We will add the dive to the site manually and therefore saved the dive site.
+
+	const struct divecomputer *odc = &oldDive->dc;
+	for (struct divecomputer *ndc = &newDive->dc; odc && ndc; odc = odc->next, ndc = ndc->next) {
+		bool shared = sameSamples(odc, ndc);
+		if (shared) {
+			free(ndc->sample);
+			free_events(ndc->events);
+			ndc->sample = nullptr;
+			ndc->samples = ndc->alloc_samples = 0;
+			ndc->events = nullptr;
+		}
+		sharedSamples.push_back(shared);
+	}
 }
 
 void EditDive::undo()
@@ -1371,13 +1434,19 @@ void EditDive::exchangeDives()
 	newDive->hidden_by_filter = oldDive->hidden_by_filter;
 
 	// Bluntly exchange dive data by shallow copy.
-	// Don't forget to unregister the old and register the new dive!
+	// The fulltext cache stays with the dive in the dive table, so that re-registering
+	// only updates the words that actually changed.
 	// Likewise take care to add/remove the dive from the dive site.
-	fulltext_unregister(oldDive);
 	dive_site *oldDiveSite = oldDive->dive_site;
 	if (oldDiveSite)
 		unregister_dive_from_dive_site(oldDive); // the dive-site pointer in the dive is now NULL
 	std::swap(*newDive, *oldDive);
+	std::swap(newDive->full_text, oldDive->full_text);
+	struct divecomputer *odc = &oldDive->dc, *ndc = &newDive->dc;
+	for (size_t i = 0; i < sharedSamples.size() && odc && ndc; ++i, odc = odc->next, ndc = ndc->next) {
+		if (sharedSamples[i])
+			swapSamples(odc, ndc);
+	}
 	fulltext_register(oldDive);
 	if (newDiveSite)
 		add_dive_to_dive_site(oldDive, newDiveSite);
@@ -1394,11 +1463,11 @@ void EditDive::exchangeDives()
 			qWarning("Command::EditDive::redo(): This command does not support moving between trips!");
 		if (oldDive->divetrip)
 			sort_dive_table(&newDive->divetrip->dives); // Keep the trip-table in order
-		emit diveListNotifier.divesTimeChanged(delta, dives);
+		diveListNotifier.changeDivesTime(delta, dives);
 	}
 
 	// Send signals
-	emit diveListNotifier.divesChanged(dives, changedFields);
+	diveListNotifier.changeDives(dives, changedFields);
 
 	// Select the changed dives
 	setSelection( { oldDive }, oldDive);
@@ -439,6 +439,9 @@ private:
 	dive_site *siteToEdit;
 	location_t dsLocation;
 
+	// Dive computers whose samples and events are only stored in the dive in the dive table
+	std::vector<bool> sharedSamples;
+
 	void undo() override;
 	void redo() override;
 	bool workToBeDone() override;
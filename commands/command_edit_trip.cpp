@@ -24,6 +24,7 @@ void EditTripBase::undo()
 	QString old = data(trip);
 	set(trip, value);
 	value = old;
+	invalidate_trip_cache(trip); // Ensure that trip is written in git_save()
 
 	emit diveListNotifier.tripChanged(trip, fieldId());
 }
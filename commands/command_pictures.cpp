@@ -201,7 +201,7 @@ void AddPictures::swapDiveSites()
 		std::swap(ds, entry.ds);
 		if (ds)
 			add_dive_to_dive_site(entry.d, ds);
-		emit diveListNotifier.divesChanged(QVector<dive *>{ entry.d }, DiveField::DIVESITE);
+		diveListNotifier.changeDives(QVector<dive *>{ entry.d }, DiveField::DIVESITE);
 	}
 
 	for (DiveSiteEditEntry &entry: sitesToEdit) {
@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-2.0
+// Convert logbooks between the git, XML and UDDF formats and report their
+// yearly statistics, without a GUI. Meant for scripts and cron jobs.
+//
+// Exit codes: 0 on success, 1 for invalid arguments, 2 if a logbook
+// couldn't be read and 3 if an output couldn't be written.
+
+#include <QString>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+#include "core/qt-gui.h"
+#include "core/qthelper.h"
+#include "core/file.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divesite.h"
+#include "core/trip.h"
+#include "core/filterpreset.h"
+#include "core/statistics.h"
+#include "core/subsurfacestartup.h"
+#include <stdio.h>
+#include "git2.h"
+
+enum ExitCode {
+	EXIT_OK = 0,
+	EXIT_USAGE = 1,
+	EXIT_READ_ERROR = 2,
+	EXIT_WRITE_ERROR = 3
+};
+
+static bool showTiming = false;
+
+static void reportTime(const char *what, const QString &file, QElapsedTimer &timer)
+{
+	if (showTiming)
+		fprintf(stderr, "%s\t%s\t%lld ms\n", what, qPrintable(file), (long long)timer.restart());
+}
+
+// The format of the output is chosen by the extension. Everything that
+// isn't UDDF is passed to save_dives(), which writes git repositories
+// ("dir[branch]" and cloud URLs) and XML files.
+static int writeLogbook(const QString &output)
+{
+	QByteArray name = output.toUtf8();
+	if (output.endsWith(".uddf", Qt::CaseInsensitive))
+		return export_dives_xslt(name.constData(), false, 0, "uddf-export.xslt", false);
+	return save_dives(name.constData());
+}
+
+static void printStatsHeader()
+{
+	printf("logbook\tyear\tdives\ttotal time [min]\tshortest [min]\tlongest [min]\t"
+	       "max depth [m]\taverage depth [m]\taverage SAC [l/min]\tmin temp [C]\tmax temp [C]\n");
+}
+
+// One tab-separated line per year, always in SI units so that the output doesn't
+// depend on the preferences stored in the logbook.
+static void printStats(const QString &source)
+{
+	stats_summary_auto_free stats;
+	calculate_stats_summary(&stats, false);
+	QByteArray name = source.toUtf8();
+	for (int i = 0; stats.stats_yearly != NULL && stats.stats_yearly[i].period; ++i) {
+		const stats_t &s = stats.stats_yearly[i];
+		printf("%s\t%d\t%u\t%.1f\t%.1f\t%.1f\t%.1f\t%.1f\t%.2f\t%.1f\t%.1f\n", name.constData(),
+		       s.period, s.selection_size, s.total_time.seconds / 60.0,
+		       s.shortest_time.seconds / 60.0, s.longest_time.seconds / 60.0,
+		       s.max_depth.mm / 1000.0, s.avg_depth.mm / 1000.0, s.avg_sac.mliter / 1000.0,
+		       s.min_temp.mkelvin ? mkelvin_to_C(s.min_temp.mkelvin) : 0.0,
+		       s.max_temp.mkelvin ? mkelvin_to_C(s.max_temp.mkelvin) : 0.0);
+	}
+}
+
+// The dive data lives in global tables, so logbooks are processed one after the other.
+static int convertLogbook(const QString &source, const QString &output, bool stats)
+{
+	QElapsedTimer timer;
+	timer.start();
+	int ret = EXIT_OK;
+	git_prefs.unit_system = default_prefs.unit_system;
+	git_prefs.units = default_prefs.units;
+	if (parse_file(qPrintable(source), &dive_table, &trip_table, &dive_site_table, &filter_preset_table)) {
+		fprintf(stderr, "can't read %s\n", qPrintable(source));
+		ret = EXIT_READ_ERROR;
+	} else {
+		// this should have set up the informational preferences - let's grab
+		// the units from there
+		prefs.unit_system = git_prefs.unit_system;
+		prefs.units = git_prefs.units;
+		process_loaded_dives();
+		reportTime("read", source, timer);
+		if (stats) {
+			printStats(source);
+			reportTime("statistics", source, timer);
+		}
+		if (!output.isEmpty()) {
+			if (writeLogbook(output)) {
+				fprintf(stderr, "can't write %s\n", qPrintable(output));
+				ret = EXIT_WRITE_ERROR;
+			} else {
+				reportTime("write", output, timer);
+			}
+		}
+	}
+	clear_dive_file_data();
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	QCoreApplication *application = new QCoreApplication(argc, argv);
+	git_libgit2_init();
+	copy_prefs(&default_prefs, &prefs);
+	init_qt_late();
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Convert Subsurface logbooks and report their statistics");
+	parser.addHelpOption();
+	QCommandLineOption sourceOption(QStringList() << "s" << "source",
+					"Read the logbook <file> (XML, git repository or any importable format), may be given more than once",
+					"file");
+	parser.addOption(sourceOption);
+	QCommandLineOption outputOption(QStringList() << "o" << "output",
+					"Write the logbook to <file>, once for every --source. Files ending in .uddf are written as UDDF, "
+					"git repositories ('directory[branch]') as git and everything else as XML",
+					"file");
+	parser.addOption(outputOption);
+	QCommandLineOption statsOption(QStringList() << "statistics",
+				       "Write the yearly statistics of every logbook to stdout as tab-separated values");
+	parser.addOption(statsOption);
+	QCommandLineOption timingOption(QStringList() << "timing",
+					"Write the time taken by every step to stderr");
+	parser.addOption(timingOption);
+
+	parser.process(*application);
+
+	QStringList sources = parser.values(sourceOption);
+	QStringList outputs = parser.values(outputOption);
+	bool stats = parser.isSet(statsOption);
+	showTiming = parser.isSet(timingOption);
+
+	if (sources.isEmpty() || (!outputs.isEmpty() && sources.size() != outputs.size()) ||
+	    (outputs.isEmpty() && !stats)) {
+		fprintf(stderr, "need --statistics or the same number of --source and --output\n");
+		exit(EXIT_USAGE);
+	}
+
+	if (stats)
+		printStatsHeader();
+	int ret = EXIT_OK;
+	for (int i = 0; i < sources.size(); i++) {
+		int res = convertLogbook(sources[i], outputs.isEmpty() ? QString() : outputs[i], stats);
+		if (res > ret)
+			ret = res;
+	}
+	exit(ret);
+}
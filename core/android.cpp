@@ -10,6 +10,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <zip.h>
 
 #include <QtAndroidExtras/QtAndroidExtras>
@@ -238,6 +239,22 @@ int subsurface_zip_close(struct zip *zip)
 	return zip_close(zip);
 }
 
+void *subsurface_mmap(int fd, size_t size)
+{
+	void *ret;
+
+	/* The zero-filled rest of the last page terminates the buffer */
+	if (size % sysconf(_SC_PAGESIZE) == 0)
+		return NULL;
+	ret = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	return ret == MAP_FAILED ? NULL : ret;
+}
+
+void subsurface_munmap(void *addr, size_t size)
+{
+	munmap(addr, size);
+}
+
 /* win32 console */
 void subsurface_console_init(void)
 {
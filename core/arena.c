@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: GPL-2.0
+/* arena.c */
+/* bump allocator for loaded logbook data */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "qthelper.h"
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+struct arena_chunk {
+	struct arena_chunk *next;
+	size_t size, used;
+	char *data;
+};
+
+struct arena logbook_arena;
+
+/*
+ * All chunks of all arenas, sorted by address, so that arena_free() can
+ * find out whether a pointer belongs to an arena. The loader allocates
+ * from the parallel divecomputer parsing, hence the lock.
+ */
+static struct arena_chunk **chunk_index;
+static int nr_chunks, allocated_chunks;
+
+static int find_chunk(const void *p)
+{
+	int lo = 0, hi = nr_chunks;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if ((const char *)p < chunk_index[mid]->data)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	/* lo is the first chunk that starts after p */
+	if (lo > 0 && (const char *)p < chunk_index[lo - 1]->data + chunk_index[lo - 1]->size)
+		return lo - 1;
+	return -1;
+}
+
+static void index_chunk(struct arena_chunk *chunk)
+{
+	int idx = 0;
+
+	if (nr_chunks >= allocated_chunks) {
+		allocated_chunks = (nr_chunks + 32) * 3 / 2;
+		chunk_index = realloc(chunk_index, allocated_chunks * sizeof(struct arena_chunk *));
+		if (!chunk_index)
+			exit(1);
+	}
+	while (idx < nr_chunks && chunk_index[idx]->data < chunk->data)
+		idx++;
+	memmove(chunk_index + idx + 1, chunk_index + idx, (nr_chunks - idx) * sizeof(struct arena_chunk *));
+	chunk_index[idx] = chunk;
+	nr_chunks++;
+}
+
+static void unindex_chunk(struct arena_chunk *chunk)
+{
+	int idx = find_chunk(chunk->data);
+
+	if (idx < 0)
+		return;
+	memmove(chunk_index + idx, chunk_index + idx + 1, (nr_chunks - idx - 1) * sizeof(struct arena_chunk *));
+	nr_chunks--;
+}
+
+static struct arena_chunk *new_chunk(struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk = malloc(sizeof(struct arena_chunk));
+
+	if (!chunk)
+		exit(1);
+	chunk->data = malloc(size);
+	if (!chunk->data)
+		exit(1);
+	chunk->size = size;
+	chunk->used = 0;
+	index_chunk(chunk);
+
+	/* Oversized chunks go behind the current one, so that its free space isn't lost */
+	if (arena->chunks && size > ARENA_CHUNK_SIZE) {
+		chunk->next = arena->chunks->next;
+		arena->chunks->next = chunk;
+	} else {
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+	}
+	return chunk;
+}
+
+void *arena_alloc(struct arena *arena, size_t size)
+{
+	struct arena_chunk *chunk;
+	void *res;
+
+	if (!arena)
+		return malloc(size);
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	lock_arena();
+	chunk = arena->chunks;
+	if (!chunk || chunk->size - chunk->used < size)
+		chunk = new_chunk(arena, size > ARENA_CHUNK_SIZE / 4 ? size : ARENA_CHUNK_SIZE);
+	res = chunk->data + chunk->used;
+	chunk->used += size;
+	unlock_arena();
+	return res;
+}
+
+char *arena_strdup(struct arena *arena, const char *s)
+{
+	size_t len;
+	char *res;
+
+	if (!s)
+		return NULL;
+	if (!arena)
+		return strdup(s);
+	len = strlen(s) + 1;
+	res = arena_alloc(arena, len);
+	memcpy(res, s, len);
+	return res;
+}
+
+void arena_free(void *p)
+{
+	int idx;
+
+	if (!p)
+		return;
+	lock_arena();
+	idx = nr_chunks ? find_chunk(p) : -1;
+	unlock_arena();
+	if (idx < 0)
+		free(p);
+}
+
+void arena_clear(struct arena *arena)
+{
+	struct arena_chunk *chunk = arena->chunks;
+
+	lock_arena();
+	while (chunk) {
+		struct arena_chunk *next = chunk->next;
+		unindex_chunk(chunk);
+		free(chunk->data);
+		free(chunk);
+		chunk = next;
+	}
+	arena->chunks = NULL;
+	unlock_arena();
+}
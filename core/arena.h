@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A simple bump allocator for data that is created in bulk when loading
+ * a logbook and then mostly stays unchanged: dive strings, events and
+ * extra data. Memory of an arena can not be freed individually, but
+ * arena_free() may be called on any pointer. It frees memory that came
+ * from malloc() and ignores memory that is part of an arena. Thus, code
+ * that edits loaded data doesn't have to know where it came from, as long
+ * as it frees it with arena_free() instead of free().
+ *
+ * All memory of the logbook arena is released by clear_dive_file_data(),
+ * so nothing may keep pointers into it past that point.
+ */
+struct arena_chunk;
+struct arena {
+	struct arena_chunk *chunks;
+};
+
+extern struct arena logbook_arena;
+
+/* These fall back to malloc() and strdup() if arena is NULL */
+extern void *arena_alloc(struct arena *arena, size_t size);
+extern char *arena_strdup(struct arena *arena, const char *s);
+
+extern void arena_free(void *p);
+extern void arena_clear(struct arena *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ARENA_H
@@ -7,8 +7,9 @@
 #include <QDebug>
 #include <QLoggingCategory>
 #include <QRegularExpression>
-#include <QElapsedTimer>
 #include <QCoreApplication>
+#include <QEventLoop>
+#include <QSettings>
 
 extern QMap<QString, dc_descriptor_t *> descriptorLookup;
 
@@ -157,6 +158,7 @@ BTDiscovery::BTDiscovery(QObject*) : m_btValid(false),
 	m_instance = this;
 #if defined(BT_SUPPORT)
 	QLoggingCategory::setFilterRules(QStringLiteral("qt.bluetooth* = true"));
+	loadKnownDevices();
 	BTDiscoveryReDiscover();
 #endif
 }
@@ -247,6 +249,90 @@ QString markBLEAddress(const QBluetoothDeviceInfo *device)
 	return btDeviceAddress(device, isBle);
 }
 
+/*
+ * The dive computers found by earlier scans are remembered, so that they
+ * can be shown and connected to right away, while the scan is still
+ * running. On macOS, iOS and Windows this also saves waiting for the scan
+ * to find the device before we can connect (see getBtDeviceInfo()).
+ */
+#define MAX_KNOWN_BT_DEVICES 16
+
+static void storeKnownDevice(const QString &devaddr, const QBluetoothDeviceInfo &device)
+{
+	QSettings s;
+	QList<QVariantMap> devices;
+
+	int size = s.beginReadArray("KnownBluetoothDevices");
+	for (int i = 0; i < size; i++) {
+		s.setArrayIndex(i);
+		if (s.value("key").toString() == devaddr)
+			continue;
+		QVariantMap entry;
+		for (const QString &key: s.childKeys())
+			entry[key] = s.value(key);
+		devices.append(entry);
+	}
+	s.endArray();
+
+	QStringList services;
+	const auto serviceUuids = device.serviceUuids();
+	for (const QBluetoothUuid &id: serviceUuids)
+		services.append(id.toString());
+	QVariantMap entry;
+	entry["key"] = devaddr;
+	entry["name"] = device.name();
+	entry["address"] = device.address().isNull() ? QString() : device.address().toString();
+	entry["uuid"] = device.deviceUuid().toString();
+	entry["ble"] = device.coreConfigurations() == QBluetoothDeviceInfo::LowEnergyCoreConfiguration;
+	entry["services"] = services;
+	// most recently used first
+	devices.prepend(entry);
+	while (devices.size() > MAX_KNOWN_BT_DEVICES)
+		devices.removeLast();
+
+	s.beginWriteArray("KnownBluetoothDevices", devices.size());
+	for (int i = 0; i < devices.size(); i++) {
+		s.setArrayIndex(i);
+		for (auto it = devices[i].cbegin(); it != devices[i].cend(); ++it)
+			s.setValue(it.key(), it.value());
+	}
+	s.endArray();
+}
+
+void BTDiscovery::loadKnownDevices()
+{
+	QSettings s;
+	int size = s.beginReadArray("KnownBluetoothDevices");
+	for (int i = 0; i < size; i++) {
+		s.setArrayIndex(i);
+		QString key = s.value("key").toString();
+		QString name = s.value("name").toString();
+		QString address = s.value("address").toString();
+		bool ble = s.value("ble").toBool();
+		if (key.isEmpty())
+			continue;
+
+		QBluetoothDeviceInfo device = address.isEmpty() ?
+			QBluetoothDeviceInfo(QBluetoothUuid(s.value("uuid").toString()), name, 0) :
+			QBluetoothDeviceInfo(QBluetoothAddress(address), name, 0);
+		device.setCoreConfigurations(ble ? QBluetoothDeviceInfo::LowEnergyCoreConfiguration :
+						   QBluetoothDeviceInfo::BaseRateCoreConfiguration);
+		const QStringList services = s.value("services").toStringList();
+		for (const QString &id: services)
+			addBtUuid(QBluetoothUuid(id));
+		// a device found by the running scan is more up to date
+		if (!btDeviceInfo.contains(key))
+			btDeviceInfo[key] = device;
+
+		qDebug() << "known BT device" << name << key;
+		btPairedDevice this_d;
+		this_d.address = (ble ? "LE:" : "") + key;
+		this_d.name = name;
+		btDeviceDiscoveredMain(this_d);
+	}
+	s.endArray();
+}
+
 void BTDiscovery::btDeviceDiscovered(const QBluetoothDeviceInfo &device)
 {
 	btPairedDevice this_d;
@@ -260,6 +346,10 @@ void BTDiscovery::btDeviceDiscovered(const QBluetoothDeviceInfo &device)
 		qDebug() << id.toByteArray();
 	}
 
+	// only remember dive computers, there may be lots of other devices around
+	if (getDeviceType(device.name()))
+		storeKnownDevice(btDeviceAddress(&device, false), device);
+
 #if defined(Q_OS_IOS) || defined(Q_OS_MACOS) || defined(Q_OS_WIN)
 	// on Windows, macOS and iOS we need to scan in order to be able to access a device;
 	// let's remember the information we scanned on this run so we can at least
@@ -284,6 +374,11 @@ void BTDiscovery::btDeviceDiscoveredMain(const btPairedDevice &device)
 
 	qDebug() << "Found new device:" << newDevice << device.address;
 	if (newDC) {
+		// known devices are reported again by the scan
+		for (const btVendorProduct &known: btDCs) {
+			if (known.btpdi.address == device.address)
+				return;
+		}
 		QString vendor = dc_descriptor_get_vendor(newDC);
 		qDebug() << "this could be a " + vendor + " " + newDevice;
 		btVP.btpdi = device;
@@ -446,6 +541,7 @@ QString extractBluetoothNameAddress(const QString &address, QString &name)
 void saveBtDeviceInfo(const QString &devaddr, QBluetoothDeviceInfo deviceInfo)
 {
 	btDeviceInfo[devaddr] = deviceInfo;
+	storeKnownDevice(devaddr, deviceInfo);
 }
 
 QBluetoothDeviceInfo getBtDeviceInfo(const QString &devaddr)
@@ -458,16 +554,18 @@ QBluetoothDeviceInfo getBtDeviceInfo(const QString &devaddr)
 		qDebug() << "still looking scan is still running, we should just wait for a few moments";
 		// wait for a maximum of 30 more seconds
 		// yes, that seems crazy, but on my Mac I see this take more than 20 seconds
-		QElapsedTimer timer;
-		timer.start();
+		// sleep in the event loop until the next device is found
+		QTimer timer;
+		timer.setSingleShot(true);
+		timer.start(30000);
+		QEventLoop loop;
 		do {
-			if (btDeviceInfo.keys().contains(devaddr)) {
+			if (btDeviceInfo.contains(devaddr)) {
 				BTDiscovery::instance()->stopAgent();
 				return btDeviceInfo[devaddr];
 			}
-			QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
-			QThread::msleep(100);
-		} while (timer.elapsed() < 30000);
+			loop.processEvents(QEventLoop::AllEvents | QEventLoop::WaitForMoreEvents);
+		} while (timer.isActive());
 	}
 	qDebug() << "notify user that we can't find" << devaddr;
 	return QBluetoothDeviceInfo();
@@ -72,6 +72,8 @@ private:
 	QList<struct btPairedDevice> btPairedDevices;
 	QBluetoothDeviceDiscoveryAgent *discoveryAgent;
 
+	void loadKnownDevices();
+
 signals:
 	void dcVendorChanged();
 	void dcProductChanged();
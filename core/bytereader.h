@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef BYTEREADER_H
+#define BYTEREADER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "file.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Bounds-checked access to the binary logs of the importers.
+ *
+ * A byte_view is a window into a memblock, usually one mapped by
+ * map_file(). Sub-views point into the memory of their parent, so
+ * nothing is copied. Reads outside of a view return zero instead of
+ * reading past the end of the file, and a byte_reader remembers that
+ * it ran out of data, so that a parser can check the error flag once
+ * per record instead of checking the length before every field.
+ */
+struct byte_view {
+	const unsigned char *data;
+	size_t size;
+};
+
+struct byte_reader {
+	struct byte_view view;
+	size_t pos;
+	bool error;
+};
+
+static inline struct byte_view byte_view_of(const struct memblock *mem)
+{
+	struct byte_view v = { (const unsigned char *)mem->buffer, mem->size };
+	return v;
+}
+
+static inline bool byte_view_has(struct byte_view v, size_t offset, size_t len)
+{
+	return offset <= v.size && len <= v.size - offset;
+}
+
+/* An empty view if the range isn't completely inside of the view */
+static inline struct byte_view byte_view_sub(struct byte_view v, size_t offset, size_t len)
+{
+	struct byte_view sub = { NULL, 0 };
+	if (byte_view_has(v, offset, len)) {
+		sub.data = v.data + offset;
+		sub.size = len;
+	}
+	return sub;
+}
+
+static inline unsigned int byte_view_u8(struct byte_view v, size_t offset)
+{
+	return byte_view_has(v, offset, 1) ? v.data[offset] : 0;
+}
+
+static inline unsigned int byte_view_u16le(struct byte_view v, size_t offset)
+{
+	if (!byte_view_has(v, offset, 2))
+		return 0;
+	return v.data[offset] | v.data[offset + 1] << 8;
+}
+
+static inline uint32_t byte_view_u32le(struct byte_view v, size_t offset)
+{
+	if (!byte_view_has(v, offset, 4))
+		return 0;
+	return v.data[offset] | v.data[offset + 1] << 8 | v.data[offset + 2] << 16 | (uint32_t)v.data[offset + 3] << 24;
+}
+
+static inline float byte_view_f32le(struct byte_view v, size_t offset)
+{
+	uint32_t bits = byte_view_u32le(v, offset);
+	float f;
+	memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+static inline void byte_reader_init(struct byte_reader *r, struct byte_view v)
+{
+	r->view = v;
+	r->pos = 0;
+	r->error = false;
+}
+
+static inline size_t byte_reader_left(const struct byte_reader *r)
+{
+	return r->view.size - r->pos;
+}
+
+/* Marks the reader as failed if there are less than len bytes left */
+static inline bool byte_reader_need(struct byte_reader *r, size_t len)
+{
+	if (r->error || len > byte_reader_left(r)) {
+		r->error = true;
+		return false;
+	}
+	return true;
+}
+
+static inline bool byte_reader_skip(struct byte_reader *r, size_t len)
+{
+	if (!byte_reader_need(r, len))
+		return false;
+	r->pos += len;
+	return true;
+}
+
+static inline unsigned int byte_reader_u8(struct byte_reader *r)
+{
+	if (!byte_reader_need(r, 1))
+		return 0;
+	return r->view.data[r->pos++];
+}
+
+static inline unsigned int byte_reader_u16le(struct byte_reader *r)
+{
+	unsigned int val;
+	if (!byte_reader_need(r, 2))
+		return 0;
+	val = byte_view_u16le(r->view, r->pos);
+	r->pos += 2;
+	return val;
+}
+
+static inline uint32_t byte_reader_u32le(struct byte_reader *r)
+{
+	uint32_t val;
+	if (!byte_reader_need(r, 4))
+		return 0;
+	val = byte_view_u32le(r->view, r->pos);
+	r->pos += 4;
+	return val;
+}
+
+static inline float byte_reader_f32le(struct byte_reader *r)
+{
+	float val;
+	if (!byte_reader_need(r, 4))
+		return 0;
+	val = byte_view_f32le(r->view, r->pos);
+	r->pos += 4;
+	return val;
+}
+
+/* The next len bytes as a sub-view, without copying them */
+static inline struct byte_view byte_reader_view(struct byte_reader *r, size_t len)
+{
+	struct byte_view v = { NULL, 0 };
+	if (byte_reader_need(r, len)) {
+		v = byte_view_sub(r->view, r->pos, len);
+		r->pos += len;
+	}
+	return v;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BYTEREADER_H
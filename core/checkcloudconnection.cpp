@@ -4,6 +4,10 @@
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QEventLoop>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QMutex>
+#include <QtConcurrent>
 
 #include "pref.h"
 #include "qthelper.h"
@@ -23,6 +27,17 @@ CheckCloudConnection::CheckCloudConnection(QObject *parent) :
 #define HTTP_I_AM_A_TEAPOT 418
 #define MILK "Linus does not like non-fat milk"
 bool CheckCloudConnection::checkServer()
+{
+	if (reachServer(true))
+		return true;
+	git_storage_update_progress(qPrintable(tr("Cloud connection failed")));
+	git_local_only = true;
+	return false;
+}
+
+// The actual check. Doesn't touch any global state, so that it can run in the
+// background while the local cache is loaded. Progress is only reported if asked for.
+bool CheckCloudConnection::reachServer(bool reportProgress)
 {
 	if (verbose)
 		fprintf(stderr, "Checking cloud connection...\n");
@@ -55,6 +70,8 @@ bool CheckCloudConnection::checkServer()
 				return true;
 			}
 		} else if (seconds < prefs.cloud_timeout) {
+			if (!reportProgress)
+				continue;
 			QString text = tr("Waiting for cloud connection (%n second(s) passed)", "", seconds);
 			git_storage_update_progress(qPrintable(text));
 		} else {
@@ -62,8 +79,6 @@ bool CheckCloudConnection::checkServer()
 			reply->abort();
 		}
 	}
-	git_storage_update_progress(qPrintable(tr("Cloud connection failed")));
-	git_local_only = true;
 	if (verbose)
 		qDebug() << "connection test to cloud server failed" <<
 			    reply->error() << reply->errorString() <<
@@ -83,9 +98,49 @@ void CheckCloudConnection::sslErrors(const QList<QSslError> &errorList)
 		qDebug() << err.errorString();
 }
 
+// A check started by startCloudServerCheck(). Its result is used by the next
+// canReachCloudServer(), as long as it isn't older than maxCheckAge.
+static QMutex backgroundCheckLock;
+static QFuture<bool> backgroundCheck;
+static QElapsedTimer backgroundCheckAge;
+static const qint64 maxCheckAge = 60000; // ms
+
+// Check the connection to the cloud server on a worker thread, so that the check
+// overlaps with loading the local cache.
+extern "C" void startCloudServerCheck()
+{
+	QMutexLocker lock(&backgroundCheckLock);
+	if (backgroundCheck.isRunning())
+		return;
+	if (verbose)
+		qWarning() << "Cloud storage: checking connection to cloud server in the background";
+	backgroundCheckAge.start();
+	backgroundCheck = QtConcurrent::run([]() { return CheckCloudConnection().reachServer(false); });
+}
+
 // helper to be used from C code
 extern "C" bool canReachCloudServer()
 {
+	QFuture<bool> check;
+	bool haveCheck = false;
+	{
+		QMutexLocker lock(&backgroundCheckLock);
+		if (backgroundCheckAge.isValid() && backgroundCheckAge.elapsed() < maxCheckAge) {
+			check = backgroundCheck;
+			haveCheck = true;
+		}
+		backgroundCheck = QFuture<bool>();
+		backgroundCheckAge.invalidate();
+	}
+	if (haveCheck) {
+		if (verbose)
+			qWarning() << "Cloud storage: using the result of the background check";
+		if (check.result())
+			return true;
+		git_storage_update_progress(qPrintable(CheckCloudConnection::tr("Cloud connection failed")));
+		git_local_only = true;
+		return false;
+	}
 	if (verbose)
 		qWarning() << "Cloud storage: checking connection to cloud server";
 	return CheckCloudConnection().checkServer();
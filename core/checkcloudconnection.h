@@ -11,6 +11,7 @@ class CheckCloudConnection : public QObject {
 public:
 	CheckCloudConnection(QObject *parent = 0);
 	bool checkServer();
+	bool reachServer(bool reportProgress);
 private:
 	QNetworkReply *reply;
 private
@@ -15,6 +15,7 @@
 
 #include "dive.h"
 #include "file.h"
+#include "bytereader.h"
 #include "subsurface-time.h"
 #include "units.h"
 #include "sha1.h"
@@ -205,7 +206,14 @@ static void cochran_debug_sample(const char *s, unsigned int sample_cnt)
 static void cochran_parse_header(const unsigned char *decode, unsigned mod,
 				 const unsigned char *in, unsigned size)
 {
-	unsigned char *buf = malloc(size);
+	unsigned char *buf;
+
+	/* The log format is stored at 0x132 - 0x137 */
+	if (size < 0x138) {
+		printf ("Truncated header\n");
+		exit(1);
+	}
+	buf = malloc(size);
 
 	/* Do the "null decode" using a one-byte decode array of '\0' */
 	/* Copies in plaintext, will be overwritten later */
@@ -601,11 +609,14 @@ static void cochran_parse_samples(struct dive *dive, const unsigned char *log,
 		*duration = sample_cnt * profile_period - 1;
 }
 
+/*
+ * The dive is descrambled into buf, which has to hold at least
+ * size bytes. It is reused for all the dives of a file.
+ */
 static void cochran_parse_dive(const unsigned char *decode, unsigned mod,
 			       const unsigned char *in, unsigned size,
-			       struct dive_table *table)
+			       unsigned char *buf, struct dive_table *table)
 {
-	unsigned char *buf = malloc(size);
 	struct dive *dive;
 	struct divecomputer *dc;
 	struct tm tm = {0};
@@ -638,7 +649,6 @@ static void cochran_parse_dive(const unsigned char *decode, unsigned mod,
 
 	if (size < 0x4914 + config.logbook_size) {
 		// Analyst calls this a "Corrupt Beginning Summary"
-		free(buf);
 		return;
 	}
 
@@ -778,7 +788,9 @@ static void cochran_parse_dive(const unsigned char *decode, unsigned mod,
 
 	// Use the log information to determine actual profile sample size
 	// Otherwise we will get surface time at end of dive.
-	if (sample_pre_offset < sample_end_offset && sample_end_offset != 0xffffffff)
+	// Never beyond the end of the dive, though.
+	if (sample_pre_offset < sample_end_offset && sample_end_offset != 0xffffffff &&
+	    sample_end_offset - sample_pre_offset < sample_size)
 		sample_size = sample_end_offset - sample_pre_offset;
 
 	cochran_parse_samples(dive, buf + 0x4914, buf + 0x4914
@@ -794,8 +806,6 @@ static void cochran_parse_dive(const unsigned char *decode, unsigned mod,
 	}
 
 	record_dive_to_table(dive, table);
-
-	free(buf);
 }
 
 int try_to_open_cochran(const char *filename, struct memblock *mem, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites)
@@ -803,36 +813,52 @@ int try_to_open_cochran(const char *filename, struct memblock *mem, struct dive_
 	UNUSED(filename);
 	UNUSED(trips);
 	UNUSED(sites);
+	struct byte_view file = byte_view_of(mem);
 	unsigned int i;
 	unsigned int mod;
-	unsigned int *offsets, dive1, dive2;
-	unsigned char *decode = mem->buffer + 0x40001;
+	unsigned int dive1, dive2, max_size = 0;
+	const unsigned char *decode = file.data + 0x40001;
+	unsigned char *buf;
 
-	if (mem->size < 0x40000)
+	/* The offset table followed by the decode array of up to 256 bytes */
+	if (!byte_view_has(file, 0x40001, 0x100 + 1))
 		return 0;
 
-	offsets = (unsigned int *) mem->buffer;
-	dive1 = offsets[0];
-	dive2 = offsets[1];
+	dive1 = byte_view_u32le(file, 0);
+	dive2 = byte_view_u32le(file, 4);
 
-	if (dive1 < 0x40000 || dive2 < dive1 || dive2 > mem->size)
+	if (dive1 < 0x40000 || dive2 < dive1 || dive2 > file.size)
 		return 0;
 
 	mod = decode[0x100] + 1;
-	cochran_parse_header(decode, mod, mem->buffer + 0x40000, dive1 - 0x40000);
+	cochran_parse_header(decode, mod, file.data + 0x40000, dive1 - 0x40000);
+
+	// Find the largest dive, so that all of them can share one buffer
+	for (i = 0; i < 65534; i++) {
+		dive1 = byte_view_u32le(file, i * 4);
+		dive2 = byte_view_u32le(file, i * 4 + 4);
+		if (dive2 < dive1 || dive2 > file.size)
+			break;
+		if (dive2 - dive1 > max_size)
+			max_size = dive2 - dive1;
+	}
+	buf = malloc(max_size + 1);
+	if (!buf)
+		return 0;
 
 	// Decode each dive
 	for (i = 0; i < 65534; i++) {
-		dive1 = offsets[i];
-		dive2 = offsets[i + 1];
+		dive1 = byte_view_u32le(file, i * 4);
+		dive2 = byte_view_u32le(file, i * 4 + 4);
 		if (dive2 < dive1)
 			break;
-		if (dive2 > mem->size)
+		if (dive2 > file.size)
 			break;
 
-		cochran_parse_dive(decode, mod, mem->buffer + dive1,
-						dive2 - dive1, table);
+		cochran_parse_dive(decode, mod, file.data + dive1,
+						dive2 - dive1, buf, table);
 	}
+	free(buf);
 
 	return 1; // no further processing needed
 }
@@ -6,6 +6,9 @@
 #include "units.h"
 #include "errorhelper.h"
 
+#include <QHash>
+#include <QByteArray>
+
 #define OSTC3_GAS1			0x10
 #define OSTC3_GAS2			0x11
 #define OSTC3_GAS3			0x12
@@ -82,6 +85,8 @@
 #define SUUNTO_VYPER_ALARM_TIME           0x66
 #define SUUNTO_VYPER_ALARM_DEPTH          0x68
 #define SUUNTO_VYPER_CUSTOM_TEXT_LENGTH   30
+// All of the above, from the max depth up to and including the alarm depth
+#define SUUNTO_VYPER_SETTINGS_SIZE        (SUUNTO_VYPER_ALARM_DEPTH + 2 - SUUNTO_VYPER_MAXDEPTH)
 
 #ifdef DEBUG_OSTC
 // Fake io to ostc memory banks
@@ -148,133 +153,168 @@ static void write_ostc_cf(unsigned char data[], unsigned char cf, unsigned char
 		progress_cb(device, DC_EVENT_PROGRESS, &progress, userdata); \
 	} while (0)
 
+/*
+ * The settings as last read from or written to the device, keyed by the
+ * OSTC setting id or the Suunto memory address. Writing a setting that still
+ * has the same value is skipped, since every setting is a round trip to the
+ * device. The read and write threads never run at the same time.
+ */
+static struct {
+	QString device;
+	QHash<unsigned int, QByteArray> values;
+} last_settings;
+
+static QString settings_device(const DeviceDetails *m_deviceDetails)
+{
+	return m_deviceDetails->model + " " + m_deviceDetails->serialNo;
+}
+
+static void forget_settings()
+{
+	last_settings.device.clear();
+	last_settings.values.clear();
+}
+
+static void remember_setting(unsigned int id, const unsigned char data[], unsigned int size)
+{
+	last_settings.values.insert(id, QByteArray((const char *)data, size));
+}
+
+static bool setting_unchanged(unsigned int id, const unsigned char data[], unsigned int size)
+{
+	auto it = last_settings.values.constFind(id);
+	return it != last_settings.values.constEnd() && *it == QByteArray::fromRawData((const char *)data, size);
+}
+
+// Call before writing, to not compare against the settings of another device
+static void check_settings_device(const DeviceDetails *m_deviceDetails)
+{
+	if (last_settings.device != settings_device(m_deviceDetails))
+		forget_settings();
+}
+
+static dc_status_t ostc3_config_read(dc_device_t *device, unsigned int config, unsigned char data[], unsigned int size)
+{
+	dc_status_t rc = hw_ostc3_device_config_read(device, config, data, size);
+	if (rc == DC_STATUS_SUCCESS)
+		remember_setting(config, data, size);
+	return rc;
+}
+
+static dc_status_t ostc3_config_write(dc_device_t *device, unsigned int config, unsigned char data[], unsigned int size)
+{
+	if (setting_unchanged(config, data, size))
+		return DC_STATUS_SUCCESS;
+	dc_status_t rc = hw_ostc3_device_config_write(device, config, data, size);
+	if (rc == DC_STATUS_SUCCESS)
+		remember_setting(config, data, size);
+	return rc;
+}
+
+static dc_status_t suunto_vyper_write(dc_device_t *device, unsigned int address, const unsigned char data[], unsigned int size)
+{
+	if (setting_unchanged(address, data, size))
+		return DC_STATUS_SUCCESS;
+	dc_status_t rc = dc_device_write(device, address, data, size);
+	if (rc == DC_STATUS_SUCCESS)
+		remember_setting(address, data, size);
+	return rc;
+}
+
 static dc_status_t read_suunto_vyper_settings(dc_device_t *device, DeviceDetails *m_deviceDetails, dc_event_callback_t progress_cb, void *userdata)
 {
-	unsigned char data[SUUNTO_VYPER_CUSTOM_TEXT_LENGTH + 1];
+	// All settings are read in one go, which libdivecomputer splits into a
+	// few packets, instead of asking for every setting separately.
+	unsigned char settings[SUUNTO_VYPER_SETTINGS_SIZE];
+	unsigned char *data;
 	dc_status_t rc;
 	dc_event_progress_t progress;
 	progress.current = 0;
-	progress.maximum = 16;
+	progress.maximum = 1;
 
-	rc = dc_device_read(device, SUUNTO_VYPER_COMPUTER_TYPE, data, 1);
-	if (rc == DC_STATUS_SUCCESS) {
-		dc_descriptor_t *desc = get_descriptor(DC_FAMILY_SUUNTO_VYPER, data[0]);
+	forget_settings();
+	rc = dc_device_read(device, SUUNTO_VYPER_MAXDEPTH, settings, sizeof(settings));
+	if (rc != DC_STATUS_SUCCESS)
+		return rc;
+	EMIT_PROGRESS();
 
-		if (desc) {
-			// We found a supported device
-			// we can safely proceed with reading/writing to this device.
-			m_deviceDetails->model = dc_descriptor_get_product(desc);
-			dc_descriptor_free(desc);
-		} else {
-			return DC_STATUS_UNSUPPORTED;
-		}
+#define SETTING(_ADDRESS, _SIZE) (remember_setting(_ADDRESS, settings + (_ADDRESS) - SUUNTO_VYPER_MAXDEPTH, _SIZE), \
+				  settings + (_ADDRESS) - SUUNTO_VYPER_MAXDEPTH)
+
+	data = SETTING(SUUNTO_VYPER_COMPUTER_TYPE, 1);
+	dc_descriptor_t *desc = get_descriptor(DC_FAMILY_SUUNTO_VYPER, data[0]);
+	if (desc) {
+		// We found a supported device
+		// we can safely proceed with reading/writing to this device.
+		m_deviceDetails->model = dc_descriptor_get_product(desc);
+		dc_descriptor_free(desc);
+	} else {
+		return DC_STATUS_UNSUPPORTED;
 	}
-	EMIT_PROGRESS();
 
-	rc = dc_device_read(device, SUUNTO_VYPER_MAXDEPTH, data, 2);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	data = SETTING(SUUNTO_VYPER_MAXDEPTH, 2);
 	// in ft * 128.0
 	int depth = feet_to_mm(data[0] << 8 ^ data[1]) / 128;
 	m_deviceDetails->maxDepth = depth;
-	EMIT_PROGRESS();
 
-	rc = dc_device_read(device, SUUNTO_VYPER_TOTAL_TIME, data, 2);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	data = SETTING(SUUNTO_VYPER_TOTAL_TIME, 2);
 	int total_time = data[0] << 8 ^ data[1];
 	m_deviceDetails->totalTime = total_time;
-	EMIT_PROGRESS();
 
-	rc = dc_device_read(device, SUUNTO_VYPER_NUMBEROFDIVES, data, 2);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	data = SETTING(SUUNTO_VYPER_NUMBEROFDIVES, 2);
 	int number_of_dives = data[0] << 8 ^ data[1];
 	m_deviceDetails->numberOfDives = number_of_dives;
-	EMIT_PROGRESS();
 
-	rc = dc_device_read(device, SUUNTO_VYPER_FIRMWARE, data, 1);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	data = SETTING(SUUNTO_VYPER_FIRMWARE, 1);
 	m_deviceDetails->firmwareVersion = QString::number(data[0]) + ".0.0";
-	EMIT_PROGRESS();
 
-	rc = dc_device_read(device, SUUNTO_VYPER_SERIALNUMBER, data, 4);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	data = SETTING(SUUNTO_VYPER_SERIALNUMBER, 4);
 	int serial_number = data[0] * 1000000 + data[1] * 10000 + data[2] * 100 + data[3];
 	m_deviceDetails->serialNo = QString::number(serial_number);
-	EMIT_PROGRESS();
 
-	rc = dc_device_read(device, SUUNTO_VYPER_CUSTOM_TEXT, data, SUUNTO_VYPER_CUSTOM_TEXT_LENGTH);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
-	data[SUUNTO_VYPER_CUSTOM_TEXT_LENGTH] = 0;
-	m_deviceDetails->customText = (const char *)data;
-	EMIT_PROGRESS();
+	data = SETTING(SUUNTO_VYPER_CUSTOM_TEXT, SUUNTO_VYPER_CUSTOM_TEXT_LENGTH);
+	char customText[SUUNTO_VYPER_CUSTOM_TEXT_LENGTH + 1];
+	memcpy(customText, data, SUUNTO_VYPER_CUSTOM_TEXT_LENGTH);
+	customText[SUUNTO_VYPER_CUSTOM_TEXT_LENGTH] = 0;
+	m_deviceDetails->customText = customText;
 
-	rc = dc_device_read(device, SUUNTO_VYPER_SAMPLING_RATE, data, 1);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	data = SETTING(SUUNTO_VYPER_SAMPLING_RATE, 1);
 	m_deviceDetails->samplingRate = (int)data[0];
-	EMIT_PROGRESS();
 
-	rc = dc_device_read(device, SUUNTO_VYPER_ALTITUDE_SAFETY, data, 1);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	data = SETTING(SUUNTO_VYPER_ALTITUDE_SAFETY, 1);
 	m_deviceDetails->altitude = data[0] & 0x03;
 	m_deviceDetails->personalSafety = data[0] >> 2 & 0x03;
-	EMIT_PROGRESS();
 
-	rc = dc_device_read(device, SUUNTO_VYPER_TIMEFORMAT, data, 1);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	data = SETTING(SUUNTO_VYPER_TIMEFORMAT, 1);
 	m_deviceDetails->timeFormat = data[0] & 0x01;
-	EMIT_PROGRESS();
 
-	rc = dc_device_read(device, SUUNTO_VYPER_UNITS, data, 1);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	data = SETTING(SUUNTO_VYPER_UNITS, 1);
 	m_deviceDetails->units = data[0] & 0x01;
-	EMIT_PROGRESS();
 
-	rc = dc_device_read(device, SUUNTO_VYPER_MODEL, data, 1);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	data = SETTING(SUUNTO_VYPER_MODEL, 1);
 	m_deviceDetails->diveMode = data[0] & 0x03;
-	EMIT_PROGRESS();
 
-	rc = dc_device_read(device, SUUNTO_VYPER_LIGHT, data, 1);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	data = SETTING(SUUNTO_VYPER_LIGHT, 1);
 	m_deviceDetails->lightEnabled = data[0] >> 7;
 	m_deviceDetails->light = data[0] & 0x7F;
-	EMIT_PROGRESS();
 
-	rc = dc_device_read(device, SUUNTO_VYPER_ALARM_DEPTH_TIME, data, 1);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	data = SETTING(SUUNTO_VYPER_ALARM_DEPTH_TIME, 1);
 	m_deviceDetails->alarmTimeEnabled = data[0] & 0x01;
 	m_deviceDetails->alarmDepthEnabled = data[0] >> 1 & 0x01;
-	EMIT_PROGRESS();
 
-	rc = dc_device_read(device, SUUNTO_VYPER_ALARM_TIME, data, 2);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	data = SETTING(SUUNTO_VYPER_ALARM_TIME, 2);
 	int time = data[0] << 8 ^ data[1];
 	// The stinger stores alarm time in seconds instead of minutes.
 	if (m_deviceDetails->model == "Stinger")
 		time /= 60;
 	m_deviceDetails->alarmTime = time;
-	EMIT_PROGRESS();
 
-	rc = dc_device_read(device, SUUNTO_VYPER_ALARM_DEPTH, data, 2);
-	if (rc != DC_STATUS_SUCCESS)
-		return rc;
+	data = SETTING(SUUNTO_VYPER_ALARM_DEPTH, 2);
 	depth = feet_to_mm(data[0] << 8 ^ data[1]) / 128;
 	m_deviceDetails->alarmDepth = depth;
-	EMIT_PROGRESS();
+#undef SETTING
 
+	last_settings.device = settings_device(m_deviceDetails);
 	return DC_STATUS_SUCCESS;
 }
 
@@ -292,8 +332,9 @@ static dc_status_t write_suunto_vyper_settings(dc_device_t *device, DeviceDetail
 	// For now we just check that we actually read a device before writing to one.
 	if (m_deviceDetails->model == "")
 		return DC_STATUS_UNSUPPORTED;
+	check_settings_device(m_deviceDetails);
 
-	rc = dc_device_write(device, SUUNTO_VYPER_CUSTOM_TEXT,
+	rc = suunto_vyper_write(device, SUUNTO_VYPER_CUSTOM_TEXT,
 			     // Convert the customText to a 30 char wide padded with " "
 			     (const unsigned char *)qPrintable(QString("%1").arg(m_deviceDetails->customText, -30, QChar(' '))),
 			     SUUNTO_VYPER_CUSTOM_TEXT_LENGTH);
@@ -302,43 +343,43 @@ static dc_status_t write_suunto_vyper_settings(dc_device_t *device, DeviceDetail
 	EMIT_PROGRESS();
 
 	data = m_deviceDetails->samplingRate;
-	rc = dc_device_write(device, SUUNTO_VYPER_SAMPLING_RATE, &data, 1);
+	rc = suunto_vyper_write(device, SUUNTO_VYPER_SAMPLING_RATE, &data, 1);
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 
 	data = m_deviceDetails->personalSafety << 2 ^ m_deviceDetails->altitude;
-	rc = dc_device_write(device, SUUNTO_VYPER_ALTITUDE_SAFETY, &data, 1);
+	rc = suunto_vyper_write(device, SUUNTO_VYPER_ALTITUDE_SAFETY, &data, 1);
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 
 	data = m_deviceDetails->timeFormat;
-	rc = dc_device_write(device, SUUNTO_VYPER_TIMEFORMAT, &data, 1);
+	rc = suunto_vyper_write(device, SUUNTO_VYPER_TIMEFORMAT, &data, 1);
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 
 	data = m_deviceDetails->units;
-	rc = dc_device_write(device, SUUNTO_VYPER_UNITS, &data, 1);
+	rc = suunto_vyper_write(device, SUUNTO_VYPER_UNITS, &data, 1);
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 
 	data = m_deviceDetails->diveMode;
-	rc = dc_device_write(device, SUUNTO_VYPER_MODEL, &data, 1);
+	rc = suunto_vyper_write(device, SUUNTO_VYPER_MODEL, &data, 1);
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 
 	data = m_deviceDetails->lightEnabled << 7 ^ (m_deviceDetails->light & 0x7F);
-	rc = dc_device_write(device, SUUNTO_VYPER_LIGHT, &data, 1);
+	rc = suunto_vyper_write(device, SUUNTO_VYPER_LIGHT, &data, 1);
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 
 	data = m_deviceDetails->alarmDepthEnabled << 1 ^ m_deviceDetails->alarmTimeEnabled;
-	rc = dc_device_write(device, SUUNTO_VYPER_ALARM_DEPTH_TIME, &data, 1);
+	rc = suunto_vyper_write(device, SUUNTO_VYPER_ALARM_DEPTH_TIME, &data, 1);
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
@@ -349,14 +390,14 @@ static dc_status_t write_suunto_vyper_settings(dc_device_t *device, DeviceDetail
 		time *= 60;
 	data2[0] = time >> 8;
 	data2[1] = time & 0xFF;
-	rc = dc_device_write(device, SUUNTO_VYPER_ALARM_TIME, data2, 2);
+	rc = suunto_vyper_write(device, SUUNTO_VYPER_ALARM_TIME, data2, 2);
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 
 	data2[0] = (int)(mm_to_feet(m_deviceDetails->alarmDepth) * 128) >> 8;
 	data2[1] = (int)(mm_to_feet(m_deviceDetails->alarmDepth) * 128) & 0x0FF;
-	rc = dc_device_write(device, SUUNTO_VYPER_ALARM_DEPTH, data2, 2);
+	rc = suunto_vyper_write(device, SUUNTO_VYPER_ALARM_DEPTH, data2, 2);
 	EMIT_PROGRESS();
 	return rc;
 }
@@ -381,7 +422,7 @@ static dc_status_t read_ostc4_settings(dc_device_t *device, DeviceDetails *m_dev
 	gas gas5;
 	unsigned char gasData[4] = { 0, 0, 0, 0 };
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_GAS1, gasData, sizeof(gasData));
+	rc = ostc3_config_read(device, OSTC3_GAS1, gasData, sizeof(gasData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	gas1.oxygen = gasData[0];
@@ -390,7 +431,7 @@ static dc_status_t read_ostc4_settings(dc_device_t *device, DeviceDetails *m_dev
 	gas1.depth = gasData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_GAS2, gasData, sizeof(gasData));
+	rc = ostc3_config_read(device, OSTC3_GAS2, gasData, sizeof(gasData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	gas2.oxygen = gasData[0];
@@ -399,7 +440,7 @@ static dc_status_t read_ostc4_settings(dc_device_t *device, DeviceDetails *m_dev
 	gas2.depth = gasData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_GAS3, gasData, sizeof(gasData));
+	rc = ostc3_config_read(device, OSTC3_GAS3, gasData, sizeof(gasData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	gas3.oxygen = gasData[0];
@@ -408,7 +449,7 @@ static dc_status_t read_ostc4_settings(dc_device_t *device, DeviceDetails *m_dev
 	gas3.depth = gasData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_GAS4, gasData, sizeof(gasData));
+	rc = ostc3_config_read(device, OSTC3_GAS4, gasData, sizeof(gasData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	gas4.oxygen = gasData[0];
@@ -417,7 +458,7 @@ static dc_status_t read_ostc4_settings(dc_device_t *device, DeviceDetails *m_dev
 	gas4.depth = gasData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_GAS5, gasData, sizeof(gasData));
+	rc = ostc3_config_read(device, OSTC3_GAS5, gasData, sizeof(gasData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	gas5.oxygen = gasData[0];
@@ -441,7 +482,7 @@ static dc_status_t read_ostc4_settings(dc_device_t *device, DeviceDetails *m_dev
 	gas dil5;
 	unsigned char dilData[4] = { 0, 0, 0, 0 };
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_DIL1, dilData, sizeof(dilData));
+	rc = ostc3_config_read(device, OSTC3_DIL1, dilData, sizeof(dilData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	dil1.oxygen = dilData[0];
@@ -450,7 +491,7 @@ static dc_status_t read_ostc4_settings(dc_device_t *device, DeviceDetails *m_dev
 	dil1.depth = dilData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_DIL2, dilData, sizeof(dilData));
+	rc = ostc3_config_read(device, OSTC3_DIL2, dilData, sizeof(dilData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	dil2.oxygen = dilData[0];
@@ -459,7 +500,7 @@ static dc_status_t read_ostc4_settings(dc_device_t *device, DeviceDetails *m_dev
 	dil2.depth = dilData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_DIL3, dilData, sizeof(dilData));
+	rc = ostc3_config_read(device, OSTC3_DIL3, dilData, sizeof(dilData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	dil3.oxygen = dilData[0];
@@ -468,7 +509,7 @@ static dc_status_t read_ostc4_settings(dc_device_t *device, DeviceDetails *m_dev
 	dil3.depth = dilData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_DIL4, dilData, sizeof(dilData));
+	rc = ostc3_config_read(device, OSTC3_DIL4, dilData, sizeof(dilData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	dil4.oxygen = dilData[0];
@@ -477,7 +518,7 @@ static dc_status_t read_ostc4_settings(dc_device_t *device, DeviceDetails *m_dev
 	dil4.depth = dilData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_DIL5, dilData, sizeof(dilData));
+	rc = ostc3_config_read(device, OSTC3_DIL5, dilData, sizeof(dilData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	dil5.oxygen = dilData[0];
@@ -500,35 +541,35 @@ static dc_status_t read_ostc4_settings(dc_device_t *device, DeviceDetails *m_dev
 	setpoint sp5;
 	unsigned char spData[4] = { 0, 0, 0, 0};
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_SP1, spData, sizeof(spData));
+	rc = ostc3_config_read(device, OSTC3_SP1, spData, sizeof(spData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	sp1.sp = spData[0];
 	sp1.depth = spData[1];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_SP2, spData, sizeof(spData));
+	rc = ostc3_config_read(device, OSTC3_SP2, spData, sizeof(spData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	sp2.sp = spData[0];
 	sp2.depth = spData[1];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_SP3, spData, sizeof(spData));
+	rc = ostc3_config_read(device, OSTC3_SP3, spData, sizeof(spData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	sp3.sp = spData[0];
 	sp3.depth = spData[1];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_SP4, spData, sizeof(spData));
+	rc = ostc3_config_read(device, OSTC3_SP4, spData, sizeof(spData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	sp4.sp = spData[0];
 	sp4.depth = spData[1];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_SP5, spData, sizeof(spData));
+	rc = ostc3_config_read(device, OSTC3_SP5, spData, sizeof(spData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	sp5.sp = spData[0];
@@ -546,7 +587,7 @@ static dc_status_t read_ostc4_settings(dc_device_t *device, DeviceDetails *m_dev
 
 #define READ_SETTING(_OSTC4_SETTING, _DEVICE_DETAIL)                                            \
 	do {                                                                                    \
-		rc = hw_ostc3_device_config_read(device, _OSTC4_SETTING, uData, sizeof(uData)); \
+		rc = ostc3_config_read(device, _OSTC4_SETTING, uData, sizeof(uData)); \
 		if (rc != DC_STATUS_SUCCESS)                                                    \
 			return rc;                                                              \
 		m_deviceDetails->_DEVICE_DETAIL = uData[0];                                     \
@@ -593,14 +634,14 @@ static dc_status_t read_ostc4_settings(dc_device_t *device, DeviceDetails *m_dev
 
 #undef READ_SETTING
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_PRESSURE_SENSOR_OFFSET, uData, sizeof(uData));
+	rc = ostc3_config_read(device, OSTC3_PRESSURE_SENSOR_OFFSET, uData, sizeof(uData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	// OSTC3 stores the pressureSensorOffset in two-complement
 	m_deviceDetails->pressureSensorOffset = (signed char)uData[0];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_TEMP_SENSOR_OFFSET, uData, sizeof(uData));
+	rc = ostc3_config_read(device, OSTC3_TEMP_SENSOR_OFFSET, uData, sizeof(uData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	// OSTC3 stores the tempSensorOffset in two-complement
@@ -625,6 +666,7 @@ static dc_status_t read_ostc4_settings(dc_device_t *device, DeviceDetails *m_dev
 	m_deviceDetails->customText = ar.trimmed();
 	EMIT_PROGRESS();
 
+	last_settings.device = settings_device(m_deviceDetails);
 	return rc;
 }
 
@@ -638,6 +680,8 @@ static dc_status_t write_ostc4_settings(dc_device_t *device, DeviceDetails *m_de
 	progress.current = 0;
 	progress.maximum = 21;
 
+	check_settings_device(m_deviceDetails);
+
 	//write gas values
 	unsigned char gas1Data[4] = {
 		m_deviceDetails->gas1.oxygen,
@@ -674,27 +718,27 @@ static dc_status_t write_ostc4_settings(dc_device_t *device, DeviceDetails *m_de
 		m_deviceDetails->gas5.depth
 	};
 	//gas 1
-	rc = hw_ostc3_device_config_write(device, OSTC3_GAS1, gas1Data, sizeof(gas1Data));
+	rc = ostc3_config_write(device, OSTC3_GAS1, gas1Data, sizeof(gas1Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//gas 2
-	rc = hw_ostc3_device_config_write(device, OSTC3_GAS2, gas2Data, sizeof(gas2Data));
+	rc = ostc3_config_write(device, OSTC3_GAS2, gas2Data, sizeof(gas2Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//gas 3
-	rc = hw_ostc3_device_config_write(device, OSTC3_GAS3, gas3Data, sizeof(gas3Data));
+	rc = ostc3_config_write(device, OSTC3_GAS3, gas3Data, sizeof(gas3Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//gas 4
-	rc = hw_ostc3_device_config_write(device, OSTC3_GAS4, gas4Data, sizeof(gas4Data));
+	rc = ostc3_config_write(device, OSTC3_GAS4, gas4Data, sizeof(gas4Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//gas 5
-	rc = hw_ostc3_device_config_write(device, OSTC3_GAS5, gas5Data, sizeof(gas5Data));
+	rc = ostc3_config_write(device, OSTC3_GAS5, gas5Data, sizeof(gas5Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
@@ -726,27 +770,27 @@ static dc_status_t write_ostc4_settings(dc_device_t *device, DeviceDetails *m_de
 	};
 
 	//sp 1
-	rc = hw_ostc3_device_config_write(device, OSTC3_SP1, sp1Data, sizeof(sp1Data));
+	rc = ostc3_config_write(device, OSTC3_SP1, sp1Data, sizeof(sp1Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//sp 2
-	rc = hw_ostc3_device_config_write(device, OSTC3_SP2, sp2Data, sizeof(sp2Data));
+	rc = ostc3_config_write(device, OSTC3_SP2, sp2Data, sizeof(sp2Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//sp 3
-	rc = hw_ostc3_device_config_write(device, OSTC3_SP3, sp3Data, sizeof(sp3Data));
+	rc = ostc3_config_write(device, OSTC3_SP3, sp3Data, sizeof(sp3Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//sp 4
-	rc = hw_ostc3_device_config_write(device, OSTC3_SP4, sp4Data, sizeof(sp4Data));
+	rc = ostc3_config_write(device, OSTC3_SP4, sp4Data, sizeof(sp4Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//sp 5
-	rc = hw_ostc3_device_config_write(device, OSTC3_SP5, sp5Data, sizeof(sp5Data));
+	rc = ostc3_config_write(device, OSTC3_SP5, sp5Data, sizeof(sp5Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
@@ -787,27 +831,27 @@ static dc_status_t write_ostc4_settings(dc_device_t *device, DeviceDetails *m_de
 		m_deviceDetails->dil5.depth
 	};
 	//dil 1
-	rc = hw_ostc3_device_config_write(device, OSTC3_DIL1, dil1Data, sizeof(gas1Data));
+	rc = ostc3_config_write(device, OSTC3_DIL1, dil1Data, sizeof(gas1Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//dil 2
-	rc = hw_ostc3_device_config_write(device, OSTC3_DIL2, dil2Data, sizeof(dil2Data));
+	rc = ostc3_config_write(device, OSTC3_DIL2, dil2Data, sizeof(dil2Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//dil 3
-	rc = hw_ostc3_device_config_write(device, OSTC3_DIL3, dil3Data, sizeof(dil3Data));
+	rc = ostc3_config_write(device, OSTC3_DIL3, dil3Data, sizeof(dil3Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//dil 4
-	rc = hw_ostc3_device_config_write(device, OSTC3_DIL4, dil4Data, sizeof(dil4Data));
+	rc = ostc3_config_write(device, OSTC3_DIL4, dil4Data, sizeof(dil4Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//dil 5
-	rc = hw_ostc3_device_config_write(device, OSTC3_DIL5, dil5Data, sizeof(dil5Data));
+	rc = ostc3_config_write(device, OSTC3_DIL5, dil5Data, sizeof(dil5Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
@@ -823,7 +867,7 @@ static dc_status_t write_ostc4_settings(dc_device_t *device, DeviceDetails *m_de
 #define WRITE_SETTING(_OSTC4_SETTING, _DEVICE_DETAIL)                                          \
 	do {                                                                                   \
 		data[0] = m_deviceDetails->_DEVICE_DETAIL;                                     \
-		rc = hw_ostc3_device_config_write(device, _OSTC4_SETTING, data, sizeof(data)); \
+		rc = ostc3_config_write(device, _OSTC4_SETTING, data, sizeof(data)); \
 		if (rc != DC_STATUS_SUCCESS)                                                   \
 			return rc;                                                             \
 		EMIT_PROGRESS();                                                               \
@@ -871,14 +915,14 @@ static dc_status_t write_ostc4_settings(dc_device_t *device, DeviceDetails *m_de
 
 	// OSTC3 stores the pressureSensorOffset in two-complement
 	data[0] = (unsigned char)m_deviceDetails->pressureSensorOffset;
-	rc = hw_ostc3_device_config_write(device, OSTC3_PRESSURE_SENSOR_OFFSET, data, sizeof(data));
+	rc = ostc3_config_write(device, OSTC3_PRESSURE_SENSOR_OFFSET, data, sizeof(data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 
 	// OSTC3 stores the tempSensorOffset in two-complement
 	data[0] = (unsigned char)m_deviceDetails->tempSensorOffset;
-	rc = hw_ostc3_device_config_write(device, OSTC3_TEMP_SENSOR_OFFSET, data, sizeof(data));
+	rc = ostc3_config_write(device, OSTC3_TEMP_SENSOR_OFFSET, data, sizeof(data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
@@ -905,6 +949,8 @@ static dc_status_t read_ostc3_settings(dc_device_t *device, DeviceDetails *m_dev
 	progress.maximum = 56;
 	unsigned char hardware[1];
 
+	forget_settings();
+
 	//Read hardware type
 	rc = hw_ostc3_device_hardware (device, hardware, sizeof (hardware));
 	if (rc != DC_STATUS_SUCCESS)
@@ -931,7 +977,7 @@ static dc_status_t read_ostc3_settings(dc_device_t *device, DeviceDetails *m_dev
 	gas gas5;
 	unsigned char gasData[4] = { 0, 0, 0, 0 };
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_GAS1, gasData, sizeof(gasData));
+	rc = ostc3_config_read(device, OSTC3_GAS1, gasData, sizeof(gasData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	gas1.oxygen = gasData[0];
@@ -940,7 +986,7 @@ static dc_status_t read_ostc3_settings(dc_device_t *device, DeviceDetails *m_dev
 	gas1.depth = gasData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_GAS2, gasData, sizeof(gasData));
+	rc = ostc3_config_read(device, OSTC3_GAS2, gasData, sizeof(gasData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	gas2.oxygen = gasData[0];
@@ -949,7 +995,7 @@ static dc_status_t read_ostc3_settings(dc_device_t *device, DeviceDetails *m_dev
 	gas2.depth = gasData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_GAS3, gasData, sizeof(gasData));
+	rc = ostc3_config_read(device, OSTC3_GAS3, gasData, sizeof(gasData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	gas3.oxygen = gasData[0];
@@ -958,7 +1004,7 @@ static dc_status_t read_ostc3_settings(dc_device_t *device, DeviceDetails *m_dev
 	gas3.depth = gasData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_GAS4, gasData, sizeof(gasData));
+	rc = ostc3_config_read(device, OSTC3_GAS4, gasData, sizeof(gasData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	gas4.oxygen = gasData[0];
@@ -967,7 +1013,7 @@ static dc_status_t read_ostc3_settings(dc_device_t *device, DeviceDetails *m_dev
 	gas4.depth = gasData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_GAS5, gasData, sizeof(gasData));
+	rc = ostc3_config_read(device, OSTC3_GAS5, gasData, sizeof(gasData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	gas5.oxygen = gasData[0];
@@ -991,7 +1037,7 @@ static dc_status_t read_ostc3_settings(dc_device_t *device, DeviceDetails *m_dev
 	gas dil5;
 	unsigned char dilData[4] = { 0, 0, 0, 0 };
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_DIL1, dilData, sizeof(dilData));
+	rc = ostc3_config_read(device, OSTC3_DIL1, dilData, sizeof(dilData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	dil1.oxygen = dilData[0];
@@ -1000,7 +1046,7 @@ static dc_status_t read_ostc3_settings(dc_device_t *device, DeviceDetails *m_dev
 	dil1.depth = dilData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_DIL2, dilData, sizeof(dilData));
+	rc = ostc3_config_read(device, OSTC3_DIL2, dilData, sizeof(dilData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	dil2.oxygen = dilData[0];
@@ -1009,7 +1055,7 @@ static dc_status_t read_ostc3_settings(dc_device_t *device, DeviceDetails *m_dev
 	dil2.depth = dilData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_DIL3, dilData, sizeof(dilData));
+	rc = ostc3_config_read(device, OSTC3_DIL3, dilData, sizeof(dilData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	dil3.oxygen = dilData[0];
@@ -1018,7 +1064,7 @@ static dc_status_t read_ostc3_settings(dc_device_t *device, DeviceDetails *m_dev
 	dil3.depth = dilData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_DIL4, dilData, sizeof(dilData));
+	rc = ostc3_config_read(device, OSTC3_DIL4, dilData, sizeof(dilData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	dil4.oxygen = dilData[0];
@@ -1027,7 +1073,7 @@ static dc_status_t read_ostc3_settings(dc_device_t *device, DeviceDetails *m_dev
 	dil4.depth = dilData[3];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_DIL5, dilData, sizeof(dilData));
+	rc = ostc3_config_read(device, OSTC3_DIL5, dilData, sizeof(dilData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	dil5.oxygen = dilData[0];
@@ -1050,35 +1096,35 @@ static dc_status_t read_ostc3_settings(dc_device_t *device, DeviceDetails *m_dev
 	setpoint sp5;
 	unsigned char spData[2] = { 0, 0 };
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_SP1, spData, sizeof(spData));
+	rc = ostc3_config_read(device, OSTC3_SP1, spData, sizeof(spData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	sp1.sp = spData[0];
 	sp1.depth = spData[1];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_SP2, spData, sizeof(spData));
+	rc = ostc3_config_read(device, OSTC3_SP2, spData, sizeof(spData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	sp2.sp = spData[0];
 	sp2.depth = spData[1];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_SP3, spData, sizeof(spData));
+	rc = ostc3_config_read(device, OSTC3_SP3, spData, sizeof(spData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	sp3.sp = spData[0];
 	sp3.depth = spData[1];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_SP4, spData, sizeof(spData));
+	rc = ostc3_config_read(device, OSTC3_SP4, spData, sizeof(spData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	sp4.sp = spData[0];
 	sp4.depth = spData[1];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_SP5, spData, sizeof(spData));
+	rc = ostc3_config_read(device, OSTC3_SP5, spData, sizeof(spData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	sp5.sp = spData[0];
@@ -1096,7 +1142,7 @@ static dc_status_t read_ostc3_settings(dc_device_t *device, DeviceDetails *m_dev
 
 #define READ_SETTING(_OSTC3_SETTING, _DEVICE_DETAIL)                                            \
 	do {                                                                                    \
-		rc = hw_ostc3_device_config_read(device, _OSTC3_SETTING, uData, sizeof(uData)); \
+		rc = ostc3_config_read(device, _OSTC3_SETTING, uData, sizeof(uData)); \
 		if (rc != DC_STATUS_SUCCESS)                                                    \
 			return rc;                                                              \
 		m_deviceDetails->_DEVICE_DETAIL = uData[0];                                     \
@@ -1143,14 +1189,14 @@ static dc_status_t read_ostc3_settings(dc_device_t *device, DeviceDetails *m_dev
 
 #undef READ_SETTING
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_PRESSURE_SENSOR_OFFSET, uData, sizeof(uData));
+	rc = ostc3_config_read(device, OSTC3_PRESSURE_SENSOR_OFFSET, uData, sizeof(uData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	// OSTC3 stores the pressureSensorOffset in two-complement
 	m_deviceDetails->pressureSensorOffset = (signed char)uData[0];
 	EMIT_PROGRESS();
 
-	rc = hw_ostc3_device_config_read(device, OSTC3_TEMP_SENSOR_OFFSET, uData, sizeof(uData));
+	rc = ostc3_config_read(device, OSTC3_TEMP_SENSOR_OFFSET, uData, sizeof(uData));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	// OSTC3 stores the tempSensorOffset in two-complement
@@ -1169,6 +1215,7 @@ static dc_status_t read_ostc3_settings(dc_device_t *device, DeviceDetails *m_dev
 	m_deviceDetails->customText = ar.trimmed();
 	EMIT_PROGRESS();
 
+	last_settings.device = settings_device(m_deviceDetails);
 	return rc;
 }
 
@@ -1179,6 +1226,8 @@ static dc_status_t write_ostc3_settings(dc_device_t *device, DeviceDetails *m_de
 	progress.current = 0;
 	progress.maximum = 55;
 
+	check_settings_device(m_deviceDetails);
+
 	//write gas values
 	unsigned char gas1Data[4] = {
 		m_deviceDetails->gas1.oxygen,
@@ -1215,27 +1264,27 @@ static dc_status_t write_ostc3_settings(dc_device_t *device, DeviceDetails *m_de
 		m_deviceDetails->gas5.depth
 	};
 	//gas 1
-	rc = hw_ostc3_device_config_write(device, OSTC3_GAS1, gas1Data, sizeof(gas1Data));
+	rc = ostc3_config_write(device, OSTC3_GAS1, gas1Data, sizeof(gas1Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//gas 2
-	rc = hw_ostc3_device_config_write(device, OSTC3_GAS2, gas2Data, sizeof(gas2Data));
+	rc = ostc3_config_write(device, OSTC3_GAS2, gas2Data, sizeof(gas2Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//gas 3
-	rc = hw_ostc3_device_config_write(device, OSTC3_GAS3, gas3Data, sizeof(gas3Data));
+	rc = ostc3_config_write(device, OSTC3_GAS3, gas3Data, sizeof(gas3Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//gas 4
-	rc = hw_ostc3_device_config_write(device, OSTC3_GAS4, gas4Data, sizeof(gas4Data));
+	rc = ostc3_config_write(device, OSTC3_GAS4, gas4Data, sizeof(gas4Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//gas 5
-	rc = hw_ostc3_device_config_write(device, OSTC3_GAS5, gas5Data, sizeof(gas5Data));
+	rc = ostc3_config_write(device, OSTC3_GAS5, gas5Data, sizeof(gas5Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
@@ -1267,27 +1316,27 @@ static dc_status_t write_ostc3_settings(dc_device_t *device, DeviceDetails *m_de
 	};
 
 	//sp 1
-	rc = hw_ostc3_device_config_write(device, OSTC3_SP1, sp1Data, sizeof(sp1Data));
+	rc = ostc3_config_write(device, OSTC3_SP1, sp1Data, sizeof(sp1Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//sp 2
-	rc = hw_ostc3_device_config_write(device, OSTC3_SP2, sp2Data, sizeof(sp2Data));
+	rc = ostc3_config_write(device, OSTC3_SP2, sp2Data, sizeof(sp2Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//sp 3
-	rc = hw_ostc3_device_config_write(device, OSTC3_SP3, sp3Data, sizeof(sp3Data));
+	rc = ostc3_config_write(device, OSTC3_SP3, sp3Data, sizeof(sp3Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//sp 4
-	rc = hw_ostc3_device_config_write(device, OSTC3_SP4, sp4Data, sizeof(sp4Data));
+	rc = ostc3_config_write(device, OSTC3_SP4, sp4Data, sizeof(sp4Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//sp 5
-	rc = hw_ostc3_device_config_write(device, OSTC3_SP5, sp5Data, sizeof(sp5Data));
+	rc = ostc3_config_write(device, OSTC3_SP5, sp5Data, sizeof(sp5Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
@@ -1328,27 +1377,27 @@ static dc_status_t write_ostc3_settings(dc_device_t *device, DeviceDetails *m_de
 		m_deviceDetails->dil5.depth
 	};
 	//dil 1
-	rc = hw_ostc3_device_config_write(device, OSTC3_DIL1, dil1Data, sizeof(gas1Data));
+	rc = ostc3_config_write(device, OSTC3_DIL1, dil1Data, sizeof(gas1Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//dil 2
-	rc = hw_ostc3_device_config_write(device, OSTC3_DIL2, dil2Data, sizeof(dil2Data));
+	rc = ostc3_config_write(device, OSTC3_DIL2, dil2Data, sizeof(dil2Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//dil 3
-	rc = hw_ostc3_device_config_write(device, OSTC3_DIL3, dil3Data, sizeof(dil3Data));
+	rc = ostc3_config_write(device, OSTC3_DIL3, dil3Data, sizeof(dil3Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//dil 4
-	rc = hw_ostc3_device_config_write(device, OSTC3_DIL4, dil4Data, sizeof(dil4Data));
+	rc = ostc3_config_write(device, OSTC3_DIL4, dil4Data, sizeof(dil4Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 	//dil 5
-	rc = hw_ostc3_device_config_write(device, OSTC3_DIL5, dil5Data, sizeof(dil5Data));
+	rc = ostc3_config_write(device, OSTC3_DIL5, dil5Data, sizeof(dil5Data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
@@ -1363,7 +1412,7 @@ static dc_status_t write_ostc3_settings(dc_device_t *device, DeviceDetails *m_de
 #define WRITE_SETTING(_OSTC3_SETTING, _DEVICE_DETAIL)                                          \
 	do {                                                                                   \
 		data[0] = m_deviceDetails->_DEVICE_DETAIL;                                     \
-		rc = hw_ostc3_device_config_write(device, _OSTC3_SETTING, data, sizeof(data)); \
+		rc = ostc3_config_write(device, _OSTC3_SETTING, data, sizeof(data)); \
 		if (rc != DC_STATUS_SUCCESS)                                                   \
 			return rc;                                                             \
 		EMIT_PROGRESS();                                                               \
@@ -1411,14 +1460,14 @@ static dc_status_t write_ostc3_settings(dc_device_t *device, DeviceDetails *m_de
 
 	// OSTC3 stores the pressureSensorOffset in two-complement
 	data[0] = (unsigned char)m_deviceDetails->pressureSensorOffset;
-	rc = hw_ostc3_device_config_write(device, OSTC3_PRESSURE_SENSOR_OFFSET, data, sizeof(data));
+	rc = ostc3_config_write(device, OSTC3_PRESSURE_SENSOR_OFFSET, data, sizeof(data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
 
 	// OSTC3 stores the tempSensorOffset in two-complement
 	data[0] = (unsigned char)m_deviceDetails->tempSensorOffset;
-	rc = hw_ostc3_device_config_write(device, OSTC3_TEMP_SENSOR_OFFSET, data, sizeof(data));
+	rc = ostc3_config_write(device, OSTC3_TEMP_SENSOR_OFFSET, data, sizeof(data));
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 	EMIT_PROGRESS();
@@ -2216,6 +2265,7 @@ void FirmwareUpdateThread::run()
 		emit error("Error registering the event handler.");
 		return;
 	}
+	forget_settings();
 	switch (dc_device_get_type(m_data->device)) {
 	case DC_FAMILY_HW_OSTC3:
 		rc = hw_ostc3_device_fwupdate(m_data->device, qPrintable(m_fileName));
@@ -2242,6 +2292,7 @@ void ResetSettingsThread::run()
 {
 	dc_status_t rc = DC_STATUS_SUCCESS;
 
+	forget_settings();
 	if (dc_device_get_type(m_data->device) == DC_FAMILY_HW_OSTC3) {
 		rc = hw_ostc3_device_config_reset(m_data->device);
 		emit progress(100);
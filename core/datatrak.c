@@ -15,6 +15,7 @@
 #include "units.h"
 #include "device.h"
 #include "file.h"
+#include "bytereader.h"
 #include "divesite.h"
 #include "dive.h"
 #include "errorhelper.h"
@@ -88,12 +89,12 @@ static char *to_utf8(unsigned char *in_string)
  * dives; zero on error (meaning this isn't a datatrak file).
  * All other info in the header is useless for Subsurface.
  */
-static int read_file_header(unsigned char *buffer)
+static int read_file_header(struct byte_view file)
 {
 	int n = 0;
 
-	if (two_bytes_to_int(buffer[0], buffer[1]) == 0xA100)
-		n = two_bytes_to_int(buffer[7], buffer[6]);
+	if (byte_view_has(file, 0, 12) && two_bytes_to_int(file.data[0], file.data[1]) == 0xA100)
+		n = byte_view_u16le(file, 6);
 	return n;
 }
 
@@ -180,8 +181,10 @@ static unsigned char *dt_dive_parser(unsigned char *runner, struct dive *dt_dive
 	/*
 	 * Parse byte to byte till next dive entry
 	 */
+	CHECK(membuf, 2);
 	while (membuf[0] != 0xA0 || membuf[1] != 0x00) {
 		JUMP(membuf, 1);
+		CHECK(membuf, 2);
 	}
 	JUMP(membuf, 2);
 
@@ -539,6 +542,7 @@ static unsigned char *dt_dive_parser(unsigned char *runner, struct dive *dt_dive
 	 * Profile parsing, only if we have a profile and a dc model.
 	 * If just a profile, skip parsing and seek the buffer to the end of dive.
 	 */
+	CHECK(membuf, profile_length);
 	if (profile_length != 0 && libdc_model != 0) {
 		compl_buffer = (unsigned char *) calloc(18 + profile_length, 1);
 		rc = dt_libdc_buffer(membuf, profile_length, libdc_model, compl_buffer);
@@ -549,10 +553,10 @@ static unsigned char *dt_dive_parser(unsigned char *runner, struct dive *dt_dive
 			free(compl_buffer);
 			goto bail;
 		}
-		if (is_nitrox && dt_dive->cylinders.nr > 0)
+		if (is_nitrox && profile_length > 23 && dt_dive->cylinders.nr > 0)
 			get_cylinder(dt_dive, 0)->gasmix.o2.permille =
 					lrint(membuf[23] & 0x0F ? 20.0 + 2 * (membuf[23] & 0x0F) : 21.0) * 10;
-		if (is_O2 && dt_dive->cylinders.nr > 0)
+		if (is_O2 && profile_length > 23 && dt_dive->cylinders.nr > 0)
 			get_cylinder(dt_dive, 0)->gasmix.o2.permille = membuf[23] * 10;
 		free(compl_buffer);
 	}
@@ -584,14 +588,9 @@ bail:
  */
 static int wlog_header_parser (struct memblock *mem)
 {
-	int tmp;
-	unsigned char *runner = (unsigned char *) mem->buffer;
-	if (!runner)
-		return -1;
-	if (!memcmp(runner, "\x52\x02", 2)) {
-		runner += 8;
-		tmp = (int) two_bytes_to_int(runner[1], runner[0]);
-		return tmp;
+	struct byte_view file = byte_view_of(mem);
+	if (byte_view_has(file, 0, 12) && !memcmp(file.data, "\x52\x02", 2)) {
+		return (int) byte_view_u16le(file, 8);
 	} else {
 		fprintf(stderr, "Error, not a Wlog .add file\n");
 		return -1;
@@ -601,19 +600,24 @@ static int wlog_header_parser (struct memblock *mem)
 static void wlog_compl_parser(struct memblock *wl_mem, struct dive *dt_dive, int dcount)
 {
 	int strlong = 256, tmp = 0, offset = 12 + (dcount * 850),
-	    pos_weight =  offset + 256,
-	    pos_viz = offset + 258,
-	    pos_tank_init = offset + 266,
-	    pos_suit = offset + 268;
+	    pos_weight = 256,
+	    pos_viz = 258,
+	    pos_tank_init = 266,
+	    pos_suit = 268;
 	char *wlog_notes = NULL, *wlog_suit = NULL, *buffer = NULL;
-	unsigned char *runner = (unsigned char *) wl_mem->buffer;
+	struct byte_view entry = byte_view_sub(byte_view_of(wl_mem), offset, pos_suit + 26);
+	const unsigned char *runner = entry.data;
+
+	/* A truncated .add file: no extra data for this dive */
+	if (!runner)
+		return;
 
 	/*
 	 * Extended notes string. Fixed length 256 bytes. 0 padded if not complete
 	 */
-	if (*(runner + offset)) {
+	if (*runner) {
 		wlog_notes = calloc(strlong + 1, 1);
-		wlog_notes = memcpy(wlog_notes, runner + offset, 256);
+		wlog_notes = memcpy(wlog_notes, runner, 256);
 		wlog_notes = to_utf8((unsigned char *) wlog_notes);
 	}
 	if (dt_dive->notes && wlog_notes) {
@@ -662,7 +666,7 @@ static void wlog_compl_parser(struct memblock *wl_mem, struct dive *dt_dive, int
 	 */
 	strlong = 26;
 	if (*(runner + pos_suit)) {
-		wlog_suit = calloc(strlong, 1);
+		wlog_suit = calloc(strlong + 1, 1);
 		wlog_suit = memcpy(wlog_suit, runner + pos_suit, strlong);
 		wlog_suit = to_utf8((unsigned char *) wlog_suit);
 	}
@@ -684,7 +688,7 @@ int datatrak_import(struct memblock *mem, struct memblock *wl_mem, struct dive_t
 	long maxbuf = (long) mem->buffer + mem->size;
 
 	// Verify fileheader,  get number of dives in datatrak divelog, zero on error
-	numdives = read_file_header((unsigned char *)mem->buffer);
+	numdives = read_file_header(byte_view_of(mem));
 	if (!numdives) {
 		report_error(translate("gettextFromC", "[Error] File is not a DataTrak file. Aborted"));
 		goto bail;
@@ -694,8 +698,7 @@ int datatrak_import(struct memblock *mem, struct memblock *wl_mem, struct dive_t
 		int compl_dives_n = wlog_header_parser(wl_mem);
 		if (compl_dives_n != numdives) {
 			report_error("ERROR: Not the same number of dives in .log %d and .add file %d.\nWill not parse .add file", numdives , compl_dives_n);
-			free(wl_mem->buffer);
-			wl_mem->buffer = NULL;
+			free_memblock(wl_mem);
 			wl_mem = NULL;
 		}
 	}
@@ -188,34 +188,40 @@ static double solve_cubic2(double B, double C)
 
 // This is a simplified formula avoiding radii. It uses the fact that Boyle's law says
 // pV = (G + P_amb) / G^3 is constant to solve for the new gradient G.
+// The coefficient B only depends on the first gradient, not on the next stop.
 
-static double update_gradient(struct deco_state *ds, double next_stop_pressure, double first_gradient)
+static double gradient_coefficient(const struct deco_state *ds, double first_gradient)
 {
-	double B = cube(first_gradient) / (ds->first_ceiling_pressure.mbar / 1000.0 + first_gradient);
-	double C = next_stop_pressure * B;
+	return cube(first_gradient) / (ds->first_ceiling_pressure.mbar / 1000.0 + first_gradient);
+}
 
-	double new_gradient = solve_cubic2(B, C);
+static double solve_gradient(double B, double next_stop_pressure)
+{
+	double new_gradient = solve_cubic2(B, next_stop_pressure * B);
 
 	if (new_gradient < 0.0)
 		report_error("Negative gradient encountered!");
 	return new_gradient;
 }
 
-static double vpmb_tolerated_ambient_pressure(struct deco_state *ds, double reference_pressure, int ci)
+static double update_gradient(struct deco_state *ds, double next_stop_pressure, double first_gradient)
 {
-	double n2_gradient, he_gradient, total_gradient;
-
-	if (reference_pressure >= ds->first_ceiling_pressure.mbar / 1000.0 || !ds->first_ceiling_pressure.mbar) {
-		n2_gradient = ds->bottom_n2_gradient[ci];
-		he_gradient = ds->bottom_he_gradient[ci];
-	} else {
-		n2_gradient = update_gradient(ds, reference_pressure, ds->bottom_n2_gradient[ci]);
-		he_gradient = update_gradient(ds, reference_pressure, ds->bottom_he_gradient[ci]);
-	}
+	return solve_gradient(gradient_coefficient(ds, first_gradient), next_stop_pressure);
+}
 
-	total_gradient = ((n2_gradient * ds->tissue_n2_sat[ci]) + (he_gradient * ds->tissue_he_sat[ci])) / (ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci]);
+/*
+ * The per-compartment VPM-B kernels below work on whole arrays, with the
+ * loop invariant parts hoisted out, so that the arithmetic can be vectorized
+ * by the compiler. The library calls (pow, exp, ...) stay scalar.
+ */
+static void vpmb_tolerated_ambient_pressures(const struct deco_state *ds, const double n2_gradient[], const double he_gradient[], double tolerated[])
+{
+	int ci;
 
-	return ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci] + vpmb_config.other_gases_pressure - total_gradient;
+	for (ci = 0; ci < 16; ci++) {
+		double total_gradient = ((n2_gradient[ci] * ds->tissue_n2_sat[ci]) + (he_gradient[ci] * ds->tissue_he_sat[ci])) / (ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci]);
+		tolerated[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci] + vpmb_config.other_gases_pressure - total_gradient;
+	}
 }
 
 double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, double pressure)
@@ -270,19 +276,35 @@ double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, dou
 	} else {
 		// VPM-B ceiling
 		double reference_pressure;
+		double n2_coefficient[16], he_coefficient[16];
+		double n2_gradient[16], he_gradient[16];
+		double tolerated[16];
+
+		for (ci = 0; ci < 16; ci++) {
+			n2_coefficient[ci] = gradient_coefficient(ds, ds->bottom_n2_gradient[ci]);
+			he_coefficient[ci] = gradient_coefficient(ds, ds->bottom_he_gradient[ci]);
+		}
 
 		ret_tolerance_limit_ambient_pressure = pressure;
 		// The Boyle compensated gradient depends on ambient pressure. For the ceiling, this should set the ambient pressure.
 		do {
 			reference_pressure = ret_tolerance_limit_ambient_pressure;
 			ret_tolerance_limit_ambient_pressure = 0.0;
+			if (reference_pressure >= ds->first_ceiling_pressure.mbar / 1000.0 || !ds->first_ceiling_pressure.mbar) {
+				vpmb_tolerated_ambient_pressures(ds, ds->bottom_n2_gradient, ds->bottom_he_gradient, tolerated);
+			} else {
+				for (ci = 0; ci < 16; ci++) {
+					n2_gradient[ci] = solve_gradient(n2_coefficient[ci], reference_pressure);
+					he_gradient[ci] = solve_gradient(he_coefficient[ci], reference_pressure);
+				}
+				vpmb_tolerated_ambient_pressures(ds, n2_gradient, he_gradient, tolerated);
+			}
 			for (ci = 0; ci < 16; ci++) {
-				double tolerated = vpmb_tolerated_ambient_pressure(ds, reference_pressure, ci);
-				if (tolerated >= ret_tolerance_limit_ambient_pressure) {
+				if (tolerated[ci] >= ret_tolerance_limit_ambient_pressure) {
 					ds->ci_pointing_to_guiding_tissue = ci;
-					ret_tolerance_limit_ambient_pressure = tolerated;
+					ret_tolerance_limit_ambient_pressure = tolerated[ci];
 				}
-				ds->tolerated_by_tissue[ci] = tolerated;
+				ds->tolerated_by_tissue[ci] = tolerated[ci];
 			}
 		// We are doing ok if the gradient was computed within ten centimeters of the ceiling.
 		} while (fabs(ret_tolerance_limit_ambient_pressure - reference_pressure) > 0.01);
@@ -309,10 +331,8 @@ static double factor(int period_in_seconds, int ci, enum inertgas gas)
 		return 1.0 - exp(-period_in_seconds * 1.155245301e-02 / buehlmann_He_t_halflife[ci]);
 }
 
-static double calc_surface_phase(double surface_pressure, double he_pressure, double n2_pressure, double he_time_constant, double n2_time_constant)
+static double calc_surface_phase(double inspired_n2, double he_pressure, double n2_pressure, double he_time_constant, double n2_time_constant)
 {
-	double inspired_n2 = (surface_pressure - ((in_planner() && (decoMode() == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE)) * NITROGEN_FRACTION;
-
 	if (n2_pressure > inspired_n2)
 		return (he_pressure / he_time_constant + (n2_pressure - inspired_n2) / n2_time_constant) / (he_pressure + n2_pressure - inspired_n2);
 
@@ -338,21 +358,21 @@ void vpmb_start_gradient(struct deco_state *ds)
 void vpmb_next_gradient(struct deco_state *ds, double deco_time, double surface_pressure)
 {
 	int ci;
-	double n2_b, n2_c;
-	double he_b, he_c;
-	double desat_time;
+	double desat_time[16];
+	double inspired_n2 = (surface_pressure - ((in_planner() && (decoMode() == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE)) * NITROGEN_FRACTION;
+	double lambda_gamma = vpmb_config.crit_volume_lambda * vpmb_config.surface_tension_gamma;
+	double gamma_gamma_lambda = vpmb_config.surface_tension_gamma * vpmb_config.surface_tension_gamma * vpmb_config.crit_volume_lambda;
+	double gammac_gammac = vpmb_config.skin_compression_gammaC * vpmb_config.skin_compression_gammaC;
 	deco_time /= 60.0;
 
-	for (ci = 0; ci < 16; ++ci) {
-		desat_time = deco_time + calc_surface_phase(surface_pressure, ds->tissue_he_sat[ci], ds->tissue_n2_sat[ci], log(2.0) / buehlmann_He_t_halflife[ci], log(2.0) / buehlmann_N2_t_halflife[ci]);
-
-		n2_b = ds->initial_n2_gradient[ci] + (vpmb_config.crit_volume_lambda * vpmb_config.surface_tension_gamma) / (vpmb_config.skin_compression_gammaC * desat_time);
-		he_b = ds->initial_he_gradient[ci] + (vpmb_config.crit_volume_lambda * vpmb_config.surface_tension_gamma) / (vpmb_config.skin_compression_gammaC * desat_time);
+	for (ci = 0; ci < 16; ++ci)
+		desat_time[ci] = deco_time + calc_surface_phase(inspired_n2, ds->tissue_he_sat[ci], ds->tissue_n2_sat[ci], log(2.0) / buehlmann_He_t_halflife[ci], log(2.0) / buehlmann_N2_t_halflife[ci]);
 
-		n2_c = vpmb_config.surface_tension_gamma * vpmb_config.surface_tension_gamma * vpmb_config.crit_volume_lambda * ds->max_n2_crushing_pressure[ci];
-		n2_c = n2_c / (vpmb_config.skin_compression_gammaC * vpmb_config.skin_compression_gammaC * desat_time);
-		he_c = vpmb_config.surface_tension_gamma * vpmb_config.surface_tension_gamma * vpmb_config.crit_volume_lambda * ds->max_he_crushing_pressure[ci];
-		he_c = he_c / (vpmb_config.skin_compression_gammaC * vpmb_config.skin_compression_gammaC * desat_time);
+	for (ci = 0; ci < 16; ++ci) {
+		double n2_b = ds->initial_n2_gradient[ci] + lambda_gamma / (vpmb_config.skin_compression_gammaC * desat_time[ci]);
+		double he_b = ds->initial_he_gradient[ci] + lambda_gamma / (vpmb_config.skin_compression_gammaC * desat_time[ci]);
+		double n2_c = gamma_gamma_lambda * ds->max_n2_crushing_pressure[ci] / (gammac_gammac * desat_time[ci]);
+		double he_c = gamma_gamma_lambda * ds->max_he_crushing_pressure[ci] / (gammac_gammac * desat_time[ci]);
 
 		ds->bottom_n2_gradient[ci] = 0.5 * ( n2_b + sqrt(n2_b * n2_b - 4.0 * n2_c));
 		ds->bottom_he_gradient[ci] = 0.5 * ( he_b + sqrt(he_b * he_b - 4.0 * he_c));
@@ -385,14 +405,18 @@ void nuclear_regeneration(struct deco_state *ds, double time)
 {
 	time /= 60.0;
 	int ci;
-	double crushing_radius_N2, crushing_radius_He;
+	double crit_radius_N2 = get_crit_radius_N2();
+	double crit_radius_He = get_crit_radius_He();
+	double skin_tension = 2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma);
+	double regenerated = 1.0 - exp (-time / vpmb_config.regeneration_time);
+
 	for (ci = 0; ci < 16; ++ci) {
 		//rm
-		crushing_radius_N2 = 1.0 / (ds->max_n2_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_N2());
-		crushing_radius_He = 1.0 / (ds->max_he_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_He());
+		double crushing_radius_N2 = 1.0 / (ds->max_n2_crushing_pressure[ci] / skin_tension + 1.0 / crit_radius_N2);
+		double crushing_radius_He = 1.0 / (ds->max_he_crushing_pressure[ci] / skin_tension + 1.0 / crit_radius_He);
 		//rs
-		ds->n2_regen_radius[ci] = crushing_radius_N2 + (get_crit_radius_N2() - crushing_radius_N2) * (1.0 - exp (-time / vpmb_config.regeneration_time));
-		ds->he_regen_radius[ci] = crushing_radius_He + (get_crit_radius_He() - crushing_radius_He) * (1.0 - exp (-time / vpmb_config.regeneration_time));
+		ds->n2_regen_radius[ci] = crushing_radius_N2 + (crit_radius_N2 - crushing_radius_N2) * regenerated;
+		ds->he_regen_radius[ci] = crushing_radius_He + (crit_radius_He - crushing_radius_He) * regenerated;
 	}
 }
 
@@ -420,6 +444,8 @@ void calc_crushing_pressure(struct deco_state *ds, double pressure)
 	double gas_tension;
 	double n2_crushing_pressure, he_crushing_pressure;
 	double n2_inner_pressure, he_inner_pressure;
+	double crit_radius_N2 = get_crit_radius_N2();
+	double crit_radius_He = get_crit_radius_He();
 
 	for (ci = 0; ci < 16; ++ci) {
 		gas_tension = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci] + vpmb_config.other_gases_pressure;
@@ -432,8 +458,8 @@ void calc_crushing_pressure(struct deco_state *ds, double pressure)
 			if (ds->max_ambient_pressure >= pressure)
 				return;
 
-			n2_inner_pressure = calc_inner_pressure(get_crit_radius_N2(), ds->crushing_onset_tension[ci], pressure);
-			he_inner_pressure = calc_inner_pressure(get_crit_radius_He(), ds->crushing_onset_tension[ci], pressure);
+			n2_inner_pressure = calc_inner_pressure(crit_radius_N2, ds->crushing_onset_tension[ci], pressure);
+			he_inner_pressure = calc_inner_pressure(crit_radius_He, ds->crushing_onset_tension[ci], pressure);
 
 			n2_crushing_pressure = pressure - n2_inner_pressure;
 			he_crushing_pressure = pressure - he_inner_pressure;
@@ -444,6 +470,38 @@ void calc_crushing_pressure(struct deco_state *ds, double pressure)
 	ds->max_ambient_pressure = MAX(pressure, ds->max_ambient_pressure);
 }
 
+/*
+ * Get the saturation factors of all tissues for a segment length. The
+ * profile and the planner use only a handful of different lengths, so
+ * keep the last few in the deco state instead of calling exp() 32 times
+ * for every segment. A period of 0 seconds is never cached, so that the
+ * zeroed slots of a cleared deco state never match.
+ */
+static const double *get_factors(struct deco_state *ds, int period_in_seconds, const double **he_f)
+{
+	int i, ci;
+
+	if (period_in_seconds == 1) {
+		*he_f = buehlmann_He_factor_expositon_one_second;
+		return buehlmann_N2_factor_expositon_one_second;
+	}
+	for (i = 0; i < 4; i++) {
+		if (period_in_seconds && ds->factors[i].period_in_seconds == period_in_seconds) {
+			*he_f = ds->factors[i].he;
+			return ds->factors[i].n2;
+		}
+	}
+	i = ds->next_factors;
+	ds->next_factors = (i + 1) % 4;
+	ds->factors[i].period_in_seconds = period_in_seconds;
+	for (ci = 0; ci < 16; ci++) {
+		ds->factors[i].n2[ci] = factor(period_in_seconds, ci, N2);
+		ds->factors[i].he[ci] = factor(period_in_seconds, ci, HE);
+	}
+	*he_f = ds->factors[i].he;
+	return ds->factors[i].n2;
+}
+
 /* add period_in_seconds at the given pressure and gas to the deco calculation */
 void add_segment(struct deco_state *ds, double pressure, struct gasmix gasmix, int period_in_seconds, int ccpo2, enum divemode_t divemode, int sac)
 {
@@ -451,26 +509,34 @@ void add_segment(struct deco_state *ds, double pressure, struct gasmix gasmix, i
 	int ci;
 	struct gas_pressures pressures;
 	bool icd = false;
+	const double *n2_f, *he_f;
 	fill_pressures(&pressures, pressure - ((in_planner() && (decoMode() == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE),
 		       gasmix, (double) ccpo2 / 1000.0, divemode);
+	n2_f = get_factors(ds, period_in_seconds, &he_f);
 
-	for (ci = 0; ci < 16; ci++) {
+	// Report ICD if N2 is more on-gasing than He off-gasing in leading tissue
+	ci = ds->ci_pointing_to_guiding_tissue;
+	if (ci >= 0 && ci < 16) {
 		double pn2_oversat = pressures.n2 - ds->tissue_n2_sat[ci];
 		double phe_oversat = pressures.he - ds->tissue_he_sat[ci];
-		double n2_f = factor(period_in_seconds, ci, N2);
-		double he_f = factor(period_in_seconds, ci, HE);
 		double n2_satmult = pn2_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
 		double he_satmult = phe_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
 
-		// Report ICD if N2 is more on-gasing than He off-gasing in leading tissue
-		if (ci == ds->ci_pointing_to_guiding_tissue && pn2_oversat > 0.0 && phe_oversat < 0.0 &&
-		    pn2_oversat * n2_satmult * n2_f + phe_oversat * he_satmult * he_f > 0)
+		if (pn2_oversat > 0.0 && phe_oversat < 0.0 &&
+		    pn2_oversat * n2_satmult * n2_f[ci] + phe_oversat * he_satmult * he_f[ci] > 0)
 			icd = true;
+	}
 
-		ds->tissue_n2_sat[ci] += n2_satmult * pn2_oversat * n2_f;
-		ds->tissue_he_sat[ci] += he_satmult * phe_oversat * he_f;
-		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
+	/* No calls and no branches other than selects, so that the compiler can vectorize this */
+	for (ci = 0; ci < 16; ci++) {
+		double pn2_oversat = pressures.n2 - ds->tissue_n2_sat[ci];
+		double phe_oversat = pressures.he - ds->tissue_he_sat[ci];
+		double n2_satmult = pn2_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
+		double he_satmult = phe_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
 
+		ds->tissue_n2_sat[ci] += n2_satmult * pn2_oversat * n2_f[ci];
+		ds->tissue_he_sat[ci] += he_satmult * phe_oversat * he_f[ci];
+		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
 	}
 	if (decoMode() == VPMB)
 		calc_crushing_pressure(ds, pressure);
@@ -523,7 +589,17 @@ void clear_deco(struct deco_state *ds, double surface_pressure)
 	ds->ci_pointing_to_guiding_tissue = -1;
 }
 
-void cache_deco_state(struct deco_state *src, struct deco_state **cached_datap)
+/* The VPM-B state that is carried over when restoring with keep_vpmb_state */
+struct vpmb_gradients {
+	double bottom_n2[16];
+	double bottom_he[16];
+	double initial_n2[16];
+	double initial_he[16];
+	pressure_t first_ceiling_pressure;
+	pressure_t max_bottom_ceiling_pressure;
+};
+
+void cache_deco_state(const struct deco_state *src, struct deco_state **cached_datap)
 {
 	struct deco_state *data = *cached_datap;
 
@@ -534,21 +610,32 @@ void cache_deco_state(struct deco_state *src, struct deco_state **cached_datap)
 	*data = *src;
 }
 
-void restore_deco_state(struct deco_state *data, struct deco_state *target, bool keep_vpmb_state)
+/* The snapshot is left untouched, so that it can be restored repeatedly. Snapshots
+ * don't have to come from cache_deco_state(): in inner loops, a plain copy of the
+ * struct on the stack avoids the allocation. */
+void restore_deco_state(const struct deco_state *data, struct deco_state *target, bool keep_vpmb_state)
 {
 	if (keep_vpmb_state) {
-		int ci;
-		for (ci = 0; ci < 16; ci++) {
-			data->bottom_n2_gradient[ci] = target->bottom_n2_gradient[ci];
-			data->bottom_he_gradient[ci] = target->bottom_he_gradient[ci];
-			data->initial_n2_gradient[ci] = target->initial_n2_gradient[ci];
-			data->initial_he_gradient[ci] = target->initial_he_gradient[ci];
-		}
-		data->first_ceiling_pressure = target->first_ceiling_pressure;
-		data->max_bottom_ceiling_pressure = target->max_bottom_ceiling_pressure;
+		struct vpmb_gradients gradients;
+
+		memcpy(gradients.bottom_n2, target->bottom_n2_gradient, sizeof(gradients.bottom_n2));
+		memcpy(gradients.bottom_he, target->bottom_he_gradient, sizeof(gradients.bottom_he));
+		memcpy(gradients.initial_n2, target->initial_n2_gradient, sizeof(gradients.initial_n2));
+		memcpy(gradients.initial_he, target->initial_he_gradient, sizeof(gradients.initial_he));
+		gradients.first_ceiling_pressure = target->first_ceiling_pressure;
+		gradients.max_bottom_ceiling_pressure = target->max_bottom_ceiling_pressure;
+
+		*target = *data;
+
+		memcpy(target->bottom_n2_gradient, gradients.bottom_n2, sizeof(gradients.bottom_n2));
+		memcpy(target->bottom_he_gradient, gradients.bottom_he, sizeof(gradients.bottom_he));
+		memcpy(target->initial_n2_gradient, gradients.initial_n2, sizeof(gradients.initial_n2));
+		memcpy(target->initial_he_gradient, gradients.initial_he, sizeof(gradients.initial_he));
+		target->first_ceiling_pressure = gradients.first_ceiling_pressure;
+		target->max_bottom_ceiling_pressure = gradients.max_bottom_ceiling_pressure;
+	} else {
+		*target = *data;
 	}
-	*target = *data;
-
 }
 
 int deco_allowed_depth(double tissues_tolerance, double surface_pressure, const struct dive *dive, bool smooth)
@@ -588,6 +675,23 @@ void set_vpmb_conservatism(short conservatism)
 		vpmb_config.conservatism = conservatism;
 }
 
+/* A fingerprint of the parameters that clear_deco() and add_segment() depend on,
+ * so that callers can tell whether a saved tissue state is still valid. */
+uint64_t deco_parameters_hash(void)
+{
+	uint64_t hash = 14695981039346656037ull;
+	const unsigned char *p;
+	size_t i;
+	enum deco_mode mode = decoMode();
+
+	for (p = (const unsigned char *)&buehlmann_config, i = 0; i < sizeof(buehlmann_config); i++)
+		hash = (hash ^ p[i]) * 1099511628211ull;
+	for (p = (const unsigned char *)&vpmb_config, i = 0; i < sizeof(vpmb_config); i++)
+		hash = (hash ^ p[i]) * 1099511628211ull;
+	hash = (hash ^ (uint64_t)mode) * 1099511628211ull;
+	return hash;
+}
+
 double get_gf(struct deco_state *ds, double ambpressure_bar, const struct dive *dive)
 {
 	double surface_pressure_bar = get_surface_pressure_in_mbar(dive, true) / 1000.0;
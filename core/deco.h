@@ -45,6 +45,14 @@ struct deco_state {
 	long sumx, sumxx;
 	double sumy, sumxy;
 	int plot_depth;
+
+	/* Saturation factors of recently used segment lengths, see add_segment() */
+	struct {
+		int period_in_seconds;
+		double n2[16];
+		double he[16];
+	} factors[4];
+	int next_factors;
 };
 
 extern const double buehlmann_N2_t_halflife[];
@@ -56,8 +64,9 @@ extern void clear_deco(struct deco_state *ds, double surface_pressure);
 extern void dump_tissues(struct deco_state *ds);
 extern void set_gf(short gflow, short gfhigh);
 extern void set_vpmb_conservatism(short conservatism);
-extern void cache_deco_state(struct deco_state *source, struct deco_state **datap);
-extern void restore_deco_state(struct deco_state *data, struct deco_state *target, bool keep_vpmb_state);
+extern uint64_t deco_parameters_hash(void);
+extern void cache_deco_state(const struct deco_state *source, struct deco_state **datap);
+extern void restore_deco_state(const struct deco_state *data, struct deco_state *target, bool keep_vpmb_state);
 extern void nuclear_regeneration(struct deco_state *ds, double time);
 extern void vpmb_start_gradient(struct deco_state *ds);
 extern void vpmb_next_gradient(struct deco_state *ds, double deco_time, double surface_pressure);
@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: GPL-2.0
+/* decotable.c
+ *
+ * batch planning of deco tables, see decotable.h
+ */
+#include <string.h>
+#include "dive.h"
+#include "deco.h"
+#include "decotable.h"
+#include "gettext.h"
+#include "membuffer.h"
+#include "planner.h"
+#include "qthelper.h"
+
+struct decotable_job {
+	struct decotable_entry *entries;
+	const struct decotable_grid *grid;
+};
+
+/* Set up the plan just like the planner does for a dive with a single level */
+static void setup_decotable_plan(struct diveplan *diveplan, struct dive *dive, const struct decotable_grid *grid,
+				 const struct decotable_entry *entry)
+{
+	pressure_t deco_po2 = { prefs.decopo2 };
+	int descent_time;
+
+	diveplan->surface_pressure = grid->surface_pressure ? grid->surface_pressure : SURFACE_PRESSURE;
+	diveplan->salinity = grid->salinity ? grid->salinity : SEAWATER_SALINITY;
+	diveplan->gflow = entry->gf.low;
+	diveplan->gfhigh = entry->gf.high;
+	diveplan->vpmb_conservatism = prefs.vpmb_conservatism;
+	diveplan->bottomsac = prefs.bottomsac;
+	diveplan->decosac = prefs.decosac;
+	diveplan->skip_notes = true;
+
+	get_or_create_cylinder(dive, 0)->gasmix = entry->gas;
+	for (int i = 0; i < grid->nr_deco_gases; i++)
+		get_or_create_cylinder(dive, i + 1)->gasmix = grid->deco_gases[i];
+	reset_cylinders(dive, true);
+
+	for (int i = 0; i < grid->nr_deco_gases; i++)
+		plan_add_segment(diveplan, 0, gas_mod(grid->deco_gases[i], deco_po2, dive, M_OR_FT(3, 10)).mm, i + 1, 0, true, OC);
+	descent_time = entry->depth / prefs.descrate;
+	if (descent_time >= entry->bottom_time)
+		descent_time = entry->bottom_time;
+	plan_add_segment(diveplan, descent_time, entry->depth, 0, 0, true, OC);
+	plan_add_segment(diveplan, entry->bottom_time - descent_time, entry->depth, 0, 0, true, OC);
+}
+
+/* Every plan has its own dive, plan and deco state, so that they can be calculated in parallel */
+static void plan_decotable_entry(int idx, void *data)
+{
+	struct decotable_job *job = data;
+	struct decotable_entry *entry = &job->entries[idx];
+	struct diveplan diveplan = { 0 };
+	struct deco_state ds = { 0 };
+	struct deco_state *cache = NULL;
+	struct dive *dive = alloc_dive();
+
+	setup_decotable_plan(&diveplan, dive, job->grid, entry);
+	plan(&ds, &diveplan, dive, DECOTIMESTEP, entry->stops, &cache, true, false);
+	entry->runtime = dive->dc.duration.seconds;
+
+	free(cache);
+	free_dps(&diveplan);
+	free_dive(dive);
+}
+
+/*
+ * The gradient factors are global settings of the deco code, which plan() sets
+ * from the plan. Therefore, only the plans with the same gradient factors are
+ * calculated in parallel.
+ */
+void calculate_decotable(struct decotable *table, const struct decotable_grid *grid)
+{
+	int per_gf = grid->nr_gases * grid->nr_depths * grid->nr_times;
+	struct decotable_job job;
+	struct decotable_entry *entry;
+
+	free_decotable(table);
+	table->nr = grid->nr_gfs * per_gf;
+	if (!table->nr)
+		return;
+	table->entries = calloc(table->nr, sizeof(struct decotable_entry));
+	if (!table->entries)
+		exit(1);
+
+	entry = table->entries;
+	for (int gf = 0; gf < grid->nr_gfs; gf++) {
+		for (int gas = 0; gas < grid->nr_gases; gas++) {
+			for (int depth = 0; depth < grid->nr_depths; depth++) {
+				for (int time = 0; time < grid->nr_times; time++) {
+					entry->gf = grid->gfs[gf];
+					entry->gas = grid->gases[gas];
+					entry->depth = grid->depths[depth];
+					entry->bottom_time = grid->bottom_times[time];
+					entry++;
+				}
+			}
+		}
+	}
+
+	job.grid = grid;
+	for (int gf = 0; gf < grid->nr_gfs; gf++) {
+		job.entries = table->entries + gf * per_gf;
+		run_in_parallel(per_gf, plan_decotable_entry, &job);
+	}
+}
+
+void free_decotable(struct decotable *table)
+{
+	free(table->entries);
+	table->entries = NULL;
+	table->nr = 0;
+}
+
+static void put_depth_value(struct membuffer *b, int mm)
+{
+	const char *unit;
+	int frac;
+	double value = get_depth_units(mm, &frac, &unit);
+	put_format_loc(b, "%.*f", frac, value);
+}
+
+/* The stops as "depth/minutes", separated by spaces */
+static void put_stops(struct membuffer *b, const struct decotable_entry *entry)
+{
+	for (int i = 0; i < DECOTABLE_MAX_STOPS && entry->stops[i].depth > 0; i++) {
+		if (i)
+			put_string(b, " ");
+		put_depth_value(b, entry->stops[i].depth);
+		put_format(b, "/%d", (entry->stops[i].time + 59) / 60);
+	}
+}
+
+static const char *depth_unit_name(void)
+{
+	const char *unit;
+	get_depth_units(0, NULL, &unit);
+	return unit;
+}
+
+void decotable_to_csv(struct membuffer *b, const struct decotable *table)
+{
+	const char *unit = depth_unit_name();
+
+	put_format(b, "\"depth (%s)\",\"bottom time (min)\",\"gas\",\"GF low\",\"GF high\",\"runtime (min)\",\"stops (%s/min)\"\n", unit, unit);
+	for (int i = 0; i < table->nr; i++) {
+		const struct decotable_entry *entry = &table->entries[i];
+
+		put_string(b, "\"");
+		put_depth_value(b, entry->depth);
+		put_format(b, "\",\"%d\",\"%s\",\"%d\",\"%d\",\"%d\",\"", entry->bottom_time / 60, gasname(entry->gas),
+			   entry->gf.low, entry->gf.high, (entry->runtime + 59) / 60);
+		put_stops(b, entry);
+		put_string(b, "\"\n");
+	}
+}
+
+void decotable_to_html(struct membuffer *b, const struct decotable *table)
+{
+	const char *unit = depth_unit_name();
+
+	put_string(b, "<table>\n<tr>");
+	put_format(b, "<th>%s (%s)</th>", translate("gettextFromC", "Depth"), unit);
+	put_format(b, "<th>%s</th>", translate("gettextFromC", "Bottom time (min)"));
+	put_format(b, "<th>%s</th>", translate("gettextFromC", "Gas"));
+	put_format(b, "<th>%s</th>", translate("gettextFromC", "GF"));
+	put_format(b, "<th>%s</th>", translate("gettextFromC", "Runtime (min)"));
+	put_format(b, "<th>%s (%s/min)</th>", translate("gettextFromC", "Stops"), unit);
+	put_string(b, "</tr>\n");
+	for (int i = 0; i < table->nr; i++) {
+		const struct decotable_entry *entry = &table->entries[i];
+
+		put_string(b, "<tr><td>");
+		put_depth_value(b, entry->depth);
+		put_format(b, "</td><td>%d</td><td>%s</td><td>%d/%d</td><td>%d</td><td>", entry->bottom_time / 60, gasname(entry->gas),
+			   entry->gf.low, entry->gf.high, (entry->runtime + 59) / 60);
+		put_stops(b, entry);
+		put_string(b, "</td></tr>\n");
+	}
+	put_string(b, "</table>\n");
+}
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef DECOTABLE_H
+#define DECOTABLE_H
+
+#include "units.h"
+#include "planner.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct membuffer;
+
+/*
+ * Deco tables: the regular planner is run for every combination of depth,
+ * bottom time, bottom gas and gradient factors of a grid. Each dive descends
+ * at the planner's descent rate and stays at depth until the bottom time
+ * (counted from the start of the dive) is over. All deco gases are available
+ * from their MOD at the deco pO2 of the preferences.
+ *
+ * The plans use the deco model and the other planner preferences, like the
+ * planner does. For the results to be identical to the planner's, call this
+ * in the planner application state.
+ */
+#define DECOTABLE_MAX_STOPS 60
+
+struct decotable_gf {
+	short low, high;
+};
+
+struct decotable_grid {
+	int nr_depths;
+	const int *depths;			/* mm */
+	int nr_times;
+	const int *bottom_times;		/* seconds */
+	int nr_gases;
+	const struct gasmix *gases;		/* the bottom gases */
+	int nr_deco_gases;
+	const struct gasmix *deco_gases;
+	int nr_gfs;
+	const struct decotable_gf *gfs;		/* ignored for VPM-B */
+	int surface_pressure;			/* mbar, 0 for standard pressure */
+	int salinity;				/* 0 for salt water */
+};
+
+struct decotable_entry {
+	int depth;				/* mm */
+	int bottom_time;			/* seconds */
+	struct gasmix gas;
+	struct decotable_gf gf;
+	int runtime;				/* seconds */
+	struct decostop stops[DECOTABLE_MAX_STOPS];	/* as filled in by plan(), ends with depth 0 */
+};
+
+struct decotable {
+	int nr;
+	struct decotable_entry *entries;	/* ordered by gradient factors, gas, depth and time */
+};
+
+extern void calculate_decotable(struct decotable *table, const struct decotable_grid *grid);
+extern void free_decotable(struct decotable *table);
+extern void decotable_to_csv(struct membuffer *b, const struct decotable *table);
+extern void decotable_to_html(struct membuffer *b, const struct decotable *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DECOTABLE_H
@@ -239,16 +239,44 @@ bool DiveComputerNode::operator<(const DiveComputerNode &a) const
 	return std::tie(model, deviceId) < std::tie(a.model, a.deviceId);
 }
 
-const DiveComputerNode *DiveComputerList::getExact(const QString &m, uint32_t d)
+const DiveComputerNode *DiveComputerList::getExact(const QString &m, uint32_t d) const
 {
-	auto it = std::lower_bound(dcs.begin(), dcs.end(), DiveComputerNode{m, d, {}, {}, {}});
-	return it != dcs.end() && it->model == m && it->deviceId == d ? &*it : NULL;
+	auto it = exactIndex.find(qMakePair(m, d));
+	return it != exactIndex.end() ? &dcs.at(*it) : NULL;
 }
 
-const DiveComputerNode *DiveComputerList::get(const QString &m)
+const DiveComputerNode *DiveComputerList::get(const QString &m) const
 {
-	auto it = std::lower_bound(dcs.begin(), dcs.end(), DiveComputerNode{m, 0, {}, {}, {}});
-	return it != dcs.end() && it->model == m ? &*it : NULL;
+	auto it = modelIndex.find(m);
+	return it != modelIndex.end() ? &dcs.at(*it) : NULL;
+}
+
+const QVector<DiveComputerNode> &DiveComputerList::getDCs() const
+{
+	return dcs;
+}
+
+void DiveComputerList::setDCs(const QVector<DiveComputerNode> &newDcs)
+{
+	dcs = newDcs;
+	std::sort(dcs.begin(), dcs.end());
+	updateIndex();
+}
+
+void DiveComputerList::clear()
+{
+	dcs.clear();
+	updateIndex();
+}
+
+void DiveComputerList::updateIndex()
+{
+	exactIndex.clear();
+	modelIndex.clear();
+	for (int i = dcs.size() - 1; i >= 0; i--) {
+		exactIndex.insert(qMakePair(dcs[i].model, dcs[i].deviceId), i);
+		modelIndex.insert(dcs[i].model, i);	// going backwards, the first one of the model wins
+	}
 }
 
 void DiveComputerNode::showchanges(const QString &n, const QString &s, const QString &f) const
@@ -265,20 +293,24 @@ void DiveComputerList::addDC(QString m, uint32_t d, QString n, QString s, QStrin
 {
 	if (m.isEmpty() || d == 0)
 		return;
-	auto it = std::lower_bound(dcs.begin(), dcs.end(), DiveComputerNode{m, d, {}, {}, {}});
-	if (it != dcs.end() && it->model == m && it->deviceId == d) {
+	auto idx = exactIndex.find(qMakePair(m, d));
+	if (idx != exactIndex.end()) {
+		DiveComputerNode &node = dcs[*idx];
 		// debugging: show changes
 		if (verbose)
-			it->showchanges(n, s, f);
+			node.showchanges(n, s, f);
 		// Update any non-existent fields from the old entry
 		if (!n.isEmpty())
-			it->nickName = n;
+			node.nickName = n;
 		if (!s.isEmpty())
-			it->serialNumber = s;
+			node.serialNumber = s;
 		if (!f.isEmpty())
-			it->firmware = f;
+			node.firmware = f;
 	} else {
+		// New dive computers are rare, so simply rebuild the index
+		auto it = std::lower_bound(dcs.begin(), dcs.end(), DiveComputerNode{m, d, {}, {}, {}});
 		dcs.insert(it, DiveComputerNode{m, d, s, f, n});
+		updateIndex();
 	}
 }
 
@@ -289,7 +321,7 @@ extern "C" void create_device_node(const char *model, uint32_t deviceid, const c
 
 extern "C" void clear_device_nodes()
 {
-	dcList.dcs.clear();
+	dcList.clear();
 }
 
 static bool compareDCById(const DiveComputerNode &a, const DiveComputerNode &b)
@@ -300,7 +332,7 @@ static bool compareDCById(const DiveComputerNode &a, const DiveComputerNode &b)
 extern "C" void call_for_each_dc (void *f, void (*callback)(void *, const char *, uint32_t, const char *, const char *, const char *),
 				  bool select_only)
 {
-	QVector<DiveComputerNode> values = dcList.dcs;
+	QVector<DiveComputerNode> values = dcList.getDCs();
 	std::sort(values.begin(), values.end(), compareDCById);
 	for (const DiveComputerNode &node : values) {
 		bool found = false;
@@ -24,6 +24,8 @@ extern void clear_device_nodes();
 // Functions and global variables that are only available to C++ code
 #ifdef __cplusplus
 
+#include <QHash>
+#include <QPair>
 #include <QString>
 #include <QVector>
 class DiveComputerNode {
@@ -41,12 +43,22 @@ public:
 
 class DiveComputerList {
 public:
-	const DiveComputerNode *getExact(const QString &m, uint32_t d);
-	const DiveComputerNode *get(const QString &m);
+	const DiveComputerNode *getExact(const QString &m, uint32_t d) const;
+	const DiveComputerNode *get(const QString &m) const;
 	void addDC(QString m, uint32_t d, QString n = QString(), QString s = QString(), QString f = QString());
+	const QVector<DiveComputerNode> &getDCs() const;
+	void setDCs(const QVector<DiveComputerNode> &dcs);
+	void clear();
+
+private:
+	void updateIndex();
 
 	// Keep the dive computers in a vector sorted by (model, deviceId)
 	QVector<DiveComputerNode> dcs;
+	// The nicknames are looked up for every dive: index of each
+	// (model, deviceId) in dcs and of the first entry of each model
+	QHash<QPair<QString, uint32_t>, int> exactIndex;
+	QHash<QString, int> modelIndex;
 };
 
 QString get_dc_nickname(const struct divecomputer *dc);
@@ -8,6 +8,9 @@
 extern "C" {
 #endif
 
+struct deco_checkpoint;
+struct plot_tissue_data;
+
 /* Plot info with smoothing, velocity indication
  * and one-, two- and three-minute minimums and maximums */
 struct plot_info {
@@ -23,6 +26,9 @@ struct plot_info {
 	double maxpp;
 	struct plot_data *entry;
 	struct plot_pressure_data *pressures; /* cylinders.nr blocks of nr entries. */
+	struct plot_tissue_data *tissues; /* nr entries, NULL if not requested */
+	int nr_deco_checkpoints;
+	struct deco_checkpoint *deco_checkpoints; /* saved deco states, see calculate_deco_information() */
 };
 
 extern struct divecomputer *select_dc(struct dive *);
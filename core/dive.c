@@ -20,6 +20,11 @@
 #include "trip.h"
 #include "structured_list.h"
 #include "fulltext.h"
+#include "samplecolumns.h"
+#include "arena.h"
+#include "memusage.h"
+#include "stringpool.h"
+#include "trace.h"
 
 
 /* one could argue about the best place to have this variable -
@@ -38,7 +43,7 @@ const char *divemode_text_ui[] = {
 // For writing/reading files.
 const char *divemode_text[] = {"OC", "CCR", "PSCR", "Freedive"};
 
-static int calculate_depth_to_mbar(int depth, pressure_t surface_pressure, int salinity);
+static struct pressure_conversion calculate_pressure_conversion(pressure_t surface_pressure, int salinity);
 
 /*
  * Adding a cylinder pressure sample field is not quite as trivial as it
@@ -134,16 +139,17 @@ bool event_is_divemodechange(const struct event *ev)
 	return same_string(ev->name, "modechange");
 }
 
-struct event *create_event(unsigned int time, int type, int flags, int value, const char *name)
+struct event *create_event_in_arena(struct arena *arena, unsigned int time, int type, int flags, int value, const char *name)
 {
 	int gas_index = -1;
 	struct event *ev;
 	unsigned int size, len = strlen(name);
 
 	size = sizeof(*ev) + len + 1;
-	ev = malloc(size);
+	ev = arena_alloc(arena, size);
 	if (!ev)
 		return NULL;
+	memusage_count_alloc(MEM_EVENTS, size);
 	memset(ev, 0, size);
 	memcpy(ev->name, name, len);
 	ev->time.seconds = time;
@@ -175,6 +181,11 @@ struct event *create_event(unsigned int time, int type, int flags, int value, co
 	return ev;
 }
 
+struct event *create_event(unsigned int time, int type, int flags, int value, const char *name)
+{
+	return create_event_in_arena(NULL, time, type, flags, value, name);
+}
+
 /* warning: does not test idx for validity */
 struct event *create_gas_switch_event(struct dive *dive, struct divecomputer *dc, int seconds, int idx)
 {
@@ -213,9 +224,10 @@ void add_event_to_dc(struct divecomputer *dc, struct event *ev)
 	*p = ev;
 }
 
-struct event *add_event(struct divecomputer *dc, unsigned int time, int type, int flags, int value, const char *name)
+/* Loaders pass an arena for the events, NULL means malloc() */
+struct event *add_event_to_arena(struct arena *arena, struct divecomputer *dc, unsigned int time, int type, int flags, int value, const char *name)
 {
-	struct event *ev = create_event(time, type, flags, value, name);
+	struct event *ev = create_event_in_arena(arena, time, type, flags, value, name);
 
 	if (!ev)
 		return NULL;
@@ -226,6 +238,11 @@ struct event *add_event(struct divecomputer *dc, unsigned int time, int type, in
 	return ev;
 }
 
+struct event *add_event(struct divecomputer *dc, unsigned int time, int type, int flags, int value, const char *name)
+{
+	return add_event_to_arena(NULL, dc, time, type, flags, value, name);
+}
+
 void add_gas_switch_event(struct dive *dive, struct divecomputer *dc, int seconds, int idx)
 {
 	/* sanity check so we don't crash */
@@ -298,24 +315,31 @@ void update_event_name(struct dive *d, struct event *event, const char *name)
 	remove = *removep;
 	*removep = (*removep)->next;
 	add_event(dc, event->time.seconds, event->type, event->flags, event->value, name);
-	free(remove);
+	free_event(remove);
 	invalidate_dive_cache(d);
 }
 
-void add_extra_data(struct divecomputer *dc, const char *key, const char *value)
+void add_extra_data_to_arena(struct arena *arena, struct divecomputer *dc, const char *key, const char *value)
 {
 	struct extra_data **ed = &dc->extra_data;
 
 	while (*ed)
 		ed = &(*ed)->next;
-	*ed = malloc(sizeof(struct extra_data));
+	*ed = arena_alloc(arena, sizeof(struct extra_data));
 	if (*ed) {
-		(*ed)->key = strdup(key);
-		(*ed)->value = strdup(value);
+		memusage_count_alloc(MEM_EXTRA_DATA, sizeof(struct extra_data) + (key ? strlen(key) + 1 : 0) + (value ? strlen(value) + 1 : 0));
+		/* The keys are the same few strings for all dives */
+		(*ed)->key = intern_string(key);
+		(*ed)->value = arena_strdup(arena, value);
 		(*ed)->next = NULL;
 	}
 }
 
+void add_extra_data(struct divecomputer *dc, const char *key, const char *value)
+{
+	add_extra_data_to_arena(NULL, dc, key, value);
+}
+
 /* Find the divemode at time 'time' (in seconds) into the dive. Sequentially step through the divemode-change events,
  * saving the dive mode for each event. When the events occur AFTER 'time' seconds, the last stored divemode
  * is returned. This function is self-tracking, relying on setting the event pointer 'evp' so that, in each iteration
@@ -380,7 +404,7 @@ static void free_dc_contents(struct divecomputer *dc);
 /* copy an element in a list of dive computer extra data */
 static void copy_extra_data(struct extra_data *sed, struct extra_data *ded)
 {
-	ded->key = copy_string(sed->key);
+	ded->key = intern_string(sed->key);
 	ded->value = copy_string(sed->value);
 }
 
@@ -389,6 +413,7 @@ static void copy_extra_data(struct extra_data *sed, struct extra_data *ded)
 static void copy_dc(const struct divecomputer *sdc, struct divecomputer *ddc)
 {
 	*ddc = *sdc;
+	ddc->sample_reload_repo = 0;
 	ddc->model = copy_string(sdc->model);
 	ddc->serial = copy_string(sdc->serial);
 	ddc->fw_version = copy_string(sdc->fw_version);
@@ -429,11 +454,11 @@ static void free_dive_structures(struct dive *d)
 	if (!d)
 		return;
 	fulltext_unregister(d);
-	/* free the strings */
-	free(d->buddy);
-	free(d->divemaster);
-	free(d->notes);
-	free(d->suit);
+	/* free the strings - these may have been loaded into the logbook arena */
+	arena_free(d->buddy);
+	arena_free(d->divemaster);
+	arena_free(d->notes);
+	arena_free(d->suit);
 	/* free tags, additional dive computers, and pictures */
 	taglist_free(d->tag_list);
 	free_dive_dcs(&d->dc);
@@ -477,7 +502,10 @@ static void copy_dive_nodc(const struct dive *s, struct dive *d)
 	memset(&d->weightsystems, 0, sizeof(d->weightsystems));
 	memset(&d->pictures, 0, sizeof(d->pictures));
 	d->full_text = NULL;
-	invalidate_dive_cache(d);
+	/* Don't use invalidate_dive_cache(): the copy is not part of the trip */
+	memset(d->git_id, 0, 20);
+	/* Copies are usually made to be edited */
+	d->gas_valid = false;
 	d->buddy = copy_string(s->buddy);
 	d->divemaster = copy_string(s->divemaster);
 	d->notes = copy_string(s->notes);
@@ -490,6 +518,7 @@ static void copy_dive_nodc(const struct dive *s, struct dive *d)
 
 void copy_dive(const struct dive *s, struct dive *d)
 {
+	load_sample_blobs(s);
 	copy_dive_nodc(s, d);
 
 	// Copy the first dc explicitly, then the list of subsequent dc's
@@ -499,6 +528,7 @@ void copy_dive(const struct dive *s, struct dive *d)
 
 static void copy_dive_onedc(const struct dive *s, const struct divecomputer *sdc, struct dive *d)
 {
+	load_sample_blobs(s);
 	copy_dive_nodc(s, d);
 	copy_dc(sdc, &d->dc);
 	d->dc.next = NULL;
@@ -556,6 +586,7 @@ struct event *clone_event(const struct event *src_ev)
 	ev = (struct event*) malloc(size);
 	if (!ev)
 		exit(1);
+	memusage_count_alloc(MEM_EVENTS, size);
 	memcpy(ev, src_ev, size);
 	ev->next = NULL;
 
@@ -634,9 +665,11 @@ void copy_samples(const struct divecomputer *s, struct divecomputer *d)
 	 * over and over again, let's just copy the whole blob */
 	if (!s || !d)
 		return;
-	int nr = s->samples;
+	/* Packed samples are shared with the copy */
+	int nr = s->packed_samples ? 0 : s->samples;
 	d->samples = nr;
 	d->alloc_samples = nr;
+	share_packed_samples(s, d);
 	// We expect to be able to read the memory in the other end of the pointer
 	// if its a valid pointer, so don't expect malloc() to return NULL for
 	// zero-sized malloc, do it ourselves.
@@ -646,8 +679,11 @@ void copy_samples(const struct divecomputer *s, struct divecomputer *d)
 		return;
 
 	d->sample = malloc(nr * sizeof(struct sample));
-	if (d->sample)
+	if (!d->sample)
+		d->samples = d->alloc_samples = 0;
+	else
 		memcpy(d->sample, s->sample, nr * sizeof(struct sample));
+	memusage_count_alloc(MEM_SAMPLES, nr * sizeof(struct sample));
 }
 
 /* make room for num samples; if not enough space is available, the sample
@@ -659,6 +695,7 @@ void alloc_samples(struct divecomputer *dc, int num)
 		dc->sample = realloc(dc->sample, dc->alloc_samples * sizeof(struct sample));
 		if (!dc->sample)
 			dc->samples = dc->alloc_samples = 0;
+		memusage_count_alloc(MEM_SAMPLES, dc->alloc_samples * sizeof(struct sample));
 	}
 }
 
@@ -996,6 +1033,7 @@ void update_setpoint_events(const struct dive *dive, struct divecomputer *dc)
 		struct gasmix gasmix = get_gasmix_from_event(dive, ev);
 		const struct event *next = get_next_event(ev, "gaschange");
 
+		struct pressure_conversion conv = calculate_pressure_conversion(dc->surface_pressure, 0);
 		for (int i = 0; i < dc->samples; i++) {
 			struct gas_pressures pressures;
 			if (next && dc->sample[i].time.seconds >= next->time.seconds) {
@@ -1003,7 +1041,7 @@ void update_setpoint_events(const struct dive *dive, struct divecomputer *dc)
 				gasmix = get_gasmix_from_event(dive, ev);
 				next = get_next_event(ev, "gaschange");
 			}
-			fill_pressures(&pressures, calculate_depth_to_mbar(dc->sample[i].depth.mm, dc->surface_pressure, 0), gasmix ,0, dc->divemode);
+			fill_pressures(&pressures, conv_depth_to_mbar(&conv, dc->sample[i].depth.mm), gasmix ,0, dc->divemode);
 			if (abs(dc->sample[i].setpoint.mbar - (int)(1000 * pressures.o2)) <= 50)
 				dc->sample[i].setpoint.mbar = 0;
 		}
@@ -1119,22 +1157,6 @@ static bool is_potentially_redundant(const struct event *event)
 	return true;
 }
 
-/* match just by name - we compare the details in the code that uses this helper */
-static struct event *find_previous_event(struct divecomputer *dc, struct event *event)
-{
-	struct event *ev = dc->events;
-	struct event *previous = NULL;
-
-	if (empty_string(event->name))
-		return NULL;
-	while (ev && ev != event) {
-		if (same_string(ev->name, event->name))
-			previous = ev;
-		ev = ev->next;
-	}
-	return previous;
-}
-
 pressure_t calculate_surface_pressure(const struct dive *dive)
 {
 	const struct divecomputer *dc;
@@ -1294,12 +1316,35 @@ static temperature_t un_fixup_airtemp(const struct dive *a)
 static void fixup_dc_events(struct divecomputer *dc)
 {
 	struct event *event;
+	/*
+	 * The previous event of the same name, for each name seen so far.
+	 * There are only a handful of different event names per dive computer,
+	 * so this avoids rescanning the list from the head for every event.
+	 */
+	struct event **last = NULL;
+	int nr_last = 0, allocated_last = 0;
 
 	event = dc->events;
 	while (event) {
-		struct event *prev;
-		if (is_potentially_redundant(event)) {
-			prev = find_previous_event(dc, event);
+		struct event *prev = NULL;
+		int i;
+		if (is_potentially_redundant(event) && !empty_string(event->name)) {
+			for (i = 0; i < nr_last; i++) {
+				if (same_string(last[i]->name, event->name))
+					break;
+			}
+			if (i < nr_last) {
+				prev = last[i];
+			} else {
+				if (nr_last >= allocated_last) {
+					allocated_last = (nr_last + 8) * 3 / 2;
+					last = realloc(last, allocated_last * sizeof(*last));
+					if (!last)
+						exit(1);
+				}
+				nr_last++;
+			}
+			last[i] = event;
 			if (prev && prev->value == event->value &&
 			    prev->flags == event->flags &&
 			    event->time.seconds - prev->time.seconds < 61)
@@ -1307,11 +1352,12 @@ static void fixup_dc_events(struct divecomputer *dc)
 		}
 		event = event->next;
 	}
+	free(last);
 	event = dc->events;
 	while (event) {
 		if (event->next && event->next->deleted) {
 			struct event *nextnext = event->next->next;
-			free(event->next);
+			free_event(event->next);
 			event->next = nextnext;
 		} else {
 			event = event->next;
@@ -1593,10 +1639,6 @@ static void fixup_no_o2sensors(struct divecomputer *dc)
 
 static void fixup_dive_dc(struct dive *dive, struct divecomputer *dc)
 {
-	/* Add device information to table */
-	if (dc->deviceid && (dc->serial || dc->fw_version))
-		create_device_node(dc->model, dc->deviceid, dc->serial, dc->fw_version, "");
-
 	/* Fixup duration and mean depth */
 	fixup_dc_duration(dc);
 
@@ -1621,7 +1663,34 @@ static void fixup_dive_dc(struct dive *dive, struct divecomputer *dc)
 	fixup_no_o2sensors(dc);
 }
 
-struct dive *fixup_dive(struct dive *dive)
+/*
+ * The people, suit and equipment descriptions are shared by many dives,
+ * so let them use the pooled copies. The fields are freed with arena_free(),
+ * which leaves the pool alone.
+ */
+static void intern_dive_strings(struct dive *dive)
+{
+	int i;
+
+	dive->buddy = (char *)intern_and_free(dive->buddy);
+	dive->divemaster = (char *)intern_and_free(dive->divemaster);
+	dive->suit = (char *)intern_and_free(dive->suit);
+	for (i = 0; i < dive->cylinders.nr; i++) {
+		cylinder_t *cyl = get_cylinder(dive, i);
+		cyl->type.description = intern_and_free(cyl->type.description);
+	}
+	for (i = 0; i < dive->weightsystems.nr; i++) {
+		weightsystem_t *ws = &dive->weightsystems.weightsystems[i];
+		ws->description = intern_and_free(ws->description);
+	}
+}
+
+/*
+ * The part of fixup_dive() that only reads and writes the dive itself.
+ * Loaders may run it for many dives in parallel and then call
+ * fixup_dive_finish() for every dive in one thread.
+ */
+void fixup_dive_data(struct dive *dive)
 {
 	int i;
 	struct divecomputer *dc;
@@ -1648,12 +1717,31 @@ struct dive *fixup_dive(struct dive *dive)
 	fixup_airtemp(dive);
 	for (i = 0; i < dive->cylinders.nr; i++) {
 		cylinder_t *cyl = get_cylinder(dive, i);
-		add_cylinder_description(&cyl->type);
 		if (same_rounded_pressure(cyl->sample_start, cyl->start))
 			cyl->start.mbar = 0;
 		if (same_rounded_pressure(cyl->sample_end, cyl->end))
 			cyl->end.mbar = 0;
 	}
+}
+
+/*
+ * The part of fixup_dive() that registers devices and equipment descriptions
+ * in global tables and calculates the CNS, which depends on the previous
+ * dives of the dive table.
+ */
+struct dive *fixup_dive_finish(struct dive *dive)
+{
+	int i;
+	struct divecomputer *dc;
+
+	/* Add device information to table */
+	for_each_dc (dive, dc) {
+		if (dc->deviceid && (dc->serial || dc->fw_version))
+			create_device_node(dc->model, dc->deviceid, dc->serial, dc->fw_version, "");
+	}
+	intern_dive_strings(dive);
+	for (i = 0; i < dive->cylinders.nr; i++)
+		add_cylinder_description(&get_cylinder(dive, i)->type);
 	update_cylinder_related_info(dive);
 	for (i = 0; i < dive->weightsystems.nr; i++) {
 		weightsystem_t *ws = &dive->weightsystems.weightsystems[i];
@@ -1667,6 +1755,15 @@ struct dive *fixup_dive(struct dive *dive)
 	return dive;
 }
 
+struct dive *fixup_dive(struct dive *dive)
+{
+	TRACE_BEGIN("fixup_dive");
+	fixup_dive_data(dive);
+	dive = fixup_dive_finish(dive);
+	TRACE_END();
+	return dive;
+}
+
 /* Don't pick a zero for MERGE_MIN() */
 #define MERGE_MAX(res, a, b, n) res->n = MAX(a->n, b->n)
 #define MERGE_MIN(res, a, b, n) res->n = (a->n) ? (b->n) ? MIN(a->n, b->n) : (a->n) : (b->n)
@@ -2438,6 +2535,12 @@ static struct dive_trip *get_preferred_trip(const struct dive *a, const struct d
 	return btrip;
 }
 
+/*
+ * The sample alignment below is not compiled: merge_dives() is always called
+ * with the offset implied by the start times of the dives. Should it be
+ * revived, note that sample_difference() only compares the first two minutes
+ * of samples, so trying all offsets of the window is cheap.
+ */
 #if CURRENTLY_NOT_USED
 /*
  * Sample 's' is between samples 'a' and 'b'. It is 'offset' seconds before 'b'.
@@ -2783,24 +2886,102 @@ struct dive *try_to_merge(struct dive *a, struct dive *b, bool prefer_downloaded
 	return res;
 }
 
+/*
+ * The largest time difference at which likely_same_dive() could consider
+ * a dive of the duration of d the same as another dive: the other dive
+ * has to have a similar() duration, and half the longer duration is the
+ * allowed difference.
+ */
+static int max_same_dive_fuzz(const struct dive *d)
+{
+	int duration = d->duration.seconds;
+	int longest = MAX(duration + 5 * 60, duration * 10 / 9 + 1);
+
+	return MAX(longest / 2, 60);
+}
+
+static int dive_time_cmp(const void *_a, const void *_b)
+{
+	const struct dive *a = *(const struct dive **)_a;
+	const struct dive *b = *(const struct dive **)_b;
+
+	return a->when < b->when ? -1 : a->when > b->when;
+}
+
+/*
+ * Find the pairs of dives of a table that try_to_merge() would merge,
+ * i.e. the same dive imported from two dive computers or two files.
+ * Unlike on import, the dives don't have to be adjacent. The dives are
+ * sorted by start time, and every dive is only compared to the dives that
+ * start within the time fuzz of likely_same_dive(). For real logbooks that
+ * is a handful of dives, so this stays close to linear.
+ *
+ * Returns the number of pairs. *pairs is set to an array of twice as many
+ * dives, the earlier dive of each pair first, which the caller has to free.
+ */
+int find_duplicate_dives(const struct dive_table *table, struct dive ***pairs)
+{
+	struct dive **sorted, **res = NULL;
+	int i, j, nr = 0, allocated = 0;
+
+	*pairs = NULL;
+	if (table->nr < 2)
+		return 0;
+	sorted = malloc(table->nr * sizeof(struct dive *));
+	if (!sorted)
+		return 0;
+	memcpy(sorted, table->dives, table->nr * sizeof(struct dive *));
+	qsort(sorted, table->nr, sizeof(struct dive *), dive_time_cmp);
+
+	for (i = 0; i < table->nr; i++) {
+		struct dive *a = sorted[i];
+		timestamp_t last = a->when + max_same_dive_fuzz(a);
+
+		for (j = i + 1; j < table->nr && sorted[j]->when <= last; j++) {
+			if (!likely_same_dive(a, sorted[j]))
+				continue;
+			if (nr >= allocated) {
+				allocated = (allocated + 8) * 3 / 2;
+				res = realloc(res, allocated * 2 * sizeof(struct dive *));
+				if (!res)
+					exit(1);
+			}
+			res[nr * 2] = a;
+			res[nr * 2 + 1] = sorted[j];
+			nr++;
+		}
+	}
+	free(sorted);
+	*pairs = res;
+	return nr;
+}
+
+/* Events may come from the logbook arena - use this instead of free() */
+void free_event(struct event *ev)
+{
+	arena_free(ev);
+}
+
 void free_events(struct event *ev)
 {
 	while (ev) {
 		struct event *next = ev->next;
-		free(ev);
+		free_event(ev);
 		ev = next;
 	}
 }
 
 static void free_extra_data(struct extra_data *ed)
 {
-	free((void *)ed->key);
-	free((void *)ed->value);
+	arena_free((void *)ed->key);
+	arena_free((void *)ed->value);
+	arena_free(ed);
 }
 
 static void free_dc_contents(struct divecomputer *dc)
 {
 	free(dc->sample);
+	free_packed_samples(dc);
 	free((void *)dc->model);
 	free((void *)dc->serial);
 	free((void *)dc->fw_version);
@@ -2916,6 +3097,7 @@ static void copy_dive_computer(struct divecomputer *res, const struct divecomput
 	STRUCTURED_LIST_COPY(struct extra_data, a->extra_data, res->extra_data, copy_extra_data);
 	res->samples = res->alloc_samples = 0;
 	res->sample = NULL;
+	res->packed_samples = NULL;
 	res->events = NULL;
 	res->next = NULL;
 }
@@ -3050,6 +3232,9 @@ struct dive *merge_dives(const struct dive *a, const struct dive *b, int offset,
 	struct dive *res = alloc_dive();
 	int *cylinders_map_a, *cylinders_map_b;
 
+	load_samples(a);
+	load_samples(b);
+
 	if (offset) {
 		/*
 		 * If "likely_same_dive()" returns true, that means that
@@ -3248,7 +3433,7 @@ static int split_dive_at(const struct dive *dive, int a, int b, struct dive **ou
 		*evp = NULL;
 		while (event) {
 			struct event *next = event->next;
-			free(event);
+			free_event(event);
 			event = next;
 		}
 
@@ -3257,7 +3442,7 @@ static int split_dive_at(const struct dive *dive, int a, int b, struct dive **ou
 		while ((event = *evp) != NULL) {
 			if (event->time.seconds < t) {
 				*evp = event->next;
-				free(event);
+				free_event(event);
 			} else {
 				event->time.seconds -= t;
 			}
@@ -3315,6 +3500,7 @@ int split_dive(const struct dive *dive, struct dive **new1, struct dive **new2)
 	if (!dive)
 		return -1;
 
+	load_samples(dive);
 	dc = &dive->dc;
 	surface_start = 0;
 	at_surface = 1;
@@ -3355,6 +3541,7 @@ int split_dive_at_time(const struct dive *dive, duration_t time, struct dive **n
 	if (!dive)
 		return -1;
 
+	load_samples(dive);
 	struct sample *sample = dive->dc.sample;
 	*new1 = *new2 = NULL;
 	while(sample->time.seconds < time.seconds) {
@@ -3654,9 +3841,25 @@ fraction_t best_he(depth_t depth, const struct dive *dive, bool o2narcotic, frac
 	return fhe;
 }
 
+/* Incremented whenever a dive changes, so caches of data derived from
+ * more than one dive (such as the profile) can tell that they are stale */
+unsigned int dive_data_generation;
+
+/* The trip tree contains the dive, so it has to be written again, too */
 void invalidate_dive_cache(struct dive *dive)
 {
+	struct divecomputer *dc;
+
 	memset(dive->git_id, 0, 20);
+	/* The samples may have changed and can't be reloaded from the repository */
+	for_each_dc (dive, dc)
+		dc->sample_reload_repo = 0;
+	invalidate_deco_cache(dive);
+	dive->derived_valid = false;
+	dive->gas_valid = false;
+	dive_data_generation++;
+	if (dive->divetrip)
+		invalidate_trip_cache(dive->divetrip);
 }
 
 bool dive_cache_is_valid(const struct dive *dive)
@@ -3686,20 +3889,30 @@ static double salinity_to_specific_weight(int salinity)
 /* Pa = N/m^2 - so we determine the weight (in N) of the mass of 10m
  * of water (and use standard salt water at 1.03kg per liter if we don't know salinity)
  * and add that to the surface pressure (or to 1013 if that's unknown) */
-static int calculate_depth_to_mbar(int depth, pressure_t surface_pressure, int salinity)
+static struct pressure_conversion calculate_pressure_conversion(pressure_t surface_pressure, int salinity)
 {
-	double specific_weight;
-	int mbar = surface_pressure.mbar;
+	struct pressure_conversion conv;
 
-	if (!mbar)
-		mbar = SURFACE_PRESSURE;
+	conv.surface_mbar = surface_pressure.mbar;
+	if (!conv.surface_mbar)
+		conv.surface_mbar = SURFACE_PRESSURE;
 	if (!salinity)
 		salinity = SEAWATER_SALINITY;
 	if (salinity < 500)
 		salinity += FRESHWATER_SALINITY;
-	specific_weight = salinity_to_specific_weight(salinity);
-	mbar += lrint(depth * specific_weight);
-	return mbar;
+	conv.mbar_per_mm = salinity_to_specific_weight(salinity);
+	return conv;
+}
+
+static int calculate_depth_to_mbar(int depth, pressure_t surface_pressure, int salinity)
+{
+	struct pressure_conversion conv = calculate_pressure_conversion(surface_pressure, salinity);
+	return conv_depth_to_mbar(&conv, depth);
+}
+
+struct pressure_conversion get_pressure_conversion(const struct dive *dive)
+{
+	return calculate_pressure_conversion(dive->surface_pressure, dive->salinity);
 }
 
 int depth_to_mbar(int depth, const struct dive *dive)
@@ -3821,40 +4034,86 @@ struct divecomputer *get_dive_dc(struct dive *dive, int nr)
 	return dc;
 }
 
-struct dive *get_dive_by_uniq_id(int id)
+/*
+ * Index from the unique id of a dive to its position in the dive table.
+ *
+ * The dive table is modified in too many places to keep an index up to
+ * date. Instead, the index is a cache: a hit is only trusted if the dive
+ * at that position indeed has the id. Since ids are unique, a stale entry
+ * can't give a wrong result. On a miss, the index is rebuilt. Thus,
+ * after a change of the dive table the first lookup is O(n), all further
+ * lookups are O(1) as long as the table stays unchanged.
+ */
+static struct {
+	unsigned int mask;	/* number of slots - 1, slots is a power of two */
+	int *slots;		/* position in the dive table or -1 */
+} uniq_id_index;
+
+static unsigned int hash_uniq_id(int id)
 {
+	return (unsigned int)id * 2654435761u;
+}
+
+static void build_uniq_id_index(void)
+{
+	unsigned int size = 64;
 	int i;
-	struct dive *dive = NULL;
 
-	for_each_dive (i, dive) {
-		if (dive->id == id)
-			break;
+	while (size < 2 * (unsigned int)dive_table.nr)
+		size *= 2;
+	if (!uniq_id_index.slots || size != uniq_id_index.mask + 1) {
+		free(uniq_id_index.slots);
+		uniq_id_index.slots = malloc(size * sizeof(int));
+		if (!uniq_id_index.slots)
+			exit(1);
+		uniq_id_index.mask = size - 1;
 	}
-#ifdef DEBUG
-	if (dive == NULL) {
-		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
-		exit(1);
+	memset(uniq_id_index.slots, -1, size * sizeof(int));
+	for (i = 0; i < dive_table.nr; i++) {
+		unsigned int h = hash_uniq_id(dive_table.dives[i]->id) & uniq_id_index.mask;
+		while (uniq_id_index.slots[h] >= 0)
+			h = (h + 1) & uniq_id_index.mask;
+		uniq_id_index.slots[h] = i;
 	}
-#endif
-	return dive;
 }
 
+static int lookup_uniq_id(int id)
+{
+	unsigned int h;
+	int idx;
+
+	if (!uniq_id_index.slots)
+		return -1;
+	h = hash_uniq_id(id) & uniq_id_index.mask;
+	while ((idx = uniq_id_index.slots[h]) >= 0) {
+		if (idx < dive_table.nr && dive_table.dives[idx]->id == id)
+			return idx;
+		h = (h + 1) & uniq_id_index.mask;
+	}
+	return -1;
+}
+
+/* Returns dive_table.nr if there is no dive with the given id */
 int get_idx_by_uniq_id(int id)
 {
-	int i;
-	struct dive *dive = NULL;
+	int idx = lookup_uniq_id(id);
 
-	for_each_dive (i, dive) {
-		if (dive->id == id)
-			break;
+	if (idx < 0) {
+		build_uniq_id_index();
+		idx = lookup_uniq_id(id);
 	}
 #ifdef DEBUG
-	if (dive == NULL) {
+	if (idx < 0) {
 		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
 		exit(1);
 	}
 #endif
-	return i;
+	return idx < 0 ? dive_table.nr : idx;
+}
+
+struct dive *get_dive_by_uniq_id(int id)
+{
+	return get_dive(get_idx_by_uniq_id(id));
 }
 
 bool dive_site_has_gps_location(const struct dive_site *ds)
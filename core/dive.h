@@ -111,6 +111,7 @@ struct extra_data {
  *
  * A deviceid or diveid of zero is assumed to be "no ID".
  */
+struct sample_columns;
 struct divecomputer {
 	timestamp_t when;
 	duration_t duration, surfacetime, last_manual_time;
@@ -127,8 +128,21 @@ struct divecomputer {
 	struct event *events;
 	struct extra_data *extra_data;
 	struct divecomputer *next;
+
+	/* Lazily loaded git logbooks: the samples have not been parsed yet
+	 * and are read from blob sample_blob_id in git repository number
+	 * sample_repo - 1 by load_samples(). Zero if there is nothing to load. */
+	int sample_repo;
+	unsigned char sample_blob_id[20];
+	/* The repository the samples were loaded from, as long as they are
+	 * unchanged. Such samples may be freed and loaded again. See sampleresidency.h */
+	int sample_reload_repo;
+
+	/* Samples in compact storage, unpacked by load_samples(). See samplecolumns.h */
+	struct sample_columns *packed_samples;
 };
 
+struct arena;
 struct dive_site;
 struct dive_site_table;
 struct dive_table;
@@ -148,6 +162,14 @@ struct dive {
 	int rating;
 	int wavesize, current, visibility, surge, chill; /* 0 - 5 star ratings */
 	int sac, otu, cns, maxcns;
+	/* sac, otu and a calculated maxcns are only updated when the dive (derived_valid)
+	 * or a previous dive (cns_generation) changed, see update_cylinder_related_info() */
+	bool derived_valid;
+	unsigned int cns_generation;
+	/* the result of get_dive_gas(), see get_dive_gas_cached(). Only valid while
+	 * the dive wasn't changed (gas_valid) */
+	bool gas_valid;
+	int gas_o2, gas_he, gas_o2max;
 
 	/* Calculated based on dive computer data */
 	temperature_t mintemp, maxtemp, watertemp, airtemp;
@@ -177,6 +199,7 @@ struct dive_or_trip {
 
 extern void invalidate_dive_cache(struct dive *dive);
 extern bool dive_cache_is_valid(const struct dive *dive);
+extern unsigned int dive_data_generation;
 
 extern int get_cylinder_idx_by_use(const struct dive *dive, enum cylinderuse cylinder_use_type);
 extern void cylinder_renumber(struct dive *dive, int mapping[]);
@@ -217,6 +240,30 @@ extern double depth_to_bar(int depth, const struct dive *dive);
 extern double depth_to_atm(int depth, const struct dive *dive);
 extern int rel_mbar_to_depth(int mbar, const struct dive *dive);
 extern int mbar_to_depth(int mbar, const struct dive *dive);
+
+/* For converting many depths of the same dive in a loop: the surface
+ * pressure and salinity are looked up once by get_pressure_conversion() */
+struct pressure_conversion {
+	int surface_mbar;
+	double mbar_per_mm;
+};
+extern struct pressure_conversion get_pressure_conversion(const struct dive *dive);
+
+/* Same as depth_to_mbar(), depth_to_bar() and depth_to_atm() */
+static inline int conv_depth_to_mbar(const struct pressure_conversion *conv, int depth)
+{
+	return conv->surface_mbar + (int)lrint(depth * conv->mbar_per_mm);
+}
+
+static inline double conv_depth_to_bar(const struct pressure_conversion *conv, int depth)
+{
+	return conv_depth_to_mbar(conv, depth) / 1000.0;
+}
+
+static inline double conv_depth_to_atm(const struct pressure_conversion *conv, int depth)
+{
+	return mbar_to_atm(conv_depth_to_mbar(conv, depth));
+}
 extern depth_t gas_mod(struct gasmix mix, pressure_t po2_limit, const struct dive *dive, int roundto);
 extern depth_t gas_mnd(struct gasmix mix, depth_t end, const struct dive *dive, int roundto);
 
@@ -297,6 +344,8 @@ extern void free_dive_dcs(struct divecomputer *dc);
 extern void record_dive_to_table(struct dive *dive, struct dive_table *table);
 extern void clear_dive(struct dive *dive);
 extern void copy_dive(const struct dive *s, struct dive *d);
+extern void load_samples(const struct dive *dive);
+extern void load_sample_blobs(const struct dive *dive);
 extern void selective_copy_dive(const struct dive *s, struct dive *d, struct dive_components what, bool clear);
 extern struct dive *move_dive(struct dive *s);
 
@@ -312,6 +361,8 @@ extern bool dive_less_than(const struct dive *a, const struct dive *b);
 extern bool dive_or_trip_less_than(struct dive_or_trip a, struct dive_or_trip b);
 extern void sort_dive_table(struct dive_table *table);
 extern struct dive *fixup_dive(struct dive *dive);
+extern void fixup_dive_data(struct dive *dive);
+extern struct dive *fixup_dive_finish(struct dive *dive);
 extern pressure_t calculate_surface_pressure(const struct dive *dive);
 extern pressure_t un_fixup_surface_pressure(const struct dive *d);
 extern int get_dive_salinity(const struct dive *dive);
@@ -323,9 +374,11 @@ extern int split_dive(const struct dive *dive, struct dive **new1, struct dive *
 extern int split_dive_at_time(const struct dive *dive, duration_t time, struct dive **new1, struct dive **new2);
 extern struct dive *merge_dives(const struct dive *a, const struct dive *b, int offset, bool prefer_downloaded, struct dive_trip **trip, struct dive_site **site);
 extern struct dive *try_to_merge(struct dive *a, struct dive *b, bool prefer_downloaded);
+extern int find_duplicate_dives(const struct dive_table *table, struct dive ***pairs);
 extern struct event *clone_event(const struct event *src_ev);
 extern void copy_events(const struct divecomputer *s, struct divecomputer *d);
 extern void copy_events_until(const struct dive *sd, struct dive *dd, int time);
+extern void free_event(struct event *ev);
 extern void free_events(struct event *ev);
 extern void copy_used_cylinders(const struct dive *s, struct dive *d, bool used_only);
 extern void copy_samples(const struct divecomputer *s, struct divecomputer *d);
@@ -333,15 +386,18 @@ extern bool is_cylinder_used(const struct dive *dive, int idx);
 extern bool is_cylinder_prot(const struct dive *dive, int idx);
 extern void add_gas_switch_event(struct dive *dive, struct divecomputer *dc, int time, int idx);
 extern struct event *create_event(unsigned int time, int type, int flags, int value, const char *name);
+extern struct event *create_event_in_arena(struct arena *arena, unsigned int time, int type, int flags, int value, const char *name);
 extern struct event *create_gas_switch_event(struct dive *dive, struct divecomputer *dc, int seconds, int idx);
 extern struct event *clone_event_rename(const struct event *ev, const char *name);
 extern void add_event_to_dc(struct divecomputer *dc, struct event *ev);
 extern void swap_event(struct divecomputer *dc, struct event *from, struct event *to);
 extern bool same_event(const struct event *a, const struct event *b);
 extern struct event *add_event(struct divecomputer *dc, unsigned int time, int type, int flags, int value, const char *name);
+extern struct event *add_event_to_arena(struct arena *arena, struct divecomputer *dc, unsigned int time, int type, int flags, int value, const char *name);
 extern void remove_event_from_dc(struct divecomputer *dc, struct event *event);
 extern void update_event_name(struct dive *d, struct event *event, const char *name);
 extern void add_extra_data(struct divecomputer *dc, const char *key, const char *value);
+extern void add_extra_data_to_arena(struct arena *arena, struct divecomputer *dc, const char *key, const char *value);
 extern void per_cylinder_mean_depth(const struct dive *dive, struct divecomputer *dc, int *mean, int *duration);
 extern int get_cylinder_index(const struct dive *dive, const struct event *ev);
 extern struct gasmix get_gasmix_from_event(const struct dive *, const struct event *ev);
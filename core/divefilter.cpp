@@ -4,7 +4,10 @@
 #include "divelist.h" // for filter_dive
 #include "gettextfromc.h"
 #include "qthelper.h"
+#include "divesummarytable.h"
+#include "trace.h"
 #include "subsurface-qt/divelistnotifier.h"
+#include <QtConcurrent>
 #ifndef SUBSURFACE_MOBILE
 #include "desktop-widgets/mapwidget.h"
 #include "desktop-widgets/mainwindow.h"
@@ -22,6 +25,43 @@ static void updateDiveStatus(dive *d, bool newStatus, ShownChange &change)
 	}
 }
 
+// Number of dives that are evaluated in one go by a worker thread
+static const int filterChunkSize = 256;
+
+// Number of filter results that are kept, see DiveFilter::resultCache
+static const size_t resultCacheSize = 8;
+
+// Calculate the new status of all dives in the dive table. The predicate is only
+// evaluated for dives whose status and evaluate flags are set on entry. Evaluating the filter only
+// reads the dives and can therefore be done in parallel chunks. The status of the
+// dives is changed serially afterwards, in the order of the dive table, so that
+// the result doesn't depend on the threads.
+// Status is a std::vector<char>, not std::vector<bool>: the threads write to different elements.
+template <typename Predicate>
+static ShownChange updateAllDives(std::vector<char> status, const std::vector<char> &evaluate, Predicate pred)
+{
+	int nr = dive_table.nr;
+	std::vector<int> chunks;
+	for (int i = 0; i < nr; i += filterChunkSize)
+		chunks.push_back(i);
+	auto evaluateChunk = [&status, &evaluate, &pred, nr](int from) {
+		int to = std::min(from + filterChunkSize, nr);
+		for (int i = from; i < to; ++i) {
+			if (status[i] && evaluate[i])
+				status[i] = pred(dive_table.dives[i]);
+		}
+	};
+	if (chunks.size() > 1)
+		QtConcurrent::blockingMap(chunks, evaluateChunk);
+	else if (!chunks.empty())
+		evaluateChunk(chunks[0]);
+
+	ShownChange res;
+	for (int i = 0; i < nr; ++i)
+		updateDiveStatus(dive_table.dives[i], status[i], res);
+	return res;
+}
+
 bool FilterData::operator==(const FilterData &f2) const
 {
 	return fullText.originalQuery == f2.fullText.originalQuery &&
@@ -34,6 +74,46 @@ bool FilterData::validFilter() const
 	return fullText.doit() || !constraints.empty();
 }
 
+// Do all words that match the query word w1 also match the query word w2?
+static bool wordIsSubset(const QString &w1, const QString &w2, StringFilterMode mode)
+{
+	switch (mode) {
+	case StringFilterMode::SUBSTRING:
+		return w1.contains(w2);
+	case StringFilterMode::STARTSWITH:
+		return w1.startsWith(w2);
+	case StringFilterMode::EXACT:
+	default:
+		return w1 == w2;
+	}
+}
+
+// Do all dives that pass the filter f1 also pass the filter f2? This is a conservative
+// check: false is returned if that can't be decided by comparing the filters.
+static bool isSubset(const FilterData &f1, const FilterData &f2)
+{
+	// A dive must match all words of a fulltext query. Therefore, each word of f2
+	// must be implied by a word of f1.
+	if (f2.fullText.doit()) {
+		if (!f1.fullText.doit() || f1.fulltextStringMode != f2.fulltextStringMode)
+			return false;
+		StringFilterMode mode = f1.fulltextStringMode;
+		for (const QString &w2: f2.fullText.words) {
+			if (std::none_of(f1.fullText.words.begin(), f1.fullText.words.end(),
+					 [&w2, mode](const QString &w1) { return wordIsSubset(w1, w2, mode); }))
+				return false;
+		}
+	}
+
+	// Likewise, each constraint of f2 must be implied by a constraint of f1.
+	for (const filter_constraint &c2: f2.constraints) {
+		if (std::none_of(f1.constraints.begin(), f1.constraints.end(),
+				 [&c2](const filter_constraint &c1) { return filter_constraint_is_subset(c1, c2); }))
+			return false;
+	}
+	return true;
+}
+
 ShownChange DiveFilter::update(const QVector<dive *> &dives) const
 {
 	dive *old_current = current_dive;
@@ -41,6 +121,8 @@ ShownChange DiveFilter::update(const QVector<dive *> &dives) const
 	ShownChange res;
 	bool doDS = diveSiteMode();
 	bool doFullText = filterData.fullText.doit();
+	for (CachedResult &entry: resultCache)
+		entry.changed.insert(dives.begin(), dives.end());
 	for (dive *d: dives) {
 		// There are three modes: divesite, fulltext, normal
 		bool newStatus = doDS        ? dive_sites.contains(d->dive_site) :
@@ -54,40 +136,87 @@ ShownChange DiveFilter::update(const QVector<dive *> &dives) const
 
 ShownChange DiveFilter::updateAll() const
 {
+	TRACE_SCOPE("DiveFilter::updateAll");
 	dive *old_current = current_dive;
 
 	ShownChange res;
-	int i;
-	dive *d;
+	if (!inSetFilter)
+		resultCache.clear();
+
 	// There are three modes: divesite, fulltext, normal
 	if (diveSiteMode()) {
-		for_each_dive(i, d) {
-			bool newStatus = dive_sites.contains(d->dive_site);
-			updateDiveStatus(d, newStatus, res);
+		res = updateAllDives(std::vector<char>(dive_table.nr, 1), std::vector<char>(dive_table.nr, 1),
+				     [this](const dive *d) { return dive_sites.contains(d->dive_site); });
+		res.currentChanged = old_current != current_dive;
+		return res;
+	}
+
+	// Reuse a previous result: only the dives that changed since have to be evaluated
+	if (cachedResult >= 0) {
+		const CachedResult &entry = resultCache[cachedResult];
+		cachedResult = -1; // storeResult() reorders the cache
+		std::vector<char> status = entry.status;
+		std::vector<char> evaluate(dive_table.nr, 0);
+		for (int i = 0; i < dive_table.nr; ++i) {
+			if (entry.changed.count(dive_table.dives[i]))
+				status[i] = evaluate[i] = 1;
 		}
-	} else if (filterData.fullText.doit()) {
-		FullTextResult ft = fulltext_find_dives(filterData.fullText, filterData.fulltextStringMode);
-		for_each_dive(i, d) {
-			bool newStatus = ft.dive_matches(d) && showDive(d);
-			updateDiveStatus(d, newStatus, res);
+		bool doFullText = filterData.fullText.doit();
+		res = updateAllDives(std::move(status), evaluate, [this, doFullText](const dive *d)
+				     { return (!doFullText || fulltext_dive_matches(d, filterData.fullText, filterData.fulltextStringMode)) &&
+					      showDive(d); });
+		storeResult();
+		res.currentChanged = old_current != current_dive;
+		return res;
+	}
+
+	std::vector<char> status = columnStatus();
+	std::vector<char> evaluate(dive_table.nr, 1);
+	// If the filter was narrowed, hidden dives stay hidden. If it was widened, shown dives stay shown.
+	for (int i = 0; i < dive_table.nr; ++i) {
+		bool shown = !dive_table.dives[i]->hidden_by_filter;
+		if ((refinement == Refinement::Narrower && !shown) || (refinement == Refinement::Wider && shown)) {
+			status[i] = shown;
+			evaluate[i] = 0;
 		}
+	}
+	if (filterData.fullText.doit()) {
+		FullTextResult ft = fulltext_find_dives(filterData.fullText, filterData.fulltextStringMode);
+		res = updateAllDives(std::move(status), evaluate, [this, &ft](const dive *d) { return ft.dive_matches(d) && showDiveRows(d); });
 	} else {
-		for_each_dive(i, d) {
-			bool newStatus = showDive(d);
-			updateDiveStatus(d, newStatus, res);
-		}
+		res = updateAllDives(std::move(status), evaluate, [this](const dive *d) { return showDiveRows(d); });
 	}
+	storeResult();
 	res.currentChanged = old_current != current_dive;
 	return res;
 }
 
+// Remember the shown status of all dives for the current filter
+void DiveFilter::storeResult() const
+{
+	auto it = std::find_if(resultCache.begin(), resultCache.end(),
+			       [this](const CachedResult &entry) { return entry.data == filterData; });
+	if (it != resultCache.end())
+		resultCache.erase(it);
+	else if (resultCache.size() >= resultCacheSize)
+		resultCache.pop_back();
+
+	CachedResult entry;
+	entry.data = filterData;
+	entry.dives.assign(dive_table.dives, dive_table.dives + dive_table.nr);
+	entry.status.resize(dive_table.nr);
+	for (int i = 0; i < dive_table.nr; ++i)
+		entry.status[i] = !dive_table.dives[i]->hidden_by_filter;
+	resultCache.insert(resultCache.begin(), std::move(entry));
+}
+
 DiveFilter *DiveFilter::instance()
 {
 	static DiveFilter self;
 	return &self;
 }
 
-DiveFilter::DiveFilter() : diveSiteRefCount(0)
+DiveFilter::DiveFilter() : refinement(Refinement::None), cachedResult(-1), inSetFilter(false), diveSiteRefCount(0)
 {
 }
 
@@ -99,8 +228,99 @@ bool DiveFilter::showDive(const struct dive *d) const
 	if (!filterData.validFilter())
 		return true;
 
-	return std::all_of(filterData.constraints.begin(), filterData.constraints.end(),
-			   [d] (const filter_constraint &c) { return filter_constraint_match_dive(c, d); });
+	return std::all_of(program.begin(), program.end(),
+			   [d] (const compiled_filter_constraint &c) { return filter_constraint_match_dive(c, d); });
+}
+
+// Like showDive(), but without the constraints that are checked by columnStatus()
+bool DiveFilter::showDiveRows(const struct dive *d) const
+{
+	if (d->invalid && !prefs.display_invalid_dives)
+		return false;
+
+	if (!filterData.validFilter())
+		return true;
+
+	return std::all_of(rowProgram.begin(), rowProgram.end(),
+			   [d] (const compiled_filter_constraint *c) { return filter_constraint_match_dive(*c, d); });
+}
+
+// The numerical constraints that can be checked on a column of the summary table
+static int summaryColumn(enum filter_constraint_type type)
+{
+	switch (type) {
+	case FILTER_CONSTRAINT_DEPTH:
+		return DiveSummaryTable::DEPTH;
+	case FILTER_CONSTRAINT_DURATION:
+		return DiveSummaryTable::DURATION;
+	case FILTER_CONSTRAINT_SAC:
+		return DiveSummaryTable::SAC;
+	case FILTER_CONSTRAINT_WATER_TEMP:
+		return DiveSummaryTable::WATER_TEMP;
+	case FILTER_CONSTRAINT_AIR_TEMP:
+		return DiveSummaryTable::AIR_TEMP;
+	case FILTER_CONSTRAINT_WEIGHT:
+		return DiveSummaryTable::WEIGHT;
+	case FILTER_CONSTRAINT_WATER_DENSITY:
+		return DiveSummaryTable::WATER_DENSITY;
+	default:
+		return -1;
+	}
+}
+
+// Check the numerical constraints for all dives on the columns of the summary table.
+// The result is indexed like the dive table.
+std::vector<char> DiveFilter::columnStatus() const
+{
+	std::vector<char> status(dive_table.nr, 1);
+	for (const compiled_filter_constraint *c: columnProgram) {
+		const std::vector<int> &values = DiveSummaryTable::instance().column((DiveSummaryTable::Column)summaryColumn(c->constraint.type));
+		filter_constraint_match_values(c->constraint, values.data(), std::min((int)values.size(), dive_table.nr), status.data());
+	}
+	return status;
+}
+
+// Compile the constraints of the filter and order them, so that the evaluation
+// of a dive can stop as early and as cheaply as possible. The fraction of dives
+// passing each constraint is estimated on a sample of the dive table. Ordering
+// by cost / (fraction of rejected dives) minimizes the expected evaluation time.
+void DiveFilter::compileFilter()
+{
+	static const int sampleSize = 200;
+
+	struct Entry {
+		double rank;
+		size_t idx;
+	};
+	std::vector<compiled_filter_constraint> compiled(filterData.constraints.begin(), filterData.constraints.end());
+	std::vector<Entry> order;
+	int step = std::max(dive_table.nr / sampleSize, 1);
+	for (size_t i = 0; i < compiled.size(); ++i) {
+		int nr = 0, rejected = 0;
+		for (int j = 0; j < dive_table.nr; j += step, ++nr) {
+			if (!filter_constraint_match_dive(compiled[i], dive_table.dives[j]))
+				++rejected;
+		}
+		// Smoothed, so that constraints that rejected no sampled dive are still ordered by cost.
+		double rejectedFraction = (rejected + 0.5) / (nr + 1);
+		order.push_back({ compiled[i].cost / rejectedFraction, i });
+	}
+	// Stable, so that constraints of equal rank are evaluated in the order given by the user.
+	std::stable_sort(order.begin(), order.end(), [](const Entry &e1, const Entry &e2) { return e1.rank < e2.rank; });
+
+	program.clear();
+	for (const Entry &e: order)
+		program.push_back(std::move(compiled[e.idx]));
+
+	// When checking all dives, the numerical constraints are checked on the columns of the summary table first
+	columnProgram.clear();
+	rowProgram.clear();
+	for (const compiled_filter_constraint &c: program) {
+		if (summaryColumn(c.constraint.type) >= 0)
+			columnProgram.push_back(&c);
+		else
+			rowProgram.push_back(&c);
+	}
 }
 
 #ifndef SUBSURFACE_MOBILE
@@ -168,6 +388,19 @@ QString DiveFilter::shownText() const
 
 void DiveFilter::setFilter(const FilterData &data)
 {
+	// The models recalculate the filter in response to the filterReset() signal.
+	// While doing so, the shown status of the dives reflects the old filter.
+	refinement = isSubset(data, filterData) ? Refinement::Narrower :
+		     isSubset(filterData, data) ? Refinement::Wider : Refinement::None;
+	auto it = std::find_if(resultCache.begin(), resultCache.end(), [&data](const CachedResult &entry)
+			       { return entry.data == data && (int)entry.dives.size() == dive_table.nr &&
+					std::equal(entry.dives.begin(), entry.dives.end(), dive_table.dives); });
+	cachedResult = it != resultCache.end() ? it - resultCache.begin() : -1;
 	filterData = data;
+	compileFilter();
+	inSetFilter = true;
 	emit diveListNotifier.filterReset();
+	inSetFilter = false;
+	cachedResult = -1;
+	refinement = Refinement::None;
 }
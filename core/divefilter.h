@@ -6,6 +6,7 @@
 #include "fulltext.h"
 #include "filterconstraint.h"
 #include <vector>
+#include <unordered_set>
 #include <QVector>
 #include <QStringList>
 
@@ -53,9 +54,44 @@ public:
 private:
 	DiveFilter();
 	bool showDive(const struct dive *d) const; // Should that dive be shown?
+	bool showDiveRows(const struct dive *d) const;
+	std::vector<char> columnStatus() const;
 
 	QVector<dive_site *> dive_sites;
 	FilterData filterData;
+	// The constraints of filterData, prepared for matching and ordered
+	// such that the cheapest and most selective constraints come first.
+	std::vector<compiled_filter_constraint> program;
+	std::vector<const compiled_filter_constraint *> columnProgram; // Checked on the summary table
+	std::vector<const compiled_filter_constraint *> rowProgram; // Checked per dive
+	void compileFilter();
+
+	// Set during setFilter(): if the new filter is narrower than the old one, only
+	// the shown dives have to be re-evaluated. If it is wider, only the hidden dives.
+	enum class Refinement {
+		None,
+		Narrower,
+		Wider
+	};
+	Refinement refinement;
+
+	// The results of the last filters, most recently used first, so that
+	// switching back to a filter (e.g. a preset) doesn't evaluate all dives.
+	// A result is valid as long as the dive table contains the same dives.
+	// Dives that were re-evaluated by update() since are remembered and
+	// evaluated again when the result is reused. The cache is cleared when
+	// all dives are re-evaluated outside of setFilter(), e.g. after
+	// loading a file or changing the preferences.
+	struct CachedResult {
+		FilterData data;
+		std::vector<const dive *> dives;
+		std::vector<char> status;
+		std::unordered_set<const dive *> changed;
+	};
+	mutable std::vector<CachedResult> resultCache;
+	mutable int cachedResult; // Set during setFilter(): index into resultCache or -1
+	bool inSetFilter;
+	void storeResult() const;
 
 	// We use ref-counting for the dive site mode. The reason is that when switching
 	// between two tabs that both need dive site mode, the following course of
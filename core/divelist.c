@@ -5,16 +5,21 @@
 #include "subsurface-string.h"
 #include "deco.h"
 #include "device.h"
+#include "fingerprint.h"
 #include "divesite.h"
 #include "dive.h"
 #include "filterpreset.h"
 #include "fulltext.h"
 #include "planner.h"
+#include "samplecolumns.h"
+#include "sampleresidency.h"
+#include "arena.h"
 #include "qthelper.h"
 #include "gettext.h"
 #include "git-access.h"
 #include "selection.h"
 #include "table.h"
+#include "trace.h"
 #include "trip.h"
 
 /* This flag is set to true by operations that are not implemented in the
@@ -70,6 +75,24 @@ void get_dive_gas(const struct dive *dive, int *o2_p, int *he_p, int *o2max_p)
 	*o2max_p = maxo2;
 }
 
+/*
+ * Same as get_dive_gas(), but the result is kept in the dive until
+ * invalidate_dive_cache() is called. Only for dives that are edited
+ * through the undo commands, i.e. not for the dive being planned or
+ * the cylinders being edited in the equipment tab.
+ */
+void get_dive_gas_cached(const struct dive *dive, int *o2_p, int *he_p, int *o2max_p)
+{
+	if (!dive->gas_valid) {
+		struct dive *d = (struct dive *)dive;
+		get_dive_gas(dive, &d->gas_o2, &d->gas_he, &d->gas_o2max);
+		d->gas_valid = true;
+	}
+	*o2_p = dive->gas_o2;
+	*he_p = dive->gas_he;
+	*o2max_p = dive->gas_o2max;
+}
+
 int total_weight(const struct dive *dive)
 {
 	int i, total_grams = 0;
@@ -98,6 +121,7 @@ static int calculate_otu(const struct dive *dive)
 	int i;
 	double otu = 0.0;
 	const struct divecomputer *dc = &dive->dc;
+	struct pressure_conversion conv = get_pressure_conversion(dive);
 	for (i = 1; i < dc->samples; i++) {
 		int t;
 		int po2i, po2f;
@@ -114,8 +138,8 @@ static int calculate_otu(const struct dive *dive)
 				po2f = sample->setpoint.mbar;
 			} else {						// For OC and rebreather without o2 sensor/setpoint
 				int o2 = active_o2(dive, dc, psample->time);	// 	... calculate po2 from depth and FiO2.
-				po2i = lrint(o2 * depth_to_atm(psample->depth.mm, dive));	// (initial) po2 at start of segment
-				po2f = lrint(o2 * depth_to_atm(sample->depth.mm, dive));	// (final) po2 at end of segment
+				po2i = lrint(o2 * conv_depth_to_atm(&conv, psample->depth.mm));	// (initial) po2 at start of segment
+				po2f = lrint(o2 * conv_depth_to_atm(&conv, sample->depth.mm));	// (final) po2 at end of segment
 			}
 		}
 		if ((po2i > 500) || (po2f > 500)) {			// If PO2 in segment is above 500 mbar then calculate otu
@@ -151,6 +175,7 @@ static double calculate_cns_dive(const struct dive *dive)
 	const struct divecomputer *dc = &dive->dc;
 	double cns = 0.0;
 	double rate;
+	struct pressure_conversion conv = get_pressure_conversion(dive);
 	/* Calculate the CNS for each sample in this dive and sum them */
 	for (n = 1; n < dc->samples; n++) {
 		int t;
@@ -171,8 +196,8 @@ static double calculate_cns_dive(const struct dive *dive)
 		}
 		if (!trueo2) {
 			int o2 = active_o2(dive, dc, psample->time);			// For OC and rebreather without o2 sensor:
-			po2i = lrint(o2 * depth_to_atm(psample->depth.mm, dive));	// (initial) po2 at start of segment
-			po2f = lrint(o2 * depth_to_atm(sample->depth.mm, dive));	// (final) po2 at end of segment
+			po2i = lrint(o2 * conv_depth_to_atm(&conv, psample->depth.mm));	// (initial) po2 at start of segment
+			po2f = lrint(o2 * conv_depth_to_atm(&conv, sample->depth.mm));	// (final) po2 at end of segment
 		}
 		po2i = (po2i + po2f) / 2;	// po2i now holds the mean po2 of initial and final po2 values of segment.
 		/* Don't increase CNS when po2 below 500 matm */
@@ -186,10 +211,22 @@ static double calculate_cns_dive(const struct dive *dive)
 	return cns;
 }
 
+/* The CNS of a single dive of the dive table. If single_cns is not NULL,
+ * it caches the values of all dives in the table, with negative entries
+ * for dives that were not yet calculated. */
+static double calculate_cns_dive_idx(int idx, double *single_cns)
+{
+	if (!single_cns)
+		return calculate_cns_dive(get_dive(idx));
+	if (single_cns[idx] < 0.0)
+		single_cns[idx] = calculate_cns_dive(get_dive(idx));
+	return single_cns[idx];
+}
+
 /* this only gets called if dive->maxcns == 0 which means we know that
  * none of the divecomputers has tracked any CNS for us
  * so we calculated it "by hand" */
-static int calculate_cns(struct dive *dive)
+static int calculate_cns(struct dive *dive, double *single_cns)
 {
 	int i, divenr;
 	double cns = 0.0;
@@ -200,7 +237,7 @@ static int calculate_cns(struct dive *dive)
 		return dive->cns;
 
 	divenr = get_divenr(dive);
-	i = divenr >= 0 ? divenr : dive_table.nr;
+	i = divenr >= 0 ? divenr : get_dive_idx_by_time(dive->when);
 #if DECO_CALC_DEBUG & 2
 	if (i >= 0 && i < dive_table.nr)
 		printf("\n\n*** CNS for dive #%d %d\n", i, get_dive(i)->number);
@@ -290,7 +327,7 @@ static int calculate_cns(struct dive *dive)
 		printf("CNS after surface interval: %f\n", cns);
 #endif
 
-		cns += calculate_cns_dive(pdive);
+		cns += calculate_cns_dive_idx(i, single_cns);
 #if DECO_CALC_DEBUG & 2
 		printf("CNS after previous dive: %f\n", cns);
 #endif
@@ -306,7 +343,10 @@ static int calculate_cns(struct dive *dive)
 	printf("CNS after last surface interval: %f\n", cns);
 #endif
 
-	cns += calculate_cns_dive(dive);
+	if (divenr >= 0 && get_dive(divenr) == dive)
+		cns += calculate_cns_dive_idx(divenr, single_cns);
+	else
+		cns += calculate_cns_dive(dive);
 #if DECO_CALC_DEBUG & 2
 	printf("CNS after dive: %f\n", cns);
 #endif
@@ -340,7 +380,7 @@ static double calculate_airuse(const struct dive *dive)
 				continue;
 		}
 
-		airuse += gas_volume(cyl, start) - gas_volume(cyl, end);
+		airuse += gas_volume_used(cyl, start, end);
 	}
 	return airuse / 1000.0;
 }
@@ -380,9 +420,13 @@ static void add_dive_to_deco(struct deco_state *ds, struct dive *dive)
 	int i;
 	const struct event *ev = NULL, *evd = NULL;
 	enum divemode_t current_divemode = UNDEF_COMP_TYPE;
+	struct pressure_conversion conv;
+
+	load_samples(dive);
 
 	if (!dc)
 		return;
+	conv = get_pressure_conversion(dive);
 
 	for (i = 1; i < dc->samples; i++) {
 		struct sample *psample = dc->sample + i - 1;
@@ -394,7 +438,7 @@ static void add_dive_to_deco(struct deco_state *ds, struct dive *dive)
 		for (j = t0; j < t1; j++) {
 			int depth = interpolate(psample->depth.mm, sample->depth.mm, j - t0, t1 - t0);
 			gasmix = get_gasmix(dive, dc, j, &ev, gasmix);
-			add_segment(ds, depth_to_bar(depth, dive), gasmix, 1, sample->setpoint.mbar,
+			add_segment(ds, conv_depth_to_bar(&conv, depth), gasmix, 1, sample->setpoint.mbar,
 				get_current_divemode(&dive->dc, j, &evd, &current_divemode), dive->sac);
 		}
 	}
@@ -403,14 +447,105 @@ static void add_dive_to_deco(struct deco_state *ds, struct dive *dive)
 int get_divenr(const struct dive *dive)
 {
 	int i;
-	const struct dive *d;
 	// tempting as it may be, don't die when called with dive=NULL
-	if (dive)
-		for_each_dive(i, d) {
-			if (d->id == dive->id) // don't compare pointers, we could be passing in a copy of the dive
-				return i;
+	if (!dive)
+		return -1;
+	// don't compare pointers, we could be passing in a copy of the dive
+	i = get_idx_by_uniq_id(dive->id);
+	return i < dive_table.nr ? i : -1;
+}
+
+/*
+ * Cache of the tissue state at the end of the dives that init_decompression()
+ * adds as previous dives. Each entry is only valid if it was computed from the
+ * same starting point: the entry of the dive before it in the chain (through
+ * its serial number), the same surface interval and surface pressure, and
+ * the same deco parameters. When an earlier dive is changed or removed, its
+ * entry goes away and the new entry gets a new serial, so all entries that
+ * depended on it are not used anymore.
+ */
+#define DECO_CACHE_SIZE 256
+
+struct deco_cache_entry {
+	int dive_id;			/* 0 means unused */
+	uint64_t serial;
+	uint64_t prev_serial;
+	uint64_t parameters;
+	int surface_time;
+	int surface_pressure;
+	enum divemode_t surface_divemode;
+	timestamp_t when;
+	int duration;
+	struct deco_state state;
+};
+
+static struct deco_cache_entry *deco_cache;
+static uint64_t deco_cache_serial;
+
+static struct deco_cache_entry *find_deco_cache(const struct dive *dive, const struct deco_cache_entry *key)
+{
+	int i;
+
+	if (!deco_cache)
+		return NULL;
+	for (i = 0; i < DECO_CACHE_SIZE; i++) {
+		struct deco_cache_entry *entry = deco_cache + i;
+		if (entry->dive_id == dive->id &&
+		    entry->prev_serial == key->prev_serial &&
+		    entry->parameters == key->parameters &&
+		    entry->surface_time == key->surface_time &&
+		    entry->surface_pressure == key->surface_pressure &&
+		    entry->surface_divemode == key->surface_divemode &&
+		    entry->when == key->when &&
+		    entry->duration == key->duration)
+			return entry;
+	}
+	return NULL;
+}
+
+/* Replace the entry of the same dive or the oldest one */
+static uint64_t add_deco_cache(const struct dive *dive, const struct deco_cache_entry *key, const struct deco_state *ds)
+{
+	struct deco_cache_entry *entry;
+	int i;
+
+	if (!deco_cache) {
+		deco_cache = calloc(DECO_CACHE_SIZE, sizeof(struct deco_cache_entry));
+		if (!deco_cache)
+			return 0;
+	}
+	entry = deco_cache;
+	for (i = 0; i < DECO_CACHE_SIZE; i++) {
+		if (deco_cache[i].dive_id == dive->id) {
+			entry = deco_cache + i;
+			break;
 		}
-	return -1;
+		if (deco_cache[i].serial < entry->serial)
+			entry = deco_cache + i;
+	}
+	*entry = *key;
+	entry->dive_id = dive->id;
+	entry->serial = ++deco_cache_serial;
+	entry->state = *ds;
+	return entry->serial;
+}
+
+void invalidate_deco_cache(const struct dive *dive)
+{
+	int i;
+
+	if (!deco_cache)
+		return;
+	for (i = 0; i < DECO_CACHE_SIZE; i++) {
+		if (deco_cache[i].dive_id == dive->id)
+			deco_cache[i].dive_id = 0;
+	}
+}
+
+void clear_deco_cache(void)
+{
+	free(deco_cache);
+	deco_cache = NULL;
 }
 
 static struct gasmix air = { .o2.permille = O2_IN_AIR, .he.permille = 0 };
@@ -427,12 +562,17 @@ int init_decompression(struct deco_state *ds, struct dive *dive)
 	timestamp_t last_endtime = 0, last_starttime = 0;
 	bool deco_init = false;
 	double surface_pressure;
+	/* The planner computes variations in a background thread, so only use the cache for the profile */
+	bool use_cache = !in_planner();
+	struct deco_cache_entry key = { 0 };
 
 	if (!dive)
 		return false;
+	key.parameters = deco_parameters_hash();
+	key.surface_divemode = dive->dc.divemode;
 
 	divenr = get_divenr(dive);
-	i = divenr >= 0 ? divenr : dive_table.nr;
+	i = divenr >= 0 ? divenr : get_dive_idx_by_time(dive->when);
 #if DECO_CALC_DEBUG & 2
 	if (i >= 0 && i < dive_table.nr)
 		printf("\n\n*** Init deco for dive #%d %d\n", i, get_dive(i)->number);
@@ -516,18 +656,7 @@ int init_decompression(struct deco_state *ds, struct dive *dive)
 #endif
 
 		surface_pressure = get_surface_pressure_in_mbar(pdive, true) / 1000.0;
-		/* Is it the first dive we add? */
-		if (!deco_init) {
-#if DECO_CALC_DEBUG & 2
-			printf("Init deco\n");
-#endif
-			clear_deco(ds, surface_pressure);
-			deco_init = true;
-#if DECO_CALC_DEBUG & 2
-			printf("Tissues after init:\n");
-			dump_tissues(ds);
-#endif
-		} else {
+		if (deco_init) {
 			surface_time = pdive->when - last_endtime;
 			if (surface_time < 0) {
 #if DECO_CALC_DEBUG & 2
@@ -535,18 +664,48 @@ int init_decompression(struct deco_state *ds, struct dive *dive)
 #endif
 				return surface_time;
 			}
-			add_segment(ds, surface_pressure, air, surface_time, 0, dive->dc.divemode, prefs.decosac);
+		}
+
+		key.surface_time = deco_init ? surface_time : 0;
+		key.surface_pressure = get_surface_pressure_in_mbar(pdive, true);
+		key.when = pdive->when;
+		key.duration = pdive->duration.seconds;
+		const struct deco_cache_entry *cached = use_cache ? find_deco_cache(pdive, &key) : NULL;
+		if (cached) {
 #if DECO_CALC_DEBUG & 2
-			printf("Tissues after surface intervall of %d:%02u:\n", FRACTION(surface_time, 60));
-			dump_tissues(ds);
+			printf("Tissues of dive #%d taken from cache\n", pdive->number);
 #endif
-		}
+			*ds = cached->state;
+			key.prev_serial = cached->serial;
+			deco_init = true;
+		} else {
+			/* Is it the first dive we add? */
+			if (!deco_init) {
+#if DECO_CALC_DEBUG & 2
+				printf("Init deco\n");
+#endif
+				clear_deco(ds, surface_pressure);
+				deco_init = true;
+#if DECO_CALC_DEBUG & 2
+				printf("Tissues after init:\n");
+				dump_tissues(ds);
+#endif
+			} else {
+				add_segment(ds, surface_pressure, air, surface_time, 0, dive->dc.divemode, prefs.decosac);
+#if DECO_CALC_DEBUG & 2
+				printf("Tissues after surface intervall of %d:%02u:\n", FRACTION(surface_time, 60));
+				dump_tissues(ds);
+#endif
+			}
 
-		add_dive_to_deco(ds, pdive);
+			add_dive_to_deco(ds, pdive);
+			clear_vpmb_state(ds);
+			if (use_cache)
+				key.prev_serial = add_deco_cache(pdive, &key, ds);
+		}
 
 		last_starttime = pdive->when;
 		last_endtime = dive_endtime(pdive);
-		clear_vpmb_state(ds);
 #if DECO_CALC_DEBUG & 2
 		printf("Tissues after added dive #%d:\n", pdive->number);
 		dump_tissues(ds);
@@ -584,14 +743,48 @@ int init_decompression(struct deco_state *ds, struct dive *dive)
 	return surface_time;
 }
 
+static void update_cylinder_related_info_cached(struct dive *dive, double *single_cns)
+{
+	dive->sac = calculate_sac(dive);
+	dive->otu = calculate_otu(dive);
+	if (dive->maxcns == 0)
+		dive->maxcns = calculate_cns(dive, single_cns);
+	dive->derived_valid = true;
+	dive->cns_generation = dive_data_generation;
+}
+
+/* Recalculate the values derived from the samples and cylinders of a dive.
+ * To be called when these were changed. */
 void update_cylinder_related_info(struct dive *dive)
 {
-	if (dive != NULL) {
-		dive->sac = calculate_sac(dive);
-		dive->otu = calculate_otu(dive);
-		if (dive->maxcns == 0)
-			dive->maxcns = calculate_cns(dive);
+	if (dive != NULL)
+		update_cylinder_related_info_cached(dive, NULL);
+}
+
+/* Recalculate the derived values of the dives in the dive table that are not
+ * up to date. A calculated CNS depends on the previous dives, therefore it is
+ * recalculated if any dive changed. This is done in one forward pass over the
+ * table, so that the CNS of every single dive is only calculated once. */
+void update_all_cylinder_related_info(void)
+{
+	int i;
+	struct dive *dive;
+	double *single_cns = NULL;
+
+	for_each_dive(i, dive) {
+		if (dive->derived_valid && (dive->maxcns || dive->cns_generation == dive_data_generation))
+			continue;
+		if (!single_cns) {
+			int j;
+			single_cns = malloc(dive_table.nr * sizeof(*single_cns));
+			if (!single_cns)
+				return;
+			for (j = 0; j < dive_table.nr; j++)
+				single_cns[j] = -1.0;
+		}
+		update_cylinder_related_info_cached(dive, single_cns);
 	}
+	free(single_cns);
 }
 
 #define MAX_GAS_STRING 80
@@ -603,7 +796,7 @@ char *get_dive_gas_string(const struct dive *dive)
 	char *buffer = malloc(MAX_GAS_STRING);
 
 	if (buffer) {
-		get_dive_gas(dive, &o2, &he, &o2max);
+		get_dive_gas_cached(dive, &o2, &he, &o2max);
 		o2 = (o2 + 5) / 10;
 		he = (he + 5) / 10;
 		o2max = (o2max + 5) / 10;
@@ -698,6 +891,7 @@ int comp_dives(const struct dive *a, const struct dive *b)
 static MAKE_GROW_TABLE(dive_table, struct dive *, dives)
 MAKE_GET_INSERTION_INDEX(dive_table, struct dive *, dives, dive_less_than)
 MAKE_ADD_TO(dive_table, struct dive *, dives)
+MAKE_MERGE_INTO(dive_table, struct dive *, dives, dive_less_than)
 static MAKE_REMOVE_FROM(dive_table, dives)
 static MAKE_GET_IDX(dive_table, struct dive *, dives)
 MAKE_SORT(dive_table, struct dive *, dives, comp_dives)
@@ -767,6 +961,7 @@ struct dive *unregister_dive(int idx)
 	 * we also have to unregister its fulltext cache. */
 	fulltext_unregister(dive);
 	remove_from_dive_table(&dive_table, idx);
+	dive_data_generation++;
 	if (dive->selected)
 		amount_selected--;
 	dive->selected = false;
@@ -787,6 +982,44 @@ void delete_single_dive(int idx)
 	delete_dive_from_table(&dive_table, idx);
 }
 
+/* Remove the dives of "to_remove" from "table" without freeing them.
+ * Both tables are supposed to be sorted, so this is done in one pass
+ * instead of moving the tail of the table for every dive. */
+static void remove_dives_from_table(struct dive_table *table, const struct dive_table *to_remove)
+{
+	int i, j = 0, k = 0;
+
+	for (i = 0; i < table->nr; i++) {
+		if (k < to_remove->nr && table->dives[i] == to_remove->dives[k])
+			k++;
+		else
+			table->dives[j++] = table->dives[i];
+	}
+	memset(&table->dives[j], 0, (table->nr - j) * sizeof(table->dives[0]));
+	table->nr = j;
+
+	/* If the tables were not sorted the same way, remove the rest one by one */
+	for ( ; k < to_remove->nr; k++)
+		remove_dive(to_remove->dives[k], table);
+}
+
+/* Like delete_single_dive() for all dives of the sorted table "dives" */
+static void delete_dives(const struct dive_table *dives)
+{
+	int i;
+
+	for (i = 0; i < dives->nr; i++) {
+		struct dive *dive = dives->dives[i];
+		if (dive->selected)
+			deselect_dive(dive);
+		remove_dive_from_trip(dive, &trip_table);
+		unregister_dive_from_dive_site(dive);
+	}
+	remove_dives_from_table(&dive_table, dives);
+	for (i = 0; i < dives->nr; i++)
+		free_dive(dives->dives[i]);
+}
+
 int shown_dives = 0;
 bool filter_dive(struct dive *d, bool shown)
 {
@@ -805,6 +1038,8 @@ bool filter_dive(struct dive *d, bool shown)
 
 void mark_divelist_changed(bool changed)
 {
+	if (changed)
+		dive_data_generation++;
 	if (dive_list_changed == changed)
 		return;
 	dive_list_changed = changed;
@@ -821,6 +1056,7 @@ void process_loaded_dives()
 	int i;
 	struct dive *dive;
 
+	TRACE_BEGIN("process_loaded_dives");
 	/* Register dive computer nick names and count shown dives. */
 	shown_dives = 0;
 	for_each_dive(i, dive) {
@@ -835,7 +1071,20 @@ void process_loaded_dives()
 	/* Autogroup dives if desired by user. */
 	autogroup_dives(&dive_table, &trip_table);
 
+	/* Calculate SAC, OTU and CNS of the dives in one pass over the sorted table */
+	update_all_cylinder_related_info();
+
+	/* Keep the samples in compact form until a dive is accessed */
+	if (pack_loaded_samples) {
+		for_each_dive(i, dive) {
+			struct divecomputer *dc;
+			for_each_dc(dive, dc)
+				pack_samples(dc);
+		}
+	}
+
 	fulltext_populate();
+	TRACE_END();
 
 	/* Inform frontend of reset data. This should reset all the models. */
 	emit_reset_signal();
@@ -943,13 +1192,13 @@ static bool merge_dive_tables(struct dive_table *dives_from, struct dive_table *
 	 *  - New dive "connects" two old dives (turn three into one).
 	 *  - New dive can not be merged into adjacent but some further dive.
 	 */
+	if (delete_from)
+		remove_dives_from_table(delete_from, dives_from);
+
 	j = 0; /* Index in dives_to */
 	for (i = 0; i < dives_from->nr; i++) {
 		struct dive *dive_to_add = dives_from->dives[i];
 
-		if (delete_from)
-			remove_dive(dive_to_add, delete_from);
-
 		/* Find insertion point. */
 		while (j < dives_to->nr && dive_less_than(dives_to->dives[j], dive_to_add))
 			j++;
@@ -1001,7 +1250,7 @@ static bool merge_dive_tables(struct dive_table *dives_from, struct dive_table *
  * precedence */
 void add_imported_dives(struct dive_table *import_table, struct trip_table *import_trip_table, struct dive_site_table *import_sites_table, int flags)
 {
-	int i, idx;
+	int i;
 	struct dive_table dives_to_add = empty_dive_table;
 	struct dive_table dives_to_remove = empty_dive_table;
 	struct trip_table trips_to_add = empty_trip_table;
@@ -1024,20 +1273,16 @@ void add_imported_dives(struct dive_table *import_table, struct trip_table *impo
 	}
 
 	/* Remove old dives */
-	for (i = 0; i < dives_to_remove.nr; i++) {
-		idx = get_divenr(dives_to_remove.dives[i]);
-		delete_single_dive(idx);
-	}
+	delete_dives(&dives_to_remove);
 	dives_to_remove.nr = 0;
 
-	/* Add new dives */
-	for (i = 0; i < dives_to_add.nr; i++)
-		insert_dive(&dive_table, dives_to_add.dives[i]);
+	/* Add new dives and trips. Both lists are sorted, so merge them in one go.
+	 * The trips only got their dives above, so sort them again first. */
+	merge_into_dive_table(&dive_table, dives_to_add.dives, dives_to_add.nr);
 	dives_to_add.nr = 0;
 
-	/* Add new trips */
-	for (i = 0; i < trips_to_add.nr; i++)
-		insert_trip(trips_to_add.trips[i], &trip_table);
+	sort_trip_table(&trips_to_add);
+	merge_into_trip_table(&trip_table, trips_to_add.trips, trips_to_add.nr);
 	trips_to_add.nr = 0;
 
 	/* Add new dive sites */
@@ -1127,6 +1372,7 @@ void process_imported_dives(struct dive_table *import_table, struct trip_table *
 {
 	int i, j, nr, start_renumbering_at = 0;
 	struct dive_trip *trip_import, *new_trip;
+	struct dive_site_hash site_hash;
 	bool sequence_changed = false;
 	bool new_dive_has_number = false;
 	bool last_old_dive_is_numbered;
@@ -1178,9 +1424,10 @@ void process_imported_dives(struct dive_table *import_table, struct trip_table *
 		autogroup_dives(import_table, import_trip_table);
 
 	/* If dive sites already exist, use the existing versions. */
+	build_dive_site_hash(&site_hash, &dive_site_table);
 	for (i = 0; i  < import_sites_table->nr; i++) {
 		struct dive_site *new_ds = import_sites_table->dive_sites[i];
-		struct dive_site *old_ds = get_same_dive_site(new_ds);
+		struct dive_site *old_ds = get_same_dive_site_hashed(new_ds, &site_hash);
 
 		/* Check if it dive site is actually used by new dives. */
 		for (j = 0; j < import_table->nr; j++) {
@@ -1207,6 +1454,7 @@ void process_imported_dives(struct dive_table *import_table, struct trip_table *
 		}
 		free_dive_site(new_ds);
 	}
+	free_dive_site_hash(&site_hash);
 	import_sites_table->nr = 0; /* All dive sites were consumed */
 
 	/* Merge overlapping trips. Since both trip tables are sorted, we
@@ -1229,9 +1477,8 @@ void process_imported_dives(struct dive_table *import_table, struct trip_table *
 			/* Add dive to list of dives to-be-added. */
 			insert_dive(dives_to_add, d);
 			sequence_changed |= !dive_is_after_last(d);
-
-			remove_dive(d, import_table);
 		}
+		remove_dives_from_table(import_table, &trip_import->dives);
 
 		/* Then, add trip to list of trips to add */
 		insert_trip(trip_import, trips_to_add);
@@ -1343,8 +1590,7 @@ int get_dive_id_closest_to(timestamp_t when)
 	else if (nr == 1)
 		return dive_table.dives[0]->id;
 
-	for (i = 0; i < nr && dive_table.dives[i]->when <= when; i++)
-		; // nothing
+	i = get_dive_idx_by_time(when + 1);
 
 	// again, capture the two edge cases first
 	if (i == nr)
@@ -1376,11 +1622,19 @@ void clear_dive_file_data()
 
 	clear_dive(&displayed_dive);
 	clear_device_nodes();
+	clear_fingerprint_table();
 	clear_events();
 	clear_filter_presets();
 
 	reset_min_datafile_version();
 	clear_git_id();
+	clear_deco_cache();
+	dive_data_generation++;
+	free_sample_repositories();
+	clear_sample_residency();
+
+	/* All loaded data is gone, so nothing refers to the arena anymore */
+	arena_clear(&logbook_arena);
 
 	/* Inform frontend of reset data. This should reset all the models. */
 	emit_reset_signal();
@@ -1430,6 +1684,24 @@ bool dive_or_trip_less_than(struct dive_or_trip a, struct dive_or_trip b)
 	return comp_dive_or_trip(a, b) < 0;
 }
 
+/*
+ * Index of the first dive in the dive table that starts at or after "when",
+ * or dive_table.nr if there is no such dive. Since the dive table is sorted
+ * by start time, this is a binary search.
+ */
+int get_dive_idx_by_time(timestamp_t when)
+{
+	int lo = 0, hi = dive_table.nr;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (dive_table.dives[mid]->when < when)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
 /*
  * Calculate surface interval for dive starting at "when". Currently, we
  * might display dives which are not yet in the divelist, therefore the
@@ -1445,11 +1717,8 @@ timestamp_t get_surface_interval(timestamp_t when)
 	int i;
 	timestamp_t prev_end;
 
-	/* find previous dive. might want to use a binary search. */
-	for (i = dive_table.nr - 1; i >= 0; --i) {
-		if (dive_table.dives[i]->when < when)
-			break;
-	}
+	/* find previous dive */
+	i = get_dive_idx_by_time(when) - 1;
 	if (i < 0)
 		return -1;
 
@@ -1459,8 +1728,6 @@ timestamp_t get_surface_interval(timestamp_t when)
 	return when - prev_end;
 }
 
-/* Find visible dive close to given date. First search towards older,
- * then newer dives. */
 struct dive *find_next_visible_dive(timestamp_t when)
 {
 	int i, j;
@@ -1468,13 +1735,9 @@ struct dive *find_next_visible_dive(timestamp_t when)
 	if (!dive_table.nr)
 		return NULL;
 
-	/* we might want to use binary search here */
-	for (i = 0; i < dive_table.nr; i++) {
-		if (when <= get_dive(i)->when)
-			break;
-	}
+	i = get_dive_idx_by_time(when);
 
-	for (j = i - 1; j > 0; j--) {
+	for (j = i - 1; j >= 0; j--) {
 		if (!get_dive(j)->hidden_by_filter)
 			return get_dive(j);
 	}
@@ -25,9 +25,12 @@ extern struct dive_table dive_table;
 #define DATAFORMAT_VERSION 3
 
 extern void update_cylinder_related_info(struct dive *);
+extern void update_all_cylinder_related_info(void);
 extern void mark_divelist_changed(bool);
 extern int unsaved_changes(void);
 extern int init_decompression(struct deco_state *ds, struct dive *dive);
+extern void invalidate_deco_cache(const struct dive *dive);
+extern void clear_deco_cache(void);
 
 /* divelist core logic functions */
 extern void process_loaded_dives();
@@ -47,12 +50,15 @@ extern char *get_dive_gas_string(const struct dive *dive);
 extern int dive_table_get_insertion_index(struct dive_table *table, struct dive *dive);
 extern void add_to_dive_table(struct dive_table *table, int idx, struct dive *dive);
 extern void insert_dive(struct dive_table *table, struct dive *d);
+extern void merge_into_dive_table(struct dive_table *table, struct dive **dives, int nr);
 extern void get_dive_gas(const struct dive *dive, int *o2_p, int *he_p, int *o2low_p);
+extern void get_dive_gas_cached(const struct dive *dive, int *o2_p, int *he_p, int *o2max_p);
 extern int get_divenr(const struct dive *dive);
 extern int remove_dive(const struct dive *dive, struct dive_table *table);
 extern bool filter_dive(struct dive *d, bool shown); /* returns true if status changed */
 extern int get_dive_nr_at_idx(int idx);
 extern void set_dive_nr_for_current_dive();
+extern int get_dive_idx_by_time(timestamp_t when);
 extern timestamp_t get_surface_interval(timestamp_t when);
 extern void delete_dive_from_table(struct dive_table *table, int idx);
 extern struct dive *find_next_visible_dive(timestamp_t when);
@@ -4,7 +4,13 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QTextStream>
+#include <QDebug>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <atomic>
 #include "divelogexportlogic.h"
+#include "dive.h"
 #include "errorhelper.h"
 #include "qthelper.h"
 #include "units.h"
@@ -19,6 +25,72 @@ static void file_copy_and_overwrite(const QString &fileName, const QString &newN
 	QFile::copy(fileName, newName);
 }
 
+/*
+ * The photos are copied on a few threads only: copying is limited by the
+ * disks, not by the CPU. Photos that were already exported before, i.e.
+ * have the same size and are not older than the original, are skipped.
+ */
+#define PHOTO_COPY_THREADS 4
+
+static void copyPhoto(const QString &fileName, const QString &newName)
+{
+	QFileInfo info(fileName), newInfo(newName);
+	if (newInfo.exists() && newInfo.size() == info.size() && newInfo.lastModified() >= info.lastModified())
+		return;
+	QFile file(newName);
+	if (file.exists())
+		file.remove();
+	if (!QFile::copy(fileName, newName))
+		qDebug() << "copy of" << fileName << "to" << newName << "failed";
+}
+
+static bool exportHTMLphotos(const QString &photosDirectory, bool selectedOnly, const std::function<bool(int, int)> &progress)
+{
+	// Photos with the same file name end up in the same file: the last one wins
+	QMap<QString, QString> photos;
+	int i;
+	struct dive *dive;
+	for_each_dive (i, dive) {
+		if (selectedOnly && !dive->selected)
+			continue;
+		FOR_EACH_PICTURE(dive) {
+			QString fileName = localFilePath(picture->filename);
+			photos.insert(photosDirectory + QFileInfo(fileName).fileName(), fileName);
+		}
+	}
+	if (photos.isEmpty())
+		return true;
+
+	QVector<QPair<QString, QString>> jobs;
+	for (auto it = photos.begin(); it != photos.end(); ++it)
+		jobs.append(qMakePair(it.value(), it.key()));
+	std::atomic<int> next(0), done(0);
+	std::atomic<bool> canceled(false);
+	auto copy = [&jobs, &next, &done, &canceled]() {
+		int idx;
+		while (!canceled && (idx = next++) < jobs.size()) {
+			copyPhoto(jobs[idx].first, jobs[idx].second);
+			++done;
+		}
+	};
+
+	QThreadPool pool;
+	pool.setMaxThreadCount(PHOTO_COPY_THREADS);
+	QVector<QFuture<void>> futures;
+	for (int t = 0; t < std::min(PHOTO_COPY_THREADS, jobs.size()); t++)
+		futures.append(QtConcurrent::run(&pool, copy));
+	for (QFuture<void> &future: futures) {
+		while (!future.isFinished()) {
+			if (!canceled && progress && progress(done, jobs.size()))
+				canceled = true;
+			QThread::msleep(20);
+		}
+	}
+	if (progress)
+		progress(done, jobs.size());
+	return !canceled;
+}
+
 static void exportHTMLsettings(const QString &filename, struct htmlExportSetting &hes)
 {
 	QString fontSize = hes.fontSize;
@@ -123,7 +195,7 @@ static void exportHTMLstatistics(const QString filename, struct htmlExportSettin
 
 }
 
-void exportHtmlInitLogic(const QString &filename, struct htmlExportSetting &hes)
+bool exportHtmlInitLogic(const QString &filename, struct htmlExportSetting &hes, const std::function<bool(int, int)> &photoProgress)
 {
 	QString photosDirectory;
 	QFile file(filename);
@@ -146,12 +218,14 @@ void exportHtmlInitLogic(const QString &filename, struct htmlExportSetting &hes)
 	exportHTMLstatistics(stat_file, hes);
 	export_translation(qPrintable(translation));
 
-	export_HTML(qPrintable(json_dive_data), qPrintable(photosDirectory), hes.selectedOnly, hes.listOnly);
+	export_HTML(qPrintable(json_dive_data), qPrintable(photosDirectory), hes.selectedOnly, hes.listOnly, hes.packedSamples);
+	if (hes.exportPhotos && !hes.listOnly && !exportHTMLphotos(photosDirectory, hes.selectedOnly, photoProgress))
+		return false;
 
 	QString searchPath = getSubsurfaceDataPath("theme");
 	if (searchPath.isEmpty()) {
 		report_error(qPrintable(gettextFromC::tr("Cannot find a folder called 'theme' in the standard locations")));
-		return;
+		return false;
 	}
 
 	searchPath += QDir::separator();
@@ -166,4 +240,5 @@ void exportHtmlInitLogic(const QString &filename, struct htmlExportSetting &hes)
 	file_copy_and_overwrite(searchPath + "jquery.min.js", exportFiles + "jquery.min.js");
 	file_copy_and_overwrite(searchPath + "jquery.jqplot.css", exportFiles + "jquery.jqplot.css");
 	file_copy_and_overwrite(searchPath + hes.themeFile, exportFiles + "theme.css");
+	return true;
 }
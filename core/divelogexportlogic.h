@@ -2,10 +2,13 @@
 #ifndef DIVELOGEXPORTLOGIC_H
 #define DIVELOGEXPORTLOGIC_H
 
+#include <functional>
+
 struct htmlExportSetting {
 	bool exportPhotos;
 	bool selectedOnly;
 	bool listOnly;
+	bool packedSamples;
 	QString fontFamily;
 	QString fontSize;
 	int themeSelection;
@@ -14,7 +17,11 @@ struct htmlExportSetting {
 	QString themeFile;
 };
 
-void exportHtmlInitLogic(const QString &filename, struct htmlExportSetting &hes);
+// The photos are copied in the background. The progress callback is called on the
+// calling thread with the number of copied photos and their total and returns
+// true to cancel. Returns false if the export was canceled.
+bool exportHtmlInitLogic(const QString &filename, struct htmlExportSetting &hes,
+			 const std::function<bool(int, int)> &photoProgress = {});
 
 #endif // DIVELOGEXPORTLOGIC_H
 
@@ -12,27 +12,37 @@
 
 struct dive_site_table dive_site_table;
 
+/* The table is kept sorted by uuid, see add_dive_site_to_table(). Returns
+ * the index of the first site with a uuid not lower than the given one. */
+static int dive_site_uuid_lower_bound(uint32_t uuid, const struct dive_site_table *ds_table)
+{
+	int lo = 0, hi = ds_table->nr;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (ds_table->dive_sites[mid]->uuid < uuid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
 int get_divesite_idx(const struct dive_site *ds, struct dive_site_table *ds_table)
 {
 	int i;
-	const struct dive_site *d;
 	// tempting as it may be, don't die when called with ds=NULL
-	if (ds)
-		for_each_dive_site(i, d, ds_table) {
-			if (d == ds)
-				return i;
-		}
-	return -1;
+	if (!ds)
+		return -1;
+	i = dive_site_uuid_lower_bound(ds->uuid, ds_table);
+	return i < ds_table->nr && ds_table->dive_sites[i] == ds ? i : -1;
 }
 
-// TODO: keep table sorted by UUID and do a binary search?
 struct dive_site *get_dive_site_by_uuid(uint32_t uuid, struct dive_site_table *ds_table)
 {
-	int i;
-	struct dive_site *ds;
-	for_each_dive_site (i, ds, ds_table)
-		if (ds->uuid == uuid)
-			return get_dive_site(i, ds_table);
+	int i = dive_site_uuid_lower_bound(uuid, ds_table);
+	if (i < ds_table->nr && ds_table->dive_sites[i]->uuid == uuid)
+		return ds_table->dive_sites[i];
 	return NULL;
 }
 
@@ -92,6 +102,24 @@ unsigned int get_distance(const location_t *loc1, const location_t *loc2)
 	return lrint(6371000 * c);
 }
 
+/*
+ * A lower bound of the distance in meters between two points at the given
+ * latitudes: the great circle distance is never shorter than the difference
+ * along the meridian. This is much cheaper than get_distance() and lets us
+ * skip sites that can't be close enough.
+ */
+static double latitude_distance(int32_t lat1, int32_t lat2)
+{
+	return 6371000 * fabs(udeg_to_radians(lat1 - lat2));
+}
+
+/* Is the site further away than min_distance, judged by the latitude alone?
+ * Allow one meter of slack, because get_distance() rounds. */
+static bool too_far_by_latitude(const location_t *loc1, const location_t *loc2, unsigned int min_distance)
+{
+	return latitude_distance(loc1->lat.udeg, loc2->lat.udeg) > (double)min_distance + 1.0;
+}
+
 /* find the closest one, no more than distance meters away - if more than one at same distance, pick the first */
 struct dive_site *get_dive_site_by_gps_proximity(const location_t *loc, int distance, struct dive_site_table *ds_table)
 {
@@ -100,6 +128,7 @@ struct dive_site *get_dive_site_by_gps_proximity(const location_t *loc, int dist
 	unsigned int cur_distance, min_distance = distance;
 	for_each_dive_site (i, ds, ds_table) {
 		if (dive_site_has_gps_location(ds) &&
+		    !too_far_by_latitude(&ds->location, loc, min_distance) &&
 		    (cur_distance = get_distance(&ds->location, loc)) < min_distance) {
 			min_distance = cur_distance;
 			res = ds;
@@ -108,6 +137,189 @@ struct dive_site *get_dive_site_by_gps_proximity(const location_t *loc, int dist
 	return res;
 }
 
+static int compare_gps_index_entries(const void *_a, const void *_b)
+{
+	const struct dive_site_gps_entry *a = _a, *b = _b;
+	if (a->lat != b->lat)
+		return a->lat < b->lat ? -1 : 1;
+	return a->idx - b->idx;
+}
+
+void build_dive_site_gps_index(struct dive_site_gps_index *index, struct dive_site_table *ds_table)
+{
+	int i;
+	struct dive_site *ds;
+
+	index->nr = 0;
+	index->entries = malloc((ds_table->nr + 1) * sizeof(struct dive_site_gps_entry));
+	if (!index->entries)
+		exit(1);
+	for_each_dive_site (i, ds, ds_table) {
+		if (!dive_site_has_gps_location(ds))
+			continue;
+		index->entries[index->nr].lat = ds->location.lat.udeg;
+		index->entries[index->nr].idx = i;
+		index->entries[index->nr].ds = ds;
+		index->nr++;
+	}
+	qsort(index->entries, index->nr, sizeof(struct dive_site_gps_entry), compare_gps_index_entries);
+}
+
+void free_dive_site_gps_index(struct dive_site_gps_index *index)
+{
+	free(index->entries);
+	index->entries = NULL;
+	index->nr = 0;
+}
+
+/* first entry with a latitude not lower than lat */
+static int gps_index_lower_bound(const struct dive_site_gps_index *index, int32_t lat)
+{
+	int lo = 0, hi = index->nr;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (index->entries[mid].lat < lat)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static void check_gps_entry(const struct dive_site_gps_entry *entry, const location_t *loc,
+			    unsigned int *min_distance, const struct dive_site_gps_entry **res)
+{
+	unsigned int cur_distance = get_distance(&entry->ds->location, loc);
+	if (cur_distance < *min_distance || (*res && cur_distance == *min_distance && entry->idx < (*res)->idx)) {
+		*min_distance = cur_distance;
+		*res = entry;
+	}
+}
+
+/*
+ * Same as get_dive_site_by_gps_proximity(), but only looks at the sites in
+ * the latitude band that can still contain a closer site.
+ */
+struct dive_site *get_dive_site_by_gps_proximity_indexed(const location_t *loc, int distance, const struct dive_site_gps_index *index)
+{
+	const struct dive_site_gps_entry *res = NULL;
+	unsigned int min_distance = distance;
+	int start = gps_index_lower_bound(index, loc->lat.udeg);
+	int i;
+
+	for (i = start; i < index->nr; i++) {
+		if (latitude_distance(index->entries[i].lat, loc->lat.udeg) > (double)min_distance + 1.0)
+			break;
+		check_gps_entry(&index->entries[i], loc, &min_distance, &res);
+	}
+	for (i = start - 1; i >= 0; i--) {
+		if (latitude_distance(index->entries[i].lat, loc->lat.udeg) > (double)min_distance + 1.0)
+			break;
+		check_gps_entry(&index->entries[i], loc, &min_distance, &res);
+	}
+	return res ? res->ds : NULL;
+}
+
+struct nearest_site {
+	unsigned int distance;
+	const struct dive_site_gps_entry *entry;
+};
+
+/* order by distance, if the same distance by position in the table */
+static bool nearer_site(const struct nearest_site *a, const struct nearest_site *b)
+{
+	if (a->distance != b->distance)
+		return a->distance < b->distance;
+	return a->entry->idx < b->entry->idx;
+}
+
+static int compare_nearest_sites(const void *_a, const void *_b)
+{
+	const struct nearest_site *a = _a, *b = _b;
+	return nearer_site(a, b) ? -1 : nearer_site(b, a) ? 1 : 0;
+}
+
+/* restore the max-heap property (farthest site on top) after replacing the entry at i */
+static void nearest_sift_down(struct nearest_site *heap, int n, int i)
+{
+	for (;;) {
+		int largest = i, l = 2 * i + 1, r = 2 * i + 2;
+		if (l < n && nearer_site(&heap[largest], &heap[l]))
+			largest = l;
+		if (r < n && nearer_site(&heap[largest], &heap[r]))
+			largest = r;
+		if (largest == i)
+			return;
+		struct nearest_site tmp = heap[i];
+		heap[i] = heap[largest];
+		heap[largest] = tmp;
+		i = largest;
+	}
+}
+
+static void nearest_sift_up(struct nearest_site *heap, int i)
+{
+	while (i > 0 && nearer_site(&heap[(i - 1) / 2], &heap[i])) {
+		struct nearest_site tmp = heap[i];
+		heap[i] = heap[(i - 1) / 2];
+		heap[(i - 1) / 2] = tmp;
+		i = (i - 1) / 2;
+	}
+}
+
+/*
+ * Find the k sites of the index that are nearest to loc and store them in res, ordered by
+ * distance. Returns the number of sites found, which is less than k if the index has fewer
+ * sites. The sites are visited in the order of their latitude difference to loc, so that the
+ * search stops once the latitude band can't contain a nearer site than the k found so far.
+ */
+int get_nearest_dive_sites_indexed(const location_t *loc, int k, const struct dive_site_gps_index *index, struct dive_site **res)
+{
+	struct nearest_site *heap;
+	int up, down, n = 0, i;
+
+	if (k > index->nr)
+		k = index->nr;
+	if (k <= 0)
+		return 0;
+	heap = malloc(k * sizeof(struct nearest_site));
+	if (!heap)
+		exit(1);
+
+	up = gps_index_lower_bound(index, loc->lat.udeg);
+	down = up - 1;
+	while (up < index->nr || down >= 0) {
+		const struct dive_site_gps_entry *entry;
+		struct nearest_site candidate;
+
+		if (down < 0 || (up < index->nr &&
+				 latitude_distance(index->entries[up].lat, loc->lat.udeg) <=
+				 latitude_distance(index->entries[down].lat, loc->lat.udeg)))
+			entry = &index->entries[up++];
+		else
+			entry = &index->entries[down--];
+		if (n == k && latitude_distance(entry->lat, loc->lat.udeg) > (double)heap[0].distance + 1.0)
+			break;
+
+		candidate.distance = get_distance(&entry->ds->location, loc);
+		candidate.entry = entry;
+		if (n < k) {
+			heap[n] = candidate;
+			nearest_sift_up(heap, n++);
+		} else if (nearer_site(&candidate, &heap[0])) {
+			heap[0] = candidate;
+			nearest_sift_down(heap, n, 0);
+		}
+	}
+
+	qsort(heap, n, sizeof(struct nearest_site), compare_nearest_sites);
+	for (i = 0; i < n; i++)
+		res[i] = heap[i].entry->ds;
+	free(heap);
+	return n;
+}
+
 int register_dive_site(struct dive_site *ds)
 {
 	return add_dive_site_to_table(ds, &dive_site_table);
@@ -315,16 +527,105 @@ static bool same_dive_site(const struct dive_site *a, const struct dive_site *b)
 	    && same_string(a->notes, b->notes);
 }
 
-struct dive_site *get_same_dive_site(const struct dive_site *site)
+struct dive_site *get_same_dive_site_in_table(const struct dive_site *site, struct dive_site_table *ds_table)
 {
 	int i;
 	struct dive_site *ds;
-	for_each_dive_site (i, ds, &dive_site_table)
+	for_each_dive_site (i, ds, ds_table)
 		if (same_dive_site(ds, site))
 			return ds;
 	return NULL;
 }
 
+struct dive_site *get_same_dive_site(const struct dive_site *site)
+{
+	return get_same_dive_site_in_table(site, &dive_site_table);
+}
+
+/* Only name and location are hashed, the probing compares the whole site */
+static uint32_t dive_site_hash_value(const struct dive_site *ds)
+{
+	const char *s = ds->name ?: "";
+	uint32_t hash = 2166136261u;
+
+	while (*s)
+		hash = (hash ^ (unsigned char)*s++) * 16777619u;
+	hash = (hash ^ (uint32_t)ds->location.lat.udeg) * 16777619u;
+	hash = (hash ^ (uint32_t)ds->location.lon.udeg) * 16777619u;
+	return hash;
+}
+
+/* Open addressing with linear probing, size is a power of two and at most half full */
+static struct dive_site **dive_site_hash_slot(struct dive_site **sites, unsigned int size, const struct dive_site *ds)
+{
+	unsigned int idx = dive_site_hash_value(ds) & (size - 1);
+
+	while (sites[idx] && !same_dive_site(sites[idx], ds))
+		idx = (idx + 1) & (size - 1);
+	return &sites[idx];
+}
+
+/*
+ * Of equal sites, only the first one is added. Thus, as with
+ * get_same_dive_site_in_table(), the first equal site is found.
+ */
+void add_to_dive_site_hash(struct dive_site_hash *hash, struct dive_site *ds)
+{
+	struct dive_site **slot;
+
+	if ((hash->nr + 1) * 2 > hash->size) {
+		unsigned int i, new_size = hash->size ? hash->size * 2 : 64;
+		struct dive_site **new_sites = calloc(new_size, sizeof(struct dive_site *));
+
+		if (!new_sites)
+			exit(1);
+		/* Sites may have been changed since they were added and be equal now */
+		hash->nr = 0;
+		for (i = 0; i < hash->size; i++) {
+			if (hash->sites[i]) {
+				slot = dive_site_hash_slot(new_sites, new_size, hash->sites[i]);
+				if (!*slot) {
+					*slot = hash->sites[i];
+					hash->nr++;
+				}
+			}
+		}
+		free(hash->sites);
+		hash->sites = new_sites;
+		hash->size = new_size;
+	}
+	slot = dive_site_hash_slot(hash->sites, hash->size, ds);
+	if (!*slot) {
+		*slot = ds;
+		hash->nr++;
+	}
+}
+
+void build_dive_site_hash(struct dive_site_hash *hash, struct dive_site_table *ds_table)
+{
+	int i;
+	struct dive_site *ds;
+
+	hash->size = hash->nr = 0;
+	hash->sites = NULL;
+	for_each_dive_site (i, ds, ds_table)
+		add_to_dive_site_hash(hash, ds);
+}
+
+void free_dive_site_hash(struct dive_site_hash *hash)
+{
+	free(hash->sites);
+	hash->sites = NULL;
+	hash->size = hash->nr = 0;
+}
+
+struct dive_site *get_same_dive_site_hashed(const struct dive_site *site, const struct dive_site_hash *hash)
+{
+	if (!hash->size)
+		return NULL;
+	return *dive_site_hash_slot(hash->sites, hash->size, site);
+}
+
 void merge_dive_site(struct dive_site *a, struct dive_site *b)
 {
 	if (!has_location(&a->location)) a->location = b->location;
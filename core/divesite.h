@@ -31,6 +31,33 @@ typedef struct dive_site_table {
 	struct dive_site **dive_sites;
 } dive_site_table_t;
 
+/*
+ * A snapshot of the sites of a table that have a GPS location, sorted by
+ * latitude, for callers that do many proximity queries against the same
+ * table, such as the dive site import. It is not updated when sites are
+ * added, removed or moved, so build it right before use and free it after.
+ */
+struct dive_site_gps_entry {
+	int32_t lat;
+	int idx;
+	struct dive_site *ds;
+};
+
+struct dive_site_gps_index {
+	int nr;
+	struct dive_site_gps_entry *entries;
+};
+
+/*
+ * A hash set of the sites of a table, to find the site equal to an imported
+ * one (see get_same_dive_site()) without comparing it to every site. Sites
+ * that are added to the table or changed afterwards have to be added again.
+ */
+struct dive_site_hash {
+	unsigned int size, nr;
+	struct dive_site **sites;
+};
+
 static const dive_site_table_t empty_dive_site_table = { 0, 0, (struct dive_site **)0 };
 
 extern struct dive_site_table dive_site_table;
@@ -66,7 +93,16 @@ struct dive_site *get_dive_site_by_name(const char *name, struct dive_site_table
 struct dive_site *get_dive_site_by_gps(const location_t *, struct dive_site_table *ds_table);
 struct dive_site *get_dive_site_by_gps_and_name(char *name, const location_t *, struct dive_site_table *ds_table);
 struct dive_site *get_dive_site_by_gps_proximity(const location_t *, int distance, struct dive_site_table *ds_table);
+void build_dive_site_gps_index(struct dive_site_gps_index *index, struct dive_site_table *ds_table);
+void free_dive_site_gps_index(struct dive_site_gps_index *index);
+struct dive_site *get_dive_site_by_gps_proximity_indexed(const location_t *, int distance, const struct dive_site_gps_index *index);
+int get_nearest_dive_sites_indexed(const location_t *loc, int k, const struct dive_site_gps_index *index, struct dive_site **res);
 struct dive_site *get_same_dive_site(const struct dive_site *);
+struct dive_site *get_same_dive_site_in_table(const struct dive_site *, struct dive_site_table *ds_table);
+void build_dive_site_hash(struct dive_site_hash *hash, struct dive_site_table *ds_table);
+void add_to_dive_site_hash(struct dive_site_hash *hash, struct dive_site *ds);
+void free_dive_site_hash(struct dive_site_hash *hash);
+struct dive_site *get_same_dive_site_hashed(const struct dive_site *, const struct dive_site_hash *hash);
 bool dive_site_is_empty(struct dive_site *ds);
 void copy_dive_site_taxonomy(struct dive_site *orig, struct dive_site *copy);
 void copy_dive_site(struct dive_site *orig, struct dive_site *copy);
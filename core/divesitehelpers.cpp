@@ -20,43 +20,46 @@
 #include <QUrlQuery>
 #include <QEventLoop>
 #include <QTimer>
-#include <memory>
+#include <QFile>
+#include <QSaveFile>
+#include <QHash>
+#include <functional>
+#include <cmath>
 
-/** Performs a REST get request to a service returning a JSON object. */
-static QJsonObject doAsyncRESTGetRequest(const QString& url, int msTimeout)
+// Coordinates are rounded to 1/100 degree (about 1 km) for the cache.
+// All locations in such a cell share a lookup.
+#define CACHE_CELLS_PER_DEGREE 100
+static const int maxConcurrentLookups = 4;
+static const int lookupTimeoutMsecs = 5000;
+
+// By making the QNetworkAccessManager local to this function, only one manager
+// exists for all geo-lookups and it is only initialized on first call.
+static QNetworkAccessManager &networkManager()
 {
-	// By making the QNetworkAccessManager static and local to this function,
-	// only one manager exists for all geo-lookups and it is only initialized
-	// on first call to this function.
 	static QNetworkAccessManager rgl;
-	QNetworkRequest request;
-	QEventLoop loop;
-	QTimer timer;
+	return rgl;
+}
 
+/** Starts a REST get request to a service returning a JSON object. */
+static QNetworkReply *startRESTGetRequest(const QString &url)
+{
+	QNetworkRequest request;
 	request.setRawHeader("Accept", "text/json");
 	request.setRawHeader("User-Agent", getUserAgent().toUtf8());
-	QObject::connect(&timer, SIGNAL(timeout()), &loop, SLOT(quit()));
-
 	request.setUrl(url);
+	QNetworkReply *reply = networkManager().get(request);
+	QTimer::singleShot(lookupTimeoutMsecs, reply, &QNetworkReply::abort);
+	return reply;
+}
 
-	// By using a std::unique_ptr<>, we can exit from the function at any point
-	// and the reply will be freed. Likewise, when overwriting the pointer with
-	// a new value. According to Qt's documentation it is fine the delete the
-	// reply as long as we're not in a slot connected to error() or finish().
-	std::unique_ptr<QNetworkReply> reply(rgl.get(request));
-	timer.setSingleShot(true);
-	QObject::connect(&*reply, SIGNAL(finished()), &loop, SLOT(quit()));
-	timer.start(msTimeout);
-	loop.exec();
-
-	if (!timer.isActive()) {
+/** Returns the JSON object of a finished REST request. */
+static QJsonObject getRESTReply(QNetworkReply *reply)
+{
+	QString url = reply->url().toString();
+	if (reply->error() == QNetworkReply::OperationCanceledError) {
 		report_error("timeout accessing %s", qPrintable(url));
-		QObject::disconnect(&*reply, SIGNAL(finished()), &loop, SLOT(quit()));
-		reply->abort();
 		return QJsonObject{};
 	}
-
-	timer.stop();
 	if (reply->error() > 0) {
 		report_error("got error accessing %s: %s", qPrintable(url), qPrintable(reply->errorString()));
 		return QJsonObject{};
@@ -76,34 +79,70 @@ static QJsonObject doAsyncRESTGetRequest(const QString& url, int msTimeout)
 	return jsonDoc.object();
 }
 
-/// Performs a reverse-geo-lookup of the coordinates and returns the taxonomy data.
-taxonomy_data reverseGeoLookup(degrees_t latitude, degrees_t longitude)
+// The cache maps language and rounded coordinates to an array of [category, value, origin] triples
+static QString cacheFileName()
 {
-	const QString geonamesNearbyURL = QStringLiteral("http://api.geonames.org/findNearbyJSON?lang=%1&lat=%2&lng=%3&radius=50&username=dirkhh");
-	const QString geonamesNearbyPlaceNameURL = QStringLiteral("http://api.geonames.org/findNearbyPlaceNameJSON?lang=%1&lat=%2&lng=%3&radius=50&username=dirkhh");
-	const QString geonamesOceanURL = QStringLiteral("http://api.geonames.org/oceanJSON?lang=%1&lat=%2&lng=%3&radius=50&username=dirkhh");
+	return QString(system_default_directory()) + "/geocoding.json";
+}
 
-	QString url;
+static QHash<QString, QJsonArray> &geoCache()
+{
+	static QHash<QString, QJsonArray> cache = [] {
+		QHash<QString, QJsonArray> res;
+		QFile f(cacheFileName());
+		if (!f.open(QIODevice::ReadOnly))
+			return res;
+		QJsonObject obj = QJsonDocument::fromJson(f.readAll()).object();
+		for (auto it = obj.begin(); it != obj.end(); ++it)
+			res.insert(it.key(), it.value().toArray());
+		return res;
+	}();
+	return cache;
+}
+
+static void saveGeoCache()
+{
 	QJsonObject obj;
-	taxonomy_data taxonomy = { 0, 0 };
+	const QHash<QString, QJsonArray> &cache = geoCache();
+	for (auto it = cache.begin(); it != cache.end(); ++it)
+		obj.insert(it.key(), it.value());
+	QSaveFile f(cacheFileName());
+	if (!f.open(QIODevice::WriteOnly))
+		return;
+	f.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+	f.commit();
+}
+
+static QString cacheKey(const QString &lang, const location_t &location)
+{
+	return QStringLiteral("%1:%2:%3").arg(lang)
+		.arg(lround(location.lat.udeg / 1000000.0 * CACHE_CELLS_PER_DEGREE))
+		.arg(lround(location.lon.udeg / 1000000.0 * CACHE_CELLS_PER_DEGREE));
+}
 
-	// check the oceans API to figure out the body of water
-	url = geonamesOceanURL.arg(getUiLanguage().section(QRegExp("[-_ ]"), 0, 0)).arg(latitude.udeg / 1000000.0).arg(longitude.udeg / 1000000.0);
-	obj = doAsyncRESTGetRequest(url, 5000); // 5 secs. timeout
-	QVariantMap oceanName = obj.value("ocean").toVariant().toMap();
-	if (oceanName["name"].isValid())
-		taxonomy_set_category(&taxonomy, TC_OCEAN, qPrintable(oceanName["name"].toString()), taxonomy_origin::GEOCODED);
-
-	// check the findNearbyPlaces API from geonames - that should give us country, state, city
-	url = geonamesNearbyPlaceNameURL.arg(getUiLanguage().section(QRegExp("[-_ ]"), 0, 0)).arg(latitude.udeg / 1000000.0).arg(longitude.udeg / 1000000.0);
-	obj = doAsyncRESTGetRequest(url, 5000); // 5 secs. timeout
-	QVariantList geoNames = obj.value("geonames").toVariant().toList();
-	if (geoNames.count() == 0) {
-		// check the findNearby API from geonames if the previous search came up empty - that should give us country, state, location
-		url = geonamesNearbyURL.arg(getUiLanguage().section(QRegExp("[-_ ]"), 0, 0)).arg(latitude.udeg / 1000000.0).arg(longitude.udeg / 1000000.0);
-		obj = doAsyncRESTGetRequest(url, 5000); // 5 secs. timeout
-		geoNames = obj.value("geonames").toVariant().toList();
+static QJsonArray taxonomyToJson(const taxonomy_data &taxonomy)
+{
+	QJsonArray res;
+	for (int i = 0; i < taxonomy.nr; ++i) {
+		const struct taxonomy &t = taxonomy.category[i];
+		res.append(QJsonArray{ t.category, QString(t.value), (int)t.origin });
 	}
+	return res;
+}
+
+static taxonomy_data taxonomyFromJson(const QJsonArray &array)
+{
+	taxonomy_data taxonomy = { 0, 0 };
+	for (const QJsonValue &v: array) {
+		QJsonArray t = v.toArray();
+		taxonomy_set_category(&taxonomy, (taxonomy_category)t[0].toInt(), qPrintable(t[1].toString()),
+				      (taxonomy_origin)t[2].toInt());
+	}
+	return taxonomy;
+}
+
+static void addGeoNames(taxonomy_data &taxonomy, const QVariantList &geoNames)
+{
 	if (geoNames.count() > 0) {
 		QVariantMap firstData = geoNames.at(0).toMap();
 
@@ -126,6 +165,144 @@ taxonomy_data reverseGeoLookup(degrees_t latitude, degrees_t longitude)
 		report_error("geonames.org did not provide reverse lookup information");
 		//qDebug() << "no reverse geo lookup; geonames returned\n" << fullReply;
 	}
+}
 
-	return taxonomy;
+// The lookup of a location goes through up to three requests
+enum LookupStep {
+	LOOKUP_OCEAN,		// The oceans API, to figure out the body of water
+	LOOKUP_PLACE_NAME,	// The findNearbyPlaces API, that should give us country, state, city
+	LOOKUP_NEARBY,		// The findNearby API, if the previous search came up empty
+	LOOKUP_DONE
+};
+
+struct GeoLookup {
+	location_t location;
+	LookupStep step;
+	taxonomy_data taxonomy;
+};
+
+static QString lookupUrl(const GeoLookup &lookup, const QString &lang)
+{
+	const QString geonamesNearbyURL = QStringLiteral("http://api.geonames.org/findNearbyJSON?lang=%1&lat=%2&lng=%3&radius=50&username=dirkhh");
+	const QString geonamesNearbyPlaceNameURL = QStringLiteral("http://api.geonames.org/findNearbyPlaceNameJSON?lang=%1&lat=%2&lng=%3&radius=50&username=dirkhh");
+	const QString geonamesOceanURL = QStringLiteral("http://api.geonames.org/oceanJSON?lang=%1&lat=%2&lng=%3&radius=50&username=dirkhh");
+	const QString &url = lookup.step == LOOKUP_OCEAN ? geonamesOceanURL :
+			     lookup.step == LOOKUP_PLACE_NAME ? geonamesNearbyPlaceNameURL : geonamesNearbyURL;
+	return url.arg(lang).arg(lookup.location.lat.udeg / 1000000.0).arg(lookup.location.lon.udeg / 1000000.0);
+}
+
+// Process the reply of the current step and go to the next one
+static void processLookupReply(GeoLookup &lookup, const QJsonObject &obj)
+{
+	switch (lookup.step) {
+	case LOOKUP_OCEAN: {
+		QVariantMap oceanName = obj.value("ocean").toVariant().toMap();
+		if (oceanName["name"].isValid())
+			taxonomy_set_category(&lookup.taxonomy, TC_OCEAN, qPrintable(oceanName["name"].toString()), taxonomy_origin::GEOCODED);
+		lookup.step = LOOKUP_PLACE_NAME;
+		break;
+	}
+	case LOOKUP_PLACE_NAME: {
+		QVariantList geoNames = obj.value("geonames").toVariant().toList();
+		if (geoNames.count() == 0) {
+			lookup.step = LOOKUP_NEARBY;
+			break;
+		}
+		addGeoNames(lookup.taxonomy, geoNames);
+		lookup.step = LOOKUP_DONE;
+		break;
+	}
+	case LOOKUP_NEARBY:
+		addGeoNames(lookup.taxonomy, obj.value("geonames").toVariant().toList());
+		lookup.step = LOOKUP_DONE;
+		break;
+	case LOOKUP_DONE:
+		break;
+	}
+}
+
+// Run the lookups, up to maxConcurrentLookups at a time, and wait until all are done
+static void runLookups(std::vector<GeoLookup> &lookups, const QString &lang)
+{
+	if (lookups.empty())
+		return;
+	QEventLoop loop;
+	size_t next = 0;
+	int running = 0;
+	std::function<void(size_t)> startRequest = [&](size_t idx) {
+		QNetworkReply *reply = startRESTGetRequest(lookupUrl(lookups[idx], lang));
+		QObject::connect(reply, &QNetworkReply::finished, &loop, [&, idx, reply]() {
+			processLookupReply(lookups[idx], getRESTReply(reply));
+			reply->deleteLater();
+			if (lookups[idx].step != LOOKUP_DONE) {
+				startRequest(idx);
+				return;
+			}
+			--running;
+			if (next < lookups.size()) {
+				++running;
+				startRequest(next++);
+			} else if (running == 0) {
+				loop.quit();
+			}
+		});
+	};
+	for (; next < lookups.size() && running < maxConcurrentLookups; ++next) {
+		++running;
+		startRequest(next);
+	}
+	loop.exec();
+}
+
+std::vector<taxonomy_data> reverseGeoLookup(const std::vector<location_t> &locations)
+{
+	QString lang = getUiLanguage().section(QRegExp("[-_ ]"), 0, 0);
+	QHash<QString, QJsonArray> &cache = geoCache();
+	std::vector<taxonomy_data> res(locations.size(), taxonomy_data{ 0, 0 });
+
+	// Take what we can from the cache and combine the lookups of nearby locations
+	std::vector<GeoLookup> lookups;
+	std::vector<QString> lookupKeys;
+	std::vector<int> locationLookups(locations.size(), -1);
+	QHash<QString, int> keyLookups;
+	for (size_t i = 0; i < locations.size(); ++i) {
+		QString key = cacheKey(lang, locations[i]);
+		auto it = cache.find(key);
+		if (it != cache.end()) {
+			res[i] = taxonomyFromJson(*it);
+			continue;
+		}
+		auto it2 = keyLookups.find(key);
+		if (it2 == keyLookups.end()) {
+			it2 = keyLookups.insert(key, (int)lookups.size());
+			lookups.push_back({ locations[i], LOOKUP_OCEAN, { 0, 0 } });
+			lookupKeys.push_back(key);
+		}
+		locationLookups[i] = *it2;
+	}
+
+	runLookups(lookups, lang);
+
+	for (size_t i = 0; i < locations.size(); ++i) {
+		if (locationLookups[i] >= 0)
+			copy_taxonomy(&lookups[locationLookups[i]].taxonomy, &res[i]);
+	}
+	// Only cache successful lookups, so that failures are retried next time
+	bool changed = false;
+	for (size_t i = 0; i < lookups.size(); ++i) {
+		if (lookups[i].taxonomy.nr > 0) {
+			cache.insert(lookupKeys[i], taxonomyToJson(lookups[i].taxonomy));
+			changed = true;
+		}
+		free_taxonomy(&lookups[i].taxonomy);
+	}
+	if (changed)
+		saveGeoCache();
+	return res;
+}
+
+/// Performs a reverse-geo-lookup of the coordinates and returns the taxonomy data.
+taxonomy_data reverseGeoLookup(degrees_t latitude, degrees_t longitude)
+{
+	return reverseGeoLookup(std::vector<location_t>{ { latitude, longitude } })[0];
 }
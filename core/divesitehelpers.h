@@ -4,9 +4,16 @@
 
 #include "taxonomy.h"
 #include "units.h"
+#include <vector>
 
 /// Performs a reverse geo-lookup and returns the data.
 /// It is up to the caller to merge the data with any existing data.
+/// The results are cached on disk for nearby coordinates.
 taxonomy_data reverseGeoLookup(degrees_t latitude, degrees_t longitude);
 
+/// Performs the reverse geo-lookups of multiple locations. Locations that are
+/// close to each other share a lookup and the lookups of different locations
+/// run concurrently. Returns the data in the order of the locations.
+std::vector<taxonomy_data> reverseGeoLookup(const std::vector<location_t> &locations);
+
 #endif // DIVESITEHELPERS_H
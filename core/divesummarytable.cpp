@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "divesummarytable.h"
+#include "dive.h"
+#include "divelist.h"
+
+DiveSummaryTable &DiveSummaryTable::instance()
+{
+	static DiveSummaryTable self;
+	return self;
+}
+
+DiveSummaryTable::DiveSummaryTable() : valid(false)
+{
+}
+
+void DiveSummaryTable::invalidate()
+{
+	valid = false;
+}
+
+static int gas_sort_value(const struct dive *d)
+{
+	int o2, he, o2max;
+	get_dive_gas_cached(d, &o2, &he, &o2max);
+	return he * 1000 + o2;
+}
+
+void DiveSummaryTable::update()
+{
+	// Dives may have been added or removed by code that doesn't go through the notifier
+	if (valid && (int)index.size() == dive_table.nr)
+		return;
+
+	int nr = dive_table.nr;
+	for (std::vector<int> &c: columns)
+		c.resize(nr);
+	index.clear();
+	index.reserve(nr);
+	for (int i = 0; i < nr; ++i) {
+		const struct dive *d = dive_table.dives[i];
+		columns[DEPTH][i] = d->maxdepth.mm;
+		columns[DURATION][i] = d->duration.seconds;
+		columns[SAC][i] = d->sac;
+		columns[WATER_TEMP][i] = d->watertemp.mkelvin;
+		columns[AIR_TEMP][i] = d->airtemp.mkelvin;
+		columns[WEIGHT][i] = total_weight(d);
+		columns[WATER_DENSITY][i] = d->user_salinity ? d->user_salinity : d->salinity;
+		columns[GAS][i] = gas_sort_value(d);
+		index.emplace(d, i);
+	}
+	valid = true;
+}
+
+const std::vector<int> &DiveSummaryTable::column(Column c)
+{
+	update();
+	return columns[c];
+}
+
+int DiveSummaryTable::value(const struct dive *d, Column c)
+{
+	update();
+	auto it = index.find(d);
+	return it != index.end() ? columns[c][it->second] : 0;
+}
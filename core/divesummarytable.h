@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: GPL-2.0
+// A table of numerical values of all dives, which are used by the filter and
+// for sorting. The values are stored column-wise in the order of the dive table,
+// so that filters can check a column for all dives in a tight loop instead of
+// recomputing the values from the dive structures.
+//
+// The table is invalidated by the DiveListNotifier and recalculated on the next
+// access. Therefore, it must only be accessed from the GUI thread.
+#ifndef DIVE_SUMMARY_TABLE_H
+#define DIVE_SUMMARY_TABLE_H
+
+#include <vector>
+#include <unordered_map>
+
+struct dive;
+
+class DiveSummaryTable {
+public:
+	enum Column {
+		DEPTH,
+		DURATION,
+		SAC,
+		WATER_TEMP,
+		AIR_TEMP,
+		WEIGHT,
+		WATER_DENSITY,
+		GAS,
+		NUM_COLUMNS
+	};
+
+	static DiveSummaryTable &instance();
+	void invalidate();
+	const std::vector<int> &column(Column c); // One value per dive in the dive table
+	int value(const struct dive *d, Column c); // Value of a single dive
+private:
+	DiveSummaryTable();
+	void update();
+
+	bool valid;
+	std::vector<int> columns[NUM_COLUMNS];
+	std::unordered_map<const struct dive *, int> index; // Index of a dive in the columns
+};
+
+#endif
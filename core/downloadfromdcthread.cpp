@@ -3,6 +3,7 @@
 #include "core/qthelper.h"
 #include "core/settings/qPrefDiveComputer.h"
 #include "core/divelist.h"
+#include "core/downloadstats.h"
 #include <QDebug>
 #if defined(Q_OS_ANDROID)
 #include "core/subsurface-string.h"
@@ -85,6 +86,7 @@ void DownloadThread::run()
 	const char *errorText;
 	import_thread_cancelled = false;
 	error.clear();
+	download_stats_reset();
 	if (!strcmp(internalData->vendor, "Uemis"))
 		errorText = do_uemis_import(internalData);
 	else
@@ -97,6 +99,9 @@ void DownloadThread::run()
 			error = tr("No new dives downloaded from dive computer");
 		qDebug() << "Finishing download thread:" << downloadTable.nr << "dives downloaded";
 	}
+	struct download_stats stats;
+	download_stats_get(&stats);
+	qDebug() << "Download statistics:" << formatDownloadStats(stats);
 	qPrefDiveComputer::set_vendor(internalData->vendor);
 	qPrefDiveComputer::set_product(internalData->product);
 	qPrefDiveComputer::set_device(internalData->devname);
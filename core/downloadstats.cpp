@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "downloadstats.h"
+#include "gettextfromc.h"
+
+#include <QElapsedTimer>
+#include <QMutex>
+
+static QMutex statsMutex;
+static download_stats stats;
+static uint64_t startTime;
+static uint64_t lastWrite;	// start of the last write that wasn't answered yet, 0 if none
+
+extern "C" uint64_t download_stats_now()
+{
+	static QElapsedTimer timer = [] { QElapsedTimer t; t.start(); return t; }();
+	return timer.nsecsElapsed() / 1000;
+}
+
+extern "C" void download_stats_reset()
+{
+	QMutexLocker lock(&statsMutex);
+	stats = download_stats();
+	startTime = download_stats_now();
+	lastWrite = 0;
+}
+
+extern "C" void download_stats_read(size_t bytes, uint64_t start)
+{
+	uint64_t now = download_stats_now();
+	QMutexLocker lock(&statsMutex);
+	stats.wait_time += now - start;
+	if (!bytes)
+		return;
+	stats.bytes_read += bytes;
+	stats.packets_read++;
+	if (lastWrite) {
+		uint64_t roundtrip = now - lastWrite;
+		stats.roundtrips++;
+		stats.roundtrip_time += roundtrip;
+		if (roundtrip > stats.roundtrip_max)
+			stats.roundtrip_max = roundtrip;
+		lastWrite = 0;
+	}
+}
+
+extern "C" void download_stats_write(size_t bytes, uint64_t start)
+{
+	QMutexLocker lock(&statsMutex);
+	if (!bytes)
+		return;
+	stats.bytes_written += bytes;
+	stats.packets_written++;
+	// the latency is measured from the first of several writes of a command
+	if (!lastWrite)
+		lastWrite = start;
+}
+
+extern "C" void download_stats_wait(uint64_t start)
+{
+	uint64_t now = download_stats_now();
+	QMutexLocker lock(&statsMutex);
+	stats.wait_time += now - start;
+}
+
+extern "C" void download_stats_phase(enum download_phase phase, uint64_t start)
+{
+	uint64_t time = download_stats_now() - start;
+	QMutexLocker lock(&statsMutex);
+	switch (phase) {
+	case DOWNLOAD_HEADER:
+		stats.header_time += time;
+		break;
+	case DOWNLOAD_SAMPLES:
+		stats.sample_time += time;
+		break;
+	case DOWNLOAD_QUEUE:
+		stats.queue_time += time;
+		break;
+	case DOWNLOAD_PROCESS:
+		stats.process_time += time;
+		break;
+	}
+}
+
+extern "C" void download_stats_dive()
+{
+	QMutexLocker lock(&statsMutex);
+	stats.dives++;
+}
+
+extern "C" void download_stats_get(struct download_stats *res)
+{
+	uint64_t now = download_stats_now();
+	QMutexLocker lock(&statsMutex);
+	*res = stats;
+	res->elapsed = now - startTime;
+}
+
+static QString ms(uint64_t usecs)
+{
+	return gettextFromC::tr("%1 ms").arg(usecs / 1000);
+}
+
+QString formatDownloadStats(const struct download_stats &s)
+{
+	double seconds = s.elapsed / 1e6;
+	QString res = gettextFromC::tr("%1 bytes/s, %2 packets read, %3 written")
+		.arg(seconds > 0.0 ? (qulonglong)(s.bytes_read / seconds) : 0)
+		.arg(s.packets_read)
+		.arg(s.packets_written);
+	if (s.roundtrips)
+		res += ", " + gettextFromC::tr("latency %1 (max %2)")
+			.arg(ms(s.roundtrip_time / s.roundtrips), ms(s.roundtrip_max));
+	res += ", " + gettextFromC::tr("waiting %1").arg(ms(s.wait_time));
+	if (s.dives)
+		res += ", " + gettextFromC::tr("%1 dives, parsing %2 per dive")
+			.arg(s.dives)
+			.arg(ms((s.header_time + s.sample_time) / s.dives));
+	if (s.queue_time)
+		res += ", " + gettextFromC::tr("waiting for the parser %1").arg(ms(s.queue_time));
+	if (s.process_time)
+		res += ", " + gettextFromC::tr("processing %1").arg(ms(s.process_time));
+	return res;
+}
@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef DOWNLOADSTATS_H
+#define DOWNLOADSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Counters of a dive computer download, to tell whether a slow download
+ * is caused by the transport, by the parsing or by our processing of the
+ * dives. All times are in microseconds. The counters are updated by the
+ * download thread and the parse worker and may be read at any time.
+ */
+struct download_stats {
+	uint64_t bytes_read, bytes_written;
+	uint64_t packets_read, packets_written;	// read() and write() calls that transferred data
+	uint64_t roundtrips;			// writes that were answered by the dive computer
+	uint64_t roundtrip_time, roundtrip_max;	// from a write to the first data read after it
+	uint64_t wait_time;			// blocked in read() and poll() of the transport
+	uint64_t dives;
+	uint64_t header_time;			// parsing the headers, in the download thread
+	uint64_t sample_time;			// parsing the samples, in the parse worker
+	uint64_t queue_time;			// waiting for the parse worker to catch up
+	uint64_t process_time;			// adding the downloaded dives to the log
+	uint64_t elapsed;			// since download_stats_reset()
+};
+
+enum download_phase {
+	DOWNLOAD_HEADER,
+	DOWNLOAD_SAMPLES,
+	DOWNLOAD_QUEUE,
+	DOWNLOAD_PROCESS
+};
+
+/* Monotonic time, the start argument of the functions below */
+extern uint64_t download_stats_now(void);
+extern void download_stats_reset(void);
+extern void download_stats_read(size_t bytes, uint64_t start);
+extern void download_stats_write(size_t bytes, uint64_t start);
+extern void download_stats_wait(uint64_t start);
+extern void download_stats_phase(enum download_phase phase, uint64_t start);
+extern void download_stats_dive(void);
+extern void download_stats_get(struct download_stats *stats);
+
+#ifdef __cplusplus
+}
+
+#include <QString>
+
+// One line for the download dialogs and the log
+QString formatDownloadStats(const struct download_stats &stats);
+#endif
+
+#endif // DOWNLOADSTATS_H
@@ -18,6 +18,7 @@
 #include "divelist.h"
 #include "subsurface-string.h"
 #include "table.h"
+#include "arena.h"
 
 /* Warning: this has strange semantics for C-code! Not the weightsystem object
  * is freed, but the data it references. The object itself is passed in by value.
@@ -25,13 +26,13 @@
  */
 void free_weightsystem(weightsystem_t ws)
 {
-	free((void *)ws.description);
+	arena_free((void *)ws.description);
 	ws.description = NULL;
 }
 
 void free_cylinder(cylinder_t c)
 {
-	free((void *)c.type.description);
+	arena_free((void *)c.type.description);
 	c.type.description = NULL;
 }
 
@@ -197,13 +198,26 @@ const char *gasname(struct gasmix gasmix)
 	return gas;
 }
 
-int gas_volume(const cylinder_t *cyl, pressure_t p)
+static int gas_volume_z(const cylinder_t *cyl, const struct gas_compressibility *z, pressure_t p)
 {
 	double bar = p.mbar / 1000.0;
-	double z_factor = gas_compressibility_factor(cyl->gasmix, bar);
+	double z_factor = compressibility_factor(z, bar);
 	return lrint(cyl->type.size.mliter * bar_to_atm(bar) / z_factor);
 }
 
+int gas_volume(const cylinder_t *cyl, pressure_t p)
+{
+	struct gas_compressibility z = get_gas_compressibility(cyl->gasmix);
+	return gas_volume_z(cyl, &z, p);
+}
+
+/* Same as gas_volume(cyl, start) - gas_volume(cyl, end) */
+int gas_volume_used(const cylinder_t *cyl, pressure_t start, pressure_t end)
+{
+	struct gas_compressibility z = get_gas_compressibility(cyl->gasmix);
+	return gas_volume_z(cyl, &z, start) - gas_volume_z(cyl, &z, end);
+}
+
 int find_best_gasmix_match(struct gasmix mix, const struct cylinder_table *cylinders)
 {
 	int i;
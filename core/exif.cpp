@@ -444,7 +444,10 @@ int easyexif::EXIFInfo::parseFrom(const unsigned char *buf, unsigned len) {
     return PARSE_EXIF_ERROR_CORRUPT;
   offs += 2;
 
-  return parseFromEXIFSegment(buf + offs, len - offs);
+  int res = parseFromEXIFSegment(buf + offs, len - offs);
+  if (this->ThumbnailLength)
+    this->ThumbnailOffset += offs;
+  return res;
 }
 
 int easyexif::EXIFInfo::parseFrom(const string &data) {
@@ -568,6 +571,14 @@ int easyexif::EXIFInfo::parseFromEXIFSegment(const unsigned char *buf,
     }
   }
 
+  // IFD0 is followed by the offset of IFD1, which describes the thumbnail
+  unsigned ifd1_offset = len;
+  if (offs + 4 <= len) {
+    unsigned next_ifd = parse_value<uint32_t>(buf + offs, alignIntel);
+    if (next_ifd)
+      ifd1_offset = tiff_header_start + next_ifd;
+  }
+
   // Jump to the EXIF SubIFD if it exists and parse all the information
   // there. Note that it's possible that the EXIF SubIFD doesn't exist.
   // The EXIF SubIFD contains most of the interesting information that a
@@ -823,6 +834,30 @@ int easyexif::EXIFInfo::parseFromEXIFSegment(const unsigned char *buf,
     }
   }
 
+  // Find the embedded JPEG thumbnail in IFD1, if any.
+  if (ifd1_offset + 2 <= len) {
+    offs = ifd1_offset;
+    int num_entries = parse_value<uint16_t>(buf + offs, alignIntel);
+    if (offs + 6 + 12 * num_entries <= len) {
+      unsigned thumbnail_offset = 0, thumbnail_length = 0;
+      offs += 2;
+      while (--num_entries >= 0) {
+        IFEntry result =
+            parseIFEntry(buf, offs, alignIntel, tiff_header_start, len);
+        offs += 12;
+        if (result.tag() == 0x201 && result.format() == 4)
+          thumbnail_offset = tiff_header_start + result.data();
+        else if (result.tag() == 0x202 && result.format() == 4)
+          thumbnail_length = result.data();
+      }
+      if (thumbnail_offset && thumbnail_length &&
+          thumbnail_offset < len && thumbnail_length <= len - thumbnail_offset) {
+        this->ThumbnailOffset = thumbnail_offset;
+        this->ThumbnailLength = thumbnail_length;
+      }
+    }
+  }
+
   return PARSE_EXIF_SUCCESS;
 }
 
@@ -855,6 +890,8 @@ void easyexif::EXIFInfo::clear() {
   MeteringMode = 0;
   ImageWidth = 0;
   ImageHeight = 0;
+  ThumbnailOffset = 0;
+  ThumbnailLength = 0;
 
   // Geolocation
   GeoLocation.Latitude = 0;
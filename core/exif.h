@@ -97,6 +97,8 @@ class EXIFInfo {
                                     // 5: multi-segment
   unsigned ImageWidth;              // Image width reported in EXIF data
   unsigned ImageHeight;             // Image height reported in EXIF data
+  unsigned ThumbnailOffset;         // Position of the embedded JPEG thumbnail in the parsed buffer
+  unsigned ThumbnailLength;         // Size of the embedded JPEG thumbnail, 0 if there is none
   struct Geolocation_t {            // GPS information embedded in file
     double Latitude;                  // Image latitude expressed as decimal
     double Longitude;                 // Image longitude expressed as decimal
@@ -18,6 +18,7 @@
 #include "qthelper.h"
 #include "import-csv.h"
 #include "parse.h"
+#include "trace.h"
 
 /* For SAMPLE_* */
 #include <libdivecomputer/parser.h>
@@ -38,6 +39,7 @@ int readfile(const char *filename, struct memblock *mem)
 
 	mem->buffer = NULL;
 	mem->size = 0;
+	mem->mapped = false;
 
 	fd = subsurface_open(filename, O_RDONLY | O_BINARY, 0);
 	if (fd < 0)
@@ -75,6 +77,47 @@ out:
 	return ret;
 }
 
+/* Smaller files are cheaper to just read */
+#define MAP_FILE_THRESHOLD (1024 * 1024)
+
+/*
+ * Like readfile(), but large files are mapped copy-on-write instead
+ * of copied into a malloc()ed buffer. The buffer is zero-terminated
+ * and may be modified in place just like the one from readfile(),
+ * but it has to be released with free_memblock().
+ */
+int map_file(const char *filename, struct memblock *mem)
+{
+	int fd;
+	struct stat st;
+	void *buf;
+
+	fd = subsurface_open(filename, O_RDONLY | O_BINARY, 0);
+	if (fd < 0)
+		return readfile(filename, mem);
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size < MAP_FILE_THRESHOLD ||
+	    (buf = subsurface_mmap(fd, st.st_size)) == NULL) {
+		close(fd);
+		return readfile(filename, mem);
+	}
+	close(fd);
+	mem->buffer = buf;
+	mem->size = st.st_size;
+	mem->mapped = true;
+	return mem->size;
+}
+
+void free_memblock(struct memblock *mem)
+{
+	if (mem->mapped)
+		subsurface_munmap(mem->buffer, mem->size);
+	else
+		free(mem->buffer);
+	mem->buffer = NULL;
+	mem->size = 0;
+	mem->mapped = false;
+}
+
 
 static void zip_read(struct zip_file *file, const char *filename, struct dive_table *table, struct trip_table *trips,
 		     struct dive_site_table *sites, filter_preset_table_t *filter_presets)
@@ -305,7 +348,24 @@ int check_git_sha(const char *filename, struct git_repository **git_p, const cha
 	return 1;
 }
 
-int parse_file(const char *filename, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites, filter_preset_table_t *filter_presets)
+/*
+ * Most parsers only write to the tables they are passed, so that several
+ * files can be parsed at the same time. Git repositories report progress
+ * to the UI and the OSTCtools and DataTrak files are decoded by
+ * libdivecomputer.c, which keeps the state of the current dive in
+ * globals. These have to be parsed one at a time on the UI thread.
+ */
+bool can_parse_file_concurrently(const char *filename)
+{
+	const char *fmt = strrchr(filename, '.');
+	size_t len = strlen(filename);
+
+	if (len && filename[len - 1] == ']')
+		return false;
+	return !fmt || (strcasecmp(fmt + 1, "DIVE") && strcasecmp(fmt + 1, "LOG"));
+}
+
+static int do_parse_file(const char *filename, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites, filter_preset_table_t *filter_presets)
 {
 	struct git_repository *git;
 	const char *branch = NULL;
@@ -324,7 +384,7 @@ int parse_file(const char *filename, struct dive_table *table, struct trip_table
 	if (git)
 		return git_load_dives(git, branch, table, trips, sites, filter_presets);
 
-	if ((ret = readfile(filename, &mem)) < 0) {
+	if ((ret = map_file(filename, &mem)) < 0) {
 		/* we don't want to display an error if this was the default file  */
 		if (same_string(filename, prefs.default_filename))
 			return 0;
@@ -337,7 +397,7 @@ int parse_file(const char *filename, struct dive_table *table, struct trip_table
 	fmt = strrchr(filename, '.');
 	if (fmt && (!strcasecmp(fmt + 1, "DB") || !strcasecmp(fmt + 1, "BAK") || !strcasecmp(fmt + 1, "SQL"))) {
 		if (!try_to_open_db(filename, &mem, table, trips, sites)) {
-			free(mem.buffer);
+			free_memblock(&mem);
 			return 0;
 		}
 	}
@@ -345,7 +405,7 @@ int parse_file(const char *filename, struct dive_table *table, struct trip_table
 	/* Divesoft Freedom */
 	if (fmt && (!strcasecmp(fmt + 1, "DLF"))) {
 		ret = parse_dlf_buffer(mem.buffer, mem.size, table, trips, sites);
-		free(mem.buffer);
+		free_memblock(&mem);
 		return ret;
 	}
 
@@ -356,26 +416,36 @@ int parse_file(const char *filename, struct dive_table *table, struct trip_table
 		char *wl_name = memcpy(calloc(t - filename + 1, 1), filename, t - filename);
 		wl_name = realloc(wl_name, strlen(wl_name) + 5);
 		wl_name = strcat(wl_name, ".add");
-		if((ret = readfile(wl_name, &wl_mem)) < 0) {
+		if((ret = map_file(wl_name, &wl_mem)) < 0) {
 			fprintf(stderr, "No file %s found. No WLog extensions.\n", wl_name);
 			ret = datatrak_import(&mem, NULL, table, trips, sites);
 		} else {
 			ret = datatrak_import(&mem, &wl_mem, table, trips, sites);
-			free(wl_mem.buffer);
+			free_memblock(&wl_mem);
 		}
-		free(mem.buffer);
+		free_memblock(&mem);
 		free(wl_name);
 		return ret;
 	}
 
 	/* OSTCtools */
 	if (fmt && (!strcasecmp(fmt + 1, "DIVE"))) {
-		free(mem.buffer);
-		ostctools_import(filename, table, trips, sites);
+		ostctools_import(filename, &mem, table, trips, sites);
+		free_memblock(&mem);
 		return 0;
 	}
 
 	ret = parse_file_buffer(filename, &mem, table, trips, sites, filter_presets);
-	free(mem.buffer);
+	free_memblock(&mem);
+	return ret;
+}
+
+int parse_file(const char *filename, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites, filter_preset_table_t *filter_presets)
+{
+	int ret;
+
+	TRACE_BEGIN("parse_file");
+	ret = do_parse_file(filename, table, trips, sites, filter_presets);
+	TRACE_END();
 	return ret;
 }
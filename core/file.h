@@ -6,10 +6,12 @@
 
 #include <sys/stat.h>
 #include <stdio.h>
+#include <stdbool.h>
 
 struct memblock {
 	void *buffer;
 	size_t size;
+	bool mapped;	// buffer was mapped by map_file(): free with free_memblock()
 };
 
 struct trip_table;
@@ -23,10 +25,13 @@ extern "C" {
 extern int try_to_open_cochran(const char *filename, struct memblock *mem, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites);
 extern int try_to_open_liquivision(const char *filename, struct memblock *mem, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites);
 extern int datatrak_import(struct memblock *mem, struct memblock *wl_mem, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites);
-extern void ostctools_import(const char *file, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites);
+extern void ostctools_import(const char *file, struct memblock *mem, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites);
 
 extern int readfile(const char *filename, struct memblock *mem);
+extern int map_file(const char *filename, struct memblock *mem);
+extern void free_memblock(struct memblock *mem);
 extern int parse_file(const char *filename, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites, filter_preset_table_t *filter_presets);
+extern bool can_parse_file_concurrently(const char *filename);
 extern int try_to_open_zip(const char *filename, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites, filter_preset_table_t *filter_presets);
 
 // Platform specific functions
@@ -39,6 +44,8 @@ extern int subsurface_access(const char *path, int mode);
 extern int subsurface_stat(const char* path, struct stat* buf);
 extern struct zip *subsurface_zip_open_readonly(const char *path, int flags, int *errorp);
 extern int subsurface_zip_close(struct zip *zip);
+extern void *subsurface_mmap(int fd, size_t size);
+extern void subsurface_munmap(void *addr, size_t size);
 
 #ifdef __cplusplus
 }
@@ -10,6 +10,7 @@
 #include "subsurface-string.h"
 #include "subsurface-time.h"
 #include <QDateTime>
+#include <climits>
 
 // We use the units enum only internally.
 // Therefore define it here, not in the header file.
@@ -797,93 +798,94 @@ uint64_t filter_constraint_get_multiple_choice(const filter_constraint &c)
 // the first matches the second according to a criterion (substring, starts-with, exact).
 using StrCheck = bool (*) (const QString &s1, const QString &s2);
 
-// Check if a string-list contains at least one string containing the second argument.
-// Comparison is non case sensitive and removes white space.
-static bool listContainsSuperstring(const QStringList &list, const QString &s, StrCheck strchk)
+static StrCheck get_string_check(const filter_constraint &c)
 {
-	return std::any_of(list.begin(), list.end(), [&s,strchk](const QString &s2)
-			   { return strchk(s2, s); } );
-}
-
-// Check whether any of the items of the first list is in the second list as a super string.
-// The mode is controlled by the second argument
-static bool check(const filter_constraint &c, const QStringList &list)
-{
-	StrCheck strchk =
-		c.string_mode == FILTER_CONSTRAINT_SUBSTRING ?
+	return	c.string_mode == FILTER_CONSTRAINT_SUBSTRING ?
 			[](const QString &s1, const QString &s2) { return s1.contains(s2, Qt::CaseInsensitive); } :
 		c.string_mode == FILTER_CONSTRAINT_STARTS_WITH ?
 			[](const QString &s1, const QString &s2) { return s1.startsWith(s2, Qt::CaseInsensitive); } :
 		/* FILTER_CONSTRAINT_EXACT */
 			[](const QString &s1, const QString &s2) { return s1.compare(s2, Qt::CaseInsensitive) == 0; };
+}
+
+// Does a string of a dive match any of the search strings of a string constraint?
+// Comparison is non case sensitive.
+static bool string_matches(const filter_constraint &c, StrCheck strchk, const QString &s)
+{
 	return std::any_of(c.data.string_list->begin(), c.data.string_list->end(),
-			   [&list, strchk](const QString &item)
-			   { return listContainsSuperstring(list, item, strchk); }) != c.negate;
+			   [&s, strchk](const QString &item) { return strchk(s, item); });
 }
 
+// The string constraints check whether any of the strings of the dive
+// matches any of the search strings. This is done without building lists
+// of strings and stops at the first match.
 static bool has_tags(const filter_constraint &c, const struct dive *d)
 {
-	QStringList dive_tags;
-	for (const tag_entry *tag = d->tag_list; tag; tag = tag->next)
-		dive_tags.push_back(QString(tag->tag->name).trimmed());
-	dive_tags.append(gettextFromC::tr(divemode_text_ui[d->dc.divemode]).trimmed());
-	return check(c, dive_tags);
+	StrCheck strchk = get_string_check(c);
+	for (const tag_entry *tag = d->tag_list; tag; tag = tag->next) {
+		if (string_matches(c, strchk, QString(tag->tag->name).trimmed()))
+			return !c.negate;
+	}
+	return string_matches(c, strchk, gettextFromC::tr(divemode_text_ui[d->dc.divemode]).trimmed()) != c.negate;
+}
+
+// Check the comma-separated names of a text field
+static bool names_match(const filter_constraint &c, StrCheck strchk, const char *names)
+{
+	for (const QString &s: QString(names).split(",", QString::SkipEmptyParts)) {
+		if (string_matches(c, strchk, s.trimmed()))
+			return true;
+	}
+	return false;
 }
 
 static bool has_people(const filter_constraint &c, const struct dive *d)
 {
-	QStringList dive_people;
-	for (const QString &s: QString(d->buddy).split(",", QString::SkipEmptyParts))
-		dive_people.push_back(s.trimmed());
-	for (const QString &s: QString(d->divemaster).split(",", QString::SkipEmptyParts))
-		dive_people.push_back(s.trimmed());
-	return check(c, dive_people);
+	StrCheck strchk = get_string_check(c);
+	return (names_match(c, strchk, d->buddy) || names_match(c, strchk, d->divemaster)) != c.negate;
 }
 
 static bool has_locations(const filter_constraint &c, const struct dive *d)
 {
-	QStringList diveLocations;
-	if (d->divetrip)
-		diveLocations.push_back(QString(d->divetrip->location).trimmed());
-
-	if (d->dive_site)
-		diveLocations.push_back(QString(d->dive_site->name).trimmed());
-
-	return check(c, diveLocations);
+	StrCheck strchk = get_string_check(c);
+	bool matches = (d->divetrip && string_matches(c, strchk, QString(d->divetrip->location).trimmed())) ||
+		       (d->dive_site && string_matches(c, strchk, QString(d->dive_site->name).trimmed()));
+	return matches != c.negate;
 }
 
 static bool has_weight_type(const filter_constraint &c, const struct dive *d)
 {
-	QStringList weightsystemTypes;
-	for (int i = 0; i < d->weightsystems.nr; ++i)
-		weightsystemTypes.push_back(d->weightsystems.weightsystems[i].description);
-
-	return check(c, weightsystemTypes);
+	StrCheck strchk = get_string_check(c);
+	for (int i = 0; i < d->weightsystems.nr; ++i) {
+		if (string_matches(c, strchk, QString(d->weightsystems.weightsystems[i].description)))
+			return !c.negate;
+	}
+	return c.negate;
 }
 
 static bool has_cylinder_type(const filter_constraint &c, const struct dive *d)
 {
-	QStringList cylinderTypes;
-	for (int i = 0; i < d->cylinders.nr; ++i)
-		cylinderTypes.push_back(d->cylinders.cylinders[i].type.description);
+	StrCheck strchk = get_string_check(c);
+	for (int i = 0; i < d->cylinders.nr; ++i) {
+		if (string_matches(c, strchk, QString(d->cylinders.cylinders[i].type.description)))
+			return !c.negate;
+	}
+	return c.negate;
+}
 
-	return check(c, cylinderTypes);
+static bool has_text(const filter_constraint &c, const char *text)
+{
+	return (text && string_matches(c, get_string_check(c), QString(text))) != c.negate;
 }
 
 static bool has_suits(const filter_constraint &c, const struct dive *d)
 {
-	QStringList diveSuits;
-	if (d->suit)
-		diveSuits.push_back(QString(d->suit));
-	return check(c, diveSuits);
+	return has_text(c, d->suit);
 }
 
 static bool has_notes(const filter_constraint &c, const struct dive *d)
 {
-	QStringList diveNotes;
-	if (d->notes)
-		diveNotes.push_back(QString(d->notes));
-	return check(c, diveNotes);
+	return has_text(c, d->notes);
 }
 
 static bool check_numerical_range(const filter_constraint &c, int v)
@@ -909,6 +911,39 @@ static bool check_numerical_range_non_zero(const filter_constraint &c, int v)
 	return check_numerical_range(c, v);
 }
 
+// And the results of a numerical constraint for the values of many dives into a status array.
+// The range mode is dispatched outside of the loops, so that the compiler can vectorize them.
+template <typename F>
+static void and_values(const int *values, int n, char *status, bool negate, bool non_zero, F check)
+{
+	for (int i = 0; i < n; ++i)
+		status[i] &= non_zero && values[i] == 0 ? negate : check(values[i]) != negate;
+}
+
+void filter_constraint_match_values(const filter_constraint &c, const int *values, int n, char *status)
+{
+	int from = c.data.numerical_range.from;
+	int to = c.data.numerical_range.to;
+	bool non_zero = c.type == FILTER_CONSTRAINT_SAC; // see check_numerical_range_non_zero()
+	switch (c.range_mode) {
+	case FILTER_CONSTRAINT_EQUAL:
+		and_values(values, n, status, c.negate, non_zero, [from](int v) { return v == from; });
+		break;
+	case FILTER_CONSTRAINT_LESS:
+		and_values(values, n, status, c.negate, non_zero, [to](int v) { return v <= to; });
+		break;
+	case FILTER_CONSTRAINT_GREATER:
+		and_values(values, n, status, c.negate, non_zero, [from](int v) { return v >= from; });
+		break;
+	case FILTER_CONSTRAINT_RANGE:
+		and_values(values, n, status, c.negate, non_zero, [from, to](int v) { return v >= from && v <= to; });
+		break;
+	default:
+		std::fill(status, status + n, 0);
+		break;
+	}
+}
+
 static long days_since_epoch(timestamp_t timestamp)
 {
 	return timestamp / (3600 * 24);
@@ -1082,3 +1117,132 @@ bool filter_constraint_match_dive(const filter_constraint &c, const struct dive
 	}
 	return false;
 }
+
+// The interval of values accepted by a non-negated numerical constraint
+static std::pair<int, int> numerical_interval(const filter_constraint &c)
+{
+	switch (c.range_mode) {
+	case FILTER_CONSTRAINT_EQUAL:
+		return { c.data.numerical_range.from, c.data.numerical_range.from };
+	case FILTER_CONSTRAINT_LESS:
+		return { INT_MIN, c.data.numerical_range.to };
+	case FILTER_CONSTRAINT_GREATER:
+		return { c.data.numerical_range.from, INT_MAX };
+	case FILTER_CONSTRAINT_RANGE:
+	default:
+		return { c.data.numerical_range.from, c.data.numerical_range.to };
+	}
+}
+
+// Do all dives that match the non-negated constraint c1 match the non-negated constraint c2?
+// Both constraints are of the same type.
+static bool positive_subset(const filter_constraint &c1, const filter_constraint &c2)
+{
+	if (filter_constraint_is_string(c1.type)) {
+		// An empty list matches all dives. A string constraint matches if any of the search
+		// strings matches, thus every search string of c1 must be more specific than one of c2.
+		if (c2.data.string_list->isEmpty())
+			return true;
+		if (c1.string_mode != c2.string_mode || c1.data.string_list->isEmpty())
+			return false;
+		StrCheck strchk = get_string_check(c1);
+		return std::all_of(c1.data.string_list->begin(), c1.data.string_list->end(),
+				   [&c2, strchk](const QString &s) { return string_matches(c2, strchk, s); });
+	}
+	if (filter_constraint_is_multiple_choice(c1.type))
+		return (c1.data.multiple_choice & ~c2.data.multiple_choice) == 0;
+	// Time of day is cyclic, timestamps are compared at different resolutions: only accept identical ranges.
+	if (!is_numerical_constraint(c1.type) || c1.type == FILTER_CONSTRAINT_TIME_OF_DAY)
+		return c1 == c2;
+	std::pair<int, int> i1 = numerical_interval(c1);
+	std::pair<int, int> i2 = numerical_interval(c2);
+	return i1.first > i1.second || (i1.first >= i2.first && i1.second <= i2.second);
+}
+
+bool filter_constraint_is_subset(const filter_constraint &c1, const filter_constraint &c2)
+{
+	if (c1 == c2)
+		return true;
+	if (c1.type != c2.type)
+		return false;
+	// An empty string list matches all dives, even if negated
+	if (filter_constraint_is_string(c2.type) && c2.data.string_list->isEmpty())
+		return true;
+	if (filter_constraint_is_string(c1.type) && c1.data.string_list->isEmpty())
+		return false;
+	if (c1.negate != c2.negate)
+		return false;
+	// For negated constraints the inclusion of the non-negated constraints is reversed
+	return c1.negate ? positive_subset(c2, c1) : positive_subset(c1, c2);
+}
+
+// Rough relative costs of checking a constraint on a dive
+static int constraint_cost(enum filter_constraint_type type)
+{
+	switch (type) {
+	case FILTER_CONSTRAINT_WEIGHT:
+	case FILTER_CONSTRAINT_LOGGED:
+	case FILTER_CONSTRAINT_PLANNED:
+	case FILTER_CONSTRAINT_TAGS:
+		return 2;
+	case FILTER_CONSTRAINT_LOCATION:
+	case FILTER_CONSTRAINT_WEIGHT_TYPE:
+	case FILTER_CONSTRAINT_CYLINDER_TYPE:
+	case FILTER_CONSTRAINT_SUIT:
+		return 5;
+	case FILTER_CONSTRAINT_PEOPLE:
+		return 10;
+	case FILTER_CONSTRAINT_NOTES:
+		return 20;
+	default:
+		return 1;
+	}
+}
+
+compiled_filter_constraint::compiled_filter_constraint(const filter_constraint &c) : constraint(c),
+	cost(constraint_cost(c.type))
+{
+	std::fill(std::begin(divemodes), std::end(divemodes), false);
+	if (c.type != FILTER_CONSTRAINT_TAGS || c.data.string_list->isEmpty())
+		return;
+
+	// The tags of the dives have the ids of the tags in the global tag list. Check each of these tags once.
+	StrCheck strchk = get_string_check(c);
+	tags.assign(taglist_nr_global_ids(), -1);
+	for (const tag_entry *entry = g_tag_list; entry; entry = entry->next) {
+		if (entry->tag->id >= 0 && entry->tag->id < (int)tags.size())
+			tags[entry->tag->id] = string_matches(c, strchk, QString(entry->tag->name).trimmed());
+	}
+	for (int i = 0; i < NUM_DIVEMODE; ++i)
+		divemodes[i] = string_matches(c, strchk, gettextFromC::tr(divemode_text_ui[i]).trimmed());
+}
+
+// Same as has_tags(), but using the verdicts for the known tags and divemodes
+static bool has_compiled_tags(const compiled_filter_constraint &cc, const struct dive *d)
+{
+	const filter_constraint &c = cc.constraint;
+	int mode = (int)d->dc.divemode;
+	if (mode >= 0 && mode < NUM_DIVEMODE && cc.divemodes[mode])
+		return !c.negate;
+	StrCheck strchk = get_string_check(c);
+	for (const tag_entry *tag = d->tag_list; tag; tag = tag->next) {
+		int id = tag->tag->id;
+		// Tags that were created after compiling the constraint have to be checked by name
+		bool matches = id >= 0 && id < (int)cc.tags.size() && cc.tags[id] >= 0 ?
+			cc.tags[id] != 0 : string_matches(c, strchk, QString(tag->tag->name).trimmed());
+		if (matches)
+			return !c.negate;
+	}
+	return c.negate;
+}
+
+bool filter_constraint_match_dive(const compiled_filter_constraint &cc, const struct dive *d)
+{
+	const filter_constraint &c = cc.constraint;
+	if (filter_constraint_is_string(c.type) && c.data.string_list->isEmpty())
+		return true;
+
+	if (c.type == FILTER_CONSTRAINT_TAGS)
+		return has_compiled_tags(cc, d);
+	return filter_constraint_match_dive(c, d);
+}
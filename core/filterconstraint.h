@@ -5,11 +5,14 @@
 #define FILTER_CONSTRAINT_H
 
 #include "units.h"
+#include "divemode.h"
 
 struct dive;
+struct divetag;
 
 #ifdef __cplusplus
 #include <QStringList>
+#include <vector>
 extern "C" {
 #else
 typedef void QStringList;
@@ -148,6 +151,23 @@ void filter_constraint_set_timestamp_from(filter_constraint &c, timestamp_t from
 void filter_constraint_set_timestamp_to(filter_constraint &c, timestamp_t to); // convert according to current units (metric or imperial)
 void filter_constraint_set_multiple_choice(filter_constraint &c, uint64_t);
 bool filter_constraint_match_dive(const filter_constraint &c, const struct dive *d);
+// For numerical constraints: and the results for an array of values into a status array
+void filter_constraint_match_values(const filter_constraint &c, const int *values, int n, char *status);
+// Do all dives that match c1 also match c2? May return false if this can't be determined cheaply.
+bool filter_constraint_is_subset(const filter_constraint &c1, const filter_constraint &c2);
+
+// A filter constraint prepared for matching many dives. Tags are interned, therefore
+// whether a tag matches is determined once for every known tag. The string checks
+// don't build string lists and stop at the first match. The cost is a rough estimate
+// of the time a check takes and is used to order the constraints of a filter.
+struct compiled_filter_constraint {
+	filter_constraint constraint;
+	std::vector<signed char> tags; // Indexed by tag id: does the tag match? -1 if unknown
+	bool divemodes[NUM_DIVEMODE]; // Does the name of the divemode match?
+	int cost;
+	compiled_filter_constraint(const filter_constraint &c);
+};
+bool filter_constraint_match_dive(const compiled_filter_constraint &c, const struct dive *d);
 #endif
 
 #endif
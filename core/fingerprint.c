@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "fingerprint.h"
+#include "subsurface-string.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct fingerprint_table fingerprint_table;
+
+static struct fingerprint_record *find_fingerprint(const char *model, uint32_t deviceid)
+{
+	for (int i = 0; i < fingerprint_table.nr; i++) {
+		struct fingerprint_record *fp = &fingerprint_table.fingerprints[i];
+		if (fp->deviceid == deviceid && same_string(fp->model, model))
+			return fp;
+	}
+	return NULL;
+}
+
+const struct fingerprint_record *get_fingerprint(const char *model, uint32_t deviceid)
+{
+	return find_fingerprint(model, deviceid);
+}
+
+/* Replaces the fingerprint of the dive computer, if there is one already */
+void create_fingerprint_node(const char *model, uint32_t deviceid, uint32_t diveid,
+			     const unsigned char *data, unsigned int size)
+{
+	struct fingerprint_record *fp;
+	unsigned char *copy;
+
+	if (empty_string(model) || !data || !size)
+		return;
+	copy = malloc(size);
+	if (!copy)
+		return;
+	memcpy(copy, data, size);
+
+	fp = find_fingerprint(model, deviceid);
+	if (!fp) {
+		if (fingerprint_table.nr >= fingerprint_table.allocated) {
+			int allocated = (fingerprint_table.allocated + 4) * 3 / 2;
+			struct fingerprint_record *fingerprints = realloc(fingerprint_table.fingerprints,
+									  allocated * sizeof(struct fingerprint_record));
+			if (!fingerprints) {
+				free(copy);
+				return;
+			}
+			fingerprint_table.fingerprints = fingerprints;
+			fingerprint_table.allocated = allocated;
+		}
+		fp = &fingerprint_table.fingerprints[fingerprint_table.nr++];
+		fp->model = strdup(model);
+		fp->deviceid = deviceid;
+	} else {
+		free(fp->data);
+	}
+	fp->diveid = diveid;
+	fp->size = size;
+	fp->data = copy;
+}
+
+static int hex_digit(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+void create_fingerprint_node_from_hex(const char *model, uint32_t deviceid, uint32_t diveid, const char *hex)
+{
+	unsigned int size = hex ? strlen(hex) / 2 : 0;
+	unsigned char *data;
+
+	if (!size)
+		return;
+	data = malloc(size);
+	if (!data)
+		return;
+	for (unsigned int i = 0; i < size; i++) {
+		int hi = hex_digit(hex[2 * i]), lo = hex_digit(hex[2 * i + 1]);
+		if (hi < 0 || lo < 0) {
+			free(data);
+			return;
+		}
+		data[i] = (unsigned char)(hi << 4 | lo);
+	}
+	create_fingerprint_node(model, deviceid, diveid, data, size);
+	free(data);
+}
+
+/* Returns a newly allocated string */
+char *fingerprint_data_to_hex(const struct fingerprint_record *fp)
+{
+	static const char digits[] = "0123456789abcdef";
+	char *res = malloc(2 * fp->size + 1);
+
+	if (!res)
+		return NULL;
+	for (unsigned int i = 0; i < fp->size; i++) {
+		res[2 * i] = digits[fp->data[i] >> 4];
+		res[2 * i + 1] = digits[fp->data[i] & 0xf];
+	}
+	res[2 * fp->size] = 0;
+	return res;
+}
+
+void clear_fingerprint_table(void)
+{
+	for (int i = 0; i < fingerprint_table.nr; i++) {
+		free(fingerprint_table.fingerprints[i].model);
+		free(fingerprint_table.fingerprints[i].data);
+	}
+	free(fingerprint_table.fingerprints);
+	fingerprint_table.fingerprints = NULL;
+	fingerprint_table.nr = fingerprint_table.allocated = 0;
+}
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The libdivecomputer fingerprint of the newest downloaded dive of each
+ * dive computer, identified by model and device id. It is saved in the
+ * settings of the logbook, so that every instance of the app that opens
+ * the logbook can do incremental downloads. The fingerprint is only used
+ * if the logbook contains the dive with the given dive id, because the
+ * dive computer would skip all older dives.
+ */
+struct fingerprint_record {
+	char *model;
+	uint32_t deviceid;
+	uint32_t diveid;		/* of the fingerprinted dive */
+	unsigned int size;
+	unsigned char *data;
+};
+
+struct fingerprint_table {
+	int nr, allocated;
+	struct fingerprint_record *fingerprints;
+};
+
+extern struct fingerprint_table fingerprint_table;
+
+extern void create_fingerprint_node(const char *model, uint32_t deviceid, uint32_t diveid,
+				    const unsigned char *data, unsigned int size);
+extern void create_fingerprint_node_from_hex(const char *model, uint32_t deviceid, uint32_t diveid, const char *hex);
+extern const struct fingerprint_record *get_fingerprint(const char *model, uint32_t deviceid);
+extern char *fingerprint_data_to_hex(const struct fingerprint_record *fp);
+extern void clear_fingerprint_table(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FINGERPRINT_H
@@ -3,30 +3,52 @@
 #include "fulltext.h"
 #include "dive.h"
 #include "divesite.h"
+#include "memusage.h"
 #include "tag.h"
 #include "trip.h"
 #include "qthelper.h"
 #include <QLocale>
+#include <QFile>
+#include <QDataStream>
+#include <algorithm>
+#include <iterator>
 #include <map>
+#include <unordered_map>
 
 // This class caches each dives words, so that we can unregister a dive from the full text search
 struct full_text_cache {
 	std::vector<QString> words;
+	uint64_t hash; // Hash of the texts the words were created from
 };
 
 // The FullText-search class
 class FullText {
-	std::map<QString, std::vector<dive *>> words; // Dives that belong to each word
+	using WordMap = std::map<QString, std::vector<dive *>>;
+	WordMap words; // Dives that belong to each word
+	// Words loaded from a cache file, indexed by the hash of the texts of a dive.
+	// Only used by the next populate().
+	std::unordered_map<uint64_t, std::vector<QString>> cache;
+	QString cacheFile;
+	int cacheMisses;
+	// Words that contain each trigram, for substring searches. The entries point
+	// into the word map, which is node based and doesn't move its entries.
+	std::map<QString, std::vector<const WordMap::value_type *>> trigrams;
 public:
+	FullText();
 	void populate(); // Rebuild from current dive_table
 	void registerDive(struct dive *d); // Note: can be called repeatedly
 	void unregisterDive(struct dive *d); // Note: can be called repeatedly
 	void unregisterAll(); // Unregister all dives in the dive table
+	void loadCache(const QString &filename);
+	void saveCache(const QString &filename) const;
 	FullTextResult find(const FullTextQuery &q, StringFilterMode mode) const; // Find dives matchin all words.
 private:
 	void registerWords(struct dive *d, const std::vector<QString> &w);
 	void unregisterWords(struct dive *d, const std::vector<QString> &w);
+	void registerTrigrams(const WordMap::value_type &entry);
+	void unregisterTrigrams(const WordMap::value_type &entry);
 	std::vector<dive *> findDives(const QString &s, StringFilterMode mode) const; // Find dives matching a given word.
+	static void reportMemoryUsage(struct mem_usage *usage, void *data);
 };
 
 // This class doesn't depend on any other objects, we might just initialize it at startup.
@@ -56,6 +78,16 @@ void fulltext_populate()
 	self.populate();
 }
 
+void fulltext_load_cache(const char *filename)
+{
+	self.loadCache(QString::fromUtf8(filename));
+}
+
+void fulltext_save_cache(const char *filename)
+{
+	self.saveCache(QString::fromUtf8(filename));
+}
+
 } // extern "C"
 
 // C++-only interface functions
@@ -85,6 +117,40 @@ bool fulltext_dive_matches(const struct dive *d, const FullTextQuery &q, StringF
 
 // Class implementation
 
+FullText::FullText() : cacheMisses(0)
+{
+	memusage_register(MEM_FULLTEXT, &FullText::reportMemoryUsage, this);
+}
+
+static size_t words_size(const std::vector<QString> &words)
+{
+	size_t size = words.capacity() * sizeof(QString);
+	for (const QString &w: words)
+		size += w.capacity() * sizeof(QChar);
+	return size;
+}
+
+// The word and trigram maps, the words cached in the dives and the words loaded from the cache file
+void FullText::reportMemoryUsage(struct mem_usage *usage, void *data)
+{
+	const FullText *self = static_cast<const FullText *>(data);
+	size_t size = 0;
+	for (const auto &entry: self->words)
+		size += sizeof(entry) + entry.first.capacity() * sizeof(QChar) + entry.second.capacity() * sizeof(dive *);
+	for (const auto &entry: self->trigrams)
+		size += sizeof(entry) + entry.first.capacity() * sizeof(QChar) + entry.second.capacity() * sizeof(entry.second[0]);
+	for (const auto &entry: self->cache)
+		size += sizeof(entry.first) + words_size(entry.second);
+	int i;
+	struct dive *d;
+	for_each_dive (i, d) {
+		if (d->full_text)
+			size += sizeof(full_text_cache) + words_size(d->full_text->words);
+	}
+	usage->bytes = size;
+	usage->objects = (int)self->words.size();
+}
+
 // Take a text and tokenize it into words. Normalize the words to upper case
 // and add to a given list, if not already in list.
 // We might think about limiting the lower size of words we store.
@@ -115,34 +181,56 @@ static void tokenize(QString s, std::vector<QString> &res)
 	}
 }
 
-// Get all words of a dive
-static std::vector<QString> getWords(const dive *d)
+// Call a function on all texts of a dive that are indexed
+template <typename F>
+static void forEachText(const dive *d, F f)
 {
-	std::vector<QString> res;
-	tokenize(QString(d->notes), res);
-	tokenize(QString(d->divemaster), res);
-	tokenize(QString(d->buddy), res);
-	tokenize(QString(d->suit), res);
+	f(d->notes);
+	f(d->divemaster);
+	f(d->buddy);
+	f(d->suit);
 	for (const tag_entry *tag = d->tag_list; tag; tag = tag->next)
-		tokenize(QString(tag->tag->name), res);
+		f(tag->tag->name);
 	for (int i = 0; i < d->cylinders.nr; ++i) {
 		const cylinder_t &cyl = *get_cylinder(d, i);
-		tokenize(QString(cyl.type.description), res);
+		f(cyl.type.description);
 	}
 	for (int i = 0; i < d->weightsystems.nr; ++i) {
 		const weightsystem_t &ws = d->weightsystems.weightsystems[i];
-		tokenize(QString(ws.description), res);
+		f(ws.description);
 	}
 	// TODO: We should tokenize all dive-sites and trips first and then
 	// take the tokens from a cache.
 	if (d->dive_site)
-		tokenize(d->dive_site->name, res);
+		f(d->dive_site->name);
 	// TODO: We should index trips separately!
 	if (d->divetrip)
-		tokenize(d->divetrip->location, res);
+		f(d->divetrip->location);
+}
+
+// Get all words of a dive
+static std::vector<QString> getWords(const dive *d)
+{
+	std::vector<QString> res;
+	forEachText(d, [&res](const char *s) { tokenize(QString(s), res); });
 	return res;
 }
 
+// A 64-bit FNV-1a hash of the texts of a dive. The texts are terminated by
+// a zero byte, so that moving text from one field to another changes the hash.
+static uint64_t getTextHash(const dive *d)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	forEachText(d, [&hash](const char *s) {
+		for (const char *p = s ? s : ""; ; ++p) {
+			hash = (hash ^ (unsigned char)*p) * 1099511628211ULL;
+			if (!*p)
+				break;
+		}
+	});
+	return hash;
+}
+
 void FullText::populate()
 {
 	// we want this to be two calls as the second text is overwritten below by the lines starting with "\r"
@@ -150,20 +238,53 @@ void FullText::populate()
 	uiNotification(QObject::tr("start processing"));
 	int i;
 	dive *d;
+	cacheMisses = 0;
 	for_each_dive(i, d)
 		registerDive(d);
 	uiNotification(QObject::tr("%1 dives processed").arg(dive_table.nr));
+
+	// If dives had to be tokenized, update the cache file for the next start.
+	if (!cacheFile.isEmpty() && cacheMisses > 0)
+		saveCache(cacheFile);
+	cache.clear();
+	cacheFile.clear();
+}
+
+// Words that are in the first but not in the second list.
+static std::vector<QString> wordsNotIn(std::vector<QString> w1, std::vector<QString> w2)
+{
+	std::vector<QString> res;
+	std::sort(w1.begin(), w1.end());
+	std::sort(w2.begin(), w2.end());
+	std::set_difference(w1.begin(), w1.end(), w2.begin(), w2.end(), std::back_inserter(res));
+	return res;
 }
 
 void FullText::registerDive(struct dive *d)
 {
-	if (d->full_text) {
-		unregisterWords(d, d->full_text->words);
-	} else {
+	uint64_t hash = getTextHash(d);
+	if (!d->full_text) {
 		d->full_text = new full_text_cache;
+	} else if (d->full_text->hash == hash) {
+		// The indexed texts didn't change, for example because only the rating was edited.
+		return;
 	}
-	d->full_text->words = getWords(d);
-	registerWords(d, d->full_text->words);
+
+	std::vector<QString> newWords;
+	auto it = cache.find(hash);
+	if (it != cache.end()) {
+		newWords = it->second;
+	} else {
+		newWords = getWords(d);
+		++cacheMisses;
+	}
+
+	// Only touch the index for words that were added or removed. Usually
+	// an edit changes only a few words of a dive.
+	unregisterWords(d, wordsNotIn(d->full_text->words, newWords));
+	registerWords(d, wordsNotIn(newWords, d->full_text->words));
+	d->full_text->hash = hash;
+	d->full_text->words = std::move(newWords);
 }
 
 void FullText::unregisterDive(struct dive *d)
@@ -184,13 +305,88 @@ void FullText::unregisterAll()
 		d->full_text = nullptr;
 	}
 	words.clear();
+	trigrams.clear();
+}
+
+// The cache file is only valid for the same version and locale, since
+// the words are converted to upper case according to the locale.
+static const quint32 cacheMagic = 0x53534654; // "SSFT"
+static const qint32 cacheVersion = 1;
+
+void FullText::loadCache(const QString &filename)
+{
+	cache.clear();
+	cacheFile = filename;
+
+	QFile f(filename);
+	if (!f.open(QIODevice::ReadOnly))
+		return;
+	QDataStream stream(&f);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	quint32 magic, nr;
+	qint32 version;
+	QString locale;
+	stream >> magic >> version >> locale >> nr;
+	if (stream.status() != QDataStream::Ok || magic != cacheMagic || version != cacheVersion ||
+	    locale != QLocale().name())
+		return;
+	for (quint32 i = 0; i < nr; ++i) {
+		quint64 hash;
+		quint32 nr_words;
+		stream >> hash >> nr_words;
+		if (stream.status() != QDataStream::Ok)
+			break;
+		std::vector<QString> &entry = cache[hash];
+		entry.clear();
+		for (quint32 j = 0; j < nr_words && stream.status() == QDataStream::Ok; ++j) {
+			QString word;
+			stream >> word;
+			entry.push_back(word);
+		}
+	}
+	// Don't use anything of a corrupt cache file
+	if (stream.status() != QDataStream::Ok)
+		cache.clear();
+}
+
+void FullText::saveCache(const QString &filename) const
+{
+	// Collect the words of all registered dives. Dives with the same texts have the same words.
+	std::unordered_map<uint64_t, const std::vector<QString> *> entries;
+	int i;
+	dive *d;
+	for_each_dive(i, d) {
+		if (d->full_text)
+			entries.emplace(d->full_text->hash, &d->full_text->words);
+	}
+	// Nothing registered (yet): don't overwrite the cache file
+	if (entries.empty())
+		return;
+
+	QFile f(filename);
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return;
+	QDataStream stream(&f);
+	stream.setVersion(QDataStream::Qt_5_0);
+	stream << cacheMagic << cacheVersion << QLocale().name() << (quint32)entries.size();
+	for (const auto &entry: entries) {
+		stream << (quint64)entry.first << (quint32)entry.second->size();
+		for (const QString &word: *entry.second)
+			stream << word;
+	}
 }
 
 // Register words of a dive.
 void FullText::registerWords(struct dive *d, const std::vector<QString> &w)
 {
 	for (const QString &word: w) {
-		std::vector<dive *> &entry = words[word];
+		auto it = words.find(word);
+		if (it == words.end()) {
+			it = words.emplace(word, std::vector<dive *>()).first;
+			registerTrigrams(*it);
+		}
+		std::vector<dive *> &entry = it->second;
 		if (std::find(entry.begin(), entry.end(), d) == entry.end())
 			entry.push_back(d);
 	}
@@ -207,8 +403,50 @@ void FullText::unregisterWords(struct dive *d, const std::vector<QString> &w)
 		}
 		std::vector<dive *> &entry = it->second;
 		entry.erase(std::remove(entry.begin(), entry.end(), d));
-		if (entry.empty())
+		if (entry.empty()) {
+			unregisterTrigrams(*it);
 			words.erase(it);
+		}
+	}
+}
+
+// Get all different trigrams of a word. Words with less than three characters have none.
+static std::vector<QString> getTrigrams(const QString &word)
+{
+	std::vector<QString> res;
+	for (int i = 0; i + 3 <= word.size(); ++i) {
+		QString trigram = word.mid(i, 3);
+		if (std::find(res.begin(), res.end(), trigram) == res.end())
+			res.push_back(trigram);
+	}
+	return res;
+}
+
+// Add a word, which was newly added to the word map, to the trigram index.
+void FullText::registerTrigrams(const WordMap::value_type &entry)
+{
+	for (const QString &trigram: getTrigrams(entry.first))
+		trigrams[trigram].push_back(&entry);
+}
+
+// Remove a word, which is about to be removed from the word map, from the trigram index.
+void FullText::unregisterTrigrams(const WordMap::value_type &entry)
+{
+	for (const QString &trigram: getTrigrams(entry.first)) {
+		auto it = trigrams.find(trigram);
+		if (it == trigrams.end()) {
+			qWarning("FullText::unregisterTrigrams: didn't find trigram '%s' in index!?", qPrintable(trigram));
+			continue;
+		}
+		// The order of the words is irrelevant. Therefore, replace the removed word by the last word.
+		std::vector<const WordMap::value_type *> &list = it->second;
+		auto it2 = std::find(list.begin(), list.end(), &entry);
+		if (it2 != list.end()) {
+			*it2 = list.back();
+			list.pop_back();
+		}
+		if (list.empty())
+			trigrams.erase(it);
 	}
 }
 
@@ -248,11 +486,29 @@ std::vector<dive *> FullText::findDives(const QString &s, StringFilterMode mode)
 		return res;
 	}
 	case StringFilterMode::SUBSTRING: {
-		// Find all words that contain a substring. Here, we have to check all words!
+		// Find all words that contain a substring.
 		std::vector<dive *> res;
-		for (auto it = words.begin(); it != words.end(); ++it) {
-			if (it->first.contains(s))
-				combineDives(res, it->second);
+		if (s.size() < 3) {
+			// The substring is too short for the trigram index. Here, we have to check all words!
+			for (auto it = words.begin(); it != words.end(); ++it) {
+				if (it->first.contains(s))
+					combineDives(res, it->second);
+			}
+			return res;
+		}
+		// A word can only contain the substring if it contains all trigrams of the
+		// substring. Therefore, it is sufficient to check the words of the rarest trigram.
+		const std::vector<const WordMap::value_type *> *candidates = nullptr;
+		for (const QString &trigram: getTrigrams(s)) {
+			auto it = trigrams.find(trigram);
+			if (it == trigrams.end())
+				return {};
+			if (!candidates || it->second.size() < candidates->size())
+				candidates = &it->second;
+		}
+		for (const WordMap::value_type *entry: *candidates) {
+			if (entry->first.contains(s))
+				combineDives(res, entry->second);
 		}
 		return res;
 	}
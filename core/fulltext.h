@@ -9,6 +9,11 @@
 // To make this accessible from C, this does manual memory management:
 // Every dive is associated with a cache of words. Thus, when deleting
 // a dive, a function freeing that data has to be called.
+//
+// Tokenizing the dives is a substantial part of opening a big logbook.
+// Therefore, the words of the dives can be stored in a cache file. The
+// entries are keyed by a hash of the texts of the dive, so that only
+// dives whose texts changed have to be tokenized again.
 
 #ifndef FULLTEXT_H
 #define FULLTEXT_H
@@ -25,6 +30,8 @@ void fulltext_register(struct dive *d); // Note: can be called repeatedly
 void fulltext_unregister(struct dive *d); // Note: can be called repeatedly
 void fulltext_unregister_all(); // Unregisters all dives in the dive table
 void fulltext_populate(); // Registers all dives in the dive table
+void fulltext_load_cache(const char *filename); // Use the words of a cache file in the next fulltext_populate()
+void fulltext_save_cache(const char *filename); // Write the words of all registered dives to a cache file
 
 #ifdef __cplusplus
 }
@@ -5,12 +5,6 @@
 #include <stdlib.h>
 #include "dive.h"
 
-/* "Virial minus one" - the virial cubic form without the initial 1.0 */
-static double virial_m1(const double coeff[], double x)
-{
-	return x*coeff[0] + x*x*coeff[1] + x*x*x*coeff[2];
-}
-
 /*
  * Z = pV/nRT
  *
@@ -29,26 +23,45 @@ static double virial_m1(const double coeff[], double x)
  * NOTE! Helium coefficients are a linear mix operation between the
  * 323K and one for 273K isotherms, to make everything be at 300K.
  */
-double gas_compressibility_factor(struct gasmix gas, double bar)
+static const double o2_coefficients[3] = {
+	-7.18092073703e-04,
+	+2.81852572808e-06,
+	-1.50290620492e-09
+};
+static const double n2_coefficients[3] = {
+	-2.19260353292e-04,
+	+2.92844845532e-06,
+	-2.07613482075e-09
+};
+static const double he_coefficients[3] = {
+	+4.87320026468e-04,
+	-8.83632921053e-08,
+	+5.33304543646e-11
+};
+
+/*
+ * The polynomial is linear in the gas fractions, so the coefficients of
+ * the three gases can be mixed once per gas mix. What remains per pressure
+ * is a single cubic.
+ *
+ * The * 0.001 is because we do the linear mixing using the raw permille
+ * gas values. The 1.0 term is left out: the linear mixing of the three
+ * 1.0 terms is still 1.0 regardless of the gas mix.
+ */
+struct gas_compressibility get_gas_compressibility(struct gasmix gas)
 {
-	static const double o2_coefficients[3] = {
-		-7.18092073703e-04,
-		+2.81852572808e-06,
-		-1.50290620492e-09
-	};
-	static const double n2_coefficients[3] = {
-		-2.19260353292e-04,
-		+2.92844845532e-06,
-		-2.07613482075e-09
-	};
-	static const double he_coefficients[3] = {
-		+4.87320026468e-04,
-		-8.83632921053e-08,
-		+5.33304543646e-11
-	};
-	int o2, he;
-	double Z;
+	struct gas_compressibility res;
+	int o2 = get_o2(gas);
+	int he = get_he(gas);
+	int n2 = 1000 - o2 - he;
 
+	for (int i = 0; i < 3; i++)
+		res.coeff[i] = (o2_coefficients[i] * o2 + he_coefficients[i] * he + n2_coefficients[i] * n2) * 0.001;
+	return res;
+}
+
+double compressibility_factor(const struct gas_compressibility *z, double bar)
+{
 	/*
 	 * The curve fitting range is only [0,500] bar.
 	 * Anything else is way out of range for cylinder
@@ -57,21 +70,13 @@ double gas_compressibility_factor(struct gasmix gas, double bar)
 	if (bar < 0) bar = 0;
 	if (bar > 500) bar = 500;
 
-	o2 = get_o2(gas);
-	he = get_he(gas);
-
-	Z = virial_m1(o2_coefficients, bar) * o2 +
-	    virial_m1(he_coefficients, bar) * he +
-	    virial_m1(n2_coefficients, bar) * (1000 - o2 - he);
+	return 1.0 + bar * (z->coeff[0] + bar * (z->coeff[1] + bar * z->coeff[2]));
+}
 
-	/*
-	 * We add the 1.0 at the very end - the linear mixing of the
-	 * three 1.0 terms is still 1.0 regardless of the gas mix.
-	 *
-	 * The * 0.001 is because we did the linear mixing using the
-	 * raw permille gas values.
-	 */
-	return Z * 0.001 + 1.0;
+double gas_compressibility_factor(struct gasmix gas, double bar)
+{
+	struct gas_compressibility z = get_gas_compressibility(gas);
+	return compressibility_factor(&z, bar);
 }
 
 /* Compute the new pressure when compressing (expanding) volome v1 at pressure p1 bar to volume v2
@@ -79,9 +84,10 @@ double gas_compressibility_factor(struct gasmix gas, double bar)
 
 double isothermal_pressure(struct gasmix gas, double p1, int volume1, int volume2)
 {
-	double p_ideal = p1 * volume1 / volume2 / gas_compressibility_factor(gas, p1);
+	struct gas_compressibility z = get_gas_compressibility(gas);
+	double p_ideal = p1 * volume1 / volume2 / compressibility_factor(&z, p1);
 
-	return p_ideal * gas_compressibility_factor(gas, p_ideal);
+	return p_ideal * compressibility_factor(&z, p_ideal);
 }
 
 double gas_density(struct gasmix gas, int pressure)
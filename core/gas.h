@@ -26,6 +26,12 @@ struct icd_data { // This structure provides communication between function isob
 
 extern bool isobaric_counterdiffusion(struct gasmix oldgasmix, struct gasmix newgasmix, struct icd_data *results);
 
+/* The compressibility polynomial of one gas mix, for evaluating it at several pressures */
+struct gas_compressibility {
+	double coeff[3];
+};
+extern struct gas_compressibility get_gas_compressibility(struct gasmix gas);
+extern double compressibility_factor(const struct gas_compressibility *z, double bar);
 extern double gas_compressibility_factor(struct gasmix gas, double bar);
 extern double isothermal_pressure(struct gasmix gas, double p1, int volume1, int volume2);
 extern double gas_density(struct gasmix gas, int pressure);
@@ -11,11 +11,10 @@
  *                                  -> fill_missing_tank_pressures() -> fill_missing_segment_pressures()
  *                                                                   -> get_pr_interpolate_data()
  *
- *  The pr_track_t related functions below implement a linked list that is used by
- *  the majority of the functions below. The linked list covers a part of the dive profile
- *  for which there are no cylinder pressure data. Each element in the linked list
- *  represents a segment between two consecutive points on the dive profile.
- *  pr_track_t is defined in gaspressures.h
+ *  The pr_track_table is an array of pr_track_t that is used by the majority of the
+ *  functions below. The tracks cover the parts of the dive profile for which there
+ *  are no cylinder pressure data. Each track represents a segment between two
+ *  consecutive points on the dive profile and the tracks are ordered by time.
  */
 
 #include "ssrf.h"
@@ -24,6 +23,7 @@
 #include "profile.h"
 #include "gaspressures.h"
 #include "pref.h"
+#include "table.h"
 
 /*
  * simple structure to track the beginning and end tank pressure as
@@ -36,7 +36,13 @@ struct pr_track_struct {
 	int t_start;
 	int t_end;
 	int pressure_time;
-	pr_track_t *next;
+	int first_entry;	/* first plot entry at or after t_start */
+	int end_entry;		/* first plot entry at or after t_end, or pi->nr */
+};
+
+struct pr_track_table {
+	int nr, allocated;
+	pr_track_t *tracks;
 };
 
 typedef struct pr_interpolate_struct pr_interpolate_t;
@@ -49,61 +55,36 @@ struct pr_interpolate_struct {
 
 enum interpolation_strategy {SAC, TIME, CONSTANT};
 
-static pr_track_t *pr_track_alloc(int start, int t_start)
+static MAKE_GROW_TABLE(pr_track_table, pr_track_t, tracks)
+
+static pr_track_t *pr_track_add(struct pr_track_table *table, int start, int t_start)
 {
-	pr_track_t *pt = malloc(sizeof(pr_track_t));
+	pr_track_t *pt;
+
+	grow_pr_track_table(table);
+	pt = &table->tracks[table->nr++];
 	pt->start = start;
 	pt->end = 0;
 	pt->t_start = pt->t_end = t_start;
 	pt->pressure_time = 0;
-	pt->next = NULL;
+	pt->first_entry = pt->end_entry = 0;
 	return pt;
 }
 
-/* poor man's linked list */
-static pr_track_t *list_last(pr_track_t *list)
-{
-	pr_track_t *tail = list;
-	if (!tail)
-		return NULL;
-	while (tail->next) {
-		tail = tail->next;
-	}
-	return tail;
-}
-
-static pr_track_t *list_add(pr_track_t *list, pr_track_t *element)
-{
-	pr_track_t *tail = list_last(list);
-	if (!tail)
-		return element;
-	tail->next = element;
-	return list;
-}
-
-static void list_free(pr_track_t *list)
-{
-	if (!list)
-		return;
-	list_free(list->next);
-	free(list);
-}
-
 #ifdef DEBUG_PR_TRACK
-static void dump_pr_track(int cyl, pr_track_t *track_pr)
+static void dump_pr_track(int cyl, const struct pr_track_table *table)
 {
-	pr_track_t *list;
+	int i;
 
 	printf("cyl%d:\n", cyl);
-	list = track_pr;
-	while (list) {
+	for (i = 0; i < table->nr; i++) {
+		const pr_track_t *track = &table->tracks[i];
 		printf("   start %d end %d t_start %d:%02d t_end %d:%02d pt %d\n",
-		       mbar_to_PSI(list->start),
-		       mbar_to_PSI(list->end),
-		       FRACTION(list->t_start, 60),
-		       FRACTION(list->t_end, 60),
-		       list->pressure_time);
-		list = list->next;
+		       mbar_to_PSI(track->start),
+		       mbar_to_PSI(track->end),
+		       FRACTION(track->t_start, 60),
+		       FRACTION(track->t_end, 60),
+		       track->pressure_time);
 	}
 }
 #endif
@@ -126,24 +107,26 @@ static void dump_pr_track(int cyl, pr_track_t *track_pr)
  * segments according to how big of a time_pressure area
  * they have.
  */
-static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_strategy strategy)
+static void fill_missing_segment_pressures(struct pr_track_table *table, enum interpolation_strategy strategy)
 {
 	double magic;
+	int i = 0;
 
-	while (list) {
+	while (i < table->nr) {
+		pr_track_t *list = &table->tracks[i];
 		int start = list->start, end;
-		pr_track_t *tmp = list;
+		int last = i;
 		int pt_sum = 0, pt = 0;
 
 		for (;;) {
-			pt_sum += tmp->pressure_time;
-			end = tmp->end;
+			pt_sum += table->tracks[last].pressure_time;
+			end = table->tracks[last].end;
 			if (end)
 				break;
 			end = start;
-			if (!tmp->next)
+			if (last + 1 >= table->nr)
 				break;
-			tmp = tmp->next;
+			last++;
 		}
 
 		if (!start)
@@ -151,14 +134,14 @@ static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_
 
 		/*
 		 * Now 'start' and 'end' contain the pressure values
-		 * for the set of segments described by 'list'..'tmp'.
+		 * for the set of segments i..last.
 		 * pt_sum is the sum of all the pressure-times of the
 		 * segments.
 		 *
 		 * Now dole out the pressures relative to pressure-time.
 		 */
 		list->start = start;
-		tmp->end = end;
+		table->tracks[last].end = end;
 		switch (strategy) {
 		case SAC:
 			for (;;) {
@@ -168,15 +151,15 @@ static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_
 				if (pt_sum)
 					pressure -= lrint((start - end) * (double)pt / pt_sum);
 				list->end = pressure;
-				if (list == tmp)
+				if (i == last)
 					break;
-				list = list->next;
+				list = &table->tracks[++i];
 				list->start = pressure;
 			}
 			break;
 		case TIME:
-			if (list->t_end && (tmp->t_start - tmp->t_end)) {
-				magic = (list->t_start - tmp->t_end) / (tmp->t_start - tmp->t_end);
+			if (list->t_end && (table->tracks[last].t_start - table->tracks[last].t_end)) {
+				magic = (list->t_start - table->tracks[last].t_end) / (table->tracks[last].t_start - table->tracks[last].t_end);
 				list->end = lrint(start - (start - end) * magic);
 			} else {
 				list->end = start;
@@ -187,7 +170,7 @@ static void fill_missing_segment_pressures(pr_track_t *list, enum interpolation_
 		}
 
 		/* Ok, we've done that set of segments */
-		list = list->next;
+		i++;
 	}
 }
 
@@ -200,55 +183,75 @@ void dump_pr_interpolate(int i, pr_interpolate_t interpolate_pr)
 #endif
 
 
-static struct pr_interpolate_struct get_pr_interpolate_data(pr_track_t *segment, struct plot_info *pi, int cur)
+/*
+ * Find the plot entries corresponding to the start and end of each track.
+ * Both the tracks and the plot entries are ordered by time, so this is a
+ * single pass over the plot entries.
+ */
+static void find_track_entries(struct pr_track_table *table, const struct plot_info *pi)
+{
+	int i, idx = 0;
+
+	for (i = 0; i < table->nr; i++) {
+		pr_track_t *track = &table->tracks[i];
+
+		while (idx < pi->nr && pi->entry[idx].sec < track->t_start)
+			idx++;
+		track->first_entry = idx;
+		while (idx < pi->nr && pi->entry[idx].sec < track->t_end)
+			idx++;
+		track->end_entry = idx;
+	}
+}
+
+/* acc[i] is the summed pressure_time of the plot entries before entry i */
+static struct pr_interpolate_struct get_pr_interpolate_data(const pr_track_t *segment, const int *acc, int nr, int cur)
 { // cur = index to pi->entry corresponding to t_end of segment;
 	struct pr_interpolate_struct interpolate;
-	int i;
-	struct plot_data *entry;
+	int last = segment->end_entry < nr ? segment->end_entry : nr - 1;
+	int last_acc = segment->end_entry - 1 < cur ? segment->end_entry - 1 : cur;
 
 	interpolate.start = segment->start;
 	interpolate.end = segment->end;
-	interpolate.acc_pressure_time = 0;
-	interpolate.pressure_time = 0;
-
-	for (i = 0; i < pi->nr; i++) {
-		entry = pi->entry + i;
-
-		if (entry->sec < segment->t_start)
-			continue;
-		interpolate.pressure_time += entry->pressure_time;
-		if (entry->sec >= segment->t_end)
-			break;
-		if (i <= cur)
-			interpolate.acc_pressure_time += entry->pressure_time;
-	}
+	interpolate.pressure_time = segment->first_entry <= last ? acc[last + 1] - acc[segment->first_entry] : 0;
+	interpolate.acc_pressure_time = segment->first_entry <= last_acc ? acc[last_acc + 1] - acc[segment->first_entry] : 0;
 	return interpolate;
 }
 
-static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi, pr_track_t *track_pr, int cyl)
+static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi, struct pr_track_table *track_pr, int cyl)
 {
-	int i;
+	int i, seg;
 	struct plot_data *entry;
 	pr_interpolate_t interpolate = { 0, 0, 0, 0 };
-	pr_track_t *last_segment = NULL;
+	const pr_track_t *last_segment = NULL;
 	int cur_pr;
+	int *acc;
+	bool oc_gas = get_cylinder(dive, cyl)->cylinder_use == OC_GAS;
 	enum interpolation_strategy strategy;
 
 	/* no segment where this cylinder is used */
-	if (!track_pr)
+	if (!track_pr->nr)
 		return;
 
-	if (get_cylinder(dive, cyl)->cylinder_use == OC_GAS)
+	if (oc_gas)
 		strategy = SAC;
 	else
 		strategy = TIME;
 	fill_missing_segment_pressures(track_pr, strategy); // Interpolate the missing tank pressure values ..
-	cur_pr = track_pr->start;			       // in the pr_track_t lists of structures
-							       // and keep the starting pressure for each cylinder.
+	cur_pr = track_pr->tracks[0].start;		     // in the pr_track_t array
+							     // and keep the starting pressure for each cylinder.
 #ifdef DEBUG_PR_TRACK
 	dump_pr_track(cyl, track_pr);
 #endif
 
+	/* Accumulate the pressure_time of the plot entries, so that the pressure_time
+	 * of any range of entries can be read off without rescanning the profile. */
+	find_track_entries(track_pr, pi);
+	acc = malloc((pi->nr + 1) * sizeof(*acc));
+	acc[0] = 0;
+	for (i = 0; i < pi->nr; i++)
+		acc[i + 1] = acc[i] + pi->entry[i].pressure_time;
+
 	/* Transfer interpolated cylinder pressures from pr_track strucktures to plotdata
 	 * Go down the list of tank pressures in plot_info. Align them with the start &
 	 * end times of each profile segment represented by a pr_track_t structure. Get
@@ -256,12 +259,14 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 	 * interpolate the pressure where these do not exist in the plot_info pressure
 	 * variables. Pressure values are transferred from the pr_track_t structures
 	 * to the plot_info structure, allowing us to plot the tank pressure.
+	 * Since both are ordered by time, the matching segment only ever moves forward.
 	 *
 	 * The first two pi structures are "fillers", but in case we don't have a sample
 	 * at time 0 we need to process the second of them here, therefore i=1 */
+	seg = 0;
 	for (i = 1; i < pi->nr; i++) { // For each point on the profile:
 		double magic;
-		pr_track_t *segment;
+		const pr_track_t *segment;
 		int pressure;
 
 		entry = pi->entry + i;
@@ -275,13 +280,13 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 		}
 		// If there is NO valid pressure value..
 		// Find the pressure segment corresponding to this entry..
-		segment = track_pr;
-		while (segment && segment->t_end < entry->sec) // Find the track_pr with end time..
-			segment = segment->next;	       // ..that matches the plot_info time (entry->sec)
+		while (seg < track_pr->nr && track_pr->tracks[seg].t_end < entry->sec) // Find the track_pr with end time..
+			seg++;								// ..that matches the plot_info time (entry->sec)
 
 		// After last segment? All done.
-		if (!segment)
+		if (seg >= track_pr->nr)
 			break;
+		segment = &track_pr->tracks[seg];
 
 		// Before first segment, or between segments.. Go on, no interpolation.
 		if (segment->t_start > entry->sec)
@@ -298,11 +303,11 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 			interpolate.acc_pressure_time += entry->pressure_time;
 		} else {
 			// Set up an interpolation structure
-			interpolate = get_pr_interpolate_data(segment, pi, i);
+			interpolate = get_pr_interpolate_data(segment, acc, pi->nr, i);
 			last_segment = segment;
 		}
 
-		if(get_cylinder(dive, cyl)->cylinder_use == OC_GAS) {
+		if (oc_gas) {
 
 			/* if this segment has pressure_time, then calculate a new interpolated pressure */
 			if (interpolate.pressure_time) {
@@ -318,6 +323,7 @@ static void fill_missing_tank_pressures(struct dive *dive, struct plot_info *pi,
 		}
 		set_plot_pressure_data(pi, i, INTERPOLATED_PR, cyl, cur_pr); // and store the interpolated data in plot_info
 	}
+	free(acc);
 }
 
 
@@ -355,11 +361,11 @@ static void debug_print_pressures(struct plot_info *pi)
 
 /* This function goes through the list of tank pressures, of structure plot_info for the dive profile where each
  * item in the list corresponds to one point (node) of the profile. It finds values for which there are no tank
- * pressures (pressure==0). For each missing item (node) of tank pressure it creates a pr_track_alloc structure
- * that represents a segment on the dive profile and that contains tank pressures. There is a linked list of
- * pr_track_alloc structures for each cylinder. These pr_track_alloc structures ultimately allow for filling
+ * pressures (pressure==0). For each missing item (node) of tank pressure it adds a pr_track_t structure
+ * that represents a segment on the dive profile and that contains tank pressures. There is an array of
+ * pr_track_t structures for each cylinder. These pr_track_t structures ultimately allow for filling
  * the missing tank pressure values on the dive profile using the depth_pressure of the dive. To do this, it
- * calculates the summed pressure-time value for the duration of the dive and stores these * in the pr_track_alloc
+ * calculates the summed pressure-time value for the duration of the dive and stores these in the pr_track_t
  * structures. This function is called by create_plot_info_new() in profile.c
  */
 void populate_pressure_information(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, int sensor)
@@ -367,7 +373,7 @@ void populate_pressure_information(struct dive *dive, struct divecomputer *dc, s
 	UNUSED(dc);
 	int first, last, cyl;
 	cylinder_t *cylinder = get_cylinder(dive, sensor);
-	pr_track_t *track = NULL;
+	struct pr_track_table track = { 0 };
 	pr_track_t *current = NULL;
 	const struct event *ev, *b_ev;
 	int missing_pr = 0, dense = 1;
@@ -469,18 +475,17 @@ void populate_pressure_information(struct dive *dive, struct divecomputer *dc, s
 		// missing entries that need to be interpolated.
 		// Or maybe we didn't have a previous one at all,
 		// and this is the first pressure entry.
-		current = pr_track_alloc(pressure, entry->sec);
-		track = list_add(track, current);
+		current = pr_track_add(&track, pressure, entry->sec);
 		dense = 1;
 	}
 
 	if (missing_pr) {
-		fill_missing_tank_pressures(dive, pi, track, sensor);
+		fill_missing_tank_pressures(dive, pi, &track, sensor);
 	}
 
 #ifdef PRINT_PRESSURES_DEBUG
 	debug_print_pressures(pi);
 #endif
 
-	list_free(track);
+	free(track.tracks);
 }
@@ -27,6 +27,15 @@
 #include "git-access.h"
 #include "gettext.h"
 #include "sha1.h"
+#include "trace.h"
+
+/*
+ * Since version 1.7, libgit2 can fetch a limited depth of history. We use
+ * that to clone only the latest commit of the cloud storage.
+ */
+#if LIBGIT2_VER_MAJOR > 1 || (LIBGIT2_VER_MAJOR == 1 && LIBGIT2_VER_MINOR >= 7)
+#define HAVE_SHALLOW_CLONE 1
+#endif
 
 bool is_subsurface_cloud = false;
 
@@ -38,6 +47,7 @@ bool git_local_only = true;
 bool git_local_only = false;
 #endif
 bool git_remote_sync_successful = false;
+struct git_sync_timings git_sync_timings;
 
 
 int (*update_progress_cb)(const char *) = NULL;
@@ -112,10 +122,16 @@ static int transfer_progress_cb(const git_transfer_progress *stats, void *payloa
 	snprintf(buf, 100, "transfer cb rec_obj %d tot_obj %d idx_delta %d total_delta %d local obj %d", stats->received_objects, stats->total_objects, stats->indexed_deltas, stats->total_deltas, stats->local_objects);
 	return git_storage_update_progress(buf);
 	 */
+	git_sync_timings.fetch_bytes = stats->received_bytes;
 	if (done > last_done) {
+		int ret;
+
 		last_done = done;
 		snprintf(buf, sizeof(buf), translate("gettextFromC", "Transfer from storage (%d/%d)"), done, total);
-		return git_storage_update_progress(buf);
+		ret = git_storage_update_progress(buf);
+		if (ret)
+			git_sync_timings.cancelled = true;
+		return ret;
 	}
 	return 0;
 }
@@ -126,8 +142,12 @@ static int push_transfer_progress_cb(unsigned int current, unsigned int total, s
 	UNUSED(bytes);
 	UNUSED(payload);
 	char buf[80];
+	int ret;
 	snprintf(buf, sizeof(buf), translate("gettextFromC", "Transfer to storage (%d/%d)"), current, total);
-	return git_storage_update_progress(buf);
+	ret = git_storage_update_progress(buf);
+	if (ret)
+		git_sync_timings.cancelled = true;
+	return ret;
 }
 
 char *get_local_dir(const char *remote, const char *branch)
@@ -177,6 +197,8 @@ static int reset_to_remote(git_repository *repo, git_reference *local, const git
 	git_checkout_options opts = GIT_CHECKOUT_OPTIONS_INIT;
 	opts.progress_cb = &progress_cb;
 	git_object *target;
+	int64_t start;
+	int error;
 
 	if (verbose)
 		SSRF_INFO("git storage: reset to remote\n");
@@ -206,7 +228,10 @@ static int reset_to_remote(git_repository *repo, git_reference *local, const git
 			return report_error("Could not look up remote commit");
 	}
 	opts.checkout_strategy = GIT_CHECKOUT_SAFE;
-	if (git_reset(repo, target, GIT_RESET_HARD, &opts)) {
+	start = elapsed_msecs();
+	error = git_reset(repo, target, GIT_RESET_HARD, &opts);
+	git_sync_timings.checkout_ms += elapsed_msecs() - start;
+	if (error) {
 		SSRF_INFO("git storage: local head checkout failed after update");
 		if (is_subsurface_cloud)
 			return report_error(translate("gettextFromC", "Could not update local cache to newer remote data"));
@@ -344,14 +369,179 @@ static int update_remote(git_repository *repo, git_remote *origin, git_reference
 
 extern int update_git_checkout(git_repository *repo, git_object *parent, git_tree *tree);
 
+/*
+ * Resolve the conflicts of a merged index: a file that was removed on
+ * one side is removed, otherwise the conflict is simply marked as resolved.
+ * Returns true if there were conflicts.
+ */
+static bool resolve_git_conflicts(git_index *merged_index)
+{
+	int error;
+	const git_index_entry *ancestor = NULL,
+			*ours = NULL,
+			*theirs = NULL;
+	git_index_conflict_iterator *iter = NULL;
+
+	if (!git_index_has_conflicts(merged_index))
+		return false;
+	error = git_index_conflict_iterator_new(&iter, merged_index);
+	while (git_index_conflict_next(&ancestor, &ours, &theirs, iter)
+	       != GIT_ITEROVER) {
+		/* Mark this conflict as resolved */
+		SSRF_INFO("git storage: conflict in %s / %s / %s -- ",
+			ours ? ours->path : "-",
+			theirs ? theirs->path : "-",
+			ancestor ? ancestor->path : "-");
+		if ((!ours && theirs && ancestor) ||
+		    (ours && !theirs && ancestor)) {
+			// the file was removed on one side or the other - just remove it
+			SSRF_INFO("git storage: looks like a delete on one side; removing the file from the index\n");
+			error = git_index_remove(merged_index, ours ? ours->path : theirs->path, GIT_INDEX_STAGE_ANY);
+		} else if (ancestor) {
+			error = git_index_conflict_remove(merged_index, ours ? ours->path : theirs ? theirs->path : ancestor->path);
+		}
+		if (error) {
+			SSRF_INFO("git storage: error at conflict resolution (%s)", giterr_last()->message);
+		}
+	}
+	git_index_conflict_cleanup(merged_index);
+	git_index_conflict_iterator_free(iter);
+	return true;
+}
+
+/* Merge three trees with libgit2 and write the resulting tree */
+static int merge_git_trees(git_repository *repo, git_oid *result, git_tree *base, git_tree *local, git_tree *remote,
+			   const git_merge_options *merge_options, bool *conflicts)
+{
+	git_index *merged_index;
+	int ret;
+
+	if (git_merge_trees(&merged_index, repo, base, local, remote, merge_options))
+		return -1;
+	if (resolve_git_conflicts(merged_index))
+		*conflicts = true;
+	ret = git_index_write_tree_to(result, merged_index, repo);
+	git_index_free(merged_index);
+	return ret;
+}
+
+static bool same_git_entry(const git_tree_entry *a, const git_tree_entry *b)
+{
+	if (!a || !b)
+		return a == b;
+	return git_tree_entry_filemode(a) == git_tree_entry_filemode(b) &&
+	       git_oid_equal(git_tree_entry_id(a), git_tree_entry_id(b));
+}
+
+static bool is_tree_entry(const git_tree_entry *entry)
+{
+	return entry && git_tree_entry_filemode(entry) == GIT_FILEMODE_TREE;
+}
+
+static int merge_changed_subtrees(git_repository *repo, git_oid *result, git_tree *base, git_tree *local, git_tree *remote,
+				  const git_merge_options *merge_options, bool *conflicts);
+
+/* Merge the subdirectory "name" that was changed on both sides */
+static int merge_changed_subtree(git_repository *repo, git_oid *result, const git_tree_entry *b, const git_tree_entry *l,
+				 const git_tree_entry *r, const git_merge_options *merge_options, bool *conflicts)
+{
+	git_tree *base_tree = NULL, *local_tree = NULL, *remote_tree = NULL;
+	int ret = -1;
+
+	if ((b && git_tree_lookup(&base_tree, repo, git_tree_entry_id(b))) ||
+	    git_tree_lookup(&local_tree, repo, git_tree_entry_id(l)) ||
+	    git_tree_lookup(&remote_tree, repo, git_tree_entry_id(r)))
+		goto out;
+	ret = merge_changed_subtrees(repo, result, base_tree, local_tree, remote_tree, merge_options, conflicts);
+out:
+	git_tree_free(base_tree);
+	git_tree_free(local_tree);
+	git_tree_free(remote_tree);
+	return ret;
+}
+
+/*
+ * Merge the local and the remote tree by walking only the directories that
+ * were changed on both sides. Subdirectories that were changed on one side
+ * only are taken over as a whole, i.e. unchanged years, months and dives
+ * are never looked at. Only a directory in which the same file was changed
+ * on both sides is handed to libgit2 for a file level merge.
+ *
+ * If a directory was removed (or renamed) on one side and changed on the
+ * other, this returns 1: such a change might be moving a dive to another
+ * month and only a merge of the full trees with rename detection can
+ * follow it.
+ */
+static int merge_changed_subtrees(git_repository *repo, git_oid *result, git_tree *base, git_tree *local, git_tree *remote,
+				  const git_merge_options *merge_options, bool *conflicts)
+{
+	git_treebuilder *bld;
+	size_t i, nr;
+	int ret = 0;
+
+	if (git_treebuilder_new(&bld, repo, local))
+		return -1;
+	nr = git_tree_entrycount(remote);
+	for (i = 0; i < nr && !ret; i++) {
+		const git_tree_entry *r = git_tree_entry_byindex(remote, i);
+		const char *name = git_tree_entry_name(r);
+		const git_tree_entry *l = git_tree_entry_byname(local, name);
+		const git_tree_entry *b = base ? git_tree_entry_byname(base, name) : NULL;
+		git_oid merged;
+
+		if (same_git_entry(l, r) || same_git_entry(b, r))
+			continue;
+		if (same_git_entry(b, l)) {
+			ret = git_treebuilder_insert(NULL, bld, name, git_tree_entry_id(r), git_tree_entry_filemode(r));
+			continue;
+		}
+		if (!l)
+			ret = 1;
+		else if (!is_tree_entry(l) || !is_tree_entry(r) || (b && !is_tree_entry(b)))
+			goto file_merge;
+		else if (!(ret = merge_changed_subtree(repo, &merged, b, l, r, merge_options, conflicts)))
+			ret = git_treebuilder_insert(NULL, bld, name, &merged, GIT_FILEMODE_TREE);
+	}
+	nr = git_tree_entrycount(local);
+	for (i = 0; i < nr && !ret; i++) {
+		const git_tree_entry *l = git_tree_entry_byindex(local, i);
+		const char *name = git_tree_entry_name(l);
+		const git_tree_entry *b;
+
+		if (git_tree_entry_byname(remote, name))
+			continue;
+		b = base ? git_tree_entry_byname(base, name) : NULL;
+		if (!b)
+			continue;
+		if (!same_git_entry(b, l))
+			ret = 1;
+		else
+			ret = git_treebuilder_remove(bld, name);
+	}
+	if (!ret)
+		ret = git_treebuilder_write(result, bld);
+	git_treebuilder_free(bld);
+	return ret;
+
+file_merge:
+	git_treebuilder_free(bld);
+	return merge_git_trees(repo, result, base, local, remote, merge_options, conflicts);
+}
+
 static int try_to_git_merge(git_repository *repo, git_reference **local_p, git_reference *remote, git_oid *base, const git_oid *local_id, const git_oid *remote_id)
 {
 	UNUSED(remote);
 	git_tree *local_tree, *remote_tree, *base_tree;
 	git_commit *local_commit, *remote_commit, *base_commit;
-	git_index *merged_index;
 	git_merge_options merge_options;
+	git_oid merge_oid, commit_oid;
+	git_tree *merged_tree;
+	git_signature *author;
+	git_commit *commit;
 	struct membuffer msg = { 0, 0, NULL};
+	bool conflicts = false;
+	int64_t start;
+	int error;
 
 	if (verbose) {
 		char outlocal[41], outremote[41];
@@ -389,48 +579,20 @@ static int try_to_git_merge(git_repository *repo, git_reference **local_p, git_r
 		SSRF_INFO("git storage: remote storage and local data diverged. Error: failed base tree lookup (%s)", giterr_last()->message);
 		goto diverged_error;
 	}
-	if (git_merge_trees(&merged_index, repo, base_tree, local_tree, remote_tree, &merge_options)) {
+	error = merge_changed_subtrees(repo, &merge_oid, base_tree, local_tree, remote_tree, &merge_options, &conflicts);
+	if (error > 0) {
+		if (verbose)
+			SSRF_INFO("git storage: directories were moved, merging the full trees");
+		conflicts = false;
+		error = merge_git_trees(repo, &merge_oid, base_tree, local_tree, remote_tree, &merge_options, &conflicts);
+	}
+	if (error) {
 		SSRF_INFO("git storage: remote storage and local data diverged. Error: merge failed (%s)", giterr_last()->message);
 		// this is the one where I want to report more detail to the user - can't quite explain why
 		return report_error(translate("gettextFromC", "Remote storage and local data diverged. Error: merge failed (%s)"), giterr_last()->message);
 	}
-	if (git_index_has_conflicts(merged_index)) {
-		int error;
-		const git_index_entry *ancestor = NULL,
-				*ours = NULL,
-				*theirs = NULL;
-		git_index_conflict_iterator *iter = NULL;
-		error = git_index_conflict_iterator_new(&iter, merged_index);
-		while (git_index_conflict_next(&ancestor, &ours, &theirs, iter)
-		       != GIT_ITEROVER) {
-			/* Mark this conflict as resolved */
-			SSRF_INFO("git storage: conflict in %s / %s / %s -- ",
-				ours ? ours->path : "-",
-				theirs ? theirs->path : "-",
-				ancestor ? ancestor->path : "-");
-			if ((!ours && theirs && ancestor) ||
-			    (ours && !theirs && ancestor)) {
-				// the file was removed on one side or the other - just remove it
-				SSRF_INFO("git storage: looks like a delete on one side; removing the file from the index\n");
-				error = git_index_remove(merged_index, ours ? ours->path : theirs->path, GIT_INDEX_STAGE_ANY);
-			} else if (ancestor) {
-				error = git_index_conflict_remove(merged_index, ours ? ours->path : theirs ? theirs->path : ancestor->path);
-			}
-			if (error) {
-				SSRF_INFO("git storage: error at conflict resolution (%s)", giterr_last()->message);
-			}
-		}
-		git_index_conflict_cleanup(merged_index);
-		git_index_conflict_iterator_free(iter);
+	if (conflicts)
 		report_error(translate("gettextFromC", "Remote storage and local data diverged. Cannot combine local and remote changes"));
-	}
-	git_oid merge_oid, commit_oid;
-	git_tree *merged_tree;
-	git_signature *author;
-	git_commit *commit;
-
-	if (git_index_write_tree_to(&merge_oid, merged_index, repo))
-		goto write_error;
 	if (git_tree_lookup(&merged_tree, repo, &merge_oid))
 		goto write_error;
 	if (get_authorship(repo, &author) < 0)
@@ -444,10 +606,13 @@ static int try_to_git_merge(git_repository *repo, git_reference **local_p, git_r
 		goto write_error;
 	if (git_branch_is_head(*local_p) && !git_repository_is_bare(repo)) {
 		git_object *parent;
+
+		start = elapsed_msecs();
 		git_reference_peel(&parent, *local_p, GIT_OBJ_COMMIT);
-		if (update_git_checkout(repo, parent, merged_tree)) {
+		error = update_git_checkout(repo, parent, merged_tree);
+		git_sync_timings.checkout_ms += elapsed_msecs() - start;
+		if (error)
 			goto write_error;
-		}
 	}
 	if (git_reference_set_target(local_p, *local_p, &commit_oid, "Subsurface merge event"))
 		goto write_error;
@@ -479,6 +644,34 @@ static int cleanup_local_cache(const char *remote_url, const char *branch)
 	return -1;
 }
 
+#ifdef HAVE_SHALLOW_CLONE
+/*
+ * The cloud storage is cloned with only the latest commit. If a merge
+ * needs older commits, fetch the full history after all.
+ */
+static bool unshallow_repo(git_repository *repo, git_remote *origin, enum remote_transport rt)
+{
+	git_fetch_options opts = GIT_FETCH_OPTIONS_INIT;
+
+	if (!git_repository_is_shallow(repo))
+		return false;
+	SSRF_INFO("git storage: fetching the full history of the shallow local cache");
+	opts.callbacks.transfer_progress = &transfer_progress_cb;
+	auth_attempt = 0;
+	if (rt == RT_SSH)
+		opts.callbacks.credentials = credential_ssh_cb;
+	else if (rt == RT_HTTPS)
+		opts.callbacks.credentials = credential_https_cb;
+	opts.callbacks.certificate_check = certificate_check_cb;
+	opts.depth = GIT_FETCH_DEPTH_UNSHALLOW;
+	if (git_remote_fetch(origin, NULL, &opts, NULL)) {
+		SSRF_INFO("git storage: fetching the full history failed (%s)", giterr_last() ? giterr_last()->message : "unknown error");
+		return false;
+	}
+	return true;
+}
+#endif
+
 static int try_to_update(git_repository *repo, git_remote *origin, git_reference *local, git_reference *remote,
 			 const char *remote_url, const char *branch, enum remote_transport rt)
 {
@@ -514,7 +707,11 @@ static int try_to_update(git_repository *repo, git_remote *origin, git_reference
 		else
 			return report_error("Unable to get local or remote SHA1");
 	}
-	if (git_merge_base(&base, repo, local_id, remote_id)) {
+	if (git_merge_base(&base, repo, local_id, remote_id)
+#ifdef HAVE_SHALLOW_CLONE
+	    && (!unshallow_repo(repo, origin, rt) || git_merge_base(&base, repo, local_id, remote_id))
+#endif
+	    ) {
 		// TODO:
 		// if they have no merge base, they actually are different repos
 		// so instead merge this as merging a commit into a repo - git_merge() appears to do that
@@ -670,6 +867,7 @@ int sync_with_remote(git_repository *repo, const char *remote, const char *branc
 	git_remote *origin;
 	char *proxy_string;
 	git_config *conf;
+	int64_t start, phase_start;
 
 	if (git_local_only) {
 		if (verbose)
@@ -678,6 +876,8 @@ int sync_with_remote(git_repository *repo, const char *remote, const char *branc
 	}
 	if (verbose)
 		SSRF_INFO("git storage: sync with remote %s[%s]\n", remote, branch);
+	memset(&git_sync_timings, 0, sizeof(git_sync_timings));
+	start = elapsed_msecs();
 	git_storage_update_progress(translate("gettextFromC", "Sync with cloud storage"));
 	git_repository_config(&conf, repo);
 	if (rt == RT_HTTPS && getProxyString(&proxy_string)) {
@@ -704,13 +904,17 @@ int sync_with_remote(git_repository *repo, const char *remote, const char *branc
 		return 0;
 	}
 
-	if (is_subsurface_cloud && !canReachCloudServer()) {
+	TRACE_BEGIN("git connect");
+	bool reachable = !is_subsurface_cloud || canReachCloudServer();
+	TRACE_END();
+	if (!reachable) {
 		// this is not an error, just a warning message, so return 0
 		SSRF_INFO("git storage: cannot connect to remote server");
 		report_error("Cannot connect to cloud server, working with local copy");
 		git_storage_update_progress(translate("gettextFromC", "Can't reach cloud server, working with local data"));
 		return 0;
 	}
+	git_sync_timings.connect_ms = elapsed_msecs() - start;
 	if (verbose)
 		SSRF_INFO("git storage: fetch remote\n");
 	git_fetch_options opts = GIT_FETCH_OPTIONS_INIT;
@@ -722,10 +926,16 @@ int sync_with_remote(git_repository *repo, const char *remote, const char *branc
 		opts.callbacks.credentials = credential_https_cb;
 	opts.callbacks.certificate_check = certificate_check_cb;
 	git_storage_update_progress(translate("gettextFromC", "Successful cloud connection, fetch remote"));
+	phase_start = elapsed_msecs();
+	TRACE_BEGIN("git fetch");
 	error = git_remote_fetch(origin, NULL, &opts, NULL);
+	TRACE_END();
+	git_sync_timings.fetch_ms = elapsed_msecs() - phase_start;
 	// NOTE! A fetch error is not fatal, we just report it
 	if (error) {
-		if (is_subsurface_cloud)
+		if (git_sync_timings.cancelled)
+			report_error("Cloud sync cancelled, working with local data");
+		else if (is_subsurface_cloud)
 			report_error("Cannot sync with cloud server, working with offline copy");
 		else
 			report_error("Unable to fetch remote '%s'", remote);
@@ -735,13 +945,81 @@ int sync_with_remote(git_repository *repo, const char *remote, const char *branc
 		git_local_only = true;
 		error = 0;
 	} else {
+		phase_start = elapsed_msecs();
+		TRACE_BEGIN("git merge");
 		error = check_remote_status(repo, origin, remote, branch, rt);
+		TRACE_END();
+		git_sync_timings.merge_ms = elapsed_msecs() - phase_start - git_sync_timings.checkout_ms;
 	}
 	git_remote_free(origin);
 	git_storage_update_progress(translate("gettextFromC", "Done syncing with cloud storage"));
+	if (verbose)
+		SSRF_INFO("git storage: sync took %d ms: connect %d ms, fetch %d ms (%lu bytes), merge %d ms, checkout %d ms\n",
+			  (int)(elapsed_msecs() - start), git_sync_timings.connect_ms, git_sync_timings.fetch_ms,
+			  (unsigned long)git_sync_timings.fetch_bytes, git_sync_timings.merge_ms, git_sync_timings.checkout_ms);
 	return error;
 }
 
+/*
+ * Sync the local cache of "remote" with the remote, like opening it
+ * with is_git_repository() does, but without reloading the dives. This
+ * uses a repository handle of its own and, but for the sync status
+ * and git_local_only, no global data. Thus, it can run on a worker
+ * thread, as long as nobody else writes to the cache meanwhile.
+ */
+int sync_local_cache(const char *remote, const char *branch)
+{
+	char *localdir = get_local_dir(remote, branch);
+	git_repository *repo;
+	int error;
+
+	if (!localdir)
+		return -1;
+	error = git_repository_open(&repo, localdir);
+	free(localdir);
+	if (error)
+		return report_error("Unable to open git cache repository for %s", remote);
+	error = sync_with_remote(repo, remote, branch, url_to_remote_transport(remote));
+	git_repository_free(repo);
+	return error;
+}
+
+/*
+ * Put the branch of the local cache back to the commit "git_id"
+ * the dives were loaded from. This is used to save dives that were
+ * changed while the cache was synced: the new commit can then be
+ * merged with the synced state by the next sync. The synced commits
+ * stay reachable through the remote branch.
+ */
+int reset_local_cache(const char *remote, const char *branch, const char *git_id)
+{
+	char *localdir = get_local_dir(remote, branch);
+	git_checkout_options opts = GIT_CHECKOUT_OPTIONS_INIT;
+	git_repository *repo;
+	git_object *target;
+	git_oid id;
+	int error;
+
+	if (!localdir)
+		return -1;
+	error = git_repository_open(&repo, localdir);
+	free(localdir);
+	if (error)
+		return report_error("Unable to open git cache repository for %s", remote);
+	if (git_oid_fromstr(&id, git_id) || git_object_lookup(&target, repo, &id, GIT_OBJ_COMMIT)) {
+		git_repository_free(repo);
+		return report_error("Could not look up loaded commit in local cache");
+	}
+	opts.checkout_strategy = GIT_CHECKOUT_FORCE;
+	error = git_reset(repo, target, GIT_RESET_HARD, &opts);
+	git_object_free(target);
+	git_repository_free(repo);
+	if (error)
+		return report_error("Could not reset local cache to the loaded data");
+	set_git_id(&id);
+	return 0;
+}
+
 static git_repository *update_local_repo(const char *localdir, const char *remote, const char *branch, enum remote_transport rt)
 {
 	int error;
@@ -869,6 +1147,13 @@ static git_repository *create_local_repo(const char *localdir, const char *remot
 	opts.fetch_opts.callbacks.certificate_check = certificate_check_cb;
 
 	opts.checkout_branch = branch;
+#ifdef HAVE_SHALLOW_CLONE
+	// Each save to the cloud is a commit, so the history of a heavy user
+	// can be huge. Fetch only the current state; the history is fetched
+	// later if a merge ever needs it.
+	if (is_subsurface_cloud)
+		opts.fetch_opts.depth = 1;
+#endif
 	if (is_subsurface_cloud && !canReachCloudServer()) {
 		SSRF_INFO("git storage: cannot reach remote server");
 		return 0;
@@ -4,6 +4,8 @@
 
 #include "git2.h"
 #include "filterpreset.h"
+#include "divesite.h"
+#include "trip.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -19,16 +21,61 @@ struct git_repository;
 extern struct git_repository *is_git_repository(const char *filename, const char **branchp, const char **remote, bool dry_run);
 extern int check_git_sha(const char *filename, git_repository **git_p, const char **branch_p);
 extern int sync_with_remote(struct git_repository *repo, const char *remote, const char *branch, enum remote_transport rt);
+extern int sync_local_cache(const char *remote, const char *branch);
+extern int reset_local_cache(const char *remote, const char *branch, const char *git_id);
 extern int git_save_dives(struct git_repository *, const char *, const char *remote, bool select_only);
 extern int git_load_dives(struct git_repository *repo, const char *branch, struct dive_table *table, struct trip_table *trips,
 			  struct dive_site_table *sites, filter_preset_table_t *filter_presets);
+/* See git_load_dive_changes() */
+struct git_dive_changes {
+	struct dive_table dives;		/* New and changed dives */
+	struct trip_table trips;		/* Their trips */
+	struct dive_table removed;		/* Loaded dives that were removed or changed */
+	struct dive_site_table added_sites;	/* Already registered in dive_site_table */
+	struct dive_site_table changed_sites;	/* New data of loaded sites, not registered */
+};
+extern int git_load_dive_changes(struct git_repository *repo, const char *branch, const char *loaded_id, struct git_dive_changes *changes);
+extern void free_git_dive_changes(struct git_dive_changes *changes);
 extern const char *get_sha(git_repository *repo, const char *branch);
 extern int do_git_save(git_repository *repo, const char *branch, const char *remote, bool select_only, bool create_empty);
 extern const char *saved_git_id;
 extern bool git_local_only;
+extern bool git_lazy_samples;
+
+/*
+ * How the samples are written to a git repository. The text samples
+ * are part of the Divecomputer blobs, the binary samples (see
+ * samplecodec.h) are written to separate Samples blobs. Versions
+ * before the binary format only read the text samples, which the
+ * mixed format keeps for them.
+ * The format is a setting of the repository: loading a repository sets
+ * git_sample_format, unless git_sample_format_forced is set (on the
+ * command line). saved_git_sample_format is the format of the repository
+ * at saved_git_id: if git_sample_format differs, all dives are rewritten.
+ */
+enum git_sample_format {
+	GIT_SAMPLES_TEXT,
+	GIT_SAMPLES_BINARY,
+	GIT_SAMPLES_BINARY_AND_TEXT
+};
+extern enum git_sample_format git_sample_format, saved_git_sample_format;
+extern bool git_sample_format_forced;
 extern bool git_remote_sync_successful;
+
+/* The duration of the phases of the last sync_with_remote(), for diagnostics */
+struct git_sync_timings {
+	int connect_ms;		/* Proxy setup and reaching the server */
+	int fetch_ms;
+	size_t fetch_bytes;
+	int merge_ms;		/* Updating, merging and pushing the local branch, without the checkout */
+	int checkout_ms;
+	bool cancelled;		/* The progress callback asked to stop the transfer */
+};
+extern struct git_sync_timings git_sync_timings;
 extern void clear_git_id(void);
 extern void set_git_id(const struct git_oid *);
+extern void free_sample_repositories(void);
+extern void save_git_snapshot(struct git_repository *repo);
 extern enum remote_transport url_to_remote_transport(const char *remote);
 void set_git_update_cb(int(*)(const char *));
 int git_storage_update_progress(const char *text);
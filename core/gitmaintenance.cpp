@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "gitmaintenance.h"
+#include "git-access.h"
+#include "errorhelper.h"
+#include "qthelper.h"
+
+#include <QDir>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+
+// Repack if there seem to be more loose objects than that. Like git gc --auto,
+// we only count the objects in one of the 256 fan-out directories.
+#define LOOSE_OBJECT_LIMIT 2000
+// Or if there are more packs than that, since each lookup has to check all of them.
+#define PACK_LIMIT 20
+// Unreachable loose objects are only removed after this many days, like git gc does.
+#define PRUNE_EXPIRE_DAYS 14
+
+static int estimateLooseObjects(const QDir &objects)
+{
+	return (int)QDir(objects.filePath("17")).entryList(QDir::Files).size() * 256;
+}
+
+static QStringList packs(const QDir &objects)
+{
+	return QDir(objects.filePath("pack")).entryList(QStringList("pack-*.pack"), QDir::Files);
+}
+
+struct TimeBudget {
+	const QElapsedTimer &timer;
+	int max_msecs;
+};
+
+static int abortWhenOverBudget(const git_transfer_progress *, void *payload)
+{
+	const TimeBudget *budget = (const TimeBudget *)payload;
+	return budget->timer.elapsed() > budget->max_msecs;
+}
+
+// Write a pack with all objects reachable from HEAD and the refs. Returns
+// the name of the pack, or an empty string on failure.
+static QString writePack(git_repository *repo, QElapsedTimer &timer, int max_msecs)
+{
+	git_revwalk *walk;
+	git_packbuilder *pb;
+	QString name;
+
+	if (git_revwalk_new(&walk, repo))
+		return name;
+	if (git_packbuilder_new(&pb, repo)) {
+		git_revwalk_free(walk);
+		return name;
+	}
+	git_revwalk_push_head(walk);
+	git_revwalk_push_glob(walk, "refs/*");
+	TimeBudget budget { timer, max_msecs };
+	if (!git_packbuilder_insert_walk(pb, walk) && timer.elapsed() < max_msecs &&
+	    !git_packbuilder_write(pb, NULL, 0, &abortWhenOverBudget, &budget)) {
+		char hex[GIT_OID_HEXSZ + 1];
+		git_oid_tostr(hex, sizeof(hex), git_packbuilder_hash(pb));
+		name = QStringLiteral("pack-%1").arg(hex);
+		if (verbose)
+			SSRF_INFO("git storage: packed %lu objects into %s", (unsigned long)git_packbuilder_object_count(pb), qPrintable(name));
+	}
+	git_packbuilder_free(pb);
+	git_revwalk_free(walk);
+	return name;
+}
+
+// The pack contains all reachable objects. Thus, a loose object is either in
+// the pack and can be removed or it is unreachable. The latter are only removed
+// when they are old, in case they were just written by a running save.
+static int pruneLooseObjects(const QDir &objects, const QString &pack, QElapsedTimer &timer, int max_msecs)
+{
+	git_odb *odb;
+	git_odb_backend *backend;
+	int removed = 0;
+
+	if (git_odb_new(&odb))
+		return 0;
+	QByteArray index = QFile::encodeName(objects.filePath("pack/" + pack + ".idx"));
+	if (git_odb_backend_one_pack(&backend, index.constData()) || git_odb_add_backend(odb, backend, 1)) {
+		git_odb_free(odb);
+		return 0;
+	}
+	QDateTime expire = QDateTime::currentDateTime().addDays(-PRUNE_EXPIRE_DAYS);
+	QStringList fanout = objects.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+	for (const QString &dirName: fanout) {
+		if (dirName.size() != 2 || timer.elapsed() > max_msecs)
+			continue;
+		QDir dir(objects.filePath(dirName));
+		for (const QFileInfo &file: dir.entryInfoList(QDir::Files)) {
+			git_oid oid;
+			QByteArray hex = (dirName + file.fileName()).toLatin1();
+			if (hex.size() != GIT_OID_HEXSZ || git_oid_fromstr(&oid, hex.constData()))
+				continue;
+			if ((git_odb_exists(odb, &oid) || file.lastModified() < expire) && dir.remove(file.fileName()))
+				removed++;
+		}
+		dir.rmdir(dir.absolutePath());
+	}
+	git_odb_free(odb);
+	return removed;
+}
+
+// All reachable objects of the other packs are in the new one
+static void removeOldPacks(const QDir &objects, const QString &pack)
+{
+	QDir dir(objects.filePath("pack"));
+	for (const QString &old: packs(objects)) {
+		QString base = old.left(old.size() - 5);
+		if (base == pack || dir.exists(base + ".keep"))
+			continue;
+		// On Windows, this fails for packs that are still mapped by some
+		// repository. They will be removed the next time.
+		dir.remove(base + ".idx");
+		dir.remove(old);
+	}
+}
+
+int maintain_local_cache(const char *remote, const char *branch, int max_msecs)
+{
+	QElapsedTimer timer;
+	git_repository *repo;
+
+	timer.start();
+	char *localdir = get_local_dir(remote, branch);
+	if (!localdir)
+		return -1;
+	int error = git_repository_open(&repo, localdir);
+	free(localdir);
+	if (error)
+		return -1;
+	QDir objects(QFile::decodeName(git_repository_path(repo)) + "objects");
+	int loose = estimateLooseObjects(objects);
+	int nrPacks = packs(objects).size();
+	if (loose <= LOOSE_OBJECT_LIMIT && nrPacks <= PACK_LIMIT) {
+		git_repository_free(repo);
+		return 0;
+	}
+	QString pack = writePack(repo, timer, max_msecs);
+	// Close the repository before deleting files it may have opened
+	git_repository_free(repo);
+	if (pack.isEmpty()) {
+		SSRF_INFO("git storage: repacking the local cache failed or took longer than %d ms", max_msecs);
+		return -1;
+	}
+	int removed = pruneLooseObjects(objects, pack, timer, max_msecs);
+	removeOldPacks(objects, pack);
+	SSRF_INFO("git storage: repacked local cache (about %d loose objects, %d packs) in %d ms, removed %d loose objects",
+		  loose, nrPacks, (int)timer.elapsed(), removed);
+	return 0;
+}
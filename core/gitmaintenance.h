@@ -0,0 +1,15 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef GITMAINTENANCE_H
+#define GITMAINTENANCE_H
+
+// Every save creates new loose objects in the local cache of a remote git
+// repository. If there are many of them, repack all reachable objects of
+// the cache into a single pack and remove the packed and the expired loose
+// objects. Gives up when max_msecs are exceeded, which leaves a consistent,
+// if not fully packed, repository. Returns 0 if nothing had to be done or
+// the maintenance was successful.
+//
+// This must not run concurrently with other accesses to the same cache.
+int maintain_local_cache(const char *remote, const char *branch, int max_msecs);
+
+#endif
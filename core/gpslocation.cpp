@@ -14,21 +14,26 @@
 #include <QUrlQuery>
 #include <QApplication>
 #include <QTimer>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QSettings>
+#include <algorithm>
 
 GpsLocation *GpsLocation::m_Instance = NULL;
 
 GpsLocation::GpsLocation(void (*showMsgCB)(const char *), QObject *parent) :
 	QObject(parent),
 	m_GpsSource(0),
+	deadRecords(0),
 	waitingForPosition(false),
 	haveSource(UNKNOWN)
 {
 	Q_ASSERT_X(m_Instance == NULL, "GpsLocation", "GpsLocation recreated");
 	m_Instance = this;
 	showMessageCB = showMsgCB;
-	// create a QSettings object that's separate from the main application settings
-	geoSettings = new QSettings(QSettings::NativeFormat, QSettings::UserScope,
-				    QStringLiteral("org.subsurfacedivelog"), QStringLiteral("subsurfacelocation"), this);
+	storage.setFileName(QString(system_default_directory()) + QStringLiteral("/gpsfixes.bin"));
 	userAgent = getUserAgent();
 	(void)getGpsSource();
 	loadFromStorage();
@@ -132,14 +137,14 @@ QString GpsLocation::currentPosition()
 	qDebug() << "current position requested";
 	if (!hasLocationsSource())
 		return tr("Unknown GPS location (no GPS source)");
-	if (m_trackers.count()) {
-		QDateTime lastFixTime =	timestampToDateTime(m_trackers.lastKey() + gettimezoneoffset());
+	if (!m_trackers.empty()) {
+		QDateTime lastFixTime =	timestampToDateTime(m_trackers.back().when + gettimezoneoffset());
 		QDateTime now = QDateTime::currentDateTime();
 		int delta = lastFixTime.secsTo(now);
 		qDebug() << "lastFixTime" << lastFixTime.toString() << "now" << now.toString() << "delta" << delta;
 		if (delta < 300) {
 			// we can simply use the last position that we tracked
-			gpsTracker gt = m_trackers.last();
+			gpsTracker gt = m_trackers.back();
 			QString gpsString = printGPSCoords(&gt.location);
 			qDebug() << "returning last position" << gpsString;
 			return gpsString;
@@ -160,9 +165,9 @@ void GpsLocation::newPosition(QGeoPositionInfo pos)
 	int64_t lastTime = 0;
 	int64_t thisTime = dateTimeToTimestamp(pos.timestamp()) + gettimezoneoffset();
 	QGeoCoordinate lastCoord;
-	int nr = m_trackers.count();
+	int nr = (int)m_trackers.size();
 	if (nr) {
-		gpsTracker gt = m_trackers.last();
+		const gpsTracker &gt = m_trackers.back();
 		lastCoord.setLatitude(gt.location.lat.udeg / 1000000.0);
 		lastCoord.setLongitude(gt.location.lon.udeg / 1000000.0);
 		lastTime = gt.when;
@@ -181,7 +186,7 @@ void GpsLocation::newPosition(QGeoPositionInfo pos)
 		gt.when = thisTime;
 		gt.location = create_location(pos.coordinate().latitude(), pos.coordinate().longitude());
 		addFixToStorage(gt);
-		gpsTracker gtNew = m_trackers.last();
+		const gpsTracker &gtNew = m_trackers.back();
 		qDebug() << "newest fix is now at" << timestampToDateTime(gtNew.when - gettimezoneoffset()).toString();
 	}
 }
@@ -208,7 +213,7 @@ void GpsLocation::status(QString msg)
 
 int GpsLocation::getGpsNum() const
 {
-	return m_trackers.count();
+	return (int)m_trackers.size();
 }
 
 #define SAME_GROUP 6 * 3600 /* six hours */
@@ -221,21 +226,25 @@ int GpsLocation::getGpsNum() const
 std::vector<DiveAndLocation> GpsLocation::getLocations()
 {
 	int i;
-	int last = 0;
-	int cnt = m_trackers.count();
+	int cnt = (int)m_trackers.size();
 	std::vector<DiveAndLocation> fixes;
 	if (cnt == 0)
 		return fixes;
 
-	// create a table with the GPS information
-	QList<struct gpsTracker> gpsTable = m_trackers.values();
+	// the GPS information is sorted by time
+	const std::vector<gpsTracker> &gpsTable = m_trackers;
 
 	// now walk the dive table and see if we can fill in missing gps data
 	struct dive *d;
 	for_each_dive(i, d) {
 		if (dive_has_gps_location(d))
 			continue;
-		for (int j = last; j < cnt; j++) {
+		// Start at the first fix that may be in SAME_GROUP range of the dive, found by a binary
+		// search. Thus, the phones logging a fix every few seconds don't make this quadratic.
+		timestamp_t from = d->when - SAME_GROUP;
+		int first = std::lower_bound(gpsTable.begin(), gpsTable.end(), from,
+					     [](const gpsTracker &gt, timestamp_t t) { return gt.when < t; }) - gpsTable.begin();
+		for (int j = first; j < cnt; j++) {
 			if (time_during_dive_with_offset(d, gpsTable[j].when, SAME_GROUP)) {
 				if (verbose)
 					qDebug() << "processing gpsFix @" << get_dive_date_string(gpsTable[j].when) <<
@@ -298,10 +307,8 @@ std::vector<DiveAndLocation> GpsLocation::getLocations()
 				/* If position is out of SAME_GROUP range and in the future, mark position for
 				 * next dive iteration and end the gps_location loop
 				 */
-				if (gpsTable[j].when >= dive_endtime(d) + SAME_GROUP) {
-					last = j;
+				if (gpsTable[j].when >= dive_endtime(d) + SAME_GROUP)
 					break;
-				}
 			}
 
 		}
@@ -310,91 +317,197 @@ std::vector<DiveAndLocation> GpsLocation::getLocations()
 	return fixes;
 }
 
-QMap<qint64, gpsTracker> GpsLocation::currentGPSInfo() const
+const std::vector<gpsTracker> &GpsLocation::currentGPSInfo() const
 {
 	return m_trackers;
 }
 
+// The fixes are stored in an append-only binary log: a header followed by records
+// that either add (or replace) a fix or delete the fix with a given timestamp.
+// Adding a fix, which happens every few seconds when tracking, thus only appends
+// a few bytes. The log is compacted when it is loaded and contains many dead records.
+static const quint32 storageMagic = 0x53534750; // "SSGP"
+static const qint32 storageVersion = 1;
+enum { RECORD_FIX = 1, RECORD_DELETE = 2 };
+
+std::vector<gpsTracker>::iterator GpsLocation::findFix(qint64 when)
+{
+	return std::lower_bound(m_trackers.begin(), m_trackers.end(), when,
+				[](const gpsTracker &gt, qint64 t) { return gt.when < t; });
+}
+
+// Returns false if there was already a fix with that timestamp, which was replaced.
+static bool insertFix(std::vector<gpsTracker> &trackers, const gpsTracker &gt)
+{
+	// Fast path: fixes are usually added in chronological order
+	if (trackers.empty() || trackers.back().when < gt.when) {
+		trackers.push_back(gt);
+		return true;
+	}
+	auto it = std::lower_bound(trackers.begin(), trackers.end(), gt.when,
+				   [](const gpsTracker &t, qint64 when) { return t.when < when; });
+	if (it != trackers.end() && it->when == gt.when) {
+		*it = gt;
+		return false;
+	}
+	trackers.insert(it, gt);
+	return true;
+}
+
 void GpsLocation::loadFromStorage()
 {
-	int nr = geoSettings->value(QStringLiteral("count")).toInt();
+	m_trackers.clear();
+	deadRecords = 0;
+	if (!storage.exists()) {
+		importFromSettings();
+		return;
+	}
+	bool corrupt = false;
+	if (storage.open(QIODevice::ReadOnly)) {
+		QDataStream stream(&storage);
+		stream.setVersion(QDataStream::Qt_5_0);
+		quint32 magic;
+		qint32 version;
+		stream >> magic >> version;
+		if (stream.status() != QDataStream::Ok || magic != storageMagic || version != storageVersion) {
+			corrupt = true;
+		} else {
+			while (!stream.atEnd()) {
+				quint8 type;
+				gpsTracker gt;
+				stream >> type >> gt.when;
+				if (type == RECORD_FIX)
+					stream >> gt.location.lat.udeg >> gt.location.lon.udeg >> gt.name;
+				// A partially written last record is dropped
+				if (stream.status() != QDataStream::Ok || (type != RECORD_FIX && type != RECORD_DELETE)) {
+					corrupt = true;
+					break;
+				}
+				if (type == RECORD_FIX) {
+					if (!insertFix(m_trackers, gt))
+						++deadRecords;
+				} else {
+					auto it = findFix(gt.when);
+					if (it != m_trackers.end() && it->when == gt.when)
+						m_trackers.erase(it);
+					deadRecords += 2;
+				}
+			}
+		}
+		storage.close();
+	}
+	if (corrupt)
+		qWarning() << "GpsLocation: dropping corrupt data of" << storage.fileName();
+	if (corrupt || deadRecords > (int)m_trackers.size())
+		compactStorage();
+	else
+		openStorage(false);
+}
+
+// Before the binary log, the fixes were stored in a separate QSettings file
+void GpsLocation::importFromSettings()
+{
+	QSettings geoSettings(QSettings::NativeFormat, QSettings::UserScope,
+			      QStringLiteral("org.subsurfacedivelog"), QStringLiteral("subsurfacelocation"));
+	int nr = geoSettings.value(QStringLiteral("count")).toInt();
 	for (int i = 0; i < nr; i++) {
 		struct gpsTracker gt;
-		gt.when = geoSettings->value(QStringLiteral("gpsFix%1_time").arg(i)).toLongLong();
-		gt.location.lat.udeg = geoSettings->value(QStringLiteral("gpsFix%1_lat").arg(i)).toInt();
-		gt.location.lon.udeg = geoSettings->value(QStringLiteral("gpsFix%1_lon").arg(i)).toInt();
-		gt.name = geoSettings->value(QStringLiteral("gpsFix%1_name").arg(i)).toString();
-		gt.idx = i;
-		m_trackers.insert(gt.when, gt);
+		gt.when = geoSettings.value(QStringLiteral("gpsFix%1_time").arg(i)).toLongLong();
+		gt.location.lat.udeg = geoSettings.value(QStringLiteral("gpsFix%1_lat").arg(i)).toInt();
+		gt.location.lon.udeg = geoSettings.value(QStringLiteral("gpsFix%1_lon").arg(i)).toInt();
+		gt.name = geoSettings.value(QStringLiteral("gpsFix%1_name").arg(i)).toString();
+		insertFix(m_trackers, gt);
+	}
+	compactStorage();
+	if (nr > 0 && storage.isOpen()) {
+		geoSettings.clear();
+		geoSettings.sync();
 	}
 }
 
+bool GpsLocation::openStorage(bool truncate)
+{
+	storage.close();
+	QDir().mkpath(QFileInfo(storage).absolutePath());
+	if (!storage.open(truncate ? QIODevice::WriteOnly | QIODevice::Truncate : QIODevice::WriteOnly | QIODevice::Append)) {
+		qWarning() << "GpsLocation: can't open" << storage.fileName();
+		return false;
+	}
+	if (storage.size() == 0) {
+		QDataStream stream(&storage);
+		stream.setVersion(QDataStream::Qt_5_0);
+		stream << storageMagic << storageVersion;
+		storage.flush();
+	}
+	return true;
+}
+
+void GpsLocation::writeRecord(quint8 type, const gpsTracker &gt)
+{
+	if (!storage.isOpen() && !openStorage(false))
+		return;
+	QDataStream stream(&storage);
+	stream.setVersion(QDataStream::Qt_5_0);
+	stream << type << (qint64)gt.when;
+	if (type == RECORD_FIX)
+		stream << gt.location.lat.udeg << gt.location.lon.udeg << gt.name;
+	storage.flush();
+}
+
+// Rewrite the log with only the current fixes
+void GpsLocation::compactStorage()
+{
+	storage.close();
+	QDir().mkpath(QFileInfo(storage).absolutePath());
+	QSaveFile f(storage.fileName());
+	if (f.open(QIODevice::WriteOnly)) {
+		QDataStream stream(&f);
+		stream.setVersion(QDataStream::Qt_5_0);
+		stream << storageMagic << storageVersion;
+		for (const gpsTracker &gt: m_trackers)
+			stream << (quint8)RECORD_FIX << (qint64)gt.when << gt.location.lat.udeg << gt.location.lon.udeg << gt.name;
+		if (f.commit())
+			deadRecords = 0;
+	}
+	openStorage(false);
+}
+
 void GpsLocation::replaceFixToStorage(gpsTracker &gt)
 {
-	if (!m_trackers.keys().contains(gt.when)) {
+	auto it = findFix(gt.when);
+	if (it == m_trackers.end() || it->when != gt.when) {
 		addFixToStorage(gt);
 		return;
 	}
-	gpsTracker replacedTracker = m_trackers.value(gt.when);
-	geoSettings->setValue(QStringLiteral("gpsFix%1_time").arg(replacedTracker.idx), gt.when);
-	geoSettings->setValue(QStringLiteral("gpsFix%1_lat").arg(replacedTracker.idx), gt.location.lat.udeg);
-	geoSettings->setValue(QStringLiteral("gpsFix%1_lon").arg(replacedTracker.idx), gt.location.lon.udeg);
-	geoSettings->setValue(QStringLiteral("gpsFix%1_name").arg(replacedTracker.idx), gt.name);
-	replacedTracker.location = gt.location;
-	replacedTracker.name = gt.name;
+	it->location = gt.location;
+	it->name = gt.name;
+	writeRecord(RECORD_FIX, *it);
+	++deadRecords;
 }
 
 void GpsLocation::addFixToStorage(gpsTracker &gt)
 {
-	int nr = m_trackers.count();
-	geoSettings->setValue("count", nr + 1);
-	geoSettings->setValue(QStringLiteral("gpsFix%1_time").arg(nr), gt.when);
-	geoSettings->setValue(QStringLiteral("gpsFix%1_lat").arg(nr), gt.location.lat.udeg);
-	geoSettings->setValue(QStringLiteral("gpsFix%1_lon").arg(nr), gt.location.lon.udeg);
-	geoSettings->setValue(QStringLiteral("gpsFix%1_name").arg(nr), gt.name);
-	gt.idx = nr;
-	geoSettings->sync();
-	m_trackers.insert(gt.when, gt);
+	if (!insertFix(m_trackers, gt))
+		++deadRecords;
+	writeRecord(RECORD_FIX, gt);
 }
 
 void GpsLocation::deleteFixFromStorage(gpsTracker &gt)
 {
-	qint64 when = gt.when;
-	int cnt = m_trackers.count();
-	if (cnt == 0 || !m_trackers.keys().contains(when)) {
-		qDebug() << "no gps fix with timestamp" << when;
+	auto it = findFix(gt.when);
+	if (it == m_trackers.end() || it->when != gt.when) {
+		qDebug() << "no gps fix with timestamp" << gt.when;
 		return;
 	}
-	if (geoSettings->value(QStringLiteral("gpsFix%1_time").arg(gt.idx)).toLongLong() != when) {
-		qDebug() << "uh oh - index for tracker has gotten out of sync...";
-		return;
-	}
-	if (cnt > 1) {
-		// now we move the last tracker into that spot (so our settings stay consecutive)
-		// and delete the last settings entry
-		when = geoSettings->value(QStringLiteral("gpsFix%1_time").arg(cnt - 1)).toLongLong();
-		struct gpsTracker movedTracker = m_trackers.value(when);
-		movedTracker.idx = gt.idx;
-		m_trackers.remove(movedTracker.when);
-		m_trackers.insert(movedTracker.when, movedTracker);
-		geoSettings->setValue(QStringLiteral("gpsFix%1_time").arg(movedTracker.idx), when);
-		geoSettings->setValue(QStringLiteral("gpsFix%1_lat").arg(movedTracker.idx), movedTracker.location.lat.udeg);
-		geoSettings->setValue(QStringLiteral("gpsFix%1_lon").arg(movedTracker.idx), movedTracker.location.lon.udeg);
-		geoSettings->setValue(QStringLiteral("gpsFix%1_name").arg(movedTracker.idx), movedTracker.name);
-		geoSettings->remove(QStringLiteral("gpsFix%1_lat").arg(cnt - 1));
-		geoSettings->remove(QStringLiteral("gpsFix%1_lon").arg(cnt - 1));
-		geoSettings->remove(QStringLiteral("gpsFix%1_time").arg(cnt - 1));
-		geoSettings->remove(QStringLiteral("gpsFix%1_name").arg(cnt - 1));
-	}
-	geoSettings->setValue("count", cnt - 1);
-	geoSettings->sync();
-	m_trackers.remove(gt.when);
+	m_trackers.erase(it);
+	writeRecord(RECORD_DELETE, gt);
+	deadRecords += 2;
 }
 
 void GpsLocation::deleteGpsFix(qint64 when)
 {
-	auto it = m_trackers.find(when);
-	if (it == m_trackers.end()) {
+	auto it = findFix(when);
+	if (it == m_trackers.end() || it->when != when) {
 		qWarning() << "GpsLocation::deleteGpsFix(): can't find tracker for timestamp " << when;
 		return;
 	}
@@ -407,7 +520,7 @@ void GpsLocation::deleteGpsFix(qint64 when)
 void GpsLocation::clearGpsData()
 {
 	m_trackers.clear();
-	geoSettings->clear();
-	geoSettings->sync();
+	deadRecords = 0;
+	openStorage(true);
 }
 #endif
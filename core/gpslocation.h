@@ -9,7 +9,8 @@
 #include <QGeoPositionInfo>
 #include <QSettings>
 #include <QNetworkReply>
-#include <QMap>
+#include <QFile>
+#include <vector>
 
 #define GPS_CURRENT_POS gettextFromC::tr("Waiting to aquire GPS location")
 
@@ -17,7 +18,6 @@ struct gpsTracker {
 	location_t location;
 	qint64 when;
 	QString name;
-	int idx;
 };
 
 struct DiveAndLocation {
@@ -38,22 +38,28 @@ public:
 	bool hasLocationsSource();
 	QString currentPosition();
 
-	QMap<qint64, gpsTracker> currentGPSInfo() const;
+	const std::vector<gpsTracker> &currentGPSInfo() const; // sorted by time
 
 private:
 	QGeoPositionInfo lastPos;
 	QGeoPositionInfoSource *getGpsSource();
 	QGeoPositionInfoSource *m_GpsSource;
 	void status(QString msg);
-	QSettings *geoSettings;
+	QFile storage; // append-only log of added and deleted fixes
+	int deadRecords; // records in the log that were overwritten or deleted
 	QNetworkReply *reply;
 	QString userAgent;
 	void (*showMessageCB)(const char *msg);
 	static GpsLocation *m_Instance;
 	bool waitingForPosition;
-	QMap<qint64, gpsTracker> m_trackers;
+	std::vector<gpsTracker> m_trackers; // sorted by time
 	QList<gpsTracker> m_deletedTrackers;
+	std::vector<gpsTracker>::iterator findFix(qint64 when);
 	void loadFromStorage();
+	void importFromSettings();
+	bool openStorage(bool truncate);
+	void writeRecord(quint8 type, const gpsTracker &gt);
+	void compactStorage();
 	void addFixToStorage(gpsTracker &gt);
 	void replaceFixToStorage(gpsTracker &gt);
 	void deleteFixFromStorage(gpsTracker &gt);
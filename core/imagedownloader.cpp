@@ -4,18 +4,32 @@
 #include "divelist.h"
 #include "qthelper.h"
 #include "imagedownloader.h"
+#include "memusage.h"
 #include "videoframeextractor.h"
 #include "qt-models/divepicturemodel.h"
 #include "metadata.h"
+#include "thumbnailstore.h"
+#include "exif.h"
 #include <unistd.h>
+#include <algorithm>
+#include <cmath>
 #include <QString>
+#include <QBuffer>
 #include <QImageReader>
 #include <QDataStream>
 #include <QSvgRenderer>
 #include <QPainter>
+#include <QTimer>
 
 #include <QtConcurrent>
 
+// Browsers use the same number of connections per host with HTTP/1.1
+static const int maxConnectionsPerHost = 6;
+static const int maxConnections = 16;
+// Transient failures are retried after 1, 2 and 4 seconds
+static const int maxRetries = 3;
+static const int retryDelayMsecs = 1000;
+
 // Note: this is a global instead of a function-local variable on purpose.
 // We don't want this to be generated in a different thread context if
 // ImageDownloader::instance() is called from a worker thread.
@@ -30,20 +44,141 @@ ImageDownloader::ImageDownloader()
 	connect(&manager, &QNetworkAccessManager::finished, this, &ImageDownloader::saveImage);
 }
 
-void ImageDownloader::load(QUrl url, QString filename)
+void ImageDownloader::load(QUrl url, QString filename, int priority)
+{
+	if (active.contains(filename)) {
+		setPriority(filename, priority);
+		return;
+	}
+	active.insert(filename);
+	pending.append({ url, filename, priority, 0 });
+	startDownloads();
+}
+
+void ImageDownloader::setPriority(QString filename, int priority)
+{
+	for (Download &download: pending) {
+		if (download.filename == filename)
+			download.priority = priority;
+	}
+}
+
+void ImageDownloader::cancel(QString filename)
+{
+	for (int i = 0; i < pending.size(); ++i) {
+		if (pending[i].filename == filename) {
+			pending.remove(i);
+			active.remove(filename);
+			return;
+		}
+	}
+}
+
+void ImageDownloader::clearQueue()
+{
+	pending.clear();
+	active.clear();
+	for (const Download &download: running)
+		active.insert(download.filename);
+}
+
+bool ImageDownloader::isScheduled(const QString &filename) const
+{
+	for (const Download &download: pending) {
+		if (download.filename == filename)
+			return true;
+	}
+	for (const Download &download: running) {
+		if (download.filename == filename)
+			return true;
+	}
+	return false;
+}
+
+// Start the most urgent downloads for which there is a free connection.
+// All requests go through the same network access manager, so that the
+// connections to a host are kept alive and reused. Where the server
+// supports it, HTTP/2 multiplexes the requests over a single connection.
+void ImageDownloader::startDownloads()
 {
-	QNetworkRequest request(url);
-	request.setAttribute(QNetworkRequest::User, filename);
-	manager.get(request);
+	while (running.size() < maxConnections) {
+		int best = -1;
+		for (int i = 0; i < pending.size(); ++i) {
+			if (connectionsPerHost.value(pending[i].url.host()) >= maxConnectionsPerHost)
+				continue;
+			if (best < 0 || pending[i].priority < pending[best].priority)
+				best = i;
+		}
+		if (best < 0)
+			return;
+		Download download = pending.takeAt(best);
+		QNetworkRequest request(download.url);
+		request.setAttribute(QNetworkRequest::HTTP2AllowedAttribute, true);
+		++connectionsPerHost[download.url.host()];
+		running.insert(manager.get(request), download);
+	}
+}
+
+// Retry the download later if the failure is likely to be temporary.
+// Returns true if the download was rescheduled.
+bool ImageDownloader::retry(QNetworkReply *reply, const Download &download)
+{
+	if (download.attempts >= maxRetries)
+		return false;
+	int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+	switch (reply->error()) {
+	case QNetworkReply::RemoteHostClosedError:
+	case QNetworkReply::TimeoutError:
+	case QNetworkReply::TemporaryNetworkFailureError:
+	case QNetworkReply::NetworkSessionFailedError:
+	case QNetworkReply::ProxyTimeoutError:
+	case QNetworkReply::UnknownNetworkError:
+		break;
+	default:
+		// Too many requests or server errors
+		if (status != 429 && status < 500)
+			return false;
+	}
+
+	int delay = retryDelayMsecs << download.attempts;
+	// Servers tell us when to come back if we are too fast
+	bool ok;
+	int retryAfter = reply->rawHeader("Retry-After").toInt(&ok);
+	if (ok && retryAfter > 0)
+		delay = qMax(delay, retryAfter * 1000);
+
+	Download next = download;
+	++next.attempts;
+	QTimer::singleShot(delay, this, [this, next]() {
+		// Cancelled in the meantime or already requested anew
+		if (!active.contains(next.filename) || isScheduled(next.filename))
+			return;
+		pending.append(next);
+		startDownloads();
+	});
+	return true;
 }
 
 void ImageDownloader::saveImage(QNetworkReply *reply)
 {
-	QString filename = reply->request().attribute(QNetworkRequest::User).toString();
+	auto it = running.find(reply);
+	if (it == running.end()) {
+		reply->deleteLater();
+		return;
+	}
+	Download download = *it;
+	running.erase(it);
+	if (--connectionsPerHost[download.url.host()] <= 0)
+		connectionsPerHost.remove(download.url.host());
+	QString filename = download.filename;
 
 	if (reply->error() != QNetworkReply::NoError) {
-		emit failed(filename);
+		if (!retry(reply, download)) {
+			active.remove(filename);
+			emit failed(filename);
+		}
 	} else {
+		active.remove(filename);
 		QByteArray imageData = reply->readAll();
 		if (imageData.isEmpty()) {
 			emit failed(filename);
@@ -68,6 +203,7 @@ void ImageDownloader::saveImage(QNetworkReply *reply)
 	}
 
 	reply->deleteLater();
+	startDownloads();
 }
 
 static bool hasVideoFileExtension(const QString &filename)
@@ -84,7 +220,7 @@ static bool hasVideoFileExtension(const QString &filename)
 // If the input-flag "tryDownload" is set to false, no download attempt is made. This is to
 // prevent infinite loops, where failed image downloads would be repeated ad infinitum.
 // Returns: fetched image, type
-Thumbnailer::Thumbnail Thumbnailer::fetchImage(const QString &urlfilename, const QString &originalFilename, bool tryDownload)
+Thumbnailer::Thumbnail Thumbnailer::fetchImage(const QString &urlfilename, const QString &originalFilename, bool tryDownload, Priority priority)
 {
 	QUrl url = QUrl::fromUserInput(urlfilename);
 	if (url.isLocalFile()) {
@@ -100,12 +236,9 @@ Thumbnailer::Thumbnail Thumbnailer::fetchImage(const QString &urlfilename, const
 			return fetchVideoThumbnail(filename, originalFilename, md.duration);
 
 		// Try if Qt can parse this image. If it does, use this as a thumbnail.
-		QImage thumb(filename);
-		if (!thumb.isNull()) {
-			int size = maxThumbnailSize();
-			thumb = thumb.scaled(size, size, Qt::KeepAspectRatio);
+		QImage thumb = decodeThumbnail(filename);
+		if (!thumb.isNull())
 			return addPictureThumbnailToCache(originalFilename, thumb);
-		}
 
 		// Neither our code, nor Qt could determine the type of this object from looking at the data.
 		// Try to check for a video-file extension. Since we couldn't parse the video file,
@@ -120,7 +253,8 @@ Thumbnailer::Thumbnail Thumbnailer::fetchImage(const QString &urlfilename, const
 		// This has to be done in UI main thread, because QNetworkManager refuses
 		// to treat requests from other threads. invokeMethod() is Qt's way of calling a
 		// function in a different thread, namely the thread the called object is associated to.
-		QMetaObject::invokeMethod(ImageDownloader::instance(), "load", Qt::AutoConnection, Q_ARG(QUrl, url), Q_ARG(QString, originalFilename));
+		QMetaObject::invokeMethod(ImageDownloader::instance(), "load", Qt::AutoConnection, Q_ARG(QUrl, url),
+					  Q_ARG(QString, originalFilename), Q_ARG(int, priority));
 		return { QImage(), MEDIATYPE_STILL_LOADING, zero_duration };
 	}
 	return { QImage(), MEDIATYPE_IO_ERROR, zero_duration };
@@ -132,7 +266,7 @@ Thumbnailer::Thumbnail Thumbnailer::fetchImage(const QString &urlfilename, const
 // was downloaded previously, but for some reason the cached picture was lost. Therefore, in such a
 // case, try the canonical filename. If that likewise fails, give up. For input and output parameters
 // see fetchImage() above.
-Thumbnailer::Thumbnail Thumbnailer::getHashedImage(const QString &filename, bool tryDownload)
+Thumbnailer::Thumbnail Thumbnailer::getHashedImage(const QString &filename, bool tryDownload, Priority priority)
 {
 	QString localFilename = localFilePath(filename);
 
@@ -141,19 +275,92 @@ Thumbnailer::Thumbnail Thumbnailer::getHashedImage(const QString &filename, bool
 	// the local filename first, we will load the file from the canonical filename.
 	Thumbnail thumbnail { QImage(), MEDIATYPE_IO_ERROR, zero_duration };
 	if (localFilename != filename)
-		thumbnail = fetchImage(localFilename, filename, tryDownload);
+		thumbnail = fetchImage(localFilename, filename, tryDownload, priority);
 
 	// If fetching from the local filename failed (or we didn't even try),
 	// use the canonical filename. This might for example happen if we downloaded
 	// a file, but for some reason lost the cached file.
 	if (thumbnail.type == MEDIATYPE_IO_ERROR)
-		thumbnail = fetchImage(filename, filename, tryDownload);
+		thumbnail = fetchImage(filename, filename, tryDownload, priority);
 
 	if (thumbnail.type == MEDIATYPE_IO_ERROR)
 		qInfo() << "Error loading image" << filename << "[local:" << localFilename << "]";
 	return thumbnail;
 }
 
+// Don't start decoding another picture if the pictures being decoded take more memory than that
+static const qint64 maxDecodeMemory = 256 * 1024 * 1024;
+
+// The EXIF segment, which contains the embedded preview, is at most 64 kB
+// and comes at the start of the file
+static const qint64 exifReadSize = 128 * 1024;
+
+// Cameras embed a small JPEG preview in the EXIF data. Use that if it is
+// at least as large as the thumbnail and shows the whole picture (some
+// cameras letterbox the preview to 4:3).
+static QImage decodeEmbeddedThumbnail(const QString &filename, const QSize &imageSize, int size)
+{
+	QFile f(filename);
+	if (!imageSize.isValid() || !f.open(QIODevice::ReadOnly))
+		return QImage();
+	QByteArray data = f.read(exifReadSize);
+	easyexif::EXIFInfo exif;
+	if (exif.parseFrom(reinterpret_cast<const unsigned char *>(data.constData()), data.size()) != PARSE_EXIF_SUCCESS ||
+	    !exif.ThumbnailLength)
+		return QImage();
+
+	QByteArray jpeg = data.mid(exif.ThumbnailOffset, exif.ThumbnailLength);
+	QBuffer buffer(&jpeg);
+	QImageReader reader(&buffer, "jpeg");
+	QSize thumbSize = reader.size();
+	if (!thumbSize.isValid() || std::max(thumbSize.width(), thumbSize.height()) < size)
+		return QImage();
+	double aspect = (double)imageSize.width() / imageSize.height();
+	double thumbAspect = (double)thumbSize.width() / thumbSize.height();
+	if (std::fabs(thumbAspect - aspect) > 0.02 * aspect)
+		return QImage();
+	return reader.read();
+}
+
+// Decode a picture at thumbnail size. Formats that support it (notably JPEG)
+// are decoded directly at that size, so that a huge picture doesn't need
+// the memory for the full resolution. For JPEGs the embedded preview is
+// tried first.
+QImage Thumbnailer::decodeThumbnail(const QString &filename)
+{
+	QImageReader reader(filename);
+	QSize imageSize = reader.size();
+	int size = maxThumbnailSize();
+	if (reader.format() == "jpeg") {
+		QImage thumb = decodeEmbeddedThumbnail(filename, imageSize, size);
+		if (!thumb.isNull())
+			return thumb.scaled(size, size, Qt::KeepAspectRatio);
+	}
+	if (imageSize.isValid() && reader.supportsOption(QImageIOHandler::ScaledSize) &&
+	    (imageSize.width() > size || imageSize.height() > size)) {
+		imageSize = imageSize.scaled(size, size, Qt::KeepAspectRatio);
+		reader.setScaledSize(imageSize);
+	}
+	qint64 memory = imageSize.isValid() ? (qint64)imageSize.width() * imageSize.height() * 4 : 0;
+
+	QMutexLocker l(&decodeLock);
+	while (decodeMemory > 0 && decodeMemory + memory > maxDecodeMemory)
+		decodeMemoryFreed.wait(&decodeLock);
+	decodeMemory += memory;
+	l.unlock();
+
+	QImage thumb = reader.read();
+
+	l.relock();
+	decodeMemory -= memory;
+	decodeMemoryFreed.wakeAll();
+	l.unlock();
+
+	if (!thumb.isNull())
+		thumb = thumb.scaled(size, size, Qt::KeepAspectRatio);
+	return thumb;
+}
+
 static QImage renderIcon(const char *id, int size)
 {
 	QImage res(size, size, QImage::Format_RGB32);
@@ -176,15 +383,31 @@ static QImage renderIconWidth(const char *id, int size)
 	return res;
 }
 
+// The pictures that are being decoded and the queued thumbnails
+void Thumbnailer::reportMemoryUsage(struct mem_usage *usage, void *data)
+{
+	Thumbnailer *self = static_cast<Thumbnailer *>(data);
+	{
+		QMutexLocker l(&self->decodeLock);
+		usage->bytes = self->decodeMemory;
+	}
+	QMutexLocker l(&self->lock);
+	usage->objects = self->workingOn.size();
+}
+
 Thumbnailer::Thumbnailer() : failImage(renderIcon(":filter-close", maxThumbnailSize())), // TODO: Don't misuse filter close icon
 			     dummyImage(renderIcon(":camera-icon", maxThumbnailSize())),
 			     videoImage(renderIcon(":video-icon", maxThumbnailSize())),
 			     videoOverlayImage(renderIconWidth(":video-overlay", maxThumbnailSize())),
-			     unknownImage(renderIcon(":unknown-icon", maxThumbnailSize()))
+			     unknownImage(renderIcon(":unknown-icon", maxThumbnailSize())),
+			     jobSeq(0),
+			     numWorkers(0),
+			     decodeMemory(0)
 {
 	// Currently, we only process one image at a time. Stefan Fuchs reported problems when
 	// calculating multiple thumbnails at once and this hopefully helps.
 	pool.setMaxThreadCount(1);
+	memusage_register(MEM_THUMBNAILS, &Thumbnailer::reportMemoryUsage, this);
 	connect(ImageDownloader::instance(), &ImageDownloader::loaded, this, &Thumbnailer::imageDownloaded);
 	connect(ImageDownloader::instance(), &ImageDownloader::failed, this, &Thumbnailer::imageDownloadFailed);
 	connect(VideoFrameExtractor::instance(), &VideoFrameExtractor::extracted, this, &Thumbnailer::frameExtracted);
@@ -253,30 +476,26 @@ Thumbnailer::Thumbnail Thumbnailer::getVideoThumbnailFromStream(QDataStream &str
 // If Thumbnail::QImage is null, the thumbnail is scheduled for recreation.
 Thumbnailer::Thumbnail Thumbnailer::getThumbnailFromCache(const QString &picture_filename)
 {
-	QString filename = thumbnailFileName(picture_filename);
-	if (filename.isEmpty())
+	QByteArray data;
+	QDateTime thumbnailTime;
+	if (!ThumbnailStore::instance().read(picture_filename, data, thumbnailTime))
 		return { QImage(), MEDIATYPE_UNKNOWN, zero_duration };
-	QFile file(filename);
 
 	if (prefs.auto_recalculate_thumbnails) {
 		// Check if thumbnails is older than the (local) image file
 		QString filenameLocal = localFilePath(qPrintable(picture_filename));
 		QFileInfo pictureInfo(filenameLocal);
-		QFileInfo thumbnailInfo(file);
-		if (pictureInfo.exists() && thumbnailInfo.exists()) {
+		if (pictureInfo.exists()) {
 			QDateTime pictureTime = pictureInfo.lastModified();
-			QDateTime thumbnailTime = thumbnailInfo.lastModified();
 			if (pictureTime.isValid() && thumbnailTime.isValid() && thumbnailTime < pictureTime) {
-				// Both files exist, have valid timestamps and thumbnail was calculated before picture.
+				// The picture exists, both have valid timestamps and thumbnail was calculated before picture.
 				// Return an empty thumbnail to signal recalculation of the thumbnail
 				return { QImage(), MEDIATYPE_UNKNOWN, zero_duration };
 			}
 		}
 	}
 
-	if (!file.open(QIODevice::ReadOnly))
-		return { QImage(), MEDIATYPE_UNKNOWN, zero_duration };
-	QDataStream stream(&file);
+	QDataStream stream(data);
 
 	// Each thumbnail file is composed of a media-type and an image file.
 	quint32 type;
@@ -301,26 +520,22 @@ Thumbnailer::Thumbnail Thumbnailer::addVideoThumbnailToCache(const QString &pict
 	//	for each picture:
 	//		uint32	offset in msec from begining of video
 	//		QImage	frame
-	QString filename = thumbnailFileName(picture_filename);
-	QSaveFile file(filename);
-	if (file.open(QIODevice::WriteOnly)) {
-		QDataStream stream(&file);
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
 
-		stream << (quint32)MEDIATYPE_VIDEO;
-		stream << (quint32)duration.seconds;
+	stream << (quint32)MEDIATYPE_VIDEO;
+	stream << (quint32)duration.seconds;
 
-		if (image.isNull()) {
-			// No image provided
-			stream << (quint32)0;
-		} else {
-			// Currently, we support at most one image
-			stream << (quint32)1;
-			stream << (quint32)position.seconds;
-			stream << image;
-		}
-
-		file.commit();
+	if (image.isNull()) {
+		// No image provided
+		stream << (quint32)0;
+	} else {
+		// Currently, we support at most one image
+		stream << (quint32)1;
+		stream << (quint32)position.seconds;
+		stream << image;
 	}
+	ThumbnailStore::instance().write(picture_filename, data);
 	return { videoImage, MEDIATYPE_VIDEO, duration };
 }
 
@@ -343,26 +558,21 @@ Thumbnailer::Thumbnail Thumbnailer::addPictureThumbnailToCache(const QString &pi
 	// The format of a picture-thumbnail is very simple:
 	// 	uint32	MEDIATYPE_PICTURE
 	// 	QImage	thumbnail
-	QString filename = thumbnailFileName(picture_filename);
-	QSaveFile file(filename);
-	if (file.open(QIODevice::WriteOnly)) {
-		QDataStream stream(&file);
-
-		stream << (quint32)MEDIATYPE_PICTURE;
-		stream << thumbnail;
-		file.commit();
-	}
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
+
+	stream << (quint32)MEDIATYPE_PICTURE;
+	stream << thumbnail;
+	ThumbnailStore::instance().write(picture_filename, data);
 	return { thumbnail, MEDIATYPE_PICTURE, zero_duration };
 }
 
 Thumbnailer::Thumbnail Thumbnailer::addUnknownThumbnailToCache(const QString &picture_filename)
 {
-	QString filename = thumbnailFileName(picture_filename);
-	QSaveFile file(filename);
-	if (file.open(QIODevice::WriteOnly)) {
-		QDataStream stream(&file);
-		stream << (quint32)MEDIATYPE_UNKNOWN;
-	}
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
+	stream << (quint32)MEDIATYPE_UNKNOWN;
+	ThumbnailStore::instance().write(picture_filename, data);
 	return { unknownImage, MEDIATYPE_UNKNOWN, zero_duration };
 }
 
@@ -419,12 +629,12 @@ void Thumbnailer::recalculate(QString filename)
 	workingOn.remove(filename);
 }
 
-void Thumbnailer::processItem(QString filename, bool tryDownload)
+void Thumbnailer::processItem(QString filename, bool tryDownload, Priority priority)
 {
 	Thumbnail thumbnail = getThumbnailFromCache(filename);
 
 	if (thumbnail.img.isNull()) {
-		thumbnail = getHashedImage(filename, tryDownload);
+		thumbnail = getHashedImage(filename, tryDownload, priority);
 		if (thumbnail.type == MEDIATYPE_STILL_LOADING)
 			return;
 
@@ -445,7 +655,7 @@ void Thumbnailer::imageDownloaded(QString filename)
 {
 	// Image was downloaded -> try thumbnailing again.
 	QMutexLocker l(&lock);
-	workingOn[filename] = QtConcurrent::run(&pool, [this, filename]() { processItem(filename, false); });
+	enqueue(filename, PROCESS_DOWNLOADED, VISIBLE);
 }
 
 void Thumbnailer::imageDownloadFailed(QString filename)
@@ -455,7 +665,7 @@ void Thumbnailer::imageDownloadFailed(QString filename)
 	workingOn.remove(filename);
 }
 
-QImage Thumbnailer::fetchThumbnail(const QString &filename, bool synchronous)
+QImage Thumbnailer::fetchThumbnail(const QString &filename, bool synchronous, Priority priority)
 {
 	if (synchronous) {
 		// In synchronous mode, first try the thumbnail cache.
@@ -473,35 +683,124 @@ QImage Thumbnailer::fetchThumbnail(const QString &filename, bool synchronous)
 	}
 
 	QMutexLocker l(&lock);
-
-	// We are not currently fetching this thumbnail - add it to the list.
-	if (!workingOn.contains(filename)) {
-		workingOn.insert(filename,
-				 QtConcurrent::run(&pool, [this, filename]() { processItem(filename, true); }));
-	}
+	enqueue(filename, PROCESS, priority);
 	return dummyImage;
 }
 
 void Thumbnailer::calculateThumbnails(const QVector<QString> &filenames)
 {
 	QMutexLocker l(&lock);
-	for (const QString &filename: filenames) {
-		if (!workingOn.contains(filename)) {
-			workingOn.insert(filename,
-					 QtConcurrent::run(&pool, [this, filename]() { recalculate(filename); }));
+	for (const QString &filename: filenames)
+		enqueue(filename, RECALCULATE, VISIBLE);
+}
+
+// Needs lock
+void Thumbnailer::requeue(const QString &filename, Job &job, Priority priority)
+{
+	job.priority = priority;
+	job.seq = ++jobSeq;
+	queues[priority].push_back({ filename, job.seq });
+}
+
+// Needs lock
+void Thumbnailer::enqueue(const QString &filename, JobType type, Priority priority)
+{
+	auto it = queued.find(filename);
+	if (it != queued.end()) {
+		// Already queued - but maybe it got more urgent
+		if (priority < it->priority)
+			requeue(filename, *it, priority);
+		return;
+	}
+	// Already being processed. If the picture had to be downloaded, it is
+	// processed again once the download finished.
+	if (workingOn.contains(filename) && type != PROCESS_DOWNLOADED)
+		return;
+
+	workingOn.insert(filename);
+	it = queued.insert(filename, { type, priority, 0 });
+	requeue(filename, *it, priority);
+	if (numWorkers < pool.maxThreadCount()) {
+		++numWorkers;
+		QtConcurrent::run(&pool, [this]() { work(); });
+	}
+}
+
+// Process the queued thumbnails, most urgent first, until the queues are empty
+void Thumbnailer::work()
+{
+	for (;;) {
+		QString filename;
+		JobType type = PROCESS;
+		Priority priority = VISIBLE;
+		bool found = false;
+
+		QMutexLocker l(&lock);
+		for (int priority = 0; priority < NUM_PRIORITIES && !found; ++priority) {
+			std::deque<std::pair<QString, quint64>> &queue = queues[priority];
+			while (!queue.empty() && !found) {
+				std::pair<QString, quint64> entry = queue.front();
+				queue.pop_front();
+				auto it = queued.find(entry.first);
+				if (it == queued.end() || it->seq != entry.second)
+					continue;	// Reprioritized or cancelled
+				filename = entry.first;
+				type = it->type;
+				priority = it->priority;
+				queued.erase(it);
+				found = true;
+			}
+		}
+		if (!found) {
+			--numWorkers;
+			return;
+		}
+		l.unlock();
+
+		switch (type) {
+		case PROCESS:			processItem(filename, true, priority); break;
+		case PROCESS_DOWNLOADED:	processItem(filename, false, priority); break;
+		case RECALCULATE:		recalculate(filename); break;
 		}
 	}
 }
 
+void Thumbnailer::setPriority(const QString &filename, Priority priority)
+{
+	QMutexLocker l(&lock);
+	auto it = queued.find(filename);
+	if (it != queued.end()) {
+		if (it->priority != priority)
+			requeue(filename, *it, priority);
+	} else if (workingOn.contains(filename)) {
+		// Maybe the picture is waiting to be downloaded
+		QMetaObject::invokeMethod(ImageDownloader::instance(), "setPriority", Qt::AutoConnection,
+					  Q_ARG(QString, filename), Q_ARG(int, priority));
+	}
+}
+
+void Thumbnailer::cancel(const QString &filename)
+{
+	QMutexLocker l(&lock);
+	if (queued.remove(filename)) {
+		workingOn.remove(filename);
+	} else if (workingOn.contains(filename)) {
+		QMetaObject::invokeMethod(ImageDownloader::instance(), "cancel", Qt::AutoConnection, Q_ARG(QString, filename));
+		workingOn.remove(filename);
+	}
+}
+
 void Thumbnailer::clearWorkQueue()
 {
 	// We also want to clear the working-queue of the video-frame-extractor so that
 	// we don't get thumbnails that we don't care about.
 	VideoFrameExtractor::instance()->clearWorkQueue();
+	QMetaObject::invokeMethod(ImageDownloader::instance(), "clearQueue", Qt::AutoConnection);
 
 	QMutexLocker l(&lock);
-	for (auto it = workingOn.begin(); it != workingOn.end(); ++it)
-		it->cancel();
+	queued.clear();
+	for (auto &queue: queues)
+		queue.clear();
 	workingOn.clear();
 }
 
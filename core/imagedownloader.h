@@ -7,29 +7,65 @@
 #include <QFuture>
 #include <QNetworkReply>
 #include <QThreadPool>
+#include <QWaitCondition>
+#include <QSet>
+#include <QHash>
+#include <QVector>
+#include <deque>
 
+// Downloads are scheduled by priority, where lower values are more urgent
+// (see Thumbnailer::Priority), and in the order they were requested within
+// the same priority. The number of connections per host is limited and
+// transient failures are retried with an increasing delay.
+// All functions must be called from the thread of the downloader.
 class ImageDownloader : public QObject {
 	Q_OBJECT
 public:
 	static ImageDownloader *instance();
 	ImageDownloader();
 public slots:
-	void load(QUrl url, QString filename);
+	void load(QUrl url, QString filename, int priority);
+	void setPriority(QString filename, int priority);
+	// Drop a download that didn't start yet
+	void cancel(QString filename);
+	void clearQueue();
 signals:
 	void loaded(QString filename);
 	void failed(QString filename);
 private:
+	struct Download {
+		QUrl url;
+		QString filename;
+		int priority;
+		int attempts;
+	};
 	QNetworkAccessManager manager;
-	void loadFromUrl(const QString &filename, const QUrl &);
+	QVector<Download> pending;			// In the order they were requested
+	QHash<QNetworkReply *, Download> running;
+	QHash<QString, int> connectionsPerHost;
+	QSet<QString> active;				// Pending, running or waiting for a retry
+	void startDownloads();
+	bool isScheduled(const QString &filename) const;
+	bool retry(QNetworkReply *reply, const Download &download);
 	void saveImage(QNetworkReply *reply);
 };
 
 struct PictureEntry;
+struct mem_usage;
 class Thumbnailer : public QObject {
 	Q_OBJECT
 public:
 	static Thumbnailer *instance();
 
+	// Scheduled thumbnails are processed in the order of their priority,
+	// and in the order they were scheduled within the same priority.
+	enum Priority {
+		VISIBLE,
+		NEAR_VISIBLE,
+		BACKGROUND,
+		NUM_PRIORITIES
+	};
+
 	// Schedule a thumbnail for fetching or calculation.
 	// If synchronous is false, returns a placeholder thumbnail.
 	// The actual thumbnail will be sent via a signal later.
@@ -37,11 +73,17 @@ public:
 	// In this mode only precalculated thumbnails or thumbnails
 	// from pictures are returned. Video extraction and remote
 	// images are not supported.
-	QImage fetchThumbnail(const QString &filename, bool synchronous);
+	QImage fetchThumbnail(const QString &filename, bool synchronous, Priority priority = VISIBLE);
 
 	// Schedule multiple thumbnails for forced recalculation
 	void calculateThumbnails(const QVector<QString> &filenames);
 
+	// Change the priority of a scheduled thumbnail or drop it from the queue.
+	// Thumbnails that are already being processed are not affected,
+	// but pictures waiting to be downloaded are.
+	void setPriority(const QString &filename, Priority priority);
+	void cancel(const QString &filename);
+
 	// If we change dive, clear all unfinished thumbnail creations
 	void clearWorkQueue();
 	static int maxThumbnailSize();
@@ -69,13 +111,29 @@ private:
 	Thumbnail addVideoThumbnailToCache(const QString &picture_filename, duration_t duration, const QImage &thumbnail, duration_t position);
 	Thumbnail addUnknownThumbnailToCache(const QString &picture_filename);
 	void recalculate(QString filename);
-	void processItem(QString filename, bool tryDownload);
+	void processItem(QString filename, bool tryDownload, Priority priority);
 	Thumbnail getThumbnailFromCache(const QString &picture_filename);
 	Thumbnail getPictureThumbnailFromStream(QDataStream &stream);
 	Thumbnail getVideoThumbnailFromStream(QDataStream &stream, const QString &filename);
-	Thumbnail fetchImage(const QString &filename, const QString &originalFilename, bool tryDownload);
-	Thumbnail getHashedImage(const QString &filename, bool tryDownload);
+	Thumbnail fetchImage(const QString &filename, const QString &originalFilename, bool tryDownload, Priority priority);
+	Thumbnail getHashedImage(const QString &filename, bool tryDownload, Priority priority = VISIBLE);
+	QImage decodeThumbnail(const QString &filename);
 	void markVideoThumbnail(QImage &img);
+	static void reportMemoryUsage(struct mem_usage *usage, void *data);
+
+	enum JobType {
+		PROCESS,		// Fetch from cache or calculate, download if needed
+		PROCESS_DOWNLOADED,	// Likewise, but the picture was just downloaded
+		RECALCULATE
+	};
+	struct Job {
+		JobType type;
+		Priority priority;
+		quint64 seq;		// Identifies the entry in the queues
+	};
+	void enqueue(const QString &filename, JobType type, Priority priority);
+	void requeue(const QString &filename, Job &job, Priority priority);
+	void work();
 
 	mutable QMutex lock;
 	QThreadPool pool;
@@ -85,7 +143,19 @@ private:
 	QImage videoOverlayImage;	// Overlay for video thumbnails
 	QImage unknownImage;		// Place holder for files where we couldn't determine the type
 
-	QMap<QString,QFuture<void>> workingOn;
+	// Thumbnails either queued or being processed
+	QSet<QString> workingOn;
+	// The queued thumbnails. If a thumbnail is reprioritized or cancelled, its old
+	// entry in the queues is left in place and skipped because the seq doesn't match.
+	QHash<QString, Job> queued;
+	std::deque<std::pair<QString, quint64>> queues[NUM_PRIORITIES];
+	quint64 jobSeq;
+	int numWorkers;
+
+	// The memory reserved by the pictures that are being decoded
+	QMutex decodeLock;
+	QWaitCondition decodeMemoryFreed;
+	qint64 decodeMemory;
 };
 
 #endif // IMAGEDOWNLOADER_H
@@ -12,6 +12,7 @@
 #include "divelist.h"
 #include "gettext.h"
 #include "import-csv.h"
+#include "membuffer.h"
 #include "qthelper.h"
 
 #define MATCH(buffer, pattern) \
@@ -284,12 +285,617 @@ static int parse_dan_format(const char *filename, char **params, int pnr, struct
 	return ret;
 }
 
+/*
+ * Native conversion of the generic "csv" import into Subsurface XML.
+ *
+ * csv2xml.xslt walks the file recursively, line by line and field by
+ * field, which is slow and runs into the XSLT recursion limit for long
+ * logs. For the common case, the same XML is generated here in a single
+ * pass over the file and then read by the streaming XML parser. This
+ * mimics the XPath string and number semantics of the stylesheet, so
+ * both produce the same dives.
+ *
+ * Anything that is not handled (quoted fields, imperial units, time
+ * deltas, Seabear header data, ...) makes csv_to_xml() fail, and the
+ * caller falls back to the stylesheet.
+ */
+struct csv_string {
+	const char *data;
+	size_t len;
+};
+
+static const struct csv_string csv_empty = { "", 0 };
+
+/* XPath substring-before() for a single character pattern, 0 is the empty pattern */
+static struct csv_string csv_before(struct csv_string s, char c)
+{
+	const char *p = c && s.len ? memchr(s.data, c, s.len) : NULL;
+	struct csv_string res = { s.data, p ? (size_t)(p - s.data) : 0 };
+	return res;
+}
+
+/* XPath substring-after() for a single character pattern, 0 is the empty pattern */
+static struct csv_string csv_after(struct csv_string s, char c)
+{
+	const char *p;
+	struct csv_string res = csv_empty;
+
+	if (!c)
+		return s;
+	p = s.len ? memchr(s.data, c, s.len) : NULL;
+	if (p) {
+		res.data = p + 1;
+		res.len = s.len - (p + 1 - s.data);
+	}
+	return res;
+}
+
+static bool csv_equal(struct csv_string a, struct csv_string b)
+{
+	return a.len == b.len && !memcmp(a.data, b.data, a.len);
+}
+
+/* The getFieldByIndex template of commonTemplates.xsl for unquoted fields */
+static struct csv_string csv_field(struct csv_string line, int index, char fs)
+{
+	struct csv_string res;
+
+	for (; index > 0; index--)
+		line = csv_after(line, fs);
+	res = csv_before(line, fs);
+	if (res.len)
+		return res;
+	if (csv_after(line, fs).len == 0 && !(line.len == 1 && line.data[0] == fs))
+		return line;
+	return csv_empty;
+}
+
+static bool csv_blank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+/*
+ * The XPath number() of a string, NaN for anything but a plain decimal
+ * number. This follows the algorithm of libxml2 to get the same rounding.
+ * Returns false for strings that may be read differently (exponents, long
+ * fractions, a lone minus sign), in which case we give up.
+ */
+static bool csv_number(struct csv_string s, double *res)
+{
+	const char *p = s.data, *end = s.data + s.len;
+	bool negative = false, digits = false;
+	double ret = 0.0;
+
+	*res = NAN;
+	while (p < end && csv_blank(*p))
+		p++;
+	if (p < end && *p == '-') {
+		negative = true;
+		p++;
+	}
+	while (p < end && *p >= '0' && *p <= '9') {
+		ret = ret * 10 + (*p++ - '0');
+		digits = true;
+	}
+	if (p < end && *p == '.') {
+		double fraction = 0.0;
+		int frac = 0;
+		p++;
+		while (p < end && *p >= '0' && *p <= '9') {
+			if (++frac > 15)
+				return false;
+			fraction = fraction * 10 + (*p++ - '0');
+			digits = true;
+		}
+		ret += fraction / pow(10.0, frac);
+	}
+	if ((digits && p < end && (*p == 'e' || *p == 'E')) || (negative && !digits))
+		return false;
+	while (p < end && csv_blank(*p))
+		p++;
+	if (digits && p == end)
+		*res = negative ? -ret : ret;
+	return true;
+}
+
+/* An XPath number as a string, as long as it is a non-negative integer */
+static bool put_csv_integer(struct membuffer *b, double d)
+{
+	if (isnan(d) || d < 0.0 || d > 1e9 || d != floor(d))
+		return false;
+	put_format(b, "%d", (int)d);
+	return true;
+}
+
+/* Escape a string for an attribute value, replacing the character from by to, or removing it if to is 0 */
+static void put_csv_escaped(struct membuffer *b, struct csv_string value, char from, char to)
+{
+	size_t i;
+
+	for (i = 0; i < value.len; i++) {
+		char c = value.data[i];
+		switch (c) {
+		case '&':
+			put_string(b, "&amp;");
+			break;
+		case '<':
+			put_string(b, "&lt;");
+			break;
+		case '>':
+			put_string(b, "&gt;");
+			break;
+		case '"':
+			put_string(b, "&quot;");
+			break;
+		case '\n':
+			put_string(b, "&#10;");
+			break;
+		case '\t':
+			put_string(b, "&#9;");
+			break;
+		default:
+			if (from && c == from) {
+				if (!to)
+					continue;
+				c = to;
+			}
+			put_bytes(b, &c, 1);
+		}
+	}
+}
+
+static void put_csv_attribute(struct membuffer *b, const char *name, struct csv_string value)
+{
+	put_format(b, " %s=\"", name);
+	put_csv_escaped(b, value, 0, 0);
+	put_string(b, "\"");
+}
+
+/* The attribute value with decimal commas replaced by points */
+static void put_csv_decimal(struct membuffer *b, const char *name, struct csv_string value)
+{
+	put_format(b, " %s=\"", name);
+	put_csv_escaped(b, value, ',', '.');
+	put_string(b, "\"");
+}
+
+static const char *csv_param(char **params, const char *name)
+{
+	int i;
+
+	for (i = 0; params[i]; i += 2) {
+		if (!strcmp(params[i], name))
+			return params[i + 1];
+	}
+	return NULL;
+}
+
+/* An integer parameter, -1 if it is not set. Returns false if it is not an integer. */
+static bool csv_int_param(char **params, const char *name, int *res)
+{
+	const char *value = csv_param(params, name);
+	char *end;
+
+	*res = -1;
+	if (!value)
+		return true;
+	*res = strtol(value, &end, 10);
+	return end != value && !*end;
+}
+
+/* The string value of a numeric parameter, such as the date and time of the dive */
+static bool csv_digits_param(char **params, const char *name, char *buf, size_t size)
+{
+	const char *value = csv_param(params, name);
+	size_t len;
+
+	if (!value || !*value || strspn(value, "0123456789") != strlen(value))
+		return false;
+	while (value[0] == '0' && value[1])
+		value++;
+	len = strlen(value);
+	if (len >= size)
+		return false;
+	memcpy(buf, value, len + 1);
+	return true;
+}
+
+/* XPath substring() of an ASCII string */
+static struct csv_string csv_substring(const char *s, size_t start, size_t len)
+{
+	struct csv_string res = csv_empty;
+	size_t slen = strlen(s);
+
+	if (start <= slen) {
+		res.data = s + start - 1;
+		res.len = MIN(len, slen - start + 1);
+	}
+	return res;
+}
+
+/* The sec2time template: minutes and rounded seconds */
+static bool put_csv_sec2time(struct membuffer *b, double t)
+{
+	if (signbit(t) || !put_csv_integer(b, floor(t / 60)))
+		return false;
+	put_format(b, ":%02d", (int)floor(fmod(t, 60) + 0.5));
+	return true;
+}
+
+/* Minutes and fractional minutes */
+static bool csv_minutes(struct csv_string value, char sep, double *res)
+{
+	struct csv_string frac = csv_after(value, sep);
+	double min, sec;
+	char *buf = malloc(frac.len + 1);
+	struct csv_string fraction = { buf, frac.len + 1 };
+	bool ok;
+
+	if (!buf)
+		return false;
+	buf[0] = '.';
+	memcpy(buf + 1, frac.data, frac.len);
+	ok = csv_number(csv_before(value, sep), &min) && csv_number(fraction, &sec);
+	free(buf);
+	*res = min * 60 + sec * 60;
+	return ok;
+}
+
+/* The time attribute of a sample as generated by the printFields template */
+static bool put_csv_time(struct membuffer *b, struct csv_string value, bool is_seconds, bool apd)
+{
+	struct csv_string rest = csv_after(value, ':');
+	double t, t2;
+
+	put_string(b, " time=\"");
+	if (is_seconds) {
+		/* Seconds, or minutes if there is a fraction */
+		if (csv_after(value, '.').len && !apd) {
+			if (!csv_minutes(value, '.', &t))
+				return false;
+		} else if (csv_after(value, ',').len) {
+			if (!csv_minutes(value, ',', &t))
+				return false;
+		} else if (!csv_number(value, &t)) {
+			return false;
+		}
+		if (!put_csv_sec2time(b, t))
+			return false;
+	} else if (!csv_after(rest, ':').len) {
+		/* m:s */
+		if (!csv_number(csv_before(value, ':'), &t) || !csv_number(rest, &t2) ||
+		    !put_csv_integer(b, t * 60 + t2))
+			return false;
+	} else {
+		/* h:m:s */
+		if (!csv_number(csv_before(value, ':'), &t) || !csv_number(csv_before(rest, ':'), &t2) ||
+		    !put_csv_integer(b, t * 60 + t2))
+			return false;
+		put_string(b, ":");
+		put_csv_escaped(b, csv_after(rest, ':'), 0, 0);
+	}
+	put_string(b, "\"");
+	return true;
+}
+
+/* Is this string a number for XPath? Clears *ok if we can't tell. */
+static bool csv_is_number(struct csv_string s, bool translate_comma, bool *ok)
+{
+	char *buf = NULL;
+	double d;
+	size_t i;
+
+	if (translate_comma && s.len && memchr(s.data, ',', s.len)) {
+		buf = malloc(s.len);
+		if (!buf) {
+			*ok = false;
+			return false;
+		}
+		for (i = 0; i < s.len; i++)
+			buf[i] = s.data[i] == ',' ? '.' : s.data[i];
+		s.data = buf;
+	}
+	if (!csv_number(s, &d))
+		*ok = false;
+	free(buf);
+	return !isnan(d);
+}
+
+struct csv_fields {
+	int time, depth, temp, po2, setpoint, sensor[3];
+	int cns, otu, ndl, tts, stopdepth, pressure, heartbeat;
+};
+
+static bool put_csv_sample(struct membuffer *b, struct csv_string line, const struct csv_fields *f, char fs, bool apd)
+{
+	static const char *sensor_names[] = { "sensor1", "sensor2", "sensor3" };
+	struct csv_string value = csv_field(line, f->time, fs), field;
+	bool ok = true, is_seconds;
+	double d;
+	int i;
+
+	is_seconds = csv_is_number(value, true, &ok);
+	if (!is_seconds && !csv_is_number(csv_before(value, ':'), false, &ok))
+		return ok;
+	if (!ok)
+		return false;
+
+	put_string(b, "<sample");
+	if (!put_csv_time(b, value, is_seconds, apd))
+		return false;
+	put_csv_decimal(b, "depth", csv_field(line, f->depth, fs));
+	if (f->temp >= 0) {
+		field = csv_field(line, f->temp, fs);
+		if (field.len)
+			put_csv_decimal(b, "temp", field);
+	}
+	if (f->setpoint >= 0)
+		put_csv_attribute(b, "po2", csv_field(line, f->setpoint, fs));
+	else if (f->po2 >= 0)
+		put_csv_attribute(b, "po2", csv_field(line, f->po2, fs));
+	for (i = 0; i < 3; i++) {
+		if (f->sensor[i] >= 0)
+			put_csv_attribute(b, sensor_names[i], csv_field(line, f->sensor[i], fs));
+	}
+	if (f->cns >= 0)
+		put_csv_attribute(b, "cns", csv_field(line, f->cns, fs));
+	if (f->otu >= 0)
+		put_csv_attribute(b, "otu", csv_field(line, f->otu, fs));
+	if (f->ndl >= 0)
+		put_csv_attribute(b, "ndl", csv_field(line, f->ndl, fs));
+	if (f->tts >= 0)
+		put_csv_attribute(b, "tts", csv_field(line, f->tts, fs));
+	if (f->stopdepth >= 0) {
+		field = csv_field(line, f->stopdepth, fs);
+		if (!csv_number(field, &d))
+			return false;
+		put_csv_attribute(b, "stopdepth", field);
+		put_format(b, " in_deco=\"%d\"", d > 0 ? 1 : 0);
+	}
+	if (f->pressure >= 0) {
+		field = csv_field(line, f->pressure, fs);
+		if (!csv_number(field, &d))
+			return false;
+		if (d >= 0)
+			put_csv_attribute(b, "pressure", field);
+	}
+	if (f->heartbeat >= 0)
+		put_csv_attribute(b, "heartbeat", csv_field(line, f->heartbeat, fs));
+	put_string(b, " />\n");
+	return true;
+}
+
+/* The date of the dive, from a field or the date parameter */
+static bool put_csv_date(struct membuffer *b, struct csv_string header, int field, int datefmt, char fs, char **params)
+{
+	struct csv_string indate, first, second, third;
+	char sep = 0, date[10];
+
+	put_string(b, " date=\"");
+	if (field < 0) {
+		if (!csv_digits_param(params, "date", date, sizeof(date)))
+			return false;
+		put_csv_escaped(b, csv_substring(date, 1, 4), 0, 0);
+		put_string(b, "-");
+		put_csv_escaped(b, csv_substring(date, 5, 2), 0, 0);
+		put_string(b, "-");
+		put_csv_escaped(b, csv_substring(date, 7, 2), 0, 0);
+		put_string(b, "\"");
+		return true;
+	}
+
+	indate = csv_field(header, field, fs);
+	if (csv_before(indate, '.').len)
+		sep = '.';
+	else if (csv_before(indate, '-').len)
+		sep = '-';
+	else if (csv_before(indate, '/').len)
+		sep = '/';
+	first = csv_before(indate, sep);
+	second = csv_before(csv_after(indate, sep), sep);
+	third = csv_after(csv_after(indate, sep), sep);
+	switch (datefmt) {
+	case 0: /* dd.mm.yyyy */
+		put_csv_escaped(b, third, ' ', 0);
+		put_string(b, "-");
+		put_csv_escaped(b, second, ' ', 0);
+		put_string(b, "-");
+		put_csv_escaped(b, first, ' ', 0);
+		break;
+	case 1: /* mm.dd.yyyy */
+		put_csv_escaped(b, third, ' ', 0);
+		put_string(b, "-");
+		put_csv_escaped(b, first, ' ', 0);
+		put_string(b, "-");
+		put_csv_escaped(b, second, ' ', 0);
+		break;
+	case 2: /* yyyy.mm.dd */
+		put_csv_escaped(b, first, ' ', 0);
+		put_string(b, "-");
+		put_csv_escaped(b, second, ' ', 0);
+		put_string(b, "-");
+		put_csv_escaped(b, third, ' ', 0);
+		break;
+	default:
+		put_string(b, "1900-1-1");
+	}
+	put_string(b, "\"");
+	return true;
+}
+
+/* The start time of the dive, from a field or the time parameter */
+static bool put_csv_start_time(struct membuffer *b, struct csv_string header, int field, char fs, char **params)
+{
+	char time[10];
+
+	if (field >= 0) {
+		put_csv_attribute(b, "time", csv_field(header, field, fs));
+		return true;
+	}
+	if (!csv_digits_param(params, "time", time, sizeof(time)))
+		return false;
+	put_string(b, " time=\"");
+	put_csv_escaped(b, csv_substring(time, 2, 2), 0, 0);
+	put_string(b, ":");
+	put_csv_escaped(b, csv_substring(time, 4, 2), 0, 0);
+	put_string(b, "\"");
+	return true;
+}
+
+/* The hw parameter, which has to be a string literal */
+static bool csv_hw_param(char **params, struct csv_string *hw)
+{
+	const char *value = csv_param(params, "hw");
+	size_t len;
+
+	*hw = csv_empty;
+	if (!value)
+		return true;
+	len = strlen(value);
+	if (len < 2 || (value[0] != '"' && value[0] != '\'') || value[len - 1] != value[0] ||
+	    memchr(value + 1, value[0], len - 2))
+		return false;
+	hw->data = value + 1;
+	hw->len = len - 2;
+	return true;
+}
+
+/*
+ * Copy the file with the line ends normalized the way the XML parser does.
+ * Returns NULL for anything that the stylesheet would read differently.
+ */
+static char *csv_normalize(const struct memblock *mem, size_t *len)
+{
+	const char *in = mem->buffer;
+	char *out = malloc(mem->size + 2);
+	bool blank = true;
+	size_t i, n = 0;
+
+	if (!out)
+		return NULL;
+	for (i = 0; i < mem->size; i++) {
+		unsigned char c = in[i];
+		if (c == '\r') {
+			if (i + 1 < mem->size && in[i + 1] == '\n')
+				continue;
+			c = '\n';
+		}
+		if ((c < ' ' && c != '\t' && c != '\n') || c == '"' || c == '<' || c == 0x7f ||
+		    (c == ']' && i + 2 < mem->size && in[i + 1] == ']' && in[i + 2] == '>')) {
+			free(out);
+			return NULL;
+		}
+		if (!csv_blank(c))
+			blank = false;
+		out[n++] = c;
+	}
+	out[n++] = '\n';
+	out[n] = 0;
+	if (blank || !xmlCheckUTF8((const xmlChar *)out)) {
+		free(out);
+		return NULL;
+	}
+	*len = n;
+	return out;
+}
+
+static int csv_to_xml(const struct memblock *mem, char **params, const char *csvtemplate, struct membuffer *b)
+{
+	static const char *unsupported[] = { "delta", "diveNro", "diveMode", "Firmware", "Serial", "GF",
+					     "maxDepth", "meanDepth", "airTemp", "waterTemp" };
+	struct csv_fields f;
+	struct csv_string text, header, line, next, hw;
+	int datefield, datefmt, starttimefield, numberfield, separator, units;
+	char fs;
+	char *buf;
+	size_t i, len;
+	bool ok = true;
+
+	if (strcmp(csvtemplate, "csv"))
+		return -1;
+	for (i = 0; i < sizeof(unsupported) / sizeof(unsupported[0]); i++) {
+		if (csv_param(params, unsupported[i]))
+			return -1;
+	}
+	ok &= csv_int_param(params, "units", &units);
+	ok &= csv_int_param(params, "separatorIndex", &separator);
+	ok &= csv_int_param(params, "dateField", &datefield);
+	ok &= csv_int_param(params, "datefmt", &datefmt);
+	ok &= csv_int_param(params, "starttimeField", &starttimefield);
+	ok &= csv_int_param(params, "numberField", &numberfield);
+	ok &= csv_int_param(params, "timeField", &f.time);
+	ok &= csv_int_param(params, "depthField", &f.depth);
+	ok &= csv_int_param(params, "tempField", &f.temp);
+	ok &= csv_int_param(params, "po2Field", &f.po2);
+	ok &= csv_int_param(params, "setpointField", &f.setpoint);
+	ok &= csv_int_param(params, "o2sensor1Field", &f.sensor[0]);
+	ok &= csv_int_param(params, "o2sensor2Field", &f.sensor[1]);
+	ok &= csv_int_param(params, "o2sensor3Field", &f.sensor[2]);
+	ok &= csv_int_param(params, "cnsField", &f.cns);
+	ok &= csv_int_param(params, "otuField", &f.otu);
+	ok &= csv_int_param(params, "ndlField", &f.ndl);
+	ok &= csv_int_param(params, "ttsField", &f.tts);
+	ok &= csv_int_param(params, "stopdepthField", &f.stopdepth);
+	ok &= csv_int_param(params, "pressureField", &f.pressure);
+	ok &= csv_int_param(params, "heartBeat", &f.heartbeat);
+	ok &= csv_hw_param(params, &hw);
+	if (!ok || units != 0)
+		return -1;
+
+	buf = csv_normalize(mem, &len);
+	if (!buf)
+		return -1;
+	text.data = buf;
+	text.len = len;
+	fs = separator == 0 ? '\t' : separator == 2 ? ';' : separator == 3 ? '|' : ',';
+
+	put_string(b, "<divelog program=\"subsurface-import\" version=\"2\">\n<dives>\n<dive");
+	header = csv_after(csv_after(text, '\n'), '\n');
+	ok = put_csv_date(b, header, datefield, datefmt, fs, params) &&
+	     put_csv_start_time(b, header, starttimefield, fs, params);
+	if (numberfield >= 0)
+		put_csv_attribute(b, "number", csv_field(header, numberfield, fs));
+	put_string(b, ">\n");
+
+	if (f.po2 >= 0 || f.setpoint >= 0 || f.sensor[0] >= 0 || f.sensor[1] >= 0 || f.sensor[2] >= 0)
+		put_string(b, "<cylinder description=\"oxygen\" o2=\"100.0%\" use=\"oxygen\" />\n"
+			      "<cylinder description=\"diluent\" o2=\"21.0%\" use=\"diluent\" />\n"
+			      "<divecomputer deviceid=\"ffffffff\" dctype=\"CCR\"");
+	else
+		put_string(b, "<divecomputer deviceid=\"ffffffff\"");
+	if (f.po2 >= 0 || f.setpoint >= 0 || f.sensor[0] >= 0 || f.sensor[1] >= 0 || f.sensor[2] >= 0)
+		put_format(b, " no_o2sensors=\"%d\"", (f.sensor[0] >= 0) + (f.sensor[1] >= 0) + (f.sensor[2] >= 0));
+	if (hw.len)
+		put_csv_attribute(b, "model", hw);
+	else
+		put_string(b, " model=\"Imported from CSV\"");
+	put_string(b, ">\n");
+
+	/* The samples: skip lines that are identical to the next one */
+	line = csv_before(text, '\n');
+	text = csv_after(text, '\n');
+	while (ok) {
+		next = csv_before(text, '\n');
+		if (!csv_equal(line, next))
+			ok = put_csv_sample(b, line, &f, fs, hw.len && strstr(hw.data, "APD"));
+		if (!text.len)
+			break;
+		line = next;
+		text = csv_after(text, '\n');
+	}
+	put_string(b, "</divecomputer>\n</dive>\n</dives>\n</divelog>\n");
+	free(buf);
+	return ok ? 0 : -1;
+}
+
 int parse_csv_file(const char *filename, char **params, int pnr, const char *csvtemplate,
 		   struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites,
 		   filter_preset_table_t *filter_presets)
 {
 	int ret, i;
 	struct memblock mem;
+	struct membuffer native = { 0 };
 	time_t now;
 	struct tm *timep = NULL;
 	char tmpbuf[MAXCOLDIGITS];
@@ -324,6 +930,19 @@ int parse_csv_file(const char *filename, char **params, int pnr, const char *csv
 		params[pnr++] = NULL;
 	}
 
+	if (readfile(filename, &mem) < 0)
+		return report_error(translate("gettextFromC", "Failed to read '%s'"), filename);
+
+	if (csv_to_xml(&mem, params, csvtemplate, &native) == 0) {
+		free(mem.buffer);
+		ret = parse_xml_buffer(filename, mb_cstring(&native), native.len, table, trips, sites, filter_presets, (const char **)params);
+		free_buffer(&native);
+		for (i = 0; params[i]; i += 2)
+			free(params[i + 1]);
+		return ret;
+	}
+	free_buffer(&native);
+
 	if (try_to_xslt_open_csv(filename, &mem, csvtemplate))
 		return -1;
 
@@ -259,21 +259,26 @@ static int divinglog_profile(void *param, int columns, char **data, char **colum
 	return 0;
 }
 
+/*
+ * The first cylinder and the profile are read with the dive itself, the
+ * other cylinders by a single query over the Tank table ordered by dive.
+ */
+struct divinglog_import {
+	struct parser_state state;
+	struct sql_cursor cylinders;
+};
+
 static int divinglog_dive(void *param, int columns, char **data, char **column)
 {
 	UNUSED(columns);
 	UNUSED(column);
 
-	int retval = 0, diveid;
-	struct parser_state *state = (struct parser_state *)param;
-	sqlite3 *handle = state->sql_handle;
-	char get_profile_template[] = "select ProfileInt,Profile,Profile2,Profile3,Profile4,Profile5 from Logbook where ID = %d";
-	char get_cylinder0_template[] = "select 0,TankSize,PresS,PresE,PresW,O2,He,DblTank from Logbook where ID = %d";
-	char get_cylinder_template[] = "select TankID,TankSize,PresS,PresE,PresW,O2,He,DblTank from Tank where LogID = %d order by TankID";
-	char get_buffer[1024];
+	struct divinglog_import *import = (struct divinglog_import *)param;
+	struct parser_state *state = &import->state;
+	sqlite3_int64 diveid;
 
 	dive_start(state);
-	diveid = atoi(data[13]);
+	diveid = strtoll(data[13], NULL, 10);
 	state->cur_dive->number = atoi(data[0]);
 
 	state->cur_dive->when = (time_t)(atol(data[1]));
@@ -338,16 +343,12 @@ static int divinglog_dive(void *param, int columns, char **data, char **column)
 		state->cur_settings.dc.model = strdup("Divinglog import");
 	}
 
-	snprintf(get_buffer, sizeof(get_buffer) - 1, get_cylinder0_template, diveid);
-	retval = sqlite3_exec(handle, get_buffer, &divinglog_cylinder, state, NULL);
-	if (retval != SQLITE_OK) {
+	if (divinglog_cylinder(state, 8, data + 16, NULL)) {
 		fprintf(stderr, "%s", "Database query divinglog_cylinder0 failed.\n");
 		return 1;
 	}
 
-	snprintf(get_buffer, sizeof(get_buffer) - 1, get_cylinder_template, diveid);
-	retval = sqlite3_exec(handle, get_buffer, &divinglog_cylinder, state, NULL);
-	if (retval != SQLITE_OK) {
+	if (sql_cursor_rows(&import->cylinders, diveid, &divinglog_cylinder, state) != SQLITE_OK) {
 		fprintf(stderr, "%s", "Database query divinglog_cylinder failed.\n");
 		return 1;
 	}
@@ -375,9 +376,7 @@ static int divinglog_dive(void *param, int columns, char **data, char **column)
 		state->cur_dive->dc.model = strdup("Divinglog import");
 	}
 
-	snprintf(get_buffer, sizeof(get_buffer) - 1, get_profile_template, diveid);
-	retval = sqlite3_exec(handle, get_buffer, &divinglog_profile, state, NULL);
-	if (retval != SQLITE_OK) {
+	if (divinglog_profile(state, 6, data + 24, NULL)) {
 		fprintf(stderr, "%s", "Database query divinglog_profile failed.\n");
 		return 1;
 	}
@@ -395,18 +394,27 @@ int parse_divinglog_buffer(sqlite3 *handle, const char *url, const char *buffer,
 	UNUSED(size);
 
 	int retval;
-	struct parser_state state;
-
-	init_parser_state(&state);
-	state.target_table = table;
-	state.trips = trips;
-	state.sites = sites;
-	state.sql_handle = handle;
-
-	char get_dives[] = "select Number,strftime('%s',Divedate || ' ' || ifnull(Entrytime,'00:00')),Country || ' - ' || City || ' - ' || Place,Buddy,Comments,Depth,Divetime,Divemaster,Airtemp,Watertemp,Weight,Divesuit,Computer,ID,Visibility,SupplyType from Logbook where UUID not in (select UUID from DeletedRecords)";
-
-	retval = sqlite3_exec(handle, get_dives, &divinglog_dive, &state, NULL);
-	free_parser_state(&state);
+	struct divinglog_import import = { 0 };
+	struct parser_state *state = &import.state;
+
+	init_parser_state(state);
+	state->target_table = table;
+	state->trips = trips;
+	state->sites = sites;
+	state->sql_handle = handle;
+
+	char get_dives[] = "select Number,strftime('%s',Divedate || ' ' || ifnull(Entrytime,'00:00')),Country || ' - ' || City || ' - ' || Place,Buddy,Comments,Depth,Divetime,Divemaster,Airtemp,Watertemp,Weight,Divesuit,Computer,ID,Visibility,SupplyType,"
+			   "0,TankSize,PresS,PresE,PresW,O2,He,DblTank,"
+			   "ProfileInt,Profile,Profile2,Profile3,Profile4,Profile5 from Logbook where UUID not in (select UUID from DeletedRecords) order by cast(ID as integer)";
+	char get_cylinders[] = "select cast(LogID as integer),TankID,TankSize,PresS,PresE,PresW,O2,He,DblTank from Tank order by 1,TankID";
+
+	retval = sql_cursor_open(&import.cylinders, handle, get_cylinders);
+	if (retval != SQLITE_OK)
+		fprintf(stderr, "%s", "Database query divinglog_cylinder failed.\n");
+	else
+		retval = sqlite3_exec(handle, get_dives, &divinglog_dive, &import, NULL);
+	sql_cursor_close(&import.cylinders);
+	free_parser_state(state);
 
 	if (retval != SQLITE_OK) {
 		fprintf(stderr, "Database query failed '%s'.\n", url);
@@ -13,6 +13,16 @@
 #include "membuffer.h"
 #include "gettext.h"
 
+/*
+ * The records of all dives are read by one query per kind of record,
+ * ordered by dive id, instead of running these queries for every dive.
+ */
+struct shearwater_import {
+	struct parser_state state;
+	struct sql_cursor mode, cylinders, first_gas, changes, samples;
+	bool ai_samples;
+};
+
 static int shearwater_cylinders(void *param, int columns, char **data, char **column)
 {
 	UNUSED(columns);
@@ -85,6 +95,7 @@ static int shearwater_profile_sample(void *param, int columns, char **data, char
 	UNUSED(column);
 	struct parser_state *state = (struct parser_state *)param;
 	int d6, d7;
+	int row = get_dc(state)->samples;
 
 	sample_start(state);
 
@@ -95,8 +106,8 @@ static int shearwater_profile_sample(void *param, int columns, char **data, char
 	 * provided by Shearwater as is.
 	 */
 
-	if (data[9] && state->sample_rate)
-		state->cur_sample->time.seconds = atoi(data[9]) * state->sample_rate;
+	if (state->sample_rate)
+		state->cur_sample->time.seconds = row * state->sample_rate;
 	else if (data[0])
 		state->cur_sample->time.seconds = atoi(data[0]);
 
@@ -148,6 +159,7 @@ static int shearwater_ai_profile_sample(void *param, int columns, char **data, c
 	UNUSED(column);
 	struct parser_state *state = (struct parser_state *)param;
 	int d6, d9;
+	int row = get_dc(state)->samples;
 
 	sample_start(state);
 
@@ -158,8 +170,8 @@ static int shearwater_ai_profile_sample(void *param, int columns, char **data, c
 	 * provided by Shearwater as is.
 	 */
 
-	if (data[11] && state->sample_rate)
-		state->cur_sample->time.seconds = atoi(data[11]) * state->sample_rate;
+	if (state->sample_rate)
+		state->cur_sample->time.seconds = row * state->sample_rate;
 	else if (data[0])
 		state->cur_sample->time.seconds = atoi(data[0]);
 
@@ -225,27 +237,52 @@ static int shearwater_mode(void *param, int columns, char **data, char **column)
 	return 0;
 }
 
+static int shearwater_dive_records(struct shearwater_import *import, sqlite3_int64 dive_id, bool has_id)
+{
+	struct parser_state *state = &import->state;
+
+	if (has_id && sql_cursor_rows(&import->mode, dive_id, &shearwater_mode, state) != SQLITE_OK) {
+		fprintf(stderr, "%s", "Database query shearwater_mode failed.\n");
+		return 1;
+	}
+
+	if (sql_cursor_rows(&import->cylinders, dive_id, &shearwater_cylinders, state) != SQLITE_OK) {
+		fprintf(stderr, "%s", "Database query shearwater_cylinders failed.\n");
+		return 1;
+	}
+
+	if (import->first_gas.stmt && sql_cursor_rows(&import->first_gas, dive_id, &shearwater_changes, state) != SQLITE_OK) {
+		fprintf(stderr, "%s", "Database query shearwater_changes failed.\n");
+		return 1;
+	}
+
+	if (sql_cursor_rows(&import->changes, dive_id, &shearwater_changes, state) != SQLITE_OK) {
+		fprintf(stderr, "%s", "Database query shearwater_changes failed.\n");
+		return 1;
+	}
+
+	if (sql_cursor_rows(&import->samples, dive_id, import->ai_samples ? &shearwater_ai_profile_sample : &shearwater_profile_sample, state) != SQLITE_OK) {
+		fprintf(stderr, "%s", "Database query shearwater_profile_sample failed.\n");
+		return 1;
+	}
+
+	return 0;
+}
+
 static int shearwater_dive(void *param, int columns, char **data, char **column)
 {
 	UNUSED(columns);
 	UNUSED(column);
 
-	int retval = 0;
-	struct parser_state *state = (struct parser_state *)param;
-	sqlite3 *handle = state->sql_handle;
-	char get_profile_template[] = "select currentTime,currentDepth,waterTemp,averagePPO2,currentNdl,CNSPercent,decoCeiling,firstStopDepth,firstStopTime from dive_log_records where diveLogId=%ld";
-	char get_profile_template_ai[] = "select currentTime,currentDepth,waterTemp,averagePPO2,currentNdl,CNSPercent,decoCeiling,aiSensor0_PressurePSI,aiSensor1_PressurePSI,firstStopDepth,firstStopTime from dive_log_records where diveLogId = %ld";
-	char get_cylinder_template[] = "select fractionO2,fractionHe from dive_log_records where diveLogId = %ld group by fractionO2,fractionHe";
-	char get_changes_template[] = "select a.currentTime,a.fractionO2,a.fractionHe from dive_log_records as a,dive_log_records as b where (a.id - 1) = b.id and (a.fractionO2 != b.fractionO2 or a.fractionHe != b.fractionHe) and a.diveLogId=b.divelogId and a.diveLogId = %ld";
-	char get_mode_template[] = "select distinct currentCircuitSetting from dive_log_records where diveLogId = %ld";
-	char get_buffer[1024];
+	struct shearwater_import *import = (struct shearwater_import *)param;
+	struct parser_state *state = &import->state;
 
 	dive_start(state);
 	state->cur_dive->number = atoi(data[0]);
 
 	state->cur_dive->when = (time_t)(atol(data[1]));
 
-	long int dive_id = atol(data[11]);
+	sqlite3_int64 dive_id = data[11] ? strtoll(data[11], NULL, 10) : 0;
 
 	if (data[2])
 		add_dive_site(data[2], state->cur_dive, state);
@@ -305,39 +342,8 @@ static int shearwater_dive(void *param, int columns, char **data, char **column)
 		}
 	}
 
-	if (data[11]) {
-		snprintf(get_buffer, sizeof(get_buffer) - 1, get_mode_template, dive_id);
-		retval = sqlite3_exec(handle, get_buffer, &shearwater_mode, state, NULL);
-		if (retval != SQLITE_OK) {
-			fprintf(stderr, "%s", "Database query shearwater_mode failed.\n");
-			return 1;
-		}
-	}
-
-	snprintf(get_buffer, sizeof(get_buffer) - 1, get_cylinder_template, dive_id);
-	retval = sqlite3_exec(handle, get_buffer, &shearwater_cylinders, state, NULL);
-	if (retval != SQLITE_OK) {
-		fprintf(stderr, "%s", "Database query shearwater_cylinders failed.\n");
-		return 1;
-	}
-
-	snprintf(get_buffer, sizeof(get_buffer) - 1, get_changes_template, dive_id);
-	retval = sqlite3_exec(handle, get_buffer, &shearwater_changes, state, NULL);
-	if (retval != SQLITE_OK) {
-		fprintf(stderr, "%s", "Database query shearwater_changes failed.\n");
+	if (shearwater_dive_records(import, dive_id, data[11] != NULL))
 		return 1;
-	}
-
-	snprintf(get_buffer, sizeof(get_buffer) - 1, get_profile_template_ai, dive_id);
-	retval = sqlite3_exec(handle, get_buffer, &shearwater_ai_profile_sample, state, NULL);
-	if (retval != SQLITE_OK) {
-		snprintf(get_buffer, sizeof(get_buffer) - 1, get_profile_template, dive_id);
-		retval = sqlite3_exec(handle, get_buffer, &shearwater_profile_sample, state, NULL);
-		if (retval != SQLITE_OK) {
-			fprintf(stderr, "%s", "Database query shearwater_profile_sample failed.\n");
-			return 1;
-		}
-	}
 
 	dive_end(state);
 
@@ -349,32 +355,15 @@ static int shearwater_cloud_dive(void *param, int columns, char **data, char **c
 	UNUSED(columns);
 	UNUSED(column);
 
-	int retval = 0;
-	struct parser_state *state = (struct parser_state *)param;
-	sqlite3 *handle = state->sql_handle;
-
-	/*
-	 * Since Shearwater reported sample time can be totally bogus,
-	 * we need to calculate the sample number by ourselves. The
-	 * calculated sample number is multiplied by sample interval
-	 * giving us correct sample time.
-	 */
-
-	char get_profile_template[] = "select currentTime,currentDepth,waterTemp,averagePPO2,currentNdl,CNSPercent,decoCeiling,firstStopDepth,firstStopTime,(select count(0) from dive_log_records r where r.id < d.id and r.diveLogId = %ld and r.currentTime > 0) as row from dive_log_records d where d.diveLogId=%ld and d.currentTime > 0";
-	char get_profile_template_ai[] = "select currentTime,currentDepth,waterTemp,averagePPO2,currentNdl,CNSPercent,decoCeiling,aiSensor0_PressurePSI,aiSensor1_PressurePSI,firstStopDepth,firstStopTime,(select count(0) from dive_log_records r where r.id < d.id and r.diveLogId = %ld and r.currentTime > 0) as row from dive_log_records d where d.diveLogId = %ld and d.currentTime > 0";
-
-	char get_cylinder_template[] = "select fractionO2 / 100,fractionHe / 100 from dive_log_records where diveLogId = %ld group by fractionO2,fractionHe";
-	char get_first_gas_template[] = "select currentTime, fractionO2 / 100, fractionHe / 100 from dive_log_records where diveLogId = %ld limit 1";
-	char get_changes_template[] = "select a.currentTime,a.fractionO2 / 100,a.fractionHe /100 from dive_log_records as a,dive_log_records as b where (a.id - 1) = b.id and (a.fractionO2 != b.fractionO2 or a.fractionHe != b.fractionHe) and a.diveLogId=b.divelogId and a.diveLogId = %ld and a.fractionO2 > 0 and b.fractionO2 > 0";
-	char get_mode_template[] = "select distinct currentCircuitSetting from dive_log_records where diveLogId = %ld";
-	char get_buffer[1024];
+	struct shearwater_import *import = (struct shearwater_import *)param;
+	struct parser_state *state = &import->state;
 
 	dive_start(state);
 	state->cur_dive->number = atoi(data[0]);
 
 	state->cur_dive->when = (time_t)(atol(data[1]));
 
-	long int dive_id = atol(data[11]);
+	sqlite3_int64 dive_id = data[11] ? strtoll(data[11], NULL, 10) : 0;
 	if (data[12])
 		state->sample_rate = atoi(data[12]);
 	else
@@ -438,74 +427,62 @@ static int shearwater_cloud_dive(void *param, int columns, char **data, char **c
 		}
 	}
 
-	if (data[11]) {
-		snprintf(get_buffer, sizeof(get_buffer) - 1, get_mode_template, dive_id);
-		retval = sqlite3_exec(handle, get_buffer, &shearwater_mode, state, NULL);
-		if (retval != SQLITE_OK) {
-			fprintf(stderr, "%s", "Database query shearwater_mode failed.\n");
-			return 1;
-		}
-	}
-
-	snprintf(get_buffer, sizeof(get_buffer) - 1, get_cylinder_template, dive_id);
-	retval = sqlite3_exec(handle, get_buffer, &shearwater_cylinders, state, NULL);
-	if (retval != SQLITE_OK) {
-		fprintf(stderr, "%s", "Database query shearwater_cylinders failed.\n");
-		return 1;
-	}
-
-	snprintf(get_buffer, sizeof(get_buffer) - 1, get_first_gas_template, dive_id);
-	retval = sqlite3_exec(handle, get_buffer, &shearwater_changes, state, NULL);
-	if (retval != SQLITE_OK) {
-		fprintf(stderr, "%s", "Database query shearwater_changes failed.\n");
-		return 1;
-	}
-
-	snprintf(get_buffer, sizeof(get_buffer) - 1, get_changes_template, dive_id);
-	retval = sqlite3_exec(handle, get_buffer, &shearwater_changes, state, NULL);
-	if (retval != SQLITE_OK) {
-		fprintf(stderr, "%s", "Database query shearwater_changes failed.\n");
+	if (shearwater_dive_records(import, dive_id, data[11] != NULL))
 		return 1;
-	}
-
-	snprintf(get_buffer, sizeof(get_buffer) - 1, get_profile_template_ai, dive_id, dive_id);
-	retval = sqlite3_exec(handle, get_buffer, &shearwater_ai_profile_sample, state, NULL);
-	if (retval != SQLITE_OK) {
-		snprintf(get_buffer, sizeof(get_buffer) - 1, get_profile_template, dive_id, dive_id);
-		retval = sqlite3_exec(handle, get_buffer, &shearwater_profile_sample, state, NULL);
-		if (retval != SQLITE_OK) {
-			fprintf(stderr, "%s", "Database query shearwater_profile_sample failed.\n");
-			return 1;
-		}
-	}
 
 	dive_end(state);
 
 	return SQLITE_OK;
 }
 
-int parse_shearwater_buffer(sqlite3 *handle, const char *url, const char *buffer, int size,
-			    struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites)
-{
-	UNUSED(buffer);
-	UNUSED(size);
-
-	int retval;
-	struct parser_state state;
-
-	init_parser_state(&state);
-	state.target_table = table;
-	state.trips = trips;
-	state.sites = sites;
-	state.sql_handle = handle;
+struct shearwater_queries {
+	const char *mode, *cylinders, *first_gas, *changes, *samples_ai, *samples;
+};
 
-	// So far have not seen any sample rate in Shearwater Desktop
-	state.sample_rate = 0;
+static int shearwater_import_dives(sqlite3 *handle, const char *url, const char *get_dives, const struct shearwater_queries *queries,
+				   int (*dive_callback)(void *, int, char **, char **),
+				   struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites)
+{
+	int retval = SQLITE_OK;
+	struct shearwater_import import = { 0 };
+	struct parser_state *state = &import.state;
+
+	init_parser_state(state);
+	state->target_table = table;
+	state->trips = trips;
+	state->sites = sites;
+	state->sql_handle = handle;
+	/* The cloud dives set their own sample rate */
+	state->sample_rate = 0;
+
+	if (sql_cursor_open(&import.mode, handle, queries->mode) != SQLITE_OK) {
+		fprintf(stderr, "%s", "Database query shearwater_mode failed.\n");
+		retval = SQLITE_ERROR;
+	} else if (sql_cursor_open(&import.cylinders, handle, queries->cylinders) != SQLITE_OK) {
+		fprintf(stderr, "%s", "Database query shearwater_cylinders failed.\n");
+		retval = SQLITE_ERROR;
+	} else if ((queries->first_gas && sql_cursor_open(&import.first_gas, handle, queries->first_gas) != SQLITE_OK) ||
+		   sql_cursor_open(&import.changes, handle, queries->changes) != SQLITE_OK) {
+		fprintf(stderr, "%s", "Database query shearwater_changes failed.\n");
+		retval = SQLITE_ERROR;
+	} else {
+		/* Older logs don't have the air integration columns */
+		import.ai_samples = sql_cursor_open(&import.samples, handle, queries->samples_ai) == SQLITE_OK;
+		if (!import.ai_samples && sql_cursor_open(&import.samples, handle, queries->samples) != SQLITE_OK) {
+			fprintf(stderr, "%s", "Database query shearwater_profile_sample failed.\n");
+			retval = SQLITE_ERROR;
+		}
+	}
 
-	char get_dives[] = "select l.number,timestamp,location||' / '||site,buddy,notes,imperialUnits,maxDepth,maxTime,startSurfacePressure,computerSerial,computerModel,i.diveId FROM dive_info AS i JOIN dive_logs AS l ON i.diveId=l.diveId";
+	if (retval == SQLITE_OK)
+		retval = sqlite3_exec(handle, get_dives, dive_callback, &import, NULL);
 
-	retval = sqlite3_exec(handle, get_dives, &shearwater_dive, &state, NULL);
-	free_parser_state(&state);
+	sql_cursor_close(&import.mode);
+	sql_cursor_close(&import.cylinders);
+	sql_cursor_close(&import.first_gas);
+	sql_cursor_close(&import.changes);
+	sql_cursor_close(&import.samples);
+	free_parser_state(state);
 
 	if (retval != SQLITE_OK) {
 		fprintf(stderr, "Database query failed '%s'.\n", url);
@@ -515,30 +492,47 @@ int parse_shearwater_buffer(sqlite3 *handle, const char *url, const char *buffer
 	return 0;
 }
 
-int parse_shearwater_cloud_buffer(sqlite3 *handle, const char *url, const char *buffer, int size,
+int parse_shearwater_buffer(sqlite3 *handle, const char *url, const char *buffer, int size,
 			    struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites)
 {
 	UNUSED(buffer);
 	UNUSED(size);
 
-	int retval;
-	struct parser_state state;
-
-	init_parser_state(&state);
-	state.target_table = table;
-	state.trips = trips;
-	state.sites = sites;
-	state.sql_handle = handle;
-
-	char get_dives[] = "select l.number,strftime('%s', DiveDate),location||' / '||site,buddy,notes,imperialUnits,maxDepth,DiveLengthTime,startSurfacePressure,computerSerial,computerModel,d.diveId,l.sampleRateMs / 1000 FROM dive_details AS d JOIN dive_logs AS l ON d.diveId=l.diveId";
+	const struct shearwater_queries queries = {
+		.mode = "select cast(diveLogId as integer),currentCircuitSetting from dive_log_records group by 1,currentCircuitSetting order by 1,min(id)",
+		.cylinders = "select cast(diveLogId as integer),fractionO2,fractionHe from dive_log_records group by 1,fractionO2,fractionHe order by 1,fractionO2,fractionHe",
+		.first_gas = NULL,
+		.changes = "select cast(a.diveLogId as integer),a.currentTime,a.fractionO2,a.fractionHe from dive_log_records as a,dive_log_records as b where (a.id - 1) = b.id and (a.fractionO2 != b.fractionO2 or a.fractionHe != b.fractionHe) and a.diveLogId=b.divelogId order by 1,a.id",
+		.samples_ai = "select cast(diveLogId as integer),currentTime,currentDepth,waterTemp,averagePPO2,currentNdl,CNSPercent,decoCeiling,aiSensor0_PressurePSI,aiSensor1_PressurePSI,firstStopDepth,firstStopTime from dive_log_records order by 1,id",
+		.samples = "select cast(diveLogId as integer),currentTime,currentDepth,waterTemp,averagePPO2,currentNdl,CNSPercent,decoCeiling,firstStopDepth,firstStopTime from dive_log_records order by 1,id"
+	};
+	char get_dives[] = "select l.number,timestamp,location||' / '||site,buddy,notes,imperialUnits,maxDepth,maxTime,startSurfacePressure,computerSerial,computerModel,i.diveId FROM dive_info AS i JOIN dive_logs AS l ON i.diveId=l.diveId ORDER BY cast(i.diveId as integer)";
 
-	retval = sqlite3_exec(handle, get_dives, &shearwater_cloud_dive, &state, NULL);
-	free_parser_state(&state);
+	// So far have not seen any sample rate in Shearwater Desktop
+	return shearwater_import_dives(handle, url, get_dives, &queries, &shearwater_dive, table, trips, sites);
+}
 
-	if (retval != SQLITE_OK) {
-		fprintf(stderr, "Database query failed '%s'.\n", url);
-		return 1;
-	}
+int parse_shearwater_cloud_buffer(sqlite3 *handle, const char *url, const char *buffer, int size,
+			    struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites)
+{
+	UNUSED(buffer);
+	UNUSED(size);
 
-	return 0;
+	/*
+	 * Since Shearwater reported sample time can be totally bogus,
+	 * we need to calculate the sample number by ourselves. The
+	 * calculated sample number is multiplied by sample interval
+	 * giving us correct sample time.
+	 */
+	const struct shearwater_queries queries = {
+		.mode = "select cast(diveLogId as integer),currentCircuitSetting from dive_log_records group by 1,currentCircuitSetting order by 1,min(id)",
+		.cylinders = "select cast(diveLogId as integer),fractionO2 / 100,fractionHe / 100 from dive_log_records group by 1,fractionO2,fractionHe order by 1,fractionO2,fractionHe",
+		.first_gas = "select cast(diveLogId as integer),currentTime,fractionO2 / 100,fractionHe / 100 from dive_log_records where rowid in (select min(rowid) from dive_log_records group by diveLogId) order by 1",
+		.changes = "select cast(a.diveLogId as integer),a.currentTime,a.fractionO2 / 100,a.fractionHe /100 from dive_log_records as a,dive_log_records as b where (a.id - 1) = b.id and (a.fractionO2 != b.fractionO2 or a.fractionHe != b.fractionHe) and a.diveLogId=b.divelogId and a.fractionO2 > 0 and b.fractionO2 > 0 order by 1,a.id",
+		.samples_ai = "select cast(diveLogId as integer),currentTime,currentDepth,waterTemp,averagePPO2,currentNdl,CNSPercent,decoCeiling,aiSensor0_PressurePSI,aiSensor1_PressurePSI,firstStopDepth,firstStopTime from dive_log_records where currentTime > 0 order by 1,id",
+		.samples = "select cast(diveLogId as integer),currentTime,currentDepth,waterTemp,averagePPO2,currentNdl,CNSPercent,decoCeiling,firstStopDepth,firstStopTime from dive_log_records where currentTime > 0 order by 1,id"
+	};
+	char get_dives[] = "select l.number,strftime('%s', DiveDate),location||' / '||site,buddy,notes,imperialUnits,maxDepth,DiveLengthTime,startSurfacePressure,computerSerial,computerModel,d.diveId,l.sampleRateMs / 1000 FROM dive_details AS d JOIN dive_logs AS l ON d.diveId=l.diveId ORDER BY cast(d.diveId as integer)";
+
+	return shearwater_import_dives(handle, url, get_dives, &queries, &shearwater_cloud_dive, table, trips, sites);
 }
@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "importfiles.h"
+#include "divelist.h"
+#include "divesite.h"
+#include "file.h"
+#include "trip.h"
+
+#include <QThread>
+#include <QtConcurrent>
+#include <atomic>
+
+namespace {
+	struct ImportResult {
+		dive_table dives = empty_dive_table;
+		trip_table trips = empty_trip_table;
+		dive_site_table sites = empty_dive_site_table;
+		filter_preset_table_t filter_presets;
+	};
+}
+
+static void clearResult(ImportResult &res)
+{
+	clear_dive_table(&res.dives);
+	clear_trip_table(&res.trips);
+	clear_dive_site_table(&res.sites);
+	free(res.dives.dives);
+	free(res.trips.trips);
+	free(res.sites.dive_sites);
+}
+
+// When parsing into one table, a dive site that was already seen in a previous
+// file is reused. Do the same here: move the dives to the site of the previous
+// file and free the duplicate.
+static void addSites(ImportResult &res, struct dive_site_table *sites, struct dive_site_hash *hash)
+{
+	for (int i = 0; i < res.sites.nr; ++i) {
+		struct dive_site *ds = res.sites.dive_sites[i];
+		struct dive_site *old_ds = get_dive_site_by_uuid(ds->uuid, sites);
+		if (old_ds) {
+			merge_dive_site(old_ds, ds);
+			add_to_dive_site_hash(hash, old_ds);
+		} else {
+			old_ds = get_same_dive_site_hashed(ds, hash);
+		}
+		if (!old_ds) {
+			add_dive_site_to_table(ds, sites);
+			add_to_dive_site_hash(hash, ds);
+			continue;
+		}
+		while (ds->dives.nr > 0)
+			add_dive_to_dive_site(ds->dives.dives[0], old_ds);
+		free_dive_site(ds);
+	}
+}
+
+static void addResult(ImportResult &res, struct dive_table *table, struct trip_table *trips,
+		      struct dive_site_table *sites, struct dive_site_hash *hash, filter_preset_table_t *filter_presets)
+{
+	for (int i = 0; i < res.dives.nr; ++i)
+		add_to_dive_table(table, table->nr, res.dives.dives[i]);
+	for (int i = 0; i < res.trips.nr; ++i)
+		insert_trip(res.trips.trips[i], trips);
+	addSites(res, sites, hash);
+	if (filter_presets) {
+		for (const filter_preset &preset: res.filter_presets)
+			add_filter_preset_to_table(&preset, filter_presets);
+	}
+	free(res.dives.dives);
+	free(res.trips.trips);
+	free(res.sites.dive_sites);
+}
+
+bool runImportJobs(const std::vector<ImportJob> &jobs, const std::function<bool(int)> &progress,
+		   struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites,
+		   filter_preset_table_t *filter_presets)
+{
+	std::vector<ImportResult> results(jobs.size());
+	std::vector<int> concurrent, sequential;
+	std::atomic<int> done(0);
+	std::atomic<bool> canceled(false);
+
+	for (int i = 0; i < (int)jobs.size(); ++i) {
+		if (can_parse_file_concurrently(qPrintable(jobs[i].filename)))
+			concurrent.push_back(i);
+		else
+			sequential.push_back(i);
+	}
+
+	auto parse = [&jobs, &results, &done, &canceled](int idx) {
+		if (canceled)
+			return;
+		ImportResult &res = results[idx];
+		jobs[idx].parse(&res.dives, &res.trips, &res.sites, &res.filter_presets);
+		++done;
+	};
+	QFuture<void> future = QtConcurrent::map(concurrent, parse);
+
+	for (int idx: sequential) {
+		if (canceled || (progress && progress(done)))
+			canceled = true;
+		else
+			parse(idx);
+	}
+	while (!future.isFinished()) {
+		if (!canceled && progress && progress(done)) {
+			canceled = true;
+			future.cancel();
+		}
+		QThread::msleep(20);
+	}
+	future.waitForFinished();
+
+	struct dive_site_hash hash;
+	build_dive_site_hash(&hash, sites);
+	for (ImportResult &res: results) {
+		if (canceled)
+			clearResult(res);
+		else
+			addResult(res, table, trips, sites, &hash, filter_presets);
+	}
+	free_dive_site_hash(&hash);
+	return !canceled;
+}
@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: GPL-2.0
+// Import of many log files at once. Every file is parsed into its own tables
+// on the global thread pool. The results are then appended to the import
+// tables in the order of the files, so that they don't depend on the order
+// in which the parsers finished, and the caller can run a single
+// process_imported_dives() on them.
+#ifndef IMPORTFILES_H
+#define IMPORTFILES_H
+
+#include "filterpreset.h"
+#include <QString>
+#include <functional>
+#include <vector>
+
+struct dive_table;
+struct trip_table;
+struct dive_site_table;
+
+struct ImportJob {
+	QString filename;
+	std::function<void(struct dive_table *, struct trip_table *, struct dive_site_table *, filter_preset_table_t *)> parse;
+};
+
+// Files for which can_parse_file_concurrently() returns false are parsed on the
+// calling thread. The progress callback is called on the calling thread with the
+// number of parsed files and returns true to cancel the import. If the import
+// was canceled, nothing is added to the tables and false is returned.
+bool runImportJobs(const std::vector<ImportJob> &jobs, const std::function<bool(int)> &progress,
+		   struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites,
+		   filter_preset_table_t *filter_presets);
+
+#endif
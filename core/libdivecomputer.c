@@ -16,6 +16,7 @@
 #include "divesite.h"
 #include "subsurface-string.h"
 #include "device.h"
+#include "fingerprint.h"
 #include "dive.h"
 #include "display.h"
 #include "errorhelper.h"
@@ -29,8 +30,11 @@
 #include <libdivecomputer/serial.h>
 #include <libdivecomputer/irda.h>
 #include <libdivecomputer/bluetooth.h>
+#include <libdivecomputer/custom.h>
 
 #include "libdivecomputer.h"
+#include "parsequeue.h"
+#include "downloadstats.h"
 #include "core/version.h"
 #include "core/qthelper.h"
 #include "core/membuffer.h"
@@ -494,17 +498,85 @@ static int match_one_dive(struct divecomputer *a, struct dive *dive)
 	return 0;
 }
 
+/*
+ * A dive can only match a downloaded dive if one of its dive computers
+ * has the same start time. Therefore, during a download we keep the start
+ * times of all dive computers of the dive table in a sorted array.
+ */
+struct dc_start {
+	timestamp_t when;
+	struct dive *dive;
+};
+static struct dc_start *dc_starts;
+static int nr_dc_starts;
+
+static int comp_dc_start(const void *_a, const void *_b)
+{
+	const struct dc_start *a = _a, *b = _b;
+	if (a->when < b->when)
+		return -1;
+	return a->when > b->when;
+}
+
+static void build_dc_start_index(void)
+{
+	int i, nr = 0;
+	struct dive *dive;
+	struct divecomputer *dc;
+
+	for_each_dive(i, dive) {
+		for_each_dc(dive, dc)
+			nr++;
+	}
+	dc_starts = malloc(nr * sizeof(*dc_starts));
+	if (!dc_starts)
+		return;
+	for_each_dive(i, dive) {
+		for_each_dc(dive, dc) {
+			dc_starts[nr_dc_starts].when = dc->when;
+			dc_starts[nr_dc_starts].dive = dive;
+			nr_dc_starts++;
+		}
+	}
+	qsort(dc_starts, nr_dc_starts, sizeof(*dc_starts), comp_dc_start);
+}
+
+static void free_dc_start_index(void)
+{
+	free(dc_starts);
+	dc_starts = NULL;
+	nr_dc_starts = 0;
+}
+
 /*
  * Check if this dive already existed before the import
  */
 static int find_dive(struct divecomputer *match)
 {
-	int i;
+	int i, lo, hi;
 
-	for (i = dive_table.nr - 1; i >= 0; i--) {
-		struct dive *old = dive_table.dives[i];
+	if (!dc_starts) {
+		for (i = dive_table.nr - 1; i >= 0; i--) {
+			struct dive *old = dive_table.dives[i];
 
-		if (match_one_dive(match, old))
+			if (match_one_dive(match, old))
+				return 1;
+		}
+		return 0;
+	}
+
+	/* Find the first dive computer that started at that time */
+	lo = 0;
+	hi = nr_dc_starts;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (dc_starts[mid].when < match->when)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (i = lo; i < nr_dc_starts && dc_starts[i].when == match->when; i++) {
+		if (match_one_dive(match, dc_starts[i].dive))
 			return 1;
 	}
 	return 0;
@@ -773,6 +845,58 @@ static dc_status_t libdc_header_parser(dc_parser_t *parser, device_data_t *devda
 	return DC_STATUS_SUCCESS;
 }
 
+/*
+ * The samples of a dive are parsed by a worker thread, so that
+ * libdivecomputer can already transfer the next dive. The header is
+ * still parsed in dive_cb(), because it is cheap and it tells us whether
+ * we have to stop the download.
+ */
+#define PARSE_QUEUE_SIZE 16
+static struct parse_queue *parse_queue;
+
+struct parse_job {
+	device_data_t *devdata;
+	dc_parser_t *parser;
+	unsigned char *data;
+	struct dive *dive;
+};
+
+static void parse_dive_samples(void *userdata)
+{
+	struct parse_job *job = userdata;
+	struct dive *dive = job->dive;
+	uint64_t start = download_stats_now();
+	int rc;
+
+	/* reset static data, that is only valid per dive */
+	stoptime = stopdepth = po2 = cns = heartbeat = 0;
+	ndl = bearing = -1;
+	in_deco = false;
+	current_gas_index = -1;
+
+	// Initialize the sample data.
+	rc = parse_samples(job->devdata, &dive->dc, job->parser);
+	dc_parser_destroy(job->parser);
+	free(job->data);
+	if (rc != DC_STATUS_SUCCESS) {
+		download_error(translate("gettextFromC", "Error parsing the samples"));
+		free(dive);
+		free(job);
+		return;
+	}
+
+	/* Various libdivecomputer interface fixups */
+	if (dive->dc.airtemp.mkelvin == 0 && first_temp_is_air && dive->dc.samples) {
+		dive->dc.airtemp = dive->dc.sample[0].temperature;
+		dive->dc.sample[0].temperature.mkelvin = 0;
+	}
+
+	record_dive_to_table(dive, job->devdata->download_table);
+	free(job);
+	download_stats_phase(DOWNLOAD_SAMPLES, start);
+	download_stats_dive();
+}
+
 /* returns true if we want libdivecomputer's dc_device_foreach() to continue,
  *  false otherwise */
 static int dive_cb(const unsigned char *data, unsigned int size,
@@ -783,12 +907,9 @@ static int dive_cb(const unsigned char *data, unsigned int size,
 	dc_parser_t *parser = NULL;
 	device_data_t *devdata = userdata;
 	struct dive *dive = NULL;
-
-	/* reset static data, that is only valid per dive */
-	stoptime = stopdepth = po2 = cns = heartbeat = 0;
-	ndl = bearing = -1;
-	in_deco = false;
-	current_gas_index = -1;
+	struct parse_job *job;
+	unsigned char *copy = NULL;
+	uint64_t start = download_stats_now();
 
 	import_dive_number++;
 
@@ -798,7 +919,15 @@ static int dive_cb(const unsigned char *data, unsigned int size,
 		return true;
 	}
 
-	rc = dc_parser_set_data(parser, data, size);
+	/* The data is only valid during the callback, but the samples are parsed later */
+	copy = malloc(size);
+	if (!copy) {
+		download_error(translate("gettextFromC", "Error registering the data"));
+		goto error_exit;
+	}
+	memcpy(copy, data, size);
+
+	rc = dc_parser_set_data(parser, copy, size);
 	if (rc != DC_STATUS_SUCCESS) {
 		download_error(translate("gettextFromC", "Error registering the data"));
 		goto error_exit;
@@ -827,35 +956,37 @@ static int dive_cb(const unsigned char *data, unsigned int size,
 		goto error_exit;
 	}
 
-	// Initialize the sample data.
-	rc = parse_samples(devdata, &dive->dc, parser);
-	if (rc != DC_STATUS_SUCCESS) {
-		download_error(translate("gettextFromC", "Error parsing the samples"));
-		goto error_exit;
-	}
-
-	dc_parser_destroy(parser);
-
 	/* If we already saw this dive, abort. */
 	if (!devdata->force_download && find_dive(&dive->dc)) {
 		char *date_string = get_dive_date_c_string(dive->when);
 		dev_info(devdata, translate("gettextFromC", "Already downloaded dive at %s"), date_string);
 		free(date_string);
+		dc_parser_destroy(parser);
+		free(copy);
 		free(dive);
 		return false;
 	}
 
-	/* Various libdivecomputer interface fixups */
-	if (dive->dc.airtemp.mkelvin == 0 && first_temp_is_air && dive->dc.samples) {
-		dive->dc.airtemp = dive->dc.sample[0].temperature;
-		dive->dc.sample[0].temperature.mkelvin = 0;
+	job = malloc(sizeof(*job));
+	if (!job)
+		goto error_exit;
+	job->devdata = devdata;
+	job->parser = parser;
+	job->data = copy;
+	job->dive = dive;
+	download_stats_phase(DOWNLOAD_HEADER, start);
+	if (parse_queue) {
+		start = download_stats_now();
+		parse_queue_push(parse_queue, job);
+		download_stats_phase(DOWNLOAD_QUEUE, start);
+	} else {
+		parse_dive_samples(job);
 	}
-
-	record_dive_to_table(dive, devdata->download_table);
 	return true;
 
 error_exit:
 	dc_parser_destroy(parser);
+	free(copy);
 	free(dive);
 	return true;
 
@@ -981,7 +1112,10 @@ static void do_save_fingerprint(device_data_t *devdata, const char *tmp, const c
 }
 
 /*
- * Save the fingerprint after a successful download
+ * Save the fingerprint after a successful download. It goes into the
+ * logbook, so that other devices that sync the logbook can use it, and
+ * into the per-machine cache, which is used for logbooks that were saved
+ * before the fingerprints were part of them.
  */
 static void save_fingerprint(device_data_t *devdata)
 {
@@ -990,6 +1124,9 @@ static void save_fingerprint(device_data_t *devdata)
 	if (!devdata->fingerprint)
 		return;
 
+	create_fingerprint_node(devdata->model, devdata->deviceid, devdata->fdiveid,
+				devdata->fingerprint, devdata->fsize);
+
 	dir = format_string("%s/fingerprints", system_default_directory());
 	subsurface_mkdir(dir);
 	tmp = format_string("%s/%04x.tmp", dir, devdata->deviceid);
@@ -1028,12 +1165,12 @@ static int has_dive(unsigned int deviceid, unsigned int diveid)
  * the fingerprint data, verify that we actually do have that
  * fingerprinted dive.
  */
-static void verify_fingerprint(dc_device_t *device, device_data_t *devdata, const unsigned char *buffer, size_t size)
+static bool verify_fingerprint(dc_device_t *device, device_data_t *devdata, const unsigned char *buffer, size_t size)
 {
 	unsigned int diveid, deviceid;
 
 	if (size <= 4)
-		return;
+		return false;
 	size -= 4;
 
 	/* Get the dive ID from the end of the fingerprint cache file.. */
@@ -1042,22 +1179,30 @@ static void verify_fingerprint(dc_device_t *device, device_data_t *devdata, cons
 	deviceid = devdata->deviceid;
 
 	/* Only use it if we *have* that dive! */
-	if (has_dive(deviceid, diveid))
-		dc_device_set_fingerprint(device, buffer, size);
+	if (!has_dive(deviceid, diveid))
+		return false;
+	dc_device_set_fingerprint(device, buffer, size);
+	return true;
 }
 
 /*
- * Look up the fingerprint from the fingerprint caches, and
- * give it to libdivecomputer to avoid downloading already
+ * Look up the fingerprint from the logbook or the fingerprint caches,
+ * and give it to libdivecomputer to avoid downloading already
  * downloaded dives.
  */
 static void lookup_fingerprint(dc_device_t *device, device_data_t *devdata)
 {
 	char *cachename;
 	struct memblock mem;
+	const struct fingerprint_record *fp;
 
 	if (devdata->force_download)
 		return;
+	fp = get_fingerprint(devdata->model, devdata->deviceid);
+	if (fp && has_dive(devdata->deviceid, fp->diveid)) {
+		dc_device_set_fingerprint(device, fp->data, fp->size);
+		return;
+	}
 	cachename = format_string("%s/fingerprints/%04x",
 		system_default_directory(), devdata->deviceid);
 	if (readfile(cachename, &mem) > 0) {
@@ -1188,7 +1333,13 @@ static const char *do_device_import(device_data_t *data)
 
 		dc_buffer_free(buffer);
 	} else {
+		if (!data->force_download)
+			build_dc_start_index();
+		parse_queue = parse_queue_start(parse_dive_samples, PARSE_QUEUE_SIZE);
 		rc = dc_device_foreach(device, dive_cb, data);
+		parse_queue_finish(parse_queue);
+		parse_queue = NULL;
+		free_dc_start_index();
 	}
 
 	if (rc != DC_STATUS_SUCCESS) {
@@ -1374,6 +1525,128 @@ static dc_status_t bluetooth_device_open(dc_iostream_t **iostream, dc_context_t
 	return dc_bluetooth_open(&data->iostream, context, address, 0);
 }
 
+/*
+ * Every transport is wrapped in a custom iostream that passes the calls
+ * on and counts the traffic for the download statistics.
+ */
+static dc_status_t stats_set_timeout(void *io, int timeout)
+{
+	return dc_iostream_set_timeout(io, timeout);
+}
+
+static dc_status_t stats_set_break(void *io, unsigned int value)
+{
+	return dc_iostream_set_break(io, value);
+}
+
+static dc_status_t stats_set_dtr(void *io, unsigned int value)
+{
+	return dc_iostream_set_dtr(io, value);
+}
+
+static dc_status_t stats_set_rts(void *io, unsigned int value)
+{
+	return dc_iostream_set_rts(io, value);
+}
+
+static dc_status_t stats_get_lines(void *io, unsigned int *value)
+{
+	return dc_iostream_get_lines(io, value);
+}
+
+static dc_status_t stats_get_available(void *io, size_t *value)
+{
+	return dc_iostream_get_available(io, value);
+}
+
+static dc_status_t stats_configure(void *io, unsigned int baudrate, unsigned int databits, dc_parity_t parity, dc_stopbits_t stopbits, dc_flowcontrol_t flowcontrol)
+{
+	return dc_iostream_configure(io, baudrate, databits, parity, stopbits, flowcontrol);
+}
+
+static dc_status_t stats_poll(void *io, int timeout)
+{
+	uint64_t start = download_stats_now();
+	dc_status_t rc = dc_iostream_poll(io, timeout);
+	download_stats_wait(start);
+	return rc;
+}
+
+static dc_status_t stats_read(void *io, void *data, size_t size, size_t *actual)
+{
+	size_t nbytes = 0;
+	uint64_t start = download_stats_now();
+	dc_status_t rc = dc_iostream_read(io, data, size, &nbytes);
+	download_stats_read(nbytes, start);
+	if (actual)
+		*actual = nbytes;
+	return rc;
+}
+
+static dc_status_t stats_write(void *io, const void *data, size_t size, size_t *actual)
+{
+	size_t nbytes = 0;
+	uint64_t start = download_stats_now();
+	dc_status_t rc = dc_iostream_write(io, data, size, &nbytes);
+	download_stats_write(nbytes, start);
+	if (actual)
+		*actual = nbytes;
+	return rc;
+}
+
+static dc_status_t stats_ioctl(void *io, unsigned int request, void *data, size_t size)
+{
+	return dc_iostream_ioctl(io, request, data, size);
+}
+
+static dc_status_t stats_flush(void *io)
+{
+	return dc_iostream_flush(io);
+}
+
+static dc_status_t stats_purge(void *io, dc_direction_t direction)
+{
+	return dc_iostream_purge(io, direction);
+}
+
+static dc_status_t stats_sleep(void *io, unsigned int milliseconds)
+{
+	return dc_iostream_sleep(io, milliseconds);
+}
+
+static dc_status_t stats_close(void *io)
+{
+	return dc_iostream_close(io);
+}
+
+static void open_stats_iostream(device_data_t *data)
+{
+	static const dc_custom_cbs_t callbacks = {
+		.set_timeout	= stats_set_timeout,
+		.set_break	= stats_set_break,
+		.set_dtr	= stats_set_dtr,
+		.set_rts	= stats_set_rts,
+		.get_lines	= stats_get_lines,
+		.get_available	= stats_get_available,
+		.configure	= stats_configure,
+		.poll		= stats_poll,
+		.read		= stats_read,
+		.write		= stats_write,
+		.ioctl		= stats_ioctl,
+		.flush		= stats_flush,
+		.purge		= stats_purge,
+		.sleep		= stats_sleep,
+		.close		= stats_close,
+	};
+	dc_iostream_t *iostream;
+
+	if (!data->iostream)
+		return;
+	// without the wrapper, we simply download without statistics
+	if (dc_custom_open(&iostream, data->context, dc_iostream_get_transport(data->iostream), &callbacks, data->iostream) == DC_STATUS_SUCCESS)
+		data->iostream = iostream;
+}
+
 dc_status_t divecomputer_device_open(device_data_t *data)
 {
 	dc_status_t rc;
@@ -1492,6 +1765,8 @@ const char *do_libdivecomputer_import(device_data_t *data)
 	err = translate("gettextFromC", "Unable to open %s %s (%s)");
 
 	rc = divecomputer_device_open(data);
+	if (rc == DC_STATUS_SUCCESS)
+		open_stats_iostream(data);
 
 	if (rc != DC_STATUS_SUCCESS) {
 		report_error(errmsg(rc));
@@ -5,15 +5,9 @@
 #include "divesite.h"
 #include "dive.h"
 #include "file.h"
+#include "bytereader.h"
 #include "strndup.h"
 
-// Convert bytes into an INT
-#define array_uint16_le(p) ((unsigned int) (p)[0] \
-							+ ((p)[1]<<8) )
-#define array_uint32_le(p) ((unsigned int) (p)[0] \
-							+ ((p)[1]<<8) + ((p)[2]<<16) \
-							+ ((p)[3]<<24))
-
 struct lv_event {
 	time_t time;
 	struct pressure {
@@ -35,7 +29,7 @@ struct lv_sensor_ids {
 
 struct lv_sensor_ids sensor_ids;
 
-static int handle_event_ver2(int code, const unsigned char *ps, unsigned int ps_ptr, struct lv_event *event)
+static int handle_event_ver2(int code, struct byte_view ps, unsigned int ps_ptr, struct lv_event *event)
 {
 	UNUSED(code);
 	UNUSED(ps);
@@ -47,7 +41,7 @@ static int handle_event_ver2(int code, const unsigned char *ps, unsigned int ps_
 }
 
 
-static int handle_event_ver3(int code, const unsigned char *ps, unsigned int ps_ptr, struct lv_event *event)
+static int handle_event_ver3(int code, struct byte_view ps, unsigned int ps_ptr, struct lv_event *event)
 {
 	int skip = 4;
 	uint16_t current_sensor;
@@ -72,11 +66,11 @@ static int handle_event_ver3(int code, const unsigned char *ps, unsigned int ps_
 		break;
 	case 0x000f:
 		// Tank pressure
-		event->time = array_uint32_le(ps + ps_ptr);
-		current_sensor = array_uint16_le(ps + ps_ptr + 4);
+		event->time = byte_view_u32le(ps, ps_ptr);
+		current_sensor = byte_view_u16le(ps, ps_ptr + 4);
 
 		event->pressure.sensor = -1;
-		event->pressure.mbar = array_uint16_le(ps + ps_ptr + 6) * 10; // cb->mb
+		event->pressure.mbar = byte_view_u16le(ps, ps_ptr + 6) * 10; // cb->mb
 
 		if (current_sensor == sensor_ids.primary) {
 			event->pressure.sensor = 0;
@@ -104,18 +98,17 @@ static int handle_event_ver3(int code, const unsigned char *ps, unsigned int ps_
 
 		// I don't think it's possible to change sensor IDs once a dive has started but disallow it here just in case
 		if (sensor_ids.primary == 0) {
-			sensor_ids.primary = array_uint16_le(ps + ps_ptr + 4);
+			sensor_ids.primary = byte_view_u16le(ps, ps_ptr + 4);
 		}
 
 		if (sensor_ids.buddy == 0) {
-			sensor_ids.buddy = array_uint16_le(ps + ps_ptr + 6);
+			sensor_ids.buddy = byte_view_u16le(ps, ps_ptr + 6);
 		}
 
 		int i;
-		const unsigned char *group_ptr = ps + ps_ptr + 8;
-		for (i = 0; i < 9; ++i, group_ptr += 2) {
+		for (i = 0; i < 9; ++i) {
 			if (sensor_ids.group[i] == 0) {
-				sensor_ids.group[i] = array_uint16_le(group_ptr);
+				sensor_ids.group[i] = byte_view_u16le(ps, ps_ptr + 8 + i * 2);
 			}
 		}
 
@@ -132,16 +125,17 @@ static int handle_event_ver3(int code, const unsigned char *ps, unsigned int ps_
 	return skip;
 }
 
-static void parse_dives(int log_version, const unsigned char *buf, unsigned int buf_size, struct dive_table *table, struct dive_site_table *sites)
+static void parse_dives(int log_version, struct byte_view buf, struct dive_table *table, struct dive_site_table *sites)
 {
-	unsigned int ptr = 0;
+	struct byte_reader r;
 	unsigned char model;
 
 	struct dive *dive;
 	struct divecomputer *dc;
 	struct sample *sample;
 
-	while (ptr < buf_size) {
+	byte_reader_init(&r, buf);
+	while (!r.error && byte_reader_left(&r) > 0) {
 		int i;
 		dive = alloc_dive();
 		memset(&sensor_ids, 0, sizeof(sensor_ids));
@@ -155,7 +149,7 @@ static void parse_dives(int log_version, const unsigned char *buf, unsigned int
 		}
 
 		// Model 0=Xen, 1,2=Xeo, 4=Lynx, other=Liquivision
-		model = *(buf + ptr);
+		model = byte_reader_u8(&r);
 		switch (model) {
 		case 0:
 			dc->model = strdup("Xen");
@@ -171,137 +165,118 @@ static void parse_dives(int log_version, const unsigned char *buf, unsigned int
 			dc->model = strdup("Liquivision");
 			break;
 		}
-		ptr++;
 
 		// Dive location, assemble Location and Place
-		unsigned int len, place_len;
+		struct byte_view loc, place;
 		char *location;
-		len = array_uint32_le(buf + ptr);
-		ptr += 4;
-		place_len = array_uint32_le(buf + ptr + len);
-
-		if (len && place_len) {
-			location = malloc(len + place_len + 4);
-			memset(location, 0, len + place_len + 4);
-			memcpy(location, buf + ptr, len);
-			memcpy(location + len, ", ", 2);
-			memcpy(location + len + 2, buf + ptr + len + 4, place_len);
-		} else if (len) {
-			location = strndup((char *)buf + ptr, len);
-		} else if (place_len) {
-			location = strndup((char *)buf + ptr + len + 4, place_len);
+		loc = byte_reader_view(&r, byte_reader_u32le(&r));
+		place = byte_reader_view(&r, byte_reader_u32le(&r));
+
+		if (loc.size && place.size) {
+			location = malloc(loc.size + place.size + 4);
+			memset(location, 0, loc.size + place.size + 4);
+			memcpy(location, loc.data, loc.size);
+			memcpy(location + loc.size, ", ", 2);
+			memcpy(location + loc.size + 2, place.data, place.size);
+		} else if (loc.size) {
+			location = strndup((const char *)loc.data, loc.size);
+		} else if (place.size) {
+			location = strndup((const char *)place.data, place.size);
 		}
 
 		/* Store the location only if we have one */
-		if (len || place_len) {
+		if (loc.size || place.size) {
 			add_dive_to_dive_site(dive, find_or_create_dive_site_with_name(location, sites));
 			free(location);
 		}
 
-		ptr += len + 4 + place_len;
-
 		// Dive comment
-		len = array_uint32_le(buf + ptr);
-		ptr += 4;
+		struct byte_view comment = byte_reader_view(&r, byte_reader_u32le(&r));
 
 		// Blank notes are better than the default text
-		if (len && strncmp((char *)buf + ptr, "Comment ...", 11)) {
-			dive->notes = strndup((char *)buf + ptr, len);
+		if (comment.size && (comment.size < 11 || memcmp(comment.data, "Comment ...", 11))) {
+			dive->notes = strndup((const char *)comment.data, comment.size);
 		}
-		ptr += len;
 
-		dive->id = array_uint32_le(buf + ptr);
-		ptr += 4;
+		dive->id = byte_reader_u32le(&r);
 
-		dive->number = array_uint16_le(buf + ptr) + 1;
-		ptr += 2;
+		dive->number = byte_reader_u16le(&r) + 1;
 
-		dive->duration.seconds = array_uint32_le(buf + ptr);	// seconds
-		ptr += 4;
+		dive->duration.seconds = byte_reader_u32le(&r);	// seconds
 
-		dive->maxdepth.mm = array_uint16_le(buf + ptr) * 10;	// cm->mm
-		ptr += 2;
+		dive->maxdepth.mm = byte_reader_u16le(&r) * 10;	// cm->mm
 
-		dive->meandepth.mm = array_uint16_le(buf + ptr) * 10;	// cm->mm
-		ptr += 2;
+		dive->meandepth.mm = byte_reader_u16le(&r) * 10;	// cm->mm
 
-		dive->when = array_uint32_le(buf + ptr);
-		ptr += 4;
+		dive->when = byte_reader_u32le(&r);
 
-		//unsigned int end_time = array_uint32_le(buf + ptr);
-		ptr += 4;
+		//unsigned int end_time = byte_reader_u32le(&r);
+		byte_reader_skip(&r, 4);
 
-		//unsigned int sit = array_uint32_le(buf + ptr);
-		ptr += 4;
+		//unsigned int sit = byte_reader_u32le(&r);
+		byte_reader_skip(&r, 4);
 		//if (sit == 0xffffffff) {
 		//}
 
-		dive->surface_pressure.mbar = array_uint16_le(buf + ptr);		// ???
-		ptr += 2;
+		dive->surface_pressure.mbar = byte_reader_u16le(&r);		// ???
 
-		//unsigned int rep_dive = array_uint16_le(buf + ptr);
-		ptr += 2;
+		//unsigned int rep_dive = byte_reader_u16le(&r);
+		byte_reader_skip(&r, 2);
 
-		dive->mintemp.mkelvin =  C_to_mkelvin((float)array_uint16_le(buf + ptr)/10);// C->mK
-		ptr += 2;
+		dive->mintemp.mkelvin =  C_to_mkelvin((float)byte_reader_u16le(&r)/10);// C->mK
 
-		dive->maxtemp.mkelvin =  C_to_mkelvin((float)array_uint16_le(buf + ptr)/10);// C->mK
-		ptr += 2;
+		dive->maxtemp.mkelvin =  C_to_mkelvin((float)byte_reader_u16le(&r)/10);// C->mK
 
-		dive->salinity = *(buf + ptr);	// ???
-		ptr += 1;
+		dive->salinity = byte_reader_u8(&r);	// ???
 
-		unsigned int sample_count = array_uint32_le(buf + ptr);
-		ptr += 4;
+		unsigned int sample_count = byte_reader_u32le(&r);
 
 		// Sample interval
 		unsigned char sample_interval;
 		sample_interval = 1;
 
 		unsigned char intervals[6] = {1,2,5,10,30,60};
-		if (*(buf + ptr) < 6)
-			sample_interval = intervals[*(buf + ptr)];
-		ptr += 1;
+		unsigned int interval_code = byte_reader_u8(&r);
+		if (interval_code < 6)
+			sample_interval = intervals[interval_code];
 
 		float start_cns = 0;
 		unsigned char dive_mode = 0, algorithm = 0;
-		if (array_uint32_le(buf + ptr) != sample_count) {
+		if (byte_view_u32le(r.view, r.pos) != sample_count) {
 			// Xeo, with CNS and OTU
-			start_cns = *(float *) (buf + ptr);
-			ptr += 4;
-			dive->cns = lrintf(*(float *) (buf + ptr));	// end cns
-			ptr += 4;
-			dive->otu = lrintf(*(float *) (buf + ptr));
-			ptr += 4;
-			dive_mode = *(buf + ptr++);	// 0=Deco, 1=Gauge, 2=None, 35=Rec
-			algorithm = *(buf + ptr++);	// 0=ZH-L16C+GF
-			sample_count = array_uint32_le(buf + ptr);
+			start_cns = byte_reader_f32le(&r);
+			dive->cns = lrintf(byte_reader_f32le(&r));	// end cns
+			dive->otu = lrintf(byte_reader_f32le(&r));
+			dive_mode = byte_reader_u8(&r);	// 0=Deco, 1=Gauge, 2=None, 35=Rec
+			algorithm = byte_reader_u8(&r);	// 0=ZH-L16C+GF
+			sample_count = byte_view_u32le(r.view, r.pos);
 		}
 
 		if (sample_count == 0) {
 			fprintf(stderr, "DEBUG: sample count 0 - terminating parser\n");
 			break;
 		}
-		if (ptr + sample_count * 4 + 4 > buf_size) {
-			fprintf(stderr, "DEBUG: BOF - terminating parser\n");
-			break;
-		}
 		// we aren't using the start_cns, dive_mode, and algorithm, yet
 		UNUSED(start_cns);
 		UNUSED(dive_mode);
 		UNUSED(algorithm);
 
-		ptr += 4;
-
-		// Parse dive samples
-		const unsigned char *ds = buf + ptr;
-		const unsigned char *ts = buf + ptr + sample_count * 2 + 4;
-		const unsigned char *ps = buf + ptr + sample_count * 4 + 4;
-		unsigned int ps_count = array_uint32_le(ps);
-		ps += 4;
-
-		// Bump ptr
-		ptr += sample_count * 4 + 4;
+		// Depth and temperature samples, each preceded by the sample count
+		struct byte_view ds, ts, ps;
+		unsigned int ps_count;
+		byte_reader_skip(&r, 4);
+		if (sample_count > byte_reader_left(&r) / 4)
+			r.error = true;
+		ds = byte_reader_view(&r, (size_t)sample_count * 2);
+		byte_reader_skip(&r, 4);
+		ts = byte_reader_view(&r, (size_t)sample_count * 2);
+		ps_count = byte_reader_u32le(&r);
+		if (r.error) {
+			fprintf(stderr, "DEBUG: BOF - terminating parser\n");
+			break;
+		}
+		// The events run into the next dive, which starts where they end
+		ps = byte_view_sub(r.view, r.pos, byte_reader_left(&r));
 
 		// Handle events
 		unsigned int ps_ptr;
@@ -312,9 +287,9 @@ static void parse_dives(int log_version, const unsigned char *buf, unsigned int
 		memset(&event, 0, sizeof(event));
 
 		// Loop through events
-		for (e = 0; e < ps_count; e++) {
+		for (e = 0; e < ps_count && byte_view_has(ps, ps_ptr, 2); e++) {
 			// Get event
-			event_code = array_uint16_le(ps + ps_ptr);
+			event_code = byte_view_u16le(ps, ps_ptr);
 			ps_ptr += 2;
 
 			if (log_version == 3) {
@@ -333,15 +308,15 @@ static void parse_dives(int log_version, const unsigned char *buf, unsigned int
 
 				// Get sample times
 				sample_time = d * sample_interval;
-				depth_mm = array_uint16_le(ds + d * 2) * 10; // cm->mm
-				temp_mk = C_to_mkelvin((float)array_uint16_le(ts + d * 2) / 10); // dC->mK
+				depth_mm = byte_view_u16le(ds, d * 2) * 10; // cm->mm
+				temp_mk = C_to_mkelvin((float)byte_view_u16le(ts, d * 2) / 10); // dC->mK
 				last_time = (d ? (d - 1) * sample_interval : 0);
 
 				if (d == sample_count) {
 					// We still have events to record
 					sample->time.seconds = event.time;
-					sample->depth.mm = array_uint16_le(ds + (d - 1) * 2) * 10; // cm->mm
-					sample->temperature.mkelvin = C_to_mkelvin((float) array_uint16_le(ts + (d - 1) * 2) / 10); // dC->mK
+					sample->depth.mm = byte_view_u16le(ds, (d - 1) * 2) * 10; // cm->mm
+					sample->temperature.mkelvin = C_to_mkelvin((float) byte_view_u16le(ts, (d - 1) * 2) / 10); // dC->mK
 					sample->sensor[0] = event.pressure.sensor;
 					sample->pressure[0].mbar = event.pressure.mbar;
 					finish_sample(dc);
@@ -375,8 +350,8 @@ static void parse_dives(int log_version, const unsigned char *buf, unsigned int
 						sample->temperature.mkelvin = temp_mk;
 					} else {
 						// Extrapolate
-						last_depth = array_uint16_le(ds + (d - 1) * 2) * 10; // cm->mm
-						last_temp = C_to_mkelvin((float) array_uint16_le(ts + (d - 1) * 2) / 10); // dC->mK
+						last_depth = byte_view_u16le(ds, (d - 1) * 2) * 10; // cm->mm
+						last_temp = C_to_mkelvin((float) byte_view_u16le(ts, (d - 1) * 2) / 10); // dC->mK
 						sample->depth.mm = last_depth + (depth_mm - last_depth)
 							* ((int)event.time - last_time) / sample_interval;
 						sample->temperature.mkelvin = last_temp + (temp_mk - last_temp)
@@ -394,15 +369,15 @@ static void parse_dives(int log_version, const unsigned char *buf, unsigned int
 			sample = prepare_sample(dc);
 			sample->time.seconds = d * sample_interval;
 
-			sample->depth.mm = array_uint16_le(ds + d * 2) * 10; // cm->mm
+			sample->depth.mm = byte_view_u16le(ds, d * 2) * 10; // cm->mm
 			sample->temperature.mkelvin =
-				C_to_mkelvin((float)array_uint16_le(ts + d * 2) / 10);
+				C_to_mkelvin((float)byte_view_u16le(ts, d * 2) / 10);
 			finish_sample(dc);
 		}
 
 		if (log_version == 3 && model == 4) {
 			// Advance to begin of next dive
-			switch (array_uint16_le(ps + ps_ptr)) {
+			switch (byte_view_u16le(ps, ps_ptr)) {
 			case 0x0000:
 				ps_ptr += 5;
 				break;
@@ -420,7 +395,7 @@ static void parse_dives(int log_version, const unsigned char *buf, unsigned int
 				break;
 			}
 
-			while (((ptr + ps_ptr + 4) < buf_size) && (*(ps + ps_ptr) != 0x04))
+			while (ps_ptr < ps.size && ps.data[ps_ptr] != 0x04)
 				ps_ptr++;
 		}
 
@@ -428,8 +403,8 @@ static void parse_dives(int log_version, const unsigned char *buf, unsigned int
 		record_dive_to_table(dive, table);
 		dive = NULL;
 
-		// Advance ptr for next dive
-		ptr += ps_ptr + 4;
+		// Advance to the next dive
+		byte_reader_skip(&r, ps_ptr);
 	} // while
 
 	//DEBUG save_dives("/tmp/test.xml");
@@ -442,28 +417,26 @@ int try_to_open_liquivision(const char *filename, struct memblock *mem, struct d
 {
 	UNUSED(filename);
 	UNUSED(trips);
-	const unsigned char *buf = mem->buffer;
-	unsigned int buf_size = mem->size;
-	unsigned int ptr;
+	struct byte_reader r;
 	int log_version;
 
-	// Get name length
-	unsigned int len = array_uint32_le(buf);
+	byte_reader_init(&r, byte_view_of(mem));
 	// Ignore length field and the name
-	ptr = 4 + len;
+	byte_reader_skip(&r, byte_reader_u32le(&r));
 
-	unsigned int dive_count = array_uint32_le(buf + ptr);
+	unsigned int dive_count = byte_reader_u32le(&r);
 	if (dive_count == 0xffffffff) {
 		// File version 3.0
 		log_version = 3;
-		ptr += 6;
-		dive_count = array_uint32_le(buf + ptr);
+		byte_reader_skip(&r, 2);
+		dive_count = byte_reader_u32le(&r);
 	} else {
 		log_version = 2;
 	}
-	ptr += 4;
+	UNUSED(dive_count);
 
-	parse_dives(log_version, buf + ptr, buf_size - ptr, table, sites);
+	if (!r.error)
+		parse_dives(log_version, byte_view_sub(r.view, r.pos, byte_reader_left(&r)), table, sites);
 
 	return 1;
 }
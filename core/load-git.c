@@ -9,6 +9,7 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <git2.h>
 #include <libdivecomputer/parser.h>
 
@@ -20,20 +21,56 @@
 #include "trip.h"
 #include "subsurface-string.h"
 #include "device.h"
+#include "fingerprint.h"
 #include "membuffer.h"
 #include "git-access.h"
 #include "picture.h"
 #include "qthelper.h"
 #include "tag.h"
 #include "subsurface-time.h"
+#include "snapshot.h"
+#include "fulltext.h"
+#include "samplecodec.h"
+#include "samplecolumns.h"
+#include "sampleresidency.h"
+#include "trace.h"
+#include "arena.h"
 
 const char *saved_git_id = NULL;
+enum git_sample_format git_sample_format = GIT_SAMPLES_TEXT;
+enum git_sample_format saved_git_sample_format = GIT_SAMPLES_TEXT;
+bool git_sample_format_forced = false;
+
+/*
+ * If set, the samples of divecomputers are not parsed when loading
+ * a logbook, but only when load_samples() is called for the dive.
+ * The repositories stay open as long as the dives refer to them.
+ */
+bool git_lazy_samples = false;
+static git_repository **sample_repos;
+static int nr_sample_repos, allocated_sample_repos;
+
+/*
+ * Divecomputer blobs are by far the biggest part of a logbook,
+ * and they only touch the divecomputer they describe. So we
+ * collect them during the tree walk and parse them on all cores
+ * in batches of this many blobs.
+ */
+#define DC_PARSE_BATCH 1024
+
+struct pending_dc {
+	git_blob *blob;
+	git_blob *samples_blob;		/* Binary samples, NULL for text samples */
+	struct divecomputer *dc;
+	int o2pressure_sensor;
+};
 
 struct git_parser_state {
 	git_repository *repo;
 	struct divecomputer *active_dc;
 	struct dive *active_dive;
 	dive_trip_t *active_trip;
+	unsigned char active_trip_id[20];
 	char *fulltext_mode;
 	char *fulltext_query;
 	char *filter_constraint_type;
@@ -49,6 +86,15 @@ struct git_parser_state {
 	struct dive_site_table *sites;
 	filter_preset_table_t *filter_presets;
 	int o2pressure_sensor;
+	struct pending_dc *pending_dcs;
+	int nr_pending_dcs, allocated_pending_dcs;
+	int first_unfinished_dive;
+	int sample_repo;
+	bool use_snapshot;
+	git_tree *old_tree;		/* Incremental reload: skip what is unchanged in this tree */
+	struct git_dive_changes *changes;
+	enum { DC_PARSE_ALL, DC_PARSE_HEADER, DC_PARSE_SAMPLES } dc_parse_mode;
+	int sample_format;		/* enum git_sample_format, -1 if the settings were not parsed */
 };
 
 struct keyword_action {
@@ -59,31 +105,86 @@ struct keyword_action {
 
 static git_blob *git_tree_entry_blob(git_repository *repo, const git_tree_entry *entry);
 
+/*
+ * Our own numbers are written by put_milli(), so they can be parsed
+ * exactly as fixed-point numbers, without going through a double and
+ * independent of the locale. Returns false for anything that isn't a
+ * plain decimal number (e.g. an exponent), so that the caller can fall
+ * back to ascii_strtod().
+ */
+static bool parse_milli(const char *line, const char **end, int *res)
+{
+	const char *p = line;
+	bool negative = false;
+	int64_t val = 0;
+	int digits = 0, decimals = 0;
+
+	if (*p == '-' || *p == '+')
+		negative = *p++ == '-';
+	while (*p >= '0' && *p <= '9') {
+		val = val * 10 + *p++ - '0';
+		if (++digits > 9)
+			return false;
+	}
+	if (*p == '.') {
+		p++;
+		while (*p >= '0' && *p <= '9') {
+			/* Round on the first digit that doesn't fit */
+			if (decimals < 3)
+				val = val * 10 + *p - '0';
+			else if (decimals == 3 && *p >= '5')
+				val++;
+			decimals++;
+			digits++;
+			p++;
+		}
+	}
+	if (!digits || *p == 'e' || *p == 'E')
+		return false;
+	for (; decimals < 3; decimals++)
+		val *= 10;
+	if (val > INT_MAX)
+		return false;
+	*res = negative ? -val : val;
+	*end = p;
+	return true;
+}
+
+static int get_milli(const char *line)
+{
+	const char *end;
+	int res;
+
+	if (parse_milli(line, &end, &res))
+		return res;
+	return lrint(1000 * ascii_strtod(line, NULL));
+}
+
 static temperature_t get_temperature(const char *line)
 {
 	temperature_t t;
-	t.mkelvin = C_to_mkelvin(ascii_strtod(line, NULL));
+	t.mkelvin = get_milli(line) + ZERO_C_IN_MKELVIN;
 	return t;
 }
 
 static depth_t get_depth(const char *line)
 {
 	depth_t d;
-	d.mm = lrint(1000 * ascii_strtod(line, NULL));
+	d.mm = get_milli(line);
 	return d;
 }
 
 static volume_t get_volume(const char *line)
 {
 	volume_t v;
-	v.mliter = lrint(1000 * ascii_strtod(line, NULL));
+	v.mliter = get_milli(line);
 	return v;
 }
 
 static weight_t get_weight(const char *line)
 {
 	weight_t w;
-	w.grams = lrint(1000 * ascii_strtod(line, NULL));
+	w.grams = get_milli(line);
 	return w;
 }
 
@@ -97,7 +198,7 @@ static pressure_t get_airpressure(const char *line)
 static pressure_t get_pressure(const char *line)
 {
 	pressure_t p;
-	p.mbar = lrint(1000 * ascii_strtod(line, NULL));
+	p.mbar = get_milli(line);
 	return p;
 }
 
@@ -143,9 +244,13 @@ static void update_time(timestamp_t *when, const char *line)
 
 static duration_t get_duration(const char *line)
 {
-	int m = 0, s = 0;
+	char *end;
+	int m, s = 0;
 	duration_t d;
-	sscanf(line, "%d:%d", &m, &s);
+
+	m = strtol(line, &end, 10);
+	if (*end == ':')
+		s = strtol(end + 1, NULL, 10);
 	d.seconds = m * 60 + s;
 	return d;
 }
@@ -213,16 +318,16 @@ static void parse_dive_location(char *line, struct membuffer *str, struct git_pa
 }
 
 static void parse_dive_divemaster(char *line, struct membuffer *str, struct git_parser_state *state)
-{ UNUSED(line); state->active_dive->divemaster = detach_cstring(str); }
+{ UNUSED(line); state->active_dive->divemaster = arena_strdup(&logbook_arena, mb_cstring(str)); }
 
 static void parse_dive_buddy(char *line, struct membuffer *str, struct git_parser_state *state)
-{ UNUSED(line); state->active_dive->buddy = detach_cstring(str); }
+{ UNUSED(line); state->active_dive->buddy = arena_strdup(&logbook_arena, mb_cstring(str)); }
 
 static void parse_dive_suit(char *line, struct membuffer *str, struct git_parser_state *state)
-{ UNUSED(line); state->active_dive->suit = detach_cstring(str); }
+{ UNUSED(line); state->active_dive->suit = arena_strdup(&logbook_arena, mb_cstring(str)); }
 
 static void parse_dive_notes(char *line, struct membuffer *str, struct git_parser_state *state)
-{ UNUSED(line); state->active_dive->notes = detach_cstring(str); }
+{ UNUSED(line); state->active_dive->notes = arena_strdup(&logbook_arena, mb_cstring(str)); }
 
 static void parse_dive_divesiteid(char *line, struct membuffer *str, struct git_parser_state *state)
 { UNUSED(str); add_dive_to_dive_site(state->active_dive, get_dive_site_by_uuid(get_hex(line), &dive_site_table)); }
@@ -605,7 +710,7 @@ static void parse_sample_keyvalue(void *_sample, const char *key, const char *va
 	report_error("Unexpected sample key/value pair (%s/%s)", key, value);
 }
 
-static char *parse_sample_unit(struct sample *sample, double val, char *unit)
+static char *parse_sample_unit(struct sample *sample, int milli, char *unit)
 {
 	unsigned int sensor;
 	char *end = unit, c;
@@ -623,16 +728,16 @@ static char *parse_sample_unit(struct sample *sample, double val, char *unit)
 	/* The cylinder pressure may also be of the form '123.0bar:4' to indicate sensor */
 	switch (*unit) {
 	case 'm':
-		sample->depth.mm = lrint(1000 * val);
+		sample->depth.mm = milli;
 		break;
 	case 'b':
 		sensor = sample->sensor[0];
 		if (end > unit + 4 && unit[3] == ':')
 			sensor = atoi(unit + 4);
-		add_sample_pressure(sample, sensor, lrint(1000 * val));
+		add_sample_pressure(sample, sensor, milli);
 		break;
 	default:
-		sample->temperature.mkelvin = C_to_mkelvin(val);
+		sample->temperature.mkelvin = milli + ZERO_C_IN_MKELVIN;
 		break;
 	}
 
@@ -693,13 +798,18 @@ static void sample_parser(char *line, struct git_parser_state *state)
 			line = parse_keyvalue_entry(parse_sample_keyvalue, sample, line, NULL);
 		} else {
 			const char *end;
-			double val = ascii_strtod(line, &end);
-			if (end == line) {
-				report_error("Odd sample data: %s", line);
-				break;
+			int milli;
+
+			if (!parse_milli(line, &end, &milli)) {
+				double val = ascii_strtod(line, &end);
+				if (end == line) {
+					report_error("Odd sample data: %s", line);
+					break;
+				}
+				milli = lrint(1000 * val);
 			}
 			line = (char *)end;
-			line = parse_sample_unit(sample, val, line);
+			line = parse_sample_unit(sample, milli, line);
 		}
 	}
 	finish_sample(state->active_dc);
@@ -711,8 +821,9 @@ static void parse_dc_airtemp(char *line, struct membuffer *str, struct git_parse
 static void parse_dc_date(char *line, struct membuffer *str, struct git_parser_state *state)
 { UNUSED(str); update_date(&state->active_dc->when, line); }
 
+/* The device lookup uses global data - it is done in finish_pending_dives() */
 static void parse_dc_deviceid(char *line, struct membuffer *str, struct git_parser_state *state)
-{ UNUSED(str); set_dc_deviceid(state->active_dc, get_hex(line)); }
+{ UNUSED(str); state->active_dc->deviceid = get_hex(line); }
 
 static void parse_dc_diveid(char *line, struct membuffer *str, struct git_parser_state *state)
 { UNUSED(str); state->active_dc->diveid = get_hex(line); }
@@ -825,7 +936,7 @@ static void parse_dc_keyvalue(char *line, struct membuffer *str, struct git_pars
 	// first string to 'key' and NUL terminates the second string (which then goes to 'value')
 	key = mb_cstring(str);
 	value = key + strlen(key) + 1;
-	add_extra_data(state->active_dc, key, value);
+	add_extra_data_to_arena(&logbook_arena, state->active_dc, key, value);
 }
 
 static void parse_dc_event(char *line, struct membuffer *str, struct git_parser_state *state)
@@ -852,7 +963,10 @@ static void parse_dc_event(char *line, struct membuffer *str, struct git_parser_
 	if (p.has_divemode && strcmp(p.name, "modechange"))
 		p.name = "modechange";
 
-	ev = add_event(state->active_dc, p.ev.time.seconds, p.ev.type, p.ev.flags, p.ev.value, p.name);
+	/* The divecomputers are parsed in parallel, the names are remembered by finish_pending_dives() */
+	ev = create_event_in_arena(&logbook_arena, p.ev.time.seconds, p.ev.type, p.ev.flags, p.ev.value, p.name);
+	if (ev)
+		add_event_to_dc(state->active_dc, ev);
 
 	/*
 	 * Older logs might mark the dive to be CCR by having an "SP change" event at time 0:00.
@@ -939,6 +1053,17 @@ static void parse_settings_version(char *line, struct membuffer *str, struct git
 		report_error("Git save file version %d is newer than version %d I know about", version, DATAFORMAT_VERSION);
 }
 
+static void parse_settings_samples(char *line, struct membuffer *str, struct git_parser_state *state)
+{
+	UNUSED(str);
+	if (!strcmp(line, "binary"))
+		state->sample_format = GIT_SAMPLES_BINARY;
+	else if (!strcmp(line, "binary+text"))
+		state->sample_format = GIT_SAMPLES_BINARY_AND_TEXT;
+	else
+		report_error("Unknown sample format '%s'", line);
+}
+
 /* The string in the membuffer is the version string of subsurface that saved things, just FYI */
 static void parse_settings_subsurface(char *line, struct membuffer *str, struct git_parser_state *_unused)
 {
@@ -1003,6 +1128,53 @@ static void parse_settings_divecomputerid(char *line, struct membuffer *str, str
 	create_device_node(id.model, id.deviceid, id.serial, id.firmware, id.nickname);
 }
 
+struct fingerprintid {
+	const char *model;
+	unsigned int deviceid;
+	unsigned int diveid;
+	const char *data;
+};
+
+static void parse_fingerprint_keyvalue(void *_fid, const char *key, const char *value)
+{
+	struct fingerprintid *fid = _fid;
+
+	if (!strcmp(key, "deviceid")) {
+		fid->deviceid = get_hex(value);
+		return;
+	}
+	if (!strcmp(key, "diveid")) {
+		fid->diveid = get_hex(value);
+		return;
+	}
+	if (!strcmp(key, "data")) {
+		fid->data = value;
+		return;
+	}
+	report_error("Unknown fingerprint key/value pair (%s/%s)", key, value);
+}
+
+/* Like the 'divecomputerid', a model string followed by key/value pairs */
+static void parse_settings_fingerprint(char *line, struct membuffer *str, struct git_parser_state *_unused)
+{
+	UNUSED(_unused);
+	struct fingerprintid id = { pop_cstring(str, line) };
+
+	/* Skip the '"' that stood for the model string */
+	line++;
+
+	for (;;) {
+		char c;
+		while (isspace(c = *line))
+			line++;
+		if (!c)
+			break;
+		line = parse_keyvalue_entry(parse_fingerprint_keyvalue, &id, line, str);
+	}
+	create_fingerprint_node_from_hex(id.model, id.deviceid, id.diveid, id.data);
+	free((void *)id.model);
+}
+
 static void parse_picture_filename(char *line, struct membuffer *str, struct git_parser_state *state)
 {
 	UNUSED(line);
@@ -1038,9 +1210,13 @@ struct keyword_action dc_action[] = {
 static void divecomputer_parser(char *line, struct membuffer *str, struct git_parser_state *state)
 {
 	char c = *line;
-	if (c < 'a' || c > 'z')
-		sample_parser(line, state);
-	match_action(line, str, state, dc_action, ARRAY_SIZE(dc_action));
+	if (c < 'a' || c > 'z') {
+		if (state->dc_parse_mode != DC_PARSE_HEADER)
+			sample_parser(line, state);
+		return;
+	}
+	if (state->dc_parse_mode != DC_PARSE_SAMPLES)
+		match_action(line, str, state, dc_action, ARRAY_SIZE(dc_action));
 }
 
 /* These need to be sorted! */
@@ -1085,7 +1261,7 @@ static void trip_parser(char *line, struct membuffer *str, struct git_parser_sta
 static struct keyword_action settings_action[] = {
 #undef D
 #define D(x) { #x, parse_settings_ ## x }
-	D(autogroup), D(divecomputerid), D(prefs), D(subsurface), D(units), D(userid), D(version)
+	D(autogroup), D(divecomputerid), D(fingerprint), D(prefs), D(samples), D(subsurface), D(units), D(userid), D(version)
 };
 
 static void settings_parser(char *line, struct membuffer *str, struct git_parser_state *state)
@@ -1345,17 +1521,83 @@ static void finish_active_trip(struct git_parser_state *state)
 
 	if (trip) {
 		state->active_trip = NULL;
+		/* Adding the dives invalidated the id, so set it only now */
+		memcpy(trip->git_id, state->active_trip_id, 20);
 		insert_trip(trip, state->trips);
 	}
 }
 
+static void parse_binary_samples(git_blob *blob, struct divecomputer *dc)
+{
+	if (!decode_samples(git_blob_rawcontent(blob), (size_t)git_blob_rawsize(blob), dc))
+		report_error("Unable to read binary samples");
+}
+
+static void parse_one_pending_dc(int idx, void *data)
+{
+	struct pending_dc *pending = (struct pending_dc *)data + idx;
+	struct git_parser_state state = { 0 };
+
+	state.active_dc = pending->dc;
+	state.o2pressure_sensor = pending->o2pressure_sensor;
+	state.dc_parse_mode = pending->dc->sample_repo || pending->samples_blob ? DC_PARSE_HEADER : DC_PARSE_ALL;
+	for_each_line(pending->blob, divecomputer_parser, &state);
+	if (pending->samples_blob)
+		parse_binary_samples(pending->samples_blob, pending->dc);
+}
+
+static void fixup_one_pending_dive(int idx, void *data)
+{
+	fixup_dive_data(((struct dive **)data)[idx]);
+}
+
+/*
+ * Parse all queued divecomputer blobs and fix up the dives that have
+ * been added to the table since the last batch in parallel. Then do the
+ * serial part: registration of devices and event names and the rest of
+ * the fixup.
+ */
+static void finish_pending_dives(struct git_parser_state *state)
+{
+	int i;
+	struct dive **dives = state->table->dives + state->first_unfinished_dive;
+	int nr = state->table->nr - state->first_unfinished_dive;
+
+	run_in_parallel(state->nr_pending_dcs, parse_one_pending_dc, state->pending_dcs);
+	for (i = 0; i < state->nr_pending_dcs; i++) {
+		git_blob_free(state->pending_dcs[i].blob);
+		git_blob_free(state->pending_dcs[i].samples_blob);
+	}
+	state->nr_pending_dcs = 0;
+
+	run_in_parallel(nr, fixup_one_pending_dive, dives);
+	for (i = 0; i < nr; i++) {
+		struct divecomputer *dc;
+		struct event *ev;
+
+		for_each_dc (dives[i], dc) {
+			set_dc_deviceid(dc, dc->deviceid);
+			for (ev = dc->events; ev; ev = ev->next)
+				remember_event(ev->name);
+		}
+		fixup_dive_finish(dives[i]);
+	}
+	state->first_unfinished_dive = state->table->nr;
+}
+
+/*
+ * The dive is added to the table right away, but the fixup
+ * has to wait until its divecomputers have been parsed.
+ */
 static void finish_active_dive(struct git_parser_state *state)
 {
 	struct dive *dive = state->active_dive;
 
 	if (dive) {
 		state->active_dive = NULL;
-		record_dive_to_table(dive, state->table);
+		add_to_dive_table(state->table, state->table->nr, dive);
+		if (state->nr_pending_dcs >= DC_PARSE_BATCH)
+			finish_pending_dives(state);
 	}
 }
 
@@ -1387,7 +1629,7 @@ static bool validate_time(int h, int m, int s)
 /*
  * Dive trip directory, name is 'nn-alphabetic[~hex]'
  */
-static int dive_trip_directory(const char *root, const char *name, struct git_parser_state *state)
+static int dive_trip_directory(const char *root, const git_tree_entry *entry, const char *name, struct git_parser_state *state)
 {
 	int yyyy = -1, mm = -1, dd = -1;
 
@@ -1398,6 +1640,7 @@ static int dive_trip_directory(const char *root, const char *name, struct git_pa
 		return GIT_WALK_SKIP;
 	finish_active_trip(state);
 	state->active_trip = alloc_trip();
+	memcpy(state->active_trip_id, git_tree_entry_id(entry)->id, 20);
 	return GIT_WALK_OK;
 }
 
@@ -1594,7 +1837,7 @@ static int walk_tree_directory(const char *root, const git_tree_entry *entry, st
 	if (digits != 2)
 		return GIT_WALK_SKIP;
 
-	return dive_trip_directory(root, name, state);
+	return dive_trip_directory(root, entry, name, state);
 }
 
 static git_blob *git_tree_entry_blob(git_repository *repo, const git_tree_entry *entry)
@@ -1631,19 +1874,67 @@ static struct divecomputer *create_new_dc(struct dive *dive)
  * until necessary, in order to reduce load-time. The parsing is
  * cheap, but the loading of the git blob into memory can be pretty
  * costly.
+ *
+ * For now, the blob is only queued here and parsed together with
+ * the other queued blobs in finish_pending_dives().
  */
 static int parse_divecomputer_entry(struct git_parser_state *state, const git_tree_entry *entry, const char *suffix)
 {
 	UNUSED(suffix);
+	struct pending_dc *pending;
 	git_blob *blob = git_tree_entry_blob(state->repo, entry);
 
 	if (!blob)
 		return report_error("Unable to read divecomputer file");
 
-	state->active_dc = create_new_dc(state->active_dive);
-	for_each_line(blob, divecomputer_parser, state);
-	git_blob_free(blob);
-	state->active_dc = NULL;
+	if (state->nr_pending_dcs >= state->allocated_pending_dcs) {
+		state->allocated_pending_dcs = (state->nr_pending_dcs + 32) * 3 / 2;
+		state->pending_dcs = realloc(state->pending_dcs, state->allocated_pending_dcs * sizeof(struct pending_dc));
+		if (!state->pending_dcs)
+			exit(1);
+	}
+	pending = &state->pending_dcs[state->nr_pending_dcs++];
+	pending->blob = blob;
+	pending->samples_blob = NULL;
+	pending->dc = create_new_dc(state->active_dive);
+	pending->o2pressure_sensor = state->o2pressure_sensor;
+	if (state->sample_repo) {
+		pending->dc->sample_repo = state->sample_repo;
+		memcpy(pending->dc->sample_blob_id, git_tree_entry_id(entry)->id, 20);
+	}
+	return 0;
+}
+
+/*
+ * The binary samples of a divecomputer, see samplecodec.h. The blobs sort
+ * after the Divecomputer blobs, so the divecomputer is still queued and
+ * only its header is parsed from the Divecomputer blob. Lazily loaded
+ * samples are read from this blob instead.
+ */
+static int parse_samples_entry(struct git_parser_state *state, const git_tree_entry *entry, const char *suffix)
+{
+	struct divecomputer *dc = &state->active_dive->dc;
+	struct pending_dc *pending = NULL;
+	int i, idx = *suffix == '-' ? atoi(suffix + 1) - 1 : 0;
+
+	for (i = 0; i < idx && dc; i++)
+		dc = dc->next;
+	for (i = state->nr_pending_dcs - 1; i >= 0 && dc; i--) {
+		if (state->pending_dcs[i].dc == dc) {
+			pending = &state->pending_dcs[i];
+			break;
+		}
+	}
+	if (!pending)
+		return report_error("Samples without divecomputer (%s)", suffix);
+
+	if (state->sample_repo) {
+		memcpy(dc->sample_blob_id, git_tree_entry_id(entry)->id, 20);
+		return 0;
+	}
+	pending->samples_blob = git_tree_entry_blob(state->repo, entry);
+	if (!pending->samples_blob)
+		return report_error("Unable to read samples file");
 	return 0;
 }
 
@@ -1673,7 +1964,14 @@ static int parse_site_entry(struct git_parser_state *state, const git_tree_entry
 	if (*suffix == '\0')
 		return report_error("Dive site without uuid");
 	uint32_t uuid = strtoul(suffix, NULL, 16);
-	state->active_site = alloc_or_get_dive_site(uuid, &dive_site_table);
+	if (state->changes && get_dive_site_by_uuid(uuid, &dive_site_table)) {
+		/* The loaded site is updated by the caller of the incremental reload */
+		state->active_site = alloc_dive_site();
+		state->active_site->uuid = uuid;
+		add_dive_site_to_table(state->active_site, &state->changes->changed_sites);
+	} else {
+		state->active_site = alloc_or_get_dive_site(uuid, &dive_site_table);
+	}
 	git_blob *blob = git_tree_entry_blob(state->repo, entry);
 	if (!blob)
 		return report_error("Unable to read dive site file");
@@ -1698,7 +1996,9 @@ static int parse_settings_entry(struct git_parser_state *state, const git_tree_e
 	git_blob *blob = git_tree_entry_blob(state->repo, entry);
 	if (!blob)
 		return report_error("Unable to read settings file");
-	for_each_line(blob, settings_parser, NULL);
+	/* Repositories without a "samples" line use the text format */
+	state->sample_format = GIT_SAMPLES_TEXT;
+	for_each_line(blob, settings_parser, state);
 	git_blob_free(blob);
 	return 0;
 }
@@ -1779,6 +2079,8 @@ static int walk_tree_file(const char *root, const git_tree_entry *entry, struct
 			return parse_filter_preset(state, entry);
 		break;
 	case 'S':
+		if (dive && !strncmp(name, "Samples", 7))
+			return parse_samples_entry(state, entry, name + 7);
 		if (!strncmp(name, "Site", 4))
 			return parse_site_entry(state, entry, name + 5);
 		break;
@@ -1793,11 +2095,44 @@ static int walk_tree_file(const char *root, const git_tree_entry *entry, struct
 	return GIT_WALK_SKIP;
 }
 
+/*
+ * Is the entry at "root" the same in "tree"? Missing entries are not.
+ */
+static bool same_tree_entry(const git_tree *tree, const char *root, const git_tree_entry *entry)
+{
+	char *path = format_string("%s%s", root, git_tree_entry_name(entry));
+	git_tree_entry *other;
+	bool same = false;
+
+	if (!git_tree_entry_bypath(&other, tree, path)) {
+		same = git_oid_equal(git_tree_entry_id(entry), git_tree_entry_id(other));
+		git_tree_entry_free(other);
+	}
+	free(path);
+	return same;
+}
+
+/*
+ * On an incremental reload, the unchanged entries down to the
+ * trips and dives of a month and the unchanged dive sites are
+ * skipped. Anything below that is parsed if its parent is, or a
+ * changed trip would lose its unchanged dives.
+ */
+static bool skip_unchanged_entry(const char *root, const git_tree_entry *entry, struct git_parser_state *state)
+{
+	if (strlen(root) > 8 && strcmp(root, "01-Divesites/"))
+		return false;
+	return same_tree_entry(state->old_tree, root, entry);
+}
+
 static int walk_tree_cb(const char *root, const git_tree_entry *entry, void *payload)
 {
 	struct git_parser_state *state = payload;
 	git_filemode_t mode = git_tree_entry_filemode(entry);
 
+	if (state->old_tree && skip_unchanged_entry(root, entry, state))
+		return GIT_WALK_SKIP;
+
 	if (mode == GIT_FILEMODE_TREE)
 		return walk_tree_directory(root, entry, state);
 
@@ -1812,6 +2147,103 @@ static int load_dives_from_tree(git_repository *repo, git_tree *tree, struct git
 	return 0;
 }
 
+/* Same logic as in parse_dive_cylinder() */
+static int get_o2pressure_sensor(const struct dive *dive)
+{
+	int i, sensor = 1;
+
+	for (i = 0; i < dive->cylinders.nr; i++) {
+		if (dive->cylinders.cylinders[i].cylinder_use == OXYGEN)
+			sensor = i;
+	}
+	return sensor;
+}
+
+/*
+ * Parse the samples of lazily loaded divecomputers. The samples are
+ * just a cache of what is in the git repository, therefore this takes
+ * a const dive. Since the dive fixup could not take the samples into
+ * account at load time, it is redone here.
+ * This also unpacks samples that were packed by pack_samples(),
+ * unless only the blobs are to be loaded.
+ */
+static void load_dive_samples(const struct dive *dive, bool unpack)
+{
+	struct dive *d = (struct dive *)dive;
+	struct divecomputer *dc;
+	bool loaded = false;
+
+	if (!d)
+		return;
+	for_each_dc (d, dc) {
+		struct git_parser_state state = { 0 };
+		git_blob *blob;
+		git_oid id;
+		int repo = dc->sample_repo;
+
+		if (unpack)
+			unpack_samples(dc);
+		if (!repo)
+			continue;
+		dc->sample_repo = 0;
+		if (repo > nr_sample_repos || !sample_repos[repo - 1])
+			continue;
+		git_oid_fromraw(&id, dc->sample_blob_id);
+		if (git_blob_lookup(&blob, sample_repos[repo - 1], &id)) {
+			report_error("Unable to read divecomputer file");
+			continue;
+		}
+		if (is_sample_blob(git_blob_rawcontent(blob), (size_t)git_blob_rawsize(blob))) {
+			parse_binary_samples(blob, dc);
+		} else {
+			state.active_dc = dc;
+			state.o2pressure_sensor = get_o2pressure_sensor(d);
+			state.dc_parse_mode = DC_PARSE_SAMPLES;
+			for_each_line(blob, divecomputer_parser, &state);
+		}
+		git_blob_free(blob);
+		dc->sample_reload_repo = repo;
+		loaded = true;
+	}
+	if (loaded)
+		fixup_dive(d);
+	if (unpack)
+		touch_dive_samples(d);
+}
+
+void load_samples(const struct dive *dive)
+{
+	load_dive_samples(dive, true);
+}
+
+/* Copies of packed divecomputers share the samples, so these are not unpacked here */
+void load_sample_blobs(const struct dive *dive)
+{
+	load_dive_samples(dive, false);
+}
+
+/* To be called when there are no more dives referring to the repositories */
+void free_sample_repositories(void)
+{
+	for (int i = 0; i < nr_sample_repos; i++)
+		git_repository_free(sample_repos[i]);
+	free(sample_repos);
+	sample_repos = NULL;
+	nr_sample_repos = allocated_sample_repos = 0;
+}
+
+static int add_sample_repository(git_repository *repo)
+{
+	if (nr_sample_repos >= allocated_sample_repos) {
+		allocated_sample_repos = (nr_sample_repos + 4) * 3 / 2;
+		sample_repos = realloc(sample_repos, allocated_sample_repos * sizeof(git_repository *));
+		if (!sample_repos)
+			exit(1);
+	}
+	sample_repos[nr_sample_repos++] = repo;
+	return nr_sample_repos;
+}
+
 void clear_git_id(void)
 {
 	free((void *)saved_git_id);
@@ -1838,6 +2270,69 @@ static int find_commit(git_repository *repo, const char *branch, git_commit **co
 	return 0;
 }
 
+/* The snapshot lives in the .git directory, next to the objects it caches */
+static char *get_snapshot_name(git_repository *repo)
+{
+	return format_string("%ssubsurface-snapshot", git_repository_path(repo));
+}
+
+/* The same goes for the words of the full text index */
+static char *get_fulltext_cache_name(git_repository *repo)
+{
+	return format_string("%ssubsurface-fulltext", git_repository_path(repo));
+}
+
+/*
+ * The settings are not part of the snapshot, so those are still
+ * read from the tree. Returns 0 if the dives were loaded.
+ */
+static int load_dives_from_snapshot(git_repository *repo, git_tree *tree, git_commit *commit, struct git_parser_state *state)
+{
+	char git_id_buffer[GIT_OID_HEXSZ + 1];
+	char *filename = get_snapshot_name(repo);
+	git_tree_entry *entry;
+	int ret;
+
+	git_oid_tostr(git_id_buffer, sizeof(git_id_buffer), git_commit_id(commit));
+	ret = load_snapshot(filename, git_id_buffer, state->sample_repo, state->table, state->trips,
+			    state->sites, state->filter_presets);
+	free(filename);
+	if (ret)
+		return ret;
+	if (!git_tree_entry_bypath(&entry, tree, "00-Subsurface")) {
+		parse_settings_entry(state, entry);
+		git_tree_entry_free(entry);
+	}
+	return 0;
+}
+
+void save_git_snapshot(git_repository *repo)
+{
+	char *filename;
+
+	if (!saved_git_id)
+		return;
+	filename = get_snapshot_name(repo);
+	if (save_snapshot(filename, saved_git_id, &dive_table, &trip_table, &dive_site_table) && verbose)
+		SSRF_INFO("git storage: failed to write snapshot %s\n", filename);
+	free(filename);
+
+	/* This does nothing if the dives were not registered with the full text index yet */
+	filename = get_fulltext_cache_name(repo);
+	fulltext_save_cache(filename);
+	free(filename);
+}
+
+/* The sample format of an opened or reloaded logbook is that of its repository */
+static void set_repo_sample_format(const struct git_parser_state *state)
+{
+	if (state->sample_format < 0)
+		return;
+	saved_git_sample_format = state->sample_format;
+	if (!git_sample_format_forced)
+		git_sample_format = state->sample_format;
+}
+
 static int do_git_load(git_repository *repo, const char *branch, struct git_parser_state *state)
 {
 	int ret;
@@ -1850,7 +2345,10 @@ static int do_git_load(git_repository *repo, const char *branch, struct git_pars
 	if (git_commit_tree(&tree, commit))
 		return report_error("Could not look up tree of commit in branch '%s'", branch);
 	git_storage_update_progress(translate("gettextFromC", "Load dives from local cache"));
-	ret = load_dives_from_tree(repo, tree, state);
+	if (state->use_snapshot && !load_dives_from_snapshot(repo, tree, commit, state))
+		state->use_snapshot = false;
+	else
+		ret = load_dives_from_tree(repo, tree, state);
 	if (!ret) {
 		set_git_id(git_commit_id(commit));
 		git_storage_update_progress(translate("gettextFromC", "Successfully opened dive data"));
@@ -1882,19 +2380,288 @@ int git_load_dives(struct git_repository *repo, const char *branch, struct dive_
 		   struct dive_site_table *sites, filter_preset_table_t *filter_presets)
 {
 	int ret;
+	bool new_logbook;
 	struct git_parser_state state = { 0 };
 	state.repo = repo;
 	state.table = table;
+	state.first_unfinished_dive = table->nr;
 	state.trips = trips;
 	state.sites = sites;
 	state.filter_presets = filter_presets;
+	state.sample_format = -1;
 
 	if (repo == dummy_git_repository)
 		return report_error("Unable to open git repository at '%s'", branch);
+	TRACE_BEGIN("git_load_dives");
+	if (git_lazy_samples)
+		state.sample_repo = add_sample_repository(repo);
+	/* Only a freshly opened logbook can be cached */
+	new_logbook = table == &dive_table && !table->nr && !trips->nr && !sites->nr;
+	state.use_snapshot = new_logbook;
+	if (state.use_snapshot) {
+		/* The full text index is built when the dives are processed */
+		char *filename = get_fulltext_cache_name(repo);
+		fulltext_load_cache(filename);
+		free(filename);
+	}
 	ret = do_git_load(repo, branch, &state);
-	git_repository_free(repo);
+	finish_active_dive(&state);
+	finish_pending_dives(&state);
+	if (!ret && new_logbook)
+		set_repo_sample_format(&state);
+	if (!ret && state.use_snapshot) {
+		finish_active_trip(&state);
+		save_git_snapshot(repo);
+	}
+	free(state.pending_dcs);
+	if (!state.sample_repo)
+		git_repository_free(repo);
 	free((void *)branch);
+	finish_active_trip(&state);
+	TRACE_END();
+	return ret;
+}
+
+/* The ids of the dive directories that are gone from the old tree */
+struct gone_dives {
+	const git_tree *new_tree;
+	git_oid *ids;
+	bool *matched;
+	int nr, allocated;
+};
+
+static void add_gone_dive(struct gone_dives *gone, const git_oid *id)
+{
+	if (gone->nr >= gone->allocated) {
+		gone->allocated = (gone->nr + 32) * 3 / 2;
+		gone->ids = realloc(gone->ids, gone->allocated * sizeof(*gone->ids));
+	}
+	gone->ids[gone->nr++] = *id;
+}
+
+/*
+ * Walk the month directories of the old tree and collect the dive
+ * directories of the trips and dives that are not in the new tree.
+ * Years and months that are the same in both trees are skipped.
+ */
+static int gone_dives_cb(const char *root, const git_tree_entry *entry, void *payload)
+{
+	struct gone_dives *gone = payload;
+	const char *name = git_tree_entry_name(entry);
+	int len = strlen(root), namelen;
+
+	if (git_tree_entry_filemode(entry) != GIT_FILEMODE_TREE)
+		return GIT_WALK_OK;
+	if (len <= 8 && same_tree_entry(gone->new_tree, root, entry))
+		return GIT_WALK_SKIP;
+	if (len < 8) {
+		/* Only recurse into the year and month directories */
+		while (isdigit(*name))
+			name++;
+		return *name ? GIT_WALK_SKIP : GIT_WALK_OK;
+	}
+
+	/* Dive directories are recognized by the time, as in walk_tree_directory() */
+	namelen = nonunique_length(name);
+	if (namelen >= 3 && (name[namelen-3] == ':' || name[namelen-3] == '=')) {
+		add_gone_dive(gone, git_tree_entry_id(entry));
+		return GIT_WALK_SKIP;
+	}
+
+	/* A trip: recurse to collect its dives. Other directories are ignored */
+	return len == 8 ? GIT_WALK_OK : GIT_WALK_SKIP;
+}
+
+static int compare_oids(const void *a, const void *b)
+{
+	return memcmp(a, b, sizeof(git_oid));
+}
+
+/*
+ * Find the loaded dives of the collected directories. Each directory
+ * accounts for exactly one dive, even if dives are equal. Fails if a
+ * loaded dive has been changed since the last save, and therefore has
+ * no id, or if a directory has no loaded dive: then the loaded dives
+ * don't correspond to the old tree.
+ */
+static int match_gone_dives(struct gone_dives *gone, struct dive_table *removed)
+{
+	int i, j;
+	struct dive *dive;
+
+	qsort(gone->ids, gone->nr, sizeof(*gone->ids), compare_oids);
+	gone->matched = calloc(gone->nr, sizeof(*gone->matched));
+	for_each_dive (i, dive) {
+		git_oid *id;
+
+		if (!dive_cache_is_valid(dive))
+			return -1;
+		id = bsearch(dive->git_id, gone->ids, gone->nr, sizeof(*gone->ids), compare_oids);
+		if (!id)
+			continue;
+		for (j = id - gone->ids; j > 0 && !compare_oids(gone->ids + j - 1, dive->git_id); j--)
+			;
+		for (; j < gone->nr && gone->matched[j]; j++)
+			;
+		if (j < gone->nr && !compare_oids(gone->ids + j, dive->git_id)) {
+			gone->matched[j] = true;
+			add_to_dive_table(removed, removed->nr, dive);
+		}
+	}
+	return removed->nr == gone->nr ? 0 : -1;
+}
+
+/*
+ * The dive sites that are in dive_site_table, but not in "before",
+ * which is a copy of an earlier state of the table and sorted by uuid.
+ */
+static void find_added_sites(const struct dive_site_table *before, struct dive_site_table *added)
+{
+	int i, j = 0;
+
+	for (i = 0; i < dive_site_table.nr; i++) {
+		struct dive_site *ds = dive_site_table.dive_sites[i];
+
+		while (j < before->nr && before->dive_sites[j]->uuid < ds->uuid)
+			j++;
+		if (j < before->nr && before->dive_sites[j] == ds)
+			continue;
+		add_dive_site_to_table(ds, added);
+	}
+}
+
+static bool same_tree_path(const git_tree *a, const git_tree *b, const char *path)
+{
+	git_tree_entry *entry_a, *entry_b;
+	bool same;
+
+	if (git_tree_entry_bypath(&entry_a, a, path))
+		return git_tree_entry_bypath(&entry_b, b, path) != 0;
+	if (git_tree_entry_bypath(&entry_b, b, path)) {
+		git_tree_entry_free(entry_a);
+		return false;
+	}
+	same = git_oid_equal(git_tree_entry_id(entry_a), git_tree_entry_id(entry_b));
+	git_tree_entry_free(entry_a);
+	git_tree_entry_free(entry_b);
+	return same;
+}
+
+static int load_dive_changes(git_repository *repo, git_tree *old_tree, git_tree *tree, struct git_dive_changes *changes)
+{
+	struct gone_dives gone = { 0 };
+	struct dive_site_table sites_before = empty_dive_site_table;
+	struct git_parser_state state = { 0 };
+	int ret;
+
+	/* Filter presets are not reloaded incrementally */
+	if (!same_tree_path(old_tree, tree, "02-Filterpresets"))
+		return -1;
+
+	gone.new_tree = tree;
+	git_tree_walk(old_tree, GIT_TREEWALK_PRE, gone_dives_cb, &gone);
+	ret = match_gone_dives(&gone, &changes->removed);
+	free(gone.ids);
+	free(gone.matched);
+	if (ret) {
+		changes->removed.nr = 0;
+		return ret;
+	}
+
+	/* A copy of the site table, sorted by uuid like the table itself */
+	sites_before.nr = sites_before.allocated = dive_site_table.nr;
+	sites_before.dive_sites = malloc(dive_site_table.nr * sizeof(*sites_before.dive_sites));
+	memcpy(sites_before.dive_sites, dive_site_table.dive_sites, dive_site_table.nr * sizeof(*sites_before.dive_sites));
+
+	state.repo = repo;
+	state.table = &changes->dives;
+	state.trips = &changes->trips;
+	state.sites = &dive_site_table;
+	state.old_tree = old_tree;
+	state.changes = changes;
+	state.sample_format = -1;
+	if (git_lazy_samples)
+		state.sample_repo = add_sample_repository(repo);
+	git_storage_update_progress(translate("gettextFromC", "Load changed dives from local cache"));
+	git_tree_walk(tree, GIT_TREEWALK_PRE, walk_tree_cb, &state);
 	finish_active_dive(&state);
+	finish_pending_dives(&state);
 	finish_active_trip(&state);
+	free(state.pending_dcs);
+	set_repo_sample_format(&state);
+
+	find_added_sites(&sites_before, &changes->added_sites);
+	free(sites_before.dive_sites);
+	if (!state.sample_repo)
+		git_repository_free(repo);
+	return 0;
+}
+
+/*
+ * Reload the dives, trips and dive sites after the branch has moved
+ * away from the commit that was loaded, for example by
+ * sync_with_remote(). Since a merge sets saved_git_id to the merge
+ * commit, the caller has to remember the id of the loaded commit
+ * before syncing. Only the parts of the tree that differ from the
+ * loaded one are parsed:
+ *  - the trips and the dives outside of trips that are new or changed
+ *    are parsed into changes->dives and changes->trips,
+ *  - the loaded dives of changed or removed trips and dives are listed
+ *    in changes->removed,
+ *  - new dive sites are registered in dive_site_table, as on a full
+ *    load, and listed in changes->added_sites,
+ *  - the new data of changed sites is parsed into changes->changed_sites.
+ * It is up to the caller to replace the dives and to update the sites.
+ *
+ * Returns 0 on success, in which case the repository and branch are
+ * consumed like in git_load_dives(). Returns nonzero if the loaded
+ * dives can't be updated this way, e.g. because they were changed
+ * since the last save or because the filter presets changed. Then
+ * nothing has been touched and the caller has to do a full reload.
+ * Dive sites that were removed from the tree are left alone; these
+ * are purged when they end up without dives.
+ */
+int git_load_dive_changes(struct git_repository *repo, const char *branch, const char *loaded_id, struct git_dive_changes *changes)
+{
+	git_oid old_id;
+	git_commit *commit, *old_commit;
+	git_tree *tree, *old_tree;
+	int ret;
+
+	if (repo == dummy_git_repository || empty_string(loaded_id) || git_oid_fromstr(&old_id, loaded_id))
+		return -1;
+	if (git_commit_lookup(&old_commit, repo, &old_id))
+		return -1;
+	if (find_commit(repo, branch, &commit)) {
+		git_object_free((git_object *)old_commit);
+		return -1;
+	}
+	ret = -1;
+	if (!git_commit_tree(&old_tree, old_commit)) {
+		if (!git_commit_tree(&tree, commit)) {
+			ret = load_dive_changes(repo, old_tree, tree, changes);
+			git_object_free((git_object *)tree);
+		}
+		git_object_free((git_object *)old_tree);
+	}
+	if (!ret) {
+		set_git_id(git_commit_id(commit));
+		git_storage_update_progress(translate("gettextFromC", "Successfully opened dive data"));
+		free((void *)branch);
+	}
+	git_object_free((git_object *)commit);
+	git_object_free((git_object *)old_commit);
 	return ret;
 }
+
+void free_git_dive_changes(struct git_dive_changes *changes)
+{
+	clear_dive_table(&changes->dives);
+	clear_trip_table(&changes->trips);
+	clear_dive_site_table(&changes->changed_sites);
+	/* These only refer to dives and sites of the main tables */
+	free(changes->removed.dives);
+	free(changes->added_sites.dive_sites);
+	changes->removed = empty_dive_table;
+	changes->added_sites = empty_dive_site_table;
+}
@@ -17,6 +17,7 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <zip.h>
 #include <sys/stat.h>
 
@@ -207,6 +208,22 @@ int subsurface_zip_close(struct zip *zip)
 	return zip_close(zip);
 }
 
+void *subsurface_mmap(int fd, size_t size)
+{
+	void *ret;
+
+	/* The zero-filled rest of the last page terminates the buffer */
+	if (size % sysconf(_SC_PAGESIZE) == 0)
+		return NULL;
+	ret = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	return ret == MAP_FAILED ? NULL : ret;
+}
+
+void subsurface_munmap(void *addr, size_t size)
+{
+	munmap(addr, size);
+}
+
 /* win32 console */
 void subsurface_console_init(void)
 {
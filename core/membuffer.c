@@ -41,6 +41,19 @@ void flush_buffer(struct membuffer *b, FILE *f)
 	}
 }
 
+/*
+ * Write the buffer to f once it holds at least 'size' bytes. Contrary to
+ * flush_buffer(), the allocation is kept for the data that follows, so
+ * that a buffer can be streamed to a file in large chunks.
+ */
+void flush_buffer_if_full(struct membuffer *b, FILE *f, unsigned int size)
+{
+	if (f && b->len >= size) {
+		fwrite(b->buffer, 1, b->len, f);
+		b->len = 0;
+	}
+}
+
 void strip_mb(struct membuffer *b)
 {
 	while (b->len && isspace(b->buffer[b->len - 1]))
@@ -156,30 +169,96 @@ void put_format_loc(struct membuffer *b, const char *fmt, ...)
 	va_end(args);
 }
 
-void put_milli(struct membuffer *b, const char *pre, int value, const char *post)
+static const char digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/* Enough for the digits of a 32-bit number */
+#define INT_DIGITS 10
+
+/* Write the digits of v backwards, ending just before 'end'. Returns the first digit. */
+static char *format_uint(char *end, unsigned int v)
 {
-	int i;
-	char buf[4];
-	const char *sign = "";
-	unsigned v;
-
-	v = value;
-	if (value < 0) {
-		sign = "-";
-		v = -value;
+	while (v >= 100) {
+		end -= 2;
+		memcpy(end, digit_pairs + (v % 100) * 2, 2);
+		v /= 100;
 	}
-	for (i = 2; i >= 0; i--) {
-		buf[i] = (v % 10) + '0';
-		v /= 10;
+	if (v >= 10) {
+		end -= 2;
+		memcpy(end, digit_pairs + v * 2, 2);
+	} else {
+		*--end = '0' + v;
 	}
-	buf[3] = 0;
-	if (buf[2] == '0') {
-		buf[2] = 0;
-		if (buf[1] == '0')
-			buf[1] = 0;
+	return end;
+}
+
+static unsigned int abs_value(int value)
+{
+	return value < 0 ? -(unsigned int)value : (unsigned int)value;
+}
+
+static void put_digits(struct membuffer *b, unsigned int v)
+{
+	char buf[INT_DIGITS];
+	char *end = buf + sizeof(buf);
+	char *p = format_uint(end, v);
+
+	put_bytes(b, p, end - p);
+}
+
+void put_integer(struct membuffer *b, const char *pre, int value, const char *post)
+{
+	put_string(b, pre);
+	if (value < 0)
+		put_bytes(b, "-", 1);
+	put_digits(b, abs_value(value));
+	put_string(b, post);
+}
+
+void put_milli(struct membuffer *b, const char *pre, int value, const char *post)
+{
+	char frac_buf[4];
+	unsigned int v = abs_value(value), frac = v % 1000;
+	int len = 2;
+
+	/* The fraction without trailing zeroes, but at least one digit */
+	frac_buf[0] = '.';
+	frac_buf[1] = '0' + frac / 100;
+	if (frac % 100) {
+		memcpy(frac_buf + 2, digit_pairs + (frac % 100) * 2, 2);
+		len = frac % 10 ? 4 : 3;
 	}
 
-	put_format(b, "%s%s%u.%s%s", pre, sign, v, buf, post);
+	put_string(b, pre);
+	if (value < 0)
+		put_bytes(b, "-", 1);
+	put_digits(b, v / 1000);
+	put_bytes(b, frac_buf, len);
+	put_string(b, post);
+}
+
+void put_minutes(struct membuffer *b, const char *pre, int seconds, const char *post)
+{
+	char sec_buf[3];
+	unsigned int v = abs_value(seconds);
+
+	put_string(b, pre);
+	if (seconds < 0)
+		put_bytes(b, "-", 1);
+	put_digits(b, v / 60);
+	sec_buf[0] = ':';
+	memcpy(sec_buf + 1, digit_pairs + (v % 60) * 2, 2);
+	put_bytes(b, sec_buf, 3);
+	put_string(b, post);
 }
 
 void put_temperature(struct membuffer *b, temperature_t temp, const char *pre, const char *post)
@@ -197,7 +276,7 @@ void put_depth(struct membuffer *b, depth_t depth, const char *pre, const char *
 void put_duration(struct membuffer *b, duration_t duration, const char *pre, const char *post)
 {
 	if (duration.seconds)
-		put_format(b, "%s%u:%02u%s", pre, FRACTION(duration.seconds, 60), post);
+		put_minutes(b, pre, duration.seconds, post);
 }
 
 void put_pressure(struct membuffer *b, pressure_t pressure, const char *pre, const char *post)
@@ -209,19 +288,30 @@ void put_pressure(struct membuffer *b, pressure_t pressure, const char *pre, con
 void put_salinity(struct membuffer *b, int salinity, const char *pre, const char *post)
 {
 	if (salinity)
-		put_format(b, "%s%d%s", pre, salinity / 10, post);
+		put_integer(b, pre, salinity / 10, post);
 }
 
 void put_degrees(struct membuffer *b, degrees_t value, const char *pre, const char *post)
 {
-	int udeg = value.udeg;
-	const char *sign = "";
-
-	if (udeg < 0) {
-		udeg = -udeg;
-		sign = "-";
+	char buf[7];
+	char *end = buf + sizeof(buf);
+	unsigned int udeg = abs_value(value.udeg), frac = udeg % 1000000;
+	char *p = end;
+
+	put_string(b, pre);
+	if (value.udeg < 0)
+		put_bytes(b, "-", 1);
+	put_digits(b, udeg / 1000000);
+
+	/* Six digits of fraction, with leading zeroes */
+	for (int i = 0; i < 3; i++) {
+		p -= 2;
+		memcpy(p, digit_pairs + (frac % 100) * 2, 2);
+		frac /= 100;
 	}
-	put_format(b, "%s%s%u.%06u%s", pre, sign, FRACTION(udeg, 1000000), post);
+	*--p = '.';
+	put_bytes(b, p, end - p);
+	put_string(b, post);
 }
 
 void put_location(struct membuffer *b, const location_t *loc, const char *pre, const char *post)
@@ -60,6 +60,7 @@ extern char *detach_cstring(struct membuffer *b);
 extern void free_buffer(struct membuffer *);
 extern void make_room(struct membuffer *b, unsigned int size);
 extern void flush_buffer(struct membuffer *, FILE *);
+extern void flush_buffer_if_full(struct membuffer *, FILE *, unsigned int);
 extern void put_bytes(struct membuffer *, const char *, int);
 extern void put_string(struct membuffer *, const char *);
 extern void put_quoted(struct membuffer *, const char *, int, int);
@@ -77,8 +78,17 @@ extern __printf(1, 0) char *vformat_string(const char *, va_list);
 extern __printf(1, 2) char *format_string(const char *, ...);
 
 
-/* Output one of our "milli" values with type and pre/post data */
+/*
+ * Output one of our "milli" values with type and pre/post data.
+ *
+ * put_milli(), put_integer() and put_minutes() don't go through printf,
+ * since they are called for every sample when saving a logbook. Like
+ * the other put_* helpers below, they don't depend on the locale.
+ */
 extern void put_milli(struct membuffer *, const char *, int, const char *);
+extern void put_integer(struct membuffer *, const char *, int, const char *);
+/* Seconds as "min:sec" */
+extern void put_minutes(struct membuffer *, const char *, int, const char *);
 
 /*
  * Helper functions for showing particular types. If the type
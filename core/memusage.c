@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: GPL-2.0
+/* memusage.c */
+/* per-subsystem accounting of the memory use */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "dive.h"
+#include "divelist.h"
+#include "membuffer.h"
+#include "memusage.h"
+#include "samplecolumns.h"
+
+#define MAX_MEM_REPORTERS 16
+
+static const char *category_names[NUM_MEM_CATEGORIES] = {
+	"samples",
+	"packed samples",
+	"events",
+	"extra data",
+	"plot info",
+	"thumbnails",
+	"undo stack",
+	"full text index"
+};
+
+static struct {
+	uint64_t allocs;
+	uint64_t bytes;
+} alloc_counters[NUM_MEM_CATEGORIES];
+
+static struct {
+	enum mem_category category;
+	mem_reporter_t reporter;
+	void *data;
+} reporters[MAX_MEM_REPORTERS];
+static int nr_reporters;
+
+void memusage_count_alloc(enum mem_category category, size_t bytes)
+{
+	__atomic_add_fetch(&alloc_counters[category].allocs, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&alloc_counters[category].bytes, bytes, __ATOMIC_RELAXED);
+}
+
+void memusage_register(enum mem_category category, mem_reporter_t reporter, void *data)
+{
+	if (nr_reporters >= MAX_MEM_REPORTERS)
+		return;
+	reporters[nr_reporters].category = category;
+	reporters[nr_reporters].reporter = reporter;
+	reporters[nr_reporters].data = data;
+	nr_reporters++;
+}
+
+void memusage_unregister(void *data)
+{
+	int i, j;
+
+	for (i = j = 0; i < nr_reporters; i++) {
+		if (reporters[i].data != data)
+			reporters[j++] = reporters[i];
+	}
+	nr_reporters = j;
+}
+
+static void add_usage(struct mem_usage *usage, enum mem_category category, size_t bytes, int objects)
+{
+	usage[category].bytes += bytes;
+	usage[category].objects += objects;
+}
+
+/* The dive data is always accounted, all other categories come from the reporters */
+static void dive_data_usage(struct mem_usage *usage)
+{
+	int i;
+	struct dive *d;
+
+	for_each_dive (i, d) {
+		const struct divecomputer *dc;
+		for (dc = &d->dc; dc; dc = dc->next) {
+			const struct event *ev;
+			const struct extra_data *ed;
+
+			add_usage(usage, MEM_SAMPLES, dc->alloc_samples * sizeof(struct sample), dc->samples);
+			if (dc->packed_samples)
+				add_usage(usage, MEM_PACKED_SAMPLES, packed_samples_size(dc), nr_packed_samples(dc));
+			for (ev = dc->events; ev; ev = ev->next)
+				add_usage(usage, MEM_EVENTS, sizeof(*ev) + strlen(ev->name) + 1, 1);
+			for (ed = dc->extra_data; ed; ed = ed->next) {
+				size_t size = sizeof(*ed);
+				if (ed->key)
+					size += strlen(ed->key) + 1;
+				if (ed->value)
+					size += strlen(ed->value) + 1;
+				add_usage(usage, MEM_EXTRA_DATA, size, 1);
+			}
+		}
+	}
+}
+
+static void put_size(struct membuffer *b, uint64_t bytes)
+{
+	if (bytes >= 1024 * 1024)
+		put_format(b, "%10.1f MB", bytes / (1024.0 * 1024.0));
+	else
+		put_format(b, "%10.1f kB", bytes / 1024.0);
+}
+
+void put_memory_usage(struct membuffer *b)
+{
+	struct mem_usage usage[NUM_MEM_CATEGORIES];
+	uint64_t total = 0;
+	int i;
+
+	memset(usage, 0, sizeof(usage));
+	dive_data_usage(usage);
+	for (i = 0; i < nr_reporters; i++) {
+		struct mem_usage u = { 0, 0 };
+		reporters[i].reporter(&u, reporters[i].data);
+		add_usage(usage, reporters[i].category, u.bytes, u.objects);
+	}
+
+	put_format(b, "Memory usage of %d dives\n", dive_table.nr);
+	put_format(b, "%-16s %13s %10s %10s %13s\n", "", "in use", "objects", "allocs", "allocated");
+	for (i = 0; i < NUM_MEM_CATEGORIES; i++) {
+		uint64_t allocs = __atomic_load_n(&alloc_counters[i].allocs, __ATOMIC_RELAXED);
+		uint64_t bytes = __atomic_load_n(&alloc_counters[i].bytes, __ATOMIC_RELAXED);
+
+		put_format(b, "%-16s ", category_names[i]);
+		put_size(b, usage[i].bytes);
+		put_format(b, " %10d %10llu ", usage[i].objects, (unsigned long long)allocs);
+		put_size(b, bytes);
+		put_string(b, "\n");
+		total += usage[i].bytes;
+	}
+	put_format(b, "%-16s ", "total");
+	put_size(b, total);
+	put_string(b, "\n");
+}
+
+void print_memory_usage(void)
+{
+	struct membuffer b = { 0 };
+
+	put_memory_usage(&b);
+	flush_buffer(&b, stdout);
+	free_buffer(&b);
+}
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef MEMUSAGE_H
+#define MEMUSAGE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct membuffer;
+
+/*
+ * Accounting of the memory used by the big consumers, so that users can
+ * include it in bug reports (About → Memory usage, or --memory-usage).
+ *
+ * For every category, the report shows the memory currently in use and
+ * the number and size of the allocations since start-up. The current use
+ * of the dive data is found by walking the dive table, the other subsystems
+ * register a reporter function. Reporters are registered and called on the
+ * GUI thread. The allocation counters are only bumped at the main
+ * allocation sites and may be updated from any thread.
+ *
+ * The sizes are those of the payload: malloc() and container overhead
+ * isn't known and not included, so the numbers are lower bounds.
+ */
+enum mem_category {
+	MEM_SAMPLES,
+	MEM_PACKED_SAMPLES,
+	MEM_EVENTS,
+	MEM_EXTRA_DATA,
+	MEM_PLOT_INFO,
+	MEM_THUMBNAILS,
+	MEM_UNDO_STACK,
+	MEM_FULLTEXT,
+	NUM_MEM_CATEGORIES
+};
+
+struct mem_usage {
+	size_t bytes;
+	int objects;
+};
+
+typedef void (*mem_reporter_t)(struct mem_usage *usage, void *data);
+
+extern void memusage_count_alloc(enum mem_category category, size_t bytes);
+extern void memusage_register(enum mem_category category, mem_reporter_t reporter, void *data);
+extern void memusage_unregister(void *data);
+extern void put_memory_usage(struct membuffer *b);
+extern void print_memory_usage(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MEMUSAGE_H
@@ -12,6 +12,88 @@
 #define UINT64_MAX (~0ULL)
 #endif
 
+// The parsers below read a few bytes at a time. To avoid a system call for each
+// of these reads, the file is read in chunks. Since the metadata are usually
+// found at the start of the file, typically only the first chunk is ever read.
+// Contrary to mapping the file, this also works for huge videos on 32-bit systems.
+class BufferedFile {
+public:
+	BufferedFile(QFile &f);
+	qint64 read(char *data, qint64 len);
+	// Pointer to the next len bytes in the buffer or null if the file is too short.
+	// Doesn't advance the position.
+	const char *peek(qint64 len);
+	bool seek(qint64 pos);
+	qint64 pos() const;
+	bool atEnd() const;
+private:
+	bool fill(qint64 len);
+	QFile &f;
+	qint64 size;
+	qint64 position;
+	qint64 bufferStart;
+	QByteArray buffer;
+};
+
+static const qint64 chunkSize = 64 * 1024;
+
+BufferedFile::BufferedFile(QFile &fIn) : f(fIn),
+	size(fIn.size()),
+	position(0),
+	bufferStart(0)
+{
+}
+
+// Make sure that the next len bytes are in the buffer
+bool BufferedFile::fill(qint64 len)
+{
+	if (position >= bufferStart && position + len <= bufferStart + buffer.size())
+		return true;
+	if (!f.seek(position))
+		return false;
+	buffer = f.read(std::max(len, chunkSize));
+	bufferStart = position;
+	return buffer.size() >= len;
+}
+
+qint64 BufferedFile::read(char *data, qint64 len)
+{
+	len = std::min(len, size - position);
+	if (len <= 0)
+		return 0;
+	if (!fill(len))
+		return -1;
+	memcpy(data, buffer.constData() + (position - bufferStart), len);
+	position += len;
+	return len;
+}
+
+const char *BufferedFile::peek(qint64 len)
+{
+	if (len > size - position || !fill(len))
+		return nullptr;
+	return buffer.constData() + (position - bufferStart);
+}
+
+// Like QFile, seeking beyond the end of the file is allowed
+bool BufferedFile::seek(qint64 pos)
+{
+	if (pos < 0)
+		return false;
+	position = pos;
+	return true;
+}
+
+qint64 BufferedFile::pos() const
+{
+	return position;
+}
+
+bool BufferedFile::atEnd() const
+{
+	return position >= size;
+}
+
 // The following functions fetch an arbitrary-length _unsigned_ integer from either
 // a file or a memory location in big-endian or little-endian mode. The size of the
 // integer is passed via a template argument [e.g. getBE<uint16_t>(...)].
@@ -32,7 +114,7 @@ static inline T getBE(const char *buf_in)
 }
 
 template <typename T>
-static inline T getBE(QFile &f, T def=0)
+static inline T getBE(BufferedFile &f, T def=0)
 {
 	constexpr size_t size = sizeof(T);
 	char buf[size];
@@ -55,7 +137,7 @@ static inline T getLE(const char *buf_in)
 }
 
 template <typename T>
-static inline T getLE(QFile &f, T def=0)
+static inline T getLE(BufferedFile &f, T def=0)
 {
 	constexpr size_t size = sizeof(T);
 	char buf[size];
@@ -64,7 +146,7 @@ static inline T getLE(QFile &f, T def=0)
 	return getLE<T>(buf);
 }
 
-static bool parseExif(QFile &f, struct metadata *metadata)
+static bool parseExif(BufferedFile &f, struct metadata *metadata)
 {
 	f.seek(0);
 	if (getBE<uint16_t>(f) != 0xffd8)
@@ -91,11 +173,12 @@ static bool parseExif(QFile &f, struct metadata *metadata)
 			if (len < 2)
 				return false;
 			len -= 2;
-			QByteArray data = f.read(len);
-			if (data.size() != len)
+			// Parse the segment straight out of the buffer
+			const char *data = f.peek(len);
+			if (!data)
 				return false;
 			easyexif::EXIFInfo exif;
-			if (exif.parseFromEXIFSegment(reinterpret_cast<const unsigned char *>(data.constData()), len) != PARSE_EXIF_SUCCESS)
+			if (exif.parseFromEXIFSegment(reinterpret_cast<const unsigned char *>(data), len) != PARSE_EXIF_SUCCESS)
 				return false;
 			metadata->location = create_location(exif.GeoLocation.Latitude, exif.GeoLocation.Longitude);
 			metadata->timestamp = exif.epoch();
@@ -120,7 +203,7 @@ static void parseXMP(const char *data, size_t size, metadata *metadata)
 		metadata->timestamp = timestamp;
 }
 
-static bool parseMP4(QFile &f, metadata *metadata)
+static bool parseMP4(BufferedFile &f, metadata *metadata)
 {
 	f.seek(0);
 
@@ -330,7 +413,7 @@ static bool parseDate(const QString &s_in, timestamp_t &timestamp)
 	return false;
 }
 
-static bool parseAVI(QFile &f, metadata *metadata)
+static bool parseAVI(BufferedFile &f, metadata *metadata)
 {
 	f.seek(0);
 
@@ -444,7 +527,7 @@ static bool parseAVI(QFile &f, metadata *metadata)
 	return found_riff;
 }
 
-static bool parseASF(QFile &f, metadata *metadata)
+static bool parseASF(BufferedFile &f, metadata *metadata)
 {
 	f.seek(0);
 
@@ -539,14 +622,15 @@ extern "C" mediatype_t get_metadata(const char *filename_in, metadata *data)
 	if (!f.open(QIODevice::ReadOnly))
 		return MEDIATYPE_IO_ERROR;
 
+	BufferedFile file(f);
 	mediatype_t res = MEDIATYPE_UNKNOWN;
-	if (parseExif(f, data))
+	if (parseExif(file, data))
 		res = MEDIATYPE_PICTURE;
-	else if(parseMP4(f, data))
+	else if(parseMP4(file, data))
 		res = MEDIATYPE_VIDEO;
-	else if(parseAVI(f, data))
+	else if(parseAVI(file, data))
 		res = MEDIATYPE_VIDEO;
-	else if(parseASF(f, data))
+	else if(parseASF(file, data))
 		res = MEDIATYPE_VIDEO;
 
 	// If we couldn't get a creation date from the file (for example AVI files don't
@@ -560,6 +644,24 @@ extern "C" mediatype_t get_metadata(const char *filename_in, metadata *data)
 	return res;
 }
 
+struct metadata_files {
+	const char * const *filenames;
+	struct metadata *data;
+};
+
+static void get_metadata_of_file(int idx, void *data_in)
+{
+	struct metadata_files *files = (struct metadata_files *)data_in;
+	get_metadata(files->filenames[idx], &files->data[idx]);
+}
+
+// The metadata extraction is dominated by file access, therefore do it in parallel
+extern "C" void get_metadata_of_files(int nr, const char * const *filenames, struct metadata *data)
+{
+	struct metadata_files files = { filenames, data };
+	run_in_parallel(nr, &get_metadata_of_file, &files);
+}
+
 extern "C" timestamp_t picture_get_timestamp(const char *filename)
 {
 	struct metadata data;
@@ -22,6 +22,7 @@ extern "C" {
 #endif
 
 enum mediatype_t get_metadata(const char *filename, struct metadata *data);
+void get_metadata_of_files(int nr, const char * const *filenames, struct metadata *data);
 timestamp_t picture_get_timestamp(const char *filename);
 
 #ifdef __cplusplus
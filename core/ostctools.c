@@ -9,6 +9,7 @@
 #include "gettext.h"
 #include "dive.h"
 #include "file.h"
+#include "bytereader.h"
 #include "libdivecomputer.h"
 
 /*
@@ -37,73 +38,41 @@ static int ostc_prepare_data(int data_model, dc_family_t dc_fam, device_data_t *
  * each file. So it's not necessary to iterate once and again on a parsing
  * function. Actually there's only one kind of archive for every DC model.
  */
-void ostctools_import(const char *file, struct dive_table *divetable, struct trip_table *trips, struct dive_site_table *sites)
+void ostctools_import(const char *file, struct memblock *mem, struct dive_table *divetable, struct trip_table *trips, struct dive_site_table *sites)
 {
 	UNUSED(trips);
 	UNUSED(sites);
-	FILE *archive;
+	struct byte_view archive = byte_view_of(mem), raw;
 	device_data_t *devdata = calloc(1, sizeof(device_data_t));
 	dc_family_t dc_fam;
-	unsigned char *buffer = calloc(65536, 1);
-	unsigned char uc_tmp[2];
+	unsigned char *buffer;
 	char *tmp;
 	struct dive *ostcdive = alloc_dive();
 	dc_status_t rc = 0;
-	int model, ret, i = 0, c;
+	int model, ret;
+	size_t i;
 	unsigned int serial;
 	struct extra_data *ptr;
-	const char *failed_to_read_msg = translate("gettextFromC", "Failed to read '%s'");
 
-	// Open the archive
-	if ((archive = subsurface_fopen(file, "rb")) == NULL) {
-		report_error(failed_to_read_msg, file);
+	// The dive number and the device's serial number, followed by the
+	// dive's raw data, header + profile, which has to hold the dc type
+	if (!byte_view_has(archive, 456, 9)) {
+		report_error(translate("gettextFromC", "Failed to read '%s'"), file);
 		free_dive(ostcdive);
 		goto out;
 	}
+	ostcdive->number = byte_view_u16le(archive, 258);
+	serial = byte_view_u16le(archive, 265);
 
-	// Read dive number from the log
-	if (fseek(archive, 258, 0) == -1) {
-		report_error(failed_to_read_msg, file);
-		free_dive(ostcdive);
-		goto close_out;
-	}
-	if (fread(uc_tmp, 1, 2, archive) != 2) {
-		report_error(failed_to_read_msg, file);
-		free_dive(ostcdive);
-		goto close_out;
-	}
-	ostcdive->number = uc_tmp[0] + (uc_tmp[1] << 8);
-
-	// Read device's serial number
-	if (fseek(archive, 265, 0) == -1) {
-		report_error(failed_to_read_msg, file);
-		free_dive(ostcdive);
-		goto close_out;
-	}
-	if (fread(uc_tmp, 1, 2, archive) != 2) {
-		report_error(failed_to_read_msg, file);
-		free_dive(ostcdive);
-		goto close_out;
-	}
-	serial = uc_tmp[0] + (uc_tmp[1] << 8);
-
-	// Read dive's raw data, header + profile
-	if (fseek(archive, 456, 0) == -1) {
-		report_error(failed_to_read_msg, file);
-		free_dive(ostcdive);
-		goto close_out;
-	}
-	while ((c = getc(archive)) != EOF) {
-		buffer[i] = c;
-		if (buffer[i] == 0xFD && buffer[i - 1] == 0xFD)
+	// The raw data ends with 0xFD 0xFD, the rest of the file is padding
+	raw = byte_view_sub(archive, 456, archive.size - 456);
+	for (i = 1; i < raw.size; i++) {
+		if (raw.data[i] == 0xFD && raw.data[i - 1] == 0xFD)
 			break;
-		i++;
-	}
-	if (ferror(archive)) {
-		report_error(failed_to_read_msg, file);
-		free_dive(ostcdive);
-		goto close_out;
 	}
+	if (i < raw.size)
+		raw.size = i + 1;
+	buffer = (unsigned char *)raw.data;
 
 	// Try to determine the dc family based on the header type
 	if (buffer[2] == 0x20 || buffer[2] == 0x21) {
@@ -120,7 +89,7 @@ void ostctools_import(const char *file, struct dive_table *divetable, struct tri
 		default:
 			report_error(translate("gettextFromC", "Unknown DC in dive %d"), ostcdive->number);
 			free_dive(ostcdive);
-			goto close_out;
+			goto out;
 		}
 	}
 
@@ -151,7 +120,7 @@ void ostctools_import(const char *file, struct dive_table *divetable, struct tri
 	if (ret == 0) {
 		report_error(translate("gettextFromC", "Unknown DC in dive %d"), ostcdive->number);
 		free_dive(ostcdive);
-		goto close_out;
+		goto out;
 	}
 	tmp = calloc(strlen(devdata->vendor) + strlen(devdata->model) + 28, 1);
 	sprintf(tmp, "%s %s (Imported from OSTCTools)", devdata->vendor, devdata->model);
@@ -159,7 +128,7 @@ void ostctools_import(const char *file, struct dive_table *divetable, struct tri
 	free(tmp);
 
 	// Parse the dive data
-	rc = libdc_buffer_parser(ostcdive, devdata, buffer, i + 1);
+	rc = libdc_buffer_parser(ostcdive, devdata, buffer, raw.size);
 	if (rc != DC_STATUS_SUCCESS)
 		report_error(translate("gettextFromC", "Error - %s - parsing dive %d"), errmsg(rc), ostcdive->number);
 
@@ -185,9 +154,6 @@ void ostctools_import(const char *file, struct dive_table *divetable, struct tri
 	record_dive_to_table(ostcdive, divetable);
 	sort_dive_table(divetable);
 
-close_out:
-	fclose(archive);
 out:
 	free(devdata);
-	free(buffer);
 }
@@ -3,22 +3,16 @@
 #include "core/subsurface-time.h"
 #include <QFile>
 #include <QXmlStreamReader>
+#include <algorithm>
 
-// Find the coordinates at the time specified in coords.start_dive
-// by searching the gpx file "fileName". Here is a typical trkpt element in GPX:
+// Read the track points of the gpx file "fileName". Here is a typical trkpt element in GPX:
 // <trkpt lat="-26.84" lon="32.88"><ele>-53.7</ele><time>2017-08-06T04:56:42Z</time></trkpt>
-int getCoordsFromGPXFile(struct dive_coords *coords, QString fileName)
+// The file is parsed as a stream, so only the track points are kept in memory.
+int getTrackFromGPXFile(std::vector<gpx_trackpoint> &track, QString fileName)
 {
 	struct tm tm1;
-	time_t trkpt_time = 0;
-	time_t divetime;
-	int64_t time_offset = coords->settingsDiff_offset + coords->timeZone_offset;
 	double lon = 0, lat = 0;
-	int line = 0;
-	bool first_line = true;
-	bool found = false;
 	bool trkpt_found = false;
-	divetime = coords->start_dive;
 	QFile gpxFile;
 	gpxFile.setFileName(fileName);
 	if (!gpxFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
@@ -28,24 +22,13 @@ int getCoordsFromGPXFile(struct dive_coords *coords, QString fileName)
 		return 1;
 	}
 
-#ifdef GPSDEBUG
-	struct tm time; // decode the time of start of dive:
-	utc_mkdate(divetime, &time);
-	int dyr,dmon,dday,dhr,dmin;
-	dyr = time.tm_year;
-	dmon = time.tm_mon;
-	dday = time.tm_mday;
-	dhr = time.tm_hour;
-	dmin = time.tm_min;
-#endif
-
+	track.clear();
 	QXmlStreamReader gpxReader(&gpxFile);
 	while (!gpxReader.atEnd()) {
 		gpxReader.readNext();
 		if (gpxReader.isStartElement()) {
 			if (gpxReader.name() == "trkpt") {
 				trkpt_found = true;
-				line++;
 				foreach (const QXmlStreamAttribute &attr, gpxReader.attributes()) {
 					if (attr.name().toString() == QLatin1String("lat"))
 						lat = attr.value().toString().toDouble();
@@ -62,27 +45,44 @@ int getCoordsFromGPXFile(struct dive_coords *coords, QString fileName)
 				tm1.tm_hour = dateTimeString.mid(11,2).toInt(&ok,10);
 				tm1.tm_min  = dateTimeString.mid(14,2).toInt(&ok,10);
 				tm1.tm_sec  = dateTimeString.mid(17,2).toInt(&ok,10);
-				trkpt_time = utc_mktime(&tm1) + time_offset;
-				if (first_line) {
-					first_line = false;
-					coords->start_track = trkpt_time;   // Local time of start of GPS track
-				}
-				if (trkpt_time >= divetime && found == false) {   // This GPS local time corresponds to the start time of the dive
-					coords->lon = lon; // save the coordinates
-					coords->lat = lat;
-					found = true;
-				}
-
-#ifdef GPSDEBUG
-				utc_mkdate(trkpt_time, &time); // print coordinates and time of each trkpt element of the GPX file as well as dive start time
-				fprintf(stderr, " %02d: lat=%f lon=%f timestamp=%ld (%ld) %02d/%02d/%02d %02d:%02d  dt=%ld  %02d/%02d/%02d %02d:%02d\n", line, lat,
-				lon, trkpt_time, time_offset, time.tm_year, time.tm_mon+1, time.tm_mday, time.tm_hour, time.tm_min, divetime, dyr, dmon+1, dday,dhr, dmin);
-#endif
-
+				track.push_back({ utc_mktime(&tm1), lat, lon });
 			}
 		}
 	} // while !at.End() // This loop executes until EOF causes a break out of the loop
-	coords->end_track = trkpt_time;  // This is the local time of the end of the GPS track
 	gpxFile.close();
+
+	// Tracks are usually recorded in order, but make sure we can do a binary search
+	std::stable_sort(track.begin(), track.end(),
+			 [](const gpx_trackpoint &a, const gpx_trackpoint &b) { return a.time < b.time; });
 	return 0;
 }
+
+// Find the coordinates of the first track point after the start of the dive (local time)
+// and the local start and end times of the track.
+void getCoordsFromTrack(struct dive_coords *coords, const std::vector<gpx_trackpoint> &track)
+{
+	int64_t time_offset = coords->settingsDiff_offset + coords->timeZone_offset;
+	if (track.empty()) {
+		coords->start_track = coords->end_track = 0;
+		return;
+	}
+	coords->start_track = track.front().time + time_offset;   // Local time of start of GPS track
+	coords->end_track = track.back().time + time_offset;      // This is the local time of the end of the GPS track
+
+	// The first GPS local time that corresponds to the start time of the dive
+	time_t divetime = coords->start_dive - time_offset;
+	auto it = std::lower_bound(track.begin(), track.end(), divetime,
+				   [](const gpx_trackpoint &p, time_t t) { return p.time < t; });
+	if (it != track.end()) {
+		coords->lon = it->lon; // save the coordinates
+		coords->lat = it->lat;
+	}
+
+#ifdef GPSDEBUG
+	struct tm time;
+	utc_mkdate(coords->start_dive, &time);
+	fprintf(stderr, "dive start %02d/%02d/%02d %02d:%02d: lat=%f lon=%f (%ld trackpoints, offset %ld)\n",
+		time.tm_year, time.tm_mon + 1, time.tm_mday, time.tm_hour, time.tm_min,
+		coords->lat, coords->lon, (long)track.size(), (long)time_offset);
+#endif
+}
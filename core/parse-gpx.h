@@ -3,6 +3,7 @@
 #define PARSE_GPX_H
 
 #include <QString>
+#include <vector>
 
 struct dive_coords {         // This structure holds important information after parsing the GPX file:
 	time_t start_dive;            // Start time of the current dive, obtained using current_dive (local time)
@@ -15,6 +16,16 @@ struct dive_coords {         // This structure holds important information after
 	int64_t timeZone_offset;      // UTC international time zone offset of dive site
 };
 
-int getCoordsFromGPXFile(dive_coords *coords, QString fileName);
+struct gpx_trackpoint {
+	time_t time;                  // UTC
+	double lat;
+	double lon;
+};
+
+// Read the track points of a GPX file, sorted by time. Returns 1 if the file can't be read.
+int getTrackFromGPXFile(std::vector<gpx_trackpoint> &track, QString fileName);
+// Find the coordinates at the time specified in coords.start_dive in a track read by
+// getTrackFromGPXFile(). This can be repeated for different offsets without reading the file again.
+void getCoordsFromTrack(dive_coords *coords, const std::vector<gpx_trackpoint> &track);
 
 #endif
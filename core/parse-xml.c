@@ -16,6 +16,7 @@
 #include <libxml/parser.h>
 #include <libxml/parserInternals.h>
 #include <libxml/tree.h>
+#include <libxml/xmlreader.h>
 #include <libxslt/transform.h>
 #include <libdivecomputer/parser.h>
 
@@ -32,11 +33,13 @@
 #include "picture.h"
 #include "qthelper.h"
 #include "tag.h"
+#include "arena.h"
 
 int quit, force_root;
 int last_xml_version = -1;
 
 static xmlDoc *test_xslt_transforms(xmlDoc *doc, const char **params);
+static bool may_need_xslt_transform(const char *root);
 
 const struct units SI_units = SI_UNITS;
 const struct units IMPERIAL_units = IMPERIAL_UNITS;
@@ -271,7 +274,7 @@ static void extra_data_end(struct parser_state *state)
 {
 	// don't save partial structures - we must have both key and value
 	if (state->cur_extra_data.key && state->cur_extra_data.value)
-		add_extra_data(get_dc(state), state->cur_extra_data.key, state->cur_extra_data.value);
+		add_extra_data_to_arena(&logbook_arena, get_dc(state), state->cur_extra_data.key, state->cur_extra_data.value);
 	free((void *)state->cur_extra_data.key);
 	free((void *)state->cur_extra_data.value);
 	state->cur_extra_data.key = state->cur_extra_data.value = NULL;
@@ -741,6 +744,21 @@ static void try_to_fill_dc_settings(const char *name, char *buf, struct parser_s
 	nonmatch("divecomputerid", name, buf);
 }
 
+static void try_to_fill_fingerprint(const char *name, char *buf, struct parser_state *state)
+{
+	start_match("fingerprint", name, buf);
+	if (MATCH("model.fingerprint", utf8_string, &state->cur_settings.fingerprint.model))
+		return;
+	if (MATCH("deviceid.fingerprint", hex_value, &state->cur_settings.fingerprint.deviceid))
+		return;
+	if (MATCH("diveid.fingerprint", hex_value, &state->cur_settings.fingerprint.diveid))
+		return;
+	if (MATCH("data.fingerprint", utf8_string, &state->cur_settings.fingerprint.data))
+		return;
+
+	nonmatch("fingerprint", name, buf);
+}
+
 static void try_to_fill_event(const char *name, char *buf, struct parser_state *state)
 {
 	start_match("event", name, buf);
@@ -845,95 +863,198 @@ static void try_to_fill_dc(struct divecomputer *dc, const char *name, char *buf,
 }
 
 /* We're in samples - try to convert the random xml value to something useful */
+/*
+ * Samples are by far the most common entries, so look up their
+ * names in a sorted table instead of going through a long chain
+ * of MATCH() calls.
+ */
+enum sample_keyword {
+	SAMPLE_UNKNOWN, SAMPLE_BEARING, SAMPLE_CNS, SAMPLE_CYLINDERINDEX, SAMPLE_CYLPRESS, SAMPLE_DECO,
+	SAMPLE_DECO_DEPTH, SAMPLE_DEPTH, SAMPLE_HEARTBEAT, SAMPLE_IN_DECO, SAMPLE_NDL, SAMPLE_O2PRESSURE,
+	SAMPLE_PDILUENT, SAMPLE_PO2, SAMPLE_PPO2, SAMPLE_PRESSURE, SAMPLE_PRESSURE0, SAMPLE_PRESSURE1,
+	SAMPLE_PRESSURE2, SAMPLE_PRESSURE3, SAMPLE_PRESSURE4, SAMPLE_RBT, SAMPLE_SAMPLETIME, SAMPLE_SENSOR,
+	SAMPLE_SENSOR1, SAMPLE_SENSOR2, SAMPLE_SENSOR3, SAMPLE_SETPOINT, SAMPLE_STOPDEPTH, SAMPLE_STOPTIME,
+	SAMPLE_TEMP, SAMPLE_TEMPERATURE, SAMPLE_DECO_TIME, SAMPLE_TIME, SAMPLE_TTS
+};
+
+/* These need to be sorted! */
+static const struct sample_keyword_entry {
+	const char *name;
+	enum sample_keyword keyword;
+} sample_keywords[] = {
+	{ "bearing", SAMPLE_BEARING },
+	{ "cns.sample", SAMPLE_CNS },
+	{ "cylinderindex.sample", SAMPLE_CYLINDERINDEX },
+	{ "cylpress.sample", SAMPLE_CYLPRESS },
+	{ "deco.sample", SAMPLE_DECO },
+	{ "depth.deco", SAMPLE_DECO_DEPTH },
+	{ "depth.sample", SAMPLE_DEPTH },
+	{ "heartbeat", SAMPLE_HEARTBEAT },
+	{ "in_deco.sample", SAMPLE_IN_DECO },
+	{ "ndl.sample", SAMPLE_NDL },
+	{ "o2pressure.sample", SAMPLE_O2PRESSURE },
+	{ "pdiluent.sample", SAMPLE_PDILUENT },
+	{ "po2.sample", SAMPLE_PO2 },
+	{ "ppo2.sample", SAMPLE_PPO2 },
+	{ "pressure.sample", SAMPLE_PRESSURE },
+	{ "pressure0.sample", SAMPLE_PRESSURE0 },
+	{ "pressure1.sample", SAMPLE_PRESSURE1 },
+	{ "pressure2.sample", SAMPLE_PRESSURE2 },
+	{ "pressure3.sample", SAMPLE_PRESSURE3 },
+	{ "pressure4.sample", SAMPLE_PRESSURE4 },
+	{ "rbt.sample", SAMPLE_RBT },
+	{ "sampletime.sample", SAMPLE_SAMPLETIME },
+	{ "sensor.sample", SAMPLE_SENSOR },
+	{ "sensor1.sample", SAMPLE_SENSOR1 },
+	{ "sensor2.sample", SAMPLE_SENSOR2 },
+	{ "sensor3.sample", SAMPLE_SENSOR3 },
+	{ "setpoint.sample", SAMPLE_SETPOINT },
+	{ "stopdepth.sample", SAMPLE_STOPDEPTH },
+	{ "stoptime.sample", SAMPLE_STOPTIME },
+	{ "temp.sample", SAMPLE_TEMP },
+	{ "temperature.sample", SAMPLE_TEMPERATURE },
+	{ "time.deco", SAMPLE_DECO_TIME },
+	{ "time.sample", SAMPLE_TIME },
+	{ "tts.sample", SAMPLE_TTS },
+};
+
+/* Compare a keyword to the first len characters of name, like strcmp() would */
+static int keyword_cmp(const char *keyword, const char *name, size_t len)
+{
+	int cmp = strncmp(keyword, name, len);
+	return cmp ? cmp : (unsigned char)keyword[len];
+}
+
+static enum sample_keyword lookup_sample_keyword(const char *name, size_t len)
+{
+	/* Standard binary search in a table */
+	unsigned low = 0, high = sizeof(sample_keywords) / sizeof(sample_keywords[0]);
+
+	while (low < high) {
+		unsigned mid = (low + high) / 2;
+		int cmp = keyword_cmp(sample_keywords[mid].name, name, len);
+		if (!cmp)
+			return sample_keywords[mid].keyword;
+		if (cmp > 0)
+			high = mid;
+		else
+			low = mid + 1;
+	}
+	return SAMPLE_UNKNOWN;
+}
+
+/*
+ * Same semantics as match_name(): the keyword has to match the name
+ * up to a '.' or the end. Try the two-level name first, then only
+ * the element name.
+ */
+static enum sample_keyword find_sample_keyword(const char *name)
+{
+	const char *first = strchr(name, '.');
+	const char *second = first ? strchr(first + 1, '.') : NULL;
+	enum sample_keyword res;
+
+	res = lookup_sample_keyword(name, second ? (size_t)(second - name) : strlen(name));
+	if (res == SAMPLE_UNKNOWN && first)
+		res = lookup_sample_keyword(name, first - name);
+	return res;
+}
+
 static void try_to_fill_sample(struct sample *sample, const char *name, char *buf, struct parser_state *state)
 {
+	enum sample_keyword keyword = find_sample_keyword(name);
 	int in_deco;
 	pressure_t p;
 
 	start_match("sample", name, buf);
-	if (MATCH_STATE("pressure.sample", pressure, &sample->pressure[0]))
-		return;
-	if (MATCH_STATE("cylpress.sample", pressure, &sample->pressure[0]))
-		return;
-	if (MATCH_STATE("pdiluent.sample", pressure, &sample->pressure[0]))
+	switch (keyword) {
+	case SAMPLE_PRESSURE:
+	case SAMPLE_CYLPRESS:
+	case SAMPLE_PDILUENT:
+		pressure(buf, &sample->pressure[0], state);
 		return;
-	if (MATCH_STATE("o2pressure.sample", pressure, &sample->pressure[1]))
+	case SAMPLE_O2PRESSURE:
+		pressure(buf, &sample->pressure[1], state);
 		return;
 	/* Christ, this is ugly */
-	if (MATCH_STATE("pressure0.sample", pressure, &p)) {
-		add_sample_pressure(sample, 0, p.mbar);
+	case SAMPLE_PRESSURE0:
+	case SAMPLE_PRESSURE1:
+	case SAMPLE_PRESSURE2:
+	case SAMPLE_PRESSURE3:
+	case SAMPLE_PRESSURE4:
+		pressure(buf, &p, state);
+		add_sample_pressure(sample, keyword - SAMPLE_PRESSURE0, p.mbar);
 		return;
-	}
-	if (MATCH_STATE("pressure1.sample", pressure, &p)) {
-		add_sample_pressure(sample, 1, p.mbar);
+	case SAMPLE_CYLINDERINDEX:
+		get_cylinderindex(buf, &sample->sensor[0], state);
 		return;
-	}
-	if (MATCH_STATE("pressure2.sample", pressure, &p)) {
-		add_sample_pressure(sample, 2, p.mbar);
+	case SAMPLE_SENSOR:
+		get_sensor(buf, &sample->sensor[0]);
 		return;
-	}
-	if (MATCH_STATE("pressure3.sample", pressure, &p)) {
-		add_sample_pressure(sample, 3, p.mbar);
+	case SAMPLE_DEPTH:
+		depth(buf, &sample->depth, state);
 		return;
-	}
-	if (MATCH_STATE("pressure4.sample", pressure, &p)) {
-		add_sample_pressure(sample, 4, p.mbar);
+	case SAMPLE_TEMP:
+	case SAMPLE_TEMPERATURE:
+		temperature(buf, &sample->temperature, state);
 		return;
-	}
-	if (MATCH_STATE("cylinderindex.sample", get_cylinderindex, &sample->sensor[0]))
-		return;
-	if (MATCH("sensor.sample", get_sensor, &sample->sensor[0]))
-		return;
-	if (MATCH_STATE("depth.sample", depth, &sample->depth))
-		return;
-	if (MATCH_STATE("temp.sample", temperature, &sample->temperature))
-		return;
-	if (MATCH_STATE("temperature.sample", temperature, &sample->temperature))
+	case SAMPLE_SAMPLETIME:
+	case SAMPLE_TIME:
+		sampletime(buf, &sample->time);
 		return;
-	if (MATCH("sampletime.sample", sampletime, &sample->time))
+	case SAMPLE_NDL:
+		sampletime(buf, &sample->ndl);
 		return;
-	if (MATCH("time.sample", sampletime, &sample->time))
+	case SAMPLE_TTS:
+		sampletime(buf, &sample->tts);
 		return;
-	if (MATCH("ndl.sample", sampletime, &sample->ndl))
-		return;
-	if (MATCH("tts.sample", sampletime, &sample->tts))
-		return;
-	if (MATCH("in_deco.sample", get_index, &in_deco)) {
+	case SAMPLE_IN_DECO:
+		get_index(buf, &in_deco);
 		sample->in_deco = (in_deco == 1);
 		return;
-	}
-	if (MATCH("stoptime.sample", sampletime, &sample->stoptime))
-		return;
-	if (MATCH_STATE("stopdepth.sample", depth, &sample->stopdepth))
+	case SAMPLE_STOPTIME:
+	case SAMPLE_DECO_TIME:
+		sampletime(buf, &sample->stoptime);
 		return;
-	if (MATCH("cns.sample", get_uint16, &sample->cns))
+	case SAMPLE_STOPDEPTH:
+	case SAMPLE_DECO_DEPTH:
+		depth(buf, &sample->stopdepth, state);
 		return;
-	if (MATCH("rbt.sample", sampletime, &sample->rbt))
+	case SAMPLE_CNS:
+		get_uint16(buf, &sample->cns);
 		return;
-	if (MATCH("sensor1.sample", double_to_o2pressure, &sample->o2sensor[0])) // CCR O2 sensor data
+	case SAMPLE_RBT:
+		sampletime(buf, &sample->rbt);
 		return;
-	if (MATCH("sensor2.sample", double_to_o2pressure, &sample->o2sensor[1]))
+	case SAMPLE_SENSOR1: // CCR O2 sensor data
+		double_to_o2pressure(buf, &sample->o2sensor[0]);
 		return;
-	if (MATCH("sensor3.sample", double_to_o2pressure, &sample->o2sensor[2])) // up to 3 CCR sensors
+	case SAMPLE_SENSOR2:
+		double_to_o2pressure(buf, &sample->o2sensor[1]);
 		return;
-	if (MATCH("po2.sample", double_to_o2pressure, &sample->setpoint))
+	case SAMPLE_SENSOR3: // up to 3 CCR sensors
+		double_to_o2pressure(buf, &sample->o2sensor[2]);
 		return;
-	if (MATCH("heartbeat", get_uint8, &sample->heartbeat))
+	case SAMPLE_PO2:
+	case SAMPLE_SETPOINT:
+		double_to_o2pressure(buf, &sample->setpoint);
 		return;
-	if (MATCH("bearing", get_bearing, &sample->bearing))
+	case SAMPLE_HEARTBEAT:
+		get_uint8(buf, &sample->heartbeat);
 		return;
-	if (MATCH("setpoint.sample", double_to_o2pressure, &sample->setpoint))
+	case SAMPLE_BEARING:
+		get_bearing(buf, &sample->bearing);
 		return;
-	if (MATCH("ppo2.sample", double_to_o2pressure, &sample->o2sensor[state->next_o2_sensor])) {
+	case SAMPLE_PPO2:
+		double_to_o2pressure(buf, &sample->o2sensor[state->next_o2_sensor]);
 		state->next_o2_sensor++;
 		return;
-	}
-	if (MATCH("deco.sample", parse_libdc_deco, sample))
-		return;
-	if (MATCH("time.deco", sampletime, &sample->stoptime))
-		return;
-	if (MATCH_STATE("depth.deco", depth, &sample->stopdepth))
+	case SAMPLE_DECO:
+		parse_libdc_deco(buf, sample);
 		return;
+	case SAMPLE_UNKNOWN:
+		break;
+	}
 
 	switch (state->import_source) {
 	case DIVINGLOG:
@@ -982,7 +1103,7 @@ static int divinglog_dive_match(struct dive *dive, const char *name, char *buf,
 	cylinder_t cyl = empty_cylinder;
 	if (MATCH("tanktype", utf8_string, &cyl.type.description)) {
 		cylinder_t *cyl0 = get_or_create_cylinder(dive, 0);
-		free((void *)cyl0->type.description);
+		arena_free((void *)cyl0->type.description);
 		cyl0->type.description = cyl.type.description;
 		return 1;
 	}
@@ -1472,6 +1593,7 @@ static bool entry(const char *name, char *buf, struct parser_state *state)
 	}
 	if (state->in_settings) {
 		try_to_fill_dc_settings(name, buf, state);
+		try_to_fill_fingerprint(name, buf, state);
 		try_to_match_autogroup(name, buf);
 		return true;
 	}
@@ -1621,6 +1743,7 @@ static struct nesting {
 	parser_func start, end;
 } nesting[] = {
 	  { "divecomputerid", dc_settings_start, dc_settings_end },
+	  { "fingerprint", fingerprint_settings_start, fingerprint_settings_end },
 	  { "settings", settings_start, settings_end },
 	  { "site", dive_site_start, dive_site_end },
 	  { "filterpreset", filter_preset_start, filter_preset_end },
@@ -1680,6 +1803,183 @@ static bool traverse(xmlNode *root, struct parser_state *state)
 	return ret;
 }
 
+/*
+ * The streaming parser only keeps the current node in memory, so
+ * it never builds the tree of the whole file. It produces the same
+ * entry() calls as traverse() does on the DOM: first the attributes
+ * of an element, then its text content.
+ */
+struct stream_element {
+	const char *name;
+	const struct nesting *rule;
+};
+
+static const struct nesting *find_nesting_rule(const char *name)
+{
+	const struct nesting *rule = nesting;
+
+	while (rule->name && strcmp(rule->name, name))
+		rule++;
+	return rule;
+}
+
+/* Like nodename(), but for the names provided by the xmlTextReader */
+static const char *stream_nodename(const char *name, const char *parent, char *buf, int len)
+{
+	char *p = buf;
+	char c;
+
+	/* Make sure it's always NUL-terminated */
+	p[--len] = 0;
+
+	for (;;) {
+		while ((c = *name++) != 0) {
+			/* Cheaper 'tolower()' for ASCII */
+			c = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+			*p++ = c;
+			if (!--len)
+				return buf;
+		}
+		*p = 0;
+		if (!parent)
+			return buf;
+		*p++ = '.';
+		if (!--len)
+			return buf;
+		name = parent;
+		parent = NULL;
+	}
+}
+
+static bool is_blank(const char *s)
+{
+	while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r')
+		s++;
+	return !*s;
+}
+
+static bool stream_attributes(xmlTextReaderPtr reader, const char *element, struct parser_state *state)
+{
+	char buffer[MAXNAME];
+	bool ret = true;
+
+	while (ret && xmlTextReaderMoveToNextAttribute(reader) == 1) {
+		const char *value = (const char *)xmlTextReaderConstValue(reader);
+
+		if (xmlTextReaderIsNamespaceDecl(reader) || !value || is_blank(value))
+			continue;
+		ret = entry(stream_nodename((const char *)xmlTextReaderConstLocalName(reader), element, buffer, sizeof(buffer)),
+			    (char *)value, state);
+	}
+	xmlTextReaderMoveToElement(reader);
+	return ret;
+}
+
+static void stream_end_element(struct stream_element *stack, int *depth, struct parser_state *state)
+{
+	const struct nesting *rule;
+
+	if (!*depth)
+		return;
+	rule = stack[--*depth].rule;
+	if (rule->end)
+		rule->end(state);
+}
+
+/*
+ * Returns 0 on success, -1 if the parser decided to give up
+ * and -2 if the input isn't well-formed XML.
+ */
+static int stream_xml(xmlTextReaderPtr reader, struct parser_state *state)
+{
+	char buffer[MAXNAME];
+	struct stream_element *stack = NULL;
+	int depth = 0, allocated = 0;
+	int res = 1, ret = 0;
+
+	/* The reader is already positioned on the root element */
+	do {
+		switch (xmlTextReaderNodeType(reader)) {
+		case XML_READER_TYPE_ELEMENT: {
+			const char *name = (const char *)xmlTextReaderConstLocalName(reader);
+			const struct nesting *rule = find_nesting_rule(name);
+
+			if (depth >= allocated) {
+				allocated = (depth + 8) * 3 / 2;
+				stack = realloc(stack, allocated * sizeof(*stack));
+				if (!stack)
+					exit(1);
+			}
+			stack[depth].name = name;
+			stack[depth].rule = rule;
+			depth++;
+			if (rule->start)
+				rule->start(state);
+			if (!stream_attributes(reader, name, state))
+				ret = -1;
+			else if (xmlTextReaderIsEmptyElement(reader))
+				stream_end_element(stack, &depth, state);
+			break;
+		}
+		case XML_READER_TYPE_END_ELEMENT:
+			stream_end_element(stack, &depth, state);
+			break;
+		case XML_READER_TYPE_TEXT:
+		case XML_READER_TYPE_CDATA: {
+			const char *value = (const char *)xmlTextReaderConstValue(reader);
+
+			if (!depth || !value || is_blank(value))
+				break;
+			if (!entry(stream_nodename(stack[depth - 1].name, depth > 1 ? stack[depth - 2].name : NULL,
+						   buffer, sizeof(buffer)), (char *)value, state))
+				ret = -1;
+			break;
+		}
+		}
+	} while (!ret && (res = xmlTextReaderRead(reader)) == 1);
+	free(stack);
+	if (!ret && res < 0)
+		ret = -2;
+	return ret;
+}
+
+/*
+ * Files without encoding declaration that aren't valid UTF-8 are
+ * parsed as latin1, like the DOM parser does when the first try fails.
+ */
+static const char *guess_xml_encoding(const char *buffer)
+{
+	if (!strncmp(buffer, "<?xml", 5)) {
+		const char *end = strstr(buffer, "?>");
+		const char *enc = strstr(buffer, "encoding");
+		if (end && enc && enc < end)
+			return NULL;
+	}
+	return xmlCheckUTF8((const xmlChar *)buffer) ? NULL : "latin1";
+}
+
+/*
+ * Peek at the root element: only files that don't have to go through
+ * an XSLT transformation can be parsed as a stream. Returns a reader
+ * that is positioned on the root element, or NULL.
+ */
+static xmlTextReaderPtr open_xml_stream(const char *url, const char *buffer)
+{
+	xmlTextReaderPtr reader = xmlReaderForMemory(buffer, strlen(buffer), url, guess_xml_encoding(buffer), 0);
+
+	if (!reader)
+		return NULL;
+	while (xmlTextReaderRead(reader) == 1) {
+		if (xmlTextReaderNodeType(reader) != XML_READER_TYPE_ELEMENT)
+			continue;
+		if (may_need_xslt_transform((const char *)xmlTextReaderConstLocalName(reader)))
+			break;
+		return reader;
+	}
+	xmlFreeTextReader(reader);
+	return NULL;
+}
+
 /* Per-file reset */
 static void reset_all(struct parser_state *state)
 {
@@ -1725,6 +2025,7 @@ int parse_xml_buffer(const char *url, const char *buffer, int size,
 {
 	UNUSED(size);
 	xmlDoc *doc;
+	xmlTextReaderPtr reader;
 	const char *res = preprocess_divelog_de(buffer);
 	int ret = 0;
 	struct parser_state state;
@@ -1734,6 +2035,22 @@ int parse_xml_buffer(const char *url, const char *buffer, int size,
 	state.trips = trips;
 	state.sites = sites;
 	state.filter_presets = filter_presets;
+
+	reader = open_xml_stream(url, res);
+	if (reader) {
+		reset_all(&state);
+		dive_start(&state);
+		ret = stream_xml(reader, &state);
+		dive_end(&state);
+		free_parser_state(&state);
+		xmlFreeTextReader(reader);
+		if (res != buffer)
+			free((char *)res);
+		if (ret == -2)
+			return report_error(translate("gettextFromC", "Failed to parse '%s'"), url);
+		return ret;
+	}
+
 	doc = xmlReadMemory(res, strlen(res), url, NULL, 0);
 	if (!doc)
 		doc = xmlReadMemory(res, strlen(res), url, "latin1", 0);
@@ -2308,6 +2625,16 @@ static struct xslt_files {
 	  { NULL, }
   };
 
+/* Conservative check based on the name of the root element only */
+static bool may_need_xslt_transform(const char *root)
+{
+	for (const struct xslt_files *info = xslt_files; info->root; info++) {
+		if (strcasecmp(root, info->root) == 0)
+			return true;
+	}
+	return false;
+}
+
 static xmlDoc *test_xslt_transforms(xmlDoc *doc, const char **params)
 {
 	struct xslt_files *info = xslt_files;
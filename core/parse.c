@@ -14,7 +14,9 @@
 #include "picture.h"
 #include "trip.h"
 #include "device.h"
+#include "fingerprint.h"
 #include "gettext.h"
+#include "arena.h"
 
 struct dive_table dive_table;
 
@@ -124,9 +126,9 @@ void event_end(struct parser_state *state)
 		 */
 		if (state->cur_event.type == 0 && strcmp(state->cur_event.name, "gaschange") == 0)
 			state->cur_event.type = state->cur_event.value >> 16 > 0 ? SAMPLE_EVENT_GASCHANGE2 : SAMPLE_EVENT_GASCHANGE;
-		ev = add_event(dc, state->cur_event.time.seconds,
-			       state->cur_event.type, state->cur_event.flags,
-			       state->cur_event.value, state->cur_event.name);
+		ev = add_event_to_arena(&logbook_arena, dc, state->cur_event.time.seconds,
+					state->cur_event.type, state->cur_event.flags,
+					state->cur_event.value, state->cur_event.name);
 
 		/*
 		 * Older logs might mark the dive to be CCR by having an "SP change" event at time 0:00. Better
@@ -206,6 +208,28 @@ void dc_settings_end(struct parser_state *state)
 	reset_dc_settings(state);
 }
 
+static void reset_fingerprint_settings(struct parser_state *state)
+{
+	free((void *)state->cur_settings.fingerprint.model);
+	free((void *)state->cur_settings.fingerprint.data);
+	state->cur_settings.fingerprint.model = NULL;
+	state->cur_settings.fingerprint.data = NULL;
+	state->cur_settings.fingerprint.deviceid = 0;
+	state->cur_settings.fingerprint.diveid = 0;
+}
+
+void fingerprint_settings_start(struct parser_state *state)
+{
+	reset_fingerprint_settings(state);
+}
+
+void fingerprint_settings_end(struct parser_state *state)
+{
+	create_fingerprint_node_from_hex(state->cur_settings.fingerprint.model, state->cur_settings.fingerprint.deviceid,
+					 state->cur_settings.fingerprint.diveid, state->cur_settings.fingerprint.data);
+	reset_fingerprint_settings(state);
+}
+
 void dive_site_start(struct parser_state *state)
 {
 	if (state->cur_dive_site)
@@ -520,3 +544,46 @@ int atoi_n(char *ptr, unsigned int len)
 	}
 	return 0;
 }
+
+int sql_cursor_open(struct sql_cursor *cursor, sqlite3 *handle, const char *query)
+{
+	cursor->status = sqlite3_prepare_v2(handle, query, -1, &cursor->stmt, NULL);
+	if (cursor->status != SQLITE_OK) {
+		sqlite3_finalize(cursor->stmt);
+		cursor->stmt = NULL;
+		return cursor->status;
+	}
+	cursor->status = sqlite3_step(cursor->stmt);
+	return cursor->status == SQLITE_ROW || cursor->status == SQLITE_DONE ? SQLITE_OK : cursor->status;
+}
+
+#define SQL_CURSOR_MAX_COLUMNS 16
+
+int sql_cursor_rows(struct sql_cursor *cursor, sqlite3_int64 id, int (*callback)(void *, int, char **, char **), void *param)
+{
+	char *data[SQL_CURSOR_MAX_COLUMNS];
+	int columns, i;
+
+	if (!cursor->stmt)
+		return cursor->status == SQLITE_OK ? SQLITE_MISUSE : cursor->status;
+	columns = sqlite3_column_count(cursor->stmt) - 1;
+	if (columns < 0 || columns > SQL_CURSOR_MAX_COLUMNS)
+		return SQLITE_RANGE;
+
+	while (cursor->status == SQLITE_ROW && sqlite3_column_int64(cursor->stmt, 0) < id)
+		cursor->status = sqlite3_step(cursor->stmt);
+	while (cursor->status == SQLITE_ROW && sqlite3_column_int64(cursor->stmt, 0) == id) {
+		for (i = 0; i < columns; i++)
+			data[i] = (char *)sqlite3_column_text(cursor->stmt, i + 1);
+		if (callback(param, columns, data, NULL))
+			return SQLITE_ABORT;
+		cursor->status = sqlite3_step(cursor->stmt);
+	}
+	return cursor->status == SQLITE_ROW || cursor->status == SQLITE_DONE ? SQLITE_OK : cursor->status;
+}
+
+void sql_cursor_close(struct sql_cursor *cursor)
+{
+	sqlite3_finalize(cursor->stmt);
+	cursor->stmt = NULL;
+}
@@ -24,6 +24,11 @@ struct parser_settings {
 		uint32_t deviceid;
 		const char *nickname, *serial_nr, *firmware;
 	} dc;
+	struct {
+		const char *model;
+		uint32_t deviceid, diveid;
+		const char *data;
+	} fingerprint;
 };
 
 enum import_source {
@@ -108,6 +113,8 @@ void settings_start(struct parser_state *state);
 void settings_end(struct parser_state *state);
 void dc_settings_start(struct parser_state *state);
 void dc_settings_end(struct parser_state *state);
+void fingerprint_settings_start(struct parser_state *state);
+void fingerprint_settings_end(struct parser_state *state);
 void dive_site_start(struct parser_state *state);
 void dive_site_end(struct parser_state *state);
 void dive_start(struct parser_state *state);
@@ -138,6 +145,21 @@ void utf8_string(char *buffer, void *_res);
 void add_dive_site(char *ds_name, struct dive *dive, struct parser_state *state);
 int atoi_n(char *ptr, unsigned int len);
 
+/*
+ * A query over the records of all dives, ordered by the integer dive id
+ * in the first column. The SQL based parsers step through it while
+ * reading the dives, which replaces one query per dive. The rows of
+ * dive "id" are passed, without the id column, to a sqlite3_exec()
+ * style callback. Hence, the dives must be read in ascending id order.
+ */
+struct sql_cursor {
+	sqlite3_stmt *stmt;
+	int status;
+};
+int sql_cursor_open(struct sql_cursor *cursor, sqlite3 *handle, const char *query);
+int sql_cursor_rows(struct sql_cursor *cursor, sqlite3_int64 id, int (*callback)(void *, int, char **, char **), void *param);
+void sql_cursor_close(struct sql_cursor *cursor);
+
 void parse_xml_init(void);
 int parse_xml_buffer(const char *url, const char *buf, int size, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites,
 		     filter_preset_table_t *filter_presets, const char **params);
@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "parsequeue.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <deque>
+
+struct parse_queue : public QThread {
+	parse_queue(void (*fn)(void *job), int capacity);
+	void run() override;
+
+	void (*fn)(void *job);
+	int capacity;
+	bool done;
+	std::deque<void *> jobs;
+	QMutex mutex;
+	QWaitCondition jobAvailable;
+	QWaitCondition spaceAvailable;
+};
+
+parse_queue::parse_queue(void (*fnIn)(void *job), int capacityIn) :
+	fn(fnIn),
+	capacity(capacityIn > 0 ? capacityIn : 1),
+	done(false)
+{
+}
+
+void parse_queue::run()
+{
+	for (;;) {
+		void *job;
+		{
+			QMutexLocker lock(&mutex);
+			while (jobs.empty() && !done)
+				jobAvailable.wait(&mutex);
+			if (jobs.empty())
+				return;
+			job = jobs.front();
+			jobs.pop_front();
+			spaceAvailable.wakeOne();
+		}
+		fn(job);
+	}
+}
+
+extern "C" struct parse_queue *parse_queue_start(void (*fn)(void *job), int capacity)
+{
+	parse_queue *queue = new parse_queue(fn, capacity);
+	queue->start();
+	return queue;
+}
+
+extern "C" void parse_queue_push(struct parse_queue *queue, void *job)
+{
+	QMutexLocker lock(&queue->mutex);
+	while ((int)queue->jobs.size() >= queue->capacity)
+		queue->spaceAvailable.wait(&queue->mutex);
+	queue->jobs.push_back(job);
+	queue->jobAvailable.wakeOne();
+}
+
+extern "C" void parse_queue_finish(struct parse_queue *queue)
+{
+	{
+		QMutexLocker lock(&queue->mutex);
+		queue->done = true;
+		queue->jobAvailable.wakeOne();
+	}
+	queue->wait();
+	delete queue;
+}
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef PARSEQUEUE_H
+#define PARSEQUEUE_H
+
+/*
+ * A bounded queue that hands jobs to a worker thread. This is used to
+ * parse the dives of a download while libdivecomputer transfers the
+ * next ones. The jobs are processed in order. If the queue is full,
+ * parse_queue_push() blocks until the worker has caught up.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct parse_queue;
+
+extern struct parse_queue *parse_queue_start(void (*fn)(void *job), int capacity);
+extern void parse_queue_push(struct parse_queue *queue, void *job);
+/* Wait until all jobs were processed and free the queue. */
+extern void parse_queue_finish(struct parse_queue *queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PARSEQUEUE_H
@@ -123,10 +123,17 @@ static bool dive_check_picture_time(const struct dive *d, timestamp_t timestamp)
 struct picture *create_picture(const char *filename, int shift_time, bool match_all, struct dive **dive)
 {
 	struct metadata metadata;
-	timestamp_t timestamp;
 
 	get_metadata(filename, &metadata);
-	timestamp = metadata.timestamp + shift_time;
+	return create_picture_from_metadata(filename, &metadata, shift_time, match_all, dive);
+}
+
+/* As create_picture(), but with the already extracted metadata of the file */
+struct picture *create_picture_from_metadata(const char *filename, const struct metadata *metadata, int shift_time, bool match_all, struct dive **dive)
+{
+	timestamp_t timestamp;
+
+	timestamp = metadata->timestamp + shift_time;
 	*dive = nearest_selected_dive(timestamp);
 
 	if (!*dive)
@@ -138,8 +145,8 @@ struct picture *create_picture(const char *filename, int shift_time, bool match_
 
 	struct picture *picture = malloc(sizeof(struct picture));
 	picture->filename = strdup(filename);
-	picture->offset.seconds = metadata.timestamp - (*dive)->when + shift_time;
-	picture->location = metadata.location;
+	picture->offset.seconds = metadata->timestamp - (*dive)->when + shift_time;
+	picture->location = metadata->location;
 	return picture;
 }
 
@@ -11,6 +11,7 @@ extern "C" {
 #endif
 
 struct dive;
+struct metadata;
 
 struct picture {
 	char *filename;
@@ -47,6 +48,7 @@ extern int get_picture_idx(const struct picture_table *, const char *filename);
 extern void sort_picture_table(struct picture_table *);
 
 extern struct picture *create_picture(const char *filename, int shift_time, bool match_all, struct dive **dive);
+extern struct picture *create_picture_from_metadata(const char *filename, const struct metadata *metadata, int shift_time, bool match_all, struct dive **dive);
 extern bool picture_check_valid_time(timestamp_t timestamp, int shift_time);
 
 #ifdef __cplusplus
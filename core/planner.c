@@ -20,17 +20,18 @@
 #include "gettext.h"
 #include "libdivecomputer/parser.h"
 #include "qthelper.h"
+#include "trace.h"
 #include "version.h"
 
 #define TIMESTEP 2 /* second */
 
-static int decostoplevels_metric[] = { 0, 3000, 6000, 9000, 12000, 15000, 18000, 21000, 24000, 27000,
+static const int decostoplevels_metric[] = { 0, 3000, 6000, 9000, 12000, 15000, 18000, 21000, 24000, 27000,
 					30000, 33000, 36000, 39000, 42000, 45000, 48000, 51000, 54000, 57000,
 					60000, 63000, 66000, 69000, 72000, 75000, 78000, 81000, 84000, 87000,
 					90000, 100000, 110000, 120000, 130000, 140000, 150000, 160000, 170000,
 					180000, 190000, 200000, 220000, 240000, 260000, 280000, 300000,
 					320000, 340000, 360000, 380000 };
-static int decostoplevels_imperial[] = { 0, 3048, 6096, 9144, 12192, 15240, 18288, 21336, 24384, 27432,
+static const int decostoplevels_imperial[] = { 0, 3048, 6096, 9144, 12192, 15240, 18288, 21336, 24384, 27432,
 					30480, 33528, 36576, 39624, 42672, 45720, 48768, 51816, 54864, 57912,
 					60960, 64008, 67056, 70104, 73152, 76200, 79248, 82296, 85344, 88392,
 					91440, 101600, 111760, 121920, 132080, 142240, 152400, 162560, 172720,
@@ -106,15 +107,151 @@ static void interpolate_transition(struct deco_state *ds, struct dive *dive, dur
 		calc_crushing_pressure(ds, depth_to_bar(d1.mm, dive));
 }
 
+/*
+ * The tissue state at the end of the entered waypoints of the last plan. While
+ * the user drags a waypoint, the segments before it stay the same, so the next
+ * plan only has to simulate the dive from the first modified waypoint on.
+ *
+ * Every checkpoint is keyed by a fingerprint of the state tissue_at_end()
+ * started from and of all samples up to it. A plan calls tissue_at_end() with
+ * different starting states (the VPM-B gradients are kept), so the store keeps
+ * all checkpoints that were used or created by the last plan.
+ */
+struct waypoint_checkpoint {
+	int sample;		/* index of the first sample that is not included */
+	uint64_t input_hash;
+	int generation;
+	struct deco_state ds;
+};
+
+struct waypoint_checkpoints {
+	int nr, allocated;
+	int generation;
+	struct waypoint_checkpoint *checkpoints;
+};
+
+struct waypoint_checkpoints *alloc_waypoint_checkpoints(void)
+{
+	return calloc(1, sizeof(struct waypoint_checkpoints));
+}
+
+void free_waypoint_checkpoints(struct waypoint_checkpoints *store)
+{
+	if (!store)
+		return;
+	free(store->checkpoints);
+	free(store);
+}
+
+/* Drop the checkpoints that the last plan didn't use and start a new plan */
+static void next_checkpoint_generation(struct waypoint_checkpoints *store)
+{
+	int i, j;
+
+	if (!store)
+		return;
+	for (i = j = 0; i < store->nr; i++) {
+		if (store->checkpoints[i].generation == store->generation)
+			store->checkpoints[j++] = store->checkpoints[i];
+	}
+	store->nr = j;
+	store->generation++;
+}
+
+static void add_waypoint_checkpoint(struct waypoint_checkpoints *store, int sample, uint64_t input_hash, const struct deco_state *ds)
+{
+	struct waypoint_checkpoint *cp;
+
+	if (store->nr >= store->allocated) {
+		store->allocated = store->allocated ? store->allocated * 2 : 16;
+		store->checkpoints = realloc(store->checkpoints, store->allocated * sizeof(struct waypoint_checkpoint));
+	}
+	cp = store->checkpoints + store->nr++;
+	cp->sample = sample;
+	cp->input_hash = input_hash;
+	cp->generation = store->generation;
+	cp->ds = *ds;
+}
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+	const unsigned char *p = data;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ p[i]) * 1099511628211ull;
+	return hash;
+}
+
+#define HASH_FIELD(hash, field) hash_bytes(hash, &(field), sizeof(field))
+
+/* The starting point of tissue_at_end(). The saturation factors in the deco
+ * state are a pure function of the segment length and therefore not included. */
+static uint64_t hash_tissue_start(const struct deco_state *ds, const struct dive *dive)
+{
+	uint64_t hash = deco_parameters_hash();
+	struct pressure_conversion conv = get_pressure_conversion(dive);
+	bool planner = in_planner();
+
+	hash = HASH_FIELD(hash, planner);
+	hash = HASH_FIELD(hash, conv.surface_mbar);
+	hash = HASH_FIELD(hash, conv.mbar_per_mm);
+	hash = HASH_FIELD(hash, dive->surface_pressure.mbar);
+	hash = HASH_FIELD(hash, ds->tissue_n2_sat);
+	hash = HASH_FIELD(hash, ds->tissue_he_sat);
+	hash = HASH_FIELD(hash, ds->tolerated_by_tissue);
+	hash = HASH_FIELD(hash, ds->tissue_inertgas_saturation);
+	hash = HASH_FIELD(hash, ds->buehlmann_inertgas_a);
+	hash = HASH_FIELD(hash, ds->buehlmann_inertgas_b);
+	hash = HASH_FIELD(hash, ds->max_n2_crushing_pressure);
+	hash = HASH_FIELD(hash, ds->max_he_crushing_pressure);
+	hash = HASH_FIELD(hash, ds->crushing_onset_tension);
+	hash = HASH_FIELD(hash, ds->n2_regen_radius);
+	hash = HASH_FIELD(hash, ds->he_regen_radius);
+	hash = HASH_FIELD(hash, ds->max_ambient_pressure);
+	hash = HASH_FIELD(hash, ds->bottom_n2_gradient);
+	hash = HASH_FIELD(hash, ds->bottom_he_gradient);
+	hash = HASH_FIELD(hash, ds->initial_n2_gradient);
+	hash = HASH_FIELD(hash, ds->initial_he_gradient);
+	hash = HASH_FIELD(hash, ds->first_ceiling_pressure.mbar);
+	hash = HASH_FIELD(hash, ds->max_bottom_ceiling_pressure.mbar);
+	hash = HASH_FIELD(hash, ds->ci_pointing_to_guiding_tissue);
+	hash = HASH_FIELD(hash, ds->gf_low_pressure_this_dive);
+	hash = HASH_FIELD(hash, ds->deco_time);
+	hash = HASH_FIELD(hash, ds->icd_warning);
+	hash = HASH_FIELD(hash, ds->sum1);
+	hash = HASH_FIELD(hash, ds->sumx);
+	hash = HASH_FIELD(hash, ds->sumxx);
+	hash = HASH_FIELD(hash, ds->sumy);
+	hash = HASH_FIELD(hash, ds->sumxy);
+	hash = HASH_FIELD(hash, ds->plot_depth);
+	return hash;
+}
+
+/* What tissue_at_end() simulates for one sample: the segment from the previous sample to it */
+struct tissue_segment {
+	duration_t t0, t1;
+	depth_t d0, d1;
+	struct gasmix gas;
+	o2pressure_t setpoint;
+	enum divemode_t divemode;
+};
+
+static uint64_t hash_tissue_segment(uint64_t hash, const struct tissue_segment *seg)
+{
+	int data[8] = { seg->t0.seconds, seg->t1.seconds, seg->d0.mm, seg->d1.mm,
+			seg->gas.o2.permille, seg->gas.he.permille, seg->setpoint.mbar, seg->divemode };
+	return hash_bytes(hash, data, sizeof(data));
+}
+
 /* returns the tissue tolerance at the end of this (partial) dive */
-static int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_state **cached_datap)
+static int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_state **cached_datap, struct waypoint_checkpoints *store)
 {
 	struct divecomputer *dc;
 	struct sample *sample, *psample;
-	int i;
+	struct tissue_segment *segments;
+	uint64_t *input_hashes;
+	int i, first = 0;
 	depth_t lastdepth = {};
 	duration_t t0 = {}, t1 = {};
-	struct gasmix gas;
 	int surface_interval = 0;
 
 	if (!dive)
@@ -133,18 +270,52 @@ static int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_s
 	const struct event *evdm = NULL;
 	enum divemode_t divemode = UNDEF_COMP_TYPE;
 
+	segments = malloc(dc->samples * sizeof(*segments));
+	input_hashes = malloc((dc->samples + 1) * sizeof(*input_hashes));
+	input_hashes[0] = store ? hash_tissue_start(ds, dive) : 0;
 	for (i = 0; i < dc->samples; i++, sample++) {
-		o2pressure_t setpoint;
+		struct tissue_segment *seg = segments + i;
 
 		if (i)
-			setpoint = sample[-1].setpoint;
+			seg->setpoint = sample[-1].setpoint;
 		else
-			setpoint = sample[0].setpoint;
+			seg->setpoint = sample[0].setpoint;
 
 		t1 = sample->time;
-		gas = get_gasmix_at_time(dive, dc, t0);
+		seg->gas = get_gasmix_at_time(dive, dc, t0);
 		if (i > 0)
 			lastdepth = psample->depth;
+		seg->t0 = t0;
+		seg->t1 = t1;
+		seg->d0 = lastdepth;
+		seg->d1 = sample->depth;
+		seg->divemode = divemode = get_current_divemode(&dive->dc, t0.seconds + 1, &evdm, &divemode);
+		if (store)
+			input_hashes[i + 1] = hash_tissue_segment(input_hashes[i], seg);
+		psample = sample;
+		t0 = t1;
+	}
+
+	/* Continue from the latest checkpoint of an unchanged beginning of the dive */
+	if (store) {
+		struct waypoint_checkpoint *found = NULL;
+
+		for (i = 0; i < store->nr; i++) {
+			struct waypoint_checkpoint *cp = store->checkpoints + i;
+			if (cp->sample > dc->samples || cp->input_hash != input_hashes[cp->sample])
+				continue;
+			cp->generation = store->generation;
+			if (!found || cp->sample > found->sample)
+				found = cp;
+		}
+		if (found) {
+			*ds = found->ds;
+			first = found->sample;
+		}
+	}
+
+	for (i = first; i < dc->samples; i++) {
+		const struct tissue_segment *seg = segments + i;
 
 		/* The ceiling in the deeper portion of a multilevel dive is sometimes critical for the VPM-B
 		 * Boyle's law compensation.  We should check the ceiling prior to ascending during the bottom
@@ -155,12 +326,12 @@ static int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_s
 		 * portion of the dive.
 		 * Remember the value for later.
 		 */
-		if ((decoMode() == VPMB) && (lastdepth.mm > sample->depth.mm)) {
+		if ((decoMode() == VPMB) && (seg->d0.mm > seg->d1.mm)) {
 			pressure_t ceiling_pressure;
-			nuclear_regeneration(ds, t0.seconds);
+			nuclear_regeneration(ds, seg->t0.seconds);
 			vpmb_start_gradient(ds);
 			ceiling_pressure.mbar = depth_to_mbar(deco_allowed_depth(tissue_tolerance_calc(ds, dive,
-													depth_to_bar(lastdepth.mm, dive)),
+													depth_to_bar(seg->d0.mm, dive)),
 										dive->surface_pressure.mbar / 1000.0,
 										dive,
 										1),
@@ -169,11 +340,12 @@ static int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_s
 				ds->max_bottom_ceiling_pressure.mbar = ceiling_pressure.mbar;
 		}
 
-		divemode = get_current_divemode(&dive->dc, t0.seconds + 1, &evdm, &divemode);
-		interpolate_transition(ds, dive, t0, t1, lastdepth, sample->depth, gas, setpoint, divemode);
-		psample = sample;
-		t0 = t1;
+		interpolate_transition(ds, dive, seg->t0, seg->t1, seg->d0, seg->d1, seg->gas, seg->setpoint, seg->divemode);
+		if (store && dc->sample[i].manually_entered)
+			add_waypoint_checkpoint(store, i + 1, input_hashes[i + 1], ds);
 	}
+	free(segments);
+	free(input_hashes);
 	return surface_interval;
 }
 
@@ -234,7 +406,7 @@ static void create_dive_from_plan(struct diveplan *diveplan, struct dive *dive,
 	free_samples(dc);
 	while ((ev = dc->events)) {
 		dc->events = dc->events->next;
-		free(ev);
+		free_event(ev);
 	}
 	dp = diveplan->dp;
 	/* Create first sample at time = 0, not based on dp because
@@ -517,51 +689,45 @@ static void track_ascent_gas(int depth, struct dive *dive, int cylinder_id, int
 }
 
 // Determine whether ascending to the next stop will break the ceiling.  Return true if the ascent is ok, false if it isn't.
-static bool trial_ascent(struct deco_state *ds, int wait_time, int trial_depth, int stoplevel, int avg_depth, int bottom_time, struct gasmix gasmix, int po2, double surface_pressure, struct dive *dive, enum divemode_t divemode)
+// The trial is run on a copy of the deco state, so that the caller's state is left untouched without
+// having to allocate a cache and restore it afterwards.
+static bool trial_ascent(const struct deco_state *ds, int wait_time, int trial_depth, int stoplevel, int avg_depth, int bottom_time, struct gasmix gasmix, int po2, double surface_pressure, struct dive *dive, enum divemode_t divemode)
 {
-
-	bool clear_to_ascend = true;
-	struct deco_state *trial_cache = NULL;
+	struct deco_state trial = *ds;
 
 	// For consistency with other VPM-B implementations, we should not start the ascent while the ceiling is
 	// deeper than the next stop (thus the offgasing during the ascent is ignored).
 	// However, we still need to make sure we don't break the ceiling due to on-gassing during ascent.
-	cache_deco_state(ds, &trial_cache);
 	if (wait_time)
-		add_segment(ds, depth_to_bar(trial_depth, dive),
+		add_segment(&trial, depth_to_bar(trial_depth, dive),
 			    gasmix,
 			    wait_time, po2, divemode, prefs.decosac);
 	if (decoMode() == VPMB) {
-		double tolerance_limit = tissue_tolerance_calc(ds, dive, depth_to_bar(stoplevel, dive));
-		update_regression(ds, dive);
-		if (deco_allowed_depth(tolerance_limit, surface_pressure, dive, 1) > stoplevel) {
-			restore_deco_state(trial_cache, ds, false);
-			free(trial_cache);
+		double tolerance_limit = tissue_tolerance_calc(&trial, dive, depth_to_bar(stoplevel, dive));
+		update_regression(&trial, dive);
+		if (deco_allowed_depth(tolerance_limit, surface_pressure, dive, 1) > stoplevel)
 			return false;
-		}
 	}
 
 	while (trial_depth > stoplevel) {
 		double tolerance_limit;
+		double pressure = depth_to_bar(trial_depth, dive);
 		int deltad = ascent_velocity(trial_depth, avg_depth, bottom_time) * TIMESTEP;
 		if (deltad > trial_depth) /* don't test against depth above surface */
 			deltad = trial_depth;
-		add_segment(ds, depth_to_bar(trial_depth, dive),
+		add_segment(&trial, pressure,
 			    gasmix,
 			    TIMESTEP, po2, divemode, prefs.decosac);
-		tolerance_limit = tissue_tolerance_calc(ds, dive, depth_to_bar(trial_depth, dive));
+		tolerance_limit = tissue_tolerance_calc(&trial, dive, pressure);
 		if (decoMode() == VPMB)
-			update_regression(ds, dive);
+			update_regression(&trial, dive);
 		if (deco_allowed_depth(tolerance_limit, surface_pressure, dive, 1) > trial_depth - deltad) {
 			/* We should have stopped */
-			clear_to_ascend = false;
-			break;
+			return false;
 		}
 		trial_depth -= deltad;
 	}
-	restore_deco_state(trial_cache, ds, false);
-	free(trial_cache);
-	return clear_to_ascend;
+	return true;
 }
 
 /* Determine if there is enough gas for the dive.  Return true if there is enough.
@@ -587,22 +753,33 @@ static bool enough_gas(const struct dive *dive, int current_cylinder)
  * Minimal solution is min + 1, and the solution should be an integer multiple of stepsize.
  * leap is a guess for the maximum but there is no guarantee that leap is an upper limit.
  * So we always test at the upper bundary, not in the middle!
+ *
+ * When the leap is halved, the rounded upper boundary often ends up at the point that
+ * was just found to be clear. Remember that point so the trial ascent isn't repeated.
  */
-static int wait_until(struct deco_state *ds, struct dive *dive, int clock, int min, int leap, int stepsize, int depth, int target_depth, int avg_depth, int bottom_time, struct gasmix gasmix, int po2, double surface_pressure, enum divemode_t divemode)
+static int wait_until(const struct deco_state *ds, struct dive *dive, int clock, int min, int leap, int stepsize, int depth, int target_depth, int avg_depth, int bottom_time, struct gasmix gasmix, int po2, double surface_pressure, enum divemode_t divemode)
 {
-	// When a deco stop exceeds two days, there is something wrong...
-	if (min >= 48 * 3600)
-		return 50 * 3600;
-	// Round min + leap up to the next multiple of stepsize
-	int upper = min + leap + stepsize - 1 - (min + leap - 1) % stepsize;
-	// Is the upper boundary too small?
-	if (!trial_ascent(ds, upper - clock, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, dive, divemode))
-		return wait_until(ds, dive, clock, upper, leap, stepsize, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, divemode);
-
-	if (upper - min <= stepsize)
-		return upper;
-
-	return wait_until(ds, dive, clock, min, leap / 2, stepsize, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, divemode);
+	int last_clear = -1;
+
+	for (;;) {
+		// When a deco stop exceeds two days, there is something wrong...
+		if (min >= 48 * 3600)
+			return 50 * 3600;
+		// Round min + leap up to the next multiple of stepsize
+		int upper = min + leap + stepsize - 1 - (min + leap - 1) % stepsize;
+		// Is the upper boundary too small?
+		if (upper != last_clear &&
+		    !trial_ascent(ds, upper - clock, depth, target_depth, avg_depth, bottom_time, gasmix, po2, surface_pressure, dive, divemode)) {
+			min = upper;
+			continue;
+		}
+		last_clear = upper;
+
+		if (upper - min <= stepsize)
+			return upper;
+
+		leap /= 2;
+	}
 }
 
 static void average_max_depth(struct diveplan *dive, int *avg_depth, int *max_depth)
@@ -631,7 +808,7 @@ static void average_max_depth(struct diveplan *dive, int *avg_depth, int *max_de
 		*avg_depth = *max_depth = 0;
 }
 
-bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, bool is_planner, bool show_disclaimer)
+static bool do_plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, bool is_planner, bool show_disclaimer)
 {
 
 	int bottom_depth;
@@ -640,7 +817,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	bool is_final_plan = true;
 	int bottom_time;
 	int previous_deco_time;
-	struct deco_state *bottom_cache = NULL;
+	struct deco_state bottom_cache;
 	struct sample *sample;
 	int po2;
 	int transitiontime, gi;
@@ -649,8 +826,10 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	int depth;
 	struct gaschanges *gaschanges = NULL;
 	int gaschangenr;
-	int *decostoplevels;
-	int decostoplevelcount;
+	/* A local copy, because the last stop depends on the preferences and
+	 * plans may be calculated in parallel (see computeVariations()) */
+	int decostoplevels[sizeof(decostoplevels_metric) / sizeof(int)];
+	int decostoplevelcount = sizeof(decostoplevels) / sizeof(int);
 	int *stoplevels = NULL;
 	bool stopping = false;
 	bool pendinggaschange = false;
@@ -670,6 +849,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	int decostopcounter = 0;
 	enum divemode_t divemode = dive->dc.divemode;
 
+	next_checkpoint_generation(diveplan->checkpoints);
 	set_gf(diveplan->gflow, diveplan->gfhigh);
 	set_vpmb_conservatism(diveplan->vpmb_conservatism);
 	if (!diveplan->surface_pressure)
@@ -680,13 +860,10 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	create_dive_from_plan(diveplan, dive, is_planner);
 
 	// Do we want deco stop array in metres or feet?
-	if (prefs.units.length == METERS ) {
-		decostoplevels = decostoplevels_metric;
-		decostoplevelcount = sizeof(decostoplevels_metric) / sizeof(int);
-	} else {
-		decostoplevels = decostoplevels_imperial;
-		decostoplevelcount = sizeof(decostoplevels_imperial) / sizeof(int);
-	}
+	if (prefs.units.length == METERS )
+		memcpy(decostoplevels, decostoplevels_metric, sizeof(decostoplevels));
+	else
+		memcpy(decostoplevels, decostoplevels_imperial, sizeof(decostoplevels));
 
 	/* If the user has selected last stop to be at 6m/20', we need to get rid of the 3m/10' stop.
 	 * Otherwise reinstate the last stop 3m/10' stop.
@@ -753,7 +930,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	gi = gaschangenr - 1;
 
 	/* Set tissue tolerance and initial vpmb gradient at start of ascent phase */
-	diveplan->surface_interval = tissue_at_end(ds, dive, cached_datap);
+	diveplan->surface_interval = tissue_at_end(ds, dive, cached_datap, diveplan->checkpoints);
 	nuclear_regeneration(ds, clock);
 	vpmb_start_gradient(ds);
 	if (decoMode() == RECREATIONAL) {
@@ -802,7 +979,8 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 		} while (depth > 0);
 		plan_add_segment(diveplan, clock - previous_point_time, 0, current_cylinder, po2, false, divemode);
 		create_dive_from_plan(diveplan, dive, is_planner);
-		add_plan_to_notes(diveplan, dive, show_disclaimer, error);
+		if (!diveplan->skip_notes)
+			add_plan_to_notes(diveplan, dive, show_disclaimer, error);
 		fixup_dc_duration(&dive->dc);
 
 		free(stoplevels);
@@ -821,7 +999,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	}
 
 	// VPM-B or Buehlmann Deco
-	tissue_at_end(ds, dive, cached_datap);
+	tissue_at_end(ds, dive, cached_datap, diveplan->checkpoints);
 	if ((divemode == CCR || divemode == PSCR) && prefs.dobailout) {
 		divemode = OC;
 		po2 = 0;
@@ -835,7 +1013,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	}
 	previous_deco_time = 100000000;
 	ds->deco_time = 10000000;
-	cache_deco_state(ds, &bottom_cache);  // Lets us make several iterations
+	bottom_cache = *ds;  // Lets us make several iterations
 	bottom_depth = depth;
 	bottom_gi = gi;
 	bottom_gas = gas;
@@ -849,7 +1027,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 			vpmb_next_gradient(ds, ds->deco_time, diveplan->surface_pressure / 1000.0);
 
 		previous_deco_time = ds->deco_time;
-		restore_deco_state(bottom_cache, ds, true);
+		restore_deco_state(&bottom_cache, ds, true);
 
 		depth = bottom_depth;
 		gi = bottom_gi;
@@ -1086,15 +1264,25 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 		plan_add_segment(diveplan, prefs.surface_segment, 0, current_cylinder, 0, false, OC);
 	}
 	create_dive_from_plan(diveplan, dive, is_planner);
-	add_plan_to_notes(diveplan, dive, show_disclaimer, error);
+	if (!diveplan->skip_notes)
+		add_plan_to_notes(diveplan, dive, show_disclaimer, error);
 	fixup_dc_duration(&dive->dc);
 
 	free(stoplevels);
 	free(gaschanges);
-	free(bottom_cache);
 	return decodive;
 }
 
+bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, bool is_planner, bool show_disclaimer)
+{
+	bool ret;
+
+	TRACE_BEGIN("plan");
+	ret = do_plan(ds, diveplan, dive, timestep, decostoptable, cached_datap, is_planner, show_disclaimer);
+	TRACE_END();
+	return ret;
+}
+
 /*
  * Get a value in tenths (so "10.2" == 102, "9" = 90)
  *
@@ -34,6 +34,8 @@ struct diveplan {
 	struct divedatapoint *dp;
 	int eff_gflow, eff_gfhigh;
 	int surface_interval;
+	struct waypoint_checkpoints *checkpoints; /* optional, owned by the caller */
+	bool skip_notes; /* only the stops are needed, e.g. for the variations */
 };
 
 #ifdef __cplusplus
@@ -56,6 +58,8 @@ extern const char *get_planner_disclaimer();
 extern char *get_planner_disclaimer_formatted();
 
 extern void free_dps(struct diveplan *diveplan);
+extern struct waypoint_checkpoints *alloc_waypoint_checkpoints(void);
+extern void free_waypoint_checkpoints(struct waypoint_checkpoints *store);
 extern struct dive *planned_dive;
 extern char *cache_data;
 
@@ -20,6 +20,7 @@
 #include "format.h"
 #include "version.h"
 #include "membuffer.h"
+#include "arena.h"
 
 static int diveplan_duration(struct diveplan *diveplan)
 {
@@ -119,6 +120,11 @@ void add_plan_to_notes(struct diveplan *diveplan, struct dive *dive, bool show_d
 	if (!dp)
 		return;
 
+	/* The notes of the last plan of this dive are a good estimate for the size
+	 * of the new ones, so that the buffer is not grown step by step. */
+	if (dive->notes)
+		make_room(&buf, strlen(dive->notes) + 1);
+
 	if (error) {
 		put_format(&buf, "<span style='color: red;'>%s </span> %s<br/>",
 				translate("gettextFromC", "Warning:"),
@@ -617,7 +623,7 @@ void add_plan_to_notes(struct diveplan *diveplan, struct dive *dive, bool show_d
 	if (o2warning_exist)
 		put_string(&buf, "</div>\n");
 finished:
-	free(dive->notes);
+	arena_free(dive->notes);
 	dive->notes = detach_cstring(&buf);
 #ifdef DEBUG_PLANNER_NOTES
 	printf("<!DOCTYPE html>\n<html>\n\t<head><title>plannernotes</title><meta http-equiv=\"Content-Type\" content=\"text/html; charset=utf-8\"/></head>\n\t<body>\n%s\t</body>\n</html>\n", dive->notes);
@@ -21,6 +21,8 @@
 #include "membuffer.h"
 #include "qthelper.h"
 #include "format.h"
+#include "memusage.h"
+#include "trace.h"
 
 //#define DEBUG_GAS 1
 
@@ -178,54 +180,82 @@ static int get_local_sac(struct plot_info *pi, int idx1, int idx2, struct dive *
 
 	cyl = get_cylinder(dive, index);
 
-	airuse = gas_volume(cyl, a) - gas_volume(cyl, b);
+	airuse = gas_volume_used(cyl, a, b);
 
 	/* milliliters per minute */
 	return lrint(airuse / atm * 60 / duration);
 }
 
 #define HALF_INTERVAL 9 * 30
+
 /*
- * Run the min/max calculations: over a 9 minute interval
- * around the entry point (indices 0, 1, 2 respectively).
+ * Sliding window min/max: for every entry, find the indices of the entries
+ * with the smallest and largest value at most half_interval seconds before
+ * or after it. Of several equal values, the first one is reported.
+ *
+ * The indices of the candidates are kept in two deques, ordered by value,
+ * so every entry is added and removed at most once.
  */
-static void analyze_plot_info_minmax(struct plot_info *pi, int entry_index)
+static void window_minmax(const struct plot_info *pi, int half_interval, int (*value)(const struct plot_data *), int *min, int *max)
 {
-	struct plot_data *plot_entry = pi->entry + entry_index;  // fixed
-	struct plot_data *p = plot_entry;  // moves with 'entry'
-	int start = p->sec - HALF_INTERVAL, end = p->sec + HALF_INTERVAL;
-	int min, max;
-
-	/* Go back 'seconds' in time */
-	while (entry_index > 0) {
-		if (p[-1].sec < start)
-			break;
-		entry_index--;
-		p--;
-	}
+	int nr = pi->nr;
+	int *min_queue = malloc(nr * sizeof(*min_queue));
+	int *max_queue = malloc(nr * sizeof(*max_queue));
+	int min_head = 0, min_tail = 0, max_head = 0, max_tail = 0;
+	int i, next = 0;
+
+	for (i = 0; i < nr; i++) {
+		int start = pi->entry[i].sec - half_interval, end = pi->entry[i].sec + half_interval;
+
+		/* Add the entries that came into the window */
+		for (; next < nr && pi->entry[next].sec <= end; next++) {
+			int v = value(pi->entry + next);
+			while (min_tail > min_head && value(pi->entry + min_queue[min_tail - 1]) > v)
+				min_tail--;
+			min_queue[min_tail++] = next;
+			while (max_tail > max_head && value(pi->entry + max_queue[max_tail - 1]) < v)
+				max_tail--;
+			max_queue[max_tail++] = next;
+		}
 
-	// indices to the min/max entries
-	min = max = entry_index;
+		/* Drop the ones that fell out of it */
+		while (pi->entry[min_queue[min_head]].sec < start)
+			min_head++;
+		while (pi->entry[max_queue[max_head]].sec < start)
+			max_head++;
 
-	/* Then go forward until we hit an entry past the time */
-	while (entry_index < pi->nr) {
-		int time = p->sec;
-		int depth = p->depth;
+		min[i] = min_queue[min_head];
+		max[i] = max_queue[max_head];
+	}
+	free(min_queue);
+	free(max_queue);
+}
 
-		if (time > end)
-			break;
+static int plot_depth(const struct plot_data *entry)
+{
+	return entry->depth;
+}
 
-		if (depth < pi->entry[min].depth)
-			min = entry_index;
-		if (depth > pi->entry[max].depth)
-			max = entry_index;
+/*
+ * Run the min/max calculations: over a 9 minute interval
+ * around the entry point (indices 0, 1, 2 respectively).
+ */
+static void analyze_plot_info_minmax(struct plot_info *pi)
+{
+	int i;
+	int *min, *max;
 
-		p++;
-		entry_index++;
+	if (pi->nr <= 0)
+		return;
+	min = malloc(pi->nr * sizeof(*min));
+	max = malloc(pi->nr * sizeof(*max));
+	window_minmax(pi, HALF_INTERVAL, plot_depth, min, max);
+	for (i = 0; i < pi->nr; i++) {
+		pi->entry[i].min = min[i];
+		pi->entry[i].max = max[i];
 	}
-
-	plot_entry->min = min;
-	plot_entry->max = max;
+	free(min);
+	free(max);
 }
 
 static velocity_t velocity(int speed)
@@ -290,8 +320,7 @@ static void analyze_plot_info(struct plot_info *pi)
 	}
 
 	/* get minmax data */
-	for (i = 0; i < nr; i++)
-		analyze_plot_info_minmax(pi, i);
+	analyze_plot_info_minmax(pi);
 }
 
 /*
@@ -498,12 +527,72 @@ static void insert_entry(struct plot_info *pi, int idx, int time, int depth, int
 	entry->bearing = -1;
 }
 
+/*
+ * Outside of the planner, the tissue state with Bühlmann only depends on the
+ * plot entries before a given point. Therefore, every few minutes of dive time
+ * we save the deco state together with a fingerprint of everything it was
+ * derived from. When the profile is recalculated (e.g. after editing an event
+ * or a sample), the deco information of all entries up to the last checkpoint
+ * with an unchanged fingerprint is copied from the old plot info and the
+ * calculation restarts from there.
+ */
+#define DECO_CHECKPOINT_INTERVAL (5 * 60)
+
+struct deco_checkpoint {
+	int idx;			/* the next entry to process */
+	uint64_t input_hash;		/* fingerprint of the inputs of entries 0..idx-1 */
+	int last_ndl_tts_calc_time;
+	struct deco_state ds;
+};
+
 void free_plot_info_data(struct plot_info *pi)
 {
 	free(pi->entry);
 	free(pi->pressures);
+	free(pi->tissues);
+	free(pi->deco_checkpoints);
 	pi->entry = NULL;
 	pi->pressures = NULL;
+	pi->tissues = NULL;
+	pi->deco_checkpoints = NULL;
+	pi->nr_deco_checkpoints = 0;
+}
+
+/* The memory used by the arrays of a plot info */
+size_t plot_info_size(const struct plot_info *pi)
+{
+	size_t size = 0;
+
+	if (pi->entry)
+		size += pi->nr * sizeof(struct plot_data);
+	if (pi->pressures)
+		size += pi->nr * (size_t)pi->nr_cylinders * sizeof(struct plot_pressure_data);
+	if (pi->tissues)
+		size += pi->nr * sizeof(struct plot_tissue_data);
+	size += pi->nr_deco_checkpoints * sizeof(struct deco_checkpoint);
+	return size;
+}
+
+/* Replace the data of dst by a deep copy of src */
+void copy_plot_info(struct plot_info *dst, const struct plot_info *src)
+{
+	free_plot_info_data(dst);
+	*dst = *src;
+	dst->entry = malloc(sizeof(struct plot_data) * src->nr);
+	memcpy(dst->entry, src->entry, sizeof(struct plot_data) * src->nr);
+	dst->pressures = malloc(sizeof(struct plot_pressure_data) * src->nr_cylinders * src->nr);
+	memcpy(dst->pressures, src->pressures, sizeof(struct plot_pressure_data) * src->nr_cylinders * src->nr);
+	dst->tissues = NULL;
+	if (src->tissues) {
+		dst->tissues = malloc(sizeof(struct plot_tissue_data) * src->nr);
+		memcpy(dst->tissues, src->tissues, sizeof(struct plot_tissue_data) * src->nr);
+	}
+	dst->deco_checkpoints = NULL;
+	if (src->nr_deco_checkpoints) {
+		dst->deco_checkpoints = malloc(sizeof(struct deco_checkpoint) * src->nr_deco_checkpoints);
+		memcpy(dst->deco_checkpoints, src->deco_checkpoints, sizeof(struct deco_checkpoint) * src->nr_deco_checkpoints);
+	}
+	memusage_count_alloc(MEM_PLOT_INFO, plot_info_size(dst));
 }
 
 static void populate_plot_entries(struct dive *dive, struct divecomputer *dc, struct plot_info *pi)
@@ -531,6 +620,7 @@ static void populate_plot_entries(struct dive *dive, struct divecomputer *dc, st
 	pi->pressures = calloc(nr * (size_t)pi->nr_cylinders, sizeof(struct plot_pressure_data));
 	if (!plot_data)
 		return;
+	memusage_count_alloc(MEM_PLOT_INFO, nr * (sizeof(struct plot_data) + pi->nr_cylinders * sizeof(struct plot_pressure_data)));
 	pi->nr = nr;
 	idx = 2; /* the two extra events at the start */
 
@@ -649,11 +739,13 @@ static void populate_plot_entries(struct dive *dive, struct divecomputer *dc, st
  * Calculate the sac rate between the two plot entries 'first' and 'last'.
  *
  * Everything in between has a cylinder pressure for at least some of the cylinders.
+ * 'pressuretime' holds the depth pressure integrated over time from the start of
+ * the dive up to each entry.
  */
-static int sac_between(struct dive *dive, struct plot_info *pi, int first, int last, const bool gases[])
+static int sac_between(struct dive *dive, struct plot_info *pi, const double pressuretime[], int first, int last, const bool gases[])
 {
 	int i, airuse;
-	double pressuretime;
+	double atmminutes;
 
 	if (first == last)
 		return 0;
@@ -671,30 +763,37 @@ static int sac_between(struct dive *dive, struct plot_info *pi, int first, int l
 		a.mbar = get_plot_pressure(pi, first, i);
 		b.mbar = get_plot_pressure(pi, last, i);
 		cyl = get_cylinder(dive, i);
-		cyluse = gas_volume(cyl, a) - gas_volume(cyl, b);
+		cyluse = gas_volume_used(cyl, a, b);
 		if (cyluse > 0)
 			airuse += cyluse;
 	}
 	if (!airuse)
 		return 0;
 
-	/* Calculate depthpressure integrated over time */
-	pressuretime = 0.0;
-	do {
-		struct plot_data *entry = pi->entry + first;
+	/* Turn "atmseconds" into "atmminutes" */
+	atmminutes = (pressuretime[last] - pressuretime[first]) / 60;
+
+	/* SAC = mliter per minute */
+	return lrint(airuse / atmminutes);
+}
+
+/* Depth pressure integrated over time from the start of the dive */
+static double *calculate_pressuretime(struct dive *dive, struct plot_info *pi)
+{
+	double *pressuretime = malloc(pi->nr * sizeof(*pressuretime));
+	if (!pressuretime)
+		exit(1);
+
+	pressuretime[0] = 0.0;
+	for (int i = 1; i < pi->nr; i++) {
+		struct plot_data *entry = pi->entry + i - 1;
 		struct plot_data *next = entry + 1;
 		int depth = (entry->depth + next->depth) / 2;
 		int time = next->sec - entry->sec;
-		double atm = depth_to_atm(depth, dive);
-
-		pressuretime += atm * time;
-	} while (++first < last);
-
-	/* Turn "atmseconds" into "atmminutes" */
-	pressuretime /= 60;
 
-	/* SAC = mliter per minute */
-	return lrint(airuse / pressuretime);
+		pressuretime[i] = pressuretime[i - 1] + depth_to_atm(depth, dive) * time;
+	}
+	return pressuretime;
 }
 
 /* Is there pressure data for all gases? */
@@ -702,6 +801,8 @@ static bool all_pressures(struct plot_info *pi, int idx, const bool gases[])
 {
 	int i;
 
+	if (idx >= pi->nr)
+		return false;
 	for (i = 0; i < pi->nr_cylinders; i++) {
 		if (gases[i] && !get_plot_pressure(pi, idx, i))
 			return false;
@@ -725,64 +826,103 @@ static bool filter_pressures(struct plot_info *pi, int idx, const bool gases_in[
 }
 
 /*
- * Try to do the momentary sac rate for this entry, averaging over one
- * minute. This is premature optimization, but instead of allocating
- * an array of gases, the caller passes in scratch memory in the last
- * argument.
+ * The momentary sac rate of an entry is averaged over the minute starting
+ * at most 30 seconds before it. The window ends at the surface and where
+ * the cylinder pressure data set changes.
+ *
+ * The entries are visited in order and, as long as the set of gases stays
+ * the same, the boundaries of the window only move forward. Thus they are
+ * kept from entry to entry instead of being searched for every entry.
+ */
+struct sac_window {
+	bool valid;		/* false: the window must be searched from scratch */
+	bool *gases;		/* the gases the window is valid for */
+	int prev;		/* the entry the window was calculated for */
+	int first_time;		/* first entry not more than 30 seconds before the current one */
+	int first, last;	/* the window */
+	int last_time;		/* last entry not more than a minute after 'first' */
+	int end;		/* all entries in ('first', 'end') may be part of the window */
+};
+
+static bool both_at_surface(struct plot_info *pi, int idx)
+{
+	return pi->entry[idx - 1].depth < SURFACE_THRESHOLD && pi->entry[idx].depth < SURFACE_THRESHOLD;
+}
+
+/* Can the window that ends at 'idx' be extended to 'idx - 1'? */
+static bool can_extend_back(struct plot_info *pi, int idx, const bool gases[])
+{
+	return !both_at_surface(pi, idx) && all_pressures(pi, idx - 1, gases);
+}
+
+/* Can the window that ends at 'idx - 1' be extended to 'idx'? */
+static bool can_extend_forward(struct plot_info *pi, int idx, const bool gases[])
+{
+	return !both_at_surface(pi, idx) && all_pressures(pi, idx + 1, gases);
+}
+
+static void update_sac_window(struct plot_info *pi, struct sac_window *w, int idx, const bool gases[])
+{
+	int nr = pi->nr;
+
+	while (pi->entry[w->first_time].sec < pi->entry[idx].sec - 30)
+		w->first_time++;
+
+	if (w->valid && w->prev == idx - 1 && !memcmp(w->gases, gases, pi->nr_cylinders * sizeof(*gases))) {
+		if (!can_extend_back(pi, idx, gases))
+			w->first = idx;
+		else if (w->first < w->first_time)
+			w->first = w->first_time;
+	} else {
+		w->first = idx;
+		while (w->first > w->first_time && can_extend_back(pi, w->first, gases))
+			w->first--;
+		w->last_time = w->first;
+		w->end = w->first + 1;
+		memcpy(w->gases, gases, pi->nr_cylinders * sizeof(*gases));
+		w->valid = true;
+	}
+	w->prev = idx;
+
+	if (w->last_time < w->first)
+		w->last_time = w->first;
+	while (w->last_time + 1 < nr && pi->entry[w->last_time + 1].sec <= pi->entry[w->first].sec + 60)
+		w->last_time++;
+	if (w->end <= w->first)
+		w->end = w->first + 1;
+	while (w->end <= w->last_time && can_extend_forward(pi, w->end, gases))
+		w->end++;
+	w->last = MIN(w->end - 1, w->last_time);
+}
+
+/*
+ * Try to do the momentary sac rate for this entry. This is premature
+ * optimization, but instead of allocating an array of gases, the caller
+ * passes in scratch memory in the last argument.
  */
-static void fill_sac(struct dive *dive, struct plot_info *pi, int idx, const bool gases_in[], bool gases[])
+static void fill_sac(struct dive *dive, struct plot_info *pi, const double pressuretime[], struct sac_window *w,
+		     int idx, const bool gases_in[], bool gases[])
 {
 	struct plot_data *entry = pi->entry + idx;
-	int first, last;
-	int time;
 
-	if (entry->sac)
+	if (entry->sac) {
+		w->valid = false;
 		return;
+	}
 
 	/*
 	 * We may not have pressure data for all the cylinders,
 	 * but we'll calculate the SAC for the ones we do have.
 	 */
-	if (!filter_pressures(pi, idx, gases_in, gases))
+	if (!filter_pressures(pi, idx, gases_in, gases)) {
+		w->valid = false;
 		return;
-
-	/*
-	 * Try to go back 30 seconds to get 'first'.
-	 * Stop if the cylinder pressure data set changes.
-	 */
-	first = idx;
-	time = entry->sec - 30;
-	while (idx > 0) {
-		struct plot_data *entry = pi->entry + idx;
-		struct plot_data *prev = pi->entry + idx - 1;
-
-		if (prev->depth < SURFACE_THRESHOLD && entry->depth < SURFACE_THRESHOLD)
-			break;
-		if (prev->sec < time)
-			break;
-		if (!all_pressures(pi, idx - 1, gases))
-			break;
-		idx--;
-		first = idx;
 	}
 
-	/* Now find an entry a minute after the first one */
-	last = first;
-	time = pi->entry[first].sec + 60;
-	while (++idx < pi->nr) {
-		struct plot_data *entry = pi->entry + last;
-		struct plot_data *next = pi->entry + last + 1;
-		if (next->depth < SURFACE_THRESHOLD && entry->depth < SURFACE_THRESHOLD)
-			break;
-		if (next->sec > time)
-			break;
-		if (!all_pressures(pi, idx + 1, gases))
-			break;
-		last = idx;
-	}
+	update_sac_window(pi, w, idx, gases);
 
 	/* Ok, now calculate the SAC between 'first' and 'last' */
-	entry->sac = sac_between(dive, pi, first, last, gases);
+	entry->sac = sac_between(dive, pi, pressuretime, w->first, w->last, gases);
 }
 
 /*
@@ -807,6 +947,8 @@ static void calculate_sac(struct dive *dive, struct divecomputer *dc, struct plo
 	/* This might be premature optimization, but let's allocate the gas array for
 	 * the fill_sac function only once an not once per sample */
 	gases_scratch = malloc(pi->nr_cylinders * sizeof(*gases));
+	struct sac_window window = { false, malloc(pi->nr_cylinders * sizeof(*gases)), -1, 0, 0, 0, 0, 0 };
+	double *pressuretime = calculate_pressuretime(dive, pi);
 
 	for (int i = 0; i < pi->nr; i++) {
 		struct plot_data *entry = pi->entry + i;
@@ -816,9 +958,11 @@ static void calculate_sac(struct dive *dive, struct divecomputer *dc, struct plo
 			matching_gases(dive, newmix, gases);
 		}
 
-		fill_sac(dive, pi, i, gases, gases_scratch);
+		fill_sac(dive, pi, pressuretime, &window, i, gases, gases_scratch);
 	}
 
+	free(pressuretime);
+	free(window.gases);
 	free(gases);
 	free(gases_scratch);
 }
@@ -1021,14 +1165,146 @@ static void calculate_ndl_tts(struct deco_state *ds, const struct dive *dive, st
 	}
 }
 
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+	const unsigned char *p = data;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ p[i]) * 1099511628211ull;
+	return hash;
+}
+
+/* Everything the deco calculation depends on apart from the plot entries */
+static uint64_t hash_deco_parameters(const struct deco_state *ds, const struct dive *dive, double surface_pressure, bool print_mode)
+{
+	uint64_t hash = deco_parameters_hash();
+	int mbar[2] = { depth_to_mbar(0, dive), depth_to_mbar(10000, dive) };
+
+	hash = hash_bytes(hash, &prefs, sizeof(prefs));
+	hash = hash_bytes(hash, &surface_pressure, sizeof(surface_pressure));
+	hash = hash_bytes(hash, mbar, sizeof(mbar));
+	hash = hash_bytes(hash, &print_mode, sizeof(print_mode));
+	hash = hash_bytes(hash, ds->tissue_n2_sat, sizeof(ds->tissue_n2_sat));
+	hash = hash_bytes(hash, ds->tissue_he_sat, sizeof(ds->tissue_he_sat));
+	hash = hash_bytes(hash, &ds->gf_low_pressure_this_dive, sizeof(ds->gf_low_pressure_this_dive));
+	return hash;
+}
+
+static uint64_t hash_deco_input(uint64_t hash, const struct plot_data *entry, struct gasmix gasmix, enum divemode_t divemode)
+{
+	int data[8] = { entry->sec, entry->depth, entry->o2pressure.mbar, entry->sac, entry->running_sum,
+			gasmix.o2.permille, gasmix.he.permille, divemode };
+	return hash_bytes(hash, data, sizeof(data));
+}
+
+static void copy_deco_results(struct plot_info *pi, const struct plot_info *prev, int idx)
+{
+	struct plot_data *dst = pi->entry + idx;
+	const struct plot_data *src = prev->entry + idx;
+
+	dst->ambpressure = src->ambpressure;
+	dst->gfline = src->gfline;
+	dst->icd_warning = src->icd_warning;
+	dst->ceiling = src->ceiling;
+	if (pi->tissues)
+		pi->tissues[idx] = prev->tissues[idx];
+	dst->surface_gf = src->surface_gf;
+	dst->current_gf = src->current_gf;
+	dst->in_deco_calc = src->in_deco_calc;
+	dst->ndl_calc = src->ndl_calc;
+	dst->tts_calc = src->tts_calc;
+	dst->stoptime_calc = src->stoptime_calc;
+	dst->stopdepth_calc = src->stopdepth_calc;
+}
+
+static void add_deco_checkpoint(struct plot_info *pi, int *alloc, int idx, uint64_t input_hash,
+				int last_ndl_tts_calc_time, const struct deco_state *ds)
+{
+	struct deco_checkpoint *cp;
+
+	if (pi->nr_deco_checkpoints >= *alloc) {
+		*alloc = *alloc ? *alloc * 2 : 16;
+		pi->deco_checkpoints = realloc(pi->deco_checkpoints, *alloc * sizeof(struct deco_checkpoint));
+	}
+	cp = pi->deco_checkpoints + pi->nr_deco_checkpoints++;
+	cp->idx = idx;
+	cp->input_hash = input_hash;
+	cp->last_ndl_tts_calc_time = last_ndl_tts_calc_time;
+	cp->ds = *ds;
+}
+
+/*
+ * With Bühlmann, the simulated ascents of calculate_ndl_tts() only depend on a
+ * copy of the deco state at the given entry. They are therefore queued during
+ * the tissue pass and calculated in parallel, a window of entries at a time to
+ * bound the memory used by the saved deco states.
+ */
+#define NDL_TTS_WINDOW 64
+
+struct ndl_tts_job {
+	struct plot_data *entry;
+	struct gasmix gasmix;
+	enum divemode_t divemode;
+	struct deco_state ds;
+};
+
+struct ndl_tts_jobs {
+	const struct dive *dive;
+	double surface_pressure;
+	int nr;
+	struct ndl_tts_job job[NDL_TTS_WINDOW];
+};
+
+static void calculate_one_ndl_tts(int idx, void *data)
+{
+	struct ndl_tts_jobs *jobs = data;
+	struct ndl_tts_job *job = jobs->job + idx;
+	calculate_ndl_tts(&job->ds, jobs->dive, job->entry, job->gasmix, jobs->surface_pressure, job->divemode);
+}
+
+static void flush_ndl_tts_jobs(struct ndl_tts_jobs *jobs)
+{
+	run_in_parallel(jobs->nr, calculate_one_ndl_tts, jobs);
+	jobs->nr = 0;
+}
+
+static void queue_ndl_tts_job(struct ndl_tts_jobs *jobs, struct plot_data *entry, const struct deco_state *ds,
+			      struct gasmix gasmix, enum divemode_t divemode)
+{
+	struct ndl_tts_job *job;
+
+	if (jobs->nr >= NDL_TTS_WINDOW)
+		flush_ndl_tts_jobs(jobs);
+	job = jobs->job + jobs->nr++;
+	job->entry = entry;
+	job->gasmix = gasmix;
+	job->divemode = divemode;
+	job->ds = *ds;
+}
+
 /* Let's try to do some deco calculations.
+ * If prev is given, the results of that plot info are reused as far as they are
+ * still valid. prev must not be pi.
  */
-void calculate_deco_information(struct deco_state *ds, const struct deco_state *planner_ds, const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi, bool print_mode)
+void calculate_deco_information(struct deco_state *ds, const struct deco_state *planner_ds, const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi, bool print_mode, const struct plot_info *prev)
 {
 	int i, count_iteration = 0;
 	double surface_pressure = (dc->surface_pressure.mbar ? dc->surface_pressure.mbar : get_surface_pressure_in_mbar(dive, true)) / 1000.0;
 	bool first_iteration = true;
 	int prev_deco_time = 10000000, time_deep_ceiling = 0;
+	struct gasmix *gasmixes;
+	enum divemode_t *divemodes;
+	uint64_t *input_hashes = NULL;
+	bool use_checkpoints;
+	int start = 1, checkpoint_alloc = 0, next_checkpoint_time = INT_MIN, resume_ndl_tts_calc_time = 0;
+	struct ndl_tts_jobs *ndl_tts_jobs = NULL;
+	bool *copy_ndl_tts = NULL;
+	struct pressure_conversion conv = get_pressure_conversion(dive);
+
+	free(pi->deco_checkpoints);
+	pi->deco_checkpoints = NULL;
+	pi->nr_deco_checkpoints = 0;
+	if (pi->nr <= 0)
+		return;
 
 	if (!in_planner() || !planner_ds) {
 		ds->deco_time = 0;
@@ -1038,30 +1314,86 @@ void calculate_deco_information(struct deco_state *ds, const struct deco_state *
 		ds->first_ceiling_pressure = planner_ds->first_ceiling_pressure;
 	}
 	struct deco_state *cache_data_initial = NULL;
-	lock_planner();
+	lock_planner_shared();
+	use_checkpoints = decoMode() != VPMB && !in_planner();
+
+	/* The gas and dive mode at every entry don't change between iterations */
+	gasmixes = malloc(pi->nr * sizeof(*gasmixes));
+	divemodes = malloc(pi->nr * sizeof(*divemodes));
+	gasmixes[0] = gasmix_invalid;
+	divemodes[0] = UNDEF_COMP_TYPE;
+	{
+		struct gasmix gasmix = gasmix_invalid;
+		const struct event *ev = NULL, *evd = NULL;
+		enum divemode_t current_divemode = UNDEF_COMP_TYPE;
+
+		for (i = 1; i < pi->nr; i++) {
+			current_divemode = get_current_divemode(dc, pi->entry[i].sec, &evd, &current_divemode);
+			gasmix = get_gasmix(dive, dc, pi->entry[i].sec, &ev, gasmix);
+			divemodes[i] = current_divemode;
+			gasmixes[i] = gasmix;
+		}
+	}
+
+	if (use_checkpoints) {
+		input_hashes = malloc(pi->nr * sizeof(*input_hashes));
+		input_hashes[0] = hash_deco_parameters(ds, dive, surface_pressure, print_mode);
+		for (i = 1; i < pi->nr; i++)
+			input_hashes[i] = hash_deco_input(input_hashes[i - 1], pi->entry + i - 1, gasmixes[i - 1], divemodes[i - 1]);
+
+		/* Find the last checkpoint of the previous calculation that is still valid.
+		 * Its entry must not have been the last one, which is treated specially. */
+		if (prev && prev != pi && (prev->tissues || !pi->tissues)) {
+			for (i = 0; i < prev->nr_deco_checkpoints; i++) {
+				const struct deco_checkpoint *cp = prev->deco_checkpoints + i;
+				if (cp->idx >= prev->nr - 1 || cp->idx >= pi->nr - 1 || cp->input_hash != input_hashes[cp->idx])
+					break;
+				add_deco_checkpoint(pi, &checkpoint_alloc, cp->idx, cp->input_hash, cp->last_ndl_tts_calc_time, &cp->ds);
+			}
+		}
+		if (pi->nr_deco_checkpoints > 0) {
+			const struct deco_checkpoint *cp = pi->deco_checkpoints + pi->nr_deco_checkpoints - 1;
+			start = cp->idx;
+			resume_ndl_tts_calc_time = cp->last_ndl_tts_calc_time;
+			next_checkpoint_time = pi->entry[start].sec + DECO_CHECKPOINT_INTERVAL;
+			*ds = cp->ds;
+			for (i = 1; i < start; i++)
+				copy_deco_results(pi, prev, i);
+		}
+	}
+
 	/* For VPM-B outside the planner, cache the initial deco state for CVA iterations */
 	if (decoMode() == VPMB) {
 		cache_deco_state(ds, &cache_data_initial);
+	} else {
+		/* With VPM-B, the simulated ascent modifies the gradients of the deco state,
+		 * so parallel NDL/TTS calculation is only possible for Bühlmann. */
+		ndl_tts_jobs = malloc(sizeof(*ndl_tts_jobs));
+		ndl_tts_jobs->dive = dive;
+		ndl_tts_jobs->surface_pressure = surface_pressure;
+		ndl_tts_jobs->nr = 0;
+		copy_ndl_tts = calloc(pi->nr, sizeof(*copy_ndl_tts));
 	}
 	/* For VPM-B outside the planner, iterate until deco time converges (usually one or two iterations after the initial)
 	 * Set maximum number of iterations to 10 just in case */
 
 	while ((abs(prev_deco_time - ds->deco_time) >= 30) && (count_iteration < 10)) {
-		int last_ndl_tts_calc_time = 0, first_ceiling = 0, current_ceiling, last_ceiling = 0, final_tts = 0 , time_clear_ceiling = 0;
+		int last_ndl_tts_calc_time = resume_ndl_tts_calc_time, first_ceiling = 0, current_ceiling, last_ceiling = 0, final_tts = 0 , time_clear_ceiling = 0;
 		if (decoMode() == VPMB)
 			ds->first_ceiling_pressure.mbar = depth_to_mbar(first_ceiling, dive);
-		struct gasmix gasmix = gasmix_invalid;
-		const struct event *ev = NULL, *evd = NULL;
-		enum divemode_t current_divemode = UNDEF_COMP_TYPE;
 
-		for (i = 1; i < pi->nr; i++) {
+		for (i = start; i < pi->nr; i++) {
 			struct plot_data *entry = pi->entry + i;
 			int j, t0 = (entry - 1)->sec, t1 = entry->sec;
 			int time_stepsize = 20;
+			struct gasmix gasmix = gasmixes[i];
+			enum divemode_t current_divemode = divemodes[i];
 
-			current_divemode = get_current_divemode(dc, entry->sec, &evd, &current_divemode);
-			gasmix = get_gasmix(dive, dc, t1, &ev, gasmix);
-			entry->ambpressure = depth_to_bar(entry->depth, dive);
+			if (use_checkpoints && entry->sec >= next_checkpoint_time) {
+				add_deco_checkpoint(pi, &checkpoint_alloc, i, input_hashes[i], last_ndl_tts_calc_time, ds);
+				next_checkpoint_time = entry->sec + DECO_CHECKPOINT_INTERVAL;
+			}
+			entry->ambpressure = conv_depth_to_bar(&conv, entry->depth);
 			entry->gfline = get_gf(ds, entry->ambpressure, dive) * (100.0 - AMB_PERCENTAGE) + AMB_PERCENTAGE;
 			if (t0 > t1) {
 				SSRF_INFO("non-monotonous dive stamps %d %d\n", t0, t1);
@@ -1073,7 +1405,7 @@ void calculate_deco_information(struct deco_state *ds, const struct deco_state *
 				time_stepsize = t1 - t0;
 			for (j = t0 + time_stepsize; j <= t1; j += time_stepsize) {
 				int depth = interpolate(entry[-1].depth, entry[0].depth, j - t0, t1 - t0);
-				add_segment(ds, depth_to_bar(depth, dive),
+				add_segment(ds, conv_depth_to_bar(&conv, depth),
 					    gasmix, time_stepsize, entry->o2pressure.mbar, current_divemode, entry->sac);
 				entry->icd_warning = ds->icd_warning;
 				if ((t1 - j < time_stepsize) && (j < t1))
@@ -1090,9 +1422,9 @@ void calculate_deco_information(struct deco_state *ds, const struct deco_state *
 					if (!first_iteration || in_planner())
 						vpmb_next_gradient(ds, ds->deco_time, surface_pressure / 1000.0);
 				}
-				entry->ceiling = deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, !prefs.calcceiling3m);
+				entry->ceiling = deco_allowed_depth(tissue_tolerance_calc(ds, dive, entry->ambpressure), surface_pressure, dive, !prefs.calcceiling3m);
 				if (prefs.calcceiling3m)
-					current_ceiling = deco_allowed_depth(tissue_tolerance_calc(ds, dive, depth_to_bar(entry->depth, dive)), surface_pressure, dive, true);
+					current_ceiling = deco_allowed_depth(tissue_tolerance_calc(ds, dive, entry->ambpressure), surface_pressure, dive, true);
 				else
 					current_ceiling = entry->ceiling;
 				last_ceiling = current_ceiling;
@@ -1126,11 +1458,14 @@ void calculate_deco_information(struct deco_state *ds, const struct deco_state *
 			for (j = 0; j < 16; j++) {
 				double m_value = ds->buehlmann_inertgas_a[j] + entry->ambpressure / ds->buehlmann_inertgas_b[j];
 				double surface_m_value = ds->buehlmann_inertgas_a[j] + surface_pressure / ds->buehlmann_inertgas_b[j];
-				entry->ceilings[j] = deco_allowed_depth(ds->tolerated_by_tissue[j], surface_pressure, dive, 1);
 				double current_gf = (ds->tissue_inertgas_saturation[j] - entry->ambpressure) / (m_value - entry->ambpressure);
-				entry->percentages[j] = ds->tissue_inertgas_saturation[j] < entry->ambpressure ?
-					lrint(ds->tissue_inertgas_saturation[j] / entry->ambpressure * AMB_PERCENTAGE) :
-					lrint(AMB_PERCENTAGE + current_gf * (100.0 - AMB_PERCENTAGE));
+				if (pi->tissues) {
+					struct plot_tissue_data *tissues = pi->tissues + i;
+					tissues->ceilings[j] = deco_allowed_depth(ds->tolerated_by_tissue[j], surface_pressure, dive, 1);
+					tissues->percentages[j] = ds->tissue_inertgas_saturation[j] < entry->ambpressure ?
+						lrint(ds->tissue_inertgas_saturation[j] / entry->ambpressure * AMB_PERCENTAGE) :
+						lrint(AMB_PERCENTAGE + current_gf * (100.0 - AMB_PERCENTAGE));
+				}
 				if (current_gf > entry->current_gf)
 					entry->current_gf = current_gf;
 				double surface_gf = 100.0 * (ds->tissue_inertgas_saturation[j] - surface_pressure) / (surface_m_value - surface_pressure);
@@ -1146,6 +1481,11 @@ void calculate_deco_information(struct deco_state *ds, const struct deco_state *
 			    (decoMode() == VPMB && !in_planner() && i == pi->nr - 1)) {
 				/* only calculate ndl/tts on every 30 seconds */
 				if ((entry->sec - last_ndl_tts_calc_time) < 30 && i != pi->nr - 1) {
+					/* The previous entry may not be calculated yet, copy it below */
+					if (ndl_tts_jobs) {
+						copy_ndl_tts[i] = true;
+						continue;
+					}
 					struct plot_data *prev_entry = (entry - 1);
 					entry->stoptime_calc = prev_entry->stoptime_calc;
 					entry->stopdepth_calc = prev_entry->stopdepth_calc;
@@ -1155,15 +1495,31 @@ void calculate_deco_information(struct deco_state *ds, const struct deco_state *
 				}
 				last_ndl_tts_calc_time = entry->sec;
 
+				if (ndl_tts_jobs) {
+					queue_ndl_tts_job(ndl_tts_jobs, entry, ds, gasmix, current_divemode);
+					continue;
+				}
+
 				/* We are going to mess up deco state, so store it for later restore */
-				struct deco_state *cache_data = NULL;
-				cache_deco_state(ds, &cache_data);
+				struct deco_state cache_data = *ds;
 				calculate_ndl_tts(ds, dive, entry, gasmix, surface_pressure, current_divemode);
 				if (decoMode() == VPMB && !in_planner() && i == pi->nr - 1)
 					final_tts = entry->tts_calc;
 				/* Restore "real" deco state for next real time step */
-				restore_deco_state(cache_data, ds, decoMode() == VPMB);
-				free(cache_data);
+				restore_deco_state(&cache_data, ds, decoMode() == VPMB);
+			}
+		}
+		if (ndl_tts_jobs) {
+			flush_ndl_tts_jobs(ndl_tts_jobs);
+			for (i = start; i < pi->nr; i++) {
+				if (copy_ndl_tts[i]) {
+					struct plot_data *entry = pi->entry + i;
+					struct plot_data *prev_entry = (entry - 1);
+					entry->stoptime_calc = prev_entry->stoptime_calc;
+					entry->stopdepth_calc = prev_entry->stopdepth_calc;
+					entry->tts_calc = prev_entry->tts_calc;
+					entry->ndl_calc = prev_entry->ndl_calc;
+				}
 			}
 		}
 		if (decoMode() == VPMB && !in_planner()) {
@@ -1193,6 +1549,11 @@ void calculate_deco_information(struct deco_state *ds, const struct deco_state *
 		}
 	}
 
+	free(gasmixes);
+	free(divemodes);
+	free(input_hashes);
+	free(ndl_tts_jobs);
+	free(copy_ndl_tts);
 	free(cache_data_initial);
 #if DECO_CALC_DEBUG & 1
 	dump_tissues(ds);
@@ -1251,20 +1612,21 @@ static void calculate_gas_information_new(struct dive *dive, struct divecomputer
 	struct gasmix gasmix = gasmix_invalid;
 	const struct event *evg = NULL, *evd = NULL;
 	enum divemode_t current_divemode = UNDEF_COMP_TYPE;
+	struct pressure_conversion conv = get_pressure_conversion(dive);
 
 	for (i = 1; i < pi->nr; i++) {
 		int fn2, fhe;
 		struct plot_data *entry = pi->entry + i;
 
 		gasmix = get_gasmix(dive, dc, entry->sec, &evg, gasmix);
-		amb_pressure = depth_to_bar(entry->depth, dive);
+		amb_pressure = conv_depth_to_bar(&conv, entry->depth);
 		current_divemode = get_current_divemode(dc, entry->sec, &evd, &current_divemode);
 		fill_pressures(&entry->pressures, amb_pressure, gasmix, (current_divemode == OC) ? 0.0 : entry->o2pressure.mbar / 1000.0, current_divemode);
 		fn2 = (int)(1000.0 * entry->pressures.n2 / amb_pressure);
 		fhe = (int)(1000.0 * entry->pressures.he / amb_pressure);
 		if (dc->divemode == PSCR) { // OC pO2 is calulated for PSCR with or without external PO2 monitoring.
 			struct gasmix gasmix2 = get_gasmix(dive, dc, entry->sec, &evg, gasmix);
-			entry->scr_OC_pO2.mbar = (int) depth_to_mbar(entry->depth, dive) * get_o2(gasmix2) / 1000;
+			entry->scr_OC_pO2.mbar = (int) conv_depth_to_mbar(&conv, entry->depth) * get_o2(gasmix2) / 1000;
 		}
 
 		/* Calculate MOD, EAD, END and EADD based on partial pressures calculated before
@@ -1368,18 +1730,45 @@ void init_plot_info(struct plot_info *pi)
  * sides, so that you can do end-points without having to worry
  * about it.
  *
+ * The ceilings and saturations of the individual tissues are only
+ * calculated if "tissues" is true.
+ *
  * The old data will be freed. Before the first call, the plot
  * info must be initialized with init_plot_info().
  */
-void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, const struct deco_state *planner_ds)
+void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, bool tissues, const struct deco_state *planner_ds)
 {
-	int o2, he, o2max;
+	TRACE_BEGIN("create_plot_info_new");
 #ifndef SUBSURFACE_MOBILE
 	struct deco_state plot_deco_state;
 	init_decompression(&plot_deco_state, dive);
+	create_plot_info_from_deco_state(dive, dc, pi, fast, tissues, &plot_deco_state, planner_ds);
 #else
+	create_plot_info_from_deco_state(dive, dc, pi, fast, tissues, NULL, planner_ds);
+#endif
+	TRACE_END();
+}
+
+/*
+ * Like create_plot_info_new(), but start the deco calculation with the tissue
+ * state ds as calculated by init_decompression(). Unlike init_decompression(),
+ * this doesn't look at other dives. It may therefore be called on a copy of a
+ * dive in a worker thread, provided that the samples of the dive were loaded.
+ */
+void create_plot_info_from_deco_state(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, bool tissues,
+				      struct deco_state *ds, const struct deco_state *planner_ds)
+{
+	int o2, he, o2max;
+#ifdef SUBSURFACE_MOBILE
+	UNUSED(ds);
 	UNUSED(planner_ds);
 #endif
+	load_samples(dive);
+	/* Keep the old deco information, calculate_deco_information() may be able to reuse it */
+	struct plot_info prev = *pi;
+	pi->entry = NULL;
+	pi->tissues = NULL;
+	pi->deco_checkpoints = NULL;
 	free_plot_info_data(pi);
 	calculate_max_limits_new(dive, dc, pi);
 	get_dive_gas(dive, &o2, &he, &o2max);
@@ -1395,6 +1784,10 @@ void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plo
 	}
 
 	populate_plot_entries(dive, dc, pi);
+	if (tissues) {
+		pi->tissues = calloc(pi->nr, sizeof(*pi->tissues));
+		memusage_count_alloc(MEM_PLOT_INFO, pi->nr * sizeof(*pi->tissues));
+	}
 
 	check_setpoint_events(dive, dc, pi);     /* Populate setpoints */
 	setup_gas_sensor_pressure(dive, dc, pi); /* Try to populate our gas pressure knowledge */
@@ -1405,8 +1798,10 @@ void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plo
 	fill_o2_values(dive, dc, pi);			 /* .. and insert the O2 sensor data having 0 values. */
 	calculate_sac(dive, dc, pi);			 /* Calculate sac */
 #ifndef SUBSURFACE_MOBILE
-	calculate_deco_information(&plot_deco_state, planner_ds, dive, dc, pi, false); /* and ceiling information, using gradient factor values in Preferences) */
+	calculate_deco_information(ds, planner_ds, dive, dc, pi, false, &prev); /* and ceiling information, using gradient factor values in Preferences) */
 #endif
+	prev.pressures = NULL;
+	free_plot_info_data(&prev);
 	calculate_gas_information_new(dive, dc, pi);	 /* Calculate gas partial pressures */
 
 #ifdef DEBUG_GAS
@@ -1559,11 +1954,12 @@ static void plot_string(const struct plot_info *pi, int idx, struct membuffer *b
 		if (entry->ceiling) {
 			depthvalue = get_depth_units(entry->ceiling, NULL, &depth_unit);
 			put_format_loc(b, translate("gettextFromC", "Calculated ceiling %.0f%s\n"), depthvalue, depth_unit);
-			if (prefs.calcalltissues) {
+			if (prefs.calcalltissues && pi->tissues) {
+				const struct plot_tissue_data *tissues = pi->tissues + idx;
 				int k;
 				for (k = 0; k < 16; k++) {
-					if (entry->ceilings[k]) {
-						depthvalue = get_depth_units(entry->ceilings[k], NULL, &depth_unit);
+					if (tissues->ceilings[k]) {
+						depthvalue = get_depth_units(tissues->ceilings[k], NULL, &depth_unit);
 						put_format_loc(b, translate("gettextFromC", "Tissue %.0fmin: %.1f%s\n"), buehlmann_N2_t_halflife[k], depthvalue, depth_unit);
 					}
 				}
@@ -1584,95 +1980,193 @@ static void plot_string(const struct plot_info *pi, int idx, struct membuffer *b
 	strip_mb(b);
 }
 
-int get_plot_details_new(const struct plot_info *pi, int time, struct membuffer *mb)
+/*
+ * The index of the first plot entry at or after the given time, clamped
+ * to the range of entries with useful data; or 0 if there is none.
+ */
+int get_plot_details_index(const struct plot_info *pi, int time)
 {
-	int i;
+	int lo, hi;
 
 	/* The two first and the two last plot entries do not have useful data */
 	if (pi->nr <= 4)
 		return 0;
-	for (i = 2; i < pi->nr - 2; i++) {
-		if (pi->entry[i].sec >= time)
-			break;
+	lo = 2;
+	hi = pi->nr - 2;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (pi->entry[mid].sec >= time)
+			hi = mid;
+		else
+			lo = mid + 1;
 	}
-	plot_string(pi, i, mb);
+	return lo;
+}
+
+void get_plot_details_string(const struct plot_info *pi, int idx, struct membuffer *mb)
+{
+	plot_string(pi, idx, mb);
+}
+
+int get_plot_details_new(const struct plot_info *pi, int time, struct membuffer *mb)
+{
+	int i = get_plot_details_index(pi, time);
+
+	if (i)
+		plot_string(pi, i, mb);
 	return i;
 }
 
 /* Compare two plot_data entries and writes the results into a string */
-void compare_samples(struct plot_info *pi, int idx1, int idx2, char *buf, int bufsize, bool sum)
+/*
+ * The statistics of compare_samples() are sums and extrema over a range of
+ * plot entries. To answer them in constant time while the ruler is dragged,
+ * keep prefix sums and sparse tables of the extrema: entry i of level l
+ * holds the extremum of the 2^l entries starting at i.
+ */
+static void fill_sparse_table(int *table, int nr, int levels, bool max)
+{
+	for (int l = 1; l < levels; l++) {
+		const int *prev = table + (l - 1) * nr;
+		int *cur = table + l * nr;
+		int half = 1 << (l - 1);
+
+		for (int i = 0; i + 2 * half <= nr; i++)
+			cur[i] = max ? MAX(prev[i], prev[i + half]) : MIN(prev[i], prev[i + half]);
+	}
+}
+
+static int query_sparse_table(const int *table, int nr, int from, int to, bool max)
+{
+	int l = 0;
+
+	while ((2 << l) <= to - from)
+		l++;
+	table += l * nr;
+	return max ? MAX(table[from], table[to - (1 << l)]) : MIN(table[from], table[to - (1 << l)]);
+}
+
+void init_plot_ranges(struct plot_ranges *r, const struct plot_info *pi)
+{
+	int nr = pi->nr;
+	int last_pressure = 0;
+
+	free_plot_ranges(r);
+	r->nr = nr;
+	r->levels = 1;
+	while ((1 << r->levels) <= nr)
+		r->levels++;
+	r->depth_time = calloc(nr + 1, sizeof(int64_t));
+	r->speed_time = calloc(nr + 1, sizeof(int64_t));
+	r->abs_speed_time = calloc(nr + 1, sizeof(int64_t));
+	r->pressure_used = calloc(nr + 1, sizeof(int64_t));
+	r->min_depth = malloc(r->levels * nr * sizeof(int));
+	r->max_depth = malloc(r->levels * nr * sizeof(int));
+	r->min_speed = malloc(r->levels * nr * sizeof(int));
+	r->max_speed = malloc(r->levels * nr * sizeof(int));
+	if (!r->depth_time || !r->speed_time || !r->abs_speed_time || !r->pressure_used ||
+	    (nr && (!r->min_depth || !r->max_depth || !r->min_speed || !r->max_speed)))
+		exit(1);
+
+	for (int i = 0; i < nr; i++) {
+		const struct plot_data *entry = pi->entry + i;
+		int dt = i > 0 ? entry->sec - entry[-1].sec : 0;
+		int pressure = get_plot_pressure(pi, i, 0);
+		int used = 0;
+
+		/* Try to detect gas changes - this hack might work for some side mount scenarios? */
+		if (i > 0 && pressure < last_pressure + 2000)
+			used = last_pressure - pressure;
+		last_pressure = pressure;
+
+		r->depth_time[i + 1] = r->depth_time[i] + (int64_t)entry->depth * dt;
+		r->speed_time[i + 1] = r->speed_time[i] + (int64_t)entry->speed * dt;
+		r->abs_speed_time[i + 1] = r->abs_speed_time[i] + (int64_t)abs(entry->speed) * dt;
+		r->pressure_used[i + 1] = r->pressure_used[i] + used;
+		r->min_depth[i] = r->max_depth[i] = entry->depth;
+		r->min_speed[i] = r->max_speed[i] = entry->speed;
+	}
+	fill_sparse_table(r->min_depth, nr, r->levels, false);
+	fill_sparse_table(r->max_depth, nr, r->levels, true);
+	fill_sparse_table(r->min_speed, nr, r->levels, false);
+	fill_sparse_table(r->max_speed, nr, r->levels, true);
+}
+
+void free_plot_ranges(struct plot_ranges *r)
+{
+	free(r->depth_time);
+	free(r->speed_time);
+	free(r->abs_speed_time);
+	free(r->pressure_used);
+	free(r->min_depth);
+	free(r->max_depth);
+	free(r->min_speed);
+	free(r->max_speed);
+	memset(r, 0, sizeof(*r));
+}
+
+/*
+ * Sum of the values of the entries idx1 < i < idx2, i.e. weighted by the time
+ * since the previous entry, starting at entry idx1.
+ */
+static int64_t range_sum(const int64_t *sums, int idx1, int idx2)
 {
-	struct plot_data *start, *stop, *data;
+	return sums[idx2] - sums[idx1 + 1];
+}
+
+/*
+ * The ranges are built by init_plot_ranges() for the plot info. If they are NULL,
+ * temporary ranges are built, which takes longer than iterating over the entries.
+ */
+void compare_samples(struct plot_info *pi, const struct plot_ranges *ranges, int idx1, int idx2, char *buf, int bufsize, bool sum)
+{
+	struct plot_data *start, *stop;
+	struct plot_ranges tmp_ranges = { 0 };
 	const char *depth_unit, *pressure_unit, *vertical_speed_unit;
-	char *buf2 = malloc(bufsize);
+	char *buf2;
 	int avg_speed, max_asc_speed, max_desc_speed;
 	int delta_depth, avg_depth, max_depth, min_depth;
-	int bar_used, last_pressure, next_pressure, pressurevalue;
-	int last_sec, delta_time;
+	int bar_used, pressurevalue;
+	int delta_time;
 	bool crossed_tankchange = false;
 
 	double depthvalue, speedvalue;
 
 	if (bufsize > 0)
 		buf[0] = '\0';
-	if (idx1 < 0 || idx2 < 0) {
-		free(buf2);
+	if (idx1 < 0 || idx2 < 0 || idx1 >= pi->nr || idx2 >= pi->nr)
 		return;
-	}
 
 	if (pi->entry[idx1].sec > pi->entry[idx2].sec) {
 		int tmp = idx2;
 		idx2 = idx1;
 		idx1 = tmp;
 	} else if (pi->entry[idx1].sec == pi->entry[idx2].sec) {
-		free(buf2);
 		return;
 	}
 	start = pi->entry + idx1;
 	stop = pi->entry + idx2;
 
-	avg_speed = 0;
-	max_asc_speed = 0;
-	max_desc_speed = 0;
+	if (!ranges || ranges->nr != pi->nr) {
+		init_plot_ranges(&tmp_ranges, pi);
+		ranges = &tmp_ranges;
+	}
 
 	delta_depth = abs(start->depth - stop->depth);
 	delta_time = abs(start->sec - stop->sec);
-	avg_depth = 0;
-	max_depth = 0;
-	min_depth = INT_MAX;
-	bar_used = 0;
-
-	last_sec = start->sec;
-	last_pressure = get_plot_pressure(pi, idx1, 0);
-
-	data = start;
-	for (int i = idx1; i < idx2; ++i) {
-		data = pi->entry + i;
-		if (sum)
-			avg_speed += abs(data->speed) * (data->sec - last_sec);
-		else
-			avg_speed += data->speed * (data->sec - last_sec);
-		avg_depth += data->depth * (data->sec - last_sec);
-
-		if (data->speed > max_desc_speed)
-			max_desc_speed = data->speed;
-		if (data->speed < max_asc_speed)
-			max_asc_speed = data->speed;
-
-		if (data->depth < min_depth)
-			min_depth = data->depth;
-		if (data->depth > max_depth)
-			max_depth = data->depth;
-		/* Try to detect gas changes - this hack might work for some side mount scenarios? */
-		next_pressure = get_plot_pressure(pi, i, 0);
-		if (next_pressure < last_pressure + 2000)
-			bar_used += last_pressure - next_pressure;
 
-		last_sec = data->sec;
-		last_pressure = next_pressure;
-	}
-	avg_depth /= stop->sec - start->sec;
-	avg_speed /= stop->sec - start->sec;
+	/* The extrema of the entries idx1 <= i < idx2, but at least zero */
+	min_depth = query_sparse_table(ranges->min_depth, ranges->nr, idx1, idx2, false);
+	max_depth = MAX(0, query_sparse_table(ranges->max_depth, ranges->nr, idx1, idx2, true));
+	max_asc_speed = MIN(0, query_sparse_table(ranges->min_speed, ranges->nr, idx1, idx2, false));
+	max_desc_speed = MAX(0, query_sparse_table(ranges->max_speed, ranges->nr, idx1, idx2, true));
+
+	avg_depth = (int)(range_sum(ranges->depth_time, idx1, idx2) / (stop->sec - start->sec));
+	avg_speed = (int)(range_sum(sum ? ranges->abs_speed_time : ranges->speed_time, idx1, idx2) / (stop->sec - start->sec));
+	bar_used = (int)range_sum(ranges->pressure_used, idx1, idx2);
+	free_plot_ranges(&tmp_ranges);
+
+	buf2 = malloc(bufsize);
 
 	snprintf_loc(buf, bufsize, translate("gettextFromC", "ΔT:%d:%02dmin"), delta_time / 60, delta_time % 60);
 	memcpy(buf2, buf, bufsize);
@@ -1725,7 +2219,7 @@ void compare_samples(struct plot_info *pi, int idx1, int idx2, char *buf, int bu
 
 			pressure_t first_pressure = { get_plot_pressure(pi, first, 0) };
 			pressure_t stop_pressure = { get_plot_pressure(pi, last, 0) };
-			int volume_used = gas_volume(cyl, first_pressure) - gas_volume(cyl, stop_pressure);
+			int volume_used = gas_volume_used(cyl, first_pressure, stop_pressure);
 
 			/* Mean pressure in ATM */
 			double atm = depth_to_atm(avg_depth, &displayed_dive);
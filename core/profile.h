@@ -35,15 +35,19 @@ struct plot_pressure_data {
 	int data[NUM_PLOT_PRESSURES];
 };
 
+/*
+ * One point of the profile. Keep this compact, there is one of these for
+ * every sample and every ten seconds of every plotted dive.
+ */
 struct plot_data {
 	unsigned int in_deco : 1;
+	unsigned int in_deco_calc : 1;	/* calculated by us */
+	unsigned int icd_warning : 1;	/* calculated by us */
 	int sec;
 	int temperature;
 	/* Depth info */
 	int depth;
 	int ceiling;
-	int ceilings[16];
-	int percentages[16];
 	int ndl;
 	int tts;
 	int rbt;
@@ -64,7 +68,6 @@ struct plot_data {
 	// stats over 9 minute window:
 	int min, max;	// indices into pi->entry[]
 	/* values calculated by us */
-	unsigned int in_deco_calc : 1;
 	int ndl_calc;
 	int tts_calc;
 	int stoptime_calc;
@@ -77,7 +80,13 @@ struct plot_data {
 	double surface_gf;
 	double current_gf;
 	double density;
-	bool icd_warning;
+};
+
+/* Calculated ceilings and saturations of the individual tissues. These are only
+ * needed for the tissue graphs, so they are stored separately in pi->tissues. */
+struct plot_tissue_data {
+	int ceilings[16];
+	int percentages[16];
 };
 
 struct ev_select {
@@ -85,12 +94,28 @@ struct ev_select {
 	bool plot_ev;
 };
 
-extern void compare_samples(struct plot_info *p1, int idx1, int idx2, char *buf, int bufsize, bool sum);
+/* Prefix sums and sparse extrema tables of the plot entries for compare_samples() */
+struct plot_ranges {
+	int nr;
+	int levels;
+	int64_t *depth_time, *speed_time, *abs_speed_time, *pressure_used; /* nr + 1 entries */
+	int *min_depth, *max_depth, *min_speed, *max_speed; /* levels blocks of nr entries */
+};
+
+extern void init_plot_ranges(struct plot_ranges *r, const struct plot_info *pi);
+extern void free_plot_ranges(struct plot_ranges *r);
+extern void compare_samples(struct plot_info *p1, const struct plot_ranges *ranges, int idx1, int idx2, char *buf, int bufsize, bool sum);
 extern void init_plot_info(struct plot_info *pi);
-extern void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, const struct deco_state *planner_ds);
-extern void calculate_deco_information(struct deco_state *ds, const struct deco_state *planner_de, const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi, bool print_mode);
+extern void create_plot_info_new(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, bool tissues, const struct deco_state *planner_ds);
+extern void create_plot_info_from_deco_state(struct dive *dive, struct divecomputer *dc, struct plot_info *pi, bool fast, bool tissues,
+					     struct deco_state *ds, const struct deco_state *planner_ds);
+extern void calculate_deco_information(struct deco_state *ds, const struct deco_state *planner_de, const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi, bool print_mode, const struct plot_info *prev);
 extern int get_plot_details_new(const struct plot_info *pi, int time, struct membuffer *);
+extern int get_plot_details_index(const struct plot_info *pi, int time);
+extern void get_plot_details_string(const struct plot_info *pi, int idx, struct membuffer *);
 extern void free_plot_info_data(struct plot_info *pi);
+extern size_t plot_info_size(const struct plot_info *pi);
+extern void copy_plot_info(struct plot_info *dst, const struct plot_info *src);
 
 /*
  * When showing dive profiles, we scale things to the
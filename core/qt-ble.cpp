@@ -1,11 +1,12 @@
 // SPDX-License-Identifier: GPL-2.0
 #include <errno.h>
+#include <algorithm>
 
 #include <QtBluetooth/QBluetoothAddress>
 #include <QLowEnergyController>
 #include <QLowEnergyService>
+#include <QLowEnergyConnectionParameters>
 #include <QCoreApplication>
-#include <QElapsedTimer>
 #include <QEventLoop>
 #include <QThread>
 #include <QTimer>
@@ -33,23 +34,101 @@ static int debugCounter;
 #define MAXIMAL_HW_CREDIT	255
 #define MINIMAL_HW_CREDIT	32
 
+// Wait until the expression becomes true, at most ms milliseconds. Rather
+// than polling, we sleep in the event loop until the next event arrives
+// (e.g. a received packet or a state change) and check again. The timer
+// makes sure that we wake up when the time is over.
 #define WAITFOR(expression, ms) do {					\
 	Q_ASSERT(QCoreApplication::instance());				\
 	Q_ASSERT(QThread::currentThread());				\
 									\
 	if (expression)							\
 		break;							\
-	QElapsedTimer timer;						\
-	timer.start();							\
+	if ((ms) <= 0) {						\
+		QCoreApplication::processEvents(QEventLoop::AllEvents);	\
+		break;							\
+	}								\
+	QTimer wakeup;							\
+	wakeup.setSingleShot(true);					\
+	wakeup.start(ms);						\
+	QEventLoop loop;						\
 									\
 	do {								\
-		QCoreApplication::processEvents(QEventLoop::AllEvents, ms); \
-		if (expression)						\
-			break;						\
-		QThread::msleep(10);					\
-	} while (timer.elapsed() < (ms));				\
+		loop.processEvents(QEventLoop::AllEvents | QEventLoop::WaitForMoreEvents); \
+	} while (!(expression) && wakeup.isActive());			\
 } while (0)
 
+// Enough for a few hundred packets of the usual sizes
+#define PACKET_RING_SIZE 65536
+
+PacketRing::PacketRing() : buffer(PACKET_RING_SIZE)
+{
+}
+
+void PacketRing::copyIn(size_t pos, const void *data, size_t size)
+{
+	size_t first = std::min(size, buffer.size() - pos);
+	memcpy(&buffer[pos], data, first);
+	memcpy(&buffer[0], (const unsigned char *)data + first, size - first);
+}
+
+void PacketRing::copyOut(size_t pos, void *data, size_t size) const
+{
+	size_t first = std::min(size, buffer.size() - pos);
+	memcpy(data, &buffer[pos], first);
+	memcpy((unsigned char *)data + first, &buffer[0], size - first);
+}
+
+// Only called when we get packets faster than libdivecomputer reads them
+void PacketRing::grow(size_t needed)
+{
+	std::vector<unsigned char> bigger(std::max(buffer.size() * 2, used + needed));
+	copyOut(start, &bigger[0], used);
+	buffer.swap(bigger);
+	start = 0;
+}
+
+void PacketRing::append(const QByteArray &packet)
+{
+	// ATT values are at most 512 bytes, so the length always fits
+	uint16_t len = (uint16_t)std::min(packet.size(), 0xffff);
+
+	if (!len)
+		return;
+	if (used + sizeof(len) + len > buffer.size())
+		grow(sizeof(len) + len);
+	copyIn((start + used) % buffer.size(), &len, sizeof(len));
+	copyIn((start + used + sizeof(len)) % buffer.size(), packet.constData(), len);
+	used += sizeof(len) + len;
+}
+
+size_t PacketRing::takeFirst(void *data, size_t size)
+{
+	uint16_t len;
+
+	if (isEmpty())
+		return 0;
+	copyOut(start, &len, sizeof(len));
+	start = (start + sizeof(len)) % buffer.size();
+	used -= sizeof(len);
+	if (size > len)
+		size = len;
+	copyOut(start, data, size);
+	start = (start + size) % buffer.size();
+	used -= size;
+
+	// Put the length of the rest in front of it
+	if (size < len) {
+		len -= (uint16_t)size;
+		start = (start + buffer.size() - sizeof(len)) % buffer.size();
+		used += sizeof(len);
+		copyIn(start, &len, sizeof(len));
+	}
+	if (!used)
+		start = 0;
+	return size;
+}
+
 extern "C" {
 
 void BLEObject::serviceStateChanged(QLowEnergyService::ServiceState newState)
@@ -296,9 +375,7 @@ dc_status_t BLEObject::write(const void *data, size_t size, size_t *actual)
 
 	if (!receivedPackets.isEmpty()) {
 		qDebug() << ".. write HIT with still incoming packets in queue";
-		do {
-			receivedPackets.takeFirst();
-		} while (!receivedPackets.isEmpty());
+		receivedPackets.clear();
 	}
 
 	foreach (const QLowEnergyCharacteristic &c, preferredService()->characteristics()) {
@@ -352,24 +429,14 @@ dc_status_t BLEObject::read(void *data, size_t size, size_t *actual)
 	if (rc != DC_STATUS_SUCCESS)
 		return rc;
 
-	QByteArray packet = receivedPackets.takeFirst();
-
-	// Did we get more than asked for?
-	//
-	// Put back the left-over at the beginning of the
-	// received packet list, and truncate the packet
-	// we got to just the part asked for.
-	if ((size_t)packet.size() > size) {
-		receivedPackets.prepend(packet.mid(size));
-		packet.truncate(size);
-	}
-
-	memcpy((char *)data, packet.data(), packet.size());
+	// If we got more than asked for, the left-over stays at
+	// the beginning of the received packets.
+	size_t len = receivedPackets.takeFirst(data, size);
 	if (actual)
-		*actual += packet.size();
+		*actual += len;
 
 	if (verbose > 2 || debugCounter < DEBUG_THRESHOLD)
-		qDebug() << QTime::currentTime() << "packet READ" << packet.toHex();
+		qDebug() << QTime::currentTime() << "packet READ" << QByteArray::fromRawData((const char *)data, (int)len).toHex();
 
 	return DC_STATUS_SUCCESS;
 }
@@ -612,6 +679,23 @@ dc_status_t qt_ble_open(void **io, dc_context_t *, const char *devaddr, dc_user_
 
 	qDebug() << " .. done discovering services";
 
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+	qDebug() << " .. MTU" << controller->mtu();
+#endif
+#if !defined(Q_OS_MACOS) && !defined(Q_OS_IOS) && !defined(Q_OS_WIN)
+	// Ask for the shortest connection interval, so that the packets of chatty
+	// protocols aren't held back. The dive computer may well reject that,
+	// in which case we simply keep the old parameters.
+	ble->connect(controller, &QLowEnergyController::connectionUpdated, [=](const QLowEnergyConnectionParameters &p) {
+		qDebug() << " .. connection interval now" << p.minimumInterval() << "-" << p.maximumInterval() << "ms";
+	});
+	QLowEnergyConnectionParameters parameters;
+	parameters.setIntervalRange(7.5, 15);
+	parameters.setLatency(0);
+	parameters.setSupervisionTimeout(4000);
+	controller->requestConnectionUpdate(parameters);
+#endif
+
 	dc_status_t error = ble->select_preferred_service();
 
 	if (error != DC_STATUS_SUCCESS) {
@@ -3,6 +3,7 @@
 #define QT_BLE_H
 
 #include <stddef.h>
+#include <vector>
 #include "core/libdivecomputer.h"
 #include <QVector>
 #include <QLowEnergyController>
@@ -13,6 +14,26 @@
 #define HW_OSTC_BLE_CREDITS_RX	2
 #define HW_OSTC_BLE_CREDITS_TX	3
 
+// The received packets, stored back to back in one preallocated ring
+// buffer, each preceded by its 16 bit length. Packets are read in the
+// order they were received, and a partially read packet keeps its
+// remainder at the front. This avoids a heap allocation per packet.
+class PacketRing
+{
+public:
+	PacketRing();
+	void append(const QByteArray &packet);
+	size_t takeFirst(void *data, size_t size);
+	inline bool isEmpty() const { return used == 0; }
+	inline void clear() { start = used = 0; }
+private:
+	std::vector<unsigned char> buffer;
+	size_t start = 0, used = 0;
+	void copyIn(size_t pos, const void *data, size_t size);
+	void copyOut(size_t pos, void *data, size_t size) const;
+	void grow(size_t needed);
+};
+
 class BLEObject : public QObject
 {
 	Q_OBJECT
@@ -48,7 +69,7 @@ private:
 
 	QLowEnergyController *controller = nullptr;
 	QLowEnergyService *preferred = nullptr;
-	QList<QByteArray> receivedPackets;
+	PacketRing receivedPackets;
 	bool isCharacteristicWritten;
 	dc_user_device_t *device;
 	unsigned int hw_credit = 0;
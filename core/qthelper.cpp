@@ -22,6 +22,7 @@
 #include "tag.h"
 #include "trip.h"
 #include "imagedownloader.h"
+#include <QElapsedTimer>
 #include <QFile>
 #include <QRegExp>
 #include <QDir>
@@ -32,12 +33,15 @@
 #include <QDateTime>
 #include <QImageReader>
 #include <QtConcurrent>
+#include <QReadWriteLock>
 #include <QFont>
 #include <QApplication>
 #include <QTextDocument>
 #include <QProgressDialog>	// TODO: remove with convertThumbnails()
+#include <QtEndian>
 #include <cstdarg>
 #include <cstdint>
+#include <numeric>
 
 #include <libxslt/documents.h>
 
@@ -368,18 +372,6 @@ extern "C" char *get_file_name(const char *fileName)
 	return copy_qstring(fileInfo.fileName());
 }
 
-extern "C" void copy_image_and_overwrite(const char *cfileName, const char *path, const char *cnewName)
-{
-	QString fileName(cfileName);
-	QString newName(path);
-	newName += cnewName;
-	QFile file(newName);
-	if (file.exists())
-		file.remove();
-	if (!QFile::copy(fileName, newName))
-		qDebug() << "copy of" << fileName << "to" << newName << "failed";
-}
-
 static bool lessThan(const QPair<QString, int> &a, const QPair<QString, int> &b)
 {
 	return a.second < b.second;
@@ -1032,17 +1024,87 @@ QString get_trip_date_string(timestamp_t when, int nr, bool getday)
 static QMutex hashOfMutex;
 static QHash<QString, QString> localFilenameOf;
 
+// The mapping of original to local picture filenames is stored in an append-only
+// journal: after a magic, each record consists of the little-endian 32-bit lengths
+// of the UTF-8 encoded original and local filenames, followed by the filenames.
+// An empty local filename removes the entry. The journal is read lazily, on the
+// first access of the mapping, and write_hashes() only appends the changed entries.
+// When the journal consists mostly of outdated records, it is rewritten.
+static const char journalMagic[8] = { 'S', 'S', 'R', 'F', 'P', 'I', 'C', '1' };
+static bool localFilenamesLoaded = false;
+static qint64 journalSize = 0;		// Size of the valid part of the journal, 0 if there is none
+static int journalRecords = 0;
+static QVector<QPair<QString, QString>> unsavedFilenames;
+
+// Before the journal, everything was stored with QDataStream in one file.
+// TODO: remove in due course, with convertThumbnails() and convertLocalFilename()
 static const QString hashfile_name()
 {
 	return QString(system_default_directory()).append("/hashes");
 }
 
+static const QString journal_name()
+{
+	return QString(system_default_directory()).append("/picturefilenames");
+}
+
+// Needs hashOfMutex
+static void loadLocalFilenames()
+{
+	if (localFilenamesLoaded)
+		return;
+	localFilenamesLoaded = true;
+
+	QFile journal(journal_name());
+	if (!journal.open(QIODevice::ReadOnly))
+		return;
+	qint64 size = journal.size();
+	QByteArray buffer;
+	const uchar *data = journal.map(0, size);
+	if (!data) {
+		buffer = journal.readAll();
+		data = (const uchar *)buffer.constData();
+		size = buffer.size();
+	}
+	if (size < (qint64)sizeof(journalMagic) || memcmp(data, journalMagic, sizeof(journalMagic)))
+		return;
+	qint64 pos = sizeof(journalMagic);
+	while (size - pos >= 8) {
+		qint64 originalLen = qFromLittleEndian<quint32>(data + pos);
+		qint64 localLen = qFromLittleEndian<quint32>(data + pos + 4);
+		// A truncated record at the end stems from an interrupted write
+		if (originalLen + localLen > size - pos - 8)
+			break;
+		QString original = QString::fromUtf8((const char *)data + pos + 8, originalLen);
+		QString local = QString::fromUtf8((const char *)data + pos + 8 + originalLen, localLen);
+		if (local.isEmpty())
+			localFilenameOf.remove(original);
+		else
+			localFilenameOf.insert(original, local);
+		pos += 8 + originalLen + localLen;
+		journalRecords++;
+	}
+	journalSize = pos;
+}
+
+static void appendJournalRecord(QByteArray &out, const QString &original, const QString &local)
+{
+	QByteArray originalUtf8 = original.toUtf8(), localUtf8 = local.toUtf8();
+	uchar lengths[8];
+	qToLittleEndian<quint32>(originalUtf8.size(), lengths);
+	qToLittleEndian<quint32>(localUtf8.size(), lengths + 4);
+	out.append((const char *)lengths, sizeof(lengths));
+	out.append(originalUtf8);
+	out.append(localUtf8);
+}
+
 static QString thumbnailDir()
 {
 	return QString(system_default_directory()) + "/thumbnails/";
 }
 
 // Calculate thumbnail filename by hashing name of file.
+// Only used for thumbnails of older versions, see thumbnailstore.h.
 QString thumbnailFileName(const QString &filename)
 {
 	if (filename.isEmpty())
@@ -1052,9 +1114,14 @@ QString thumbnailFileName(const QString &filename)
 	return thumbnailDir() + hash.result().toHex();
 }
 
+QString thumbnailPackFileName()
+{
+	return thumbnailDir() + "pack";
+}
+
 extern "C" char *hashfile_name_string()
 {
-	return copy_qstring(hashfile_name());
+	return copy_qstring(journal_name());
 }
 
 // During a transition period, convert old thumbnail-hashes to individual files
@@ -1136,46 +1203,78 @@ static void convertLocalFilename(const QHash<QString, QByteArray> &hashOf, const
 	}
 }
 
-void read_hashes()
+// Convert the data of the old hashes file, if there is no journal yet
+static void readLegacyHashes()
 {
 	QFile hashfile(hashfile_name());
-	if (hashfile.open(QIODevice::ReadOnly)) {
-		QDataStream stream(&hashfile);
-		QHash<QByteArray, QString> localFilenameByHash;
-		QHash<QString, QByteArray> hashOf;
-		stream >> localFilenameByHash;		// For backwards compatibility
-		stream >> hashOf;			// For backwards compatibility
-		QHash <QString, QImage> thumbnailCache;
-		stream >> thumbnailCache;		// For backwards compatibility
-		QMutexLocker locker(&hashOfMutex);
-		stream >> localFilenameOf;
-		locker.unlock();
-		hashfile.close();
-		convertThumbnails(thumbnailCache);
-		convertLocalFilename(hashOf, localFilenameByHash);
-	}
+	if (QFile::exists(journal_name()) || !hashfile.open(QIODevice::ReadOnly))
+		return;
+	QDataStream stream(&hashfile);
+	QHash<QByteArray, QString> localFilenameByHash;
+	QHash<QString, QByteArray> hashOf;
+	stream >> localFilenameByHash;		// For backwards compatibility
+	stream >> hashOf;			// For backwards compatibility
+	QHash <QString, QImage> thumbnailCache;
+	stream >> thumbnailCache;		// For backwards compatibility
+	QHash<QString, QString> legacyFilenameOf;
+	stream >> legacyFilenameOf;
+	hashfile.close();
 	QMutexLocker locker(&hashOfMutex);
+	localFilenamesLoaded = true;
+	localFilenameOf = legacyFilenameOf;
 	localFilenameOf.remove("");
+	locker.unlock();
+	convertThumbnails(thumbnailCache);
+	convertLocalFilename(hashOf, localFilenameByHash);
+	// Since there is no journal, this writes all entries
+	write_hashes();
+}
+
+void read_hashes()
+{
+	readLegacyHashes();
 
 	// Make sure that the thumbnail directory exists
 	QDir().mkpath(thumbnailDir());
 }
 
+// Append the changed entries to the journal, or rewrite it if it consists mostly
+// of outdated records
 void write_hashes()
 {
-	QSaveFile hashfile(hashfile_name());
 	QMutexLocker locker(&hashOfMutex);
+	if (!localFilenamesLoaded)
+		return;		// Nothing was changed
+	bool rewrite = journalSize == 0 || journalRecords + unsavedFilenames.size() > 2 * localFilenameOf.size() + 1000;
+	if (unsavedFilenames.isEmpty() && (!rewrite || localFilenameOf.isEmpty()))
+		return;
 
-	if (hashfile.open(QIODevice::WriteOnly)) {
-		QDataStream stream(&hashfile);
-		stream << QHash<QByteArray, QString>();	// Empty hash to filename - for backwards compatibility
-		stream << QHash<QString, QByteArray>(); // Empty hashes - for backwards compatibility
-		stream << QHash<QString,QImage>();	// Empty thumbnailCache - for backwards compatibility
-		stream << localFilenameOf;
-		hashfile.commit();
+	QByteArray data;
+	if (rewrite) {
+		QSaveFile journal(journal_name());
+		data.append(journalMagic, sizeof(journalMagic));
+		for (auto it = localFilenameOf.cbegin(); it != localFilenameOf.cend(); ++it)
+			appendJournalRecord(data, it.key(), it.value());
+		if (!journal.open(QIODevice::WriteOnly) || journal.write(data) != data.size() || !journal.commit()) {
+			qWarning() << "Cannot write picture filename table: " << journal.fileName();
+			return;
+		}
+		journalSize = data.size();
+		journalRecords = localFilenameOf.size();
 	} else {
-		qWarning() << "Cannot open hashfile for writing: " << hashfile.fileName();
+		QFile journal(journal_name());
+		for (const auto &entry: unsavedFilenames)
+			appendJournalRecord(data, entry.first, entry.second);
+		// Drop a truncated record of an interrupted write before appending
+		if (!journal.open(QIODevice::ReadWrite) || !journal.resize(journalSize) || !journal.seek(journalSize) ||
+		    journal.write(data) != data.size()) {
+			qWarning() << "Cannot append to picture filename table: " << journal.fileName();
+			return;
+		}
+		journalSize += data.size();
+		journalRecords += unsavedFilenames.size();
 	}
+	unsavedFilenames.clear();
 }
 
 void learnPictureFilename(const QString &originalName, const QString &localName)
@@ -1183,16 +1282,21 @@ void learnPictureFilename(const QString &originalName, const QString &localName)
 	if (originalName.isEmpty() || localName.isEmpty())
 		return;
 	QMutexLocker locker(&hashOfMutex);
+	loadLocalFilenames();
 	// Only keep track of images where original and local names differ
-	if (originalName == localName)
-		localFilenameOf.remove(originalName);
-	else
+	if (originalName == localName) {
+		if (localFilenameOf.remove(originalName))
+			unsavedFilenames.append({ originalName, QString() });
+	} else if (localFilenameOf.value(originalName) != localName) {
 		localFilenameOf[originalName] = localName;
+		unsavedFilenames.append({ originalName, localName });
+	}
 }
 
 QString localFilePath(const QString &originalFilename)
 {
 	QMutexLocker locker(&hashOfMutex);
+	loadLocalFilenames();
 	return localFilenameOf.value(originalFilename, originalFilename);
 }
 
@@ -1637,11 +1741,18 @@ extern "C" void print_qt_versions()
 	printf("%s\n", qPrintable(QStringLiteral("built with Qt Version %1, runtime from Qt Version %2").arg(QT_VERSION_STR).arg(qVersion())));
 }
 
-QMutex planLock;
+// The deco calculations of several profiles may run at the same time, e.g.
+// when exporting the profile data, but not while the planner copies its plan.
+QReadWriteLock planLock;
 
 extern "C" void lock_planner()
 {
-	planLock.lock();
+	planLock.lockForWrite();
+}
+
+extern "C" void lock_planner_shared()
+{
+	planLock.lockForRead();
 }
 
 extern "C" void unlock_planner()
@@ -1649,6 +1760,40 @@ extern "C" void unlock_planner()
 	planLock.unlock();
 }
 
+static QMutex arenaLock;
+
+extern "C" void lock_arena()
+{
+	arenaLock.lock();
+}
+
+extern "C" void unlock_arena()
+{
+	arenaLock.unlock();
+}
+
+// Call fn(idx, data) for idx = 0..n-1 on the global thread pool and wait
+// for all calls to finish. The callback must not touch global state.
+extern "C" void run_in_parallel(int n, void (*fn)(int idx, void *data), void *data)
+{
+	if (n <= 0)
+		return;
+	if (n == 1) {
+		fn(0, data);
+		return;
+	}
+	std::vector<int> indices(n);
+	std::iota(indices.begin(), indices.end(), 0);
+	QtConcurrent::blockingMap(indices, [fn, data](int &idx) { fn(idx, data); });
+}
+
+// Milliseconds on a monotonic clock, for timing things
+extern "C" int64_t elapsed_msecs()
+{
+	static QElapsedTimer timer = [] { QElapsedTimer t; t.start(); return t; }();
+	return timer.elapsed();
+}
+
 char *copy_qstring(const QString &s)
 {
 	return strdup(qPrintable(s));
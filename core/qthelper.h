@@ -32,6 +32,7 @@ QStringList stringToList(const QString &s);
 void read_hashes();
 void write_hashes();
 QString thumbnailFileName(const QString &filename);
+QString thumbnailPackFileName();
 void learnPictureFilename(const QString &originalName, const QString &localName);
 QString localFilePath(const QString &originalFilename);
 int getCloudURL(QString &filename);
@@ -135,11 +136,11 @@ char *printGPSCoordsC(const location_t *loc);
 bool in_planner();
 bool getProxyString(char **buffer);
 bool canReachCloudServer();
+void startCloudServerCheck();
 void updateWindowTitle();
 void subsurface_mkdir(const char *dir);
 char *get_file_name(const char *fileName);
 void set_filename(const char *filename);
-void copy_image_and_overwrite(const char *cfileName, const char *path, const char *cnewName);
 char *move_away(const char *path);
 const char *local_file_path(struct picture *picture);
 char *cloud_url();
@@ -152,7 +153,12 @@ char *get_current_date();
 time_t get_dive_datetime_from_isostring(char *when);
 void print_qt_versions();
 void lock_planner();
+void lock_planner_shared();
 void unlock_planner();
+void lock_arena();
+void unlock_arena();
+void run_in_parallel(int n, void (*fn)(int idx, void *data), void *data);
+int64_t elapsed_msecs();
 xsltStylesheetPtr get_stylesheet(const char *name);
 weight_t string_to_weight(const char *str);
 depth_t string_to_depth(const char *str);
@@ -205,6 +205,9 @@ static dc_status_t qt_serial_poll(void *io, int timeout)
 	if (!device->socket)
 		return DC_STATUS_INVALIDARGS;
 
+	if (device->socket->bytesAvailable() > 0)
+		return DC_STATUS_SUCCESS;
+
 	QEventLoop loop;
 	QTimer timer;
 	timer.setSingleShot(true);
@@ -213,7 +216,8 @@ static dc_status_t qt_serial_poll(void *io, int timeout)
 	timer.start(timeout);
 	loop.exec();
 
-	if (!timer.isActive())
+	// the timer is still running if we got woken up by data
+	if (timer.isActive())
 		return DC_STATUS_SUCCESS;
 	return DC_STATUS_TIMEOUT;
 }
@@ -0,0 +1,254 @@
+// SPDX-License-Identifier: GPL-2.0
+/* samplecodec.c */
+/* compact binary encoding of the samples for the git storage */
+#include <stdint.h>
+#include <string.h>
+
+#include "dive.h"
+#include "membuffer.h"
+#include "samplecodec.h"
+
+#define SAMPLE_BLOB_HEADER_SIZE (sizeof(SAMPLE_BLOB_MAGIC) - 1 + 1)
+
+/*
+ * The column ids are part of the file format: never renumber them,
+ * only add new ones at the end. Like the text format, the planner-only
+ * fields (sac and manually_entered) are not saved.
+ */
+enum sample_column {
+	COL_TIME,
+	COL_DEPTH,
+	COL_TEMPERATURE,
+	COL_PRESSURE0,
+	COL_PRESSURE1,
+	COL_SENSOR0,
+	COL_SENSOR1,
+	COL_NDL,
+	COL_TTS,
+	COL_STOPTIME,
+	COL_STOPDEPTH,
+	COL_IN_DECO,
+	COL_CNS,
+	COL_RBT,
+	COL_O2SENSOR0,
+	COL_O2SENSOR1,
+	COL_O2SENSOR2,
+	COL_SETPOINT,
+	COL_HEARTBEAT,
+	COL_BEARING,
+	NR_SAMPLE_COLUMNS
+};
+
+enum column_mode {
+	COLUMN_CONSTANT,	/* One value for all samples */
+	COLUMN_DELTA		/* One difference to the previous sample per sample */
+};
+
+static int64_t get_column(const struct sample *s, int col)
+{
+	switch (col) {
+	case COL_TIME: return s->time.seconds;
+	case COL_DEPTH: return s->depth.mm;
+	case COL_TEMPERATURE: return s->temperature.mkelvin;
+	case COL_PRESSURE0: return s->pressure[0].mbar;
+	case COL_PRESSURE1: return s->pressure[1].mbar;
+	case COL_SENSOR0: return s->sensor[0];
+	case COL_SENSOR1: return s->sensor[1];
+	case COL_NDL: return s->ndl.seconds;
+	case COL_TTS: return s->tts.seconds;
+	case COL_STOPTIME: return s->stoptime.seconds;
+	case COL_STOPDEPTH: return s->stopdepth.mm;
+	case COL_IN_DECO: return s->in_deco;
+	case COL_CNS: return s->cns;
+	case COL_RBT: return s->rbt.seconds;
+	case COL_O2SENSOR0: return s->o2sensor[0].mbar;
+	case COL_O2SENSOR1: return s->o2sensor[1].mbar;
+	case COL_O2SENSOR2: return s->o2sensor[2].mbar;
+	case COL_SETPOINT: return s->setpoint.mbar;
+	case COL_HEARTBEAT: return s->heartbeat;
+	case COL_BEARING: return s->bearing.degrees;
+	}
+	return 0;
+}
+
+static void set_column(struct sample *s, int col, int64_t val)
+{
+	switch (col) {
+	case COL_TIME: s->time.seconds = (int32_t)val; break;
+	case COL_DEPTH: s->depth.mm = (int32_t)val; break;
+	case COL_TEMPERATURE: s->temperature.mkelvin = (uint32_t)val; break;
+	case COL_PRESSURE0: s->pressure[0].mbar = (int32_t)val; break;
+	case COL_PRESSURE1: s->pressure[1].mbar = (int32_t)val; break;
+	case COL_SENSOR0: s->sensor[0] = (uint8_t)val; break;
+	case COL_SENSOR1: s->sensor[1] = (uint8_t)val; break;
+	case COL_NDL: s->ndl.seconds = (int32_t)val; break;
+	case COL_TTS: s->tts.seconds = (int32_t)val; break;
+	case COL_STOPTIME: s->stoptime.seconds = (int32_t)val; break;
+	case COL_STOPDEPTH: s->stopdepth.mm = (int32_t)val; break;
+	case COL_IN_DECO: s->in_deco = val != 0; break;
+	case COL_CNS: s->cns = (uint16_t)val; break;
+	case COL_RBT: s->rbt.seconds = (int32_t)val; break;
+	case COL_O2SENSOR0: s->o2sensor[0].mbar = (uint16_t)val; break;
+	case COL_O2SENSOR1: s->o2sensor[1].mbar = (uint16_t)val; break;
+	case COL_O2SENSOR2: s->o2sensor[2].mbar = (uint16_t)val; break;
+	case COL_SETPOINT: s->setpoint.mbar = (uint16_t)val; break;
+	case COL_HEARTBEAT: s->heartbeat = (uint8_t)val; break;
+	case COL_BEARING: s->bearing.degrees = (int16_t)val; break;
+	}
+}
+
+/* Same defaults as prepare_sample() */
+static int64_t default_value(int col)
+{
+	return col == COL_NDL || col == COL_BEARING ? -1 : 0;
+}
+
+static void put_varint(struct membuffer *b, uint64_t val)
+{
+	char buf[10];
+	int len = 0;
+
+	while (val >= 0x80) {
+		buf[len++] = (char)(val | 0x80);
+		val >>= 7;
+	}
+	buf[len++] = (char)val;
+	put_bytes(b, buf, len);
+}
+
+static void put_signed(struct membuffer *b, int64_t val)
+{
+	put_varint(b, ((uint64_t)val << 1) ^ (uint64_t)(val >> 63));
+}
+
+void encode_samples(struct membuffer *b, const struct divecomputer *dc)
+{
+	const struct sample *s = dc->sample;
+	int nr = dc->samples;
+	char version = SAMPLE_BLOB_VERSION;
+
+	put_bytes(b, SAMPLE_BLOB_MAGIC, sizeof(SAMPLE_BLOB_MAGIC) - 1);
+	put_bytes(b, &version, 1);
+	put_varint(b, nr);
+	if (!nr)
+		return;
+
+	for (int col = 0; col < NR_SAMPLE_COLUMNS; col++) {
+		int64_t first = get_column(s, col), prev;
+		bool constant = true;
+
+		for (int i = 1; i < nr && constant; i++)
+			constant = get_column(s + i, col) == first;
+
+		/* The time is always a delta column, see decode_samples() */
+		if (constant && col != COL_TIME) {
+			if (first == default_value(col))
+				continue;
+			put_varint(b, col);
+			put_varint(b, COLUMN_CONSTANT);
+			put_signed(b, first);
+			continue;
+		}
+		put_varint(b, col);
+		put_varint(b, COLUMN_DELTA);
+		prev = 0;
+		for (int i = 0; i < nr; i++) {
+			int64_t val = get_column(s + i, col);
+			put_signed(b, val - prev);
+			prev = val;
+		}
+	}
+}
+
+struct sample_reader {
+	const unsigned char *p, *end;
+	bool error;
+};
+
+static uint64_t get_varint(struct sample_reader *r)
+{
+	uint64_t val = 0;
+
+	for (int shift = 0; shift < 64; shift += 7) {
+		unsigned char c;
+
+		if (r->p >= r->end)
+			break;
+		c = *r->p++;
+		val |= (uint64_t)(c & 0x7f) << shift;
+		if (!(c & 0x80))
+			return val;
+	}
+	r->error = true;
+	return 0;
+}
+
+static int64_t get_signed(struct sample_reader *r)
+{
+	uint64_t val = get_varint(r);
+	return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+bool is_sample_blob(const void *data, size_t len)
+{
+	return len >= SAMPLE_BLOB_HEADER_SIZE &&
+	       !memcmp(data, SAMPLE_BLOB_MAGIC, sizeof(SAMPLE_BLOB_MAGIC) - 1);
+}
+
+/*
+ * Replaces the samples of the divecomputer. Returns false for a corrupt
+ * blob or one written by a newer version, which leaves no samples.
+ */
+bool decode_samples(const void *data, size_t len, struct divecomputer *dc)
+{
+	struct sample_reader r;
+	uint64_t nr;
+
+	dc->samples = 0;
+	if (!is_sample_blob(data, len) || ((const unsigned char *)data)[SAMPLE_BLOB_HEADER_SIZE - 1] > SAMPLE_BLOB_VERSION)
+		return false;
+	r.p = (const unsigned char *)data + SAMPLE_BLOB_HEADER_SIZE;
+	r.end = (const unsigned char *)data + len;
+	r.error = false;
+
+	/* Every sample takes at least one byte in the time column */
+	nr = get_varint(&r);
+	if (r.error || nr > (uint64_t)(r.end - r.p))
+		return false;
+	if (!nr)
+		return true;
+	alloc_samples(dc, (int)nr);
+	if (!dc->sample)
+		return false;
+	for (uint64_t i = 0; i < nr; i++) {
+		struct sample *s = dc->sample + i;
+		memset(s, 0, sizeof(*s));
+		s->ndl.seconds = -1;
+		s->bearing.degrees = -1;
+	}
+
+	while (r.p < r.end && !r.error) {
+		uint64_t col = get_varint(&r);
+		uint64_t mode = get_varint(&r);
+
+		if (mode == COLUMN_CONSTANT) {
+			int64_t val = get_signed(&r);
+			for (uint64_t i = 0; i < nr && col < NR_SAMPLE_COLUMNS; i++)
+				set_column(dc->sample + i, (int)col, val);
+		} else if (mode == COLUMN_DELTA) {
+			int64_t val = 0;
+			for (uint64_t i = 0; i < nr; i++) {
+				val += get_signed(&r);
+				/* Columns of newer versions are skipped */
+				if (col < NR_SAMPLE_COLUMNS)
+					set_column(dc->sample + i, (int)col, val);
+			}
+		} else {
+			r.error = true;
+		}
+	}
+	if (r.error)
+		return false;
+	dc->samples = (int)nr;
+	return true;
+}
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef SAMPLECODEC_H
+#define SAMPLECODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct divecomputer;
+struct membuffer;
+
+/*
+ * Binary encoding of the samples of a divecomputer for the git storage.
+ *
+ * The blob starts with SAMPLE_BLOB_MAGIC and a version byte, followed by
+ * the number of samples and the columns. Each column is one field of
+ * struct sample: fields that have their default value (0, or -1 for ndl
+ * and bearing) in all samples are not written, fields with the same value
+ * in all samples are written once, and all other fields are written as
+ * zigzag varints of the difference to the previous sample. For the usual
+ * 1 Hz dive computer most differences fit in a single byte.
+ *
+ * Unknown columns are skipped, so new fields can be added without
+ * bumping the version. The blobs are zlib-compressed by git anyway, so
+ * there is no second layer of compression.
+ */
+#define SAMPLE_BLOB_MAGIC "\x89SMP"
+#define SAMPLE_BLOB_VERSION 1
+
+extern void encode_samples(struct membuffer *b, const struct divecomputer *dc);
+extern bool is_sample_blob(const void *data, size_t len);
+extern bool decode_samples(const void *data, size_t len, struct divecomputer *dc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLECODEC_H
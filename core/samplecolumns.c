@@ -0,0 +1,181 @@
+// SPDX-License-Identifier: GPL-2.0
+/* samplecolumns.c */
+/* structure-of-arrays storage of the samples of a divecomputer */
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dive.h"
+#include "memusage.h"
+#include "samplecolumns.h"
+
+bool pack_loaded_samples = false;
+
+#define SAMPLE_FIELD(f) { offsetof(struct sample, f), sizeof(((struct sample *)0)->f) }
+
+/* This has to list all fields of struct sample */
+static const struct sample_field {
+	size_t offset, size;
+} sample_fields[] = {
+	SAMPLE_FIELD(time),
+	SAMPLE_FIELD(depth),
+	SAMPLE_FIELD(stoptime),
+	SAMPLE_FIELD(ndl),
+	SAMPLE_FIELD(tts),
+	SAMPLE_FIELD(rbt),
+	SAMPLE_FIELD(stopdepth),
+	SAMPLE_FIELD(temperature),
+	SAMPLE_FIELD(pressure[0]),
+	SAMPLE_FIELD(pressure[1]),
+	SAMPLE_FIELD(setpoint),
+	SAMPLE_FIELD(o2sensor[0]),
+	SAMPLE_FIELD(o2sensor[1]),
+	SAMPLE_FIELD(o2sensor[2]),
+	SAMPLE_FIELD(bearing),
+	SAMPLE_FIELD(sensor[0]),
+	SAMPLE_FIELD(sensor[1]),
+	SAMPLE_FIELD(cns),
+	SAMPLE_FIELD(heartbeat),
+	SAMPLE_FIELD(sac),
+	SAMPLE_FIELD(in_deco),
+	SAMPLE_FIELD(manually_entered),
+};
+#define NR_SAMPLE_FIELDS (sizeof(sample_fields) / sizeof(sample_fields[0]))
+
+struct sample_columns {
+	int refcount;	/* Packed samples are immutable and shared between copies of a divecomputer */
+	int nr;
+	/* The values of the fields that don't have a column */
+	struct sample constant;
+	/* One array per entry of sample_fields, NULL for constant fields */
+	char *column[NR_SAMPLE_FIELDS];
+};
+
+static void free_columns(struct sample_columns *columns)
+{
+	for (size_t f = 0; f < NR_SAMPLE_FIELDS; f++)
+		free(columns->column[f]);
+	free(columns);
+}
+
+static bool is_constant_field(const struct sample *samples, int nr, const struct sample_field *field)
+{
+	const char *first = (const char *)samples + field->offset;
+	for (int i = 1; i < nr; i++) {
+		if (memcmp((const char *)(samples + i) + field->offset, first, field->size))
+			return false;
+	}
+	return true;
+}
+
+void pack_samples(struct divecomputer *dc)
+{
+	struct sample_columns *columns;
+	int nr = dc->samples;
+
+	if (!nr || dc->packed_samples)
+		return;
+	columns = calloc(1, sizeof(*columns));
+	if (!columns)
+		return;
+	columns->refcount = 1;
+	columns->nr = nr;
+	for (size_t f = 0; f < NR_SAMPLE_FIELDS; f++) {
+		const struct sample_field *field = &sample_fields[f];
+		char *column;
+
+		if (is_constant_field(dc->sample, nr, field)) {
+			memcpy((char *)&columns->constant + field->offset, (char *)dc->sample + field->offset, field->size);
+			continue;
+		}
+		column = malloc(nr * field->size);
+		if (!column) {
+			free_columns(columns);
+			return;
+		}
+		for (int i = 0; i < nr; i++)
+			memcpy(column + i * field->size, (char *)(dc->sample + i) + field->offset, field->size);
+		columns->column[f] = column;
+	}
+
+	free(dc->sample);
+	dc->sample = NULL;
+	dc->samples = dc->alloc_samples = 0;
+	dc->packed_samples = columns;
+	memusage_count_alloc(MEM_PACKED_SAMPLES, packed_samples_size(dc));
+}
+
+/* Write the packed samples into an array of at least nr_packed_samples() entries */
+void get_packed_samples(const struct divecomputer *dc, struct sample *samples)
+{
+	const struct sample_columns *columns = dc->packed_samples;
+
+	if (!columns)
+		return;
+	for (int i = 0; i < columns->nr; i++)
+		samples[i] = columns->constant;
+	for (size_t f = 0; f < NR_SAMPLE_FIELDS; f++) {
+		const struct sample_field *field = &sample_fields[f];
+		const char *column = columns->column[f];
+
+		if (!column)
+			continue;
+		for (int i = 0; i < columns->nr; i++)
+			memcpy((char *)(samples + i) + field->offset, column + i * field->size, field->size);
+	}
+}
+
+int nr_packed_samples(const struct divecomputer *dc)
+{
+	return dc->packed_samples ? dc->packed_samples->nr : 0;
+}
+
+/* The memory used by the packed samples, which may be shared with copies of the divecomputer */
+size_t packed_samples_size(const struct divecomputer *dc)
+{
+	const struct sample_columns *columns = dc->packed_samples;
+	size_t size;
+
+	if (!columns)
+		return 0;
+	size = sizeof(*columns);
+	for (size_t f = 0; f < NR_SAMPLE_FIELDS; f++) {
+		if (columns->column[f])
+			size += columns->nr * sample_fields[f].size;
+	}
+	return size;
+}
+
+void unpack_samples(struct divecomputer *dc)
+{
+	int nr = nr_packed_samples(dc);
+
+	if (!nr)
+		return;
+	free(dc->sample);
+	dc->sample = malloc(nr * sizeof(struct sample));
+	if (!dc->sample) {
+		dc->samples = dc->alloc_samples = 0;
+		return;
+	}
+	get_packed_samples(dc, dc->sample);
+	dc->samples = dc->alloc_samples = nr;
+	free_packed_samples(dc);
+}
+
+/* Unpacking a shared divecomputer only drops its reference */
+void free_packed_samples(struct divecomputer *dc)
+{
+	if (!dc->packed_samples)
+		return;
+	if (__atomic_sub_fetch(&dc->packed_samples->refcount, 1, __ATOMIC_ACQ_REL) == 0)
+		free_columns(dc->packed_samples);
+	dc->packed_samples = NULL;
+}
+
+void share_packed_samples(const struct divecomputer *s, struct divecomputer *d)
+{
+	d->packed_samples = s->packed_samples;
+	if (d->packed_samples)
+		__atomic_add_fetch(&d->packed_samples->refcount, 1, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef SAMPLECOLUMNS_H
+#define SAMPLECOLUMNS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct divecomputer;
+struct sample;
+
+/*
+ * Compact storage for the samples of a divecomputer that is not in use.
+ *
+ * Most fields of struct sample have the same value in all samples of a
+ * typical dive (no o2 sensors, no heartbeat, no bearing, ...), so the
+ * samples are stored as one array per field and fields that are constant
+ * over the whole dive are stored only once. Time and depth thus practically
+ * always get a column, the other fields only if they are actually used.
+ *
+ * A packed divecomputer has samples set to 0, just like a divecomputer of
+ * a lazily loaded git logbook. load_samples() unpacks the samples, so code
+ * that has to call that function anyway needs no further changes.
+ *
+ * Since packed samples are never modified, copies of a packed divecomputer
+ * share them. Only when a copy is unpacked, it gets its own sample array.
+ */
+extern bool pack_loaded_samples;
+
+extern void pack_samples(struct divecomputer *dc);
+extern void unpack_samples(struct divecomputer *dc);
+extern void free_packed_samples(struct divecomputer *dc);
+extern void share_packed_samples(const struct divecomputer *s, struct divecomputer *d);
+extern int nr_packed_samples(const struct divecomputer *dc);
+extern size_t packed_samples_size(const struct divecomputer *dc);
+extern void get_packed_samples(const struct divecomputer *dc, struct sample *samples);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLECOLUMNS_H
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0
+/* sampleresidency.c */
+/* evict the samples of dives that were not accessed recently */
+#include <stdlib.h>
+#include <string.h>
+
+#include "dive.h"
+#include "samplecolumns.h"
+#include "sampleresidency.h"
+
+#define MIN_RESIDENT_DIVES 2
+
+int sample_residency_budget = 0;
+
+/* Unique ids of the dives with loaded samples, most recently used first */
+static int *resident;
+static int nr_resident, allocated_resident;
+
+static size_t dive_sample_size(const struct dive *d)
+{
+	const struct divecomputer *dc;
+	size_t size = 0;
+
+	for_each_dc (d, dc)
+		size += dc->alloc_samples * sizeof(struct sample);
+	return size;
+}
+
+static void evict_samples(struct dive *d)
+{
+	struct divecomputer *dc;
+
+	for_each_dc (d, dc) {
+		if (!dc->samples)
+			continue;
+		if (dc->sample_reload_repo) {
+			free(dc->sample);
+			dc->sample = NULL;
+			dc->samples = dc->alloc_samples = 0;
+			dc->sample_repo = dc->sample_reload_repo;
+		} else {
+			pack_samples(dc);
+		}
+	}
+}
+
+static void remove_resident(int idx)
+{
+	memmove(resident + idx, resident + idx + 1, (nr_resident - idx - 1) * sizeof(int));
+	nr_resident--;
+}
+
+static void add_resident(int id)
+{
+	for (int i = 0; i < nr_resident; i++) {
+		if (resident[i] == id) {
+			remove_resident(i);
+			break;
+		}
+	}
+	if (nr_resident >= allocated_resident) {
+		int *new_resident;
+		allocated_resident = (nr_resident + 8) * 3 / 2;
+		new_resident = realloc(resident, allocated_resident * sizeof(int));
+		if (!new_resident)
+			return;
+		resident = new_resident;
+	}
+	memmove(resident + 1, resident, nr_resident * sizeof(int));
+	resident[0] = id;
+	nr_resident++;
+}
+
+/* Only dives of the dive table are tracked: copies are owned by their users */
+void touch_dive_samples(struct dive *d)
+{
+	size_t budget = (size_t)sample_residency_budget * 1024 * 1024;
+	size_t total = 0;
+
+	if (!budget || !d || (nr_resident && resident[0] == d->id))
+		return;
+	if (get_dive_by_uniq_id(d->id) != d)
+		return;
+	add_resident(d->id);
+	for (int i = 0; i < nr_resident; ) {
+		struct dive *r = get_dive_by_uniq_id(resident[i]);
+		size_t size;
+
+		if (!r) {
+			remove_resident(i);
+			continue;
+		}
+		size = dive_sample_size(r);
+		if (i >= MIN_RESIDENT_DIVES && r != current_dive && total + size > budget) {
+			evict_samples(r);
+			remove_resident(i);
+			continue;
+		}
+		total += size;
+		i++;
+	}
+}
+
+void clear_sample_residency(void)
+{
+	free(resident);
+	resident = NULL;
+	nr_resident = allocated_resident = 0;
+}
+
+bool dive_samples_loaded(const struct dive *d)
+{
+	const struct divecomputer *dc;
+
+	for_each_dc (d, dc) {
+		if (dc->sample_repo || dc->packed_samples)
+			return false;
+	}
+	return true;
+}
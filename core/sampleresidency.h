@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef SAMPLERESIDENCY_H
+#define SAMPLERESIDENCY_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dive;
+
+/*
+ * Keep only the samples of recently accessed dives in memory.
+ *
+ * load_samples() registers the dive as most recently used. When the
+ * samples of the registered dives exceed sample_residency_budget MB,
+ * the samples of the least recently used dives are evicted: samples
+ * that are unchanged since they were read from a git logbook are freed
+ * and will be read again from the repository on the next load_samples().
+ * All other samples are packed (see samplecolumns.h).
+ *
+ * The current dive and the two most recently used dives are never
+ * evicted, so that code working on two dives at once (e.g. merging)
+ * may keep pointers to the samples of both.
+ *
+ * A budget of 0 means no limit, which is the default.
+ */
+extern int sample_residency_budget;
+
+extern void touch_dive_samples(struct dive *d);
+extern void clear_sample_residency(void);
+
+/*
+ * False if loading the samples of other dives evicted the samples of
+ * this dive again. Code that loads the samples of a batch of dives
+ * before processing them has to check this.
+ */
+extern bool dive_samples_loaded(const struct dive *d);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAMPLERESIDENCY_H
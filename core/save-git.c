@@ -23,15 +23,18 @@
 #include "subsurface-string.h"
 #include "trip.h"
 #include "device.h"
+#include "fingerprint.h"
 #include "errorhelper.h"
 #include "membuffer.h"
 #include "git-access.h"
 #include "version.h"
 #include "picture.h"
+#include "samplecodec.h"
 #include "qthelper.h"
 #include "gettext.h"
 #include "tag.h"
 #include "subsurface-time.h"
+#include "trace.h"
 
 #define VA_BUF(b, fmt) do { va_list args; va_start(args, fmt); put_vformat(b, fmt, args); va_end(args); } while (0)
 
@@ -247,7 +250,10 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 {
 	int idx;
 
-	put_format(b, "%3u:%02u", FRACTION(sample->time.seconds, 60));
+	/* Right-align the minutes in three columns */
+	if (sample->time.seconds < 100 * 60)
+		put_string(b, sample->time.seconds < 10 * 60 ? "  " : " ");
+	put_minutes(b, "", sample->time.seconds, "");
 	put_milli(b, " ", sample->depth.mm, "m");
 	put_temperature(b, sample->temperature, " ", "°C");
 
@@ -273,7 +279,7 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 			 * mode, and "old->sensor[0]" contains that index.
 			 */
 			if (sensor != old->sensor[0]) {
-				put_format(b, " sensor=%d", sensor);
+				put_integer(b, " sensor=", sensor, "");
 				old->sensor[0] = sensor;
 			}
 			continue;
@@ -281,24 +287,24 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 
 		/* The new-style format is much simpler: the sensor is always encoded */
 		put_pressure(b, p, " ", "bar");
-		put_format(b, ":%d", sensor);
+		put_integer(b, ":", sensor, "");
 	}
 
 	/* the deco/ndl values are stored whenever they change */
 	if (sample->ndl.seconds != old->ndl.seconds) {
-		put_format(b, " ndl=%u:%02u", FRACTION(sample->ndl.seconds, 60));
+		put_minutes(b, " ndl=", sample->ndl.seconds, "");
 		old->ndl = sample->ndl;
 	}
 	if (sample->tts.seconds != old->tts.seconds) {
-		put_format(b, " tts=%u:%02u", FRACTION(sample->tts.seconds, 60));
+		put_minutes(b, " tts=", sample->tts.seconds, "");
 		old->tts = sample->tts;
 	}
 	if (sample->in_deco != old->in_deco) {
-		put_format(b, " in_deco=%d", sample->in_deco ? 1 : 0);
+		put_integer(b, " in_deco=", sample->in_deco ? 1 : 0, "");
 		old->in_deco = sample->in_deco;
 	}
 	if (sample->stoptime.seconds != old->stoptime.seconds) {
-		put_format(b, " stoptime=%u:%02u", FRACTION(sample->stoptime.seconds, 60));
+		put_minutes(b, " stoptime=", sample->stoptime.seconds, "");
 		old->stoptime = sample->stoptime;
 	}
 
@@ -308,12 +314,12 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 	}
 
 	if (sample->cns != old->cns) {
-		put_format(b, " cns=%u%%", sample->cns);
+		put_integer(b, " cns=", sample->cns, "%");
 		old->cns = sample->cns;
 	}
 
 	if (sample->rbt.seconds != old->rbt.seconds) {
-		put_format(b, " rbt=%u:%02u", FRACTION(sample->rbt.seconds, 60));
+		put_minutes(b, " rbt=", sample->rbt.seconds, "");
 		old->rbt.seconds = sample->rbt.seconds;
 	}
 
@@ -423,7 +429,8 @@ static void save_dc(struct membuffer *b, struct dive *dive, struct divecomputer
 
 	save_extra_data(b, dc->extra_data);
 	save_events(b, dive, dc->events);
-	save_samples(b, dive, dc);
+	if (git_sample_format != GIT_SAMPLES_BINARY)
+		save_samples(b, dive, dc);
 }
 
 /*
@@ -474,6 +481,7 @@ static void create_dive_buffer(struct dive *dive, struct membuffer *b)
 struct dir {
 	git_treebuilder *files;
 	struct dir *subdirs, *sibling;
+	unsigned char *git_id;	/* if set, store the id of the written tree here */
 	char unique, name[1];
 };
 
@@ -520,6 +528,7 @@ static struct dir *new_directory(git_repository *repo, struct dir *parent, struc
 	 * and an empty treebuilder list of files.
 	 */
 	subdir->subdirs = NULL;
+	subdir->git_id = NULL;
 	git_treebuilder_new(&subdir->files, repo, NULL);
 	memcpy(subdir->name, name, len);
 	subdir->unique = 0;
@@ -601,18 +610,139 @@ static int blob_insert(git_repository *repo, struct dir *tree, struct membuffer
 	return ret;
 }
 
-static int save_one_divecomputer(git_repository *repo, struct dir *tree, struct dive *dive, struct divecomputer *dc, int idx)
+/*
+ * Creating the dive and divecomputer blobs only depends on the dive
+ * itself, so for all dives that have to be written, the blobs are
+ * formatted up-front on the thread pool. Only the insertion into the
+ * git repository is done serially when walking the dives.
+ */
+struct dive_blobs {
+	struct dive *dive;
+	struct membuffer dive_buf;
+	int nr_dcs;
+	struct membuffer *dc_bufs;
+	struct membuffer *sample_bufs;	/* Binary samples, NULL for the text format */
+};
+
+struct formatted_dives {
+	int nr;
+	struct dive_blobs *blobs;
+};
+
+static void format_one_dive(int idx, void *data)
+{
+	struct dive_blobs *blobs = (struct dive_blobs *)data + idx;
+	struct divecomputer *dc;
+	int i;
+
+	create_dive_buffer(blobs->dive, &blobs->dive_buf);
+	for (dc = &blobs->dive->dc, i = 0; dc; dc = dc->next, i++) {
+		save_dc(&blobs->dc_bufs[i], blobs->dive, dc);
+		if (blobs->sample_bufs && dc->samples)
+			encode_samples(&blobs->sample_bufs[i], dc);
+	}
+}
+
+static int dive_blobs_cmp(const void *_a, const void *_b)
+{
+	const struct dive *a = ((const struct dive_blobs *)_a)->dive;
+	const struct dive *b = ((const struct dive_blobs *)_b)->dive;
+	return a < b ? -1 : a > b ? 1 : 0;
+}
+
+static bool dive_needs_writing(struct dive *dive, bool select_only, bool cached_ok)
+{
+	if (select_only && !dive->selected)
+		return false;
+	return !cached_ok || !dive_cache_is_valid(dive);
+}
+
+static void format_dives(struct formatted_dives *formatted, bool select_only, bool cached_ok)
+{
+	int i, nr;
+	struct dive *dive;
+	struct divecomputer *dc;
+
+	formatted->nr = 0;
+	formatted->blobs = NULL;
+	for_each_dive(i, dive) {
+		if (dive_needs_writing(dive, select_only, cached_ok))
+			formatted->nr++;
+	}
+	if (!formatted->nr)
+		return;
+
+	formatted->blobs = calloc(formatted->nr, sizeof(struct dive_blobs));
+	nr = 0;
+	for_each_dive(i, dive) {
+		struct dive_blobs *blobs;
+
+		if (!dive_needs_writing(dive, select_only, cached_ok))
+			continue;
+		/* Loading samples accesses the repository, so do that serially */
+		load_samples(dive);
+		blobs = &formatted->blobs[nr++];
+		blobs->dive = dive;
+		for (dc = &dive->dc; dc; dc = dc->next)
+			blobs->nr_dcs++;
+		blobs->dc_bufs = calloc(blobs->nr_dcs, sizeof(struct membuffer));
+		if (git_sample_format != GIT_SAMPLES_TEXT)
+			blobs->sample_bufs = calloc(blobs->nr_dcs, sizeof(struct membuffer));
+	}
+	run_in_parallel(formatted->nr, format_one_dive, formatted->blobs);
+
+	/* Sort by dive, so that save_one_dive() can find the blobs */
+	qsort(formatted->blobs, formatted->nr, sizeof(struct dive_blobs), dive_blobs_cmp);
+}
+
+static struct dive_blobs *find_dive_blobs(const struct formatted_dives *formatted, struct dive *dive)
+{
+	struct dive_blobs key = { .dive = dive };
+	if (!formatted->nr)
+		return NULL;
+	return bsearch(&key, formatted->blobs, formatted->nr, sizeof(struct dive_blobs), dive_blobs_cmp);
+}
+
+/* Frees the buffers of dives that were not written for whatever reason */
+static void free_formatted_dives(struct formatted_dives *formatted)
+{
+	for (int i = 0; i < formatted->nr; i++) {
+		struct dive_blobs *blobs = &formatted->blobs[i];
+		free_buffer(&blobs->dive_buf);
+		for (int j = 0; j < blobs->nr_dcs; j++) {
+			free_buffer(&blobs->dc_bufs[j]);
+			if (blobs->sample_bufs)
+				free_buffer(&blobs->sample_bufs[j]);
+		}
+		free(blobs->dc_bufs);
+		free(blobs->sample_bufs);
+	}
+	free(formatted->blobs);
+}
+
+static int save_one_divecomputer(git_repository *repo, struct dir *tree, struct membuffer *buf, int idx)
 {
 	int ret;
-	struct membuffer buf = { 0 };
 
-	save_dc(&buf, dive, dc);
-	ret = blob_insert(repo, tree, &buf, "Divecomputer%c%03u", idx ? '-' : 0, idx);
+	ret = blob_insert(repo, tree, buf, "Divecomputer%c%03u", idx ? '-' : 0, idx);
 	if (ret)
 		report_error("divecomputer tree insert failed");
 	return ret;
 }
 
+/* The binary samples are named like the divecomputer they belong to */
+static int save_one_sample_blob(git_repository *repo, struct dir *tree, struct membuffer *buf, int idx)
+{
+	int ret;
+
+	if (!buf->len)
+		return 0;
+	ret = blob_insert(repo, tree, buf, "Samples%c%03u", idx ? '-' : 0, idx);
+	if (ret)
+		report_error("samples tree insert failed");
+	return ret;
+}
+
 static int save_one_picture(git_repository *repo, struct dir *dir, struct picture *pic)
 {
 	int offset = pic->offset.seconds;
@@ -647,12 +777,17 @@ static int save_pictures(git_repository *repo, struct dir *dir, struct dive *div
 	return 0;
 }
 
-static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *dive, struct tm *tm, bool cached_ok)
+/*
+ * If remember_id is set, the id of the written dive tree is stored in
+ * the dive, so that the next save can reuse it.
+ */
+static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *dive, struct tm *tm, bool cached_ok,
+			 bool remember_id, const struct formatted_dives *formatted)
 {
-	struct divecomputer *dc;
-	struct membuffer buf = { 0 }, name = { 0 };
+	struct membuffer name = { 0 };
+	struct dive_blobs *blobs;
 	struct dir *subdir;
-	int ret, nr;
+	int ret, nr, i;
 
 	/* Create dive directory */
 	create_dive_name(dive, &name, tm);
@@ -672,13 +807,20 @@ static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *di
 		return 0;
 	}
 
+	blobs = find_dive_blobs(formatted, dive);
+	if (!blobs) {
+		free_buffer(&name);
+		return report_error("dive %d was not formatted", dive->number);
+	}
+
 	subdir = new_directory(repo, tree, &name);
 	subdir->unique = 1;
+	if (remember_id)
+		subdir->git_id = dive->git_id;
 	free_buffer(&name);
 
-	create_dive_buffer(dive, &buf);
 	nr = dive->number;
-	ret = blob_insert(repo, subdir, &buf,
+	ret = blob_insert(repo, subdir, &blobs->dive_buf,
 		"Dive%c%d", nr ? '-' : 0, nr);
 	if (ret)
 		return report_error("dive save-file tree insert failed");
@@ -688,12 +830,12 @@ static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *di
 	 * computer, use index 0 for that (which disables the index
 	 * generation when naming it).
 	 */
-	dc = &dive->dc;
-	nr = dc->next ? 1 : 0;
-	do {
-		save_one_divecomputer(repo, subdir, dive, dc, nr++);
-		dc = dc->next;
-	} while (dc);
+	nr = blobs->nr_dcs > 1 ? 1 : 0;
+	for (i = 0; i < blobs->nr_dcs; i++) {
+		if (blobs->sample_bufs)
+			save_one_sample_blob(repo, subdir, &blobs->sample_bufs[i], nr);
+		save_one_divecomputer(repo, subdir, &blobs->dc_bufs[i], nr++);
+	}
 
 	/* Save the picture data, if any */
 	save_pictures(repo, subdir, dive);
@@ -788,9 +930,10 @@ static void verify_shared_date(timestamp_t when, struct tm *tm)
 #define MIN_TIMESTAMP (0)
 #define MAX_TIMESTAMP (0x7fffffffffffffff)
 
-static int save_one_trip(git_repository *repo, struct dir *tree, dive_trip_t *trip, struct tm *tm, bool cached_ok)
+static int save_one_trip(git_repository *repo, struct dir *tree, dive_trip_t *trip, struct tm *tm, bool cached_ok,
+			 const struct formatted_dives *formatted)
 {
-	int i;
+	int i, ret;
 	struct dive *dive;
 	struct dir *subdir;
 	struct membuffer name = { 0 };
@@ -798,8 +941,21 @@ static int save_one_trip(git_repository *repo, struct dir *tree, dive_trip_t *tr
 
 	/* Create trip directory */
 	create_trip_name(trip, &name, tm);
+
+	/* Like for dives, an unchanged trip can reuse the whole directory */
+	if (cached_ok && trip_cache_is_valid(trip)) {
+		git_oid oid;
+		git_oid_fromraw(&oid, trip->git_id);
+		ret = tree_insert(tree->files, mb_cstring(&name), 1, &oid, GIT_FILEMODE_TREE);
+		free_buffer(&name);
+		if (ret)
+			return report_error("cached trip tree insert failed");
+		return 0;
+	}
+
 	subdir = new_directory(repo, tree, &name);
 	subdir->unique = 1;
+	subdir->git_id = trip->git_id;
 	free_buffer(&name);
 
 	/* Trip description file */
@@ -808,9 +964,8 @@ static int save_one_trip(git_repository *repo, struct dir *tree, dive_trip_t *tr
 	/* Make sure we write out the dates to the dives consistently */
 	first = MAX_TIMESTAMP;
 	last = MIN_TIMESTAMP;
-	for_each_dive(i, dive) {
-		if (dive->divetrip != trip)
-			continue;
+	for (i = 0; i < trip->dives.nr; i++) {
+		dive = trip->dives.dives[i];
 		if (dive->when < first)
 			first = dive->when;
 		if (dive->when > last)
@@ -820,10 +975,8 @@ static int save_one_trip(git_repository *repo, struct dir *tree, dive_trip_t *tr
 	verify_shared_date(last, tm);
 
 	/* Save each dive in the directory */
-	for_each_dive(i, dive) {
-		if (dive->divetrip == trip)
-			save_one_dive(repo, subdir, dive, tm, cached_ok);
-	}
+	for (i = 0; i < trip->dives.nr; i++)
+		save_one_dive(repo, subdir, trip->dives.dives[i], tm, cached_ok, true, formatted);
 
 	return 0;
 }
@@ -866,13 +1019,30 @@ static void save_one_device(void *_b, const char *model, uint32_t deviceid,
 	put_string(b, "\n");
 }
 
+static void save_fingerprints(struct membuffer *b)
+{
+	for (int i = 0; i < fingerprint_table.nr; i++) {
+		const struct fingerprint_record *fp = &fingerprint_table.fingerprints[i];
+		char *data = fingerprint_data_to_hex(fp);
+
+		show_utf8(b, "fingerprint ", fp->model, "");
+		put_format(b, " deviceid=%08x diveid=%08x data=%s\n", fp->deviceid, fp->diveid, data ?: "");
+		free(data);
+	}
+}
+
 static void save_settings(git_repository *repo, struct dir *tree)
 {
 	struct membuffer b = { 0 };
 
 	put_format(&b, "version %d\n", DATAFORMAT_VERSION);
 	call_for_each_dc(&b, save_one_device, false);
+	save_fingerprints(&b);
 	cond_put_format(autogroup, &b, "autogroup\n");
+	if (git_sample_format == GIT_SAMPLES_BINARY)
+		put_string(&b, "samples binary\n");
+	else if (git_sample_format == GIT_SAMPLES_BINARY_AND_TEXT)
+		put_string(&b, "samples binary+text\n");
 	save_units(&b);
 	if (prefs.tankbar)
 		put_string(&b, "prefs TANKBAR\n");
@@ -1004,6 +1174,7 @@ static int create_git_tree(git_repository *repo, struct dir *root, bool select_o
 	int i;
 	struct dive *dive;
 	dive_trip_t *trip;
+	struct formatted_dives formatted;
 
 	git_storage_update_progress(translate("gettextFromC", "Start saving data"));
 	save_settings(repo, root);
@@ -1016,6 +1187,7 @@ static int create_git_tree(git_repository *repo, struct dir *root, bool select_o
 
 	/* save the dives */
 	git_storage_update_progress(translate("gettextFromC", "Start saving dives"));
+	format_dives(&formatted, select_only, cached_ok);
 	for_each_dive(i, dive) {
 		struct tm tm;
 		struct dir *tree;
@@ -1042,12 +1214,13 @@ static int create_git_tree(git_repository *repo, struct dir *root, bool select_o
 			trip->saved = 1;
 
 			/* Pass that new subdirectory in for save-trip */
-			save_one_trip(repo, tree, trip, &tm, cached_ok);
+			save_one_trip(repo, tree, trip, &tm, cached_ok, &formatted);
 			continue;
 		}
 
-		save_one_dive(repo, tree, dive, &tm, cached_ok);
+		save_one_dive(repo, tree, dive, &tm, cached_ok, !select_only, &formatted);
 	}
+	free_formatted_dives(&formatted);
 	git_storage_update_progress(translate("gettextFromC", "Done creating local cache"));
 	return 0;
 }
@@ -1258,8 +1431,10 @@ static int create_new_commit(git_repository *repo, const char *remote, const cha
 	 * commit_id, otherwise we'll think that the cache is valid and fail when building
 	 * the tree when we actually try to store the dive data
 	 */
-	if (! create_empty)
+	if (! create_empty) {
 		set_git_id(&commit_id);
+		saved_git_sample_format = git_sample_format;
+	}
 
 	return 0;
 }
@@ -1273,8 +1448,11 @@ static int write_git_tree(git_repository *repo, struct dir *tree, git_oid *resul
 	while ((subdir = tree->subdirs) != NULL) {
 		git_oid id;
 
-		if (!write_git_tree(repo, subdir, &id))
+		if (!write_git_tree(repo, subdir, &id)) {
 			tree_insert(tree->files, subdir->name, subdir->unique, &id, GIT_FILEMODE_TREE);
+			if (subdir->git_id)
+				memcpy(subdir->git_id, id.id, 20);
+		}
 		tree->subdirs = subdir->sibling;
 		free(subdir);
 	};
@@ -1310,6 +1488,9 @@ int do_git_save(git_repository *repo, const char *branch, const char *remote, bo
 	 * have the original git commit we loaded in the repo
 	 */
 	cached_ok = try_to_find_parent(saved_git_id, repo);
+	/* Changing the sample format rewrites all dives */
+	if (git_sample_format != saved_git_sample_format)
+		cached_ok = false;
 
 	/* Start with an empty tree: no subdirectories, no files */
 	tree.name[0] = 0;
@@ -1331,6 +1512,8 @@ int do_git_save(git_repository *repo, const char *branch, const char *remote, bo
 	/* And save the tree! */
 	if (create_new_commit(repo, remote, branch, &id, create_empty))
 		return report_error("creating commit failed");
+	if (!select_only && !create_empty)
+		save_git_snapshot(repo);
 
 	/* now sync the tree with the remote server */
 	if (remote && !git_local_only)
@@ -1344,7 +1527,9 @@ int git_save_dives(struct git_repository *repo, const char *branch, const char *
 
 	if (repo == dummy_git_repository)
 		return report_error("Unable to open git repository '%s'", branch);
+	TRACE_BEGIN("git_save_dives");
 	ret = do_git_save(repo, branch, remote, select_only, false);
+	TRACE_END();
 	git_repository_free(repo);
 	free((void *)branch);
 	return ret;
@@ -12,10 +12,15 @@
 #include "errorhelper.h"
 #include "file.h"
 #include "picture.h"
+#include "sampleresidency.h"
 #include "tag.h"
 #include "subsurface-time.h"
 #include "trip.h"
+#include <errno.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 static void write_attribute(struct membuffer *b, const char *att_name, const char *value, const char *separator)
 {
@@ -26,7 +31,8 @@ static void write_attribute(struct membuffer *b, const char *att_name, const cha
 	put_format(b, "\"%s", separator);
 }
 
-static void save_photos(struct membuffer *b, const char *photos_dir, struct dive *dive)
+/* The photos themselves are copied by exportHtmlInitLogic() */
+static void save_photos(struct membuffer *b, struct dive *dive)
 {
 	if (dive->pictures.nr <= 0)
 		return;
@@ -35,12 +41,13 @@ static void save_photos(struct membuffer *b, const char *photos_dir, struct dive
 	FOR_EACH_PICTURE(dive) {
 		put_string(b, separator);
 		separator = ", ";
-		char *fname = get_file_name(local_file_path(picture));
+		const char *path = local_file_path(picture);
+		char *fname = get_file_name(path);
 		put_string(b, "{\"filename\":\"");
 		put_quoted(b, fname, 1, 0);
 		put_string(b, "\"}");
-		copy_image_and_overwrite(local_file_path(picture), photos_dir, fname);
 		free(fname);
+		free((void *)path);
 	}
 	put_string(b, "],");
 }
@@ -172,6 +179,7 @@ static void put_cylinder_HTML(struct membuffer *b, struct dive *dive)
 }
 
 
+/* The samples must have been loaded */
 static void put_HTML_samples(struct membuffer *b, struct dive *dive)
 {
 	int i;
@@ -191,6 +199,70 @@ static void put_HTML_samples(struct membuffer *b, struct dive *dive)
 	put_string(b, "],");
 }
 
+static void put_base64(struct membuffer *b, const unsigned char *data, int len)
+{
+	static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	char out[4];
+
+	for (int i = 0; i < len; i += 3) {
+		unsigned int v = data[i] << 16;
+		if (i + 1 < len)
+			v |= data[i + 1] << 8;
+		if (i + 2 < len)
+			v |= data[i + 2];
+		out[0] = alphabet[(v >> 18) & 63];
+		out[1] = alphabet[(v >> 12) & 63];
+		out[2] = i + 1 < len ? alphabet[(v >> 6) & 63] : '=';
+		out[3] = i + 2 < len ? alphabet[v & 63] : '=';
+		put_bytes(b, out, 4);
+	}
+}
+
+static void put_varint_delta(struct membuffer *b, int64_t val)
+{
+	uint64_t zigzag = ((uint64_t)val << 1) ^ (uint64_t)(val >> 63);
+	char c;
+
+	while (zigzag >= 0x80) {
+		c = (char)(zigzag | 0x80);
+		put_bytes(b, &c, 1);
+		zigzag >>= 7;
+	}
+	c = (char)zigzag;
+	put_bytes(b, &c, 1);
+}
+
+/*
+ * The same four values per sample as put_HTML_samples(), but as zigzag
+ * varints of the difference to the previous sample, base64 encoded.
+ * This is a fraction of the size and the browser doesn't have to parse
+ * the arrays of all dives: unpack_samples() in list_lib.js decodes the
+ * samples of a dive when it is shown. The samples must have been loaded.
+ */
+static void put_HTML_packed_samples(struct membuffer *b, struct dive *dive)
+{
+	struct membuffer bytes = { 0 };
+	int64_t prev[4] = { 0 };
+	struct sample *s = dive->dc.sample;
+
+	put_format(b, "\"maxdepth\":%d,", dive->dc.maxdepth.mm);
+	put_format(b, "\"duration\":%d,", dive->dc.duration.seconds);
+	if (!dive->dc.samples)
+		return;
+
+	for (int i = 0; i < dive->dc.samples; i++, s++) {
+		int64_t val[4] = { s->time.seconds, s->depth.mm, s->pressure[0].mbar, s->temperature.mkelvin };
+		for (int j = 0; j < 4; j++) {
+			put_varint_delta(&bytes, val[j] - prev[j]);
+			prev[j] = val[j];
+		}
+	}
+	put_string(b, "\"packed_samples\":\"");
+	put_base64(b, (const unsigned char *)bytes.buffer, bytes.len);
+	put_string(b, "\",");
+	free_buffer(&bytes);
+}
+
 static void put_HTML_coordinates(struct membuffer *b, struct dive *dive)
 {
 	struct dive_site *ds = get_dive_site_for_dive(dive);
@@ -343,11 +415,17 @@ static void put_HTML_tags(struct membuffer *b, struct dive *dive, const char *pr
 	put_string(b, post);
 }
 
+struct html_options {
+	const char *photos_dir;
+	bool list_only;
+	bool packed_samples;
+};
+
 /* if exporting list_only mode, we neglect exporting the samples, bookmarks and cylinders */
-static void write_one_dive(struct membuffer *b, struct dive *dive, const char *photos_dir, int *dive_no, bool list_only)
+static void write_one_dive(struct membuffer *b, struct dive *dive, const struct html_options *options, int dive_no)
 {
 	put_string(b, "{");
-	put_format(b, "\"number\":%d,", *dive_no);
+	put_format(b, "\"number\":%d,", dive_no);
 	put_format(b, "\"subsurface_number\":%d,", dive->number);
 	put_HTML_date(b, dive, "\"date\":\"", "\",");
 	put_HTML_time(b, dive, "\"time\":\"", "\",");
@@ -369,84 +447,101 @@ static void write_one_dive(struct membuffer *b, struct dive *dive, const char *p
 	write_attribute(b, "divemaster", dive->divemaster, ", ");
 	write_attribute(b, "suit", dive->suit, ", ");
 	put_HTML_tags(b, dive, "\"tags\":", ",");
-	if (!list_only) {
+	if (!options->list_only) {
 		put_cylinder_HTML(b, dive);
 		put_weightsystem_HTML(b, dive);
-		put_HTML_samples(b, dive);
+		if (options->packed_samples)
+			put_HTML_packed_samples(b, dive);
+		else
+			put_HTML_samples(b, dive);
 		put_HTML_bookmarks(b, dive);
 		write_dive_status(b, dive);
-		if (photos_dir && strcmp(photos_dir, ""))
-			save_photos(b, photos_dir, dive);
+		if (options->photos_dir && strcmp(options->photos_dir, ""))
+			save_photos(b, dive);
 		write_divecomputers(b, dive);
 	}
 	put_HTML_notes(b, dive, "\"notes\":\"", "\"");
 	put_string(b, "}\n");
-	(*dive_no)++;
 }
 
-static void write_no_trip(struct membuffer *b, int *dive_no, bool selected_only, const char *photos_dir, const bool list_only, char *sep)
-{
-	int i;
+/*
+ * Like the XML save, the dives are formatted in parallel, in batches of
+ * that many dives, and then written in order. When writing to a file,
+ * the output is flushed in chunks, so that at most one batch of
+ * formatted dives is kept in memory.
+ */
+#define HTML_BATCH_SIZE 256
+#define HTML_CHUNK_SIZE (1024 * 1024)
+
+/* The dives and trips in the order they are written */
+enum html_item_type {
+	HTML_DIVE,
+	HTML_TRIP_START,
+	HTML_TRIP_END
+};
+
+struct html_item {
+	enum html_item_type type;
 	struct dive *dive;
-	char *separator = "";
-	bool found_sel_dive = 0;
+	dive_trip_t *trip;	/* NULL for the "Other" dives outside of trips */
+	int dive_no;
+	struct membuffer buf;	/* The formatted dive */
+};
+
+struct html_items {
+	int nr, alloc;
+	struct html_item *items;
+};
+
+struct html_batch {
+	const struct html_options *options;
+	struct html_item **dives;
+};
+
+static void add_html_item(struct html_items *items, enum html_item_type type, struct dive *dive, dive_trip_t *trip, int dive_no)
+{
+	struct html_item *item;
 
-	for_each_dive (i, dive) {
-		// write dive if it doesn't belong to any trip and the dive is selected
-		// or we are in exporting all dives mode.
-		if (!dive->divetrip && (dive->selected || !selected_only)) {
-			if (!found_sel_dive) {
-				put_format(b, "%c{", *sep);
-				(*sep) = ',';
-				put_format(b, "\"name\":\"Other\",");
-				put_format(b, "\"dives\":[");
-				found_sel_dive = 1;
-			}
-			put_string(b, separator);
-			separator = ", ";
-			write_one_dive(b, dive, photos_dir, dive_no, list_only);
-		}
+	if (items->nr >= items->alloc) {
+		items->alloc = (items->nr + 16) * 3 / 2;
+		items->items = realloc(items->items, items->alloc * sizeof(struct html_item));
+		if (!items->items)
+			exit(1);
 	}
-	if (found_sel_dive)
-		put_format(b, "]}\n\n");
+	item = &items->items[items->nr++];
+	memset(item, 0, sizeof(*item));
+	item->type = type;
+	item->dive = dive;
+	item->trip = trip;
+	item->dive_no = dive_no;
 }
 
-static void write_trip(struct membuffer *b, dive_trip_t *trip, int *dive_no, bool selected_only, const char *photos_dir, const bool list_only, char *sep)
+/* Without a trip, collect the dives that don't belong to any trip. Groups without exported dives are left out. */
+static void collect_group(struct html_items *items, dive_trip_t *trip, bool selected_only, int *dive_no)
 {
-	struct dive *dive;
-	char *separator = "";
-	bool found_sel_dive = 0;
+	int start = items->nr;
+	int nr = trip ? trip->dives.nr : dive_table.nr;
 
-	for (int i = 0; i < trip->dives.nr; i++) {
-		dive = trip->dives.dives[i];
+	add_html_item(items, HTML_TRIP_START, NULL, trip, 0);
+	for (int i = 0; i < nr; i++) {
+		struct dive *dive = trip ? trip->dives.dives[i] : dive_table.dives[i];
+		if (!trip && dive->divetrip)
+			continue;
 		if (!dive->selected && selected_only)
 			continue;
-
-		// save trip if found at least one selected dive.
-		if (!found_sel_dive) {
-			found_sel_dive = 1;
-			put_format(b, "%c {", *sep);
-			(*sep) = ',';
-			write_attribute(b, "name", trip->location, ", ");
-			put_format(b, "\"dives\":[");
-		}
-		put_string(b, separator);
-		separator = ", ";
-		write_one_dive(b, dive, photos_dir, dive_no, list_only);
+		add_html_item(items, HTML_DIVE, dive, trip, (*dive_no)++);
 	}
-
-	// close the trip object if contain dives.
-	if (found_sel_dive)
-		put_format(b, "]}\n\n");
+	if (items->nr == start + 1)
+		items->nr = start;
+	else
+		add_html_item(items, HTML_TRIP_END, NULL, trip, 0);
 }
 
-static void write_trips(struct membuffer *b, const char *photos_dir, bool selected_only, const bool list_only)
+static void collect_html_items(struct html_items *items, bool selected_only)
 {
 	int i, dive_no = 0;
 	struct dive *dive;
 	dive_trip_t *trip;
-	char sep_ = ' ';
-	char *sep = &sep_;
 
 	for (i = 0; i < trip_table.nr; ++i)
 		trip_table.trips[i]->saved = 0;
@@ -460,34 +555,122 @@ static void write_trips(struct membuffer *b, const char *photos_dir, bool select
 
 		/* We haven't seen this trip before - save it and all dives */
 		trip->saved = 1;
-		write_trip(b, trip, &dive_no, selected_only, photos_dir, list_only, sep);
+		collect_group(items, trip, selected_only, &dive_no);
 	}
 
 	/*Save all remaining trips into Others*/
-	write_no_trip(b, &dive_no, selected_only, photos_dir, list_only, sep);
+	collect_group(items, NULL, selected_only, &dive_no);
+}
+
+static void format_one_html_dive(int idx, void *data)
+{
+	struct html_batch *batch = data;
+	struct html_item *item = batch->dives[idx];
+
+	write_one_dive(&item->buf, item->dive, batch->options, item->dive_no);
+}
+
+static void write_trip_start(struct membuffer *b, dive_trip_t *trip, char sep)
+{
+	if (trip) {
+		put_format(b, "%c {", sep);
+		write_attribute(b, "name", trip->location, ", ");
+	} else {
+		put_format(b, "%c{", sep);
+		put_format(b, "\"name\":\"Other\",");
+	}
+	put_format(b, "\"dives\":[");
+}
+
+/* stream may be NULL, in which case the whole output is kept in the buffer */
+static void write_trips(struct membuffer *b, const struct html_options *options, bool selected_only, FILE *stream)
+{
+	struct html_items items = { 0 };
+	struct html_batch batch = { options, NULL };
+	int start, end, nr, i;
+	char sep = ' ';
+	const char *separator = "";
+	bool loaded;
+
+	collect_html_items(&items, selected_only);
+	batch.dives = malloc(HTML_BATCH_SIZE * sizeof(struct html_item *));
+	if (!batch.dives)
+		exit(1);
+
+	for (start = 0; start < items.nr; start = end) {
+		/* Loading samples accesses the repository, so do that serially */
+		nr = 0;
+		for (end = start; end < items.nr && nr < HTML_BATCH_SIZE; end++) {
+			if (items.items[end].type != HTML_DIVE)
+				continue;
+			if (!options->list_only)
+				load_samples(items.items[end].dive);
+			batch.dives[nr++] = &items.items[end];
+		}
+		/* With a sample budget, loading may have evicted other dives of the batch. Format those serially. */
+		loaded = true;
+		for (i = 0; i < nr && !options->list_only; i++)
+			loaded = loaded && dive_samples_loaded(batch.dives[i]->dive);
+		if (loaded)
+			run_in_parallel(nr, format_one_html_dive, &batch);
+
+		for (i = start; i < end; i++) {
+			struct html_item *item = &items.items[i];
+			switch (item->type) {
+			case HTML_DIVE:
+				put_string(b, separator);
+				separator = ", ";
+				if (loaded) {
+					put_bytes(b, item->buf.buffer, item->buf.len);
+					free_buffer(&item->buf);
+				} else {
+					load_samples(item->dive);
+					write_one_dive(b, item->dive, options, item->dive_no);
+				}
+				flush_buffer_if_full(b, stream, HTML_CHUNK_SIZE);
+				break;
+			case HTML_TRIP_START:
+				write_trip_start(b, item->trip, sep);
+				sep = ',';
+				separator = "";
+				break;
+			case HTML_TRIP_END:
+				put_format(b, "]}\n\n");
+				break;
+			}
+		}
+	}
+	free(batch.dives);
+	free(items.items);
 }
 
 void export_list(struct membuffer *b, const char *photos_dir, bool selected_only, const bool list_only)
 {
+	struct html_options options = { photos_dir, list_only, false };
+
 	put_string(b, "trips=[");
-	write_trips(b, photos_dir, selected_only, list_only);
+	write_trips(b, &options, selected_only, NULL);
 	put_string(b, "]");
 }
 
-void export_HTML(const char *file_name, const char *photos_dir, const bool selected_only, const bool list_only)
+void export_HTML(const char *file_name, const char *photos_dir, const bool selected_only, const bool list_only, const bool packed_samples)
 {
-	FILE *f;
-
+	struct html_options options = { photos_dir, list_only, packed_samples };
 	struct membuffer buf = { 0 };
-	export_list(&buf, photos_dir, selected_only, list_only);
+	FILE *f;
 
 	f = subsurface_fopen(file_name, "w+");
 	if (!f) {
 		report_error(translate("gettextFromC", "Can't open file %s"), file_name);
-	} else {
-		flush_buffer(&buf, f); /*check for writing errors? */
-		fclose(f);
+		return;
 	}
+	put_string(&buf, "trips=[");
+	write_trips(&buf, &options, selected_only, f);
+	put_string(&buf, "]");
+	flush_buffer(&buf, f);
+	if (ferror(f))
+		report_error(translate("gettextFromC", "Failed to save dives to %s (%s)"), file_name, strerror(errno));
+	fclose(f);
 	free_buffer(&buf);
 }
 
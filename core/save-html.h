@@ -21,7 +21,7 @@ void put_HTML_pressure_units(struct membuffer *b, pressure_t pressure, const cha
 void put_HTML_weight_units(struct membuffer *b, unsigned int grams, const char *pre, const char *post);
 void put_HTML_volume_units(struct membuffer *b, unsigned int ml, const char *pre, const char *post);
 
-void export_HTML(const char *file_name, const char *photos_dir, const bool selected_only, const bool list_only);
+void export_HTML(const char *file_name, const char *photos_dir, const bool selected_only, const bool list_only, const bool packed_samples);
 void export_list(struct membuffer *b, const char *photos_dir, bool selected_only, const bool list_only);
 
 void export_translation(const char *file_name);
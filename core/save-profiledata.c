@@ -1,36 +1,125 @@
 #include "core/profile.h"
+#include "core/deco.h"
+#include "core/divelist.h"
 #include "core/display.h"
 #include "core/errorhelper.h"
 #include "core/file.h"
 #include "core/membuffer.h"
+#include "core/qthelper.h"
+#include "core/sampleresidency.h"
 #include "core/subsurface-string.h"
 #include "core/save-profiledata.h"
 #include "core/version.h"
+#include <ctype.h>
 #include <errno.h>
+#include <string.h>
 
-static void put_int(struct membuffer *b, int val)
+/*
+ * One line of the profile data CSV. The header line of every dive decides
+ * which of its columns are written (see select_column()), the data lines
+ * of the dive then only write those.
+ */
+struct csv_line {
+	struct membuffer *b;
+	const char *columns;	/* Comma separated column names, NULL for all */
+	bool *selected;
+	int nr_selected, allocated;
+	int column;
+	bool empty;
+};
+
+static void start_line(struct csv_line *l)
+{
+	l->column = 0;
+	l->empty = true;
+}
+
+static void end_line(struct csv_line *l)
+{
+	put_string(l->b, "\n");
+}
+
+/* A trailing '*' in the list of columns matches any suffix, e.g. "ceiling_*" */
+static bool column_requested(const char *columns, const char *name)
+{
+	size_t len = strlen(name);
+
+	while (*columns) {
+		const char *end;
+		size_t n;
+
+		while (*columns == ',' || isspace((unsigned char)*columns))
+			columns++;
+		end = columns;
+		while (*end && *end != ',')
+			end++;
+		n = end - columns;
+		while (n > 0 && isspace((unsigned char)columns[n - 1]))
+			n--;
+		if (n > 0 && columns[n - 1] == '*' && !strncmp(columns, name, n - 1))
+			return true;
+		if (n == len && !strncmp(columns, name, n))
+			return true;
+		columns = end;
+	}
+	return false;
+}
+
+static void select_column(struct csv_line *l, const char *name)
 {
-	put_format(b, "\"%d\", ", val);
+	if (l->column >= l->allocated) {
+		l->allocated = (l->column + 16) * 3 / 2;
+		l->selected = realloc(l->selected, l->allocated * sizeof(*l->selected));
+		if (!l->selected)
+			exit(1);
+	}
+	l->selected[l->column] = !l->columns || column_requested(l->columns, name);
+	l->nr_selected = l->column + 1;
 }
 
-static void put_int_with_nl(struct membuffer *b, int val)
+/* Returns whether the next column is written and puts the separator if so */
+static bool next_column(struct csv_line *l)
 {
-	put_format(b, "\"%d\"\n", val);
+	int column = l->column++;
+
+	if (column < l->nr_selected && !l->selected[column])
+		return false;
+	if (!l->empty)
+		put_string(l->b, ", ");
+	l->empty = false;
+	return true;
 }
 
-static void put_csv_string(struct membuffer *b, const char *val)
+static void put_int(struct csv_line *l, int val)
 {
-	put_format(b, "\"%s\", ", val);
+	if (next_column(l))
+		put_integer(l->b, "\"", val, "\"");
 }
 
-static void put_csv_string_with_nl(struct membuffer *b, const char *val)
+static void put_csv_string(struct csv_line *l, const char *val)
 {
-	put_format(b, "\"%s\"\n", val);
+	if (next_column(l))
+		put_format(l->b, "\"%s\"", val);
 }
 
-static void put_double(struct membuffer *b, double val)
+static void put_double(struct csv_line *l, double val)
 {
-	put_format(b, "\"%f\", ", val);
+	if (next_column(l))
+		put_format(l->b, "\"%f\"", val);
+}
+
+static void put_header(struct csv_line *l, const char *name)
+{
+	select_column(l, name);
+	put_csv_string(l, name);
+}
+
+static void put_numbered_header(struct csv_line *l, const char *fmt, int nr)
+{
+	char name[64];
+
+	snprintf(name, sizeof(name), fmt, nr);
+	put_header(l, name);
 }
 
 static void put_video_time(struct membuffer *b, int secs)
@@ -42,130 +131,134 @@ static void put_video_time(struct membuffer *b, int secs)
 	put_format(b, "%d:%02d:%02d.000,", hours, mins, secs);
 }
 
-static void put_pd(struct membuffer *b, const struct plot_info *pi, int idx)
+static void put_pd(struct csv_line *l, const struct plot_info *pi, int idx)
 {
 	const struct plot_data *entry = pi->entry + idx;
 
-	put_int(b, entry->in_deco);
-	put_int(b,  entry->sec);
+	start_line(l);
+	put_int(l, entry->in_deco);
+	put_int(l, entry->sec);
 	for (int c = 0; c < pi->nr_cylinders; c++) {
-		put_int(b, get_plot_sensor_pressure(pi, idx, c));
-		put_int(b, get_plot_interpolated_pressure(pi, idx, c));
+		put_int(l, get_plot_sensor_pressure(pi, idx, c));
+		put_int(l, get_plot_interpolated_pressure(pi, idx, c));
 	}
-	put_int(b, entry->temperature);
-	put_int(b, entry->depth);
-	put_int(b, entry->ceiling);
+	put_int(l, entry->temperature);
+	put_int(l, entry->depth);
+	put_int(l, entry->ceiling);
 	for (int i = 0; i < 16; i++)
-		put_int(b, entry->ceilings[i]);
+		put_int(l, pi->tissues[idx].ceilings[i]);
 	for (int i = 0; i < 16; i++)
-		put_int(b, entry->percentages[i]);
-	put_int(b, entry->ndl);
-	put_int(b, entry->tts);
-	put_int(b, entry->rbt);
-	put_int(b, entry->stoptime);
-	put_int(b, entry->stopdepth);
-	put_int(b, entry->cns);
-	put_int(b, entry->smoothed);
-	put_int(b, entry->sac);
-	put_int(b, entry->running_sum);
-	put_double(b, entry->pressures.o2);
-	put_double(b, entry->pressures.n2);
-	put_double(b, entry->pressures.he);
-	put_int(b, entry->o2pressure.mbar);
-	put_int(b, entry->o2sensor[0].mbar);
-	put_int(b, entry->o2sensor[1].mbar);
-	put_int(b, entry->o2sensor[2].mbar);
-	put_int(b, entry->o2setpoint.mbar);
-	put_int(b, entry->scr_OC_pO2.mbar);
-	put_double(b, entry->mod);
-	put_double(b, entry->ead);
-	put_double(b, entry->end);
-	put_double(b, entry->eadd);
+		put_int(l, pi->tissues[idx].percentages[i]);
+	put_int(l, entry->ndl);
+	put_int(l, entry->tts);
+	put_int(l, entry->rbt);
+	put_int(l, entry->stoptime);
+	put_int(l, entry->stopdepth);
+	put_int(l, entry->cns);
+	put_int(l, entry->smoothed);
+	put_int(l, entry->sac);
+	put_int(l, entry->running_sum);
+	put_double(l, entry->pressures.o2);
+	put_double(l, entry->pressures.n2);
+	put_double(l, entry->pressures.he);
+	put_int(l, entry->o2pressure.mbar);
+	put_int(l, entry->o2sensor[0].mbar);
+	put_int(l, entry->o2sensor[1].mbar);
+	put_int(l, entry->o2sensor[2].mbar);
+	put_int(l, entry->o2setpoint.mbar);
+	put_int(l, entry->scr_OC_pO2.mbar);
+	put_double(l, entry->mod);
+	put_double(l, entry->ead);
+	put_double(l, entry->end);
+	put_double(l, entry->eadd);
 	switch (entry->velocity) {
 	case STABLE:
-		put_csv_string(b, "STABLE");
+		put_csv_string(l, "STABLE");
 		break;
 	case SLOW:
-		put_csv_string(b, "SLOW");
+		put_csv_string(l, "SLOW");
 		break;
 	case MODERATE:
-		put_csv_string(b, "MODERATE");
+		put_csv_string(l, "MODERATE");
 		break;
 	case FAST:
-		put_csv_string(b, "FAST");
+		put_csv_string(l, "FAST");
 		break;
 	case CRAZY:
-		put_csv_string(b, "CRAZY");
+		put_csv_string(l, "CRAZY");
 		break;
 	}
-	put_int(b, entry->speed);
-	put_int(b, entry->in_deco_calc);
-	put_int(b, entry->ndl_calc);
-	put_int(b, entry->tts_calc);
-	put_int(b, entry->stoptime_calc);
-	put_int(b, entry->stopdepth_calc);
-	put_int(b, entry->pressure_time);
-	put_int(b, entry->heartbeat);
-	put_int(b, entry->bearing);
-	put_double(b, entry->ambpressure);
-	put_double(b, entry->gfline);
-	put_double(b, entry->surface_gf);
-	put_double(b, entry->density);
-	put_int_with_nl(b, entry->icd_warning ? 1 : 0);
+	put_int(l, entry->speed);
+	put_int(l, entry->in_deco_calc);
+	put_int(l, entry->ndl_calc);
+	put_int(l, entry->tts_calc);
+	put_int(l, entry->stoptime_calc);
+	put_int(l, entry->stopdepth_calc);
+	put_int(l, entry->pressure_time);
+	put_int(l, entry->heartbeat);
+	put_int(l, entry->bearing);
+	put_double(l, entry->ambpressure);
+	put_double(l, entry->gfline);
+	put_double(l, entry->surface_gf);
+	put_double(l, entry->density);
+	put_int(l, entry->icd_warning ? 1 : 0);
+	end_line(l);
 }
 
-static void put_headers(struct membuffer *b, int nr_cylinders)
+static void put_headers(struct csv_line *l, int nr_cylinders)
 {
-	put_csv_string(b, "in_deco");
-	put_csv_string(b, "sec");
+	start_line(l);
+	put_header(l, "in_deco");
+	put_header(l, "sec");
 	for (int c = 0; c < nr_cylinders; c++) {
-		put_format(b, "\"pressure_%d_cylinder\", ", c);
-		put_format(b, "\"pressure_%d_interpolated\", ", c);
+		put_numbered_header(l, "pressure_%d_cylinder", c);
+		put_numbered_header(l, "pressure_%d_interpolated", c);
 	}
-	put_csv_string(b, "temperature");
-	put_csv_string(b, "depth");
-	put_csv_string(b, "ceiling");
+	put_header(l, "temperature");
+	put_header(l, "depth");
+	put_header(l, "ceiling");
 	for (int i = 0; i < 16; i++)
-		put_format(b, "\"ceiling_%d\", ", i);
+		put_numbered_header(l, "ceiling_%d", i);
 	for (int i = 0; i < 16; i++)
-		put_format(b, "\"percentage_%d\", ", i);
-	put_csv_string(b, "ndl");
-	put_csv_string(b, "tts");
-	put_csv_string(b, "rbt");
-	put_csv_string(b, "stoptime");
-	put_csv_string(b, "stopdepth");
-	put_csv_string(b, "cns");
-	put_csv_string(b, "smoothed");
-	put_csv_string(b, "sac");
-	put_csv_string(b, "running_sum");
-	put_csv_string(b, "pressureo2");
-	put_csv_string(b, "pressuren2");
-	put_csv_string(b, "pressurehe");
-	put_csv_string(b, "o2pressure");
-	put_csv_string(b, "o2sensor0");
-	put_csv_string(b, "o2sensor1");
-	put_csv_string(b, "o2sensor2");
-	put_csv_string(b, "o2setpoint");
-	put_csv_string(b, "scr_oc_po2");
-	put_csv_string(b, "mod");
-	put_csv_string(b, "ead");
-	put_csv_string(b, "end");
-	put_csv_string(b, "eadd");
-	put_csv_string(b, "velocity");
-	put_csv_string(b, "speed");
-	put_csv_string(b, "in_deco_calc");
-	put_csv_string(b, "ndl_calc");
-	put_csv_string(b, "tts_calc");
-	put_csv_string(b, "stoptime_calc");
-	put_csv_string(b, "stopdepth_calc");
-	put_csv_string(b, "pressure_time");
-	put_csv_string(b, "heartbeat");
-	put_csv_string(b, "bearing");
-	put_csv_string(b, "ambpressure");
-	put_csv_string(b, "gfline");
-	put_csv_string(b, "surface_gf");
-	put_csv_string(b, "density");
-	put_csv_string_with_nl(b, "icd_warning");
+		put_numbered_header(l, "percentage_%d", i);
+	put_header(l, "ndl");
+	put_header(l, "tts");
+	put_header(l, "rbt");
+	put_header(l, "stoptime");
+	put_header(l, "stopdepth");
+	put_header(l, "cns");
+	put_header(l, "smoothed");
+	put_header(l, "sac");
+	put_header(l, "running_sum");
+	put_header(l, "pressureo2");
+	put_header(l, "pressuren2");
+	put_header(l, "pressurehe");
+	put_header(l, "o2pressure");
+	put_header(l, "o2sensor0");
+	put_header(l, "o2sensor1");
+	put_header(l, "o2sensor2");
+	put_header(l, "o2setpoint");
+	put_header(l, "scr_oc_po2");
+	put_header(l, "mod");
+	put_header(l, "ead");
+	put_header(l, "end");
+	put_header(l, "eadd");
+	put_header(l, "velocity");
+	put_header(l, "speed");
+	put_header(l, "in_deco_calc");
+	put_header(l, "ndl_calc");
+	put_header(l, "tts_calc");
+	put_header(l, "stoptime_calc");
+	put_header(l, "stopdepth_calc");
+	put_header(l, "pressure_time");
+	put_header(l, "heartbeat");
+	put_header(l, "bearing");
+	put_header(l, "ambpressure");
+	put_header(l, "gfline");
+	put_header(l, "surface_gf");
+	put_header(l, "density");
+	put_header(l, "icd_warning");
+	end_line(l);
 }
 
 static void put_st_event(struct membuffer *b, struct plot_data *entry, int offset, int length)
@@ -202,25 +295,96 @@ static void put_st_event(struct membuffer *b, struct plot_data *entry, int offse
 	put_format(b, "\n");
 }
 
-static void save_profiles_buffer(struct membuffer *b, bool select_only)
-{
-	int i;
+/*
+ * The profile data are calculated in parallel, in batches of that many
+ * dives, and then written in order. The CSV of a long dive can take a few
+ * MB, so the batches are kept smaller than for the XML save.
+ */
+#define PROFILE_BATCH_SIZE 32
+#define PROFILE_CHUNK_SIZE (1024 * 1024)
+
+struct profile_item {
 	struct dive *dive;
+	struct deco_state ds;
+	struct membuffer buf;
+};
+
+struct profile_batch {
+	const char *columns;
+	struct profile_item items[PROFILE_BATCH_SIZE];
+};
+
+static void save_one_profile(struct membuffer *b, struct dive *dive, struct deco_state *ds, const char *columns)
+{
 	struct plot_info pi;
-	struct deco_state *planner_deco_state = NULL;
+	struct csv_line line = { b, columns, NULL, 0, 0, 0, true };
 
 	init_plot_info(&pi);
-	for_each_dive(i, dive) {
-		if (select_only && !dive->selected)
-			continue;
-		create_plot_info_new(dive, &dive->dc, &pi, false, planner_deco_state);
-		put_headers(b, pi.nr_cylinders);
-
-		for (int i = 0; i < pi.nr; i++)
-			put_pd(b, &pi, i);
-		put_format(b, "\n");
-		free_plot_info_data(&pi);
+	create_plot_info_from_deco_state(dive, &dive->dc, &pi, false, true, ds, NULL);
+	put_headers(&line, pi.nr_cylinders);
+
+	for (int i = 0; i < pi.nr; i++)
+		put_pd(&line, &pi, i);
+	put_format(b, "\n");
+	free_plot_info_data(&pi);
+	free(line.selected);
+}
+
+static void save_one_profile_in_batch(int idx, void *data)
+{
+	struct profile_batch *batch = data;
+	struct profile_item *item = batch->items + idx;
+
+	save_one_profile(&item->buf, item->dive, &item->ds, batch->columns);
+}
+
+/* stream may be NULL, in which case the whole output is kept in the buffer */
+static void save_profiles_buffer(struct membuffer *b, bool select_only, const char *columns, FILE *stream)
+{
+	int i, nr;
+	struct dive *dive;
+	struct profile_batch *batch;
+
+	batch = calloc(1, sizeof(*batch));
+	if (!batch)
+		exit(1);
+	batch->columns = columns;
+
+	i = 0;
+	while (i < dive_table.nr) {
+		/* The deco state depends on the previous dives and is cached by
+		 * init_decompression(). Loading samples accesses the repository.
+		 * Therefore, do both serially and in order. */
+		for (nr = 0; i < dive_table.nr && nr < PROFILE_BATCH_SIZE; i++) {
+			dive = get_dive(i);
+			if (select_only && !dive->selected)
+				continue;
+			batch->items[nr].dive = dive;
+#ifndef SUBSURFACE_MOBILE
+			init_decompression(&batch->items[nr].ds, dive);
+#endif
+			load_samples(dive);
+			nr++;
+		}
+
+		/* With a sample budget, loading samples may evict the samples of
+		 * other dives, so the profiles have to be calculated serially. */
+		if (sample_residency_budget) {
+			for (int j = 0; j < nr; j++)
+				save_one_profile_in_batch(j, batch);
+		} else {
+			run_in_parallel(nr, save_one_profile_in_batch, batch);
+		}
+
+		for (int j = 0; j < nr; j++) {
+			struct membuffer *buf = &batch->items[j].buf;
+			put_bytes(b, buf->buffer, buf->len);
+			free_buffer(buf);
+			if (stream)
+				flush_buffer_if_full(b, stream, PROFILE_CHUNK_SIZE);
+		}
 	}
+	free(batch);
 }
 
 void save_subtitles_buffer(struct membuffer *b, struct dive *dive, int offset, int length)
@@ -229,7 +393,7 @@ void save_subtitles_buffer(struct membuffer *b, struct dive *dive, int offset, i
 	struct deco_state *planner_deco_state = NULL;
 
 	init_plot_info(&pi);
-	create_plot_info_new(dive, &dive->dc, &pi, false, planner_deco_state);
+	create_plot_info_new(dive, &dive->dc, &pi, false, false, planner_deco_state);
 
 	put_format(b, "[Script Info]\n");
 	put_format(b, "; Script generated by Subsurface %s\n", subsurface_canonical_version());
@@ -246,14 +410,16 @@ void save_subtitles_buffer(struct membuffer *b, struct dive *dive, int offset, i
 	free_plot_info_data(&pi);
 }
 
-int save_profiledata(const char *filename, bool select_only)
+/*
+ * columns is a comma separated list of the column names to export, as
+ * in the header lines, or NULL for all columns.
+ */
+int save_profiledata(const char *filename, bool select_only, const char *columns)
 {
 	struct membuffer buf = { 0 };
 	FILE *f;
 	int error = 0;
 
-	save_profiles_buffer(&buf, select_only);
-
 	if (same_string(filename, "-")) {
 		f = stdout;
 	} else {
@@ -261,8 +427,10 @@ int save_profiledata(const char *filename, bool select_only)
 		f = subsurface_fopen(filename, "w");
 	}
 	if (f) {
+		save_profiles_buffer(&buf, select_only, empty_string(columns) ? NULL : columns, f);
 		flush_buffer(&buf, f);
-		error = fclose(f);
+		error = ferror(f);
+		error |= fclose(f);
 	}
 	if (error)
 		report_error("Save failed (%s)", strerror(errno));
@@ -6,7 +6,7 @@
 extern "C" {
 #endif
 
-int save_profiledata(const char *filename, bool selected_only);
+int save_profiledata(const char *filename, bool selected_only, const char *columns);
 void save_subtitles_buffer(struct membuffer *b, struct dive *dive, int offset, int length);
 
 #ifdef __cplusplus
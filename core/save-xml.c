@@ -21,9 +21,11 @@
 #include "subsurface-time.h"
 #include "trip.h"
 #include "device.h"
+#include "fingerprint.h"
 #include "file.h"
 #include "membuffer.h"
 #include "picture.h"
+#include "sampleresidency.h"
 #include "strndup.h"
 #include "git-access.h"
 #include "qthelper.h"
@@ -224,7 +226,8 @@ static void save_weightsystem_info(struct membuffer *b, struct dive *dive)
 
 static void show_integer(struct membuffer *b, int value, const char *pre, const char *post)
 {
-	put_format(b, " %s%d%s", pre, value, post);
+	put_string(b, " ");
+	put_integer(b, pre, value, post);
 }
 
 static void show_index(struct membuffer *b, int value, const char *pre, const char *post)
@@ -237,7 +240,7 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 {
 	int idx;
 
-	put_format(b, "  <sample time='%u:%02u min'", FRACTION(sample->time.seconds, 60));
+	put_minutes(b, "  <sample time='", sample->time.seconds, " min'");
 	put_milli(b, " depth='", sample->depth.mm, " m'");
 	if (sample->temperature.mkelvin && sample->temperature.mkelvin != old->temperature.mkelvin) {
 		put_temperature(b, sample->temperature, " temp='", " C'");
@@ -263,36 +266,36 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 			}
 			put_pressure(b, p, " pressure='", " bar'");
 			if (sensor != old->sensor[0]) {
-				put_format(b, " sensor='%d'", sensor);
+				put_integer(b, " sensor='", sensor, "'");
 				old->sensor[0] = sensor;
 			}
 			continue;
 		}
 
 		/* The new-style format is much simpler: the sensor is always encoded */
-		put_format(b, " pressure%d=", sensor);
+		put_integer(b, " pressure", sensor, "=");
 		put_pressure(b, p, "'", " bar'");
 	}
 
 	/* the deco/ndl values are stored whenever they change */
 	if (sample->ndl.seconds != old->ndl.seconds) {
-		put_format(b, " ndl='%u:%02u min'", FRACTION(sample->ndl.seconds, 60));
+		put_minutes(b, " ndl='", sample->ndl.seconds, " min'");
 		old->ndl = sample->ndl;
 	}
 	if (sample->tts.seconds != old->tts.seconds) {
-		put_format(b, " tts='%u:%02u min'", FRACTION(sample->tts.seconds, 60));
+		put_minutes(b, " tts='", sample->tts.seconds, " min'");
 		old->tts = sample->tts;
 	}
 	if (sample->rbt.seconds != old->rbt.seconds) {
-		put_format(b, " rbt='%u:%02u min'", FRACTION(sample->rbt.seconds, 60));
+		put_minutes(b, " rbt='", sample->rbt.seconds, " min'");
 		old->rbt = sample->rbt;
 	}
 	if (sample->in_deco != old->in_deco) {
-		put_format(b, " in_deco='%d'", sample->in_deco ? 1 : 0);
+		put_integer(b, " in_deco='", sample->in_deco ? 1 : 0, "'");
 		old->in_deco = sample->in_deco;
 	}
 	if (sample->stoptime.seconds != old->stoptime.seconds) {
-		put_format(b, " stoptime='%u:%02u min'", FRACTION(sample->stoptime.seconds, 60));
+		put_minutes(b, " stoptime='", sample->stoptime.seconds, " min'");
 		old->stoptime = sample->stoptime;
 	}
 
@@ -302,7 +305,7 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 	}
 
 	if (sample->cns != old->cns) {
-		put_format(b, " cns='%u%%'", sample->cns);
+		put_integer(b, " cns='", sample->cns, "%'");
 		old->cns = sample->cns;
 	}
 
@@ -480,11 +483,13 @@ static void save_picture(struct membuffer *b, struct picture *pic)
 	put_string(b, "/>\n");
 }
 
-void save_one_dive_to_mb(struct membuffer *b, struct dive *dive, bool anonymize)
+/* The samples must have been loaded. This doesn't touch global state and may run in parallel */
+static void save_loaded_dive_to_mb(struct membuffer *b, struct dive *dive, bool anonymize)
 {
 	struct divecomputer *dc;
-	pressure_t surface_pressure = un_fixup_surface_pressure(dive);
+	pressure_t surface_pressure;
 
+	surface_pressure = un_fixup_surface_pressure(dive);
 	put_string(b, "<dive");
 	if (dive->number)
 		put_format(b, " number='%d'", dive->number);
@@ -539,6 +544,12 @@ void save_one_dive_to_mb(struct membuffer *b, struct dive *dive, bool anonymize)
 	put_format(b, "</dive>\n");
 }
 
+void save_one_dive_to_mb(struct membuffer *b, struct dive *dive, bool anonymize)
+{
+	load_samples(dive);
+	save_loaded_dive_to_mb(b, dive, anonymize);
+}
+
 int save_dive(FILE *f, struct dive *dive, bool anonymize)
 {
 	struct membuffer buf = { 0 };
@@ -549,29 +560,174 @@ int save_dive(FILE *f, struct dive *dive, bool anonymize)
 	return 0;
 }
 
-static void save_trip(struct membuffer *b, dive_trip_t *trip, bool anonymize)
-{
-	int i;
+/*
+ * When saving to a file, the buffer is written in chunks of that size, so
+ * that the memory needed doesn't grow with the size of the logbook.
+ */
+#define SAVE_CHUNK_SIZE (1024 * 1024)
+
+/*
+ * The dives are formatted in parallel, in batches of that many dives, and
+ * then written in order. Thus, at most one batch of formatted dives is
+ * kept in memory.
+ */
+#define SAVE_BATCH_SIZE 256
+
+/* The dives and trips in the order they are written */
+enum save_item_type {
+	SAVE_DIVE,
+	SAVE_TRIP_START,
+	SAVE_TRIP_END
+};
+
+struct save_item {
+	enum save_item_type type;
 	struct dive *dive;
+	dive_trip_t *trip;
+	struct membuffer buf;	/* The formatted dive */
+};
+
+struct save_items {
+	int nr, alloc;
+	struct save_item *items;
+};
+
+struct save_batch {
+	bool anonymize;
+	struct save_item **dives;
+};
+
+static void add_save_item(struct save_items *items, enum save_item_type type, struct dive *dive, dive_trip_t *trip)
+{
+	struct save_item *item;
+
+	if (items->nr >= items->alloc) {
+		items->alloc = (items->nr + 16) * 3 / 2;
+		items->items = realloc(items->items, items->alloc * sizeof(struct save_item));
+		if (!items->items)
+			exit(1);
+	}
+	item = &items->items[items->nr++];
+	memset(item, 0, sizeof(*item));
+	item->type = type;
+	item->dive = dive;
+	item->trip = trip;
+}
+
+static void collect_save_items(struct save_items *items, bool select_only)
+{
+	int i, j;
+	struct dive *dive, *trip_dive;
+	dive_trip_t *trip;
+
+	for (i = 0; i < trip_table.nr; ++i)
+		trip_table.trips[i]->saved = 0;
+
+	for_each_dive(i, dive) {
+		if (select_only) {
+			if (dive->selected)
+				add_save_item(items, SAVE_DIVE, dive, NULL);
+			continue;
+		}
+		trip = dive->divetrip;
+
+		/* Bare dive without a trip? */
+		if (!trip) {
+			add_save_item(items, SAVE_DIVE, dive, NULL);
+			continue;
+		}
+
+		/* Have we already seen this trip (and thus saved this dive?) */
+		if (trip->saved)
+			continue;
 
+		/* We haven't seen this trip before - save it and all dives */
+		trip->saved = 1;
+		add_save_item(items, SAVE_TRIP_START, NULL, trip);
+
+		/*
+		 * Incredibly cheesy: we want to save the dives sorted, and they
+		 * are sorted in the dive array.. So instead of using the dive
+		 * list in the trip, we just traverse the global dive array and
+		 * check the divetrip pointer..
+		 */
+		for_each_dive(j, trip_dive) {
+			if (trip_dive->divetrip == trip)
+				add_save_item(items, SAVE_DIVE, trip_dive, trip);
+		}
+		add_save_item(items, SAVE_TRIP_END, NULL, trip);
+	}
+}
+
+static void format_one_dive(int idx, void *data)
+{
+	struct save_batch *batch = data;
+	struct save_item *item = batch->dives[idx];
+
+	save_loaded_dive_to_mb(&item->buf, item->dive, batch->anonymize);
+}
+
+static void save_trip_start(struct membuffer *b, dive_trip_t *trip)
+{
 	put_format(b, "<trip");
 	show_date(b, trip_date(trip));
 	show_utf8(b, trip->location, " location=\'", "\'", 1);
 	put_format(b, ">\n");
 	show_utf8(b, trip->notes, "<notes>", "</notes>\n", 0);
+}
 
-	/*
-	 * Incredibly cheesy: we want to save the dives sorted, and they
-	 * are sorted in the dive array.. So instead of using the dive
-	 * list in the trip, we just traverse the global dive array and
-	 * check the divetrip pointer..
-	 */
-	for_each_dive(i, dive) {
-		if (dive->divetrip == trip)
-			save_one_dive_to_mb(b, dive, anonymize);
+/* stream may be NULL, in which case the whole output is kept in the buffer */
+static void save_dives_in_order(struct membuffer *b, bool select_only, bool anonymize, FILE *stream)
+{
+	struct save_items items = { 0 };
+	struct save_batch batch = { anonymize, NULL };
+	int start, end, nr, i;
+	bool loaded;
+
+	collect_save_items(&items, select_only);
+	batch.dives = malloc(SAVE_BATCH_SIZE * sizeof(struct save_item *));
+	if (!batch.dives)
+		exit(1);
+
+	for (start = 0; start < items.nr; start = end) {
+		/* Loading samples accesses the repository, so do that serially */
+		nr = 0;
+		for (end = start; end < items.nr && nr < SAVE_BATCH_SIZE; end++) {
+			if (items.items[end].type != SAVE_DIVE)
+				continue;
+			load_samples(items.items[end].dive);
+			batch.dives[nr++] = &items.items[end];
+		}
+		/* With a sample budget, loading may have evicted other dives of the batch. Format those serially. */
+		loaded = true;
+		for (i = 0; i < nr; i++)
+			loaded = loaded && dive_samples_loaded(batch.dives[i]->dive);
+		if (loaded)
+			run_in_parallel(nr, format_one_dive, &batch);
+
+		for (i = start; i < end; i++) {
+			struct save_item *item = &items.items[i];
+			switch (item->type) {
+			case SAVE_DIVE:
+				if (loaded) {
+					put_bytes(b, item->buf.buffer, item->buf.len);
+					free_buffer(&item->buf);
+				} else {
+					save_one_dive_to_mb(b, item->dive, anonymize);
+				}
+				flush_buffer_if_full(b, stream, SAVE_CHUNK_SIZE);
+				break;
+			case SAVE_TRIP_START:
+				save_trip_start(b, item->trip);
+				break;
+			case SAVE_TRIP_END:
+				put_format(b, "</trip>\n");
+				break;
+			}
+		}
 	}
-
-	put_format(b, "</trip>\n");
+	free(batch.dives);
+	free(items.items);
 }
 
 static void save_one_device(void *_f, const char *model, uint32_t deviceid,
@@ -606,6 +762,21 @@ static void save_one_device(void *_f, const char *model, uint32_t deviceid,
 	put_format(b, "/>\n");
 }
 
+static void save_fingerprints(struct membuffer *b)
+{
+	for (int i = 0; i < fingerprint_table.nr; i++) {
+		const struct fingerprint_record *fp = &fingerprint_table.fingerprints[i];
+		char *data = fingerprint_data_to_hex(fp);
+
+		put_format(b, "<fingerprint");
+		show_utf8(b, fp->model, " model='", "'", 1);
+		put_format(b, " deviceid='%08x' diveid='%08x'", fp->deviceid, fp->diveid);
+		show_utf8(b, data, " data='", "'", 1);
+		put_format(b, "/>\n");
+		free(data);
+	}
+}
+
 int save_dives(const char *filename)
 {
 	return save_dives_logic(filename, false, false);
@@ -661,16 +832,18 @@ static void save_filter_presets(struct membuffer *b)
 	put_format(b, "</filterpresets>\n");
 }
 
-static void save_dives_buffer(struct membuffer *b, bool select_only, bool anonymize)
+/* Everything up to the dives: the settings, the dive sites and the filter presets */
+static void save_dives_header(struct membuffer *b, bool select_only, bool anonymize)
 {
 	int i;
-	struct dive *dive;
-	dive_trip_t *trip;
 
 	put_format(b, "<divelog program='subsurface' version='%d'>\n<settings>\n", DATAFORMAT_VERSION);
 
 	/* save the dive computer nicknames, if any */
 	call_for_each_dc(b, save_one_device, select_only);
+	/* the fingerprints refer to dives that a partial export may not contain */
+	if (!select_only)
+		save_fingerprints(b);
 	if (autogroup)
 		put_format(b, "  <autogroup state='1' />\n");
 	put_format(b, "</settings>\n");
@@ -706,38 +879,17 @@ static void save_dives_buffer(struct membuffer *b, bool select_only, bool anonym
 		put_format(b, "</site>\n");
 	}
 	put_format(b, "</divesites>\n<dives>\n");
-	for (i = 0; i < trip_table.nr; ++i)
-		trip_table.trips[i]->saved = 0;
 
 	/* save the filter presets */
 	save_filter_presets(b);
+}
 
-	/* save the dives */
-	for_each_dive(i, dive) {
-		if (select_only) {
-
-			if (!dive->selected)
-				continue;
-			save_one_dive_to_mb(b, dive, anonymize);
-
-		} else {
-			trip = dive->divetrip;
-
-			/* Bare dive without a trip? */
-			if (!trip) {
-				save_one_dive_to_mb(b, dive, anonymize);
-				continue;
-			}
-
-			/* Have we already seen this trip (and thus saved this dive?) */
-			if (trip->saved)
-				continue;
+static void save_dives_buffer(struct membuffer *b, bool select_only, bool anonymize, FILE *stream)
+{
+	save_dives_header(b, select_only, anonymize);
 
-			/* We haven't seen this trip before - save it and all dives */
-			trip->saved = 1;
-			save_trip(b, trip, anonymize);
-		}
-	}
+	/* save the dives */
+	save_dives_in_order(b, select_only, anonymize, stream);
 	put_format(b, "</dives>\n</divelog>\n");
 }
 
@@ -798,9 +950,15 @@ static void try_to_backup(const char *filename)
 	}
 }
 
+/*
+ * The XML is streamed to a temporary file, which replaces the logbook only
+ * once it was written completely. Thus, a failed save never destroys the
+ * old file.
+ */
 int save_dives_logic(const char *filename, const bool select_only, bool anonymize)
 {
 	struct membuffer buf = { 0 };
+	struct membuffer tmpname = { 0 };
 	FILE *f;
 	void *git;
 	const char *branch, *remote;
@@ -810,26 +968,191 @@ int save_dives_logic(const char *filename, const bool select_only, bool anonymiz
 	if (git)
 		return git_save_dives(git, branch, remote, select_only);
 
-	save_dives_buffer(&buf, select_only, anonymize);
-
 	if (same_string(filename, "-")) {
-		f = stdout;
-	} else {
-		try_to_backup(filename);
-		error = -1;
-		f = subsurface_fopen(filename, "w");
+		save_dives_buffer(&buf, select_only, anonymize, stdout);
+		flush_buffer(&buf, stdout);
+		return fflush(stdout);
 	}
-	if (f) {
+
+	put_format(&tmpname, "%s.tmp", filename);
+	f = subsurface_fopen(mb_cstring(&tmpname), "w");
+	if (!f) {
+		error = -1;
+	} else {
+		save_dives_buffer(&buf, select_only, anonymize, f);
 		flush_buffer(&buf, f);
-		error = fclose(f);
+		error = ferror(f);
+		if (fclose(f))
+			error = -1;
+		if (!error) {
+			try_to_backup(filename);
+			error = subsurface_rename(mb_cstring(&tmpname), filename);
+		}
 	}
-	if (error)
+	if (error) {
 		report_error(translate("gettextFromC", "Failed to save dives to %s (%s)"), filename, strerror(errno));
+		remove(mb_cstring(&tmpname));
+	}
 
+	free_buffer(&tmpname);
 	free_buffer(&buf);
 	return error;
 }
 
+/*
+ * Some stylesheets write a fixed header line, followed by lines that only
+ * depend on the dive they describe. For large exports, these are applied
+ * to chunks of about EXPORT_CHUNK_DIVES dives in parallel and the results
+ * are concatenated, keeping only the header of the first chunk.
+ *
+ * The manual CSV export does not qualify: its columns depend on the
+ * cylinders of the last dive. UDDF is a single XML document.
+ */
+static const char *chunked_stylesheets[] = { "xml2csv.xslt" };
+#define EXPORT_CHUNK_DIVES 200
+
+struct export_chunk {
+	struct membuffer xml;	/* The dives of the chunk as a complete divelog */
+	xmlChar *result;	/* The transformed chunk */
+	int result_len;
+	bool ok;
+};
+
+struct export_job {
+	xsltStylesheetPtr xslt;
+	const char **params;
+	struct export_chunk *chunks;
+};
+
+static bool can_export_in_chunks(const char *export_xslt, bool selected)
+{
+	int i, nr = 0;
+	struct dive *dive;
+	bool found = false;
+
+	for (i = 0; i < (int)(sizeof(chunked_stylesheets) / sizeof(chunked_stylesheets[0])); i++)
+		found = found || same_string(export_xslt, chunked_stylesheets[i]);
+	if (!found)
+		return false;
+
+	for_each_dive(i, dive) {
+		if (!selected || dive->selected)
+			nr++;
+	}
+	return nr > EXPORT_CHUNK_DIVES;
+}
+
+/*
+ * Write the dives into chunks of whole trips. This is done serially,
+ * since loading the samples may access the repository.
+ * Returns the number of chunks.
+ */
+static int split_export_chunks(struct export_chunk **chunksp, bool selected, bool anonymize)
+{
+	struct save_items items = { 0 };
+	struct membuffer header = { 0 };
+	struct export_chunk *chunks = NULL, *chunk = NULL;
+	int i, nr = 0, dives = 0;
+
+	collect_save_items(&items, selected);
+	save_dives_header(&header, selected, anonymize);
+	for (i = 0; i < items.nr; i++) {
+		struct save_item *item = &items.items[i];
+
+		if (!chunk) {
+			chunks = realloc(chunks, (nr + 1) * sizeof(struct export_chunk));
+			if (!chunks)
+				exit(1);
+			chunk = &chunks[nr++];
+			memset(chunk, 0, sizeof(*chunk));
+			put_bytes(&chunk->xml, header.buffer, header.len);
+			dives = 0;
+		}
+		switch (item->type) {
+		case SAVE_DIVE:
+			save_one_dive_to_mb(&chunk->xml, item->dive, anonymize);
+			dives++;
+			break;
+		case SAVE_TRIP_START:
+			save_trip_start(&chunk->xml, item->trip);
+			break;
+		case SAVE_TRIP_END:
+			put_format(&chunk->xml, "</trip>\n");
+			break;
+		}
+		/* Chunks end between trips */
+		if (dives >= EXPORT_CHUNK_DIVES && (item->type == SAVE_TRIP_END || !item->trip)) {
+			put_format(&chunk->xml, "</dives>\n</divelog>\n");
+			chunk = NULL;
+		}
+	}
+	if (chunk)
+		put_format(&chunk->xml, "</dives>\n</divelog>\n");
+	free_buffer(&header);
+	free(items.items);
+	*chunksp = chunks;
+	return nr;
+}
+
+static void transform_one_chunk(int idx, void *data)
+{
+	struct export_job *job = data;
+	struct export_chunk *chunk = &job->chunks[idx];
+	xmlDoc *doc, *transformed;
+
+	doc = xmlReadMemory(chunk->xml.buffer, chunk->xml.len, "divelog", NULL, 0);
+	free_buffer(&chunk->xml);
+	if (!doc)
+		return;
+	transformed = xsltApplyStylesheet(job->xslt, doc, job->params);
+	xmlFreeDoc(doc);
+	if (!transformed)
+		return;
+	chunk->ok = xsltSaveResultToString(&chunk->result, &chunk->result_len, transformed, job->xslt) == 0;
+	xmlFreeDoc(transformed);
+}
+
+static int export_dives_xslt_chunked(const char *filename, bool selected, xsltStylesheetPtr xslt, const char **params, bool anonymize)
+{
+	struct export_job job = { xslt, params, NULL };
+	int i, nr, res = 0;
+	FILE *f;
+
+	nr = split_export_chunks(&job.chunks, selected, anonymize);
+	run_in_parallel(nr, transform_one_chunk, &job);
+
+	for (i = 0; i < nr && !res; i++) {
+		if (!job.chunks[i].ok)
+			res = report_error("Failed to convert the dives to the export format");
+	}
+	if (!res) {
+		f = subsurface_fopen(filename, "w");
+		if (f) {
+			for (i = 0; i < nr; i++) {
+				const char *p = (const char *)job.chunks[i].result;
+				const char *nl;
+				int len = job.chunks[i].result_len;
+
+				/* Skip the repeated header line */
+				if (i > 0 && len > 0) {
+					nl = memchr(p, '\n', len);
+					len = nl ? len - (int)(nl + 1 - p) : 0;
+					p = nl + 1;
+				}
+				if (len > 0)
+					fwrite(p, 1, len, f);
+			}
+			fclose(f);
+		} else {
+			res = report_error("Failed to open %s for writing (%s)", filename, strerror(errno));
+		}
+	}
+	for (i = 0; i < nr; i++)
+		xmlFree(job.chunks[i].result);
+	free(job.chunks);
+	return res;
+}
+
 int export_dives_xslt(const char *filename, const bool selected, const int units, const char *export_xslt, bool anonymize)
 {
 	FILE *f;
@@ -848,8 +1171,22 @@ int export_dives_xslt(const char *filename, const bool selected, const int units
 	if (!filename)
 		return report_error("No filename for export");
 
+	snprintf(unitstr, 3, "%d", units);
+	params[pnr++] = "units";
+	params[pnr++] = unitstr;
+	params[pnr++] = NULL;
+
+	if (can_export_in_chunks(export_xslt, selected)) {
+		xslt = get_stylesheet(export_xslt);
+		if (!xslt)
+			return report_error("Failed to open export conversion stylesheet");
+		res = export_dives_xslt_chunked(filename, selected, xslt, (const char **)params, anonymize);
+		xsltFreeStylesheet(xslt);
+		return res;
+	}
+
 	/* Save XML to file and convert it into a memory buffer */
-	save_dives_buffer(&buf, selected, anonymize);
+	save_dives_buffer(&buf, selected, anonymize, NULL);
 
 	/*
 	 * Parse the memory buffer into XML document and
@@ -866,11 +1203,6 @@ int export_dives_xslt(const char *filename, const bool selected, const int units
 	if (!xslt)
 		return report_error("Failed to open export conversion stylesheet");
 
-	snprintf(unitstr, 3, "%d", units);
-	params[pnr++] = "units";
-	params[pnr++] = unitstr;
-	params[pnr++] = NULL;
-
 	transformed = xsltApplyStylesheet(xslt, doc, (const char **)params);
 	xmlFreeDoc(doc);
 
@@ -7,6 +7,7 @@
 #include "subsurface-qt/divelistnotifier.h"
 
 #include <QVector>
+#include <algorithm>
 
 int amount_selected;
 static int amount_trips_selected;
@@ -66,21 +67,17 @@ extern "C" struct dive *first_selected_dive()
 
 extern "C" struct dive *last_selected_dive()
 {
-	int idx;
-	struct dive *d, *ret = NULL;
-
-	for_each_dive (idx, d) {
-		if (d->selected)
-			ret = d;
+	for (int idx = dive_table.nr - 1; idx >= 0; --idx) {
+		if (dive_table.dives[idx]->selected)
+			return dive_table.dives[idx];
 	}
-	return ret;
+	return NULL;
 }
 
 extern "C" bool consecutive_selected()
 {
 	struct dive *d;
 	int i;
-	bool consecutive = true;
 	bool firstfound = false;
 	bool lastfound = false;
 
@@ -92,12 +89,12 @@ extern "C" bool consecutive_selected()
 			if (!firstfound)
 				firstfound = true;
 			else if (lastfound)
-				consecutive = false;
+				return false;
 		} else if (firstfound) {
 			lastfound = true;
 		}
 	}
-	return consecutive;
+	return true;
 }
 
 #if DEBUG_SELECTION_TRACKING
@@ -166,7 +163,12 @@ void setSelection(const std::vector<dive *> &selection, dive *currentDive)
 	for (int i = 0; i < trip_table.nr; ++i)
 		trip_table.trips[i]->selected = false;
 
-	// TODO: We might want to keep track of selected dives in a more efficient way!
+	// Searching every dive in the selection vector is quadratic, which is prohibitive
+	// when selecting all dives of a large log. Therefore, sort the selection by pointer
+	// and use binary search.
+	std::vector<dive *> sorted = selection;
+	std::sort(sorted.begin(), sorted.end());
+
 	int i;
 	dive *d;
 	amount_selected = 0; // We recalculate amount_selected
@@ -179,8 +181,7 @@ void setSelection(const std::vector<dive *> &selection, dive *currentDive)
 		}
 
 		// Search the dive in the list of selected dives.
-		// TODO: By sorting the list in the same way as the backend, this could be made more efficient.
-		bool newState = std::find(selection.begin(), selection.end(), d) != selection.end();
+		bool newState = std::binary_search(sorted.begin(), sorted.end(), d);
 
 		if (newState) {
 			++amount_selected;
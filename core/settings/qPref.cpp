@@ -24,7 +24,9 @@
 void qPref::loadSync(bool doSync)
 {
 	// the following calls, ensures qPref* is instanciated, registred and
-	// that properties are loaded
+	// that properties are loaded. All of them go through one QSettings
+	// object, opening one per key is slow with the registry and plists.
+	qPrefBatch batch;
 	qPrefCloudStorage::loadSync(doSync);
 	qPrefDisplay::loadSync(doSync);
 	qPrefDiveComputer::loadSync(doSync);
@@ -2,7 +2,22 @@
 #include "qPrefPrivate.h"
 #include "core/subsurface-string.h"
 
-#include <QSettings>
+static thread_local QSettings *batchSettings = nullptr;
+
+qPrefBatch::qPrefBatch() : previous(batchSettings)
+{
+	batchSettings = &settings;
+}
+
+qPrefBatch::~qPrefBatch()
+{
+	batchSettings = previous;
+}
+
+QSettings *qPrefBatch::current()
+{
+	return batchSettings;
+}
 
 void qPrefPrivate::copy_txt(const char **name, const QString &string)
 {
@@ -18,7 +33,12 @@ QString keyFromGroupAndName(QString group, QString name)
 
 void qPrefPrivate::propSetValue(const QString &key, const QVariant &value, const QVariant &defaultValue)
 {
-	QSettings s;
+	if (!batchSettings) {
+		qPrefBatch batch;
+		propSetValue(key, value, defaultValue);
+		return;
+	}
+
 	bool isDefault = false;
 	if (value.isValid() && value.type() == QVariant::Double)
 		isDefault = IS_FP_SAME(value.toDouble(), defaultValue.toDouble());
@@ -26,13 +46,15 @@ void qPrefPrivate::propSetValue(const QString &key, const QVariant &value, const
 		isDefault = (value == defaultValue);
 
 	if (!isDefault)
-		s.setValue(key, value);
+		batchSettings->setValue(key, value);
 	else
-		s.remove(key);
+		batchSettings->remove(key);
 }
 
 QVariant qPrefPrivate::propValue(const QString &key, const QVariant &defaultValue)
 {
+	if (batchSettings)
+		return batchSettings->value(key, defaultValue);
 	QSettings s;
-	return  s.value(key, defaultValue);
+	return s.value(key, defaultValue);
 }
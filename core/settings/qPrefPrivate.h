@@ -9,6 +9,7 @@
 #include <QObject>
 #include <QDebug>
 #include <QVariant>
+#include <QSettings>
 
 
 // implementation class of the interface classes
@@ -25,6 +26,19 @@ private:
 	qPrefPrivate() {}
 };
 
+// While a qPrefBatch exists, the preferences of the current thread are read
+// and written through its QSettings object instead of opening one per key.
+class qPrefBatch {
+public:
+	qPrefBatch();
+	~qPrefBatch();
+	static QSettings *current();
+
+private:
+	QSettings settings;
+	QSettings *previous;
+};
+
 // helper function to ensure there's a '/' between group and name
 extern QString keyFromGroupAndName(QString group, QString name);
 
@@ -0,0 +1,721 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifdef __clang__
+// Clang has a bug on zero-initialization of C structs.
+#pragma clang diagnostic ignored "-Wmissing-field-initializers"
+#endif
+
+#include "ssrf.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "dive.h"
+#include "divelist.h"
+#include "divesite.h"
+#include "errorhelper.h"
+#include "file.h"
+#include "filterconstraint.h"
+#include "filterpreset.h"
+#include "membuffer.h"
+#include "samplecolumns.h"
+#include "subsurface-string.h"
+#include "tag.h"
+#include "trip.h"
+#include "snapshot.h"
+
+#define SNAPSHOT_MAGIC "SSRFSNAP"
+#define SNAPSHOT_VERSION 2
+
+/*
+ * All values are written in host byte order. Strings are written as
+ * their length plus one (zero for a NULL pointer) followed by the
+ * bytes without the terminating zero.
+ */
+static void put_int(struct membuffer *b, int32_t val)
+{
+	put_bytes(b, (const char *)&val, sizeof(val));
+}
+
+static void put_int64(struct membuffer *b, int64_t val)
+{
+	put_bytes(b, (const char *)&val, sizeof(val));
+}
+
+static void put_str(struct membuffer *b, const char *s)
+{
+	int len;
+
+	if (!s) {
+		put_int(b, 0);
+		return;
+	}
+	len = strlen(s);
+	put_int(b, len + 1);
+	put_bytes(b, s, len);
+}
+
+struct snapshot_reader {
+	const char *p, *end;
+	bool error;
+};
+
+static void get_bytes(struct snapshot_reader *r, void *dst, size_t len)
+{
+	if (r->error || (size_t)(r->end - r->p) < len) {
+		r->error = true;
+		memset(dst, 0, len);
+		return;
+	}
+	memcpy(dst, r->p, len);
+	r->p += len;
+}
+
+static int32_t get_int(struct snapshot_reader *r)
+{
+	int32_t val;
+	get_bytes(r, &val, sizeof(val));
+	return val;
+}
+
+static int64_t get_int64(struct snapshot_reader *r)
+{
+	int64_t val;
+	get_bytes(r, &val, sizeof(val));
+	return val;
+}
+
+/* Get a count of objects of which each takes at least min_size bytes */
+static int get_count(struct snapshot_reader *r, size_t min_size)
+{
+	int32_t nr = get_int(r);
+	if (nr < 0 || (size_t)(r->end - r->p) / min_size < (size_t)nr) {
+		r->error = true;
+		return 0;
+	}
+	return nr;
+}
+
+static char *get_str(struct snapshot_reader *r)
+{
+	int32_t len = get_int(r);
+	char *res;
+
+	if (len <= 0 || r->error)
+		return NULL;
+	len--;
+	if (r->end - r->p < len) {
+		r->error = true;
+		return NULL;
+	}
+	res = malloc(len + 1);
+	memcpy(res, r->p, len);
+	res[len] = 0;
+	r->p += len;
+	return res;
+}
+
+static void save_sites(struct membuffer *b, struct dive_site_table *sites)
+{
+	put_int(b, sites->nr);
+	for (int i = 0; i < sites->nr; i++) {
+		struct dive_site *ds = sites->dive_sites[i];
+		put_int(b, ds->uuid);
+		put_str(b, ds->name);
+		put_str(b, ds->description);
+		put_str(b, ds->notes);
+		put_int(b, ds->location.lat.udeg);
+		put_int(b, ds->location.lon.udeg);
+		put_int(b, ds->taxonomy.nr);
+		for (int j = 0; j < ds->taxonomy.nr; j++) {
+			put_int(b, ds->taxonomy.category[j].category);
+			put_int(b, ds->taxonomy.category[j].origin);
+			put_str(b, ds->taxonomy.category[j].value);
+		}
+	}
+}
+
+static void load_sites(struct snapshot_reader *r, struct dive_site_table *sites)
+{
+	int nr = get_count(r, 6 * sizeof(int32_t));
+
+	for (int i = 0; i < nr && !r->error; i++) {
+		struct dive_site *ds = alloc_or_get_dive_site(get_int(r), sites);
+		int nr_taxonomy;
+
+		ds->name = get_str(r);
+		ds->description = get_str(r);
+		ds->notes = get_str(r);
+		ds->location.lat.udeg = get_int(r);
+		ds->location.lon.udeg = get_int(r);
+		nr_taxonomy = get_count(r, 3 * sizeof(int32_t));
+		for (int j = 0; j < nr_taxonomy && !r->error; j++) {
+			int category = get_int(r);
+			int origin = get_int(r);
+			char *value = get_str(r);
+			taxonomy_set_category(&ds->taxonomy, category, value ?: "", origin);
+			free(value);
+		}
+	}
+}
+
+static void save_trips(struct membuffer *b, struct trip_table *trips)
+{
+	put_int(b, trips->nr);
+	for (int i = 0; i < trips->nr; i++) {
+		struct dive_trip *trip = trips->trips[i];
+		put_str(b, trip->location);
+		put_str(b, trip->notes);
+		put_int(b, trip->autogen);
+		put_bytes(b, (const char *)trip->git_id, 20);
+	}
+}
+
+static int get_trip_idx(struct trip_table *trips, const struct dive_trip *trip, int *last)
+{
+	/* Consecutive dives are usually in the same trip */
+	if (*last >= 0 && *last < trips->nr && trips->trips[*last] == trip)
+		return *last;
+	for (int i = 0; i < trips->nr; i++) {
+		if (trips->trips[i] == trip)
+			return *last = i;
+	}
+	return -1;
+}
+
+static void save_snapshot_dc(struct membuffer *b, struct divecomputer *dc)
+{
+	int nr;
+	struct event *ev;
+	struct extra_data *ed;
+
+	put_int64(b, dc->when);
+	put_int(b, dc->duration.seconds);
+	put_int(b, dc->surfacetime.seconds);
+	put_int(b, dc->last_manual_time.seconds);
+	put_int(b, dc->maxdepth.mm);
+	put_int(b, dc->meandepth.mm);
+	put_int(b, dc->airtemp.mkelvin);
+	put_int(b, dc->watertemp.mkelvin);
+	put_int(b, dc->surface_pressure.mbar);
+	put_int(b, dc->divemode);
+	put_int(b, dc->no_o2sensors);
+	put_int(b, dc->salinity);
+	put_str(b, dc->model);
+	put_str(b, dc->serial);
+	put_str(b, dc->fw_version);
+	put_int(b, dc->deviceid);
+	put_int(b, dc->diveid);
+
+	/* Lazily loaded samples are stored as reference */
+	put_int(b, dc->sample_repo ? 1 : 0);
+	if (dc->sample_repo)
+		put_bytes(b, (const char *)dc->sample_blob_id, 20);
+	if (dc->packed_samples) {
+		int nr_samples = nr_packed_samples(dc);
+		struct sample *samples = malloc(nr_samples * sizeof(struct sample));
+		get_packed_samples(dc, samples);
+		put_int(b, nr_samples);
+		put_bytes(b, (const char *)samples, nr_samples * sizeof(struct sample));
+		free(samples);
+	} else {
+		put_int(b, dc->samples);
+		put_bytes(b, (const char *)dc->sample, dc->samples * sizeof(struct sample));
+	}
+
+	for (nr = 0, ev = dc->events; ev; ev = ev->next)
+		nr++;
+	put_int(b, nr);
+	for (ev = dc->events; ev; ev = ev->next) {
+		put_int(b, ev->time.seconds);
+		put_int(b, ev->type);
+		put_int(b, ev->flags);
+		put_int(b, ev->value);
+		put_int(b, ev->gas.index);
+		put_int(b, ev->gas.mix.o2.permille);
+		put_int(b, ev->gas.mix.he.permille);
+		put_str(b, ev->name);
+	}
+
+	for (nr = 0, ed = dc->extra_data; ed; ed = ed->next)
+		nr++;
+	put_int(b, nr);
+	for (ed = dc->extra_data; ed; ed = ed->next) {
+		put_str(b, ed->key);
+		put_str(b, ed->value);
+	}
+}
+
+static void load_snapshot_dc(struct snapshot_reader *r, struct divecomputer *dc, int sample_repo)
+{
+	int nr;
+
+	dc->when = get_int64(r);
+	dc->duration.seconds = get_int(r);
+	dc->surfacetime.seconds = get_int(r);
+	dc->last_manual_time.seconds = get_int(r);
+	dc->maxdepth.mm = get_int(r);
+	dc->meandepth.mm = get_int(r);
+	dc->airtemp.mkelvin = get_int(r);
+	dc->watertemp.mkelvin = get_int(r);
+	dc->surface_pressure.mbar = get_int(r);
+	dc->divemode = get_int(r);
+	dc->no_o2sensors = get_int(r);
+	dc->salinity = get_int(r);
+	dc->model = get_str(r);
+	dc->serial = get_str(r);
+	dc->fw_version = get_str(r);
+	dc->deviceid = get_int(r);
+	dc->diveid = get_int(r);
+
+	if (get_int(r)) {
+		/* We can't get at the samples without a repository */
+		if (!sample_repo)
+			r->error = true;
+		dc->sample_repo = sample_repo;
+		get_bytes(r, dc->sample_blob_id, 20);
+	}
+	nr = get_count(r, sizeof(struct sample));
+	if (nr) {
+		dc->sample = malloc(nr * sizeof(struct sample));
+		if (!dc->sample) {
+			r->error = true;
+			return;
+		}
+		get_bytes(r, dc->sample, nr * sizeof(struct sample));
+		dc->samples = dc->alloc_samples = nr;
+	}
+
+	nr = get_count(r, 8 * sizeof(int32_t));
+	for (int i = 0; i < nr && !r->error; i++) {
+		struct event *ev;
+		int time = get_int(r);
+		int type = get_int(r);
+		int flags = get_int(r);
+		int value = get_int(r);
+		int index = get_int(r);
+		int o2 = get_int(r);
+		int he = get_int(r);
+		char *name = get_str(r);
+
+		ev = add_event(dc, time, type, flags, value, name ?: "");
+		if (ev) {
+			ev->gas.index = index;
+			ev->gas.mix.o2.permille = o2;
+			ev->gas.mix.he.permille = he;
+		}
+		free(name);
+	}
+
+	nr = get_count(r, 2 * sizeof(int32_t));
+	for (int i = 0; i < nr && !r->error; i++) {
+		char *key = get_str(r);
+		char *value = get_str(r);
+		add_extra_data(dc, key ?: "", value ?: "");
+		free(key);
+		free(value);
+	}
+}
+
+static void save_snapshot_dive(struct membuffer *b, struct dive *dive, int trip_idx)
+{
+	int nr;
+	struct tag_entry *tag;
+	struct divecomputer *dc;
+
+	put_int64(b, dive->when);
+	put_int(b, trip_idx);
+	put_int(b, dive->dive_site ? dive->dive_site->uuid : 0);
+	put_str(b, dive->notes);
+	put_str(b, dive->divemaster);
+	put_str(b, dive->buddy);
+	put_str(b, dive->suit);
+	put_int(b, dive->number);
+	put_int(b, dive->rating);
+	put_int(b, dive->wavesize);
+	put_int(b, dive->current);
+	put_int(b, dive->visibility);
+	put_int(b, dive->surge);
+	put_int(b, dive->chill);
+	put_int(b, dive->sac);
+	put_int(b, dive->otu);
+	put_int(b, dive->cns);
+	put_int(b, dive->maxcns);
+	put_int(b, dive->mintemp.mkelvin);
+	put_int(b, dive->maxtemp.mkelvin);
+	put_int(b, dive->watertemp.mkelvin);
+	put_int(b, dive->airtemp.mkelvin);
+	put_int(b, dive->maxdepth.mm);
+	put_int(b, dive->meandepth.mm);
+	put_int(b, dive->surface_pressure.mbar);
+	put_int(b, dive->duration.seconds);
+	put_int(b, dive->salinity);
+	put_int(b, dive->user_salinity);
+	put_int(b, dive->notrip);
+	put_int(b, dive->invalid);
+	put_bytes(b, (const char *)dive->git_id, 20);
+
+	put_int(b, dive->cylinders.nr);
+	for (int i = 0; i < dive->cylinders.nr; i++) {
+		const cylinder_t *cyl = &dive->cylinders.cylinders[i];
+		put_int(b, cyl->type.size.mliter);
+		put_int(b, cyl->type.workingpressure.mbar);
+		put_str(b, cyl->type.description);
+		put_int(b, cyl->gasmix.o2.permille);
+		put_int(b, cyl->gasmix.he.permille);
+		put_int(b, cyl->start.mbar);
+		put_int(b, cyl->end.mbar);
+		put_int(b, cyl->sample_start.mbar);
+		put_int(b, cyl->sample_end.mbar);
+		put_int(b, cyl->depth.mm);
+		put_int(b, cyl->manually_added);
+		put_int(b, cyl->gas_used.mliter);
+		put_int(b, cyl->deco_gas_used.mliter);
+		put_int(b, cyl->cylinder_use);
+		put_int(b, cyl->bestmix_o2);
+		put_int(b, cyl->bestmix_he);
+	}
+
+	put_int(b, dive->weightsystems.nr);
+	for (int i = 0; i < dive->weightsystems.nr; i++) {
+		const weightsystem_t *ws = &dive->weightsystems.weightsystems[i];
+		put_int(b, ws->weight.grams);
+		put_str(b, ws->description);
+		put_int(b, ws->auto_filled);
+	}
+
+	for (nr = 0, tag = dive->tag_list; tag; tag = tag->next)
+		nr++;
+	put_int(b, nr);
+	for (tag = dive->tag_list; tag; tag = tag->next)
+		put_str(b, tag->tag->source ?: tag->tag->name);
+
+	put_int(b, dive->pictures.nr);
+	FOR_EACH_PICTURE(dive) {
+		put_str(b, picture->filename);
+		put_int(b, picture->offset.seconds);
+		put_int(b, picture->location.lat.udeg);
+		put_int(b, picture->location.lon.udeg);
+	}
+
+	for (nr = 0, dc = &dive->dc; dc; dc = dc->next)
+		nr++;
+	put_int(b, nr);
+	for_each_dc (dive, dc)
+		save_snapshot_dc(b, dc);
+}
+
+static struct dive *load_snapshot_dive(struct snapshot_reader *r, struct dive_trip **trips, int nr_trips,
+			      struct dive_site_table *sites, int sample_repo)
+{
+	struct dive *dive = alloc_dive();
+	struct divecomputer *dc = NULL;
+	int trip_idx, nr;
+	uint32_t uuid;
+
+	dive->when = get_int64(r);
+	trip_idx = get_int(r);
+	uuid = get_int(r);
+	dive->notes = get_str(r);
+	dive->divemaster = get_str(r);
+	dive->buddy = get_str(r);
+	dive->suit = get_str(r);
+	dive->number = get_int(r);
+	dive->rating = get_int(r);
+	dive->wavesize = get_int(r);
+	dive->current = get_int(r);
+	dive->visibility = get_int(r);
+	dive->surge = get_int(r);
+	dive->chill = get_int(r);
+	dive->sac = get_int(r);
+	dive->otu = get_int(r);
+	dive->cns = get_int(r);
+	dive->maxcns = get_int(r);
+	dive->mintemp.mkelvin = get_int(r);
+	dive->maxtemp.mkelvin = get_int(r);
+	dive->watertemp.mkelvin = get_int(r);
+	dive->airtemp.mkelvin = get_int(r);
+	dive->maxdepth.mm = get_int(r);
+	dive->meandepth.mm = get_int(r);
+	dive->surface_pressure.mbar = get_int(r);
+	dive->duration.seconds = get_int(r);
+	dive->salinity = get_int(r);
+	dive->user_salinity = get_int(r);
+	dive->notrip = get_int(r);
+	dive->invalid = get_int(r);
+	get_bytes(r, dive->git_id, 20);
+
+	nr = get_count(r, 16 * sizeof(int32_t));
+	for (int i = 0; i < nr && !r->error; i++) {
+		cylinder_t cyl = empty_cylinder;
+		cyl.type.size.mliter = get_int(r);
+		cyl.type.workingpressure.mbar = get_int(r);
+		cyl.type.description = get_str(r);
+		cyl.gasmix.o2.permille = get_int(r);
+		cyl.gasmix.he.permille = get_int(r);
+		cyl.start.mbar = get_int(r);
+		cyl.end.mbar = get_int(r);
+		cyl.sample_start.mbar = get_int(r);
+		cyl.sample_end.mbar = get_int(r);
+		cyl.depth.mm = get_int(r);
+		cyl.manually_added = get_int(r);
+		cyl.gas_used.mliter = get_int(r);
+		cyl.deco_gas_used.mliter = get_int(r);
+		cyl.cylinder_use = get_int(r);
+		cyl.bestmix_o2 = get_int(r);
+		cyl.bestmix_he = get_int(r);
+		add_cylinder_description(&cyl.type);
+		add_cylinder(&dive->cylinders, dive->cylinders.nr, cyl);
+	}
+
+	nr = get_count(r, 3 * sizeof(int32_t));
+	for (int i = 0; i < nr && !r->error; i++) {
+		weightsystem_t ws = empty_weightsystem;
+		ws.weight.grams = get_int(r);
+		ws.description = get_str(r);
+		ws.auto_filled = get_int(r);
+		add_weightsystem_description(&ws);
+		add_to_weightsystem_table(&dive->weightsystems, dive->weightsystems.nr, ws);
+	}
+
+	nr = get_count(r, sizeof(int32_t));
+	for (int i = 0; i < nr && !r->error; i++) {
+		char *tag = get_str(r);
+		if (tag)
+			taglist_add_tag(&dive->tag_list, tag);
+		free(tag);
+	}
+
+	nr = get_count(r, 4 * sizeof(int32_t));
+	for (int i = 0; i < nr && !r->error; i++) {
+		struct picture pic = empty_picture;
+		pic.filename = get_str(r);
+		pic.offset.seconds = get_int(r);
+		pic.location.lat.udeg = get_int(r);
+		pic.location.lon.udeg = get_int(r);
+		add_picture(&dive->pictures, pic);
+	}
+
+	nr = get_count(r, sizeof(int32_t));
+	for (int i = 0; i < nr && !r->error; i++) {
+		if (!dc) {
+			dc = &dive->dc;
+		} else {
+			dc->next = calloc(1, sizeof(struct divecomputer));
+			dc = dc->next;
+		}
+		load_snapshot_dc(r, dc, sample_repo);
+	}
+
+	if (uuid)
+		add_dive_to_dive_site(dive, get_dive_site_by_uuid(uuid, sites));
+	if (trip_idx >= 0 && trip_idx < nr_trips)
+		add_dive_to_trip(dive, trips[trip_idx]);
+	return dive;
+}
+
+static void save_filter_presets(struct membuffer *b)
+{
+	int nr = filter_presets_count();
+
+	put_int(b, nr);
+	for (int i = 0; i < nr; i++) {
+		char *name = filter_preset_name(i);
+		char *fulltext = filter_preset_fulltext_query(i);
+		int nr_constraints = filter_preset_constraint_count(i);
+
+		put_str(b, name);
+		put_str(b, fulltext);
+		put_str(b, filter_preset_fulltext_mode(i));
+		free(name);
+		free(fulltext);
+
+		put_int(b, nr_constraints);
+		for (int j = 0; j < nr_constraints; j++) {
+			const struct filter_constraint *constraint = filter_preset_constraint(i, j);
+			char *data = filter_constraint_data_to_string(constraint);
+
+			put_str(b, filter_constraint_type_to_string(constraint->type));
+			put_str(b, filter_constraint_has_string_mode(constraint->type) ?
+				filter_constraint_string_mode_to_string(constraint->string_mode) : NULL);
+			put_str(b, filter_constraint_has_range_mode(constraint->type) ?
+				filter_constraint_range_mode_to_string(constraint->range_mode) : NULL);
+			put_int(b, constraint->negate);
+			put_str(b, data);
+			free(data);
+		}
+	}
+}
+
+static void load_filter_presets(struct snapshot_reader *r, filter_preset_table_t *filter_presets)
+{
+	int nr = get_count(r, 4 * sizeof(int32_t));
+
+	for (int i = 0; i < nr && !r->error; i++) {
+		struct filter_preset *preset = alloc_filter_preset();
+		char *name = get_str(r);
+		char *fulltext = get_str(r);
+		char *mode = get_str(r);
+		int nr_constraints;
+
+		filter_preset_set_name(preset, name ?: "");
+		filter_preset_set_fulltext(preset, fulltext ?: "", mode ?: "");
+		free(name);
+		free(fulltext);
+		free(mode);
+
+		nr_constraints = get_count(r, 5 * sizeof(int32_t));
+		for (int j = 0; j < nr_constraints && !r->error; j++) {
+			char *type = get_str(r);
+			char *string_mode = get_str(r);
+			char *range_mode = get_str(r);
+			bool negate = get_int(r);
+			char *data = get_str(r);
+
+			filter_preset_add_constraint(preset, type ?: "", string_mode, range_mode, negate, data ?: "");
+			free(type);
+			free(string_mode);
+			free(range_mode);
+			free(data);
+		}
+		if (!r->error)
+			add_filter_preset_to_table(preset, filter_presets);
+		free_filter_preset(preset);
+	}
+}
+
+int save_snapshot(const char *filename, const char *git_id, struct dive_table *table, struct trip_table *trips,
+		  struct dive_site_table *sites)
+{
+	struct membuffer b = { 0 };
+	struct membuffer tmpname = { 0 };
+	FILE *f;
+	int last_trip = -1;
+	int ret = 0;
+
+	put_bytes(&b, SNAPSHOT_MAGIC, strlen(SNAPSHOT_MAGIC));
+	put_int(&b, SNAPSHOT_VERSION);
+	put_int(&b, sizeof(struct sample));
+	put_str(&b, git_id);
+
+	save_sites(&b, sites);
+	save_trips(&b, trips);
+	put_int(&b, table->nr);
+	for (int i = 0; i < table->nr; i++) {
+		struct dive *dive = table->dives[i];
+		save_snapshot_dive(&b, dive, dive->divetrip ? get_trip_idx(trips, dive->divetrip, &last_trip) : -1);
+	}
+	save_filter_presets(&b);
+
+	/* Write to a temporary file so that a crash never leaves a half-written snapshot */
+	put_format(&tmpname, "%s.tmp", filename);
+	f = subsurface_fopen(mb_cstring(&tmpname), "wb");
+	if (!f) {
+		ret = -1;
+	} else {
+		flush_buffer(&b, f);
+		if (fclose(f) || subsurface_rename(mb_cstring(&tmpname), filename))
+			ret = -1;
+	}
+	if (ret)
+		remove(mb_cstring(&tmpname));
+	free_buffer(&tmpname);
+	free_buffer(&b);
+	return ret;
+}
+
+/*
+ * Returns 0 if the snapshot for commit git_id could be loaded. On
+ * failure, nothing has been added to the tables.
+ */
+int load_snapshot(const char *filename, const char *git_id, int sample_repo, struct dive_table *table,
+		  struct trip_table *trips, struct dive_site_table *sites, filter_preset_table_t *filter_presets)
+{
+	struct memblock mem;
+	struct snapshot_reader r;
+	struct dive_table dives = empty_dive_table;
+	struct trip_table new_trips = empty_trip_table;
+	struct dive_site_table new_sites = empty_dive_site_table;
+	struct dive_trip **trip_array;
+	unsigned char *trip_ids;
+	char *id;
+	int nr;
+
+	if (map_file(filename, &mem) <= 0)
+		return -1;
+	r.p = mem.buffer;
+	r.end = r.p + mem.size;
+	r.error = false;
+
+	if (mem.size < strlen(SNAPSHOT_MAGIC) || memcmp(r.p, SNAPSHOT_MAGIC, strlen(SNAPSHOT_MAGIC))) {
+		free_memblock(&mem);
+		return -1;
+	}
+	r.p += strlen(SNAPSHOT_MAGIC);
+	if (get_int(&r) != SNAPSHOT_VERSION || get_int(&r) != sizeof(struct sample)) {
+		free_memblock(&mem);
+		return -1;
+	}
+	id = get_str(&r);
+	if (!same_string(id, git_id)) {
+		free(id);
+		free_memblock(&mem);
+		return -1;
+	}
+	free(id);
+
+	/* Load into private tables, so that a corrupt snapshot doesn't leave half-loaded data */
+	load_sites(&r, &new_sites);
+
+	nr = get_count(&r, 3 * sizeof(int32_t) + 20);
+	trip_array = calloc(nr ? nr : 1, sizeof(struct dive_trip *));
+	trip_ids = calloc(nr ? nr : 1, 20);
+	for (int i = 0; i < nr && !r.error; i++) {
+		trip_array[i] = alloc_trip();
+		trip_array[i]->location = get_str(&r);
+		trip_array[i]->notes = get_str(&r);
+		trip_array[i]->autogen = get_int(&r);
+		get_bytes(&r, trip_ids + 20 * i, 20);
+	}
+
+	int nr_dives = get_count(&r, 32 * sizeof(int32_t));
+	for (int i = 0; i < nr_dives && !r.error; i++)
+		add_to_dive_table(&dives, dives.nr, load_snapshot_dive(&r, trip_array, nr, &new_sites, sample_repo));
+
+	/* The trips can only be sorted once they contain their dives.
+	 * Adding the dives invalidated the tree ids, so restore them now. */
+	for (int i = 0; i < nr; i++) {
+		if (trip_array[i]) {
+			memcpy(trip_array[i]->git_id, trip_ids + 20 * i, 20);
+			insert_trip(trip_array[i], &new_trips);
+		}
+	}
+	free(trip_array);
+	free(trip_ids);
+
+	if (!r.error)
+		load_filter_presets(&r, filter_presets);
+	free_memblock(&mem);
+
+	if (r.error) {
+		report_error("Ignoring corrupt snapshot %s", filename);
+		clear_dive_table(&dives);
+		clear_trip_table(&new_trips);
+		clear_dive_site_table(&new_sites);
+		free(dives.dives);
+		free(new_trips.trips);
+		free(new_sites.dive_sites);
+		return -1;
+	}
+
+	for (int i = 0; i < dives.nr; i++)
+		add_to_dive_table(table, table->nr, dives.dives[i]);
+	for (int i = 0; i < new_trips.nr; i++)
+		insert_trip(new_trips.trips[i], trips);
+	for (int i = 0; i < new_sites.nr; i++)
+		add_dive_site_to_table(new_sites.dive_sites[i], sites);
+	free(dives.dives);
+	free(new_trips.trips);
+	free(new_sites.dive_sites);
+	return 0;
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "filterpreset.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dive_table;
+struct trip_table;
+struct dive_site_table;
+
+/*
+ * A snapshot is a binary dump of the dives, trips, dive sites and
+ * filter presets of a git logbook, tagged with the id of the commit
+ * it was created from. It is only a cache to avoid walking the git
+ * tree on start-up: the format is host specific and a snapshot with
+ * a different version or commit id is simply ignored.
+ *
+ * Divecomputers with lazily loaded samples are stored as a reference
+ * to the sample blob. These get sample_repo set on load, or make the
+ * load fail if sample_repo is 0.
+ */
+extern int save_snapshot(const char *filename, const char *git_id, struct dive_table *table, struct trip_table *trips,
+			 struct dive_site_table *sites);
+extern int load_snapshot(const char *filename, const char *git_id, int sample_repo, struct dive_table *table,
+			 struct trip_table *trips, struct dive_site_table *sites, filter_preset_table_t *filter_presets);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SNAPSHOT_H
@@ -81,6 +81,16 @@ static void process_dive(struct dive *dive, stats_t *stats)
 	}
 }
 
+/* copy the statistics, but keep the label of the destination */
+static void copy_summary(stats_t *dest, const stats_t *src)
+{
+	char *location = dest->location;
+	bool is_trip = dest->is_trip;
+	*dest = *src;
+	dest->location = location;
+	dest->is_trip = is_trip;
+}
+
 char *get_minutes(int seconds)
 {
 	static char buf[80];
@@ -108,13 +118,6 @@ void calculate_stats_summary(struct stats_summary *out, bool selected_only)
 	int trip_iter = 0;
 	dive_trip_t *trip_ptr = 0;
 	size_t size, tsize, dsize, tmsize;
-	stats_t stats = { 0 };
-
-	if (dive_table.nr > 0) {
-		stats.shortest_time.seconds = dive_table.dives[0]->duration.seconds;
-		stats.min_depth.mm = dive_table.dives[0]->maxdepth.mm;
-		stats.selection_size = dive_table.nr;
-	}
 
 	/* allocate sufficient space to hold the worst
 	 * case (one dive per year or all dives during
@@ -168,7 +171,6 @@ void calculate_stats_summary(struct stats_summary *out, bool selected_only)
 			continue;
 		if (dp->invalid)
 			continue;
-		process_dive(dp, &stats);
 
 		/* yearly statistics */
 		utc_mkdate(dp->when, &tm);
@@ -185,17 +187,15 @@ void calculate_stats_summary(struct stats_summary *out, bool selected_only)
 		out->stats_yearly[year_iter].selection_size++;
 		out->stats_yearly[year_iter].period = current_year;
 
-		/* stats_by_type[0] is all the dives combined */
+		/* stats_by_type[0] is all the dives combined. The same
+		 * summary is copied to stats_by_depth[0] and stats_by_temp[0]
+		 * after the loop. */
 		out->stats_by_type[0].selection_size++;
 		process_dive(dp, &(out->stats_by_type[0]));
 
 		process_dive(dp, &(out->stats_by_type[dp->dc.divemode + 1]));
 		out->stats_by_type[dp->dc.divemode + 1].selection_size++;
 
-		/* stats_by_depth[0] is all the dives combined */
-		out->stats_by_depth[0].selection_size++;
-		process_dive(dp, &(out->stats_by_depth[0]));
-
 		d_idx = dp->maxdepth.mm / (STATS_DEPTH_BUCKET * 1000);
 		if (d_idx < 0)
 			d_idx = 0;
@@ -204,10 +204,6 @@ void calculate_stats_summary(struct stats_summary *out, bool selected_only)
 		process_dive(dp, &(out->stats_by_depth[d_idx + 1]));
 		out->stats_by_depth[d_idx + 1].selection_size++;
 
-		/* stats_by_temp[0] is all the dives combined */
-		out->stats_by_temp[0].selection_size++;
-		process_dive(dp, &(out->stats_by_temp[0]));
-
 		t_idx = ((int)mkelvin_to_C(dp->mintemp.mkelvin)) / STATS_TEMP_BUCKET;
 		if (t_idx < 0)
 			t_idx = 0;
@@ -225,8 +221,6 @@ void calculate_stats_summary(struct stats_summary *out, bool selected_only)
 			/* stats_by_trip[0] is all the dives combined */
 			out->stats_by_trip[0].selection_size++;
 			process_dive(dp, &(out->stats_by_trip[0]));
-			out->stats_by_trip[0].is_trip = true;
-			out->stats_by_trip[0].location = strdup(translate("gettextFromC", "All (by trip stats)"));
 
 			process_dive(dp, &(out->stats_by_trip[trip_iter]));
 			out->stats_by_trip[trip_iter].selection_size++;
@@ -250,6 +244,16 @@ void calculate_stats_summary(struct stats_summary *out, bool selected_only)
 		prev_year = current_year;
 	}
 
+	if (out->stats_by_trip[0].selection_size) {
+		out->stats_by_trip[0].is_trip = true;
+		out->stats_by_trip[0].location = strdup(translate("gettextFromC", "All (by trip stats)"));
+	}
+
+	/* the combined depth and temperature summaries are the same as the
+	 * combined type summary - only the labels differ */
+	copy_summary(&out->stats_by_depth[0], &out->stats_by_type[0]);
+	copy_summary(&out->stats_by_temp[0], &out->stats_by_type[0]);
+
 	/* add labels for depth ranges up to maximum depth seen */
 	if (out->stats_by_depth[0].selection_size) {
 		d_idx = out->stats_by_depth[0].max_depth.mm;
@@ -378,7 +382,7 @@ volume_t *get_gas_used(struct dive *dive)
 		start = cyl->start.mbar ? cyl->start : cyl->sample_start;
 		end = cyl->end.mbar ? cyl->end : cyl->sample_end;
 		if (end.mbar && start.mbar > end.mbar)
-			gases[idx].mliter = gas_volume(cyl, start) - gas_volume(cyl, end);
+			gases[idx].mliter = gas_volume_used(cyl, start, end);
 		else
 			gases[idx].mliter = 0;
 	}
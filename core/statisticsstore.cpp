@@ -0,0 +1,349 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "statisticsstore.h"
+#include "dive.h"
+#include "divelist.h"
+#include "gettext.h"
+#include "subsurface-time.h"
+#include "trip.h"
+#include <algorithm>
+#include <vector>
+#include <cmath>
+#include <cstring>
+
+StatisticsStore &StatisticsStore::instance()
+{
+	static StatisticsStore self;
+	return self;
+}
+
+StatisticsStore::StatisticsStore() : valid(false)
+{
+}
+
+void StatisticsStore::invalidate()
+{
+	valid = false;
+}
+
+// Buckets as in calculate_stats_summary()
+static int depth_bucket(const struct dive *d)
+{
+	int idx = d->maxdepth.mm / (STATS_DEPTH_BUCKET * 1000);
+	return std::max(0, std::min(idx, STATS_MAX_DEPTH / STATS_DEPTH_BUCKET - 1));
+}
+
+static int temp_bucket(const struct dive *d)
+{
+	int idx = ((int)mkelvin_to_C(d->mintemp.mkelvin)) / STATS_TEMP_BUCKET;
+	return std::max(0, std::min(idx, STATS_MAX_TEMP / STATS_TEMP_BUCKET - 1));
+}
+
+StatisticsStore::Contribution StatisticsStore::contribution(const struct dive *d)
+{
+	Contribution c;
+	struct tm tm;
+	utc_mkdate(d->when, &tm);
+	c.valid = !d->invalid;
+	c.year = tm.tm_year;
+	c.month = tm.tm_mon + 1;
+	c.trip = d->divetrip;
+	c.divemode = std::max(0, std::min((int)d->dc.divemode, NUM_DIVEMODE - 1));
+	c.depthBucket = depth_bucket(d);
+	c.tempBucket = temp_bucket(d);
+	c.duration = d->duration.seconds;
+	c.maxdepth = d->maxdepth.mm;
+	c.meandepth = d->meandepth.mm;
+	c.sac = d->sac;
+	c.mintemp = d->mintemp.mkelvin;
+	c.maxtemp = d->maxtemp.mkelvin;
+	// Same as process_temperatures(): the mean temperature, or zero if the dive has no temperature.
+	c.meantemp = c.mintemp ? (c.mintemp + c.maxtemp) / 2 : c.maxtemp;
+	return c;
+}
+
+// Dives without a duration and bogus SAC values of less than .1 l/min are not considered for the SAC
+bool StatisticsStore::hasSac(const Contribution &c)
+{
+	return c.duration && c.sac > 100;
+}
+
+// For the minima, zero means "unset", as in process_dive()
+static void set_min(int &v, int x)
+{
+	if (x && (!v || x < v))
+		v = x;
+}
+
+static void set_max(int &v, int x)
+{
+	if (x > v)
+		v = x;
+}
+
+void StatisticsStore::includeExtrema(Bucket &b, const Contribution &c)
+{
+	set_min(b.shortest, c.duration);
+	set_max(b.longest, c.duration);
+	set_min(b.minDepth, c.maxdepth);
+	set_max(b.maxDepth, c.maxdepth);
+	if (hasSac(c)) {
+		set_min(b.minSac, c.sac);
+		set_max(b.maxSac, c.sac);
+	}
+	set_min(b.minTemp, c.mintemp);
+	set_max(b.maxTemp, c.maxtemp);
+}
+
+void StatisticsStore::addToBucket(Bucket &b, const struct dive *d, const Contribution &c)
+{
+	++b.count;
+	b.totalTime += c.duration;
+	b.combinedMaxDepth += c.maxdepth;
+	if (c.meantemp) {
+		b.combinedTemp += c.meantemp;
+		++b.combinedTempCount;
+	}
+	if (c.duration && c.meandepth) {
+		b.depthTime += c.duration;
+		b.depthTimeSum += (int64_t)c.duration * c.meandepth;
+	}
+	if (hasSac(c)) {
+		b.sacTime += c.duration;
+		b.sacTimeSum += (int64_t)c.duration * c.sac;
+	}
+	b.members.insert(d);
+	if (b.extremaValid)
+		includeExtrema(b, c);
+}
+
+void StatisticsStore::removeFromBucket(Bucket &b, const struct dive *d, const Contribution &c)
+{
+	--b.count;
+	b.totalTime -= c.duration;
+	b.combinedMaxDepth -= c.maxdepth;
+	if (c.meantemp) {
+		b.combinedTemp -= c.meantemp;
+		--b.combinedTempCount;
+	}
+	if (c.duration && c.meandepth) {
+		b.depthTime -= c.duration;
+		b.depthTimeSum -= (int64_t)c.duration * c.meandepth;
+	}
+	if (hasSac(c)) {
+		b.sacTime -= c.duration;
+		b.sacTimeSum -= (int64_t)c.duration * c.sac;
+	}
+	b.members.erase(d);
+
+	// If the dive defined one of the extrema, these have to be recalculated.
+	if (c.duration == b.shortest || c.duration == b.longest ||
+	    c.maxdepth == b.minDepth || c.maxdepth == b.maxDepth ||
+	    (hasSac(c) && (c.sac == b.minSac || c.sac == b.maxSac)) ||
+	    c.mintemp == b.minTemp || c.maxtemp == b.maxTemp)
+		b.extremaValid = false;
+}
+
+void StatisticsStore::updateExtrema(Bucket &b) const
+{
+	if (b.extremaValid)
+		return;
+	b.shortest = b.longest = b.minDepth = b.maxDepth = 0;
+	b.minSac = b.maxSac = b.minTemp = b.maxTemp = 0;
+	for (const dive *d: b.members)
+		includeExtrema(b, contributions.at(d));
+	b.extremaValid = true;
+}
+
+void StatisticsStore::add(const struct dive *d, const Contribution &c)
+{
+	if (!c.valid)
+		return;
+	addToBucket(all, d, c);
+	addToBucket(years[c.year], d, c);
+	addToBucket(months[c.year * 100 + c.month], d, c);
+	if (c.trip) {
+		addToBucket(allTrips, d, c);
+		addToBucket(trips[c.trip], d, c);
+	}
+	addToBucket(types[c.divemode], d, c);
+	addToBucket(depths[c.depthBucket], d, c);
+	addToBucket(temps[c.tempBucket], d, c);
+}
+
+// Remove a dive from a bucket in a map and remove the bucket when it becomes empty
+template <typename Map, typename Key, typename Function>
+static void removeFromMap(Map &map, const Key &key, Function removeFromBucket)
+{
+	auto it = map.find(key);
+	if (it == map.end())
+		return;
+	removeFromBucket(it->second);
+	if (it->second.count <= 0)
+		map.erase(it);
+}
+
+void StatisticsStore::remove(const struct dive *d, const Contribution &c)
+{
+	if (!c.valid)
+		return;
+	auto removeDive = [this, d, &c](Bucket &b) { removeFromBucket(b, d, c); };
+	removeDive(all);
+	removeFromMap(years, c.year, removeDive);
+	removeFromMap(months, c.year * 100 + c.month, removeDive);
+	if (c.trip) {
+		removeDive(allTrips);
+		removeFromMap(trips, c.trip, removeDive);
+	}
+	removeDive(types[c.divemode]);
+	removeDive(depths[c.depthBucket]);
+	removeDive(temps[c.tempBucket]);
+}
+
+void StatisticsStore::updateDive(const struct dive *d)
+{
+	if (!valid)
+		return; // Will be calculated on next access
+	auto it = contributions.find(d);
+	if (it != contributions.end())
+		remove(d, it->second);
+	Contribution c = contribution(d);
+	contributions[d] = c;
+	add(d, c);
+}
+
+void StatisticsStore::removeDive(const struct dive *d)
+{
+	if (!valid)
+		return;
+	auto it = contributions.find(d);
+	if (it == contributions.end())
+		return;
+	remove(d, it->second);
+	contributions.erase(it);
+}
+
+void StatisticsStore::rebuild()
+{
+	contributions.clear();
+	all = allTrips = Bucket();
+	years.clear();
+	months.clear();
+	trips.clear();
+	std::fill(std::begin(types), std::end(types), Bucket());
+	std::fill(std::begin(depths), std::end(depths), Bucket());
+	std::fill(std::begin(temps), std::end(temps), Bucket());
+
+	contributions.reserve(dive_table.nr);
+	for (int i = 0; i < dive_table.nr; ++i) {
+		const struct dive *d = dive_table.dives[i];
+		Contribution c = contribution(d);
+		contributions[d] = c;
+		add(d, c);
+	}
+	valid = true;
+}
+
+stats_t StatisticsStore::toStats(Bucket &b) const
+{
+	updateExtrema(b);
+	stats_t s;
+	memset(&s, 0, sizeof(s));
+	s.selection_size = b.count;
+	s.total_time.seconds = (int)b.totalTime;
+	s.total_average_depth_time.seconds = (int)b.depthTime;
+	s.shortest_time.seconds = b.shortest;
+	s.longest_time.seconds = b.longest;
+	s.max_depth.mm = b.maxDepth;
+	s.min_depth.mm = b.minDepth;
+	s.avg_depth.mm = b.depthTime ? lrint((double)b.depthTimeSum / b.depthTime) : 0;
+	s.combined_max_depth.mm = (int)b.combinedMaxDepth;
+	s.max_sac.mliter = b.maxSac;
+	s.min_sac.mliter = b.minSac;
+	s.avg_sac.mliter = b.sacTime ? lrint((double)b.sacTimeSum / b.sacTime) : 0;
+	s.total_sac_time.seconds = (int)b.sacTime;
+	s.max_temp.mkelvin = b.maxTemp;
+	s.min_temp.mkelvin = b.minTemp;
+	s.combined_temp.mkelvin = b.combinedTemp;
+	s.combined_count = b.combinedTempCount;
+	return s;
+}
+
+static stats_t with_label(stats_t s, const char *label)
+{
+	s.is_trip = true;
+	s.location = strdup(label);
+	return s;
+}
+
+void StatisticsStore::summary(struct stats_summary *out)
+{
+	// Dives may have been added or removed by code that doesn't go through the notifier
+	if (!valid || (int)contributions.size() != dive_table.nr)
+		rebuild();
+
+	const int numDepths = STATS_MAX_DEPTH / STATS_DEPTH_BUCKET;
+	const int numTemps = STATS_MAX_TEMP / STATS_TEMP_BUCKET;
+	free_stats_summary(out);
+	// The tables are terminated by an empty entry
+	out->stats_yearly = (stats_t *)calloc(years.size() + 1, sizeof(stats_t));
+	out->stats_monthly = (stats_t *)calloc(months.size() + 1, sizeof(stats_t));
+	out->stats_by_trip = (stats_t *)calloc(trips.size() + 2, sizeof(stats_t));
+	out->stats_by_type = (stats_t *)calloc(NUM_DIVEMODE + 1, sizeof(stats_t));
+	out->stats_by_depth = (stats_t *)calloc(numDepths + 2, sizeof(stats_t));
+	out->stats_by_temp = (stats_t *)calloc(numTemps + 2, sizeof(stats_t));
+	if (!out->stats_yearly || !out->stats_monthly || !out->stats_by_trip ||
+	    !out->stats_by_type || !out->stats_by_depth || !out->stats_by_temp)
+		return;
+
+	out->stats_yearly[0].is_year = true;
+	int i = 0;
+	for (auto &year: years) {
+		out->stats_yearly[i] = toStats(year.second);
+		out->stats_yearly[i].is_year = true;
+		out->stats_yearly[i].period = year.first;
+		++i;
+	}
+
+	i = 0;
+	for (auto &month: months) {
+		out->stats_monthly[i] = toStats(month.second);
+		out->stats_monthly[i].period = month.first % 100;
+		++i;
+	}
+
+	if (allTrips.count > 0) {
+		out->stats_by_trip[0] = with_label(toStats(allTrips), translate("gettextFromC", "All (by trip stats)"));
+		std::vector<const dive_trip *> sortedTrips;
+		sortedTrips.reserve(trips.size());
+		for (auto &trip: trips)
+			sortedTrips.push_back(trip.first);
+		std::sort(sortedTrips.begin(), sortedTrips.end(), [](const dive_trip *t1, const dive_trip *t2)
+			  { return trip_date(t1) != trip_date(t2) ? trip_date(t1) < trip_date(t2) : t1 < t2; });
+		i = 1;
+		for (const dive_trip *trip: sortedTrips) {
+			out->stats_by_trip[i] = toStats(trips[trip]);
+			out->stats_by_trip[i].is_trip = true;
+			out->stats_by_trip[i].location = trip->location;
+			++i;
+		}
+	}
+
+	out->stats_by_type[0] = with_label(toStats(all), translate("gettextFromC", "All (by type stats)"));
+	for (i = 0; i < NUM_DIVEMODE; ++i)
+		out->stats_by_type[i + 1] = with_label(toStats(types[i]), translate("gettextFromC", divemode_text_ui[i]));
+
+	// Label the depth and temperature ranges up to the maximum seen
+	out->stats_by_depth[0] = with_label(toStats(all), translate("gettextFromC", "All (by max depth stats)"));
+	int maxDepth = std::min(out->stats_by_depth[0].max_depth.mm, STATS_MAX_DEPTH * 1000);
+	for (i = 0; i < numDepths; ++i) {
+		out->stats_by_depth[i + 1] = toStats(depths[i]);
+		out->stats_by_depth[i + 1].is_trip = all.count > 0 && i * (STATS_DEPTH_BUCKET * 1000) < maxDepth;
+	}
+
+	out->stats_by_temp[0] = with_label(toStats(all), translate("gettextFromC", "All (by min. temp stats)"));
+	int maxTemp = std::min((int)mkelvin_to_C(out->stats_by_temp[0].max_temp.mkelvin), STATS_MAX_TEMP);
+	for (i = 0; i < numTemps; ++i) {
+		out->stats_by_temp[i + 1] = toStats(temps[i]);
+		out->stats_by_temp[i + 1].is_trip = all.count > 0 && i * STATS_TEMP_BUCKET < maxTemp;
+	}
+}
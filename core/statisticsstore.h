@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: GPL-2.0
+// The yearly, monthly, trip, dive mode, depth and temperature statistics of all
+// valid dives. Contrary to calculate_stats_summary(), the statistics are not
+// recalculated from scratch, but updated incrementally by the DiveListNotifier:
+// the contribution of every dive is remembered, so that it can be removed from
+// the sums of its buckets when the dive is changed or deleted. The extrema of a
+// bucket can't be updated that way and are recalculated from the members of the
+// bucket when a dive that may have defined them is removed.
+//
+// Since the store is updated via signals, it must only be accessed from the GUI thread.
+#ifndef STATISTICS_STORE_H
+#define STATISTICS_STORE_H
+
+#include "statistics.h"
+#include "divemode.h"
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+struct dive;
+struct dive_trip;
+
+class StatisticsStore {
+public:
+	static StatisticsStore &instance();
+	// Fill the summary in the same layout as calculate_stats_summary(out, false).
+	void summary(struct stats_summary *out);
+
+	void invalidate();
+	void updateDive(const struct dive *d);
+	void removeDive(const struct dive *d);
+private:
+	StatisticsStore();
+
+	// The values a dive contributes to its buckets
+	struct Contribution {
+		bool valid;		// Invalid dives are not counted
+		int year, month;
+		const dive_trip *trip;
+		int divemode;
+		int depthBucket, tempBucket;
+		int duration, maxdepth, meandepth, sac;
+		int mintemp, maxtemp, meantemp;
+	};
+
+	struct Bucket {
+		int count = 0;
+		int64_t totalTime = 0;
+		int64_t combinedMaxDepth = 0;
+		int64_t depthTime = 0, depthTimeSum = 0;	// Dives with a mean depth: duration and duration * mean depth
+		int64_t sacTime = 0, sacTimeSum = 0;		// Dives with a SAC: duration and duration * SAC
+		uint64_t combinedTemp = 0;
+		int combinedTempCount = 0;
+
+		bool extremaValid = true;
+		int shortest = 0, longest = 0, minDepth = 0, maxDepth = 0;
+		int minSac = 0, maxSac = 0, minTemp = 0, maxTemp = 0;
+		std::unordered_set<const dive *> members;	// For recalculating the extrema
+	};
+
+	static Contribution contribution(const struct dive *d);
+	static bool hasSac(const Contribution &c);
+	static void includeExtrema(Bucket &b, const Contribution &c);
+	void add(const struct dive *d, const Contribution &c);
+	void remove(const struct dive *d, const Contribution &c);
+	void addToBucket(Bucket &b, const struct dive *d, const Contribution &c);
+	void removeFromBucket(Bucket &b, const struct dive *d, const Contribution &c);
+	void updateExtrema(Bucket &b) const;
+	stats_t toStats(Bucket &b) const;
+	void rebuild();
+
+	bool valid;
+	std::unordered_map<const dive *, Contribution> contributions; // All dives, including invalid ones
+	Bucket all;
+	Bucket allTrips;
+	std::map<int, Bucket> years;
+	std::map<int, Bucket> months;			// Key: year * 100 + month
+	std::map<const dive_trip *, Bucket> trips;
+	Bucket types[NUM_DIVEMODE];
+	Bucket depths[STATS_MAX_DEPTH / STATS_DEPTH_BUCKET];
+	Bucket temps[STATS_MAX_TEMP / STATS_TEMP_BUCKET];
+};
+
+#endif
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: GPL-2.0
+/* stringpool.c */
+/* interned strings of the dive equipment and people fields */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stringpool.h"
+#include "arena.h"
+#include "qthelper.h"
+
+/* Never cleared, so that interned strings survive closing a logbook */
+static struct arena pool_arena;
+
+/* Open addressing hash set, size is a power of two and at most half full */
+static const char **pool;
+static unsigned int pool_size, pool_used;
+
+static uint32_t hash_string(const char *s)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*s)
+		hash = (hash ^ (unsigned char)*s++) * 16777619u;
+	return hash;
+}
+
+/* Has to be called with the arena lock held */
+static const char **find_slot(const char **table, unsigned int size, const char *s, uint32_t hash)
+{
+	unsigned int idx = hash & (size - 1);
+
+	while (table[idx] && strcmp(table[idx], s))
+		idx = (idx + 1) & (size - 1);
+	return &table[idx];
+}
+
+static void grow_pool(void)
+{
+	unsigned int new_size = pool_size ? pool_size * 2 : 1024;
+	const char **new_pool = calloc(new_size, sizeof(const char *));
+
+	if (!new_pool)
+		exit(1);
+	for (unsigned int i = 0; i < pool_size; i++) {
+		if (pool[i])
+			*find_slot(new_pool, new_size, pool[i], hash_string(pool[i])) = pool[i];
+	}
+	free(pool);
+	pool = new_pool;
+	pool_size = new_size;
+}
+
+const char *intern_string(const char *s)
+{
+	const char **slot;
+	const char *res;
+	char *copy;
+	uint32_t hash;
+
+	if (!s)
+		return NULL;
+	hash = hash_string(s);
+
+	lock_arena();
+	res = pool_size ? *find_slot(pool, pool_size, s, hash) : NULL;
+	unlock_arena();
+	if (res)
+		return res;
+
+	/* arena_strdup() takes the lock itself, so the slot has to be searched again */
+	copy = arena_strdup(&pool_arena, s);
+	lock_arena();
+	if ((pool_used + 1) * 2 > pool_size)
+		grow_pool();
+	slot = find_slot(pool, pool_size, s, hash);
+	if (!*slot) {
+		*slot = copy;
+		pool_used++;
+	}
+	res = *slot;
+	unlock_arena();
+	return res;
+}
+
+int is_interned_string(const char *s)
+{
+	const char *res;
+
+	if (!s || !pool_size)
+		return 0;
+	lock_arena();
+	res = *find_slot(pool, pool_size, s, hash_string(s));
+	unlock_arena();
+	return res == s;
+}
+
+const char *intern_and_free(const char *s)
+{
+	const char *res = intern_string(s);
+
+	if (res != s)
+		arena_free((void *)s);
+	return res;
+}
@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef STRINGPOOL_H
+#define STRINGPOOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A global pool of the short strings that are repeated over and over in
+ * a logbook: buddies, divemasters, suits, cylinder and weightsystem
+ * descriptions and the keys of the dive computer extra data. intern_string() returns a pointer to the pooled copy of
+ * its argument, which stays valid for the lifetime of the program. Thus,
+ * two interned strings are equal if and only if they are the same pointer.
+ *
+ * Interned strings live in an arena, so the fields that hold them must be
+ * freed with arena_free(), which ignores them.
+ */
+extern const char *intern_string(const char *s);
+extern int is_interned_string(const char *s);
+
+/* Like intern_string(), but frees s if it wasn't interned already */
+extern const char *intern_and_free(const char *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STRINGPOOL_H
@@ -1,4 +1,193 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "divelistnotifier.h"
+#include "core/divesummarytable.h"
+#include "core/statisticsstore.h"
 
 DiveListNotifier diveListNotifier;
+
+// The summary table has to be invalidated before the models and the filter
+// react to a change. Therefore, connect it first, when the notifier is created.
+// The same goes for the statistics store.
+DiveListNotifier::DiveListNotifier() : transactionDepth(0), changedFields(DiveField::NONE)
+{
+	// Pending notifications concern the state before the structural change.
+	// After a reset, they may refer to dives that don't exist anymore.
+	connect(this, &DiveListNotifier::dataReset, [this] { clearBuffer(); });
+	connect(this, &DiveListNotifier::divesAdded, [this] { flush(); });
+	connect(this, &DiveListNotifier::divesDeleted, [this] { flush(); });
+	connect(this, &DiveListNotifier::divesMovedBetweenTrips, [this] { flush(); });
+
+	auto invalidate = [] { DiveSummaryTable::instance().invalidate(); };
+	connect(this, &DiveListNotifier::dataReset, invalidate);
+	connect(this, &DiveListNotifier::divesAdded, invalidate);
+	connect(this, &DiveListNotifier::divesDeleted, invalidate);
+	connect(this, &DiveListNotifier::divesChanged, invalidate);
+	connect(this, &DiveListNotifier::divesTimeChanged, invalidate);
+	connect(this, &DiveListNotifier::cylindersReset, invalidate);
+	connect(this, &DiveListNotifier::cylinderAdded, invalidate);
+	connect(this, &DiveListNotifier::cylinderRemoved, invalidate);
+	connect(this, &DiveListNotifier::cylinderEdited, invalidate);
+	connect(this, &DiveListNotifier::weightsystemsReset, invalidate);
+	connect(this, &DiveListNotifier::weightAdded, invalidate);
+	connect(this, &DiveListNotifier::weightRemoved, invalidate);
+	connect(this, &DiveListNotifier::weightEdited, invalidate);
+	connect(this, &DiveListNotifier::eventsChanged, invalidate);
+
+	// The statistics store is updated dive by dive
+	StatisticsStore &stats = StatisticsStore::instance();
+	auto updateDives = [&stats](const QVector<dive *> &dives) {
+		for (const dive *d: dives)
+			stats.updateDive(d);
+	};
+	auto updateDive = [&stats](dive *d) { stats.updateDive(d); };
+	connect(this, &DiveListNotifier::dataReset, [&stats] { stats.invalidate(); });
+	connect(this, &DiveListNotifier::divesAdded, [updateDives](dive_trip *, bool, const QVector<dive *> &dives)
+		{ updateDives(dives); });
+	connect(this, &DiveListNotifier::divesDeleted, [&stats](dive_trip *, bool, const QVector<dive *> &dives) {
+		for (const dive *d: dives)
+			stats.removeDive(d);
+	});
+	connect(this, &DiveListNotifier::divesMovedBetweenTrips,
+		[updateDives](dive_trip *, dive_trip *, bool, bool, const QVector<dive *> &dives) { updateDives(dives); });
+	connect(this, &DiveListNotifier::divesChanged, [updateDives](const QVector<dive *> &dives, DiveField)
+		{ updateDives(dives); });
+	connect(this, &DiveListNotifier::divesTimeChanged, [updateDives](timestamp_t, const QVector<dive *> &dives)
+		{ updateDives(dives); });
+	connect(this, &DiveListNotifier::cylindersReset, updateDives);
+	connect(this, &DiveListNotifier::cylinderAdded, updateDive);
+	connect(this, &DiveListNotifier::cylinderRemoved, updateDive);
+	connect(this, &DiveListNotifier::cylinderEdited, updateDive);
+	connect(this, &DiveListNotifier::eventsChanged, updateDive);
+}
+
+static void addFields(DiveField &to, DiveField from)
+{
+	to.nr |= from.nr;
+	to.datetime |= from.datetime;
+	to.depth |= from.depth;
+	to.duration |= from.duration;
+	to.air_temp |= from.air_temp;
+	to.water_temp |= from.water_temp;
+	to.atm_press |= from.atm_press;
+	to.divesite |= from.divesite;
+	to.divemaster |= from.divemaster;
+	to.buddy |= from.buddy;
+	to.rating |= from.rating;
+	to.visibility |= from.visibility;
+	to.wavesize |= from.wavesize;
+	to.current |= from.current;
+	to.surge |= from.surge;
+	to.chill |= from.chill;
+	to.suit |= from.suit;
+	to.tags |= from.tags;
+	to.mode |= from.mode;
+	to.notes |= from.notes;
+	to.salinity |= from.salinity;
+	to.invalid |= from.invalid;
+}
+
+void DiveListNotifier::DiveBuffer::add(const QVector<dive *> &newDives)
+{
+	for (dive *d: newDives) {
+		if (!set.contains(d)) {
+			set.insert(d);
+			dives.push_back(d);
+		}
+	}
+}
+
+void DiveListNotifier::DiveBuffer::clear()
+{
+	dives.clear();
+	set.clear();
+}
+
+void DiveListNotifier::beginTransaction()
+{
+	++transactionDepth;
+}
+
+void DiveListNotifier::endTransaction()
+{
+	if (--transactionDepth == 0)
+		flush();
+}
+
+void DiveListNotifier::changeDives(const QVector<dive *> &dives, DiveField field)
+{
+	if (transactionDepth == 0) {
+		emit divesChanged(dives, field);
+		return;
+	}
+	changedDives.add(dives);
+	addFields(changedFields, field);
+}
+
+void DiveListNotifier::changeDivesTime(timestamp_t delta, const QVector<dive *> &dives)
+{
+	if (transactionDepth == 0) {
+		emit divesTimeChanged(delta, dives);
+		return;
+	}
+	timeChangedDives.add(dives);
+	for (dive *d: dives)
+		timeDeltas[d] += delta;
+}
+
+void DiveListNotifier::resetCylinders(const QVector<dive *> &dives)
+{
+	if (transactionDepth == 0)
+		emit cylindersReset(dives);
+	else
+		cylinderDives.add(dives);
+}
+
+void DiveListNotifier::resetWeightsystems(const QVector<dive *> &dives)
+{
+	if (transactionDepth == 0)
+		emit weightsystemsReset(dives);
+	else
+		weightDives.add(dives);
+}
+
+void DiveListNotifier::clearBuffer()
+{
+	changedDives.clear();
+	changedFields = DiveField(DiveField::NONE);
+	timeChangedDives.clear();
+	timeDeltas.clear();
+	cylinderDives.clear();
+	weightDives.clear();
+}
+
+// Send the buffered notifications. The time changes come first, because the models
+// have to be resorted before the dives are updated. The cylinders have to be reset
+// before the dives are updated, lest the plot data model gets out of sync.
+void DiveListNotifier::flush()
+{
+	// Take the buffers, as the listeners might send further notifications.
+	QVector<dive *> dives = changedDives.dives;
+	QVector<dive *> timeDives = timeChangedDives.dives;
+	QVector<dive *> cylDives = cylinderDives.dives;
+	QVector<dive *> wsDives = weightDives.dives;
+	QHash<dive *, timestamp_t> deltas = timeDeltas;
+	DiveField fields = changedFields;
+	clearBuffer();
+
+	// Dives that were shifted by the same amount are sent in one signal
+	while (!timeDives.isEmpty()) {
+		timestamp_t delta = deltas[timeDives[0]];
+		QVector<dive *> shifted, rest;
+		for (dive *d: timeDives)
+			(deltas[d] == delta ? shifted : rest).push_back(d);
+		if (delta != 0)
+			emit divesTimeChanged(delta, shifted);
+		std::swap(timeDives, rest);
+	}
+	if (!cylDives.isEmpty())
+		emit cylindersReset(cylDives);
+	if (!wsDives.isEmpty())
+		emit weightsystemsReset(wsDives);
+	if (!dives.isEmpty())
+		emit divesChanged(dives, fields);
+}
@@ -9,6 +9,9 @@
 #include "core/pictureobj.h"
 
 #include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QVector>
 
 // Dive and trip fields that can be edited. Use bit fields so that we can pass multiple fields at once.
 // Provides an inlined flag-based constructur because sadly C-style designated initializers are only supported since C++20.
@@ -77,6 +80,21 @@ struct TripField {
 
 class DiveListNotifier : public QObject {
 	Q_OBJECT
+public:
+	DiveListNotifier();
+
+	// Bulk operations may open a transaction (see DiveListTransaction below). Until the
+	// outermost transaction is closed, the notifications passed to the following functions
+	// are buffered and merged, so that the listeners are informed only once about every dive.
+	// Outside of a transaction the notifications are sent immediately.
+	// The buffer is flushed before a signal that changes the structure of the dive list
+	// (dives added, deleted or moved between trips) reaches the listeners.
+	void beginTransaction();
+	void endTransaction();
+	void changeDives(const QVector<dive *> &dives, DiveField field);
+	void changeDivesTime(timestamp_t delta, const QVector<dive *> &dives);
+	void resetCylinders(const QVector<dive *> &dives);
+	void resetWeightsystems(const QVector<dive *> &dives);
 signals:
 	// The core structures were completely reset. Repopulate all models.
 	void dataReset();
@@ -135,12 +153,47 @@ signals:
 	// This is necessary, so that the user can't click on the "undo" button and undo
 	// an unrelated command.
 	void commandExecuted();
+private:
+	// Dives in the order of their first notification, each dive only once
+	struct DiveBuffer {
+		QVector<dive *> dives;
+		QSet<dive *> set;
+		void add(const QVector<dive *> &newDives);
+		void clear();
+	};
+	void flush();
+	void clearBuffer();
+
+	int transactionDepth;
+	DiveBuffer changedDives;
+	DiveField changedFields;
+	DiveBuffer timeChangedDives;
+	QHash<dive *, timestamp_t> timeDeltas;
+	DiveBuffer cylinderDives;
+	DiveBuffer weightDives;
 };
 
 // The DiveListNotifier class has only trivial state.
 // We can simply define it as a global object.
 extern DiveListNotifier diveListNotifier;
 
+// Buffers the notifications of the DiveListNotifier for the lifetime of the object.
+class DiveListTransaction {
+public:
+	DiveListTransaction();
+	~DiveListTransaction();
+};
+
+inline DiveListTransaction::DiveListTransaction()
+{
+	diveListNotifier.beginTransaction();
+}
+
+inline DiveListTransaction::~DiveListTransaction()
+{
+	diveListNotifier.endTransaction();
+}
+
 inline DiveField::DiveField(int flags) :
 	nr((flags & NR) != 0),
 	datetime((flags & DATETIME) != 0),
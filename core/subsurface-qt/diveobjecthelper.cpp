@@ -261,45 +261,22 @@ QString formatDiveWaterType(const dive *d)
 }
 
 // Qt's metatype system insists on generating a default constructed object, even if that makes no sense.
-DiveObjectHelper::DiveObjectHelper()
-{
-}
-
-DiveObjectHelper::DiveObjectHelper(const struct dive *d) :
-	number(d->number),
-	id(d->id),
-	rating(d->rating),
-	visibility(d->visibility),
-	timestamp(d->when),
-	location(get_dive_location(d) ? QString::fromUtf8(get_dive_location(d)) : QString()),
-	gps(d->dive_site ? printGPSCoords(&d->dive_site->location) : QString()),
-	gps_decimal(format_gps_decimal(d)),
-	dive_site(QVariant::fromValue(d->dive_site)),
-	duration(get_dive_duration_string(d->duration.seconds, gettextFromC::tr("h"), gettextFromC::tr("min"))),
-	noDive(d->duration.seconds == 0 && d->dc.duration.seconds == 0),
-	depth(get_depth_string(d->dc.maxdepth.mm, true, true)),
-	divemaster(d->divemaster ? d->divemaster : QString()),
-	buddy(d->buddy ? d->buddy : QString()),
-	airTemp(get_temperature_string(d->airtemp, true)),
-	waterTemp(get_temperature_string(d->watertemp, true)),
-	notes(formatNotes(d)),
-	tags(get_taglist_string(d->tag_list)),
-	gas(formatGas(d)),
-	sac(formatSac(d)),
-	weightList(formatWeightList(d)),
-	weights(formatWeights(d)),
-	singleWeight(d->weightsystems.nr <= 1),
-	suit(d->suit ? d->suit : QString()),
-	cylinders(formatCylinders(d)),
-	maxcns(d->maxcns),
-	otu(d->otu),
-	sumWeight(get_weight_string(weight_t { total_weight(d) }, true)),
-	getCylinder(formatGetCylinder(d)),
-	startPressure(getStartPressure(d)),
-	endPressure(getEndPressure(d)),
-	firstGas(getFirstGas(d)),
-	salinity(formatDiveSalinity(d)),
-	waterType(formatDiveWaterType(d))
+DiveObjectHelper::DiveObjectHelper() : d(nullptr)
+{
+}
+
+DiveObjectHelper::DiveObjectHelper(const struct dive *dIn) :
+	number(dIn->number),
+	id(dIn->id),
+	rating(dIn->rating),
+	visibility(dIn->visibility),
+	timestamp(dIn->when),
+	dive_site(QVariant::fromValue(dIn->dive_site)),
+	noDive(dIn->duration.seconds == 0 && dIn->dc.duration.seconds == 0),
+	singleWeight(dIn->weightsystems.nr <= 1),
+	maxcns(dIn->maxcns),
+	otu(dIn->otu),
+	d(dIn)
 {
 #if defined(DEBUG_DOH)
 	void *array[4];
@@ -309,7 +286,7 @@ DiveObjectHelper::DiveObjectHelper(const struct dive *d) :
 	size = backtrace(array, 4);
 
 	// print out all the frames to stderr
-	fprintf(stderr, "\n\nCalling DiveObjectHelper constructor for dive %d - call #%d\n", d->number, ++callCounter);
+	fprintf(stderr, "\n\nCalling DiveObjectHelper constructor for dive %d - call #%d\n", dIn->number, ++callCounter);
 	backtrace_symbols_fd(array, size, STDERR_FILENO);
 #endif /* defined(DEBUG_DOH) */
 }
@@ -319,9 +296,13 @@ DiveObjectHelperGrantlee::DiveObjectHelperGrantlee()
 }
 
 DiveObjectHelperGrantlee::DiveObjectHelperGrantlee(const struct dive *d) :
-	DiveObjectHelper(d),
-	cylinderObjects(makeCylinderObjects(d))
+	DiveObjectHelper(d)
+{
+}
+
+QVector<CylinderObjectHelper> DiveObjectHelperGrantlee::cylinderObjects() const
 {
+	return m_cylinderObjects.get([this] { return makeCylinderObjects(d); });
 }
 
 QString DiveObjectHelper::date() const
@@ -340,3 +321,123 @@ QStringList DiveObjectHelper::cylinderList() const
 {
 	return getFullCylinderList();
 }
+
+QString DiveObjectHelper::location() const
+{
+	return m_location.get([this] { return get_dive_location(d) ? QString::fromUtf8(get_dive_location(d)) : QString(); });
+}
+
+QString DiveObjectHelper::gps() const
+{
+	return m_gps.get([this] { return d->dive_site ? printGPSCoords(&d->dive_site->location) : QString(); });
+}
+
+QString DiveObjectHelper::gps_decimal() const
+{
+	return m_gps_decimal.get([this] { return format_gps_decimal(d); });
+}
+
+QString DiveObjectHelper::duration() const
+{
+	return m_duration.get([this] { return get_dive_duration_string(d->duration.seconds, gettextFromC::tr("h"), gettextFromC::tr("min")); });
+}
+
+QString DiveObjectHelper::depth() const
+{
+	return m_depth.get([this] { return get_depth_string(d->dc.maxdepth.mm, true, true); });
+}
+
+QString DiveObjectHelper::divemaster() const
+{
+	return m_divemaster.get([this] { return d->divemaster ? d->divemaster : QString(); });
+}
+
+QString DiveObjectHelper::buddy() const
+{
+	return m_buddy.get([this] { return d->buddy ? d->buddy : QString(); });
+}
+
+QString DiveObjectHelper::airTemp() const
+{
+	return m_airTemp.get([this] { return get_temperature_string(d->airtemp, true); });
+}
+
+QString DiveObjectHelper::waterTemp() const
+{
+	return m_waterTemp.get([this] { return get_temperature_string(d->watertemp, true); });
+}
+
+QString DiveObjectHelper::notes() const
+{
+	return m_notes.get([this] { return formatNotes(d); });
+}
+
+QString DiveObjectHelper::tags() const
+{
+	return m_tags.get([this] { return get_taglist_string(d->tag_list); });
+}
+
+QString DiveObjectHelper::gas() const
+{
+	return m_gas.get([this] { return formatGas(d); });
+}
+
+QString DiveObjectHelper::sac() const
+{
+	return m_sac.get([this] { return formatSac(d); });
+}
+
+QString DiveObjectHelper::weightList() const
+{
+	return m_weightList.get([this] { return formatWeightList(d); });
+}
+
+QStringList DiveObjectHelper::weights() const
+{
+	return m_weights.get([this] { return formatWeights(d); });
+}
+
+QString DiveObjectHelper::suit() const
+{
+	return m_suit.get([this] { return d->suit ? d->suit : QString(); });
+}
+
+QStringList DiveObjectHelper::cylinders() const
+{
+	return m_cylinders.get([this] { return formatCylinders(d); });
+}
+
+QString DiveObjectHelper::sumWeight() const
+{
+	return m_sumWeight.get([this] { return get_weight_string(weight_t { total_weight(d) }, true); });
+}
+
+QStringList DiveObjectHelper::getCylinder() const
+{
+	return m_getCylinder.get([this] { return formatGetCylinder(d); });
+}
+
+QStringList DiveObjectHelper::startPressure() const
+{
+	return m_startPressure.get([this] { return getStartPressure(d); });
+}
+
+QStringList DiveObjectHelper::endPressure() const
+{
+	return m_endPressure.get([this] { return getEndPressure(d); });
+}
+
+QStringList DiveObjectHelper::firstGas() const
+{
+	return m_firstGas.get([this] { return getFirstGas(d); });
+}
+
+QString DiveObjectHelper::salinity() const
+{
+	return m_salinity.get([this] { return formatDiveSalinity(d); });
+}
+
+QString DiveObjectHelper::waterType() const
+{
+	return m_waterType.get([this] { return formatDiveWaterType(d); });
+}
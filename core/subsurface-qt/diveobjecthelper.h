@@ -9,6 +9,26 @@
 #include <QVector>
 #include <QVariant>
 
+// A value that is calculated on first access and then cached
+template <typename T>
+class LazyValue {
+	mutable bool valid = false;
+	mutable T value;
+public:
+	template <typename F>
+	const T &get(F calculate) const
+	{
+		if (!valid) {
+			value = calculate();
+			valid = true;
+		}
+		return value;
+	}
+};
+
+// The string properties are formatted on first access, so that building a helper
+// for every page of the dive details doesn't format dozens of unused strings.
+// Therefore, the dive must not be changed or freed as long as the helper is used.
 class DiveObjectHelper {
 	Q_GADGET
 	Q_PROPERTY(int number MEMBER number CONSTANT)
@@ -18,34 +38,34 @@ class DiveObjectHelper {
 	Q_PROPERTY(QString date READ date CONSTANT)
 	Q_PROPERTY(QString time READ time CONSTANT)
 	Q_PROPERTY(int timestamp MEMBER timestamp CONSTANT)
-	Q_PROPERTY(QString location MEMBER location CONSTANT)
-	Q_PROPERTY(QString gps MEMBER gps CONSTANT)
-	Q_PROPERTY(QString gps_decimal MEMBER gps_decimal CONSTANT)
+	Q_PROPERTY(QString location READ location CONSTANT)
+	Q_PROPERTY(QString gps READ gps CONSTANT)
+	Q_PROPERTY(QString gps_decimal READ gps_decimal CONSTANT)
 	Q_PROPERTY(QVariant dive_site MEMBER dive_site CONSTANT)
-	Q_PROPERTY(QString duration MEMBER duration CONSTANT)
+	Q_PROPERTY(QString duration READ duration CONSTANT)
 	Q_PROPERTY(bool noDive MEMBER noDive CONSTANT)
-	Q_PROPERTY(QString depth MEMBER depth CONSTANT)
-	Q_PROPERTY(QString divemaster MEMBER divemaster CONSTANT)
-	Q_PROPERTY(QString buddy MEMBER buddy CONSTANT)
-	Q_PROPERTY(QString airTemp MEMBER airTemp CONSTANT)
-	Q_PROPERTY(QString waterTemp MEMBER waterTemp CONSTANT)
-	Q_PROPERTY(QString notes MEMBER notes CONSTANT)
-	Q_PROPERTY(QString tags MEMBER tags CONSTANT)
-	Q_PROPERTY(QString gas MEMBER gas CONSTANT)
-	Q_PROPERTY(QString sac MEMBER sac CONSTANT)
-	Q_PROPERTY(QString weightList MEMBER weightList CONSTANT)
-	Q_PROPERTY(QStringList weights MEMBER weights CONSTANT)
+	Q_PROPERTY(QString depth READ depth CONSTANT)
+	Q_PROPERTY(QString divemaster READ divemaster CONSTANT)
+	Q_PROPERTY(QString buddy READ buddy CONSTANT)
+	Q_PROPERTY(QString airTemp READ airTemp CONSTANT)
+	Q_PROPERTY(QString waterTemp READ waterTemp CONSTANT)
+	Q_PROPERTY(QString notes READ notes CONSTANT)
+	Q_PROPERTY(QString tags READ tags CONSTANT)
+	Q_PROPERTY(QString gas READ gas CONSTANT)
+	Q_PROPERTY(QString sac READ sac CONSTANT)
+	Q_PROPERTY(QString weightList READ weightList CONSTANT)
+	Q_PROPERTY(QStringList weights READ weights CONSTANT)
 	Q_PROPERTY(bool singleWeight MEMBER singleWeight CONSTANT)
-	Q_PROPERTY(QString suit MEMBER suit CONSTANT)
+	Q_PROPERTY(QString suit READ suit CONSTANT)
 	Q_PROPERTY(QStringList cylinderList READ cylinderList CONSTANT)
-	Q_PROPERTY(QStringList cylinders MEMBER cylinders CONSTANT)
+	Q_PROPERTY(QStringList cylinders READ cylinders CONSTANT)
 	Q_PROPERTY(int maxcns MEMBER maxcns CONSTANT)
 	Q_PROPERTY(int otu MEMBER otu CONSTANT)
-	Q_PROPERTY(QString sumWeight MEMBER sumWeight CONSTANT)
-	Q_PROPERTY(QStringList getCylinder MEMBER getCylinder CONSTANT)
-	Q_PROPERTY(QStringList startPressure MEMBER startPressure CONSTANT)
-	Q_PROPERTY(QStringList endPressure MEMBER endPressure CONSTANT)
-	Q_PROPERTY(QStringList firstGas MEMBER firstGas CONSTANT)
+	Q_PROPERTY(QString sumWeight READ sumWeight CONSTANT)
+	Q_PROPERTY(QStringList getCylinder READ getCylinder CONSTANT)
+	Q_PROPERTY(QStringList startPressure READ startPressure CONSTANT)
+	Q_PROPERTY(QStringList endPressure READ endPressure CONSTANT)
+	Q_PROPERTY(QStringList firstGas READ firstGas CONSTANT)
 public:
 	DiveObjectHelper(); // This is only to be used by Qt's metatype system!
 	DiveObjectHelper(const struct dive *dive);
@@ -56,36 +76,63 @@ public:
 	QString date() const;
 	timestamp_t timestamp;
 	QString time() const;
-	QString location;
-	QString gps;
-	QString gps_decimal;
+	QString location() const;
+	QString gps() const;
+	QString gps_decimal() const;
 	QVariant dive_site;
-	QString duration;
+	QString duration() const;
 	bool noDive;
-	QString depth;
-	QString divemaster;
-	QString buddy;
-	QString airTemp;
-	QString waterTemp;
-	QString notes;
-	QString tags;
-	QString gas;
-	QString sac;
-	QString weightList;
-	QStringList weights;
+	QString depth() const;
+	QString divemaster() const;
+	QString buddy() const;
+	QString airTemp() const;
+	QString waterTemp() const;
+	QString notes() const;
+	QString tags() const;
+	QString gas() const;
+	QString sac() const;
+	QString weightList() const;
+	QStringList weights() const;
 	bool singleWeight;
-	QString suit;
+	QString suit() const;
 	QStringList cylinderList() const;
-	QStringList cylinders;
+	QStringList cylinders() const;
 	int maxcns;
 	int otu;
-	QString sumWeight;
-	QStringList getCylinder;
-	QStringList startPressure;
-	QStringList endPressure;
-	QStringList firstGas;
-	QString salinity;
-	QString waterType;
+	QString sumWeight() const;
+	QStringList getCylinder() const;
+	QStringList startPressure() const;
+	QStringList endPressure() const;
+	QStringList firstGas() const;
+	QString salinity() const;
+	QString waterType() const;
+protected:
+	const struct dive *d;
+private:
+	LazyValue<QString> m_location;
+	LazyValue<QString> m_gps;
+	LazyValue<QString> m_gps_decimal;
+	LazyValue<QString> m_duration;
+	LazyValue<QString> m_depth;
+	LazyValue<QString> m_divemaster;
+	LazyValue<QString> m_buddy;
+	LazyValue<QString> m_airTemp;
+	LazyValue<QString> m_waterTemp;
+	LazyValue<QString> m_notes;
+	LazyValue<QString> m_tags;
+	LazyValue<QString> m_gas;
+	LazyValue<QString> m_sac;
+	LazyValue<QString> m_weightList;
+	LazyValue<QStringList> m_weights;
+	LazyValue<QString> m_suit;
+	LazyValue<QStringList> m_cylinders;
+	LazyValue<QString> m_sumWeight;
+	LazyValue<QStringList> m_getCylinder;
+	LazyValue<QStringList> m_startPressure;
+	LazyValue<QStringList> m_endPressure;
+	LazyValue<QStringList> m_firstGas;
+	LazyValue<QString> m_salinity;
+	LazyValue<QString> m_waterType;
 };
 
 // This is an extended version of DiveObjectHelper that also keeps track of cylinder data.
@@ -94,11 +141,13 @@ public:
 // want to remove this class.
 class DiveObjectHelperGrantlee : public DiveObjectHelper {
 	Q_GADGET
-	Q_PROPERTY(QVector<CylinderObjectHelper> cylinderObjects MEMBER cylinderObjects CONSTANT)
+	Q_PROPERTY(QVector<CylinderObjectHelper> cylinderObjects READ cylinderObjects CONSTANT)
 public:
 	DiveObjectHelperGrantlee();
 	DiveObjectHelperGrantlee(const struct dive *dive);
-	QVector<CylinderObjectHelper> cylinderObjects;
+	QVector<CylinderObjectHelper> cylinderObjects() const;
+private:
+	LazyValue<QVector<CylinderObjectHelper>> m_cylinderObjects;
 };
 
 Q_DECLARE_METATYPE(DiveObjectHelper)
@@ -9,6 +9,7 @@
 #include "gettext.h"
 #include "qthelper.h"
 #include "git-access.h"
+#include "trace.h"
 #include "libdivecomputer/version.h"
 
 struct preferences prefs, git_prefs;
@@ -104,6 +105,9 @@ struct preferences default_prefs = {
 };
 
 int ignore_bt;
+bool opengl_profile;
+char *trace_filename = NULL;
+bool memory_usage_report = false;
 #ifdef SUBSURFACE_MOBILE_DESKTOP
 char *testqml = NULL;
 #endif
@@ -181,12 +185,20 @@ static void print_help()
 	printf("\n --help|-h             This help text");
 	printf("\n --ignore-bt           Don't enable Bluetooth support");
 	printf("\n --import logfile ...  Logs before this option is treated as base, everything after is imported");
+#ifndef SUBSURFACE_MOBILE
+	printf("\n --opengl              Draw the dive profile with OpenGL");
+#endif
 	printf("\n --verbose|-v          Verbose debug (repeat to increase verbosity)");
 	printf("\n --version             Prints current version");
 	printf("\n --user=<test>         Choose configuration space for user <test>");
 #ifdef SUBSURFACE_MOBILE_DESKTOP
 	printf("\n --testqml=<dir>       Use QML files from <dir> instead of QML resources");
 #endif
+#ifndef NO_TRACING
+	printf("\n --trace=<file>        Write the timing of the hot paths to <file> in the Chrome trace format");
+#endif
+	printf("\n --memory-usage        Print the memory used by the dive data, caches and undo stack on exit");
+	printf("\n --git-samples=<fmt>   Save the samples to git repositories as text, binary or binary+text");
 	printf("\n --cloud-timeout=<nr>  Set timeout for cloud connection (0 < timeout < 60)\n\n");
 }
 
@@ -220,14 +232,46 @@ void parse_argument(const char *arg)
 					default_prefs.cloud_timeout = to;
 				return;
 			}
+#ifndef NO_TRACING
+			if (strncmp(arg, "--trace=", sizeof("--trace=") - 1) == 0) {
+				trace_filename = strdup(arg + sizeof("--trace=") - 1);
+				trace_enable();
+				return;
+			}
+#endif
 			if (strcmp(arg, "--help") == 0) {
 				print_help();
 				exit(0);
 			}
+			if (strcmp(arg, "--memory-usage") == 0) {
+				memory_usage_report = true;
+				return;
+			}
+			if (strncmp(arg, "--git-samples=", sizeof("--git-samples=") - 1) == 0) {
+				const char *format = arg + sizeof("--git-samples=") - 1;
+				if (strcmp(format, "text") == 0) {
+					git_sample_format = GIT_SAMPLES_TEXT;
+				} else if (strcmp(format, "binary") == 0) {
+					git_sample_format = GIT_SAMPLES_BINARY;
+				} else if (strcmp(format, "binary+text") == 0) {
+					git_sample_format = GIT_SAMPLES_BINARY_AND_TEXT;
+				} else {
+					fprintf(stderr, "Bad sample format '%s'\n", format);
+					exit(1);
+				}
+				git_sample_format_forced = true;
+				return;
+			}
 			if (strcmp(arg, "--ignore-bt") == 0) {
 				ignore_bt = true;
 				return;
 			}
+#ifndef SUBSURFACE_MOBILE
+			if (strcmp(arg, "--opengl") == 0) {
+				opengl_profile = true;
+				return;
+			}
+#endif
 			if (strcmp(arg, "--import") == 0) {
 				imported = true; /* mark the dives so far as the base, * everything after is imported */
 				return;
@@ -9,6 +9,7 @@ extern "C" {
 #endif
 
 extern bool imported;
+extern bool opengl_profile;
 
 void setup_system_prefs(void);
 void parse_argument(const char *arg);
@@ -17,6 +18,8 @@ void print_files(void);
 void print_version(void);
 
 extern char *settings_suffix;
+extern char *trace_filename;
+extern bool memory_usage_report;
 
 #ifdef __cplusplus
 }
@@ -23,39 +23,67 @@
 	}
 
 /* get the index where we want to insert an object so that everything stays
- * ordered according to a comparison function() */
+ * ordered according to a comparison function(). The table must already be
+ * ordered. Objects are inserted after all objects that compare equal. */
 #define MAKE_GET_INSERTION_INDEX(table_type, item_type, array_name, fun)		\
 	int table_type##_get_insertion_index(struct table_type *table, item_type item)	\
 	{										\
-		/* we might want to use binary search here */				\
-		for (int i = 0; i < table->nr; i++) {					\
-			if (fun(item, table->array_name[i]))				\
-				return i;						\
+		int lo = 0, hi = table->nr;						\
+		while (lo < hi) {							\
+			int mid = lo + (hi - lo) / 2;					\
+			if (fun(item, table->array_name[mid]))				\
+				hi = mid;						\
+			else								\
+				lo = mid + 1;						\
 		}									\
-		return table->nr;							\
+		return lo;								\
 	}
 
 /* add object at the given index to a table. */
 #define MAKE_ADD_TO(table_type, item_type, array_name)					\
 	void add_to_##table_type(struct table_type *table, int idx, item_type item)	\
 	{										\
-		int i;									\
 		grow_##table_type(table);						\
+		memmove(&table->array_name[idx + 1], &table->array_name[idx],		\
+			(table->nr - idx) * sizeof(item_type));				\
+		table->array_name[idx] = item;						\
 		table->nr++;								\
+	}
+
+/* merge an ordered array of objects into an ordered table in a single pass.
+ * Like inserting the objects one by one, objects are placed after all
+ * objects of the table that compare equal. */
+#define MAKE_MERGE_INTO(table_type, item_type, array_name, fun)				\
+	void merge_into_##table_type(struct table_type *table, item_type *items, int nr)	\
+	{										\
+		int i = table->nr - 1, j = nr - 1, k = table->nr + nr - 1;		\
 											\
-		for (i = idx; i < table->nr; i++) {					\
-			item_type tmp = table->array_name[i];				\
-			table->array_name[i] = item;					\
-			item = tmp;							\
+		if (nr <= 0)								\
+			return;								\
+		if (table->nr + nr > table->allocated) {				\
+			int allocated = (table->nr + nr + 32) * 3 / 2;			\
+			item_type *new_items = realloc(table->array_name,		\
+						       allocated * sizeof(item_type));	\
+			if (!new_items)							\
+				exit(1);						\
+			table->array_name = new_items;					\
+			table->allocated = allocated;					\
+		}									\
+		/* Fill from the end so that no object is overwritten */		\
+		while (j >= 0) {							\
+			if (i >= 0 && fun(items[j], table->array_name[i]))		\
+				table->array_name[k--] = table->array_name[i--];	\
+			else								\
+				table->array_name[k--] = items[j--];			\
 		}									\
+		table->nr += nr;							\
 	}
 
 #define MAKE_REMOVE_FROM(table_type, array_name)						\
 	void remove_from_##table_type(struct table_type *table, int idx)			\
 	{											\
-		int i;										\
-		for (i = idx; i < table->nr - 1; i++)						\
-			table->array_name[i] = table->array_name[i + 1];			\
+		memmove(&table->array_name[idx], &table->array_name[idx + 1],			\
+			(table->nr - idx - 1) * sizeof(table->array_name[0]));			\
 		memset(&table->array_name[--table->nr], 0, sizeof(table->array_name[0]));	\
 	}
 
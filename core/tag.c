@@ -6,10 +6,23 @@
 #include "membuffer.h"
 #include "gettext.h"
 
+#include <stdint.h>
 #include <stdlib.h>
 
 struct tag_entry *g_tag_list = NULL;
 
+/*
+ * Index of the tags in g_tag_list by name. During loading every tag of
+ * every dive is looked up, which is much faster than walking the list.
+ * Open addressing with linear probing, the size is a power of two and
+ * the table at most half full.
+ */
+static struct {
+	unsigned int size, nr;
+	struct divetag **tags;
+} global_tag_hash;
+static int global_tag_ids;
+
 static const char *default_tags[] = {
 	QT_TRANSLATE_NOOP("gettextFromC", "boat"), QT_TRANSLATE_NOOP("gettextFromC", "shore"), QT_TRANSLATE_NOOP("gettextFromC", "drift"),
 	QT_TRANSLATE_NOOP("gettextFromC", "deep"), QT_TRANSLATE_NOOP("gettextFromC", "cavern"), QT_TRANSLATE_NOOP("gettextFromC", "ice"),
@@ -26,6 +39,79 @@ static void copy_tl(struct tag_entry *st, struct tag_entry *dt)
 	dt->tag = malloc(sizeof(struct divetag));
 	dt->tag->name = copy_string(st->tag->name);
 	dt->tag->source = copy_string(st->tag->source);
+	dt->tag->id = st->tag->id;
+}
+
+static uint32_t tag_hash_value(const char *name)
+{
+	uint32_t hash = 2166136261u;
+
+	while (*name)
+		hash = (hash ^ (unsigned char)*name++) * 16777619u;
+	return hash;
+}
+
+static struct divetag **tag_hash_slot(struct divetag **tags, unsigned int size, const char *name)
+{
+	unsigned int idx = tag_hash_value(name) & (size - 1);
+
+	while (tags[idx] && strcmp(tags[idx]->name, name))
+		idx = (idx + 1) & (size - 1);
+	return &tags[idx];
+}
+
+static void add_to_tag_hash(struct divetag *tag)
+{
+	struct divetag **slot;
+
+	if ((global_tag_hash.nr + 1) * 2 > global_tag_hash.size) {
+		unsigned int i, new_size = global_tag_hash.size ? global_tag_hash.size * 2 : 64;
+		struct divetag **new_tags = calloc(new_size, sizeof(struct divetag *));
+
+		if (!new_tags)
+			exit(1);
+		for (i = 0; i < global_tag_hash.size; i++) {
+			if (global_tag_hash.tags[i])
+				*tag_hash_slot(new_tags, new_size, global_tag_hash.tags[i]->name) = global_tag_hash.tags[i];
+		}
+		free(global_tag_hash.tags);
+		global_tag_hash.tags = new_tags;
+		global_tag_hash.size = new_size;
+	}
+	slot = tag_hash_slot(global_tag_hash.tags, global_tag_hash.size, tag->name);
+	if (!*slot) {
+		*slot = tag;
+		global_tag_hash.nr++;
+	}
+}
+
+static void clear_tag_hash()
+{
+	free(global_tag_hash.tags);
+	global_tag_hash.tags = NULL;
+	global_tag_hash.size = global_tag_hash.nr = 0;
+}
+
+/* After g_tag_list was changed other than by adding tags */
+static void rebuild_tag_hash()
+{
+	struct tag_entry *entry;
+
+	clear_tag_hash();
+	for (entry = g_tag_list; entry; entry = entry->next)
+		add_to_tag_hash(entry->tag);
+}
+
+struct divetag *taglist_get_global_tag(const char *name)
+{
+	if (!global_tag_hash.size || !name)
+		return NULL;
+	return *tag_hash_slot(global_tag_hash.tags, global_tag_hash.size, name);
+}
+
+int taglist_nr_global_ids(void)
+{
+	return global_tag_ids;
 }
 
 static bool tag_seen_before(struct tag_entry *start, struct tag_entry *before)
@@ -50,6 +136,8 @@ void taglist_cleanup(struct tag_entry **tag_list)
 		}
 		tl = &(*tl)->next;
 	}
+	if (tag_list == &g_tag_list)
+		rebuild_tag_hash();
 }
 
 char *taglist_get_tagstring(struct tag_entry *tag_list)
@@ -110,11 +198,11 @@ static struct divetag *taglist_add_divetag(struct tag_entry **tag_list, struct d
 	return tag;
 }
 
-struct divetag *taglist_add_tag(struct tag_entry **tag_list, const char *tag)
+static struct divetag *create_divetag(const char *tag)
 {
 	size_t i = 0;
 	int is_default_tag = 0;
-	struct divetag *ret_tag, *new_tag;
+	struct divetag *new_tag;
 	const char *translation;
 	new_tag = malloc(sizeof(struct divetag));
 
@@ -136,18 +224,39 @@ struct divetag *taglist_add_tag(struct tag_entry **tag_list, const char *tag)
 		new_tag->name = malloc(strlen(tag) + 1);
 		memcpy(new_tag->name, tag, strlen(tag) + 1);
 	}
-	/* Try to insert new_tag into g_tag_list if we are not operating on it */
-	if (tag_list != &g_tag_list) {
-		ret_tag = taglist_add_divetag(&g_tag_list, new_tag);
-		/* g_tag_list already contains new_tag, free the duplicate */
-		if (ret_tag != new_tag)
-			taglist_free_divetag(new_tag);
-		ret_tag = taglist_add_divetag(tag_list, ret_tag);
-	} else {
-		ret_tag = taglist_add_divetag(tag_list, new_tag);
-		if (ret_tag != new_tag)
-			taglist_free_divetag(new_tag);
+	new_tag->id = -1;
+	return new_tag;
+}
+
+/* Find the tag in g_tag_list or add it there */
+static struct divetag *get_or_add_global_tag(const char *tag)
+{
+	struct divetag *ret_tag, *new_tag = create_divetag(tag);
+
+	/* The translated name is what ends up in the list */
+	ret_tag = taglist_get_global_tag(new_tag->name);
+	if (ret_tag) {
+		taglist_free_divetag(new_tag);
+		return ret_tag;
 	}
+	ret_tag = taglist_add_divetag(&g_tag_list, new_tag);
+	if (ret_tag != new_tag) {
+		/* Not in the hash, which means that g_tag_list was changed behind our back */
+		taglist_free_divetag(new_tag);
+		rebuild_tag_hash();
+		return ret_tag;
+	}
+	new_tag->id = global_tag_ids++;
+	add_to_tag_hash(new_tag);
+	return new_tag;
+}
+
+struct divetag *taglist_add_tag(struct tag_entry **tag_list, const char *tag)
+{
+	struct divetag *ret_tag = get_or_add_global_tag(tag);
+
+	if (tag_list != &g_tag_list)
+		ret_tag = taglist_add_divetag(tag_list, ret_tag);
 	return ret_tag;
 }
 
@@ -182,11 +291,27 @@ void taglist_init_global()
 		taglist_add_tag(&g_tag_list, default_tags[i]);
 }
 
+void taglist_free_global()
+{
+	taglist_free(g_tag_list);
+	g_tag_list = NULL;
+	clear_tag_hash();
+	global_tag_ids = 0;
+}
+
 bool taglist_contains(struct tag_entry *tag_list, const char *tag)
 {
+	const struct divetag *global = taglist_get_global_tag(tag);
+	int id = global ? global->id : -1;
+
 	while (tag_list) {
-		if (same_string(tag_list->tag->name, tag))
+		/* Tags with the same id have the same name */
+		if (id >= 0 && tag_list->tag->id >= 0) {
+			if (tag_list->tag->id == id)
+				return true;
+		} else if (same_string(tag_list->tag->name, tag)) {
 			return true;
+		}
 		tag_list = tag_list->next;
 	}
 	return false;
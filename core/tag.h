@@ -20,6 +20,12 @@ struct divetag {
 	 * This enables us to write a non-localized tag to the xml file.
 	 */
 	char *source;
+	/*
+	 * Index of the tag in the global tag list in order of addition, or -1
+	 * for tags that are not in it. Copies of a tag keep its id, so for
+	 * membership tests the id can be used instead of the name.
+	 */
+	int id;
 };
 
 struct tag_entry {
@@ -35,6 +41,10 @@ struct tag_entry {
 extern struct tag_entry *g_tag_list;
 
 struct divetag *taglist_add_tag(struct tag_entry **tag_list, const char *tag);
+/* Hashed lookup in g_tag_list, returns NULL if there is no such tag */
+struct divetag *taglist_get_global_tag(const char *name);
+/* Number of ids handed out to global tags, ids are 0 to this minus one */
+int taglist_nr_global_ids(void);
 struct tag_entry *taglist_added(struct tag_entry *original_list, struct tag_entry *new_list);
 
 /*
@@ -50,6 +60,8 @@ char *taglist_get_tagstring(struct tag_entry *tag_list);
 void taglist_cleanup(struct tag_entry **tag_list);
 
 void taglist_init_global();
+/* frees g_tag_list and forgets all tag ids */
+void taglist_free_global();
 void taglist_free(struct tag_entry *tag_list);
 struct tag_entry *taglist_copy(struct tag_entry *s);
 bool taglist_contains(struct tag_entry *tag_list, const char *tag);
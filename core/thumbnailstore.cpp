@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "thumbnailstore.h"
+#include "qthelper.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+
+static const char packMagic[8] = { 'S', 'S', 'R', 'F', 'T', 'H', 'M', '1' };
+static const int keySize = 20;				// SHA1
+static const int headerSize = keySize + 8 + 4;		// Key, time and size
+// Rewrite the pack if the superseded records take more space than that and than the live records
+static const qint64 compactThreshold = 4 * 1024 * 1024;
+
+static QByteArray thumbnailKey(const QString &filename)
+{
+	return QCryptographicHash::hash(filename.toUtf8(), QCryptographicHash::Sha1);
+}
+
+ThumbnailStore &ThumbnailStore::instance()
+{
+	static ThumbnailStore self;
+	return self;
+}
+
+ThumbnailStore::ThumbnailStore() : opened(false),
+	mapped(nullptr),
+	mappedSize(0),
+	validSize(0),
+	liveSize(0)
+{
+}
+
+// Needs lock
+void ThumbnailStore::open()
+{
+	opened = true;
+	QString filename = thumbnailPackFileName();
+	QDir().mkpath(QFileInfo(filename).absolutePath());
+	file.setFileName(filename);
+	if (!file.open(QIODevice::ReadWrite))
+		return;
+	scan();
+	if (validSize - (qint64)sizeof(packMagic) - liveSize > qMax(liveSize, compactThreshold))
+		compact();
+}
+
+// Build the index from the record headers. Needs lock.
+void ThumbnailStore::scan()
+{
+	index.clear();
+	validSize = liveSize = 0;
+	if (mapped)
+		file.unmap((uchar *)mapped);
+	qint64 size = file.size();
+	mapped = size > 0 ? file.map(0, size) : nullptr;
+	mappedSize = mapped ? size : 0;
+	if (size > 0 && !mapped)
+		return;		// Leave the pack alone, but don't use it
+	if (size < (qint64)sizeof(packMagic) || memcmp(mapped, packMagic, sizeof(packMagic))) {
+		// No or unusable pack: start a new one
+		if (mapped)
+			file.unmap((uchar *)mapped);
+		mapped = nullptr;
+		mappedSize = 0;
+		if (!file.resize(0) || !file.seek(0) || file.write(packMagic, sizeof(packMagic)) != sizeof(packMagic))
+			return;
+		file.flush();
+		validSize = sizeof(packMagic);
+		return;
+	}
+	qint64 pos = sizeof(packMagic);
+	while (size - pos >= headerSize) {
+		const uchar *header = mapped + pos;
+		Entry entry;
+		entry.time = qFromLittleEndian<qint64>(header + keySize);
+		entry.size = qFromLittleEndian<quint32>(header + keySize + 8);
+		entry.offset = pos + headerSize;
+		if (entry.size > size - entry.offset)
+			break;
+		QByteArray key((const char *)header, keySize);
+		auto it = index.find(key);
+		if (it != index.end())
+			liveSize -= headerSize + it->size;
+		index[key] = entry;
+		liveSize += headerSize + entry.size;
+		pos = entry.offset + entry.size;
+	}
+	validSize = pos;
+}
+
+// Write the live records into a new pack. Needs lock.
+void ThumbnailStore::compact()
+{
+	QSaveFile newPack(file.fileName());
+	if (!newPack.open(QIODevice::WriteOnly) || !mapped)
+		return;
+	newPack.write(packMagic, sizeof(packMagic));
+	for (auto it = index.cbegin(); it != index.cend(); ++it) {
+		newPack.write((const char *)mapped + it->offset - headerSize, headerSize);
+		newPack.write((const char *)mapped + it->offset, it->size);
+	}
+	// On some platforms, a mapped file can't be replaced
+	file.unmap((uchar *)mapped);
+	mapped = nullptr;
+	mappedSize = 0;
+	file.close();
+	newPack.commit();
+	if (file.open(QIODevice::ReadWrite))
+		scan();
+	else
+		index.clear();
+}
+
+// Needs lock
+bool ThumbnailStore::append(const QByteArray &key, qint64 time, const QByteArray &data)
+{
+	if (!file.isOpen() || validSize == 0)
+		return false;
+	QByteArray record = key;
+	uchar header[8 + 4];
+	qToLittleEndian<qint64>(time, header);
+	qToLittleEndian<quint32>(data.size(), header + 8);
+	record.append((const char *)header, sizeof(header));
+	record.append(data);
+
+	// Cut off an incomplete record of an interrupted write
+	if (file.size() != validSize && !file.resize(validSize))
+		return false;
+	if (!file.seek(validSize) || file.write(record) != record.size() || !file.flush()) {
+		file.resize(validSize);
+		return false;
+	}
+	auto it = index.find(key);
+	if (it != index.end())
+		liveSize -= headerSize + it->size;
+	index[key] = { validSize + headerSize, (quint32)data.size(), time };
+	liveSize += record.size();
+	validSize += record.size();
+	return true;
+}
+
+// Move a thumbnail of an older version into the pack. Needs lock.
+bool ThumbnailStore::readLegacyFile(const QString &filename, const QByteArray &key, QByteArray &data, QDateTime &time)
+{
+	QFile legacy(thumbnailFileName(filename));
+	if (!legacy.open(QIODevice::ReadOnly))
+		return false;
+	data = legacy.readAll();
+	time = QFileInfo(legacy).lastModified();
+	legacy.close();
+	if (append(key, time.toMSecsSinceEpoch(), data))
+		legacy.remove();
+	return true;
+}
+
+bool ThumbnailStore::read(const QString &filename, QByteArray &data, QDateTime &time)
+{
+	if (filename.isEmpty())
+		return false;
+	QByteArray key = thumbnailKey(filename);
+	QMutexLocker l(&lock);
+	if (!opened)
+		open();
+	auto it = index.find(key);
+	if (it == index.end())
+		return readLegacyFile(filename, key, data, time);
+
+	qint64 end = it->offset + it->size;
+	if (end > mappedSize) {
+		// Appended after the pack was mapped
+		if (mapped)
+			file.unmap((uchar *)mapped);
+		mapped = file.map(0, validSize);
+		mappedSize = mapped ? validSize : 0;
+	}
+	if (mapped) {
+		data = QByteArray((const char *)mapped + it->offset, it->size);
+	} else {
+		if (!file.seek(it->offset))
+			return false;
+		data = file.read(it->size);
+		if (data.size() != (int)it->size)
+			return false;
+	}
+	time = QDateTime::fromMSecsSinceEpoch(it->time);
+	return true;
+}
+
+bool ThumbnailStore::write(const QString &filename, const QByteArray &data)
+{
+	if (filename.isEmpty())
+		return false;
+	QByteArray key = thumbnailKey(filename);
+	QMutexLocker l(&lock);
+	if (!opened)
+		open();
+	return append(key, QDateTime::currentMSecsSinceEpoch(), data);
+}
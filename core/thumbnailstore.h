@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-2.0
+// All thumbnails are stored in one append-only pack file in the thumbnail
+// directory, instead of one file per picture. The pack consists of a magic
+// followed by records: the SHA1 of the picture filename, the time the
+// thumbnail was stored (little-endian 64-bit msecs since the epoch), the
+// little-endian 32-bit size of the serialized thumbnail and the thumbnail
+// itself. A later record of the same picture supersedes the earlier ones.
+//
+// On first access, the pack is memory mapped and the index of the records
+// is built from the record headers. Reads are served from the mapping.
+// A record is only added to the index once it was completely written; an
+// incomplete record of an interrupted write is cut off before the next
+// append. When the pack consists mostly of superseded records, it is
+// rewritten on the next start.
+//
+// Thumbnails in the individual files of older versions are moved into the
+// pack when they are first read.
+//
+// The store may be accessed from any thread.
+#ifndef THUMBNAILSTORE_H
+#define THUMBNAILSTORE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+
+class ThumbnailStore {
+public:
+	static ThumbnailStore &instance();
+	// Get the serialized thumbnail of a picture and when it was stored
+	bool read(const QString &filename, QByteArray &data, QDateTime &time);
+	bool write(const QString &filename, const QByteArray &data);
+private:
+	ThumbnailStore();
+	struct Entry {
+		qint64 offset;		// Of the thumbnail data
+		quint32 size;
+		qint64 time;
+	};
+	void open();
+	void scan();
+	void compact();
+	bool append(const QByteArray &key, qint64 time, const QByteArray &data);
+	bool readLegacyFile(const QString &filename, const QByteArray &key, QByteArray &data, QDateTime &time);
+
+	QMutex lock;
+	bool opened;
+	QFile file;
+	const uchar *mapped;
+	qint64 mappedSize;
+	qint64 validSize;	// Size of the pack without an incomplete last record
+	qint64 liveSize;	// Size of the records that are not superseded
+	QHash<QByteArray, Entry> index;
+};
+
+#endif
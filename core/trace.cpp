@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "trace.h"
+#include "membuffer.h"
+#include "errorhelper.h"
+#include "file.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+// Spans beyond that are dropped, so that a long session can't eat up the memory
+#define MAX_TRACE_EVENTS 100000
+
+bool tracing_enabled = false;
+
+namespace {
+	using clock = std::chrono::steady_clock;
+
+	struct Begin {
+		const char *name;
+		clock::time_point start;
+	};
+
+	struct Event {
+		const char *name;
+		int64_t start_us, duration_us;
+		int tid;
+	};
+
+	clock::time_point trace_start;
+	std::mutex events_mutex;
+	std::vector<Event> events;
+	std::atomic<int> nr_threads(0);
+
+	thread_local std::vector<Begin> open_spans;
+	thread_local int thread_id = 0;
+}
+
+extern "C" void trace_enable()
+{
+	if (tracing_enabled)
+		return;
+	trace_start = clock::now();
+	tracing_enabled = true;
+}
+
+extern "C" void trace_begin(const char *name)
+{
+	open_spans.push_back({ name, clock::now() });
+}
+
+extern "C" void trace_end()
+{
+	if (open_spans.empty())
+		return;
+	clock::time_point end = clock::now();
+	Begin b = open_spans.back();
+	open_spans.pop_back();
+	if (!thread_id)
+		thread_id = ++nr_threads;
+	Event ev = { b.name,
+		     std::chrono::duration_cast<std::chrono::microseconds>(b.start - trace_start).count(),
+		     std::chrono::duration_cast<std::chrono::microseconds>(end - b.start).count(),
+		     thread_id };
+	std::lock_guard<std::mutex> lock(events_mutex);
+	if (events.size() < MAX_TRACE_EVENTS)
+		events.push_back(ev);
+}
+
+extern "C" void put_trace(struct membuffer *b)
+{
+	std::lock_guard<std::mutex> lock(events_mutex);
+	put_string(b, "{\"traceEvents\":[");
+	for (size_t i = 0; i < events.size(); ++i) {
+		const Event &ev = events[i];
+		put_format(b, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld}",
+			   i ? "," : "", ev.name, ev.tid, (long long)ev.start_us, (long long)ev.duration_us);
+	}
+	put_string(b, "\n],\"displayTimeUnit\":\"ms\"}\n");
+}
+
+extern "C" int save_trace(const char *filename)
+{
+	struct membuffer b = {};
+	FILE *f = subsurface_fopen(filename, "w");
+	if (!f)
+		return report_error("Unable to write trace file %s (%s)", filename, strerror(errno));
+	put_trace(&b);
+	flush_buffer(&b, f);
+	free_buffer(&b);
+	fclose(f);
+	return 0;
+}
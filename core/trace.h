@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct membuffer;
+
+/*
+ * Timing spans of the hot paths, which can be written in the Chrome
+ * trace event format. The files can be viewed with chrome://tracing or
+ * https://ui.perfetto.dev.
+ *
+ * Nothing is recorded unless trace_enable() was called, and the
+ * TRACE_* macros compile to nothing when built with NO_TRACING. Spans
+ * nest per thread: every TRACE_BEGIN() must be matched by TRACE_END()
+ * on the same thread. C++ code uses TRACE_SCOPE() instead, which ends
+ * the span when leaving the scope.
+ */
+extern bool tracing_enabled;
+
+extern void trace_enable(void);
+extern void trace_begin(const char *name);
+extern void trace_end(void);
+extern void put_trace(struct membuffer *b);
+extern int save_trace(const char *filename);
+
+#ifdef NO_TRACING
+#define TRACE_BEGIN(name) do { } while (0)
+#define TRACE_END() do { } while (0)
+#else
+#define TRACE_BEGIN(name) do { if (tracing_enabled) trace_begin(name); } while (0)
+#define TRACE_END() do { if (tracing_enabled) trace_end(); } while (0)
+#endif
+
+#ifdef __cplusplus
+}
+
+class TraceSpan {
+public:
+	TraceSpan(const char *name)
+	{
+		TRACE_BEGIN(name);
+	}
+	~TraceSpan()
+	{
+		TRACE_END();
+	}
+};
+
+#ifdef NO_TRACING
+#define TRACE_SCOPE(name)
+#else
+#define TRACE_SCOPE_VAR(line) traceSpan ## line
+#define TRACE_SCOPE_LINE(name, line) TraceSpan TRACE_SCOPE_VAR(line)(name)
+#define TRACE_SCOPE(name) TRACE_SCOPE_LINE(name, __LINE__)
+#endif
+
+#endif
+
+#endif // TRACE_H
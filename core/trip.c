@@ -50,6 +50,7 @@ static MAKE_GET_IDX(trip_table, struct dive_trip *, trips)
 static MAKE_GROW_TABLE(trip_table, struct dive_trip *, trips)
 static MAKE_GET_INSERTION_INDEX(trip_table, struct dive_trip *, trips, trip_less_than)
 static MAKE_ADD_TO(trip_table, struct dive_trip *, trips)
+MAKE_MERGE_INTO(trip_table, struct dive_trip *, trips, trip_less_than)
 static MAKE_REMOVE_FROM(trip_table, trips)
 MAKE_SORT(trip_table, struct dive_trip *, trips, comp_trips)
 MAKE_REMOVE(trip_table, struct dive_trip *, trip)
@@ -93,6 +94,7 @@ void add_dive_to_trip(struct dive *dive, dive_trip_t *trip)
 		SSRF_INFO("Warning: adding dive to trip that has trip set\n");
 	insert_dive(&trip->dives, dive);
 	dive->divetrip = trip;
+	invalidate_trip_cache(trip);
 }
 
 /* remove a dive from the trip it's associated to, but don't delete the
@@ -108,6 +110,7 @@ struct dive_trip *unregister_dive_from_trip(struct dive *dive)
 
 	remove_dive(dive, &trip->dives);
 	dive->divetrip = NULL;
+	invalidate_trip_cache(trip);
 	return trip;
 }
 
@@ -124,6 +127,17 @@ void remove_dive_from_trip(struct dive *dive, struct trip_table *trip_table_arg)
 		delete_trip(trip, trip_table_arg);
 }
 
+void invalidate_trip_cache(struct dive_trip *trip)
+{
+	memset(trip->git_id, 0, 20);
+}
+
+bool trip_cache_is_valid(const struct dive_trip *trip)
+{
+	static const unsigned char null_id[20] = { 0, };
+	return !!memcmp(trip->git_id, null_id, 20);
+}
+
 dive_trip_t *alloc_trip(void)
 {
 	dive_trip_t *res = calloc(1, sizeof(dive_trip_t));
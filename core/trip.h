@@ -18,6 +18,8 @@ typedef struct dive_trip
 	bool saved;
 	bool autogen;
 	bool selected;
+	/* Id of the trip tree in the git repository, all zero if it has to be written */
+	unsigned char git_id[20];
 } dive_trip_t;
 
 typedef struct trip_table {
@@ -32,12 +34,15 @@ extern struct dive_trip *unregister_dive_from_trip(struct dive *dive);
 extern void remove_dive_from_trip(struct dive *dive, struct trip_table *trip_table_arg);
 
 extern void insert_trip(dive_trip_t *trip, struct trip_table *trip_table_arg);
+extern void merge_into_trip_table(struct trip_table *table, dive_trip_t **trips, int nr);
 extern int remove_trip(const dive_trip_t *trip, struct trip_table *trip_table_arg);
 extern void free_trip(dive_trip_t *trip);
 extern timestamp_t trip_date(const struct dive_trip *trip);
 extern timestamp_t trip_enddate(const struct dive_trip *trip);
 
 extern bool trip_less_than(const struct dive_trip *a, const struct dive_trip *b);
+extern void invalidate_trip_cache(struct dive_trip *trip);
+extern bool trip_cache_is_valid(const struct dive_trip *trip);
 extern int comp_trips(const struct dive_trip *a, const struct dive_trip *b);
 extern void sort_trip_table(struct trip_table *table);
 
@@ -30,6 +30,7 @@
 #include "file.h"
 #include "tag.h"
 #include "subsurface-time.h"
+#include "arena.h"
 #include "core/subsurface-string.h"
 
 #define ERR_FS_ALMOST_FULL QT_TRANSLATE_NOOP("gettextFromC", "Uemis Zurich: the file system is almost full.\nDisconnect/reconnect the dive computer\nand click \'Retry\'")
@@ -63,10 +64,14 @@ static int debug_round = 0;
 #define UEMIS_TIMEOUT 50		/* 50ns */
 #define UEMIS_LONG_TIMEOUT 500		/* 500ns */
 #define UEMIS_MAX_TIMEOUT 2000		/* 2ms */
+#define UEMIS_MIN_POLL 10		/* 10ns */
+#define UEMIS_MAX_POLL 100		/* 100ns */
 #else
 #define UEMIS_TIMEOUT 50000		/* 50ms */
 #define UEMIS_LONG_TIMEOUT 500000	/* 500ms */
 #define UEMIS_MAX_TIMEOUT 2000000	/* 2s */
+#define UEMIS_MIN_POLL 10000		/* 10ms */
+#define UEMIS_MAX_POLL 100000		/* 100ms */
 #endif
 
 static char *param_buff[NUM_PARAM_BUFS];
@@ -76,6 +81,7 @@ static int filenr;
 static int number_of_files;
 static char *mbuf = NULL;
 static int mbuf_size = 0;
+static int mbuf_alloc = 0;
 
 static int max_mem_used = -1;
 static int next_table_index = 0;
@@ -415,19 +421,27 @@ static char *next_segment(char *buf, int *offset, int size)
 }
 
 /* a dynamically growing buffer to store the potentially massive responses.
- * The binary data block can be more than 100k in size (base64 encoded) */
-static void buffer_add(char **buffer, int *buffer_size, char *buf)
+ * The binary data block can be more than 100k in size (base64 encoded), so
+ * the allocation grows geometrically and the chunks are appended at the known
+ * end instead of rescanning the whole buffer for every chunk */
+static void buffer_add(char **buffer, int *buffer_size, int *buffer_alloc, char *buf)
 {
+	int len;
+
 	if (!buf)
 		return;
-	if (!*buffer) {
-		*buffer = strdup(buf);
-		*buffer_size = strlen(*buffer) + 1;
-	} else {
-		*buffer_size += strlen(buf);
-		*buffer = realloc(*buffer, *buffer_size);
-		strcat(*buffer, buf);
+	len = strlen(buf);
+	if (!*buffer)
+		*buffer_size = 1;
+	if (!*buffer || *buffer_size + len > *buffer_alloc) {
+		int alloc = *buffer_alloc > 0 ? *buffer_alloc : BUFLEN;
+		while (alloc < *buffer_size + len)
+			alloc *= 2;
+		*buffer = realloc(*buffer, alloc);
+		*buffer_alloc = alloc;
 	}
+	memcpy(*buffer + *buffer_size - 1, buf, len + 1);
+	*buffer_size += len;
 #if UEMIS_DEBUG & 8
 	fprintf(debugfile, "added \"%s\" to buffer - new length %d\n", buf, *buffer_size);
 #endif
@@ -508,7 +522,6 @@ static void uemis_increased_timeout(int *timeout)
 {
 	if (*timeout < UEMIS_MAX_TIMEOUT)
 		*timeout += UEMIS_LONG_TIMEOUT;
-	usleep(*timeout);
 }
 
 static char *build_ans_path(const char *path, int filenumber)
@@ -527,6 +540,67 @@ static char *build_ans_path(const char *path, int filenumber)
 	return ans_path;
 }
 
+/* What an ANS file looked like before we triggered a request. The files are
+ * reused, so a file that already exists may hold the answer to an older request */
+struct ans_state {
+	long size;
+	int len;
+	char head[100];
+};
+
+static void read_ans_state(const char *ans_path, struct ans_state *state)
+{
+	int ans_file = subsurface_open(ans_path, O_RDONLY, 0666);
+
+	state->size = -1;
+	state->len = 0;
+	if (ans_file < 0)
+		return;
+	state->size = bytes_available(ans_file);
+	state->len = read(ans_file, state->head, sizeof(state->head));
+	if (state->len < 0)
+		state->len = 0;
+	close(ans_file);
+}
+
+static void snapshot_answer(const char *path, int filenumber, struct ans_state *state)
+{
+	char *ans_path = build_ans_path(path, filenumber);
+	read_ans_state(ans_path, state);
+	free(ans_path);
+}
+
+/* Wait up to timeout usecs for the dive computer to answer a request.
+ * We can't be notified about the answer: the SDA is a mass storage device
+ * and the host doesn't see its writes as file system events. So we poll,
+ * starting with short intervals. We only return early for a complete answer
+ * (one that starts with '1') that differs from the state before the request
+ * and that didn't grow between two polls; anything else is left to the
+ * retry logic of the caller once the full timeout has passed, as before */
+static void wait_for_answer(const char *path, int filenumber, const struct ans_state *before, int timeout)
+{
+	char *ans_path = build_ans_path(path, filenumber);
+	struct ans_state now, last = *before;
+	int poll = UEMIS_MIN_POLL;
+
+	while (timeout > 0) {
+		int step = poll < timeout ? poll : timeout;
+		usleep(step);
+		timeout -= step;
+		if (import_thread_cancelled)
+			break;
+		read_ans_state(ans_path, &now);
+		if (now.len >= 3 && now.head[0] == '1' &&
+		    (now.size != before->size || now.len != before->len || memcmp(now.head, before->head, now.len)) &&
+		    now.size == last.size && now.len == last.len && !memcmp(now.head, last.head, now.len))
+			break;
+		last = now;
+		if (poll < UEMIS_MAX_POLL)
+			poll *= 2;
+	}
+	free(ans_path);
+}
+
 /* send a request to the dive computer and collect the answer */
 static bool uemis_get_answer(const char *path, char *request, int n_param_in,
 			     int n_param_out, const char **error_text)
@@ -545,6 +619,7 @@ static bool uemis_get_answer(const char *path, char *request, int n_param_in,
 	char *ans_path;
 	int ans_file;
 	int timeout = UEMIS_LONG_TIMEOUT;
+	struct ans_state ans_state;
 
 	reqtxt_file = subsurface_open(reqtxt_path, O_RDWR | O_CREAT, 0666);
 	if (reqtxt_file < 0) {
@@ -585,11 +660,13 @@ static bool uemis_get_answer(const char *path, char *request, int n_param_in,
 		*error_text = translate("gettextFromC", ERR_FS_FULL);
 		more_files = false;
 	}
+	snapshot_answer(path, filenr - 1, &ans_state);
 	trigger_response(reqtxt_file, "n", filenr, file_length);
-	usleep(timeout);
+	wait_for_answer(path, filenr - 1, &ans_state, timeout);
 	free(mbuf);
 	mbuf = NULL;
 	mbuf_size = 0;
+	mbuf_alloc = 0;
 	while (searching || assembling_mbuf) {
 		if (import_thread_cancelled)
 			return false;
@@ -642,6 +719,7 @@ static bool uemis_get_answer(const char *path, char *request, int n_param_in,
 					fprintf(stderr, "open %s failed with errno %d\n", reqtxt_path, errno);
 					return false;
 				}
+				snapshot_answer(path, filenr - 1, &ans_state);
 				trigger_response(reqtxt_file, "n", filenr, file_length);
 			}
 		} else {
@@ -657,8 +735,10 @@ static bool uemis_get_answer(const char *path, char *request, int n_param_in,
 				fprintf(stderr, "open %s failed with errno %d\n", reqtxt_path, errno);
 				return false;
 			}
+			snapshot_answer(path, filenr - 1, &ans_state);
 			trigger_response(reqtxt_file, "r", filenr, file_length);
 			uemis_increased_timeout(&timeout);
+			wait_for_answer(path, filenr - 1, &ans_state, timeout);
 		}
 		if (ismulti && more_files && tmp[0] == '1') {
 			int size;
@@ -685,14 +765,15 @@ static bool uemis_get_answer(const char *path, char *request, int n_param_in,
 					goto fs_error;
 				}
 				buf[r] = '\0';
-				buffer_add(&mbuf, &mbuf_size, buf);
+				buffer_add(&mbuf, &mbuf_size, &mbuf_alloc, buf);
 				show_progress(buf, what);
 				free(buf);
 				param_buff[3]++;
 			}
 			close(ans_file);
 			timeout = UEMIS_TIMEOUT;
-			usleep(UEMIS_TIMEOUT);
+			if (assembling_mbuf)
+				wait_for_answer(path, filenr - 1, &ans_state, timeout);
 		}
 	}
 	if (more_files) {
@@ -722,7 +803,7 @@ static bool uemis_get_answer(const char *path, char *request, int n_param_in,
 					goto fs_error;
 				}
 				buf[r] = '\0';
-				buffer_add(&mbuf, &mbuf_size, buf);
+				buffer_add(&mbuf, &mbuf_size, &mbuf_alloc, buf);
 				show_progress(buf, what);
 #if UEMIS_DEBUG & 8
 				fprintf(debugfile, "::r %s \"%s\"\n", ans_path, buf);
@@ -858,10 +939,10 @@ static bool uemis_delete_dive(device_data_t *devdata, uint32_t diveid)
 		devdata->download_table->dives[--devdata->download_table->nr] = NULL;
 
 		free(dive->dc.sample);
-		free((void *)dive->notes);
-		free((void *)dive->divemaster);
-		free((void *)dive->buddy);
-		free((void *)dive->suit);
+		arena_free((void *)dive->notes);
+		arena_free((void *)dive->divemaster);
+		arena_free((void *)dive->buddy);
+		arena_free((void *)dive->suit);
 		taglist_free(dive->tag_list);
 		free(dive);
 
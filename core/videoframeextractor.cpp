@@ -6,6 +6,10 @@
 
 #include <QtConcurrent>
 #include <QProcess>
+#include <QTemporaryDir>
+
+// Extract the thumbnails of up to that many queued videos with one ffmpeg process
+static const int maxBatchSize = 16;
 
 // Note: this is a global instead of a function-local variable on purpose.
 // We don't want this to be generated in a different thread context if
@@ -16,7 +20,7 @@ VideoFrameExtractor *VideoFrameExtractor::instance()
 	return &frameExtractor;
 }
 
-VideoFrameExtractor::VideoFrameExtractor()
+VideoFrameExtractor::VideoFrameExtractor() : workerRunning(false)
 {
 	// Currently, we only process one video at a time.
 	// Eventually, we might want to increase this value.
@@ -28,8 +32,12 @@ void VideoFrameExtractor::extract(QString originalFilename, QString filename, du
 	QMutexLocker l(&lock);
 	if (!workingOn.contains(originalFilename)) {
 		// We are not currently extracting this video - add it to the list.
-		workingOn.insert(originalFilename, QtConcurrent::run(&pool, [this, originalFilename, filename, duration]()
-				 { processItem(originalFilename, filename, duration); }));
+		workingOn.insert(originalFilename);
+		queue.enqueue({ originalFilename, filename, duration });
+		if (!workerRunning) {
+			workerRunning = true;
+			QtConcurrent::run(&pool, [this]() { work(); });
+		}
 	}
 }
 
@@ -46,8 +54,7 @@ void VideoFrameExtractor::fail(const QString &originalFilename, duration_t durat
 void VideoFrameExtractor::clearWorkQueue()
 {
 	QMutexLocker l(&lock);
-	for (auto it = workingOn.begin(); it != workingOn.end(); ++it)
-		it->cancel();
+	queue.clear();
 	workingOn.clear();
 }
 
@@ -58,6 +65,95 @@ T clamp(T v, T lo, T hi)
 	return v < lo ? lo : v > hi ? hi : v;
 }
 
+// Determine the time where we want to extract the image.
+// If the duration is < 10 sec, just snap the first frame
+static duration_t thumbnailPosition(duration_t &duration)
+{
+	duration_t position = { 0 };
+	if (duration.seconds > 10) {
+		// We round to second-precision. To be sure that we don't attempt reading past the
+		// video's end, round down by one second.
+		--duration.seconds;
+		position.seconds = clamp(duration.seconds * prefs.extract_video_thumbnails_position / 100,
+					 0, duration.seconds);
+	}
+	return position;
+}
+
+static QString positionString(duration_t position)
+{
+	return QString("%1:%2:%3").arg(position.seconds / 3600, 2, 10, QChar('0'))
+				  .arg((position.seconds % 3600) / 60, 2, 10, QChar('0'))
+				  .arg(position.seconds % 60, 2, 10, QChar('0'));
+}
+
+// Work off the queue in batches, so that not every video needs its own ffmpeg process
+void VideoFrameExtractor::work()
+{
+	for (;;) {
+		QVector<Item> items;
+		QMutexLocker l(&lock);
+		while (!queue.isEmpty() && items.size() < maxBatchSize)
+			items.push_back(queue.dequeue());
+		if (items.isEmpty()) {
+			workerRunning = false;
+			return;
+		}
+		l.unlock();
+		processBatch(items);
+	}
+}
+
+// Extract the thumbnails of all videos with a single ffmpeg invocation: one input
+// and one output file per video. If that doesn't produce a thumbnail for a video,
+// e.g. because one of the files is broken and ffmpeg gave up, try the video on
+// its own, which also tells a broken file from a failure to run ffmpeg.
+void VideoFrameExtractor::processBatch(QVector<Item> items)
+{
+	// If video frame extraction is turned off (e.g. because we failed to start ffmpeg),
+	// abort immediately.
+	if (!prefs.extract_video_thumbnails) {
+		QMutexLocker l(&lock);
+		for (const Item &item: items)
+			workingOn.remove(item.originalFilename);
+		return;
+	}
+	QTemporaryDir dir;
+	if (items.size() == 1 || !dir.isValid()) {
+		for (const Item &item: items)
+			processItem(item.originalFilename, item.filename, item.duration);
+		return;
+	}
+
+	QStringList arguments { "-y" };
+	QVector<duration_t> durations, positions;
+	for (const Item &item: items) {
+		duration_t duration = item.duration;
+		positions.push_back(thumbnailPosition(duration));
+		durations.push_back(duration);
+		arguments << "-ss" << positionString(positions.back()) << "-i" << item.filename;
+	}
+	for (int i = 0; i < items.size(); ++i) {
+		arguments << "-map" << QString("%1:v:0").arg(i) << "-frames:v" << "1" << "-q:v" << "2"
+			  << dir.filePath(QString("%1.jpg").arg(i));
+	}
+	QProcess ffmpeg;
+	ffmpeg.start(prefs.ffmpeg_executable, arguments);
+	if (ffmpeg.waitForStarted())
+		ffmpeg.waitForFinished(30000 * items.size());
+
+	for (int i = 0; i < items.size(); ++i) {
+		QImage img(dir.filePath(QString("%1.jpg").arg(i)));
+		if (img.isNull()) {
+			processItem(items[i].originalFilename, items[i].filename, items[i].duration);
+			continue;
+		}
+		emit extracted(items[i].originalFilename, img, durations[i], positions[i]);
+		QMutexLocker l(&lock);
+		workingOn.remove(items[i].originalFilename);
+	}
+}
+
 void VideoFrameExtractor::processItem(QString originalFilename, QString filename, duration_t duration)
 {
 	// If video frame extraction is turned off (e.g. because we failed to start ffmpeg),
@@ -68,19 +164,8 @@ void VideoFrameExtractor::processItem(QString originalFilename, QString filename
 		return;
 	}
 
-	// Determine the time where we want to extract the image.
-	// If the duration is < 10 sec, just snap the first frame
-	duration_t position = { 0 };
-	if (duration.seconds > 10) {
-		// We round to second-precision. To be sure that we don't attempt reading past the
-		// video's end, round down by one second.
-		--duration.seconds;
-		position.seconds = clamp(duration.seconds * prefs.extract_video_thumbnails_position / 100,
-					 0, duration.seconds);
-	}
-	QString posString = QString("%1:%2:%3").arg(position.seconds / 3600, 2, 10, QChar('0'))
-					       .arg((position.seconds % 3600) / 60, 2, 10, QChar('0'))
-					       .arg(position.seconds % 60, 2, 10, QChar('0'));
+	duration_t position = thumbnailPosition(duration);
+	QString posString = positionString(position);
 
 	QProcess ffmpeg;
 	ffmpeg.start(prefs.ffmpeg_executable, QStringList {
@@ -10,6 +10,8 @@
 #include <QQueue>
 #include <QString>
 #include <QPair>
+#include <QSet>
+#include <QVector>
 
 class VideoFrameExtractor : public QObject {
 	Q_OBJECT
@@ -27,11 +29,21 @@ public slots:
 	void extract(QString originalFilename, QString filename, duration_t duration);
 	void clearWorkQueue();
 private:
+	struct Item {
+		QString originalFilename;
+		QString filename;
+		duration_t duration;
+	};
+	void work();
+	void processBatch(QVector<Item> items);
 	void processItem(QString originalFilename, QString filename, duration_t duration);
 	void fail(const QString &originalFilename, duration_t duration, bool isInvalid);
 	mutable QMutex lock;
 	QThreadPool pool;
-	QMap<QString, QFuture<void>> workingOn;
+	// Videos either queued or being processed
+	QSet<QString> workingOn;
+	QQueue<Item> queue;
+	bool workerRunning;
 };
 
 #endif
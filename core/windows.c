@@ -257,8 +257,9 @@ int subsurface_rename(const char *path, const char *newpath)
 	wchar_t *wpath = utf8_to_utf16(path);
 	wchar_t *wnewpath = utf8_to_utf16(newpath);
 
+	/* Contrary to _wrename(), this replaces an existing file, like rename() on POSIX systems */
 	if (wpath && wnewpath)
-		ret = _wrename(wpath, wnewpath);
+		ret = MoveFileExW(wpath, wnewpath, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
 	free((void *)wpath);
 	free((void *)wnewpath);
 	return ret;
@@ -399,6 +400,32 @@ int subsurface_zip_close(struct zip *zip)
 	return zip_close(zip);
 }
 
+void *subsurface_mmap(int fd, size_t size)
+{
+	SYSTEM_INFO info;
+	HANDLE file = (HANDLE)_get_osfhandle(fd);
+	HANDLE mapping;
+	void *ret;
+
+	/* The zero-filled rest of the last page terminates the buffer */
+	GetSystemInfo(&info);
+	if (file == INVALID_HANDLE_VALUE || size % info.dwPageSize == 0)
+		return NULL;
+	mapping = CreateFileMappingW(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (!mapping)
+		return NULL;
+	ret = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, size);
+	/* The view keeps a reference to the mapping */
+	CloseHandle(mapping);
+	return ret;
+}
+
+void subsurface_munmap(void *addr, size_t size)
+{
+	UNUSED(size);
+	UnmapViewOfFile(addr);
+}
+
 /* win32 console */
 static struct {
 	bool allocated;
@@ -1,9 +1,15 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "desktop-widgets/about.h"
+#include "core/membuffer.h"
+#include "core/memusage.h"
 #include "core/version.h"
 #include <QDesktopServices>
+#include <QDialogButtonBox>
+#include <QFontDatabase>
+#include <QPlainTextEdit>
 #include <QUrl>
 #include <QShortcut>
+#include <QVBoxLayout>
 
 SubsurfaceAbout::SubsurfaceAbout(QWidget *parent, Qt::WindowFlags f) : QDialog(parent, f)
 {
@@ -44,3 +50,26 @@ void SubsurfaceAbout::on_creditButton_clicked()
 {
 	QDesktopServices::openUrl(QUrl("http://subsurface-divelog.org/misc/credits"));
 }
+
+// Show the memory accounting as selectable text, so that it can be pasted into bug reports
+void SubsurfaceAbout::on_memoryButton_clicked()
+{
+	membuffer buf = {};
+	put_memory_usage(&buf);
+	QString text = QString::fromUtf8(mb_cstring(&buf));
+	free_buffer(&buf);
+
+	QDialog dialog(this);
+	dialog.setWindowTitle(tr("Memory usage"));
+	QVBoxLayout *layout = new QVBoxLayout(&dialog);
+	QPlainTextEdit *edit = new QPlainTextEdit(text, &dialog);
+	edit->setReadOnly(true);
+	edit->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+	edit->setLineWrapMode(QPlainTextEdit::NoWrap);
+	edit->setMinimumWidth(edit->fontMetrics().averageCharWidth() * 80);
+	layout->addWidget(edit);
+	QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+	connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+	layout->addWidget(buttons);
+	dialog.exec();
+}
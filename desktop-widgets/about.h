@@ -15,6 +15,7 @@ slots:
 	void on_licenseButton_clicked();
 	void on_websiteButton_clicked();
 	void on_creditButton_clicked();
+	void on_memoryButton_clicked();
 
 private:
 	Ui::SubsurfaceAbout ui;
@@ -8,6 +8,7 @@
 #include "qt-models/filtermodels.h"
 #include "desktop-widgets/modeldelegates.h"
 #include "desktop-widgets/mainwindow.h"
+#include "profile-widget/profilewidget2.h"
 #include "core/selection.h"
 #include <unistd.h>
 #include <QSettings>
@@ -16,6 +17,7 @@
 #include <QStandardPaths>
 #include <QMessageBox>
 #include <QHeaderView>
+#include <QScrollBar>
 #include "commands/command.h"
 #include "core/errorhelper.h"
 #include "core/qthelper.h"
@@ -54,6 +56,11 @@ DiveListView::DiveListView(QWidget *parent) : QTreeView(parent),
 
 	installEventFilter(this);
 
+	// Dragging the scroll bar through a long list repaints the whole view for every
+	// step. Meanwhile, only paint the columns that are cheap to render.
+	connect(verticalScrollBar(), &QScrollBar::sliderPressed, [this] { setFastScroll(true); });
+	connect(verticalScrollBar(), &QScrollBar::sliderReleased, [this] { setFastScroll(false); });
+
 	for (int i = DiveTripModelBase::NR; i < DiveTripModelBase::COLUMNS; i++)
 		calculateInitialColumnWidth(i);
 	setColumnWidths();
@@ -77,6 +84,13 @@ DiveListView::~DiveListView()
 	settings.endGroup();
 }
 
+void DiveListView::setFastScroll(bool fast)
+{
+	static_cast<DiveListDelegate *>(itemDelegate())->setFastScroll(fast);
+	static_cast<StarWidgetsDelegate *>(itemDelegateForColumn(DiveTripModelBase::RATING))->setFastScroll(fast);
+	viewport()->update();
+}
+
 void DiveListView::resetModel()
 {
 	MultiFilterSortModel *m = MultiFilterSortModel::instance();
@@ -833,6 +847,8 @@ void DiveListView::contextMenuEvent(QContextMenuEvent *event)
 	}
 	if (amount_selected > 1 && consecutive_selected())
 		popup.addAction(tr("Merge selected dives"), this, &DiveListView::mergeDives);
+	if (amount_selected > 1)
+		popup.addAction(tr("Compare profiles"), this, &DiveListView::compareProfiles);
 	if (amount_selected >= 1) {
 		popup.addAction(tr("Renumber dive(s)"), this, &DiveListView::renumberDives);
 		popup.addAction(tr("Shift dive times"), this, &DiveListView::shiftTimes);
@@ -852,6 +868,20 @@ void DiveListView::contextMenuEvent(QContextMenuEvent *event)
 	event->accept();
 }
 
+// Overlay the profiles of the selected dives on the profile of the current dive
+void DiveListView::compareProfiles()
+{
+	int i;
+	struct dive *d;
+	QVector<dive *> dives;
+
+	for_each_dive (i, d) {
+		if (d->selected)
+			dives.append(d);
+	}
+	MainWindow::instance()->graphics->setComparisonDives(dives);
+}
+
 void DiveListView::shiftTimes()
 {
 	ShiftTimesDialog dialog(MainWindow::instance());
@@ -887,10 +917,13 @@ void DiveListView::matchImagesToDives(QStringList fileNames)
 	updateLastImageTimeOffset(shiftDialog.amount());
 
 	// Create the data structure of pictures to be added: a list of pictures per dive.
+	// The dialog already extracted the metadata of the files
 	std::vector<Command::PictureListForAddition> pics;
-	for (const QString &fileName: fileNames) {
+	const QVector<metadata> &fileMetadata = shiftDialog.fileMetadata();
+	for (int i = 0; i < fileNames.size(); ++i) {
+		const QString &fileName = fileNames[i];
 		struct dive *d;
-		picture *pic = create_picture(qPrintable(fileName), shiftDialog.amount(), shiftDialog.matchAll(), &d);
+		picture *pic = create_picture_from_metadata(qPrintable(fileName), &fileMetadata[i], shiftDialog.amount(), shiftDialog.matchAll(), &d);
 		if (!pic)
 			continue;
 		PictureObj pObj(*pic);
@@ -48,6 +48,7 @@ slots:
 	void addToTripAbove();
 	void addToTripBelow();
 	void mergeDives();
+	void compareProfiles();
 	void splitDives();
 	void renumberDives();
 	void shiftTimes();
@@ -86,6 +87,7 @@ private:
 	void mouseDoubleClickEvent(QMouseEvent *event) override;
 	void contextMenuEvent(QContextMenuEvent *event) override;
 	void currentChanged(const QModelIndex &current, const QModelIndex &previous) override;
+	void setFastScroll(bool fast);
 	QNetworkAccessManager manager;
 	bool programmaticalSelectionChange;
 };
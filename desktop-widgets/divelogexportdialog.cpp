@@ -1,7 +1,15 @@
 // SPDX-License-Identifier: GPL-2.0
+#include <QApplication>
 #include <QFileDialog>
+#include <QInputDialog>
+#include <QPainter>
+#include <QProgressDialog>
 #include <QShortcut>
 #include <QSettings>
+#include <QSvgGenerator>
+#include <QThread>
+#include <QtConcurrent>
+#include <deque>
 #include <string.h> // Allows string comparisons and substitutions in TeX export
 
 #include "ui_divelogexportdialog.h"
@@ -14,6 +22,7 @@
 #include "core/divesite.h"
 #include "core/errorhelper.h"
 #include "core/file.h"
+#include "core/gettextfromc.h"
 #include "core/tag.h"
 #include "backend-shared/exportfuncs.h"
 #include "desktop-widgets/mainwindow.h"
@@ -68,6 +77,9 @@ DiveLogExportDialog::DiveLogExportDialog(QWidget *parent) : QDialog(parent),
 	if (settings.contains("listOnly")) {
 		ui->exportListOnly->setChecked(settings.value("listOnly").toBool());
 	}
+	if (settings.contains("packedSamples")) {
+		ui->exportPackedSamples->setChecked(settings.value("packedSamples").toBool());
+	}
 	if (settings.contains("exportPhotos")) {
 		ui->exportPhotos->setChecked(settings.value("exportPhotos").toBool());
 	}
@@ -104,12 +116,25 @@ void DiveLogExportDialog::showExplanation()
 	} else if (ui->exportLaTeX->isChecked()) {
 		ui->description->setText(tr("Write dive as LaTeX macros to file."));
 	} else if (ui->exportProfile->isChecked()) {
-		ui->description->setText(tr("Write the profile image as PNG file."));
+		ui->description->setText(tr("Write the profile images as PNG or SVG files."));
 	} else if (ui->exportProfileData->isChecked()) {
 		ui->description->setText(tr("Write the computed Profile Panel data to a CSV file."));
 	}
 }
 
+// Show the progress of an export that runs in the UI thread and let the user cancel it
+static std::function<bool(int, int)> progressCallback(QProgressDialog &progress)
+{
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(500);
+	return [&progress](int done, int total) {
+		progress.setMaximum(total);
+		progress.setValue(done);
+		qApp->processEvents();
+		return progress.wasCanceled();
+	};
+}
+
 void DiveLogExportDialog::exportHtmlInit(const QString &filename)
 {
 	struct htmlExportSetting hes;
@@ -117,13 +142,15 @@ void DiveLogExportDialog::exportHtmlInit(const QString &filename)
 	hes.exportPhotos = ui->exportPhotos->isChecked();
 	hes.selectedOnly = ui->exportSelectedDives->isChecked();
 	hes.listOnly = ui->exportListOnly->isChecked();
+	hes.packedSamples = ui->exportPackedSamples->isChecked();
 	hes.fontFamily = ui->fontSelection->itemData(ui->fontSelection->currentIndex()).toString();
 	hes.fontSize = ui->fontSizeSelection->currentText();
 	hes.themeSelection = ui->themeSelection->currentIndex();
 	hes.subsurfaceNumbers = ui->exportSubsurfaceNumber->isChecked();
 	hes.yearlyStatistics = ui->exportStatistics->isChecked();
 
-	exportHtmlInitLogic(filename, hes);
+	QProgressDialog progress(tr("Copying photos..."), tr("Cancel"), 0, 0, this);
+	exportHtmlInitLogic(filename, hes, progressCallback(progress));
 }
 
 void DiveLogExportDialog::on_exportGroup_buttonClicked(QAbstractButton*)
@@ -188,16 +215,38 @@ void DiveLogExportDialog::on_buttonBox_accepted()
 				export_depths(qPrintable(filename), ui->exportSelected->isChecked());
 		} else if (ui->exportTeX->isChecked() || ui->exportLaTeX->isChecked()) {
 			filename = QFileDialog::getSaveFileName(this, tr("Export to TeX file"), lastDir, tr("TeX files") + " (*.tex)");
-			if (!filename.isNull() && !filename.isEmpty())
-				export_TeX(qPrintable(filename), ui->exportSelected->isChecked(), ui->exportTeX->isChecked());
+			if (!filename.isNull() && !filename.isEmpty()) {
+				QProgressDialog progress(tr("Writing profile images..."), tr("Cancel"), 0, 0, this);
+				export_TeX(qPrintable(filename), ui->exportSelected->isChecked(), ui->exportTeX->isChecked(), progressCallback(progress));
+			}
 		} else if (ui->exportProfile->isChecked()) {
-			filename = QFileDialog::getSaveFileName(this, tr("Save profile image"), lastDir);
-			if (!filename.isNull() && !filename.isEmpty())
-				exportProfile(qPrintable(filename), ui->exportSelected->isChecked());
+			filename = QFileDialog::getSaveFileName(this, tr("Save profile image"), lastDir,
+								tr("PNG files") + " (*.png);;" + tr("SVG files") + " (*.svg)");
+			if (!filename.isNull() && !filename.isEmpty()) {
+				QSettings settings;
+				bool ok;
+				int scale = QInputDialog::getInt(this, tr("Save profile image"),
+								 tr("Size of the image, as multiple of the profile on screen"),
+								 settings.value("ProfileImage/scale", 4).toInt(), 1, 8, 1, &ok);
+				if (ok) {
+					settings.setValue("ProfileImage/scale", scale);
+					QProgressDialog progress(tr("Writing profile images..."), tr("Cancel"), 0, 0, this);
+					exportProfile(qPrintable(filename), ui->exportSelected->isChecked(), scale, progressCallback(progress));
+				}
+			}
 		} else if (ui->exportProfileData->isChecked()) {
 			filename = QFileDialog::getSaveFileName(this, tr("Save profile data"), lastDir);
-			if (!filename.isNull() && !filename.isEmpty())
-				save_profiledata(qPrintable(filename), ui->exportSelected->isChecked());
+			if (!filename.isNull() && !filename.isEmpty()) {
+				QSettings settings;
+				bool ok;
+				QString columns = QInputDialog::getText(this, tr("Save profile data"),
+									tr("Columns to export, separated by commas (e.g. \"sec, depth, ceiling_*\"). Leave empty to export all columns."),
+									QLineEdit::Normal, settings.value("ProfileData/columns").toString(), &ok);
+				if (ok) {
+					settings.setValue("ProfileData/columns", columns);
+					save_profiledata(qPrintable(filename), ui->exportSelected->isChecked(), qPrintable(columns.trimmed()));
+				}
+			}
 		}
 		break;
 	case 1:
@@ -224,19 +273,70 @@ void DiveLogExportDialog::on_buttonBox_accepted()
 
 void exportProfile(const struct dive *dive, const QString filename)
 {
+	exportProfiles({ dive }, { filename }, 4);
+}
+
+// The profile widget is switched to print mode once for all dives. The plot data is
+// calculated in parallel, a few dives at a time. The plotting has to be done in the UI
+// thread, but PNG files are compressed and written by worker threads. The number of
+// images waiting to be written is limited, since at high resolutions they are big.
+bool exportProfiles(const std::vector<const struct dive *> &dives, const std::vector<QString> &filenames, int scale,
+		    const std::function<bool(int, int)> &progress)
+{
+	if (dives.empty())
+		return true;
 	ProfileWidget2 *profile = MainWindow::instance()->graphics;
 	profile->setToolTipVisibile(false);
 	profile->setPrintMode(true);
-	double scale = profile->getFontPrintScale();
-	profile->setFontPrintScale(4 * scale);
-	profile->plotDive(dive, true, false, true);
-	QImage image = QImage(profile->size() * 4, QImage::Format_RGB32);
-	QPainter paint;
-	paint.begin(&image);
-	profile->render(&paint);
-	image.save(filename);
+	double fontScale = profile->getFontPrintScale();
+	profile->setFontPrintScale(scale * fontScale);
+
+	std::deque<std::pair<QFuture<bool>, QString>> writes;
+	QStringList failed;
+	auto finishWrite = [&writes, &failed]() {
+		if (!writes.front().first.result())
+			failed.push_back(writes.front().second);
+		writes.pop_front();
+	};
+	size_t maxWrites = std::max(QThread::idealThreadCount(), 1);
+	bool cancelled = false;
+	for (size_t i = 0; i < dives.size() && !cancelled;) {
+		size_t nr = profile->calculatePlotInfos(&dives[i], dives.size() - i);
+		for (size_t end = i + nr; i < end && !cancelled; ++i) {
+			if (progress && progress((int)i, (int)dives.size())) {
+				cancelled = true;
+				break;
+			}
+			profile->plotDive(dives[i], true, false, true);
+			if (filenames[i].endsWith(".svg", Qt::CaseInsensitive)) {
+				QSvgGenerator generator;
+				generator.setFileName(filenames[i]);
+				generator.setSize(profile->size() * scale);
+				generator.setViewBox(QRect(QPoint(0, 0), profile->size() * scale));
+				QPainter paint(&generator);
+				profile->render(&paint);
+				continue;
+			}
+			QImage image(profile->size() * scale, QImage::Format_RGB32);
+			QPainter paint(&image);
+			profile->render(&paint);
+			paint.end();
+			if (writes.size() >= maxWrites)
+				finishWrite();
+			QString filename = filenames[i];
+			writes.emplace_back(QtConcurrent::run([image, filename]() { return image.save(filename); }), filename);
+		}
+	}
+	while (!writes.empty())
+		finishWrite();
+	if (progress && !cancelled)
+		progress((int)dives.size(), (int)dives.size());
+	if (!failed.isEmpty())
+		report_error(qPrintable(gettextFromC::tr("Could not write profile image %1").arg(failed.join(", "))));
+
 	profile->setToolTipVisibile(true);
-	profile->setFontPrintScale(scale);
+	profile->setFontPrintScale(fontScale);
 	profile->setPrintMode(false);
-	profile->plotDive(dive, true);
+	profile->plotDive(current_dive, true);
+	return !cancelled;
 }
@@ -4,17 +4,21 @@
 #include "commands/command.h"
 #include "core/color.h"
 #include "ui_divelogimportdialog.h"
+#include <QBuffer>
 #include <QShortcut>
 #include <QDrag>
 #include <QMimeData>
 #include <QRegExp>
 #include <QUndoStack>
 #include <QPainter>
+#include <QProgressDialog>
+#include <QApplication>
 #include "core/filterpreset.h"
 #include "core/qthelper.h"
 #include "core/divesite.h"
 #include "core/trip.h"
 #include "core/import-csv.h"
+#include "core/importfiles.h"
 
 static QString subsurface_mimedata = "subsurface/csvcolumns";
 static QString subsurface_index = "subsurface/csvindex";
@@ -418,6 +422,30 @@ static QPair<QString, QString> poseidonFileNames(const QString &fn)
 	}
 }
 
+// The preview only shows the first lines of the file. The beginning of the file
+// is read once and parsed from memory when the separator or the file type changes.
+// Only the actual import reads the whole file.
+static const qint64 previewSize = 256 * 1024;
+
+QByteArray DiveLogImportDialog::previewContents(const QString &fileName)
+{
+	auto it = previewCache.find(fileName);
+	if (it != previewCache.end())
+		return *it;
+
+	QByteArray contents;
+	QFile f(fileName);
+	if (f.open(QFile::ReadOnly)) {
+		contents = f.read(previewSize);
+		// Don't show a truncated last line
+		int end = contents.lastIndexOf('\n');
+		if (!f.atEnd() && end >= 0)
+			contents.truncate(end + 1);
+	}
+	previewCache.insert(fileName, contents);
+	return contents;
+}
+
 void DiveLogImportDialog::loadFileContents(int value, whatChanged triggeredBy)
 {
 	QList<QStringList> fileColumns;
@@ -442,8 +470,9 @@ void DiveLogImportDialog::loadFileContents(int value, whatChanged triggeredBy)
 	QString fileName = fileNames.first();
 	QPair<QString, QString> pair = poseidonFileNames(fileName);
 	if (!pair.second.isEmpty()) {
-		QFile f_txt(pair.second);
-		f_txt.open(QFile::ReadOnly);
+		QBuffer f_txt;
+		f_txt.setData(previewContents(pair.second));
+		f_txt.open(QIODevice::ReadOnly);
 		QString firstLine = f_txt.readLine();
 		if (firstLine.startsWith("MkVI_Config ")) {
 			poseidon = true;
@@ -456,8 +485,9 @@ void DiveLogImportDialog::loadFileContents(int value, whatChanged triggeredBy)
 		}
 	}
 
-	QFile f(fileName);
-	f.open(QFile::ReadOnly);
+	QBuffer f;
+	f.setData(previewContents(fileName));
+	f.open(QIODevice::ReadOnly);
 	QString firstLine = f.readLine();
 	if (firstLine.contains("SEABEAR")) {
 		seabear = true;
@@ -910,37 +940,44 @@ void DiveLogImportDialog::on_buttonBox_accepted()
 	struct trip_table trips = empty_trip_table;
 	struct dive_site_table sites = empty_dive_site_table;
 	filter_preset_table_t filter_presets;
+	std::vector<ImportJob> jobs;
 	QStringList r = resultModel->result();
+	QByteArray csvtemplate = specialCSV.contains(ui->knownImports->currentIndex()) ? CSVApps[ui->knownImports->currentIndex()].name.toUtf8() : QByteArray("csv");
+
+	// The parameters are collected from the dialog here, the files are parsed by runImportJobs()
 	if (ui->knownImports->currentText() != "Manual import") {
 		for (int i = 0; i < fileNames.size(); ++i) {
+			QString fileName = fileNames[i];
 			if (ui->knownImports->currentText() == "Seabear CSV") {
-				parse_seabear_log(qPrintable(fileNames[i]), &table, &trips, &sites, &filter_presets);
+				jobs.push_back({ fileName, [fileName](dive_table *t, trip_table *tr, dive_site_table *s, filter_preset_table_t *f)
+						     { parse_seabear_log(qPrintable(fileName), t, tr, s, f); } });
 			} else if (ui->knownImports->currentText() == "Poseidon MkVI") {
 				QPair<QString, QString> pair = poseidonFileNames(fileNames[i]);
-				parse_txt_file(qPrintable(pair.second), qPrintable(pair.first), &table, &trips, &sites);
+				jobs.push_back({ fileName, [pair](dive_table *t, trip_table *tr, dive_site_table *s, filter_preset_table_t *)
+						     { parse_txt_file(qPrintable(pair.second), qPrintable(pair.first), t, tr, s); } });
 			} else {
-				char *params[50];
+				std::vector<char *> params(50);
 				int pnr = 0;
 
 				QRegExp apdRe("^.*[/\\][0-9a-zA-Z]*_([0-9]{6})_([0-9]{6})\\.apd");
 				if (txtLog) {
-					pnr = parseTxtHeader(fileNames[i], params, pnr);
+					pnr = parseTxtHeader(fileNames[i], params.data(), pnr);
 				} else if (apdRe.exactMatch(fileNames[i])) {
 					params[pnr++] = strdup("date");
 					params[pnr++] = strdup("20" + apdRe.cap(1).toLatin1());
 					params[pnr++] = strdup("time");
 					params[pnr++] = strdup("1" + apdRe.cap(2).toLatin1());
 				}
-				pnr = setup_csv_params(r, params, pnr);
-				parse_csv_file(qPrintable(fileNames[i]), params, pnr - 1,
-						specialCSV.contains(ui->knownImports->currentIndex()) ? qPrintable(CSVApps[ui->knownImports->currentIndex()].name) : "csv",
-						&table, &trips, &sites, &filter_presets);
+				pnr = setup_csv_params(r, params.data(), pnr);
+				jobs.push_back({ fileName, [fileName, params, pnr, csvtemplate](dive_table *t, trip_table *tr, dive_site_table *s, filter_preset_table_t *f) mutable
+						     { parse_csv_file(qPrintable(fileName), params.data(), pnr - 1, csvtemplate.constData(), t, tr, s, f); } });
 			}
 		}
 	} else {
 		for (int i = 0; i < fileNames.size(); ++i) {
+			QString fileName = fileNames[i];
 			if (r.indexOf(tr("Sample time")) < 0) {
-				char *params[61];
+				std::vector<char *> params(61);
 				int pnr = 0;
 				params[pnr++] = strdup("numberField");
 				params[pnr++] = intdup(r.indexOf(tr("Dive #")));
@@ -1000,28 +1037,39 @@ void DiveLogImportDialog::on_buttonBox_accepted()
 				params[pnr++] = intdup(r.indexOf(tr("Rating")));
 				params[pnr++] = NULL;
 
-				parse_manual_file(qPrintable(fileNames[i]), params, pnr - 1, &table, &trips, &sites, &filter_presets);
+				jobs.push_back({ fileName, [fileName, params, pnr](dive_table *t, trip_table *tr, dive_site_table *s, filter_preset_table_t *f) mutable
+						     { parse_manual_file(qPrintable(fileName), params.data(), pnr - 1, t, tr, s, f); } });
 			} else {
-				char *params[53];
+				std::vector<char *> params(53);
 				int pnr = 0;
 
 				QRegExp apdRe("^.*[/\\][0-9a-zA-Z]*_([0-9]{6})_([0-9]{6})\\.apd");
 				if (txtLog) {
-					pnr = parseTxtHeader(fileNames[i], params, pnr);
+					pnr = parseTxtHeader(fileNames[i], params.data(), pnr);
 				} else if (apdRe.exactMatch(fileNames[i])) {
 					params[pnr++] = strdup("date");
 					params[pnr++] = strdup("20" + apdRe.cap(1).toLatin1());
 					params[pnr++] = strdup("time");
 					params[pnr++] = strdup("1" + apdRe.cap(2).toLatin1());
 				}
-				pnr = setup_csv_params(r, params, pnr);
-				parse_csv_file(qPrintable(fileNames[i]), params, pnr - 1,
-						specialCSV.contains(ui->knownImports->currentIndex()) ? qPrintable(CSVApps[ui->knownImports->currentIndex()].name) : "csv",
-						&table, &trips, &sites, &filter_presets);
+				pnr = setup_csv_params(r, params.data(), pnr);
+				jobs.push_back({ fileName, [fileName, params, pnr, csvtemplate](dive_table *t, trip_table *tr, dive_site_table *s, filter_preset_table_t *f) mutable
+						     { parse_csv_file(qPrintable(fileName), params.data(), pnr - 1, csvtemplate.constData(), t, tr, s, f); } });
 			}
 		}
 	}
 
+	QProgressDialog progress(tr("Importing dive log files..."), tr("Cancel"), 0, fileNames.size(), this);
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(500);
+	auto update = [&progress](int done) {
+		progress.setValue(done);
+		qApp->processEvents();
+		return progress.wasCanceled();
+	};
+	if (!runImportJobs(jobs, update, &table, &trips, &sites, &filter_presets))
+		return;
+
 	QString source = fileNames.size() == 1 ? fileNames[0] : tr("multiple files");
 	Command::importDives(&table, &trips, &sites, nullptr, IMPORT_MERGE_ALL_TRIPS, source);
 }
@@ -6,6 +6,7 @@
 #include <QAbstractListModel>
 #include <QListView>
 #include <QDragLeaveEvent>
+#include <QHash>
 #include <QTableView>
 #include <QAbstractTableModel>
 #include <QStyledItemDelegate>
@@ -91,6 +92,8 @@ slots:
 	int parseTxtHeader(QString fileName, char **params, int pnr);
 
 private:
+	QByteArray previewContents(const QString &fileName);
+	QHash<QString, QByteArray> previewCache;
 	bool selector;
 	QStringList fileNames;
 	Ui::DiveLogImportDialog *ui;
@@ -609,7 +609,33 @@ void PlannerSettingsWidget::setBailoutVisibility(int mode)
 		ui.sacFactor->setDisabled(mode == CCR);
 }
 
-PlannerDetails::PlannerDetails(QWidget *parent) : QWidget(parent)
+PlannerDetails::PlannerDetails(QWidget *parent) : QWidget(parent),
+	notesPending(false)
 {
 	ui.setupUi(this);
 }
+
+// Laying out the HTML is expensive and the notes change on every drag of the
+// profile. While the panel is hidden, e.g. when editing the profile of a manually
+// added dive, only keep the latest notes and show them when the panel appears.
+void PlannerDetails::setPlanNotes(const QString &notes)
+{
+	if (!isVisible()) {
+		pendingNotes = notes;
+		notesPending = true;
+		return;
+	}
+	notesPending = false;
+	pendingNotes.clear();
+	ui.divePlanOutput->setHtml(notes);
+}
+
+void PlannerDetails::showEvent(QShowEvent *event)
+{
+	QWidget::showEvent(event);
+	if (notesPending) {
+		notesPending = false;
+		ui.divePlanOutput->setHtml(pendingNotes);
+		pendingNotes.clear();
+	}
+}
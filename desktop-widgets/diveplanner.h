@@ -93,9 +93,13 @@ public:
 	QPushButton *printPlan() const { return ui.printPlan; }
 	QTextEdit *divePlanOutput() const { return ui.divePlanOutput; }
 	QLabel *divePlannerOutputLabel() const { return ui.divePlanOutputLabel; }
-
+	void setPlanNotes(const QString &notes);
+protected:
+	void showEvent(QShowEvent *event) override;
 private:
 	Ui::plannerDetails ui;
+	QString pendingNotes;
+	bool notesPending;
 };
 
 #endif // DIVEPLANNER_H
@@ -33,8 +33,17 @@ DivesiteImportDialog::DivesiteImportDialog(struct dive_site_table &imported, QSt
 	ui.importedDivesitesView->setColumnWidth(1, startingWidth * 12);
 	ui.importedDivesitesView->setColumnWidth(2, startingWidth * 8);
 	ui.importedDivesitesView->setColumnWidth(3, startingWidth * 14);
-	ui.selectAllButton->setEnabled(true);
-	ui.unselectAllButton->setEnabled(true);
+	// Wait for the nearest existing sites, which determine the selection
+	ui.importedDivesitesView->setEnabled(false);
+	ui.selectAllButton->setEnabled(false);
+	ui.unselectAllButton->setEnabled(false);
+	ui.ok->setEnabled(false);
+	connect(divesiteImportedModel, &DivesiteImportedModel::matchesReady, this, [this]() {
+		ui.importedDivesitesView->setEnabled(true);
+		ui.selectAllButton->setEnabled(true);
+		ui.unselectAllButton->setEnabled(true);
+		ui.ok->setEnabled(true);
+	});
 
 	connect(ui.importedDivesitesView, &QTableView::clicked, divesiteImportedModel, &DivesiteImportedModel::changeSelected);
 	connect(ui.selectAllButton, &QPushButton::clicked, divesiteImportedModel, &DivesiteImportedModel::selectAll);
@@ -42,8 +51,6 @@ DivesiteImportDialog::DivesiteImportDialog(struct dive_site_table &imported, QSt
 	connect(close, SIGNAL(activated()), this, SLOT(close()));
 	connect(quit, SIGNAL(activated()), parent, SLOT(close()));
 
-	ui.ok->setEnabled(true);
-
 	importedSites = imported;
 	imported.nr = imported.allocated = 0;
 	imported.dive_sites = nullptr;
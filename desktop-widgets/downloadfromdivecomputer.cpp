@@ -8,6 +8,7 @@
 #include "core/subsurface-string.h"
 #include "core/uemis.h"
 #include "core/downloadfromdcthread.h"
+#include "core/downloadstats.h"
 #include "desktop-widgets/divelistview.h"
 #include "desktop-widgets/mainwindow.h"
 #include "qt-models/diveimportedmodel.h"
@@ -215,6 +216,9 @@ void DownloadFromDCWidget::updateProgressBar()
 		}
 	}
 	ui.progressBar->setValue(lrint(progress_bar_fraction * 100));
+	struct download_stats stats;
+	download_stats_get(&stats);
+	ui.downloadStats->setText(formatDownloadStats(stats));
 	free(last_text);
 	last_text = strdup(progress_bar_text);
 }
@@ -230,6 +234,7 @@ void DownloadFromDCWidget::updateState(states state)
 		markChildrenAsEnabled();
 		timer->stop();
 		progress_bar_text = "";
+		ui.downloadStats->clear();
 #if defined(Q_OS_MAC)
 		// on mac we show the text in a label
 		ui.progressText->setText(progress_bar_text);
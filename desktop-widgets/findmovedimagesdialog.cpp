@@ -7,6 +7,7 @@
 
 #include <QFileDialog>
 #include <QtConcurrent>
+#include <QWaitCondition>
 
 FindMovedImagesDialog::FindMovedImagesDialog(QWidget *parent) : QDialog(parent)
 {
@@ -47,31 +48,26 @@ static int matchPath(const QString &path1, const QString &path2)
 	return score;
 }
 
-FindMovedImagesDialog::ImagePath::ImagePath(const QString &path) : fullPath(path),
-	filenameUpperCase(QFileInfo(path).fileName().toUpper())
+void FindMovedImagesDialog::learnImage(const QDir &dir, const QString &file, QMap<QString, ImageMatch> &matches,
+				       const QMultiHash<QString, QString> &imagePaths)
 {
-}
-
-bool FindMovedImagesDialog::ImagePath::operator<(const ImagePath &path2) const
-{
-	return filenameUpperCase < path2.filenameUpperCase;
-}
+	// Most files of a photo archive don't match any picture. Find that out
+	// with a single lookup before doing anything expensive.
+	QString key = file.toUpper();
+	auto it = imagePaths.find(key);
+	if (it == imagePaths.end())
+		return;
 
-void FindMovedImagesDialog::learnImage(const QString &filename, QMap<QString, ImageMatch> &matches, const QVector<ImagePath> &imagePaths)
-{
 	QStringList newMatches;
 	int bestScore = 1;
-	// Find matching file paths by a binary search of the file name
-	ImagePath path(filename);
-	for (auto it = std::lower_bound(imagePaths.begin(), imagePaths.end(), path);
-	     it != imagePaths.end() && it->filenameUpperCase == path.filenameUpperCase;
-	     ++it) {
-		int score = matchPath(filename, it->fullPath);
+	QString filename = dir.absoluteFilePath(file);
+	for (; it != imagePaths.end() && it.key() == key; ++it) {
+		int score = matchPath(filename, *it);
 		if (score < bestScore)
 			continue;
 		if (score > bestScore)
 			newMatches.clear();
-		newMatches.append(it->fullPath);
+		newMatches.append(*it);
 		bestScore = score;
 	}
 
@@ -85,69 +81,102 @@ void FindMovedImagesDialog::learnImage(const QString &filename, QMap<QString, Im
 	}
 }
 
-// We use a stack to recurse into directories. Each level of the stack is made up of
-// a list of subdirectories to process. For each directory we keep track of the progress
-// that is done when processing this directory. In principle the from value is redundant
-// (it could be extracted from previous stack entries, but it makes code simpler.
+// The directories still to be scanned. Each directory gets a share of the total progress,
+// which is split among its subdirectories. The progress of a directory without (scanned)
+// subdirectories is done once it is scanned.
 struct Dir {
 	QString path;
-	double progressFrom, progressTo;
+	int depth;
+	double progress;
 };
 
 QVector<FindMovedImagesDialog::Match> FindMovedImagesDialog::learnImages(const QString &rootdir, int maxRecursions, QVector<QString> imagePathsIn)
 {
-	QMap<QString, ImageMatch> matches;
-
 	// For divelogs with thousands of images, we don't want to compare the path of every image.
-	// Therefore, keep an array of image paths sorted by the filename in upper case.
-	// Thus, we can access all paths ending in the same filename by a binary search. We suppose that
+	// Therefore, index the image paths by the filename in upper case. We suppose that
 	// there aren't many pictures with the same filename but different paths.
-	QVector<ImagePath> imagePaths;
+	QMultiHash<QString, QString> imagePaths;
 	imagePaths.reserve(imagePathsIn.size());
 	for (const QString &path: imagePathsIn)
-		imagePaths.append(ImagePath(path));	// No emplace() in QVector? Sheesh.
-	std::sort(imagePaths.begin(), imagePaths.end());
+		imagePaths.insert(QFileInfo(path).fileName().toUpper(), path);
 
 	// Free memory of original path vector - we don't need it any more
 	imagePathsIn.clear();
 
-	QVector<QVector<Dir>> stack; // Use a stack to recurse into directories
-	stack.reserve(maxRecursions + 1);
-	stack.append({ { rootdir, 0.0, 1.0 } });
-	while (!stack.isEmpty()) {
-		if (stack.last().isEmpty()) {
-			stack.removeLast();
-			continue;
-		}
-		Dir entry = stack.last().takeLast();
-		QDir dir(entry.path);
+	// Listing the directories is the bottleneck, therefore scan them with multiple threads.
+	// The threads take directories from a common list and add the subdirectories they find.
+	// The scan is finished when the list is empty and no thread is busy listing a directory.
+	struct Scan {
+		FindMovedImagesDialog *dialog;
+		const QMultiHash<QString, QString> *imagePaths;
+		int maxRecursions;
+		QMutex lock;
+		QWaitCondition changed;
+		QVector<Dir> todo;
+		int busy;
+		double done;
+		QMap<QString, ImageMatch> matches;
+	} scan;
+	scan.dialog = this;
+	scan.imagePaths = &imagePaths;
+	scan.maxRecursions = maxRecursions;
+	scan.todo.append({ rootdir, 0, 1.0 });
+	scan.busy = 0;
+	scan.done = 0.0;
 
-		// Since we're running in a different thread, use invokeMethod to set progress.
-		QMetaObject::invokeMethod(this, "setProgress", Q_ARG(double, entry.progressFrom), Q_ARG(QString, dir.absolutePath()));
+	run_in_parallel(qMax(QThread::idealThreadCount(), 1), [](int, void *data) {
+		Scan &scan = *(Scan *)data;
+		FindMovedImagesDialog *dialog = scan.dialog;
+		QMap<QString, ImageMatch> matches;
+		QMutexLocker l(&scan.lock);
+		for (;;) {
+			while (scan.todo.isEmpty() && scan.busy > 0 && dialog->stopScanning == 0)
+				scan.changed.wait(&scan.lock);
+			if (scan.todo.isEmpty() || dialog->stopScanning != 0)
+				break;
+			Dir entry = scan.todo.takeLast();
+			double done = scan.done;
+			++scan.busy;
+			l.unlock();
 
-		for (const QString &file: dir.entryList(QDir::Files)) {
-			if (stopScanning != 0)
-				goto out;
-			learnImage(dir.absoluteFilePath(file), matches, imagePaths);
-		}
-		if (stack.size() <= maxRecursions) {
-			stack.append(QVector<Dir>());
-			QVector<Dir> &newItem = stack.last();
-			for (const QString &dirname: dir.entryList(QDir::NoDotAndDotDot | QDir::Dirs))
-				stack.last().append({ dir.filePath(dirname), 0.0, 0.0 });
-			int num = newItem.size();
-			double diff = entry.progressTo - entry.progressFrom;
-			// We pop from back therefore we fill the progress in reverse
-			for (int i = 0; i < num; ++i) {
-				newItem[num - i - 1].progressFrom = (i / (double)num) * diff + entry.progressFrom;
-				newItem[num - i - 1].progressTo = ((i + 1) / (double)num) * diff + entry.progressFrom;
+			QDir dir(entry.path);
+			// Since we're running in a different thread, use invokeMethod to set progress.
+			QMetaObject::invokeMethod(dialog, "setProgress", Q_ARG(double, done), Q_ARG(QString, dir.absolutePath()));
+			for (const QString &file: dir.entryList(QDir::Files)) {
+				if (dialog->stopScanning != 0)
+					break;
+				dialog->learnImage(dir, file, matches, *scan.imagePaths);
 			}
+			QVector<Dir> subdirs;
+			if (entry.depth < scan.maxRecursions) {
+				QStringList dirnames = dir.entryList(QDir::NoDotAndDotDot | QDir::Dirs);
+				for (const QString &dirname: dirnames)
+					subdirs.append({ dir.filePath(dirname), entry.depth + 1, entry.progress / dirnames.size() });
+			}
+
+			l.relock();
+			--scan.busy;
+			if (subdirs.isEmpty())
+				scan.done += entry.progress;
+			else
+				scan.todo.append(subdirs);
+			scan.changed.wakeAll();
 		}
-	}
-out:
+
+		// Merge with the matches of the other threads, keeping the best score
+		for (auto it = matches.begin(); it != matches.end(); ++it) {
+			auto it2 = scan.matches.find(it.key());
+			if (it2 == scan.matches.end())
+				scan.matches.insert(it.key(), *it);
+			else if (it2->score < it->score)
+				*it2 = *it;
+		}
+		scan.changed.wakeAll();
+	}, &scan);
+
 	QMetaObject::invokeMethod(this, "setProgress", Q_ARG(double, 1.0), Q_ARG(QString, QString()));
 	QVector<FindMovedImagesDialog::Match> ret;
-	for (auto it = matches.begin(); it != matches.end(); ++it)
+	for (auto it = scan.matches.begin(); it != scan.matches.end(); ++it)
 		ret.append({ it.key(), it->localFilename, it->score });
 	return ret;
 }
@@ -3,9 +3,11 @@
 #define FINDMOVEDIMAGES_H
 
 #include "ui_findmovedimagesdialog.h"
+#include <QDir>
 #include <QFutureWatcher>
 #include <QVector>
 #include <QMap>
+#include <QMultiHash>
 #include <QAtomicInteger>
 
 class FindMovedImagesDialog : public QDialog {
@@ -29,20 +31,15 @@ private:
 		QString localFilename;
 		int score;
 	};
-	struct ImagePath {
-		QString fullPath;
-		QString	filenameUpperCase;
-		ImagePath() = default;		// For some reason QVector<...>::reserve() needs a default constructor!?
-		ImagePath(const QString &path);
-		inline bool operator<(const ImagePath &path2) const;
-	};
 	Ui::FindMovedImagesDialog ui;
 	QFutureWatcher<QVector<Match>> watcher;
 	QVector<Match> matches;
 	QAtomicInt stopScanning;
 	QScopedPointer<QFontMetrics> fontMetrics;		// Needed to format elided paths
 
-	void learnImage(const QString &filename, QMap<QString, ImageMatch> &matches, const QVector<ImagePath> &imagePaths);
+	// Key of the image paths is the filename in upper case
+	void learnImage(const QDir &dir, const QString &file, QMap<QString, ImageMatch> &matches,
+			const QMultiHash<QString, QString> &imagePaths);
 	QVector<Match> learnImages(const QString &dir, int maxRecursions, QVector<QString> imagePaths);
 };
 
@@ -29,6 +29,14 @@ ImportGPS::ImportGPS(QWidget *parent, QString fileName, class Ui::LocationInform
 	pixmapSize = (int) (ui.diveDateLabel->height() / 2);
 }
 
+int ImportGPS::readGPXFile()
+{
+	if (getTrackFromGPXFile(track, fileName))
+		return 1;
+	getCoordsFromTrack(&coords, track);
+	return 0;
+}
+
 void ImportGPS::buttonClicked(QAbstractButton *button)
 {
 	if (ui.GPSbuttonBox->buttonRole(button) == QDialogButtonBox::AcceptRole) {
@@ -109,7 +117,7 @@ void  ImportGPS::updateUI()
 void ImportGPS::changeZoneForward()
 {
 	coords.timeZone_offset = abs(coords.timeZone_offset);
-	getCoordsFromGPXFile(&coords, fileName); // If any of the time controls are changed
+	getCoordsFromTrack(&coords, track); // If any of the time controls are changed
 	updateUI();          // .. then recalculate the synchronisation
 }
 
@@ -117,14 +125,14 @@ void ImportGPS::changeZoneBackwards()
 {
 	if (coords.timeZone_offset > 0)
 		coords.timeZone_offset = 0 - coords.timeZone_offset;
-	getCoordsFromGPXFile(&coords, fileName);
+	getCoordsFromTrack(&coords, track);
 	updateUI();
 }
 
 void ImportGPS::changeDiffForward()
 {
 	coords.settingsDiff_offset = abs(coords.settingsDiff_offset);
-	getCoordsFromGPXFile(&coords, fileName);
+	getCoordsFromTrack(&coords, track);
 	updateUI();
 }
 
@@ -132,7 +140,7 @@ void ImportGPS::changeDiffBackwards()
 {
 	if (coords.settingsDiff_offset > 0)
 		coords.settingsDiff_offset = 0 - coords.settingsDiff_offset;
-	getCoordsFromGPXFile(&coords, fileName);
+	getCoordsFromTrack(&coords, track);
 	updateUI();
 }
 
@@ -141,7 +149,7 @@ void  ImportGPS::timeDiffEditChanged()
 	coords.settingsDiff_offset = ui.timeDiffEdit->time().hour() * 3600 + ui.timeDiffEdit->time().minute() * 60;
 	if (ui.diff_backwards->isChecked())
 		coords.settingsDiff_offset = 0 - coords.settingsDiff_offset;
-	getCoordsFromGPXFile(&coords, fileName);
+	getCoordsFromTrack(&coords, track);
 	updateUI();
 }
 
@@ -150,6 +158,6 @@ void  ImportGPS::timeZoneEditChanged()
 	coords.timeZone_offset = ui.timeZoneEdit->time().hour() * 3600;
 	if (ui.timezone_backwards->isChecked())
 		coords.timeZone_offset = 0 - coords.timeZone_offset;
-	getCoordsFromGPXFile(&coords, fileName);
+	getCoordsFromTrack(&coords, track);
 	updateUI();
 }
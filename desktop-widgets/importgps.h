@@ -14,6 +14,8 @@ public:
 	Ui::ImportGPS ui;
 	explicit ImportGPS(QWidget *parent, QString fileName, class Ui::LocationInformation *LocationUI);
 	struct dive_coords coords;
+	// Read the track of the GPX file and find the coordinates of the dive. Returns 1 on error.
+	int readGPXFile();
 	void updateUI();
 
 private
@@ -28,6 +30,7 @@ slots:
 
 private:
 	QString fileName;
+	std::vector<gpx_trackpoint> track;	// Read once, searched again if the time offsets change
 	class Ui::LocationInformation *LocationUI;
 	int pixmapSize;
 };
@@ -20,6 +20,8 @@
 #include <QItemSelectionModel>
 #include <qmessagebox.h>
 #include <cstdlib>
+#include <climits>
+#include <vector>
 #include <QDesktopWidget>
 #include <QFileDialog>
 #include <QScrollBar>
@@ -259,7 +261,7 @@ void LocationInformationWidget::on_GPSbutton_clicked()
 	ImportGPS GPSDialog(this, fileName, &ui); // Create a GPS import QDialog
 	GPSDialog.coords.start_dive = current_dive->when; // initialise
 	GPSDialog.coords.end_dive = dive_endtime(current_dive);
-	if (getCoordsFromGPXFile(&GPSDialog.coords, fileName) == 0) { // Get coordinates from GPS file
+	if (GPSDialog.readGPXFile() == 0) { // Get coordinates from GPS file
 		GPSDialog.updateUI();         // If successful, put results in Dialog
 		if (!GPSDialog.exec())        // and show QDialog
 			return;
@@ -340,6 +342,16 @@ void DiveLocationFilterProxyModel::setFilter(const QString &filterIn)
 void DiveLocationFilterProxyModel::setCurrentLocation(location_t loc)
 {
 	currentLocation = loc;
+	distanceRank.clear();
+	if (has_location(&currentLocation)) {
+		struct dive_site_gps_index index;
+		build_dive_site_gps_index(&index, &dive_site_table);
+		std::vector<dive_site *> nearest(index.nr);
+		int n = get_nearest_dive_sites_indexed(&currentLocation, index.nr, &index, nearest.data());
+		for (int i = 0; i < n; ++i)
+			distanceRank.insert(nearest[i], i);
+		free_dive_site_gps_index(&index);
+	}
 	sort(LocationInformationModel::NAME);
 }
 
@@ -368,6 +380,11 @@ bool DiveLocationFilterProxyModel::lessThan(const QModelIndex &source_left, cons
 		// The dive sites are -2 because of the first two items.
 		struct dive_site *ds1 = get_dive_site(source_left.row() - 2, &dive_site_table);
 		struct dive_site *ds2 = get_dive_site(source_right.row() - 2, &dive_site_table);
+		// Sites without a GPS location or added after the ranking come last
+		int rank1 = distanceRank.value(ds1, INT_MAX);
+		int rank2 = distanceRank.value(ds2, INT_MAX);
+		if (rank1 != rank2)
+			return rank1 < rank2;
 		return get_distance(&ds1->location, &currentLocation) < get_distance(&ds2->location, &currentLocation);
 	}
 	return source_left.data().toString().compare(source_right.data().toString(), Qt::CaseInsensitive) < 0;
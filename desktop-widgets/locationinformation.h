@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include <QAbstractListModel>
 #include <QSortFilterProxyModel>
+#include <QHash>
 
 struct dive_site;
 
@@ -60,6 +61,9 @@ public:
 	void setCurrentLocation(location_t loc);
 private:
 	location_t currentLocation; // Sort by distance to that location
+	// Position of the dive sites with a GPS location, ordered by distance to currentLocation.
+	// Calculated once per location, so that filtering on every keystroke doesn't recompute the distances.
+	QHash<const dive_site *, int> distanceRank;
 };
 
 class DiveLocationModel : public QAbstractTableModel {
@@ -23,7 +23,9 @@
 #include "core/file.h"
 #include "core/gettextfromc.h"
 #include "core/git-access.h"
+#include "core/gitmaintenance.h"
 #include "core/import-csv.h"
+#include "core/importfiles.h"
 #include "core/planner.h"
 #include "core/qthelper.h"
 #include "core/subsurface-string.h"
@@ -642,6 +644,7 @@ void MainWindow::closeCurrentFile()
 {
 	/* free the dives and trips */
 	clear_git_id();
+	Command::clear(); // the undo commands may refer to data of the current file
 	clear_dive_file_data(); // this clears all the core data structures and resets the models
 	setCurrentFile(nullptr);
 	diveList->setSortOrder(DiveTripModelBase::NR, Qt::DescendingOrder);
@@ -794,7 +797,7 @@ void MainWindow::planCreated()
 
 void MainWindow::setPlanNotes(QString plan)
 {
-	plannerDetails->divePlanOutput()->setHtml(plan);
+	plannerDetails->setPlanNotes(plan);
 }
 
 void MainWindow::printPlan()
@@ -1301,6 +1304,19 @@ void MainWindow::writeSettings()
 	settings.endGroup();
 }
 
+// Repack the local cache of a remote logbook on shutdown, when nobody accesses it anymore
+static void maintainLocalCache()
+{
+	const char *branch = nullptr, *remote = nullptr;
+
+	if (!existing_filename || !is_git_repository(existing_filename, &branch, &remote, true) || !remote)
+		return;
+	if (strstr(remote, "://"))
+		maintain_local_cache(remote, branch, 3000);
+	free((void *)remote);
+	free((void *)branch);
+}
+
 void MainWindow::closeEvent(QCloseEvent *event)
 {
 	if (DivePlannerPointsModel::instance()->currentMode() != DivePlannerPointsModel::NOTHING ||
@@ -1316,6 +1332,7 @@ void MainWindow::closeEvent(QCloseEvent *event)
 	}
 	event->accept();
 	writeSettings();
+	maintainLocalCache();
 	QApplication::closeAllWindows();
 }
 
@@ -1545,16 +1562,29 @@ void MainWindow::importFiles(const QStringList fileNames)
 	if (fileNames.isEmpty())
 		return;
 
-	QByteArray fileNamePtr;
 	struct dive_table table = empty_dive_table;
 	struct trip_table trips = empty_trip_table;
 	struct dive_site_table sites = empty_dive_site_table;
 	filter_preset_table_t filter_presets;
+	std::vector<ImportJob> jobs;
 
-	for (int i = 0; i < fileNames.size(); ++i) {
-		fileNamePtr = QFile::encodeName(fileNames.at(i));
-		parse_file(fileNamePtr.data(), &table, &trips, &sites, &filter_presets);
+	for (const QString &fn: fileNames) {
+		QByteArray fileNamePtr = QFile::encodeName(fn);
+		jobs.push_back({ fn, [fileNamePtr](dive_table *t, trip_table *tr, dive_site_table *s, filter_preset_table_t *f)
+				     { parse_file(fileNamePtr.data(), t, tr, s, f); } });
 	}
+
+	QProgressDialog progress(tr("Importing dive log files..."), tr("Cancel"), 0, fileNames.size(), this);
+	progress.setWindowModality(Qt::WindowModal);
+	progress.setMinimumDuration(500);
+	auto update = [&progress](int done) {
+		progress.setValue(done);
+		qApp->processEvents();
+		return progress.wasCanceled();
+	};
+	if (!runImportJobs(jobs, update, &table, &trips, &sites, &filter_presets))
+		return;
+
 	QString source = fileNames.size() == 1 ? fileNames[0] : tr("multiple files");
 	Command::importDives(&table, &trips, &sites, &filter_presets, IMPORT_MERGE_ALL_TRIPS, source);
 }
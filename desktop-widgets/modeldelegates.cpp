@@ -28,6 +28,8 @@
 #include <QLineEdit>
 #include <QAbstractItemView>
 #include <QSpinBox>
+#include <QPainter>
+#include <algorithm>
 
 QSize DiveListDelegate::sizeHint(const QStyleOptionViewItem &, const QModelIndex &) const
 {
@@ -35,19 +37,95 @@ QSize DiveListDelegate::sizeHint(const QStyleOptionViewItem &, const QModelIndex
 	return QSize(50, qMax(22, metrics.height()));
 }
 
+// Paint only the background of a cell, i.e. the selection and hover state, but no data
+static void paintEmptyCell(QPainter *painter, const QStyleOptionViewItem &option)
+{
+	const QWidget *widget = option.widget;
+	QStyle *style = widget ? widget->style() : QApplication::style();
+	style->drawPrimitive(QStyle::PE_PanelItemViewItem, &option, painter, widget);
+}
+
+// The columns with long texts or icons, which are costly to lay out
+static bool isExpensiveColumn(int column)
+{
+	switch (column) {
+	case DiveTripModelBase::SUIT:
+	case DiveTripModelBase::CYLINDER:
+	case DiveTripModelBase::GAS:
+	case DiveTripModelBase::TAGS:
+	case DiveTripModelBase::PHOTOS:
+	case DiveTripModelBase::COUNTRY:
+	case DiveTripModelBase::BUDDIES:
+	case DiveTripModelBase::LOCATION:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void DiveListDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
+{
+	if (fastScroll && isExpensiveColumn(index.column()))
+		paintEmptyCell(painter, option);
+	else
+		QStyledItemDelegate::paint(painter, option, index);
+}
+
+void DiveListDelegate::setFastScroll(bool fast)
+{
+	fastScroll = fast;
+}
+
 // Gets the index of the model in the currentRow and column.
 // currCombo is defined below.
 #define IDX(_XX) mymodel->index(currCombo.currRow, (_XX))
 
 StarWidgetsDelegate::StarWidgetsDelegate(QWidget *parent) : QStyledItemDelegate(parent),
-	parentWidget(parent)
+	parentWidget(parent),
+	fastScroll(false),
+	starPixmapsDpr(0.0)
 {
 	const IconMetrics &metrics = defaultIconMetrics();
 	minStarSize = QSize(metrics.sz_small * TOTALSTARS + metrics.spacing * (TOTALSTARS - 1), metrics.sz_small);
 }
 
+void StarWidgetsDelegate::setFastScroll(bool fast)
+{
+	fastScroll = fast;
+}
+
+// Render the whole row of stars once per rating instead of painting each star of each cell
+const QPixmap &StarWidgetsDelegate::starsPixmap(int rating, qreal dpr) const
+{
+	if (starPixmaps.empty() || dpr != starPixmapsDpr) {
+		const QImage &active = StarWidget::starActive();
+		const QImage &inactive = StarWidget::starInactive();
+		const IconMetrics &metrics = defaultIconMetrics();
+		QSize size(metrics.spacing + (TOTALSTARS - 1) * metrics.sz_small + active.width(), active.height());
+
+		starPixmaps.clear();
+		for (int r = 0; r <= TOTALSTARS; r++) {
+			QPixmap pixmap(size * dpr);
+			pixmap.setDevicePixelRatio(dpr);
+			pixmap.fill(Qt::transparent);
+			QPainter painter(&pixmap);
+			painter.setRenderHint(QPainter::Antialiasing, true);
+			for (int i = 0; i < TOTALSTARS; i++)
+				painter.drawImage(i * metrics.sz_small + metrics.spacing, 0, i < r ? active : inactive);
+			painter.end();
+			starPixmaps.push_back(pixmap);
+		}
+		starPixmapsDpr = dpr;
+	}
+	return starPixmaps[std::max(0, std::min(rating, (int)TOTALSTARS))];
+}
+
 void StarWidgetsDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
 {
+	if (fastScroll) {
+		paintEmptyCell(painter, option);
+		return;
+	}
 	QStyledItemDelegate::paint(painter, option, index);
 	if (!index.isValid())
 		return;
@@ -56,19 +134,9 @@ void StarWidgetsDelegate::paint(QPainter *painter, const QStyleOptionViewItem &o
 	if (!value.isValid())
 		return;
 
-	int rating = value.toInt();
+	const QPixmap &stars = starsPixmap(value.toInt(), painter->device()->devicePixelRatioF());
 	int deltaY = option.rect.height() / 2 - StarWidget::starActive().height() / 2;
-	painter->save();
-	painter->setRenderHint(QPainter::Antialiasing, true);
-	const QPixmap active = QPixmap::fromImage(StarWidget::starActive());
-	const QPixmap inactive = QPixmap::fromImage(StarWidget::starInactive());
-	const IconMetrics &metrics = defaultIconMetrics();
-
-	for (int i = 0; i < rating; i++)
-		painter->drawPixmap(option.rect.x() + i * metrics.sz_small + metrics.spacing, option.rect.y() + deltaY, active);
-	for (int i = rating; i < TOTALSTARS; i++)
-		painter->drawPixmap(option.rect.x() + i * metrics.sz_small + metrics.spacing, option.rect.y() + deltaY, inactive);
-	painter->restore();
+	painter->drawPixmap(option.rect.x(), option.rect.y() + deltaY, stars);
 }
 
 QSize StarWidgetsDelegate::sizeHint(const QStyleOptionViewItem &, const QModelIndex &) const
@@ -6,15 +6,22 @@
 
 #include <QStyledItemDelegate>
 #include <QComboBox>
+#include <QPixmap>
+#include <vector>
 class QPainter;
 
 class DiveListDelegate : public QStyledItemDelegate {
 public:
 	explicit DiveListDelegate(QObject *parent = 0)
-	    : QStyledItemDelegate(parent)
+	    : QStyledItemDelegate(parent), fastScroll(false)
 	{
 	}
 	QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const;
+	void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+	// While set, the text and icon columns are painted empty
+	void setFastScroll(bool fast);
+private:
+	bool fastScroll;
 };
 
 class StarWidgetsDelegate : public QStyledItemDelegate {
@@ -22,12 +29,19 @@ class StarWidgetsDelegate : public QStyledItemDelegate {
 public:
 	explicit StarWidgetsDelegate(QWidget *parent = 0);
 	const QSize &starSize() const;
+	// While set, the stars are not painted
+	void setFastScroll(bool fast);
 
 private:
 	void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const override;
 	QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
+	const QPixmap &starsPixmap(int rating, qreal dpr) const;
 	QWidget *parentWidget;
 	QSize minStarSize;
+	bool fastScroll;
+	// The row of stars for each rating, rendered for the device pixel ratio starPixmapsDpr
+	mutable std::vector<QPixmap> starPixmaps;
+	mutable qreal starPixmapsDpr;
 };
 
 class ComboBoxDelegate : public QStyledItemDelegate {
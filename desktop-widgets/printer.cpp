@@ -45,16 +45,7 @@ void Printer::putProfileImage(QRect profilePlaceholder, QRect viewPort, QPainter
 		imgPainter.end();
 
 		// convert QImage to grayscale before rendering
-		for (int i = 0; i < image.height(); i++) {
-			QRgb *pixel = reinterpret_cast<QRgb *>(image.scanLine(i));
-			QRgb *end = pixel + image.width();
-			for (; pixel != end; pixel++) {
-				int gray_val = qGray(*pixel);
-				*pixel = QColor(gray_val, gray_val, gray_val).rgb();
-			}
-		}
-
-		painter->drawImage(pos, image);
+		painter->drawImage(pos, image.convertToFormat(QImage::Format_Grayscale8));
 	} else {
 		profile->render(painter, pos);
 	}
@@ -287,13 +287,25 @@ ShiftImageTimesDialog::ShiftImageTimesDialog(QWidget *parent, QStringList fileNa
 	dcImageEpoch = (time_t)0;
 
 	// Get times of all files. 0 means that the time couldn't be determined.
+	// The other metadata are kept for adding the pictures.
 	int numFiles = fileNames.size();
-	timestamps.resize(numFiles);
-	for (int i = 0; i < numFiles; ++i)
-		timestamps[i] = picture_get_timestamp(qPrintable(fileNames[i]));
+	QVector<QByteArray> encodedNames;
+	std::vector<const char *> names;
+	encodedNames.reserve(numFiles);
+	for (const QString &fileName: fileNames) {
+		encodedNames.push_back(fileName.toUtf8());
+		names.push_back(encodedNames.back().constData());
+	}
+	filesMetadata.resize(numFiles);
+	get_metadata_of_files(numFiles, names.data(), filesMetadata.data());
 	updateInvalid();
 }
 
+const QVector<metadata> &ShiftImageTimesDialog::fileMetadata() const
+{
+	return filesMetadata;
+}
+
 time_t ShiftImageTimesDialog::amount() const
 {
 	return m_amount;
@@ -327,12 +339,12 @@ void ShiftImageTimesDialog::updateInvalid()
 
 	int numFiles = fileNames.size();
 	for (int i = 0; i < numFiles; ++i) {
-		if (picture_check_valid_time(timestamps[i], m_amount))
+		if (picture_check_valid_time(filesMetadata[i].timestamp, m_amount))
 			continue;
 
 		// We've found an invalid image
-		time_first.setTime_t(timestamps[i] + m_amount);
-		if (timestamps[i] == 0)
+		time_first.setTime_t(filesMetadata[i].timestamp + m_amount);
+		if (filesMetadata[i].timestamp == 0)
 			ui.invalidFilesText->append(fileNames[i] + " - " + tr("No Exif date/time found"));
 		else
 			ui.invalidFilesText->append(fileNames[i] + " - " + time_first.toString());
@@ -13,6 +13,8 @@ class FilterModelBase;
 #include <QTextEdit>
 #include <stdint.h>
 
+#include "core/metadata.h"
+
 #include "ui_renumber.h"
 #include "ui_setpoint.h"
 #include "ui_shifttimes.h"
@@ -94,6 +96,8 @@ class ShiftImageTimesDialog : public QDialog {
 	Q_OBJECT
 public:
 	explicit ShiftImageTimesDialog(QWidget *parent, QStringList fileNames);
+	// The metadata of the files, in the order of fileNames
+	const QVector<metadata> &fileMetadata() const;
 	time_t amount() const;
 	void setOffset(time_t offset);
 	bool matchAll();
@@ -109,7 +113,7 @@ slots:
 
 private:
 	QStringList fileNames;
-	QVector<timestamp_t> timestamps;
+	QVector<metadata> filesMetadata;
 	Ui::ShiftImageTimesDialog ui;
 	time_t m_amount;
 	time_t dcImageEpoch;
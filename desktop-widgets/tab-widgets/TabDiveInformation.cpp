@@ -13,17 +13,34 @@
 #include "core/display.h"
 #include "core/divelist.h"
 
+#include <QSignalBlocker>
+
 #define COMBO_CHANGED 0
 #define TEXT_EDITED 1
 #define CSS_SET_HEADING_BLUE "QLabel { color: mediumblue;} "
 
-TabDiveInformation::TabDiveInformation(QWidget *parent) : TabBase(parent), ui(new Ui::TabDiveInformation())
+static const int updateDelay = 50; // in ms
+static const int gasUseCacheSize = 256;
+
+TabDiveInformation::TabDiveInformation(QWidget *parent) : TabBase(parent), ui(new Ui::TabDiveInformation()),
+	dirty(false)
 {
 	ui->setupUi(this);
+	updateTimer.setSingleShot(true);
+	updateTimer.setInterval(updateDelay);
+	connect(&updateTimer, &QTimer::timeout, this, &TabDiveInformation::updateNow);
 	connect(&diveListNotifier, &DiveListNotifier::divesChanged, this, &TabDiveInformation::divesChanged);
 	connect(&diveListNotifier, &DiveListNotifier::cylinderAdded, this, &TabDiveInformation::cylinderChanged);
 	connect(&diveListNotifier, &DiveListNotifier::cylinderRemoved, this, &TabDiveInformation::cylinderChanged);
 	connect(&diveListNotifier, &DiveListNotifier::cylinderEdited, this, &TabDiveInformation::cylinderChanged);
+	connect(&diveListNotifier, &DiveListNotifier::cylindersReset, this, [this](const QVector<dive *> &dives)
+		{ for (dive *d: dives) cylinderChanged(d); });
+	connect(&diveListNotifier, &DiveListNotifier::eventsChanged, this, &TabDiveInformation::invalidateGasUseOfDive);
+	connect(&diveListNotifier, &DiveListNotifier::divesAdded, this, [this](dive_trip *, bool, const QVector<dive *> &dives)
+		{ invalidateGasUse(dives); });
+	connect(&diveListNotifier, &DiveListNotifier::divesDeleted, this, [this](dive_trip *, bool, const QVector<dive *> &dives)
+		{ invalidateGasUse(dives); });
+	connect(&diveListNotifier, &DiveListNotifier::dataReset, this, [this]() { gasUseCache.clear(); });
 	QStringList atmPressTypes { "mbar", get_depth_unit() ,tr("Use DC")};
 	ui->atmPressType->insertItems(0, atmPressTypes);
 	pressTypeIndex = 0;
@@ -72,6 +89,8 @@ TabDiveInformation::~TabDiveInformation()
 
 void TabDiveInformation::clear()
 {
+	updateTimer.stop();
+	dirty = false;
 	ui->sacText->clear();
 	ui->otuText->clear();
 	ui->maxcnsText->clear();
@@ -116,6 +135,51 @@ void TabDiveInformation::updateWaterTypeWidget()
 	}
 }
 
+// The gas use is kept in ml, not as strings, so that a change of units
+// doesn't need an invalidation.
+const TabDiveInformation::GasUse &TabDiveInformation::getGasUse(struct dive *d)
+{
+	QPair<int, int> key(d->id, dc_number);
+	auto it = gasUseCache.find(key);
+	if (it != gasUseCache.end())
+		return *it;
+
+	if (gasUseCache.size() >= gasUseCacheSize)
+		gasUseCache.clear();
+
+	GasUse res;
+	volume_t *gases = get_gas_used(d);
+	std::vector<int> mean(d->cylinders.nr), duration(d->cylinders.nr);
+	if (d->cylinders.nr >= 0)
+		per_cylinder_mean_depth(d, select_dc(d), mean.data(), duration.data());
+	res.used.resize(d->cylinders.nr);
+	res.sac.resize(d->cylinders.nr);
+	for (int i = 0; i < d->cylinders.nr; i++) {
+		res.used[i] = gases[i].mliter;
+		res.sac[i] = gases[i].mliter && duration[i] ?
+			lrint(gases[i].mliter / (depth_to_atm(mean[i], d) * duration[i] / 60)) : 0;
+	}
+	res.firstMeanDepth = d->cylinders.nr > 0 && mean[0];
+	free(gases);
+	return *gasUseCache.insert(key, res);
+}
+
+void TabDiveInformation::invalidateGasUseOfDive(dive *d)
+{
+	for (auto it = gasUseCache.begin(); it != gasUseCache.end(); ) {
+		if (it.key().first == d->id)
+			it = gasUseCache.erase(it);
+		else
+			++it;
+	}
+}
+
+void TabDiveInformation::invalidateGasUse(const QVector<dive *> &dives)
+{
+	for (dive *d: dives)
+		invalidateGasUseOfDive(d);
+}
+
 // Update fields that depend on the dive profile
 void TabDiveInformation::updateProfile()
 {
@@ -124,37 +188,30 @@ void TabDiveInformation::updateProfile()
 	ui->maximumDepthText->setText(get_depth_string(current_dive->maxdepth, true));
 	ui->averageDepthText->setText(get_depth_string(current_dive->meandepth, true));
 
-	volume_t *gases = get_gas_used(current_dive);
+	const GasUse &gasUse = getGasUse(current_dive);
 	QString volumes;
-	std::vector<int> mean(current_dive->cylinders.nr), duration(current_dive->cylinders.nr);
-	if (current_dive->cylinders.nr >= 0)
-		per_cylinder_mean_depth(current_dive, select_dc(current_dive), mean.data(), duration.data());
-	volume_t sac;
 	QString gaslist, SACs, separator;
 
-	for (int i = 0; i < current_dive->cylinders.nr; i++) {
+	for (int i = 0; i < current_dive->cylinders.nr && i < (int)gasUse.used.size(); i++) {
 		if (!is_cylinder_used(current_dive, i))
 			continue;
 		gaslist.append(separator); volumes.append(separator); SACs.append(separator);
 		separator = "\n";
 
 		gaslist.append(gasname(get_cylinder(current_dive, i)->gasmix));
-		if (!gases[i].mliter)
+		if (!gasUse.used[i])
 			continue;
-		volumes.append(get_volume_string(gases[i], true));
-		if (duration[i]) {
-			sac.mliter = lrint(gases[i].mliter / (depth_to_atm(mean[i], current_dive) * duration[i] / 60));
-			SACs.append(get_volume_string(sac, true).append(tr("/min")));
-		}
+		volumes.append(get_volume_string(volume_t { gasUse.used[i] }, true));
+		if (gasUse.sac[i])
+			SACs.append(get_volume_string(volume_t { gasUse.sac[i] }, true).append(tr("/min")));
 	}
-	free(gases);
 	ui->gasUsedText->setText(volumes);
 	ui->oxygenHeliumText->setText(gaslist);
 
 	ui->diveTimeText->setText(get_dive_duration_string(current_dive->duration.seconds, tr("h"), tr("min"), tr("sec"),
 			" ", current_dive->dc.divemode == FREEDIVE));
 
-	ui->sacText->setText(current_dive->cylinders.nr > 0 && mean[0] ? SACs : QString());
+	ui->sacText->setText(gasUse.firstMeanDepth ? SACs : QString());
 
 	if (current_dive->surface_pressure.mbar == 0) {
 		ui->atmPressVal->clear();			// If no atm pressure for dive then clear text box
@@ -219,6 +276,27 @@ void TabDiveInformation::updateData()
 		return;
 	}
 
+	dirty = true;
+	if (isVisible())
+		updateTimer.start();
+}
+
+void TabDiveInformation::showEvent(QShowEvent *event)
+{
+	TabBase::showEvent(event);
+	if (dirty)
+		updateNow();
+}
+
+void TabDiveInformation::updateNow()
+{
+	updateTimer.stop();
+	dirty = false;
+	if (!current_dive) {
+		clear();
+		return;
+	}
+
 	int salinity_value;
 	manualDive = same_string(current_dive->dc.model, "manually added dive");
 	updateWaterTypeWidget();
@@ -243,12 +321,18 @@ void TabDiveInformation::updateData()
 	}
 	checkDcSalinityOverWritten();  // If exclamation is needed (i.e. salinity overwrite by user), then show it
 
-	updateMode(current_dive);
-	ui->visibility->setCurrentStars(current_dive->visibility);
-	ui->wavesize->setCurrentStars(current_dive->wavesize);
-	ui->current->setCurrentStars(current_dive->current);
-	ui->surge->setCurrentStars(current_dive->surge);
-	ui->chill->setCurrentStars(current_dive->chill);
+	// This runs outside of the caller's ignoreInput guard: don't let the
+	// widgets post edit commands for the values we set.
+	{
+		QSignalBlocker blockMode(ui->diveType), blockVisibility(ui->visibility), blockWavesize(ui->wavesize),
+			       blockCurrent(ui->current), blockSurge(ui->surge), blockChill(ui->chill);
+		updateMode(current_dive);
+		ui->visibility->setCurrentStars(current_dive->visibility);
+		ui->wavesize->setCurrentStars(current_dive->wavesize);
+		ui->current->setCurrentStars(current_dive->current);
+		ui->surge->setCurrentStars(current_dive->surge);
+		ui->chill->setCurrentStars(current_dive->chill);
+	}
 	if (prefs.extraEnvironmentalDefault)
 		showCurrentWidget(true, 2);   // Show current star widget at 3rd position
 	else
@@ -298,9 +382,14 @@ void TabDiveInformation::on_waterTypeCombo_activated(int index)
 
 void TabDiveInformation::cylinderChanged(dive *d)
 {
-	// If this isn't the current dive, do nothing
-	if (current_dive != d)
+	invalidateGasUseOfDive(d);
+	// If this isn't the current dive or the full update is pending, do nothing
+	if (current_dive != d || dirty)
+		return;
+	if (!isVisible()) {
+		dirty = true;
 		return;
+	}
 	updateProfile();
 }
 
@@ -310,10 +399,23 @@ void TabDiveInformation::divesChanged(const QVector<dive *> &dives, DiveField fi
 {
 	int salinity_value;
 
+	if (field.duration || field.depth || field.mode) {
+		for (dive *d: dives)
+			invalidateGasUseOfDive(d);
+	}
+
 	// If the current dive is not in list of changed dives, do nothing
 	if (!current_dive || !dives.contains(current_dive))
 		return;
 
+	// A full update is pending anyway
+	if (dirty && !field.mode)
+		return;
+	if (!isVisible() && !field.mode) {
+		dirty = true;
+		return;
+	}
+
 	bool replot = false;
 	if (field.visibility)
 		ui->visibility->setCurrentStars(current_dive->visibility);
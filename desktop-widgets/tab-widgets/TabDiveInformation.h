@@ -4,6 +4,9 @@
 
 #include "TabBase.h"
 #include "core/subsurface-qt/divelistnotifier.h"
+#include <QHash>
+#include <QTimer>
+#include <vector>
 
 namespace Ui {
 	class TabDiveInformation;
@@ -16,9 +19,14 @@ public:
 	~TabDiveInformation();
 	void updateData() override;
 	void clear() override;
+protected:
+	void showEvent(QShowEvent *event) override;
 private slots:
+	void updateNow();
 	void divesChanged(const QVector<dive *> &dives, DiveField field);
 	void cylinderChanged(dive *d);
+	void invalidateGasUse(const QVector<dive *> &dives);
+	void invalidateGasUseOfDive(dive *d);
 	void diveModeChanged(int index);
 	void on_atmPressVal_editingFinished();
 	void on_atmPressType_currentIndexChanged(int index);
@@ -33,6 +41,20 @@ private slots:
 private:
 	Ui::TabDiveInformation *ui;
 	bool manualDive;
+	// Updates are deferred while the tab is hidden and coalesced while it
+	// is shown, so that fast navigation in the dive list doesn't recalculate
+	// every dive it passes.
+	QTimer updateTimer;
+	bool dirty;
+	// Gas use and SAC per cylinder, which need a pass over the samples.
+	// Keyed by dive id and divecomputer, invalidated on edits.
+	struct GasUse {
+		std::vector<int> used;	// in ml
+		std::vector<int> sac;	// in ml/min, 0 if unknown
+		bool firstMeanDepth;
+	};
+	QHash<QPair<int, int>, GasUse> gasUseCache;
+	const GasUse &getGasUse(struct dive *d);
 	void updateProfile();
 	int updateSalinityComboIndex(int salinity);
 	void checkDcSalinityOverWritten();
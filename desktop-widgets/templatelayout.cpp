@@ -6,6 +6,7 @@
 #include "templatelayout.h"
 #include "core/divelist.h"
 #include "core/selection.h"
+#include "core/statisticsstore.h"
 
 QList<QString> grantlee_templates, grantlee_statistics_templates;
 
@@ -120,24 +121,47 @@ static QString preprocessTemplate(const QString &in)
 	out.replace(weightsRegExp, QStringLiteral(R"({{\1.weightList}})"));
 	out.replace(weightRegExp, QStringLiteral(R"({{\1.weights.\2}})"));
 	out.replace(cylindersRegExp, QStringLiteral(R"({{\1.cylinderList}})"));
-	out.replace(cylindersRegExp, QStringLiteral(R"({{\1.cylinders.\2}})"));
+	out.replace(cylinderRegExp, QStringLiteral(R"({{\1.cylinders.\2}})"));
 
 	return out;
 }
 
+/* Preprocessing and compiling a template is a noticeable part of every
+ * print preview refresh, which happens on each change of the print options.
+ * Keep the last compiled template around and only redo the work if the
+ * template or its contents (e.g. after editing it) changed. The engine has
+ * to outlive the template, therefore it is kept as well. */
+static Grantlee::Template compiledTemplate(const QString &name)
+{
+	static Grantlee::Engine *engine;
+	static QString cachedName, cachedContents;
+	static Grantlee::Template cached;
+
+	QString templateContents = TemplateLayout::readTemplate(name);
+	if (cached && name == cachedName && templateContents == cachedContents)
+		return cached;
+
+	if (!engine)
+		engine = new Grantlee::Engine;
+	cached = engine->newTemplate(preprocessTemplate(templateContents), name);
+	cachedName = name;
+	cachedContents = templateContents;
+	return cached;
+}
+
 QString TemplateLayout::generate()
 {
 	int progress = 0;
 	int totalWork = getTotalWork(printOptions);
 
 	QString htmlContent;
-	Grantlee::Engine engine(this);
 	Grantlee::registerMetaType<template_options>();
 	Grantlee::registerMetaType<print_options>();
 	Grantlee::registerMetaType<CylinderObjectHelper>(); // TODO: Remove when grantlee supports Q_GADGET
 	Grantlee::registerMetaType<DiveObjectHelperGrantlee>(); // TODO: Remove when grantlee supports Q_GADGET
 
 	QVariantList diveList;
+	diveList.reserve(in_planner() ? 1 : totalWork);
 
 	struct dive *dive;
 	if (in_planner()) {
@@ -160,11 +184,7 @@ QString TemplateLayout::generate()
 	c.insert("print_options", QVariant::fromValue(*printOptions));
 
 	/* don't use the Grantlee loader API */
-	QString templateContents = readTemplate(printOptions->p_template);
-	QString preprocessed = preprocessTemplate(templateContents);
-
-	/* create the template from QString; is this thing allocating memory? */
-	Grantlee::Template t = engine.newTemplate(preprocessed, printOptions->p_template);
+	Grantlee::Template t = compiledTemplate(printOptions->p_template);
 	if (!t || t->error()) {
 		qDebug() << "Can't load template";
 		return htmlContent;
@@ -198,7 +218,7 @@ QString TemplateLayout::generateStatistics()
 
 	int i = 0;
 	stats_summary_auto_free stats;
-	calculate_stats_summary(&stats, false);
+	StatisticsStore::instance().summary(&stats);
 	while (stats.stats_yearly != NULL && stats.stats_yearly[i].period) {
 		YearInfo year{ &stats.stats_yearly[i] };
 		years.append(QVariant::fromValue(year));
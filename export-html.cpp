@@ -3,12 +3,13 @@
 
 #include <QString>
 #include <QCommandLineParser>
-#include <QApplication>
+#include <QCoreApplication>
 #include <QDebug>
 
 #include "core/qt-gui.h"
 #include "core/qthelper.h"
 #include "core/file.h"
+#include "core/divelist.h"
 #include "core/divesite.h"
 #include "core/trip.h"
 #include "core/save-html.h"
@@ -18,51 +19,71 @@
 #include "core/divelogexportlogic.h"
 #include "core/statistics.h"
 
+/*
+ * Logbooks are exported one after the other: the dive data lives in global
+ * tables. Loading a git logbook and formatting the dives of the export
+ * already use all cores, and a logbook that was exported before starts
+ * from the snapshot in its repository, as long as the tables are empty.
+ */
+static int exportLogbook(const QString &source, const QString &output, struct htmlExportSetting &hes)
+{
+	git_prefs.unit_system = default_prefs.unit_system;
+	git_prefs.units = default_prefs.units;
+	int ret = parse_file(qPrintable(source), &dive_table, &trip_table, &dive_site_table, &filter_preset_table);
+	if (ret) {
+		fprintf(stderr, "parse_file of %s returned %d\n", qPrintable(source), ret);
+	} else {
+		// this should have set up the informational preferences - let's grab
+		// the units from there
+		prefs.unit_system = git_prefs.unit_system;
+		prefs.units = git_prefs.units;
+		exportHtmlInitLogic(output, hes);
+	}
+	clear_dive_file_data();
+	return ret;
+}
+
 int main(int argc, char **argv)
 {
-	QApplication *application = new QApplication(argc, argv);
+	QCoreApplication *application = new QCoreApplication(argc, argv);
 	git_libgit2_init();
 	copy_prefs(&default_prefs, &prefs);
 	init_qt_late();
 
 	QCommandLineParser parser;
 	QCommandLineOption sourceDirectoryOption(QStringList() << "s" << "source",
-						 "Read git repository from <directory>",
+						 "Read git repository from <directory>, may be given more than once",
 						 "directory");
 	parser.addOption(sourceDirectoryOption);
 	QCommandLineOption outputDirectoryOption(QStringList() << "u" << "output",
-						 "Write HTML files into <directory>",
+						 "Write HTML files into <directory>, once for every --source",
 						 "directory");
 	parser.addOption(outputDirectoryOption);
 
 	parser.process(*application);
 
-	QString source = parser.value(sourceDirectoryOption);
-	QString output = parser.value(outputDirectoryOption);
+	QStringList sources = parser.values(sourceDirectoryOption);
+	QStringList outputs = parser.values(outputDirectoryOption);
 
-	if (source.isEmpty() || output.isEmpty()) {
-		qDebug() << "need --source and --output";
-		exit(1);
-	}
-	int ret = parse_file(qPrintable(source), &dive_table, &trip_table, &dive_site_table, &filter_preset_table);
-	if (ret) {
-		fprintf(stderr, "parse_file returned %d\n", ret);
+	if (sources.isEmpty() || sources.size() != outputs.size()) {
+		qDebug() << "need the same number of --source and --output";
 		exit(1);
 	}
 
-	// this should have set up the informational preferences - let's grab
-	// the units from there
-	prefs.unit_system = git_prefs.unit_system;
-	prefs.units = git_prefs.units;
-
 	// now set up the export settings to create the HTML export
 	struct htmlExportSetting hes;
 	hes.themeFile = "sand.css";
 	hes.exportPhotos = true;
 	hes.selectedOnly = false;
 	hes.listOnly = false;
+	hes.packedSamples = true;
 	hes.yearlyStatistics = true;
 	hes.subsurfaceNumbers = true;
-	exportHtmlInitLogic(output, hes);
-	exit(0);
+
+	int failed = 0;
+	for (int i = 0; i < sources.size(); i++) {
+		if (exportLogbook(sources[i], outputs[i], hes))
+			failed++;
+	}
+	exit(failed ? 1 : 0);
 }
@@ -42,10 +42,15 @@ Item {
 		property var clickCoord: QtPositioning.coordinate(0, 0)
 		property bool isReady: false
 
-		Component.onCompleted: isReady = true
+		Component.onCompleted: {
+			isReady = true
+			mapHelper.updateClusters(zoomLevel)
+		}
 		onZoomLevelChanged: {
-			if (isReady)
+			if (isReady) {
 				mapHelper.calculateSmallCircleRadius(map.center)
+				mapHelper.updateClusters(zoomLevel)
+			}
 		}
 
 		MapItemView {
@@ -65,11 +70,30 @@ Item {
 						PropertyAnimation { target: mapItemImage; property: "scale"; from: 1.0; to: 0.7; duration: 120 }
 						PropertyAnimation { target: mapItemImage; property: "scale"; from: 0.7; to: 1.0; duration: 80 }
 					}
+					Rectangle {
+						// Number of dive sites of a cluster
+						visible: model.count > 1
+						anchors.centerIn: parent
+						width: Math.max(mapItemCount.width + 8, height)
+						height: mapItemCount.height + 4
+						radius: height * 0.5
+						color: "#b08000"
+						border.color: "white"
+						Text {
+							id: mapItemCount
+							anchors.centerIn: parent
+							text: model.count
+							font.pointSize: 9.0
+							color: "white"
+						}
+					}
 					MouseArea {
 						drag.target: (mapHelper.editMode && model.isSelected) ? mapItem : undefined
 						anchors.fill: parent
 						onClicked: {
-							if (!mapHelper.editMode && model.divesite)
+							if (model.count > 1)
+								map.doubleClickHandler(mapItem.coordinate) // Zoom in to expand the cluster
+							else if (!mapHelper.editMode && model.divesite)
 								mapHelper.selectedLocationChanged(model.divesite)
 						}
 						onDoubleClicked: map.doubleClickHandler(mapItem.coordinate)
@@ -124,6 +124,11 @@ void MapWidgetHelper::selectionChanged()
 	m_mapLocationModel->selectionChanged();
 }
 
+void MapWidgetHelper::updateClusters(qreal zoomLevel)
+{
+	m_mapLocationModel->setZoomLevel(zoomLevel);
+}
+
 void MapWidgetHelper::selectedLocationChanged(struct dive_site *ds_in)
 {
 	int idx;
@@ -36,6 +36,7 @@ public:
 	Q_INVOKABLE void updateCurrentDiveSiteCoordinatesFromMap(struct dive_site *ds, QGeoCoordinate coord);
 	Q_INVOKABLE void selectVisibleLocations();
 	Q_INVOKABLE void selectedLocationChanged(struct dive_site *ds);
+	Q_INVOKABLE void updateClusters(qreal zoomLevel);
 	void selectionChanged();
 	void setSelected(const QVector<dive_site *> &divesites);
 	QString pluginObject();
@@ -30,6 +30,7 @@ Kirigami.Page {
 
 		onDownloadFinished : {
 			progressBar.visible = false
+			downloadStats.text = importModel.downloadStats()
 			if (rowCount() > 0) {
 				manager.appendTextToLog(rowCount() + " dive downloaded")
 				divesDownloaded = true
@@ -294,6 +295,23 @@ Kirigami.Page {
 			visible: false
 		}
 
+		TemplateLabel {
+			id: downloadStats
+			Layout.fillWidth: true
+			wrapMode: Text.WordWrap
+			font.pointSize: subsurfaceTheme.smallPointSize
+			visible: text !== ""
+		}
+
+		Timer {
+			id: downloadStatsTimer
+			interval: 500
+			repeat: true
+			triggeredOnStart: true
+			running: progressBar.visible
+			onTriggered: downloadStats.text = importModel.downloadStats()
+		}
+
 		RowLayout {
 			id: buttonBar
 			Layout.fillWidth: true
@@ -355,7 +373,7 @@ Kirigami.Page {
 					manager.cancelDownloadDC()
 					if (!progressBar.visible) {
 						// remove the download page and show dive list
-						pageStack.pop(downloadFromDc)
+						pageStack.pop(diveComputerDownloadWindow)
 						rootItem.showDiveList()
 						download.text = qsTr("Download")
 						divesDownloaded = false
@@ -14,6 +14,11 @@ Kirigami.ScrollablePage {
 	title: qsTr("Application Log")
 	background: Rectangle { color: subsurfaceTheme.backgroundColor }
 
+	// only update the list while it is shown
+	onVisibleChanged: logModel.setActive(visible)
+	Component.onCompleted: logModel.setActive(visible)
+	Component.onDestruction: logModel.setActive(false)
+
 	ListView {
 		anchors.fill: parent
 		model: logModel
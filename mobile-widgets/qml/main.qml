@@ -30,7 +30,9 @@ Kirigami.ApplicationWindow {
 	property alias notificationText: manager.notificationText
 	property alias locationServiceEnabled: manager.locationServiceEnabled
 	property alias pluggedInDeviceName: manager.pluggedInDeviceName
-	property alias defaultCylinderIndex: settingsWindow.defaultCylinderIndex
+	// these pages are created on first use, see loadPage()
+	property alias mapPage: mapPageLoader.item
+	property alias downloadFromDc: downloadFromDcLoader.item
 	property bool filterToggle: false
 	property string filterPattern: ""
 	property int colWidth: undefined
@@ -98,8 +100,18 @@ Kirigami.ApplicationWindow {
 		manager.appendTextToLog("switched to page " + page.title)
 	}
 
+	// The rarely used pages are only created when they are shown for the
+	// first time, which keeps them out of the start up of the app
+	function loadPage(loader) {
+		if (!loader.active) {
+			manager.appendTextToLog("creating page " + loader.objectName)
+			loader.active = true
+		}
+		return loader.item
+	}
+
 	function showMap() {
-		showPage(mapPage)
+		showPage(loadPage(mapPageLoader))
 	}
 
 	function showDiveList() {
@@ -293,6 +305,7 @@ Kirigami.ApplicationWindow {
 					enabled: true
 					onTriggered: {
 						globalDrawer.close()
+						loadPage(downloadFromDcLoader)
 						downloadFromDc.dcImportModel.clearTable()
 						showPage(downloadFromDc)
 					}
@@ -322,7 +335,7 @@ Kirigami.ApplicationWindow {
 						name: ":/icons/cloud_sync.svg"
 					}
 					text: qsTr("Manual sync with cloud")
-					enabled: Backend.cloud_verification_status === Enums.CS_VERIFIED
+					enabled: Backend.cloud_verification_status === Enums.CS_VERIFIED && !manager.cloudSyncRunning
 					onTriggered: {
 						globalDrawer.close()
 						detailsWindow.endEditMode()
@@ -330,6 +343,17 @@ Kirigami.ApplicationWindow {
 						globalDrawer.close()
 					}
 				}
+				Kirigami.Action {
+					icon {
+						name: ":/icons/ic_cloud_off.svg"
+					}
+					text: qsTr("Cancel cloud sync")
+					visible: manager.cloudSyncRunning
+					onTriggered: {
+						globalDrawer.close()
+						manager.cancelCloudSync()
+					}
+				}
 				Kirigami.Action {
 				icon {
 					name: PrefCloudStorage.cloud_auto_sync ?  ":/icons/ic_cloud_off.svg" : ":/icons/ic_cloud_done.svg"
@@ -353,7 +377,7 @@ if you have network connectivity and want to sync your data to cloud storage."),
 					text: qsTr("Dive summary")
 					onTriggered: {
 						globalDrawer.close()
-						showPage(diveSummaryWindow)
+						showPage(loadPage(diveSummaryLoader))
 						detailsWindow.endEditMode()
 					}
 				}
@@ -364,7 +388,7 @@ if you have network connectivity and want to sync your data to cloud storage."),
 					text: qsTr("Export")
 					onTriggered: {
 						globalDrawer.close()
-						showPage(exportWindow)
+						showPage(loadPage(exportLoader))
 						detailsWindow.endEditMode()
 					}
 				}
@@ -386,7 +410,7 @@ if you have network connectivity and want to sync your data to cloud storage."),
 					icon {
 						name: ":/icons/map-globe.svg"
 					}
-					text: mapPage.title
+					text: qsTranslate("MapPage", "Map")
 					onTriggered: {
 						showMap()
 					}
@@ -400,7 +424,7 @@ if you have network connectivity and want to sync your data to cloud storage."),
 						globalDrawer.close()
 						returnTopPage()
 						manager.populateGpsData();
-						showPage(gpsWindow)
+						showPage(loadPage(gpsLoader))
 					}
 				}
 
@@ -433,8 +457,9 @@ if you have network connectivity and want to sync your data to cloud storage."),
 				text: qsTr("Settings")
 				onTriggered: {
 					globalDrawer.close()
+					var settingsWindow = loadPage(settingsLoader)
 					settingsWindow.defaultCylinderModel = manager.cylinderInit
-					PrefEquipment.default_cylinder === "" ? defaultCylinderIndex = "-1" : defaultCylinderIndex = settingsWindow.defaultCylinderModel.indexOf(PrefEquipment.default_cylinder)
+					PrefEquipment.default_cylinder === "" ? settingsWindow.defaultCylinderIndex = "-1" : settingsWindow.defaultCylinderIndex = settingsWindow.defaultCylinderModel.indexOf(PrefEquipment.default_cylinder)
 					showPage(settingsWindow)
 					detailsWindow.endEditMode()
 				}
@@ -458,7 +483,7 @@ if you have network connectivity and want to sync your data to cloud storage."),
 					text: qsTr("About")
 					onTriggered: {
 						globalDrawer.close()
-						showPage(aboutWindow)
+						showPage(loadPage(aboutLoader))
 						detailsWindow.endEditMode()
 					}
 				}
@@ -513,7 +538,7 @@ if you have network connectivity and want to sync your data to cloud storage."),
 					text: qsTr("App log")
 					onTriggered: {
 						globalDrawer.close()
-						showPage(logWindow)
+						showPage(loadPage(logLoader))
 					}
 				}
 				Kirigami.Action {
@@ -536,7 +561,7 @@ if you have network connectivity and want to sync your data to cloud storage."),
 					text: qsTr("Theme information")
 					onTriggered: {
 						globalDrawer.close()
-						showPage(themetest)
+						showPage(loadPage(themeTestLoader))
 					}
 				}
 
@@ -553,7 +578,7 @@ if you have network connectivity and want to sync your data to cloud storage."),
 					text: qsTr("Access local cloud cache dirs")
 					onTriggered: {
 						globalDrawer.close()
-						showPage(recoverCache)
+						showPage(loadPage(recoverCacheLoader))
 					}
 				}
 
@@ -695,7 +720,7 @@ if you have network connectivity and want to sync your data to cloud storage."),
 			// for some reason I cannot figure out, whenever the mapPage is selected
 			// we immediately switch back to the page before it - so force-prevent
 			// that undersired behavior
-			if (pageStack.currentItem.objectName === mapPage.objectName) {
+			if (pageStack.currentItem.objectName === "MapPage") {
 				// remember that we actively picked the mapPage
 				if (hackToOpenMap !== 2 /* MapForced */ ) {
 					manager.appendTextToLog("pageStack switched to map")
@@ -703,8 +728,8 @@ if you have network connectivity and want to sync your data to cloud storage."),
 				} else {
 					manager.appendTextToLog("pageStack forced back to map")
 				}
-			} else if (pageStack.currentItem.objectName !== mapPage.objectName &&
-				           pageStack.lastItem.objectName === mapPage.objectName &&
+			} else if (pageStack.currentItem.objectName !== "MapPage" &&
+				           pageStack.lastItem.objectName === "MapPage" &&
 				           hackToOpenMap === 1 /* MapSelected */) {
 				// if we just picked the mapPage and are suddenly back on a different page
 				// force things back to the mapPage
@@ -718,11 +743,11 @@ if you have network connectivity and want to sync your data to cloud storage."),
 			}
 
 			// disable the left swipe to go back when on the map page
-			pageStack.interactive = pageStack.currentItem.objectName !== mapPage.objectName
+			pageStack.interactive = pageStack.currentItem.objectName !== "MapPage"
 
 			// is there a better way to reload the map markers instead of doing that
 			// every time the map page is shown - e.g. link to the dive list model somehow?
-			if (pageStack.currentItem.objectName === mapPage.objectName)
+			if (pageStack.currentItem.objectName === "MapPage")
 				mapPage.reloadMap()
 
 			// In case we land on any page, not being the DiveDetails (which can be
@@ -796,24 +821,48 @@ if you have network connectivity and want to sync your data to cloud storage."),
 		visible: false
 	}
 
-	Settings {
-		id: settingsWindow
-		visible: false
+	Loader {
+		id: settingsLoader
+		objectName: "Settings"
+		active: false
+		sourceComponent: Component {
+			Settings {
+				visible: false
+			}
+		}
 	}
 
-	CopySettings {
-		id: settingsCopyWindow
-		visible: false
+	Loader {
+		id: settingsCopyLoader
+		objectName: "CopySettings"
+		active: false
+		sourceComponent: Component {
+			CopySettings {
+				visible: false
+			}
+		}
 	}
 
-	About {
-		id: aboutWindow
-		visible: false
+	Loader {
+		id: aboutLoader
+		objectName: "About"
+		active: false
+		sourceComponent: Component {
+			About {
+				visible: false
+			}
+		}
 	}
 
-	Export {
-		id: exportWindow
-		visible: false
+	Loader {
+		id: exportLoader
+		objectName: "Export"
+		active: false
+		sourceComponent: Component {
+			Export {
+				visible: false
+			}
+		}
 	}
 
 	DiveDetails {
@@ -826,29 +875,59 @@ if you have network connectivity and want to sync your data to cloud storage."),
 		visible: false
 	}
 
-	Log {
-		id: logWindow
-		visible: false
+	Loader {
+		id: logLoader
+		objectName: "Log"
+		active: false
+		sourceComponent: Component {
+			Log {
+				visible: false
+			}
+		}
 	}
 
-	GpsList {
-		id: gpsWindow
-		visible: false
+	Loader {
+		id: gpsLoader
+		objectName: "GpsList"
+		active: false
+		sourceComponent: Component {
+			GpsList {
+				visible: false
+			}
+		}
 	}
 
-	DownloadFromDiveComputer {
-		id: downloadFromDc
-		visible: false
+	Loader {
+		id: downloadFromDcLoader
+		objectName: "DownloadFromDiveComputer"
+		active: false
+		sourceComponent: Component {
+			DownloadFromDiveComputer {
+				visible: false
+			}
+		}
 	}
 
-	MapPage {
-		id: mapPage
-		visible: false
+	Loader {
+		id: mapPageLoader
+		objectName: "MapPage"
+		active: false
+		sourceComponent: Component {
+			MapPage {
+				visible: false
+			}
+		}
 	}
 
-	RecoverCache {
-		id: recoverCache
-		visible: false
+	Loader {
+		id: recoverCacheLoader
+		objectName: "RecoverCache"
+		active: false
+		sourceComponent: Component {
+			RecoverCache {
+				visible: false
+			}
+		}
 	}
 
 /* this shouldn't be exposed unless someone will finish the work
@@ -872,18 +951,31 @@ if you have network connectivity and want to sync your data to cloud storage."),
 		visible: false
 	}
  */
-	DiveSummary {
-		id: diveSummaryWindow
-		visible: false
+	Loader {
+		id: diveSummaryLoader
+		objectName: "DiveSummary"
+		active: false
+		sourceComponent: Component {
+			DiveSummary {
+				visible: false
+			}
+		}
 	}
 
-	ThemeTest {
-		id: themetest
-		visible: false
+	Loader {
+		id: themeTestLoader
+		objectName: "ThemeTest"
+		active: false
+		sourceComponent: Component {
+			ThemeTest {
+				visible: false
+			}
+		}
 	}
 
 	function showDownloadPage(vendor, product, connection) {
 		manager.appendTextToLog("show download page for " + vendor + " / " + product + " / " + connection)
+		loadPage(downloadFromDcLoader)
 		downloadFromDc.dcImportModel.clearTable()
 		if (vendor !== undefined && product !== undefined && connection !== undefined) {
 			downloadFromDc.setupUSB = true
@@ -33,8 +33,13 @@
 #include "core/qthelper.h"
 #include "core/qt-gui.h"
 #include "core/git-access.h"
+#include "core/gitmaintenance.h"
+#include "core/samplecolumns.h"
+#include "core/sampleresidency.h"
+#include "core/arena.h"
 #include "core/cloudstorage.h"
 #include "core/membuffer.h"
+#include "core/memusage.h"
 #include "core/downloadfromdcthread.h"
 #include "core/subsurface-string.h"
 #include "core/pref.h"
@@ -47,6 +52,7 @@
 #include "core/settings/qPrefPartialPressureGas.h"
 #include "core/settings/qPrefUnit.h"
 #include "core/subsurface-qt/diveobjecthelper.h"
+#include "core/trace.h"
 #include "core/trip.h"
 #include "backend-shared/exportfuncs.h"
 #include "core/worldmap-save.h"
@@ -57,8 +63,21 @@
 
 #if defined(Q_OS_ANDROID)
 #include "core/serial_usb_android.h"
+#include <QtAndroid>
 std::vector<android_usb_serial_device_descriptor> androidSerialDevices;
 
+static bool powerSaveMode()
+{
+	QAndroidJniObject service = QAndroidJniObject::fromString("power");
+	QAndroidJniObject powerManager = QtAndroid::androidContext().callObjectMethod("getSystemService",
+			"(Ljava/lang/String;)Ljava/lang/Object;", service.object<jstring>());
+	return powerManager.isValid() && powerManager.callMethod<jboolean>("isPowerSaveMode", "()Z");
+}
+#else
+static bool powerSaveMode()
+{
+	return false;
+}
 #endif
 
 QMLManager *QMLManager::m_instance = NULL;
@@ -100,19 +119,22 @@ static void appendTextToLogStandalone(const char *text)
 // are really vastly different...
 // this is mainly intended for the early stages of the app so the user sees that
 // things are progressing
+// The cloud sync reports its progress from a worker thread, so take care to
+// set the text in the UI thread.
 static void showProgress(QString msg)
 {
 	QMLManager *self = QMLManager::instance();
 	if (self)
-		self->setNotificationText(msg);
+		QMetaObject::invokeMethod(self, [self, msg]() { self->setNotificationText(msg); }, Qt::AutoConnection);
 }
 
 // show the git progress in the passive notification area
 extern "C" int gitProgressCB(const char *text)
 {
 	showProgress(QString(text));
-	// return 0 so that we don't end the download
-	return 0;
+	// a nonzero return value ends the download
+	QMLManager *self = QMLManager::instance();
+	return self && self->cloudSyncCancelled();
 }
 
 void QMLManager::registerError(QString error)
@@ -186,11 +208,34 @@ QMLManager::QMLManager() : m_locationServiceEnabled(false),
 	m_pluggedInDeviceName(""),
 	m_showNonDiveComputers(false),
 	undoAction(Command::undoAction(this)),
+	m_cloudSyncCancelled(false),
+	m_changedDuringSync(false),
+	m_syncGitLocalOnly(false),
+	m_syncDeferred(false),
+	m_syncDeferDelay(0),
 	m_oldStatus(qPrefCloudStorage::CS_UNKNOWN)
 {
 	m_instance = this;
+#ifndef NO_TRACING
+	// keep the timing of the hot paths for the support logs
+	trace_enable();
+#endif
 	m_lastDevicePixelRatio = qApp->devicePixelRatio();
 	timer.start();
+	connect(&cloudSyncWatcher, &QFutureWatcher<int>::finished, this, &QMLManager::cloudSyncFinished);
+	saveTimer.setSingleShot(true);
+	connect(&saveTimer, &QTimer::timeout, this, &QMLManager::saveDelayedChanges);
+	syncScheduleTimer.setSingleShot(true);
+	connect(&syncScheduleTimer, &QTimer::timeout, this, &QMLManager::runScheduledCloudSync);
+	// retry a deferred sync as soon as the network gets better
+	connect(&networkConfigManager, &QNetworkConfigurationManager::onlineStateChanged, this, [this](bool) {
+		if (m_syncDeferred)
+			runScheduledCloudSync();
+	});
+	connect(&networkConfigManager, &QNetworkConfigurationManager::configurationChanged, this, [this](const QNetworkConfiguration &) {
+		if (m_syncDeferred)
+			runScheduledCloudSync();
+	});
 	connect(qobject_cast<QApplication *>(QApplication::instance()), &QApplication::applicationStateChanged, this, &QMLManager::applicationStateChanged);
 
 	// make upload signals available in QML
@@ -251,6 +296,12 @@ QMLManager::QMLManager() : m_locationServiceEnabled(false),
 #endif
 	set_error_cb(&showErrorFromC);
 	uiNotificationCallback = showProgress;
+	// the dive list only needs the dive headers - parse the samples of a dive when it is shown
+	git_lazy_samples = true;
+	// likewise, keep the samples of other logbooks in compact form until the dive is shown
+	pack_loaded_samples = true;
+	// and only keep the samples of the recently shown dives
+	sample_residency_budget = 32;
 	appendTextToLog("Starting " + getUserAgent());
 	appendTextToLog(QStringLiteral("built with libdivecomputer v%1").arg(dc_version(NULL)));
 	appendTextToLog(QStringLiteral("built with Qt Version %1, runtime from Qt Version %2").arg(QT_VERSION_STR).arg(qVersion()));
@@ -334,8 +385,12 @@ void QMLManager::applicationStateChanged(Qt::ApplicationState state)
 	}
 	if (state == Qt::ApplicationInactive && unsavedChanges()) {
 		// saveChangesCloud ensures that we don't have two conflicting saves going on
+		// this also flushes the changes that are waiting for saveTimer
 		appendTextToLog("trying to save data as user switched away from app");
 		saveChangesCloud(false);
+		// the app may be suspended before the batched sync is due
+		if (syncScheduleTimer.isActive() && !m_syncDeferred)
+			runScheduledCloudSync();
 		appendTextToLog("done trying to save to git local / remote");
 	}
 }
@@ -343,6 +398,7 @@ void QMLManager::applicationStateChanged(Qt::ApplicationState state)
 void QMLManager::openLocalThenRemote(QString url)
 {
 	// clear out the models and the fulltext index
+	Command::clear();
 	clear_dive_file_data();
 	setDiveListProcessing(true);
 	setNotificationText(tr("Open local dive data file"));
@@ -352,8 +408,26 @@ void QMLManager::openLocalThenRemote(QString url)
 	/* if this is a cloud storage repo and we have no local cache (i.e., it's the first time
 	 * we try to open this), parse_file (which is called by openAndMaybeSync) will ALWAYS connect
 	 * to the remote and populate the cache.
-	 * Otherwise parse_file will respect the git_local_only flag and only update if that isn't set */
+	 * Otherwise parse_file will respect the git_local_only flag and only update if that isn't set.
+	 * To show the dive list quickly, first read the local cache only. With the snapshot of the
+	 * dive headers and lazily loaded samples, this is a matter of a few hundred ms. The sync
+	 * with the remote is then done in the background and cloudSyncFinished() only reloads the
+	 * dives that were changed. */
+	bool syncLater = !git_local_only;
+	// Check the connection to the cloud server while the local cache is loaded.
+	// The sync uses the result of this check instead of waiting for another one.
+	if (syncLater && m_oldStatus != qPrefCloudStorage::CS_NOCLOUD && url.startsWith(prefs.cloud_git_url))
+		startCloudServerCheck();
+	git_local_only = true;
 	int error = parse_file(encodedFilename.constData(), &dive_table, &trip_table, &dive_site_table, &filter_preset_table);
+	git_local_only = !syncLater;
+	if (error && syncLater) {
+		// Probably there is no local cache yet - we have to wait for the remote
+		appendTextToLog(QStringLiteral("loading dives from cache failed %1, try again with remote sync").arg(error));
+		syncLater = false;
+		clear_dive_file_data();
+		error = parse_file(encodedFilename.constData(), &dive_table, &trip_table, &dive_site_table, &filter_preset_table);
+	}
 	if (error) {
 		/* there can be 2 reasons for this:
 		 * 1) we have cloud credentials, but there is no local repo (yet).
@@ -411,6 +485,10 @@ void QMLManager::openLocalThenRemote(QString url)
 	setDiveListProcessing(false);
 	// this could have added a new local cache directory
 	emit cloudCacheListChanged();
+
+	// Let the dive list be drawn before starting the sync
+	if (!error && syncLater && m_oldStatus != qPrefCloudStorage::CS_NOCLOUD)
+		QTimer::singleShot(0, this, [this] { startCloudSync(); });
 }
 
 // Convenience function to accesss dive directly via its row.
@@ -482,6 +560,24 @@ QString QMLManager::getCombinedLogs()
 	QString copyString = "\n---------- subsurface.log ----------\n";
 	copyString += MessageHandlerModel::self()->logAsString();
 
+	// Add heading and append the timing of the hot paths
+	if (tracing_enabled) {
+		membuffer buf = {};
+		put_trace(&buf);
+		copyString += "\n\n\n---------- trace ----------\n";
+		copyString += QString::fromUtf8(mb_cstring(&buf));
+		free_buffer(&buf);
+	}
+
+	// Add heading and append the memory usage
+	{
+		membuffer buf = {};
+		put_memory_usage(&buf);
+		copyString += "\n\n\n---------- memory usage ----------\n";
+		copyString += QString::fromUtf8(mb_cstring(&buf));
+		free_buffer(&buf);
+	}
+
 	// Add heading and append libdivecomputer.log
 	QFile f(logfile_name);
 	if (f.open(QFile::ReadOnly | QFile::Text)) {
@@ -627,6 +723,7 @@ void QMLManager::saveCloudCredentials(const QString &newEmail, const QString &ne
 		syncLoadFromCloud();
 		manager()->clearAccessCache(); // remove any chached credentials
 		clear_git_id(); // invalidate our remembered GIT SHA
+		Command::clear();
 		clear_dive_file_data();
 		setStartPageText(tr("Attempting to open cloud storage with new credentials"));
 		// since we changed credentials, we need to try to connect to the cloud, regardless
@@ -693,14 +790,24 @@ void QMLManager::loadDivesWithValidCredentials()
 	git_repository *git;
 	const char *branch;
 	int error;
+	struct git_dive_changes changes = {};
+	QByteArray loadedId(saved_git_id); // A merge during the sync changes saved_git_id
 	if (check_git_sha(fileNamePrt.data(), &git, &branch) == 0) {
 		appendTextToLog("Cloud sync shows local cache was current");
+	} else if (!noCloudToCloud && !git_load_dive_changes(git, branch, loadedId.constData(), &changes)) {
+		// Only the changed dives were parsed: replace them without resetting the dive list
+		appendTextToLog(QStringLiteral("Cloud sync brought %1 new or changed dives, %2 dives were removed or changed")
+				.arg(changes.dives.nr).arg(changes.removed.nr));
+		Command::reloadDives(&changes);
+		free_git_dive_changes(&changes);
+		applyGitPrefs();
 	} else {
 		appendTextToLog("Cloud sync brought newer data, reloading the dive list");
 		setDiveListProcessing(true);
 		// if we aren't switching from no-cloud mode, let's clear the dive data
 		if (!noCloudToCloud) {
 			appendTextToLog("Clear out in memory dive data");
+			Command::clear();
 			clear_dive_file_data();
 		} else {
 			appendTextToLog("Switching from no cloud mode; keep in memory dive data");
@@ -782,7 +889,7 @@ void QMLManager::revertToNoCloudIfNeeded()
 	}
 }
 
-void QMLManager::consumeFinishedLoad()
+void QMLManager::applyGitPrefs()
 {
 	prefs.unit_system = git_prefs.unit_system;
 	if (git_prefs.unit_system == IMPERIAL)
@@ -795,6 +902,11 @@ void QMLManager::consumeFinishedLoad()
 	prefs.show_ccr_setpoint = git_prefs.show_ccr_setpoint;
 	prefs.show_ccr_sensors = git_prefs.show_ccr_sensors;
 	prefs.pp_graphs.po2 = git_prefs.pp_graphs.po2;
+}
+
+void QMLManager::consumeFinishedLoad()
+{
+	applyGitPrefs();
 	process_loaded_dives();
 	appendTextToLog(QStringLiteral("%1 dives loaded").arg(dive_table.nr));
 	if (dive_table.nr == 0)
@@ -940,8 +1052,8 @@ bool QMLManager::checkLocation(DiveSiteChange &res, const DiveObjectHelper &myDi
 {
 	struct dive_site *ds = get_dive_site_for_dive(d);
 	bool changed = false;
-	qDebug() << "checkLocation" << location << "gps" << gps << "dive had" << myDive.location << "gps" << myDive.gas;
-	if (myDive.location != location) {
+	qDebug() << "checkLocation" << location << "gps" << gps << "dive had" << myDive.location() << "gps" << myDive.gas();
+	if (myDive.location() != location) {
 		ds = get_dive_site_by_name(qPrintable(location), &dive_site_table);
 		if (!ds && !location.isEmpty()) {
 			res.createdDs.reset(alloc_dive_site_with_name(qPrintable(location)));
@@ -954,7 +1066,7 @@ bool QMLManager::checkLocation(DiveSiteChange &res, const DiveObjectHelper &myDi
 	// now make sure that the GPS coordinates match - if the user changed the name but not
 	// the GPS coordinates, this still does the right thing as the now new dive site will
 	// have no coordinates, so the coordinates from the edit screen will get added
-	if (myDive.gps != gps) {
+	if (myDive.gps() != gps) {
 		double lat, lon;
 		if (parseGpsText(gps, &lat, &lon)) {
 			qDebug() << "parsed GPS, using it";
@@ -981,7 +1093,7 @@ bool QMLManager::checkLocation(DiveSiteChange &res, const DiveObjectHelper &myDi
 
 bool QMLManager::checkDuration(const DiveObjectHelper &myDive, struct dive *d, QString duration)
 {
-	if (myDive.duration != duration) {
+	if (myDive.duration() != duration) {
 		int h = 0, m = 0, s = 0;
 		QRegExp r1(QStringLiteral("(\\d*)\\s*%1[\\s,:]*(\\d*)\\s*%2[\\s,:]*(\\d*)\\s*%3").arg(tr("h")).arg(tr("min")).arg(tr("sec")), Qt::CaseInsensitive);
 		QRegExp r2(QStringLiteral("(\\d*)\\s*%1[\\s,:]*(\\d*)\\s*%2").arg(tr("h")).arg(tr("min")), Qt::CaseInsensitive);
@@ -1020,7 +1132,7 @@ bool QMLManager::checkDuration(const DiveObjectHelper &myDive, struct dive *d, Q
 
 bool QMLManager::checkDepth(const DiveObjectHelper &myDive, dive *d, QString depth)
 {
-	if (myDive.depth != depth) {
+	if (myDive.depth() != depth) {
 		int depthValue = parseLengthToMm(depth);
 		// the QML code should stop negative depth, but massively huge depth can make
 		// the profile extremely slow or even run out of memory and crash, so keep
@@ -1052,7 +1164,8 @@ void QMLManager::commitChanges(QString diveId, QString number, QString date, QSt
 	Command::OwningDivePtr d_ptr(alloc_dive()); // Automatically delete dive if we exit early!
 	dive *d = d_ptr.get();
 	copy_dive(orig, d);
-	DiveObjectHelper myDive(d);
+	load_samples(d); // The copy is edited, give it its own samples
+	DiveObjectHelper myDive(orig); // Formats lazily: orig, unlike d, is not changed before the command is executed
 
 	// notes comes back as rich text - let's convert this into plain text
 	QTextDocument doc;
@@ -1074,15 +1187,15 @@ void QMLManager::commitChanges(QString diveId, QString number, QString date, QSt
 		diveChanged = true;
 		d->number = number.toInt();
 	}
-	if (myDive.airTemp != airtemp) {
+	if (myDive.airTemp() != airtemp) {
 		diveChanged = true;
 		d->airtemp.mkelvin = parseTemperatureToMkelvin(airtemp);
 	}
-	if (myDive.waterTemp != watertemp) {
+	if (myDive.waterTemp() != watertemp) {
 		diveChanged = true;
 		d->watertemp.mkelvin = parseTemperatureToMkelvin(watertemp);
 	}
-	if (myDive.sumWeight != weight) {
+	if (myDive.sumWeight() != weight) {
 		diveChanged = true;
 		// not sure what we'd do if there was more than one weight system
 		// defined - for now just ignore that case
@@ -1099,7 +1212,7 @@ void QMLManager::commitChanges(QString diveId, QString number, QString date, QSt
 		startpressure = QStringList();
 	if (endpressure == QStringList(QString()))
 		endpressure = QStringList();
-	if (myDive.startPressure != startpressure || myDive.endPressure != endpressure) {
+	if (myDive.startPressure() != startpressure || myDive.endPressure() != endpressure) {
 		diveChanged = true;
 		for ( int i = 0, j = 0 ; j < startpressure.length() && j < endpressure.length() ; i++ ) {
 			if (state != "add" && !is_cylinder_used(d, i))
@@ -1115,7 +1228,7 @@ void QMLManager::commitChanges(QString diveId, QString number, QString date, QSt
 		}
 	}
 	// gasmix for first cylinder
-	if (myDive.firstGas != gasmix) {
+	if (myDive.firstGas() != gasmix) {
 		for ( int i = 0, j = 0 ; j < gasmix.length() ; i++ ) {
 			if (state != "add" && !is_cylinder_used(d, i))
 				continue;
@@ -1134,7 +1247,7 @@ void QMLManager::commitChanges(QString diveId, QString number, QString date, QSt
 		}
 	}
 	// info for first cylinder
-	if (myDive.getCylinder != usedCylinder) {
+	if (myDive.getCylinder() != usedCylinder) {
 		diveChanged = true;
 		unsigned long i;
 		int size = 0, wp = 0, j = 0, k = 0;
@@ -1160,25 +1273,25 @@ void QMLManager::commitChanges(QString diveId, QString number, QString date, QSt
 			k++;
 		}
 	}
-	if (myDive.suit != suit) {
+	if (myDive.suit() != suit) {
 		diveChanged = true;
-		free(d->suit);
+		arena_free(d->suit);
 		d->suit = copy_qstring(suit);
 	}
-	if (myDive.buddy != buddy) {
+	if (myDive.buddy() != buddy) {
 		if (buddy.contains(",")){
 			buddy = buddy.replace(QRegExp("\\s*,\\s*"), ", ");
 		}
 		diveChanged = true;
-		free(d->buddy);
+		arena_free(d->buddy);
 		d->buddy = copy_qstring(buddy);
 	}
-	if (myDive.divemaster != diveMaster) {
+	if (myDive.divemaster() != diveMaster) {
 		if (diveMaster.contains(",")){
 			diveMaster = diveMaster.replace(QRegExp("\\s*,\\s*"), ", ");
 		}
 		diveChanged = true;
-		free(d->divemaster);
+		arena_free(d->divemaster);
 		d->divemaster = copy_qstring(diveMaster);
 	}
 	if (myDive.rating != rating) {
@@ -1189,9 +1302,9 @@ void QMLManager::commitChanges(QString diveId, QString number, QString date, QSt
 		diveChanged = true;
 		d->visibility = visibility;
 	}
-	if (myDive.notes != notes) {
+	if (myDive.notes() != notes) {
 		diveChanged = true;
-		free(d->notes);
+		arena_free(d->notes);
 		d->notes = copy_qstring(notes);
 	}
 	// now that we have it all figured out, let's see what we need
@@ -1287,7 +1400,26 @@ void QMLManager::addDiveToTrip(int id, int tripId)
 	changesNeedSaving();
 }
 
+// Wait that long for further changes before saving, but never delay a save for
+// more than SAVE_MAX_DELAY_MSECS after the first unsaved change
+#define SAVE_DEBOUNCE_MSECS 5000
+#define SAVE_MAX_DELAY_MSECS 60000
+
 void QMLManager::changesNeedSaving()
+{
+	// Every save is a commit with its own tree, so editing a few dives in a row
+	// would create as many commits. Instead, coalesce the changes and only save
+	// once the user stopped editing for a while (or switched away from the app).
+	mark_divelist_changed(true);
+	emit syncStateChanged();
+	if (!saveTimer.isActive())
+		firstUnsavedChange.start();
+	qint64 delay = qMin<qint64>(SAVE_DEBOUNCE_MSECS, SAVE_MAX_DELAY_MSECS - firstUnsavedChange.elapsed());
+	saveTimer.start((int)qMax<qint64>(delay, 0));
+	updateAllGlobalLists();
+}
+
+void QMLManager::saveDelayedChanges()
 {
 	// we no longer save right away on iOS because file access is so slow; on the other hand,
 	// on Android the save as the user switches away doesn't seem to work... drat.
@@ -1295,14 +1427,11 @@ void QMLManager::changesNeedSaving()
 	// to be reasonably fast), but don't save at all (and only remember that we need to save things
 	// on iOS
 	// on all other platforms we just save the changes and be done with it
-	mark_divelist_changed(true);
-	emit syncStateChanged();
 #if defined(Q_OS_IOS)
 	saveChangesLocal();
 #else
 	saveChangesCloud(false);
 #endif
-	updateAllGlobalLists();
 }
 
 void QMLManager::openNoCloudRepo()
@@ -1333,7 +1462,13 @@ void QMLManager::openNoCloudRepo()
 
 void QMLManager::saveChangesLocal()
 {
-	if (unsavedChanges()) {
+	// Any save also writes the changes that are waiting for saveTimer
+	saveTimer.stop();
+	if (unsavedChanges() && cloudSyncRunning()) {
+		// The cache must not be written while it is synced
+		appendTextToLog("defer local save until the cloud sync is finished");
+		m_changedDuringSync = true;
+	} else if (unsavedChanges()) {
 		if (qPrefCloudStorage::cloud_verification_status() == qPrefCloudStorage::CS_NOCLOUD) {
 			if (empty_string(existing_filename)) {
 				QString filename = nocloud_localstorage();
@@ -1385,21 +1520,198 @@ void QMLManager::saveChangesCloud(bool forceRemoteSync)
 		return;
 	}
 
-	bool glo = git_local_only;
+	if (cloudSyncRunning()) {
+		appendTextToLog("cloud sync already running");
+		return;
+	}
+	if (forceRemoteSync)
+		startCloudSync();
+	else
+		scheduleCloudSync();
+}
+
+// Wait that long for further saves before pushing them in one sync. A deferred sync is
+// retried after SYNC_DEFER_MIN_MSECS, doubling up to SYNC_DEFER_MAX_MSECS. On a metered
+// network or in power saving mode the changes are pushed anyway once they have waited
+// for SYNC_DEFER_MAX_MSECS.
+#define SYNC_BATCH_MSECS 30000
+#define SYNC_DEFER_MIN_MSECS (5 * 60 * 1000)
+#define SYNC_DEFER_MAX_MSECS (60 * 60 * 1000)
+
+void QMLManager::scheduleCloudSync()
+{
+	if (syncScheduleTimer.isActive())
+		return;
+	syncScheduleTimer.start(SYNC_BATCH_MSECS);
+}
+
+// The reason to not sync now, or an empty string
+QString QMLManager::syncDeferReason() const
+{
+	if (!networkConfigManager.isOnline())
+		return QStringLiteral("offline");
+	switch (networkConfigManager.defaultConfiguration().bearerTypeFamily()) {
+	case QNetworkConfiguration::Bearer2G:
+		return QStringLiteral("slow network");
+	case QNetworkConfiguration::Bearer3G:
+	case QNetworkConfiguration::Bearer4G:
+		if (firstDeferredSync.isValid() && firstDeferredSync.elapsed() >= SYNC_DEFER_MAX_MSECS)
+			break;
+		return QStringLiteral("metered network");
+	default:
+		break;
+	}
+	if (powerSaveMode() && !(firstDeferredSync.isValid() && firstDeferredSync.elapsed() >= SYNC_DEFER_MAX_MSECS))
+		return QStringLiteral("power saving mode");
+	return QString();
+}
+
+void QMLManager::runScheduledCloudSync()
+{
+	syncScheduleTimer.stop();
+	if (cloudSyncRunning() || qPrefCloudStorage::cloud_verification_status() == qPrefCloudStorage::CS_NOCLOUD)
+		return;
+	QString reason = syncDeferReason();
+	if (!reason.isEmpty()) {
+		if (!m_syncDeferred)
+			firstDeferredSync.start();
+		m_syncDeferDelay = m_syncDeferDelay ? qMin(2 * m_syncDeferDelay, SYNC_DEFER_MAX_MSECS) : SYNC_DEFER_MIN_MSECS;
+		appendTextToLog(QStringLiteral("defer cloud sync for %1 s: %2").arg(m_syncDeferDelay / 1000).arg(reason));
+		syncScheduleTimer.start(m_syncDeferDelay);
+		setSyncDeferred(true);
+		return;
+	}
+	startCloudSync();
+}
+
+void QMLManager::setSyncDeferred(bool deferred)
+{
+	if (deferred == m_syncDeferred)
+		return;
+	m_syncDeferred = deferred;
+	if (!deferred) {
+		m_syncDeferDelay = 0;
+		firstDeferredSync.invalidate();
+	}
+	emit syncStateChanged();
+}
+
+bool QMLManager::cloudSyncRunning() const
+{
+	return cloudSyncWatcher.isRunning();
+}
+
+bool QMLManager::cloudSyncCancelled() const
+{
+	return m_cloudSyncCancelled;
+}
+
+void QMLManager::cancelCloudSync()
+{
+	if (!cloudSyncRunning())
+		return;
+	appendTextToLog("cloud sync cancelled by user");
+	m_cloudSyncCancelled = true;
+}
+
+// Sync the local cache with the cloud on a worker thread, so that the UI stays
+// responsive on slow connections. The worker only touches the git repository,
+// the dives are reloaded in cloudSyncFinished().
+void QMLManager::startCloudSync()
+{
+	QString url;
+	if (getCloudURL(url)) {
+		setNotificationText(consumeError());
+		return;
+	}
+	QByteArray fileName = QFile::encodeName(url);
+	const char *branch = nullptr, *remote = nullptr;
+	is_git_repository(fileName.data(), &branch, &remote, true);
+	if (!remote) {
+		appendTextToLog(QStringLiteral("cannot sync %1, not a git repository").arg(url));
+		return;
+	}
+	m_syncRemote = remote;
+	m_syncBranch = branch;
+	free((void *)remote);
+	free((void *)branch);
+
+	// this sync also pushes the changes of a batched or deferred sync
+	syncScheduleTimer.stop();
+	setSyncDeferred(false);
+
+	m_syncLoadedId = saved_git_id;
+	m_syncGitLocalOnly = git_local_only;
 	git_local_only = false;
+	m_cloudSyncCancelled = false;
+	cloudSyncTimer.start();
+	appendTextToLog("start cloud sync in the background");
+	QByteArray syncRemote = m_syncRemote, syncBranch = m_syncBranch;
+	cloudSyncWatcher.setFuture(QtConcurrent::run([syncRemote, syncBranch]() {
+		int error = sync_local_cache(syncRemote.constData(), syncBranch.constData());
+		// Nobody else touches the cache now, so this is a good time to repack it.
+		// This is a no-op unless many loose objects accumulated.
+		if (!error && !git_sync_timings.cancelled)
+			maintain_local_cache(syncRemote.constData(), syncBranch.constData(), 5000);
+		return error;
+	}));
+	emit cloudSyncRunningChanged();
+}
+
+void QMLManager::cloudSyncFinished()
+{
+	int error = cloudSyncWatcher.result();
+	bool synced = git_remote_sync_successful && !git_sync_timings.cancelled;
+	git_local_only = m_syncGitLocalOnly;
+	m_cloudSyncCancelled = false;
+	emit cloudSyncRunningChanged();
+	appendTextToLog(QStringLiteral("cloud sync %1 after %2 ms: connect %3 ms, fetch %4 ms (%5 bytes), merge %6 ms, checkout %7 ms")
+			.arg(git_sync_timings.cancelled ? "cancelled" : error ? "failed" : "done")
+			.arg(cloudSyncTimer.elapsed()).arg(git_sync_timings.connect_ms).arg(git_sync_timings.fetch_ms)
+			.arg((qulonglong)git_sync_timings.fetch_bytes).arg(git_sync_timings.merge_ms).arg(git_sync_timings.checkout_ms));
+	if (error)
+		setNotificationText(consumeError());
+
+	if (m_changedDuringSync || unsavedChanges()) {
+		// The dives were changed during the sync, which may have moved the branch of the cache.
+		// Save them on top of the commit they were loaded from and let another sync merge them.
+		m_changedDuringSync = false;
+		if (!m_syncLoadedId.isEmpty())
+			reset_local_cache(m_syncRemote.constData(), m_syncBranch.constData(), m_syncLoadedId.constData());
+		saveChangesLocal();
+		if (synced)
+			startCloudSync();
+		else
+			updateHaveLocalChanges(true);
+		return;
+	}
+
+	// The cache is up to date, so reload it without syncing again. A merge set
+	// saved_git_id to the merged commit: go back to the loaded one so that the
+	// change is detected.
+	git_oid loaded;
+	if (!m_syncLoadedId.isEmpty() && !git_oid_fromstr(&loaded, m_syncLoadedId.constData()))
+		set_git_id(&loaded);
+	QElapsedTimer reparseTimer;
+	reparseTimer.start();
+	bool glo = git_local_only;
+	git_local_only = true;
 	loadDivesWithValidCredentials();
 	git_local_only = glo;
+	git_remote_sync_successful = synced;
+	updateHaveLocalChanges(!synced);
+	appendTextToLog(QStringLiteral("reloading the synced dives took %1 ms").arg(reparseTimer.elapsed()));
 }
 
 void QMLManager::undo()
 {
-	Command::getUndoStack()->undo();
+	Command::undo();
 	changesNeedSaving();
 }
 
 void QMLManager::redo()
 {
-	Command::getUndoStack()->redo();
+	Command::redo();
 	changesNeedSaving();
 }
 
@@ -2274,6 +2586,8 @@ QString QMLManager::getSyncState() const
 {
 	if (unsavedChanges())
 		return tr("(unsaved changes in memory)");
+	if (localChanges && m_syncDeferred)
+		return tr("(changes synced locally, upload postponed)");
 	if (localChanges)
 		return tr("(changes synced locally)");
 	return tr("(synced with cloud)");
@@ -5,10 +5,14 @@
 #include <QObject>
 #include <QString>
 #include <QNetworkAccessManager>
+#include <QNetworkConfigurationManager>
 #include <QScreen>
 #include <QElapsedTimer>
+#include <QTimer>
 #include <QColor>
 #include <QFile>
+#include <QFutureWatcher>
+#include <atomic>
 
 #include "core/btdiscovery.h"
 #include "core/gpslocation.h"
@@ -61,6 +65,7 @@ class QMLManager : public QObject {
 	Q_PROPERTY(bool diveListProcessing MEMBER m_diveListProcessing  WRITE setDiveListProcessing NOTIFY diveListProcessingChanged)
 	Q_PROPERTY(bool initialized MEMBER m_initialized NOTIFY initializedChanged)
 	Q_PROPERTY(QString syncState READ getSyncState NOTIFY syncStateChanged)
+	Q_PROPERTY(bool cloudSyncRunning READ cloudSyncRunning NOTIFY cloudSyncRunningChanged)
 
 public:
 	QMLManager();
@@ -123,6 +128,7 @@ public:
 	Q_INVOKABLE void importCacheRepo(QString repo);
 
 	static QMLManager *instance();
+	bool cloudSyncCancelled() const;
 	Q_INVOKABLE void registerError(QString error);
 	QString consumeError();
 
@@ -194,6 +200,7 @@ public slots:
 	void changesNeedSaving();
 	void openNoCloudRepo();
 	void saveChangesCloud(bool forceRemoteSync);
+	void cancelCloudSync();
 	void selectDive(int id);
 	void deleteDive(int id);
 	void toggleDiveInvalid(int id);
@@ -282,11 +289,43 @@ private:
 	bool verifyCredentials(QString email, QString password, QString pin);
 	void loadDivesWithValidCredentials();
 	void revertToNoCloudIfNeeded();
+	void applyGitPrefs();
 	void consumeFinishedLoad();
 	void mergeLocalRepo();
 	void openLocalThenRemote(QString url);
 	void saveChangesLocal();
 
+	// Changes are saved in batches: a save is only done when no further change was
+	// made for a few seconds, or when the app is sent to the background.
+	QTimer saveTimer;
+	QElapsedTimer firstUnsavedChange;
+	void saveDelayedChanges();
+
+	// The sync with the cloud runs in the background. The saves that are requested
+	// meanwhile are done, and synced again, when it is finished.
+	QFutureWatcher<int> cloudSyncWatcher;
+	std::atomic<bool> m_cloudSyncCancelled;
+	bool m_changedDuringSync;
+	bool m_syncGitLocalOnly;
+	QByteArray m_syncLoadedId, m_syncRemote, m_syncBranch;
+	QElapsedTimer cloudSyncTimer;
+	bool cloudSyncRunning() const;
+	void startCloudSync();
+	void cloudSyncFinished();
+
+	// Automatic pushes are batched and deferred while the phone is offline, on a
+	// slow or metered network or in power saving mode. Syncs requested by the user
+	// are started right away.
+	QTimer syncScheduleTimer;
+	QElapsedTimer firstDeferredSync;
+	QNetworkConfigurationManager networkConfigManager;
+	bool m_syncDeferred;
+	int m_syncDeferDelay;
+	void scheduleCloudSync();
+	void runScheduledCloudSync();
+	void setSyncDeferred(bool deferred);
+	QString syncDeferReason() const;
+
 #if defined(Q_OS_ANDROID) || defined(Q_OS_IOS)
 	QString appLogFileName;
 	QFile appLogFile;
@@ -321,6 +360,7 @@ signals:
 	void redoTextChanged();
 	void restartDownloadSignal();
 	void syncStateChanged();
+	void cloudSyncRunningChanged();
 
 	// From upload process
 	void uploadFinish(bool success, const QString &text);
@@ -29,6 +29,7 @@ SOURCES += ../../subsurface-mobile-main.cpp \
 	../../core/gpslocation.cpp \
 	../../core/imagedownloader.cpp \
 	../../core/downloadfromdcthread.cpp \
+	../../core/downloadstats.cpp \
 	../../core/qtserialbluetooth.cpp \
 	../../core/plannernotes.c \
 	../../core/uemis-downloader.c \
@@ -55,16 +56,20 @@ SOURCES += ../../subsurface-mobile-main.cpp \
 	../../core/device.cpp \
 	../../core/dive.c \
 	../../core/divefilter.cpp \
+	../../core/divesummarytable.cpp \
 	../../core/filterconstraint.cpp \
 	../../core/filterpreset.cpp \
+	../../core/fingerprint.c \
 	../../core/divelist.c \
 	../../core/gas-model.c \
 	../../core/gaspressures.c \
 	../../core/git-access.c \
+	../../core/gitmaintenance.cpp \
 	../../core/liquivision.c \
 	../../core/load-git.c \
 	../../core/parse-xml.c \
 	../../core/parse.c \
+	../../core/parsequeue.cpp \
 	../../core/picture.c \
 	../../core/pictureobj.cpp \
 	../../core/import-suunto.c \
@@ -73,8 +78,18 @@ SOURCES += ../../subsurface-mobile-main.cpp \
 	../../core/import-cobalt.c \
 	../../core/import-divinglog.c \
 	../../core/import-csv.c \
+	../../core/importfiles.cpp \
 	../../core/save-html.c \
 	../../core/statistics.c \
+	../../core/statisticsstore.cpp \
+	../../core/arena.c \
+	../../core/samplecodec.c \
+	../../core/samplecolumns.c \
+	../../core/sampleresidency.c \
+	../../core/snapshot.c \
+	../../core/stringpool.c \
+	../../core/trace.cpp \
+	../../core/memusage.c \
 	../../core/worldmap-save.c \
 	../../core/libdivecomputer.c \
 	../../core/version.c \
@@ -94,6 +109,7 @@ SOURCES += ../../subsurface-mobile-main.cpp \
 	../../core/strtod.c \
 	../../core/tag.c \
 	../../core/taxonomy.c \
+	../../core/thumbnailstore.cpp \
 	../../core/time.c \
 	../../core/trip.c \
 	../../core/units.c \
@@ -202,19 +218,32 @@ HEADERS += \
 	../../core/devicedetails.h \
 	../../core/dive.h \
 	../../core/git-access.h \
+	../../core/gitmaintenance.h \
 	../../core/gpslocation.h \
 	../../core/imagedownloader.h \
+	../../core/importfiles.h \
 	../../core/pref.h \
 	../../core/profile.h \
 	../../core/qthelper.h \
 	../../core/save-html.h \
 	../../core/statistics.h \
+	../../core/statisticsstore.h \
+	../../core/arena.h \
+	../../core/samplecodec.h \
+	../../core/samplecolumns.h \
+	../../core/sampleresidency.h \
+	../../core/snapshot.h \
+	../../core/stringpool.h \
+	../../core/trace.h \
+	../../core/memusage.h \
 	../../core/units.h \
 	../../core/version.h \
+	../../core/parsequeue.h \
 	../../core/picture.h \
 	../../core/pictureobj.h \
 	../../core/planner.h \
 	../../core/divesite.h \
+	../../core/bytereader.h \
 	../../core/checkcloudconnection.h \
 	../../core/cochran.h \
 	../../core/color.h \
@@ -223,8 +252,10 @@ HEADERS += \
 	../../core/deco.h \
 	../../core/display.h \
 	../../core/divefilter.h \
+	../../core/divesummarytable.h \
 	../../core/filterconstraint.h \
 	../../core/filterpreset.h \
+	../../core/fingerprint.h \
 	../../core/divelist.h \
 	../../core/divelogexportlogic.h \
 	../../core/divesitehelpers.h \
@@ -243,12 +274,14 @@ HEADERS += \
 	../../core/subsurfacestartup.h \
 	../../core/subsurfacesysinfo.h \
 	../../core/taxonomy.h \
+	../../core/thumbnailstore.h \
 	../../core/uemis.h \
 	../../core/webservice.h \
 	../../core/windowtitleupdate.h \
 	../../core/worldmap-options.h \
 	../../core/worldmap-save.h \
 	../../core/downloadfromdcthread.h \
+	../../core/downloadstats.h \
 	../../core/btdiscovery.h \
 	../../core/connectionlistmodel.h \
 	../../core/qt-ble.h \
@@ -1,10 +1,54 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "profile-widget/animationfunctions.h"
 #include "core/pref.h"
+#include <QHash>
+#include <QParallelAnimationGroup>
 #include <QPropertyAnimation>
+#include <QTimer>
 
 namespace Animations {
 
+	// Above these, replots are done without animations
+	static const int maxAnimatedItems = 200;
+	static const qint64 maxFrameTime = 100; // ms
+
+	// The moves requested during one replot are collected in one group,
+	// which is started when control returns to the event loop. Thus, all
+	// of them are driven by the group instead of each having its own
+	// animation running.
+	static QParallelAnimationGroup *pendingMoves = nullptr;
+	static QHash<QObject *, QPropertyAnimation *> pendingTargets;
+
+	static void startPendingMoves()
+	{
+		QParallelAnimationGroup *group = pendingMoves;
+		pendingMoves = nullptr;
+		pendingTargets.clear();
+		if (group)
+			group->start(QAbstractAnimation::DeleteWhenStopped);
+	}
+
+	static void addPendingMove(QObject *obj, QPropertyAnimation *animation)
+	{
+		if (!pendingMoves) {
+			pendingMoves = new QParallelAnimationGroup;
+			QTimer::singleShot(0, &startPendingMoves);
+		}
+		// Only the last move of an item counts
+		QPropertyAnimation *old = pendingTargets.value(obj);
+		if (old && old->targetObject() == obj) {
+			pendingMoves->removeAnimation(old);
+			delete old;
+		}
+		pendingMoves->addAnimation(animation);
+		pendingTargets.insert(obj, animation);
+	}
+
+	bool withinBudget(int items, qint64 lastFrameTime)
+	{
+		return items <= maxAnimatedItems && lastFrameTime <= maxFrameTime;
+	}
+
 	void hide(QObject *obj, int speed)
 	{
 		if (speed != 0) {
@@ -49,7 +93,7 @@ namespace Animations {
 			animation->setDuration(prefs.animation_speed);
 			animation->setStartValue(obj->property("pos").toPointF());
 			animation->setEndValue(QPointF(x, y));
-			animation->start(QAbstractAnimation::DeleteWhenStopped);
+			addPendingMove(obj, animation);
 		} else {
 			obj->setProperty("pos", QPointF(x, y));
 		}
@@ -14,6 +14,9 @@ namespace Animations {
 	void moveTo(QObject *obj, int speed, const QPointF &pos);
 	void animDelete(QObject *obj, int speed);
 	void scaleTo(QObject *obj, int speed, qreal scale);
+	// Whether a replot that animates that many items is still smooth
+	// when the last replot took lastFrameTime milliseconds.
+	bool withinBudget(int items, qint64 lastFrameTime);
 }
 
 #endif // ANIMATIONFUNCTIONS_H
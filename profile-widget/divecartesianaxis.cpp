@@ -125,15 +125,32 @@ void DiveCartesianAxis::setLinesVisible(bool arg1)
 	}
 }
 
+// Items that are not needed anymore are faded out and kept for later reuse,
+// so that zooming does not create and delete scene items all the time.
 template <typename T>
-void emptyList(QList<T *> &list, int steps, int speed)
+void emptyList(QList<T *> &list, QList<T *> &spare, int steps, int speed)
 {
 	while (list.size() > steps) {
 		T *removedItem = list.takeLast();
-		Animations::animDelete(removedItem, speed);
+		Animations::hide(removedItem, speed);
+		spare.append(removedItem);
 	}
 }
 
+// Returns a spare item whose fade out animation is finished, or null.
+template <typename T>
+T *takeSpare(QList<T *> &spare)
+{
+	for (int i = spare.size() - 1; i >= 0; i--) {
+		if (spare[i]->opacity() == 0.0) {
+			T *item = spare.takeAt(i);
+			item->setOpacity(1.0);
+			return item;
+		}
+	}
+	return nullptr;
+}
+
 void DiveCartesianAxis::updateTicks(color_index_t color)
 {
 	if (!scene() || (!changed && !profileWidget->getPrintMode()))
@@ -149,8 +166,8 @@ void DiveCartesianAxis::updateTicks(color_index_t color)
 	if (steps < 1)
 		return;
 
-	emptyList(labels, steps, profileWidget->animSpeed);
-	emptyList(lines, steps, profileWidget->animSpeed);
+	emptyList(labels, spareLabels, steps, profileWidget->animSpeed);
+	emptyList(lines, spareLines, steps, profileWidget->animSpeed);
 
 	// Move the remaining ticks / text to their correct positions
 	// regarding the possible new values for the axis
@@ -203,7 +220,9 @@ void DiveCartesianAxis::updateTicks(color_index_t color)
 		} else {
 			childPos = begin - i * stepSize;
 		}
-		DiveTextItem *label = new DiveTextItem(this);
+		DiveTextItem *label = takeSpare(spareLabels);
+		if (!label)
+			label = new DiveTextItem(this);
 		label->setText(textForValue(currValueText));
 		label->setBrush(colorForValue(currValueText));
 		label->setScale(fontLabelScale());
@@ -228,7 +247,9 @@ void DiveCartesianAxis::updateTicks(color_index_t color)
 		} else {
 			childPos = begin - i * stepSize;
 		}
-		DiveLineItem *line = new DiveLineItem(this);
+		DiveLineItem *line = takeSpare(spareLines);
+		if (!line)
+			line = new DiveLineItem(this);
 		QPen pen = gridPen();
 		pen.setBrush(getColor(color));
 		line->setPen(pen);
@@ -65,6 +65,8 @@ protected:
 	Orientation orientation;
 	QList<DiveTextItem *> labels;
 	QList<DiveLineItem *> lines;
+	QList<DiveTextItem *> spareLabels;
+	QList<DiveLineItem *> spareLines;
 	double min;
 	double max;
 	double interval;
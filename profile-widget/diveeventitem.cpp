@@ -10,6 +10,8 @@
 #include "core/membuffer.h"
 #include "core/subsurface-string.h"
 
+#include <QHash>
+
 #define DEPTH_NOT_FOUND (-2342)
 
 extern struct ev_select *ev_namelist;
@@ -66,6 +68,18 @@ void DiveEventItem::setEvent(struct event *ev, struct gasmix lastgasmix)
 	recalculatePos(0);
 }
 
+// Loading and scaling the icons is expensive compared to the rest of the profile
+// update, and there are only a handful of them: keep the scaled pixmaps around.
+static QPixmap scaledPixmap(const QString &name, int size)
+{
+	static QHash<QPair<QString, int>, QPixmap> cache;
+	QPair<QString, int> key(name, size);
+	auto it = cache.find(key);
+	if (it == cache.end())
+		it = cache.insert(key, QPixmap(name).scaled(size, size, Qt::KeepAspectRatio, Qt::SmoothTransformation));
+	return *it;
+}
+
 void DiveEventItem::setupPixmap(struct gasmix lastgasmix)
 {
 	const IconMetrics& metrics = defaultIconMetrics();
@@ -83,8 +97,8 @@ void DiveEventItem::setupPixmap(struct gasmix lastgasmix)
 #endif
 	int sz_pix = sz_bigger/2; // ex 20px
 
-#define EVENT_PIXMAP(PIX) QPixmap(QString(PIX)).scaled(sz_pix, sz_pix, Qt::KeepAspectRatio, Qt::SmoothTransformation)
-#define EVENT_PIXMAP_BIGGER(PIX) QPixmap(QString(PIX)).scaled(sz_bigger, sz_bigger, Qt::KeepAspectRatio, Qt::SmoothTransformation)
+#define EVENT_PIXMAP(PIX) scaledPixmap(QString(PIX), sz_pix)
+#define EVENT_PIXMAP_BIGGER(PIX) scaledPixmap(QString(PIX), sz_bigger)
 	if (empty_string(internalEvent->name)) {
 		setPixmap(EVENT_PIXMAP(":status-warning-icon"));
 	} else if (same_string_caseinsensitive(internalEvent->name, "modechange")) {
@@ -259,13 +273,13 @@ bool DiveEventItem::shouldBeHidden()
 
 int DiveEventItem::depthAtTime(int time)
 {
-	QModelIndexList result = dataModel->match(dataModel->index(0, DivePlotDataModel::TIME), Qt::DisplayRole, time);
-	if (result.isEmpty()) {
+	int row = dataModel->rowAtTime(time);
+	if (row < 0) {
 		qWarning("can't find a spot in the dataModel");
 		hide();
 		return DEPTH_NOT_FOUND;
 	}
-	return dataModel->data(dataModel->index(result.first().row(), DivePlotDataModel::DEPTH)).toInt();
+	return dataModel->data().entry[row].depth;
 }
 
 void DiveEventItem::recalculatePos(int speed)
@@ -273,12 +287,6 @@ void DiveEventItem::recalculatePos(int speed)
 	if (!vAxis || !hAxis || !internalEvent || !dataModel)
 		return;
 
-	QModelIndexList result = dataModel->match(dataModel->index(0, DivePlotDataModel::TIME), Qt::DisplayRole, internalEvent->time.seconds);
-	if (result.isEmpty()) {
-		qWarning("can't find a spot in the dataModel");
-		hide();
-		return;
-	}
 	int depth = depthAtTime(internalEvent->time.seconds);
 	if (depth == DEPTH_NOT_FOUND)
 		return;
@@ -15,6 +15,9 @@
 #include "libdivecomputer/parser.h"
 #include "profile-widget/profilewidget2.h"
 
+#include <algorithm>
+#include <cmath>
+
 AbstractProfilePolygonItem::AbstractProfilePolygonItem() : QObject(), QGraphicsPolygonItem(), hAxis(NULL), vAxis(NULL), dataModel(NULL), hDataColumn(-1), vDataColumn(-1)
 {
 	setCacheMode(DeviceCoordinateCache);
@@ -55,6 +58,7 @@ void AbstractProfilePolygonItem::setModel(DivePlotDataModel *model)
 
 void AbstractProfilePolygonItem::modelDataRemoved(const QModelIndex&, int, int)
 {
+	fullPolygon.clear();
 	setPolygon(QPolygonF());
 	qDeleteAll(texts);
 	texts.clear();
@@ -91,6 +95,62 @@ bool AbstractProfilePolygonItem::shouldCalculateStuff(const QModelIndex &topLeft
 	return true;
 }
 
+// Reduce the points of a polygon, which is ordered by x, to the first, last, highest and lowest
+// one in each column of the given width. Drawn at that resolution, the result looks the same.
+static QPolygonF decimatePolygon(const QPolygonF &poly, qreal columnWidth)
+{
+	if (columnWidth <= 0.0 || poly.size() <= 4)
+		return poly;
+
+	QPolygonF res;
+	int first = 0;
+	while (first < poly.size()) {
+		qreal column = floor(poly[first].x() / columnWidth);
+		int last = first, top = first, bottom = first;
+		while (last + 1 < poly.size() && floor(poly[last + 1].x() / columnWidth) == column) {
+			++last;
+			if (poly[last].y() < poly[top].y())
+				top = last;
+			if (poly[last].y() > poly[bottom].y())
+				bottom = last;
+		}
+		// Add the points of the column in their original order
+		res.append(poly[first]);
+		int mid1 = std::min(top, bottom), mid2 = std::max(top, bottom);
+		if (mid1 != first && mid1 != last)
+			res.append(poly[mid1]);
+		if (mid2 != mid1 && mid2 != first && mid2 != last)
+			res.append(poly[mid2]);
+		if (last != first)
+			res.append(poly[last]);
+		first = last + 1;
+	}
+	return res;
+}
+
+void AbstractProfilePolygonItem::setDecimatedPolygon(const QPolygonF &poly)
+{
+	fullPolygon = poly;
+	updateDecimation();
+}
+
+void AbstractProfilePolygonItem::updateDecimation()
+{
+	if (fullPolygon.isEmpty())
+		return;
+
+	// Width of a pixel in scene coordinates. Don't decimate for printing, where
+	// the resolution of the output is not that of the widget.
+	qreal columnWidth = 0.0;
+	if (scene() && !scene()->views().isEmpty()) {
+		ProfileWidget2 *profile = qobject_cast<ProfileWidget2 *>(scene()->views().first());
+		qreal scale = profile ? profile->transform().m11() : 0.0;
+		if (profile && !profile->getPrintMode() && scale > 0.0)
+			columnWidth = 1.0 / scale;
+	}
+	setPolygon(decimatePolygon(fullPolygon, columnWidth));
+}
+
 void AbstractProfilePolygonItem::modelDataChanged(const QModelIndex&, const QModelIndex&)
 {
 	// Calculate the polygon. This is the polygon that will be painted on screen
@@ -100,8 +160,8 @@ void AbstractProfilePolygonItem::modelDataChanged(const QModelIndex&, const QMod
 	// to our coordinates, store. no painting is done here.
 	QPolygonF poly;
 	for (int i = 0, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
-		qreal horizontalValue = dataModel->index(i, hDataColumn).data().toReal();
-		qreal verticalValue = dataModel->index(i, vDataColumn).data().toReal();
+		qreal horizontalValue = dataModel->value(i, hDataColumn);
+		qreal verticalValue = dataModel->value(i, vDataColumn);
 		QPointF point(hAxis->posAtValue(horizontalValue), vAxis->posAtValue(verticalValue));
 		poly.append(point);
 	}
@@ -140,9 +200,9 @@ void DiveProfileItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *o
 	pen.setWidth(2);
 	QPolygonF poly = polygon();
 	// This paints the colors of the velocities.
+	const plot_data *entry = dataModel->data().entry;
 	for (int i = 1, count = dataModel->rowCount(); i < count; i++) {
-		QModelIndex colorIndex = dataModel->index(i, DivePlotDataModel::COLOR);
-		pen.setBrush(QBrush(colorIndex.data(Qt::BackgroundRole).value<QColor>()));
+		pen.setBrush(QBrush(getColor((color_index_t)(VELOCITY_COLORS_START_IDX + entry[i].velocity))));
 		painter->setPen(pen);
 		if (i < poly.count())
 			painter->drawLine(poly[i - 1], poly[i]);
@@ -153,10 +213,13 @@ void DiveProfileItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *o
 int DiveProfileItem::maxCeiling(int row)
 {
 	int max = -1;
-	plot_data *entry = dataModel->data().entry + row;
+	const plot_info &pInfo = dataModel->data();
+	if (!pInfo.tissues)
+		return max;
+	const plot_tissue_data *tissues = pInfo.tissues + row;
 	for (int tissue = 0; tissue < 16; tissue++) {
-		if (max < entry->ceilings[tissue])
-			max = entry->ceilings[tissue];
+		if (max < tissues->ceilings[tissue])
+			max = tissues->ceilings[tissue];
 	}
 	return max;
 }
@@ -288,10 +351,10 @@ void DiveHeartrateItem::modelDataChanged(const QModelIndex &topLeft, const QMode
 	// Ignore empty values. a heart rate of 0 would be a bad sign.
 	QPolygonF poly;
 	for (int i = 0, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
-		int hr = dataModel->index(i, vDataColumn).data().toInt();
+		int hr = lrint(dataModel->value(i, vDataColumn));
 		if (!hr)
 			continue;
-		sec = dataModel->index(i, hDataColumn).data().toInt();
+		sec = lrint(dataModel->value(i, hDataColumn));
 		QPointF point(hAxis->posAtValue(sec), vAxis->posAtValue(hr));
 		poly.append(point);
 		if (hr == hist[2].hr)
@@ -320,7 +383,7 @@ void DiveHeartrateItem::modelDataChanged(const QModelIndex &topLeft, const QMode
 		createTextItem(sec, hr);
 		last_printed_hr = hr;
 	}
-	setPolygon(poly);
+	setDecimatedPolygon(poly);
 
 	if (texts.count())
 		texts.last()->setAlignment(Qt::AlignLeft | Qt::AlignBottom);
@@ -362,15 +425,44 @@ void DivePercentageItem::modelDataChanged(const QModelIndex &topLeft, const QMod
 	if (!shouldCalculateStuff(topLeft, bottomRight))
 		return;
 
-	// Ignore empty values. a heart rate of 0 would be a bad sign.
+	// The heat map is rendered into an image here and only scaled when
+	// painting, since the profile is repainted much more often than the
+	// data changes. The image has one pixel per time step, so that plot
+	// entries at irregular times (e.g. events) keep their width.
 	QPolygonF poly;
+	QVector<int> times;
+	QVector<QRgb> colors; // color of the segment ending at each point
+	const struct event *ev = NULL;
+	struct gasmix gasmix = gasmix_air;
 	for (int i = 0, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
-		sec = dataModel->index(i, hDataColumn).data().toInt();
+		sec = lrint(dataModel->value(i, hDataColumn));
 		QPointF point(hAxis->posAtValue(sec), vAxis->posAtValue(64 - 4 * tissueIndex));
 		poly.append(point);
+		times.append(sec);
+
+		double value = dataModel->value(i, vDataColumn);
+		gasmix = get_gasmix(&displayed_dive, displayed_dc, sec, &ev, gasmix);
+		int inert = 1000 - get_o2(gasmix);
+		colors.append(ColorScale(value, inert).rgb());
 	}
 	setPolygon(poly);
 
+	image = QImage();
+	int duration = times.isEmpty() ? 0 : times.last() - times.first();
+	if (duration > 0) {
+		const int maxWidth = 16384;
+		int step = (duration + maxWidth - 1) / maxWidth;
+		int width = (duration + step - 1) / step;
+		image = QImage(width, 1, QImage::Format_RGB32);
+		QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(0));
+		for (int x = 0, i = 1; x < width; x++) {
+			int t = times.first() + x * step;
+			while (i < times.count() - 1 && times[i] <= t)
+				i++;
+			line[x] = colors[i];
+		}
+	}
+
 	if (texts.count())
 		texts.last()->setAlignment(Qt::AlignLeft | Qt::AlignBottom);
 }
@@ -401,26 +493,14 @@ QColor DivePercentageItem::ColorScale(double value, int inert)
 
 void DivePercentageItem::paint(QPainter *painter, const QStyleOptionGraphicsItem*, QWidget*)
 {
-	if (polygon().isEmpty())
+	if (polygon().isEmpty() || image.isNull())
 		return;
-	painter->save();
-	QPen mypen;
-	mypen.setCapStyle(Qt::FlatCap);
-	mypen.setCosmetic(false);
+	// Same area as the one unit wide line that was drawn for each segment
 	QPolygonF poly = polygon();
-	for (int i = 1, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
-		if (i < poly.count()) {
-			double value = dataModel->index(i, vDataColumn).data().toDouble();
-			struct gasmix gasmix = gasmix_air;
-			const struct event *ev = NULL;
-			int sec = dataModel->index(i, DivePlotDataModel::TIME).data().toInt();
-			gasmix = get_gasmix(&displayed_dive, displayed_dc, sec, &ev, gasmix);
-			int inert = 1000 - get_o2(gasmix);
-			mypen.setBrush(QBrush(ColorScale(value, inert)));
-			painter->setPen(mypen);
-			painter->drawLine(poly[i - 1], poly[i]);
-		}
-	}
+	QRectF rect(poly.first().x(), poly.first().y() - 0.5, poly.last().x() - poly.first().x(), 1.0);
+	painter->save();
+	painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
+	painter->drawImage(rect, image);
 	painter->restore();
 }
 
@@ -445,14 +525,14 @@ void DiveAmbPressureItem::modelDataChanged(const QModelIndex &topLeft, const QMo
 	// Ignore empty values. a heart rate of 0 would be a bad sign.
 	QPolygonF poly;
 	for (int i = 0, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
-		int hr = dataModel->index(i, vDataColumn).data().toInt();
+		int hr = lrint(dataModel->value(i, vDataColumn));
 		if (!hr)
 			continue;
-		sec = dataModel->index(i, hDataColumn).data().toInt();
+		sec = lrint(dataModel->value(i, hDataColumn));
 		QPointF point(hAxis->posAtValue(sec), vAxis->posAtValue(hr));
 		poly.append(point);
 	}
-	setPolygon(poly);
+	setDecimatedPolygon(poly);
 
 	if (texts.count())
 		texts.last()->setAlignment(Qt::AlignLeft | Qt::AlignBottom);
@@ -490,14 +570,14 @@ void DiveGFLineItem::modelDataChanged(const QModelIndex &topLeft, const QModelIn
 	// Ignore empty values. a heart rate of 0 would be a bad sign.
 	QPolygonF poly;
 	for (int i = 0, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
-		int hr = dataModel->index(i, vDataColumn).data().toInt();
+		int hr = lrint(dataModel->value(i, vDataColumn));
 		if (!hr)
 			continue;
-		sec = dataModel->index(i, hDataColumn).data().toInt();
+		sec = lrint(dataModel->value(i, hDataColumn));
 		QPointF point(hAxis->posAtValue(sec), vAxis->posAtValue(hr));
 		poly.append(point);
 	}
-	setPolygon(poly);
+	setDecimatedPolygon(poly);
 
 	if (texts.count())
 		texts.last()->setAlignment(Qt::AlignLeft | Qt::AlignBottom);
@@ -535,11 +615,11 @@ void DiveTemperatureItem::modelDataChanged(const QModelIndex &topLeft, const QMo
 	// Ignore empty values. things do not look good with '0' as temperature in kelvin...
 	QPolygonF poly;
 	for (int i = 0, modelDataCount = dataModel->rowCount(); i < modelDataCount; i++) {
-		int mkelvin = dataModel->index(i, vDataColumn).data().toInt();
+		int mkelvin = lrint(dataModel->value(i, vDataColumn));
 		if (!mkelvin)
 			continue;
 		last_valid_temp = mkelvin;
-		sec = dataModel->index(i, hDataColumn).data().toInt();
+		sec = lrint(dataModel->value(i, hDataColumn));
 		QPointF point(hAxis->posAtValue(sec), vAxis->posAtValue(mkelvin));
 		poly.append(point);
 
@@ -556,7 +636,7 @@ void DiveTemperatureItem::modelDataChanged(const QModelIndex &topLeft, const QMo
 			createTextItem(sec, mkelvin);
 		last_printed_temp = mkelvin;
 	}
-	setPolygon(poly);
+	setDecimatedPolygon(poly);
 
 	/* it would be nice to print the end temperature, if it's
 	* different or if the last temperature print has been more
@@ -623,7 +703,7 @@ void DiveMeanDepthItem::modelDataChanged(const QModelIndex &topLeft, const QMode
 		poly.append(point);
 	}
 	lastRunningSum = meandepthvalue;
-	setPolygon(poly);
+	setDecimatedPolygon(poly);
 	createTextItem();
 }
 
@@ -849,7 +929,7 @@ void DiveCalculatedCeiling::modelDataChanged(const QModelIndex &topLeft, const Q
 
 	poly.prepend(QPointF(p1.x(), vAxis->posAtValue(0)));
 	poly.append(QPointF(p2.x(), vAxis->posAtValue(0)));
-	setPolygon(poly);
+	setDecimatedPolygon(poly);
 
 	QLinearGradient pat(0, polygon().boundingRect().top(), 0, polygon().boundingRect().bottom());
 	pat.setColorAt(0, getColor(CALC_CEILING_SHALLOW));
@@ -904,7 +984,7 @@ void DiveReportedCeiling::modelDataChanged(const QModelIndex &topLeft, const QMo
 			p.append(QPointF(hAxis->posAtValue(entry->sec), vAxis->posAtValue(0)));
 		}
 	}
-	setPolygon(p);
+	setDecimatedPolygon(p);
 	QLinearGradient pat(0, p.boundingRect().top(), 0, p.boundingRect().bottom());
 	// does the user want the ceiling in "surface color" or in red?
 	if (prefs.redceiling) {
@@ -959,8 +1039,8 @@ void PartialPressureGasItem::modelDataChanged(const QModelIndex &topLeft, const
 		threshold_min = *thresholdPtrMin;
 	bool inAlertFragment = false;
 	for (int i = 0; i < dataModel->rowCount(); i++, entry++) {
-		double value = dataModel->index(i, vDataColumn).data().toDouble();
-		int time = dataModel->index(i, hDataColumn).data().toInt();
+		double value = dataModel->value(i, vDataColumn);
+		int time = lrint(dataModel->value(i, hDataColumn));
 		QPointF point(hAxis->posAtValue(time), vAxis->posAtValue(value));
 		poly.push_back(point);
 		if (thresholdPtrMax && value >= threshold_max) {
@@ -985,7 +1065,7 @@ void PartialPressureGasItem::modelDataChanged(const QModelIndex &topLeft, const
 			inAlertFragment = false;
 		}
 	}
-	setPolygon(poly);
+	setDecimatedPolygon(poly);
 	/*
 	createPPLegend(trUtf8("pN₂"), getColor(PN2), legendPos);
 	*/
@@ -1022,3 +1102,49 @@ void PartialPressureGasItem::setColors(const QColor &normal, const QColor &alert
 	normalColor = normal;
 	alertColor = alert;
 }
+
+DiveComparisonItem::DiveComparisonItem(const QVector<QPointF> &depthsIn, const QString &labelIn, const QColor &color) :
+	depths(depthsIn),
+	label(labelIn)
+{
+	QPen pen(color);
+	pen.setCosmetic(true);
+	pen.setWidth(1);
+	setPen(pen);
+}
+
+void DiveComparisonItem::modelDataChanged(const QModelIndex &, const QModelIndex &)
+{
+	if (!hAxis || !vAxis || depths.isEmpty())
+		return;
+
+	qDeleteAll(texts);
+	texts.clear();
+	QPolygonF poly;
+	poly.reserve(depths.size());
+	for (const QPointF &p: depths)
+		poly.append(QPointF(hAxis->posAtValue(p.x()), vAxis->posAtValue(p.y())));
+	// Many overlaid dives have to stay interactive: only keep what can be seen at this zoom level
+	setDecimatedPolygon(poly);
+
+	// Label the curve at its deepest point
+	auto deepest = std::max_element(depths.begin(), depths.end(), [](const QPointF &a, const QPointF &b)
+					{ return a.y() < b.y(); });
+	DiveTextItem *text = new DiveTextItem(this);
+	text->setAlignment(Qt::AlignRight | Qt::AlignBottom);
+	text->setBrush(pen().color());
+	text->setPos(QPointF(hAxis->posAtValue(deepest->x()), vAxis->posAtValue(deepest->y())));
+	text->setScale(0.7); // need to call this BEFORE setText()
+	text->setText(label);
+	texts.append(text);
+}
+
+void DiveComparisonItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *)
+{
+	if (polygon().isEmpty())
+		return;
+	painter->save();
+	painter->setPen(pen());
+	painter->drawPolyline(polygon());
+	painter->restore();
+}
@@ -4,6 +4,7 @@
 
 #include <QObject>
 #include <QGraphicsPolygonItem>
+#include <QImage>
 #include <QModelIndex>
 
 #include "divelineitem.h"
@@ -42,6 +43,8 @@ public:
 	void setHorizontalDataColumn(int column);
 	void setVerticalDataColumn(int column);
 	virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0) = 0;
+	// Recalculate the polygon set by setDecimatedPolygon() for the current zoom level
+	void updateDecimation();
 public
 slots:
 	virtual void settingsChanged();
@@ -59,12 +62,21 @@ protected:
 	 */
 	bool shouldCalculateStuff(const QModelIndex &topLeft, const QModelIndex &bottomRight);
 
+	/* Plain lines and filled areas don't need more than a handful of points per pixel column.
+	 * This sets the polygon, reduced to the first, last, highest and lowest point of each
+	 * column at the current zoom level, and keeps the full polygon for when the zoom changes.
+	 * Not suitable for items that paint the polygon point by point with the model's data.
+	 */
+	void setDecimatedPolygon(const QPolygonF &poly);
+
 	DiveCartesianAxis *hAxis;
 	DiveCartesianAxis *vAxis;
 	DivePlotDataModel *dataModel;
 	int hDataColumn;
 	int vDataColumn;
 	QList<DiveTextItem *> texts;
+private:
+	QPolygonF fullPolygon;
 };
 
 class DiveProfileItem : public AbstractProfilePolygonItem {
@@ -131,6 +143,7 @@ public:
 private:
 	QString visibilityKey;
 	int tissueIndex;
+	QImage image; // one pixel per time step, stretched over the polygon when painting
 	QColor ColorScale(double value, int inert);
 
 };
@@ -223,4 +236,18 @@ private:
 	QColor normalColor;
 	QColor alertColor;
 };
+
+// The depth curve of another dive, overlaid on the profile to compare dives.
+// It doesn't use the data model, but a list of (seconds, mm) points.
+class DiveComparisonItem : public AbstractProfilePolygonItem {
+	Q_OBJECT
+public:
+	DiveComparisonItem(const QVector<QPointF> &depths, const QString &label, const QColor &color);
+	void modelDataChanged(const QModelIndex &topLeft = QModelIndex(), const QModelIndex &bottomRight = QModelIndex()) override;
+	void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0) override;
+
+private:
+	QVector<QPointF> depths;
+	QString label;
+};
 #endif // DIVEPROFILEITEM_H
@@ -14,7 +14,8 @@ DiveTextItem::DiveTextItem(QGraphicsItem *parent) : QGraphicsItemGroup(parent),
 	textItem(new QGraphicsPathItem(this)),
 	printScale(1.0),
 	scale(1.0),
-	connected(false)
+	connected(false),
+	renderedAlignFlags(0)
 {
 	setFlag(ItemIgnoresTransformations);
 	textBackgroundItem->setBrush(QBrush(getColor(TEXT_BACKGROUND)));
@@ -95,6 +96,11 @@ void DiveTextItem::updateText()
 		size *= scale * printScale;
 		fnt.setPointSizeF(size);
 	}
+	if (internalText == renderedText && internalAlignFlags == renderedAlignFlags && fnt == renderedFont)
+		return;
+	renderedText = internalText;
+	renderedFont = fnt;
+	renderedAlignFlags = internalAlignFlags;
 	QFontMetrics fm(fnt);
 
 	QPainterPath textPath;
@@ -4,6 +4,7 @@
 
 #include <QObject>
 #include <QGraphicsItemGroup>
+#include <QFont>
 
 class QBrush;
 
@@ -34,6 +35,10 @@ private:
 	double printScale;
 	double scale;
 	bool connected;
+	// What the current paths were created for, since paint() calls updateText()
+	QString renderedText;
+	QFont renderedFont;
+	int renderedAlignFlags;
 };
 
 #endif // DIVETEXTITEM_H
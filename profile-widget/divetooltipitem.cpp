@@ -137,7 +137,8 @@ ToolTipItem::ToolTipItem(QGraphicsItem *parent) : QGraphicsRectItem(parent),
 	title(new QGraphicsSimpleTextItem(tr("Information"), this)),
 	status(COLLAPSED),
 	timeAxis(0),
-	lastTime(-1)
+	lastTime(-1),
+	lastIdx(-1)
 {
 	clearPlotInfo();
 	entryToolTip.first = NULL;
@@ -221,11 +222,36 @@ void ToolTipItem::readPos()
 void ToolTipItem::setPlotInfo(const plot_info &plot)
 {
 	pInfo = plot;
+	invalidateCache();
 }
 
 void ToolTipItem::clearPlotInfo()
 {
 	memset(&pInfo, 0, sizeof(pInfo));
+	invalidateCache();
+}
+
+// The entry texts depend on the units and on the display preferences,
+// so they have to be recreated whenever the settings change.
+void ToolTipItem::invalidateCache()
+{
+	entryTexts.clear();
+	lastIdx = -1;
+}
+
+const QString &ToolTipItem::entryText(int idx)
+{
+	static struct membuffer mb = {};
+
+	if (entryTexts.size() != pInfo.nr)
+		entryTexts = QVector<QString>(pInfo.nr);
+	QString &text = entryTexts[idx];
+	if (text.isNull()) {
+		mb.len = 0;
+		get_plot_details_string(&pInfo, idx, &mb);
+		text = QString::fromUtf8(mb.buffer, mb.len);
+	}
+	return text;
 }
 
 void ToolTipItem::setTimeAxis(DiveCartesianAxis *axis)
@@ -237,7 +263,6 @@ void ToolTipItem::refresh(const QPointF &pos)
 {
 	static QPixmap tissues(16,60);
 	static QPainter painter(&tissues);
-	static struct membuffer mb = {};
 
 	if(refreshTime.elapsed() < 40)
 		return;
@@ -248,34 +273,36 @@ void ToolTipItem::refresh(const QPointF &pos)
 	lastTime = time;
 	clear();
 
-	mb.len = 0;
-	int idx = get_plot_details_new(&pInfo, time, &mb);
-
-	tissues.fill();
-	painter.setPen(QColor(0, 0, 0, 0));
-	painter.setBrush(QColor(LIMENADE1));
-	painter.drawRect(0, 10 + (100 - AMB_PERCENTAGE) / 2, 16, AMB_PERCENTAGE / 2);
-	painter.setBrush(QColor(SPRINGWOOD1));
-	painter.drawRect(0, 10, 16, (100 - AMB_PERCENTAGE) / 2);
-	painter.setBrush(QColor(Qt::red));
-	painter.drawRect(0,0,16,10);
-	if (idx) {
-		ProfileWidget2 *view = qobject_cast<ProfileWidget2*>(scene()->views().first());
-		Q_ASSERT(view);
-
-		const struct plot_data *entry = &pInfo.entry[idx];
-		painter.setPen(QColor(0, 0, 0, 255));
-		if (decoMode() == BUEHLMANN)
-			painter.drawLine(0, lrint(60 - entry->gfline / 2), 16, lrint(60 - entry->gfline / 2));
-		painter.drawLine(0, lrint(60 - AMB_PERCENTAGE * (entry->pressures.n2 + entry->pressures.he) / entry->ambpressure / 2),
-				16, lrint(60 - AMB_PERCENTAGE * (entry->pressures.n2 + entry->pressures.he) / entry->ambpressure /2));
-		painter.setPen(QColor(0, 0, 0, 127));
-		for (int i=0; i<16; i++) {
-			painter.drawLine(i, 60, i, 60 - entry->percentages[i] / 2);
+	int idx = get_plot_details_index(&pInfo, time);
+
+	// the text and the tissue graph only depend on the plot entry
+	if (idx != lastIdx) {
+		lastIdx = idx;
+		tissues.fill();
+		painter.setPen(QColor(0, 0, 0, 0));
+		painter.setBrush(QColor(LIMENADE1));
+		painter.drawRect(0, 10 + (100 - AMB_PERCENTAGE) / 2, 16, AMB_PERCENTAGE / 2);
+		painter.setBrush(QColor(SPRINGWOOD1));
+		painter.drawRect(0, 10, 16, (100 - AMB_PERCENTAGE) / 2);
+		painter.setBrush(QColor(Qt::red));
+		painter.drawRect(0,0,16,10);
+		if (idx) {
+			const struct plot_data *entry = &pInfo.entry[idx];
+			painter.setPen(QColor(0, 0, 0, 255));
+			if (decoMode() == BUEHLMANN)
+				painter.drawLine(0, lrint(60 - entry->gfline / 2), 16, lrint(60 - entry->gfline / 2));
+			painter.drawLine(0, lrint(60 - AMB_PERCENTAGE * (entry->pressures.n2 + entry->pressures.he) / entry->ambpressure / 2),
+					16, lrint(60 - AMB_PERCENTAGE * (entry->pressures.n2 + entry->pressures.he) / entry->ambpressure /2));
+			painter.setPen(QColor(0, 0, 0, 127));
+			if (pInfo.tissues) {
+				for (int i=0; i<16; i++) {
+					painter.drawLine(i, 60, i, 60 - pInfo.tissues[idx].percentages[i] / 2);
+				}
+			}
+			entryToolTip.second->setText(entryText(idx));
 		}
-		entryToolTip.second->setText(QString::fromUtf8(mb.buffer, mb.len));
+		entryToolTip.first->setPixmap(tissues);
 	}
-	entryToolTip.first->setPixmap(tissues);
 
 	const auto l = scene()->items(pos, Qt::IntersectsItemBoundingRect, Qt::DescendingOrder,
 			scene()->views().first()->transform());
@@ -45,12 +45,14 @@ public:
 	void setTimeAxis(DiveCartesianAxis *axis);
 	void setPlotInfo(const plot_info &plot);
 	void clearPlotInfo();
+	void invalidateCache();
 	void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
 public
 slots:
 	void setRect(const QRectF &rect);
 
 private:
+	const QString &entryText(int idx);
 	typedef QPair<QGraphicsPixmapItem *, QGraphicsSimpleTextItem *> ToolTip;
 	QVector<ToolTip> toolTips;
 	ToolTip entryToolTip;
@@ -61,6 +63,8 @@ private:
 	DiveCartesianAxis *timeAxis;
 	plot_info pInfo;
 	int lastTime;
+	int lastIdx;
+	QVector<QString> entryTexts;
 	QElapsedTimer refreshTime;
 	QList<QGraphicsItem*> oldSelection;
 };
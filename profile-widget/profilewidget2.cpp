@@ -5,9 +5,11 @@
 #include "core/qthelper.h"
 #include "core/picture.h"
 #include "core/profile.h"
+#include "core/deco.h"
 #include "core/settings/qPrefDisplay.h"
 #include "core/settings/qPrefTechnicalDetails.h"
 #include "core/settings/qPrefPartialPressureGas.h"
+#include "profile-widget/animationfunctions.h"
 #include "profile-widget/diveeventitem.h"
 #include "profile-widget/divetextitem.h"
 #include "profile-widget/divetooltipitem.h"
@@ -21,6 +23,7 @@
 #include "qt-models/divepicturemodel.h" // TODO: remove once divepictures have been undo-ified
 #include "core/divelist.h"
 #include "core/errorhelper.h"
+#include "core/memusage.h"
 #ifndef SUBSURFACE_MOBILE
 #include "desktop-widgets/diveplanner.h"
 #include "desktop-widgets/simplewidgets.h"
@@ -31,17 +34,23 @@
 #include "core/gettextfromc.h"
 #include "core/imagedownloader.h"
 #include "core/subsurface-qt/divelistnotifier.h"
+#include "core/subsurfacestartup.h"
 #endif
 
 #include <libdivecomputer/parser.h>
 #include <QScrollBar>
+#include <algorithm>
 #include <QtCore/qmath.h>
 #include <QMessageBox>
 #include <QInputDialog>
 #include <QDebug>
 #include <QWheelEvent>
 #include <QMenu>
+#include <QtConcurrent>
 #include <QElapsedTimer>
+#if !defined(SUBSURFACE_MOBILE) && !defined(QT_NO_OPENGL)
+#include <QOpenGLWidget>
+#endif
 
 #ifndef QT_NO_DEBUG
 #include <QTableView>
@@ -100,6 +109,7 @@ static const double thumbnailBaseZValue = 100.0;
 
 ProfileWidget2::ProfileWidget2(QWidget *parent) : QGraphicsView(parent),
 	currentState(INVALID),
+	lastPlotDuration(0),
 	dataModel(new DivePlotDataModel(this)),
 	zoomLevel(0),
 	zoomFactor(1.15),
@@ -151,6 +161,12 @@ ProfileWidget2::ProfileWidget2(QWidget *parent) : QGraphicsView(parent),
 	isPlotZoomed = prefs.zoomed_plot; // now it seems that 'prefs' has loaded our preferences
 
 	init_plot_info(&plotInfo);
+	plotInfoGeneration = dive_data_generation;
+#ifndef SUBSURFACE_MOBILE
+	plotJob = nullptr;
+	comparisonPending = false;
+#endif
+	memusage_register(MEM_PLOT_INFO, &ProfileWidget2::reportMemoryUsage, this);
 
 	setupSceneAndFlags();
 	setupItemSizes();
@@ -168,11 +184,16 @@ ProfileWidget2::ProfileWidget2(QWidget *parent) : QGraphicsView(parent),
 	addActionShortcut(Qt::Key_Right, &ProfileWidget2::keyRightAction);
 
 	connect(Thumbnailer::instance(), &Thumbnailer::thumbnailChanged, this, &ProfileWidget2::updateThumbnail, Qt::QueuedConnection);
+	pendingThumbnailsTimer.setSingleShot(true);
+	pendingThumbnailsTimer.setInterval(16);
+	connect(&pendingThumbnailsTimer, &QTimer::timeout, this, &ProfileWidget2::applyPendingThumbnails);
 	connect(&diveListNotifier, &DiveListNotifier::picturesRemoved, this, &ProfileWidget2::picturesRemoved);
 	connect(&diveListNotifier, &DiveListNotifier::picturesAdded, this, &ProfileWidget2::picturesAdded);
 	connect(&diveListNotifier, &DiveListNotifier::cylinderEdited, this, &ProfileWidget2::profileChanged);
 	connect(&diveListNotifier, &DiveListNotifier::eventsChanged, this, &ProfileWidget2::profileChanged);
 	connect(&diveListNotifier, &DiveListNotifier::pictureOffsetChanged, this, &ProfileWidget2::pictureOffsetChanged);
+	connect(&plotJobWatcher, &QFutureWatcher<void>::finished, this, &ProfileWidget2::plotJobFinished);
+	connect(&comparisonWatcher, &QFutureWatcher<void>::finished, this, &ProfileWidget2::comparisonJobsFinished);
 #endif // SUBSURFACE_MOBILE
 
 #if !defined(QT_NO_DEBUG) && defined(SHOW_PLOT_INFO_TABLE)
@@ -182,11 +203,360 @@ ProfileWidget2::ProfileWidget2(QWidget *parent) : QGraphicsView(parent),
 #endif
 }
 
+#ifndef SUBSURFACE_MOBILE
+// Plot data of a dive computer, calculated in a worker thread from a private copy of the dive
+struct ProfileWidget2::PlotJob {
+	int diveId;
+	unsigned int dcNr;
+	uint64_t prefsHash;
+	unsigned int generation;
+	struct dive *dive;
+	struct deco_state decoState;
+	enum divemode_t divemode;
+	struct plot_info info;
+
+	~PlotJob()
+	{
+		free_plot_info_data(&info);
+		free_dive(dive);
+	}
+};
+
+// Depth curve of a dive to compare with. Dives that are in the plot data cache
+// don't need a copy of the dive, their curve is taken from the cache right away.
+struct ProfileWidget2::ComparisonJob {
+	struct dive *dive;
+	struct deco_state decoState;
+	ComparisonCurve curve;
+
+	~ComparisonJob()
+	{
+		free_dive(dive);
+	}
+};
+#endif
+
 ProfileWidget2::~ProfileWidget2()
 {
+	memusage_unregister(this);
+#ifndef SUBSURFACE_MOBILE
+	if (plotJob) {
+		plotJobWatcher.waitForFinished();
+		delete plotJob;
+	}
+	comparisonWatcher.waitForFinished();
+	qDeleteAll(comparisonJobs);
+#endif
 	free_plot_info_data(&plotInfo);
+	clearPlotInfoCache();
+}
+
+// Number of recently shown dive computers of which we keep the plot data
+static const size_t plotInfoCacheSize = 8;
+
+// The plot data depends on many preferences, so simply fingerprint all of them.
+// Strings are compared by pointer, which at worst causes a needless recalculation.
+uint64_t plotPrefsHash()
+{
+	uint64_t hash = deco_parameters_hash();
+	const unsigned char *p = (const unsigned char *)&prefs;
+	for (size_t i = 0; i < sizeof(prefs); i++)
+		hash = (hash ^ p[i]) * 1099511628211ull;
+	return hash;
+}
+
+void ProfileWidget2::reportMemoryUsage(struct mem_usage *usage, void *data)
+{
+	const ProfileWidget2 *self = static_cast<const ProfileWidget2 *>(data);
+	usage->bytes = plot_info_size(&self->plotInfo);
+	usage->objects = 1;
+	for (const PlotInfoCacheEntry &entry: self->plotInfoCache)
+		usage->bytes += plot_info_size(&entry.info);
+	usage->objects += (int)self->plotInfoCache.size();
+}
+
+void ProfileWidget2::clearPlotInfoCache()
+{
+	for (PlotInfoCacheEntry &entry: plotInfoCache)
+		free_plot_info_data(&entry.info);
+	plotInfoCache.clear();
+}
+
+// Any change to any dive may change the deco of the dives after it
+void ProfileWidget2::checkPlotInfoCacheGeneration()
+{
+	if (plotInfoGeneration != dive_data_generation) {
+		clearPlotInfoCache();
+		plotInfoGeneration = dive_data_generation;
+	}
+}
+
+bool ProfileWidget2::isPlotInfoCached(int diveId, unsigned int dcNr, uint64_t prefsHash)
+{
+	checkPlotInfoCacheGeneration();
+	return std::any_of(plotInfoCache.begin(), plotInfoCache.end(), [diveId, dcNr, prefsHash](const PlotInfoCacheEntry &entry)
+			   { return entry.diveId == diveId && entry.dcNr == dcNr && entry.prefsHash == prefsHash; });
 }
 
+// Add a copy of the plot data as most recently used entry
+void ProfileWidget2::addToPlotInfoCache(int diveId, unsigned int dcNr, uint64_t prefsHash, enum divemode_t divemode, const struct plot_info &info)
+{
+	auto it = std::find_if(plotInfoCache.begin(), plotInfoCache.end(), [diveId, dcNr](const PlotInfoCacheEntry &entry)
+			       { return entry.diveId == diveId && entry.dcNr == dcNr; });
+	if (it != plotInfoCache.end()) {
+		free_plot_info_data(&it->info);
+		plotInfoCache.erase(it);
+	}
+	if (plotInfoCache.size() >= plotInfoCacheSize) {
+		free_plot_info_data(&plotInfoCache.back().info);
+		plotInfoCache.pop_back();
+	}
+	PlotInfoCacheEntry entry { diveId, dcNr, prefsHash, divemode, {} };
+	init_plot_info(&entry.info);
+	copy_plot_info(&entry.info, &info);
+	plotInfoCache.insert(plotInfoCache.begin(), entry);
+}
+
+// Calculate the plot data of the given dive computer of displayed_dive (which
+// automatically frees the old plot data), or take them from the cache if we
+// showed it recently and nothing changed since.
+void ProfileWidget2::createPlotInfo(struct divecomputer *dc)
+{
+#ifndef SUBSURFACE_MOBILE
+	const struct deco_state *planner_ds = &DivePlannerPointsModel::instance()->final_deco_state;
+#else
+	const struct deco_state *planner_ds = nullptr;
+#endif
+	// When planning or adding a dive, the plot changes with every mouse move
+	if (currentState == ADD || currentState == PLAN || in_planner() || !shouldCalculateMaxDepth) {
+		create_plot_info_new(&displayed_dive, dc, &plotInfo, !shouldCalculateMaxDepth, true, planner_ds);
+		return;
+	}
+
+	checkPlotInfoCacheGeneration();
+	uint64_t prefsHash = plotPrefsHash();
+	for (auto it = plotInfoCache.begin(); it != plotInfoCache.end(); ++it) {
+		if (it->diveId == displayed_dive.id && it->dcNr == dc_number && it->prefsHash == prefsHash) {
+			copy_plot_info(&plotInfo, &it->info);
+			dc->divemode = it->divemode; // create_plot_info_new() may have switched the dive computer to CCR
+			std::rotate(plotInfoCache.begin(), it, it + 1);
+			return;
+		}
+	}
+
+	create_plot_info_new(&displayed_dive, dc, &plotInfo, false, true, planner_ds);
+	addToPlotInfoCache(displayed_dive.id, dc_number, prefsHash, dc->divemode, plotInfo);
+}
+
+#ifndef SUBSURFACE_MOBILE
+// Calculating the plot data of long dives with many samples takes a while. When
+// browsing through the dive list, this is done in a worker thread so that the UI
+// stays responsive. Only one calculation runs at a time. When it is finished,
+// the result goes to the cache and whatever dive is current by then is plotted.
+// Dives that were selected only in the meantime are thus never calculated.
+void ProfileWidget2::plotDiveInBackground(const struct dive *d, unsigned int dcNr)
+{
+	if (plotJob)
+		return;
+
+	plotJob = createPlotJob(d, dcNr);
+	PlotJob *job = plotJob;
+	plotJobWatcher.setFuture(QtConcurrent::run([job]() { calculatePlotJob(job); }));
+}
+
+// Everything that accesses other dives or the git repository is done here
+ProfileWidget2::PlotJob *ProfileWidget2::createPlotJob(const struct dive *d, unsigned int dcNr)
+{
+	load_samples(d);
+	PlotJob *job = new PlotJob;
+	job->diveId = d->id;
+	job->dcNr = dcNr;
+	job->prefsHash = plotPrefsHash();
+	job->generation = dive_data_generation;
+	job->dive = alloc_dive();
+	copy_dive(d, job->dive);
+	init_decompression(&job->decoState, job->dive);
+	init_plot_info(&job->info);
+	return job;
+}
+
+// Runs in a worker thread
+void ProfileWidget2::calculatePlotJob(PlotJob *job)
+{
+	struct divecomputer *dc = get_dive_dc(job->dive, job->dcNr);
+	if (!dc->samples)
+		fake_dc(dc);
+	create_plot_info_from_deco_state(job->dive, dc, &job->info, false, true, &job->decoState, nullptr);
+	job->divemode = dc->divemode;
+}
+
+// Used to export the profiles of many dives: their plot data is calculated on all cores,
+// the plotting itself has to be done in the UI thread. Only as many dives as fit into
+// the plot data cache are calculated, the caller has to pass the rest in later calls.
+size_t ProfileWidget2::calculatePlotInfos(const struct dive *const *dives, size_t nr)
+{
+	nr = std::min(nr, plotInfoCacheSize);
+	uint64_t prefsHash = plotPrefsHash();
+	std::vector<PlotJob *> jobs;
+	for (size_t i = 0; i < nr; ++i) {
+		const struct dive *d = dives[i];
+		if (!isPlotInfoCached(d->id, dc_number, prefsHash))
+			jobs.push_back(createPlotJob(d, dc_number));
+	}
+	QtConcurrent::blockingMap(jobs, &ProfileWidget2::calculatePlotJob);
+	for (PlotJob *job: jobs) {
+		addToPlotInfoCache(job->diveId, job->dcNr, job->prefsHash, job->divemode, job->info);
+		delete job;
+	}
+	return nr;
+}
+
+void ProfileWidget2::plotJobFinished()
+{
+	PlotJob *job = plotJob;
+	plotJob = nullptr;
+
+	// Drop the result if a dive or the preferences were changed in the meantime
+	checkPlotInfoCacheGeneration();
+	if (job->generation == dive_data_generation && job->prefsHash == plotPrefsHash())
+		addToPlotInfoCache(job->diveId, job->dcNr, job->prefsHash, job->divemode, job->info);
+	delete job;
+
+	if (currentState != ADD && currentState != PLAN && !printMode)
+		plotDive(current_dive, false);
+}
+
+void ProfileWidget2::setComparisonCurve(const struct plot_info &pi, int number, ComparisonCurve &curve)
+{
+	curve.number = number;
+	curve.maxtime = get_maxtime(&pi);
+	curve.maxdepth = get_maxdepth(&pi);
+	curve.depths.clear();
+	curve.depths.reserve(pi.nr);
+	for (int i = 0; i < pi.nr; i++)
+		curve.depths.append(QPointF(pi.entry[i].sec, pi.entry[i].depth));
+}
+
+// Only the depths are shown, so the pressures are not calculated (fast mode)
+void ProfileWidget2::calculateComparisonJob(ComparisonJob *job)
+{
+	if (!job->dive)
+		return;
+	struct divecomputer *dc = &job->dive->dc;
+	if (!dc->samples)
+		fake_dc(dc);
+	struct plot_info pi;
+	init_plot_info(&pi);
+	create_plot_info_from_deco_state(job->dive, dc, &pi, true, false, &job->decoState, nullptr);
+	setComparisonCurve(pi, job->dive->number, job->curve);
+	free_plot_info_data(&pi);
+}
+
+void ProfileWidget2::setComparisonDives(const QVector<dive *> &dives)
+{
+	clearComparison();
+	for (const dive *d: dives) {
+		if (d->id != displayed_dive.id)
+			comparisonDiveIds.append(d->id);
+	}
+	if (!comparisonDiveIds.isEmpty())
+		startComparisonJobs();
+	else if (currentState == PROFILE && !printMode)
+		plotDive(current_dive, true);
+}
+
+void ProfileWidget2::stopComparison()
+{
+	setComparisonDives(QVector<dive *>());
+}
+
+// Results of jobs that are still running are dropped
+void ProfileWidget2::clearComparison()
+{
+	comparisonDiveIds.clear();
+	comparisonCurves.clear();
+	clearComparisonItems();
+	if (!comparisonJobs.isEmpty())
+		comparisonPending = true;
+}
+
+// Like the plot job, the jobs copy everything they need from the dive list here.
+// If the dives change while the jobs are running, they are restarted when done.
+void ProfileWidget2::startComparisonJobs()
+{
+	if (!comparisonJobs.isEmpty()) {
+		comparisonPending = true;
+		return;
+	}
+	comparisonPending = false;
+	checkPlotInfoCacheGeneration();
+	uint64_t prefsHash = plotPrefsHash();
+	for (int id: comparisonDiveIds) {
+		struct dive *d = get_dive_by_uniq_id(id);
+		if (!d)
+			continue;
+		ComparisonJob *job = new ComparisonJob;
+		job->dive = nullptr;
+		auto it = std::find_if(plotInfoCache.begin(), plotInfoCache.end(), [id, prefsHash](const PlotInfoCacheEntry &entry)
+				       { return entry.diveId == id && entry.dcNr == 0 && entry.prefsHash == prefsHash; });
+		if (it != plotInfoCache.end()) {
+			setComparisonCurve(it->info, d->number, job->curve);
+		} else {
+			load_samples(d);
+			job->dive = alloc_dive();
+			copy_dive(d, job->dive);
+			init_decompression(&job->decoState, job->dive);
+		}
+		comparisonJobs.append(job);
+	}
+	if (comparisonJobs.isEmpty())
+		return;
+	comparisonWatcher.setFuture(QtConcurrent::map(comparisonJobs, calculateComparisonJob));
+}
+
+void ProfileWidget2::comparisonJobsFinished()
+{
+	std::vector<ComparisonCurve> curves;
+	for (ComparisonJob *job: comparisonJobs) {
+		curves.push_back(std::move(job->curve));
+		delete job;
+	}
+	comparisonJobs.clear();
+	if (comparisonPending) {
+		startComparisonJobs();
+		return;
+	}
+
+	comparisonCurves = std::move(curves);
+	createComparisonItems();
+	if (currentState == PROFILE && !printMode)
+		plotDive(current_dive, true);
+}
+
+void ProfileWidget2::createComparisonItems()
+{
+	clearComparisonItems();
+	int nr = (int)comparisonCurves.size();
+	for (int i = 0; i < nr; i++) {
+		const ComparisonCurve &curve = comparisonCurves[i];
+		QColor color = QColor::fromHsv(i * 360 / nr, 200, 200);
+		DiveComparisonItem *item = new DiveComparisonItem(curve.depths, QStringLiteral("#%1").arg(curve.number), color);
+		item->setZValue(1); // a line on top of the depth area of the current dive
+		scene()->addItem(item);
+		item->setHorizontalAxis(timeAxis);
+		item->setVerticalAxis(profileYAxis);
+		comparisonItems.push_back(item);
+	}
+}
+
+void ProfileWidget2::clearComparisonItems()
+{
+	for (DiveComparisonItem *item: comparisonItems)
+		delete item;
+	comparisonItems.clear();
+}
+#endif
+
 #ifndef SUBSURFACE_MOBILE
 void ProfileWidget2::addActionShortcut(const Qt::Key shortcut, void (ProfileWidget2::*slot)())
 {
@@ -539,6 +909,18 @@ void ProfileWidget2::setupSceneAndFlags()
 	setOptimizationFlags(QGraphicsView::DontSavePainterState);
 	setViewportUpdateMode(QGraphicsView::BoundingRectViewportUpdate);
 	setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
+#if !defined(SUBSURFACE_MOBILE) && !defined(QT_NO_OPENGL)
+	// On request, let the graphics hardware draw the profile. An OpenGL viewport
+	// is always repainted as a whole, partial updates don't buy anything there.
+	if (opengl_profile) {
+		QOpenGLWidget *glViewport = new QOpenGLWidget;
+		QSurfaceFormat format = glViewport->format();
+		format.setSamples(4); // the software renderer does antialiasing, too
+		glViewport->setFormat(format);
+		setViewport(glViewport);
+		setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+	}
+#endif
 	setMouseTracking(true);
 	background->setFlag(QGraphicsItem::ItemIgnoresTransformations);
 }
@@ -562,6 +944,8 @@ void ProfileWidget2::plotDive(const struct dive *d, bool force, bool doClearPict
 #else
 	Q_UNUSED(doClearPictures);
 #endif
+	// When replotting the dive that is already shown, only its data changed: don't animate the axes
+	bool dataChangedOnly = false;
 	if (currentState != ADD && currentState != PLAN) {
 		if (!d) {
 			setEmptyState();
@@ -575,6 +959,23 @@ void ProfileWidget2::plotDive(const struct dive *d, bool force, bool doClearPict
 		if (d->id == displayed_dive.id && dc_number == dataModel->dcShown() && !force)
 			return;
 
+#ifndef SUBSURFACE_MOBILE
+		// The other dives are compared with the dive that was shown
+		if (d->id != displayed_dive.id)
+			clearComparison();
+#endif
+
+#ifndef SUBSURFACE_MOBILE
+		// When just browsing through the dives, don't wait for the plot data
+		unsigned int dcNr = dc_number < number_of_computers(d) ? dc_number : 0;
+		if (!force && !printMode && !isPlotInfoCached(d->id, dcNr, plotPrefsHash())) {
+			plotDiveInBackground(d, dcNr);
+			return;
+		}
+#endif
+
+		dataChangedOnly = currentState == PROFILE && d->id == displayed_dive.id && dc_number == dataModel->dcShown();
+
 		// this copies the dive and makes copies of all the relevant additional data
 		copy_dive(d, &displayed_dive);
 #ifndef SUBSURFACE_MOBILE
@@ -598,11 +999,19 @@ void ProfileWidget2::plotDive(const struct dive *d, bool force, bool doClearPict
 	}
 
 	// special handling for the first time we display things
-	animSpeed = instant ? 0 : qPrefDisplay::animation_speed();
+	animSpeed = instant || dataChangedOnly ? 0 : qPrefDisplay::animation_speed();
 	if (firstCall && haveFilesOnCommandLine()) {
 		animSpeed = 0;
 		firstCall = false;
 	}
+	// Animating hundreds of event and picture items makes replots sluggish
+	if (animSpeed) {
+		int items = displayed_dive.pictures.nr;
+		for (const struct event *ev = select_dc(&displayed_dive)->events; ev; ev = ev->next)
+			items++;
+		if (!Animations::withinBudget(items, lastPlotDuration))
+			animSpeed = 0;
+	}
 
 	// restore default zoom level
 	resetZoom();
@@ -639,12 +1048,7 @@ void ProfileWidget2::plotDive(const struct dive *d, bool force, bool doClearPict
 	 * shown.
 	 */
 
-	// create_plot_info_new() automatically frees old plot data
-#ifndef SUBSURFACE_MOBILE
-	create_plot_info_new(&displayed_dive, currentdc, &plotInfo, !shouldCalculateMaxDepth, &DivePlannerPointsModel::instance()->final_deco_state);
-#else
-	create_plot_info_new(&displayed_dive, currentdc, &plotInfo, !shouldCalculateMaxDepth, nullptr);
-#endif
+	createPlotInfo(currentdc);
 	int newMaxtime = get_maxtime(&plotInfo);
 	if (shouldCalculateMaxTime || newMaxtime > maxtime)
 		maxtime = newMaxtime;
@@ -661,6 +1065,13 @@ void ProfileWidget2::plotDive(const struct dive *d, bool force, bool doClearPict
 	} else {
 		maxdepth = newMaxDepth;
 	}
+#ifndef SUBSURFACE_MOBILE
+	// The axes are shared with the dives that are compared with this one
+	for (const ComparisonCurve &curve: comparisonCurves) {
+		maxtime = std::max(maxtime, curve.maxtime);
+		maxdepth = std::max(maxdepth, curve.maxdepth);
+	}
+#endif
 
 	dataModel->setDive(&displayed_dive, plotInfo);
 #ifndef SUBSURFACE_MOBILE
@@ -718,6 +1129,10 @@ void ProfileWidget2::plotDive(const struct dive *d, bool force, bool doClearPict
 		incr *= 2;
 	timeAxis->setTickInterval(incr);
 	timeAxis->updateTicks();
+#ifndef SUBSURFACE_MOBILE
+	for (DiveComparisonItem *item: comparisonItems)
+		item->modelDataChanged();
+#endif
 	cylinderPressureAxis->setMinimum(plotInfo.minpressure);
 	cylinderPressureAxis->setMaximum(plotInfo.maxpressure);
 #ifndef SUBSURFACE_MOBILE
@@ -767,8 +1182,8 @@ void ProfileWidget2::plotDive(const struct dive *d, bool force, bool doClearPict
 	// The event items are a bit special since we don't know how many events are going to
 	// exist on a dive, so I cant create cache items for that. that's why they are here
 	// while all other items are up there on the constructor.
-	qDeleteAll(eventItems);
-	eventItems.clear();
+	// The items of the previous dive are reused, only the surplus is created or deleted.
+	int eventIdx = 0;
 	struct event *event = currentdc->events;
 	struct gasmix lastgasmix = get_gasmix_at_time(&displayed_dive, current_dc, duration_t{1});
 
@@ -789,22 +1204,31 @@ void ProfileWidget2::plotDive(const struct dive *d, bool force, bool doClearPict
 		// printMode is always selected for SUBSURFACE_MOBILE due to font problems
 		// BUT events are wanted.
 #endif
-		DiveEventItem *item = new DiveEventItem();
-		item->setHorizontalAxis(timeAxis);
-		item->setVerticalAxis(profileYAxis, qPrefDisplay::animation_speed());
-		item->setModel(dataModel);
+		DiveEventItem *item;
+		if (eventIdx < eventItems.size()) {
+			item = eventItems[eventIdx];
+		} else {
+			item = new DiveEventItem();
+			item->setHorizontalAxis(timeAxis);
+			item->setVerticalAxis(profileYAxis, qPrefDisplay::animation_speed());
+			item->setModel(dataModel);
+			item->setZValue(2);
+			scene()->addItem(item);
+			eventItems.push_back(item);
+		}
+		++eventIdx;
 		item->setEvent(event, lastgasmix);
-		item->setZValue(2);
 #ifndef SUBSURFACE_MOBILE
 		item->setScale(printMode ? 4 :1);
 #endif
-		scene()->addItem(item);
-		eventItems.push_back(item);
 		if (event_is_gaschange(event))
 			lastgasmix = get_gasmix_from_event(&displayed_dive, event);
 		event = event->next;
 	}
 
+	while (eventItems.size() > eventIdx)
+		delete eventItems.takeLast();
+
 	// Only set visible the events that should be visible
 	Q_FOREACH (DiveEventItem *event, eventItems) {
 		event->setVisible(!event->shouldBeHidden());
@@ -840,7 +1264,8 @@ void ProfileWidget2::plotDive(const struct dive *d, bool force, bool doClearPict
 	// OK, how long did this take us? Anything above the second is way too long,
 	// so if we are calculation TTS / NDL then let's force that off.
 #ifndef SUBSURFACE_MOBILE
-	if (measureDuration.elapsed() > 1000 && prefs.calcndltts) {
+	lastPlotDuration = measureDuration.elapsed();
+	if (lastPlotDuration > 1000 && prefs.calcndltts) {
 		qPrefTechnicalDetails::set_calcndltts(false);
 		report_error(qPrintable(tr("Show NDL / TTS was disabled because of excessive processing time")));
 	}
@@ -870,6 +1295,7 @@ void ProfileWidget2::settingsChanged()
 	else
 		needReplot = prefs.calcceiling;
 #ifndef SUBSURFACE_MOBILE
+	toolTipItem->invalidateCache();	// The texts depend on units and display settings
 	gasYAxis->settingsChanged();	// Initialize ticks of partial pressure graph
 	if ((prefs.percentagegraph||prefs.hrgraph) && PP_GRAPHS_ENABLED) {
 		profileYAxis->animateChangeLine(itemPos.depth.shrinked);
@@ -938,6 +1364,17 @@ void ProfileWidget2::resizeEvent(QResizeEvent *event)
 	QGraphicsView::resizeEvent(event);
 	fitInView(sceneRect(), Qt::IgnoreAspectRatio);
 	fixBackgroundPos();
+	updateDecimation();
+}
+
+// The polygons of the profile are reduced to the resolution of the widget.
+// Recalculate them if that changed.
+void ProfileWidget2::updateDecimation()
+{
+	for (QGraphicsItem *item: scene()->items()) {
+		if (AbstractProfilePolygonItem *polygonItem = dynamic_cast<AbstractProfilePolygonItem *>(item))
+			polygonItem->updateDecimation();
+	}
 }
 
 #ifndef SUBSURFACE_MOBILE
@@ -993,15 +1430,18 @@ void ProfileWidget2::fixBackgroundPos()
 void ProfileWidget2::scale(qreal sx, qreal sy)
 {
 	QGraphicsView::scale(sx, sy);
+	updateDecimation();
 
 #ifndef SUBSURFACE_MOBILE
 	// Since the zoom level changed, adjust the duration bars accordingly.
 	// We want to grow/shrink the length, but not the height and pen.
+	bool linesChanged = false;
 	for (PictureEntry &p: pictures)
-		updateDurationLine(p);
+		linesChanged |= updateDurationLine(p);
 
-	// Since we created new duration lines, we have to update the order in which the thumbnails is painted.
-	updateThumbnailPaintOrder();
+	// If we created new duration lines, we have to update the order in which the thumbnails is painted.
+	if (linesChanged)
+		updateThumbnailPaintOrder();
 #endif
 }
 
@@ -1113,6 +1553,7 @@ void ProfileWidget2::setEmptyState()
 
 #ifndef SUBSURFACE_MOBILE
 	clearPictures();
+	clearComparison();
 #endif
 	disconnectTemporaryConnections();
 	setBackgroundBrush(getColor(::BACKGROUND, isGrayscale));
@@ -1317,6 +1758,7 @@ void ProfileWidget2::setAddState()
 		return;
 
 	clearHandlers();
+	clearComparison();
 	setProfileState();
 	mouseFollowerHorizontal->setVisible(true);
 	mouseFollowerVertical->setVisible(true);
@@ -1350,6 +1792,7 @@ void ProfileWidget2::setPlanState()
 	if (currentState == PLAN)
 		return;
 
+	clearComparison();
 	setProfileState();
 	mouseFollowerHorizontal->setVisible(true);
 	mouseFollowerVertical->setVisible(true);
@@ -1552,6 +1995,8 @@ void ProfileWidget2::contextMenuEvent(QContextMenuEvent *event)
 	}
 	if (some_hidden)
 		m.addAction(tr("Unhide all events"), this, &ProfileWidget2::unhideEvents);
+	if (!comparisonDiveIds.isEmpty())
+		m.addAction(tr("Stop comparing dives"), this, &ProfileWidget2::stopComparison);
 	m.exec(event->globalPos());
 }
 
@@ -1693,6 +2138,8 @@ void ProfileWidget2::setPrintMode(bool mode, bool grayscale)
 	mouseFollowerVertical->setVisible(!mode);
 	toolTipItem->setVisible(!mode);
 #endif
+	// Printing uses the full resolution polygons
+	updateDecimation();
 }
 
 void ProfileWidget2::setFontPrintScale(double scale)
@@ -2020,8 +2467,10 @@ void ProfileWidget2::clearPictures()
 static const double unscaledDurationLineWidth = 2.5;
 static const double unscaledDurationLinePenWidth = 0.5;
 
-// Reset the duration line after an image was moved or we found a new duration
-void ProfileWidget2::updateDurationLine(PictureEntry &e)
+// Reset the duration line after an image was moved or we found a new duration.
+// Returns true if a line was created or removed, in which case the paint order
+// of the thumbnails has to be updated.
+bool ProfileWidget2::updateDurationLine(PictureEntry &e)
 {
 	if (e.duration.seconds > 0) {
 		// We know the duration of this video, reset the line symbolizing its extent accordingly
@@ -2033,41 +2482,66 @@ void ProfileWidget2::updateDurationLine(PictureEntry &e)
 		double scale = transform().m22();
 		double durationLineWidth = unscaledDurationLineWidth / scale;
 		double durationLinePenWidth = unscaledDurationLinePenWidth / scale;
-		e.durationLine.reset(new QGraphicsRectItem(begin, y - durationLineWidth - durationLinePenWidth, end - begin, durationLineWidth));
+		QRectF rect(begin, y - durationLineWidth - durationLinePenWidth, end - begin, durationLineWidth);
+		bool created = !e.durationLine;
+		if (created) {
+			e.durationLine.reset(new QGraphicsRectItem(rect));
+			scene()->addItem(e.durationLine.get());
+		} else {
+			e.durationLine->setRect(rect);
+		}
 		e.durationLine->setPen(QPen(getColor(GF_LINE, isGrayscale), durationLinePenWidth));
 		e.durationLine->setBrush(getColor(::BACKGROUND, isGrayscale));
 		e.durationLine->setVisible(prefs.show_pictures_in_profile);
-		scene()->addItem(e.durationLine.get());
+		return created;
 	} else {
 		// This is either a picture or a video with unknown duration.
 		// In case there was a line (how could that be?) remove it.
+		bool removed = !!e.durationLine;
 		e.durationLine.reset();
+		return removed;
 	}
 }
 
 // This function is called asynchronously by the thumbnailer if a thumbnail
-// was fetched from disk or freshly calculated.
+// was fetched from disk or freshly calculated. When opening a dive with many
+// pictures, the thumbnails arrive in quick succession. Therefore, collect them
+// and apply them in one go, at most once per frame.
 void ProfileWidget2::updateThumbnail(QString filename, QImage thumbnail, duration_t duration)
 {
-	// Find the picture with the given filename
-	auto it = std::find_if(pictures.begin(), pictures.end(), [&filename](const PictureEntry &e)
-			       { return e.filename == filename; });
+	pendingThumbnails.insert(filename, { thumbnail, duration });
+	if (!pendingThumbnailsTimer.isActive())
+		pendingThumbnailsTimer.start();
+}
+
+void ProfileWidget2::applyPendingThumbnails()
+{
+	if (pendingThumbnails.isEmpty())
+		return;
+
+	int size = Thumbnailer::defaultThumbnailSize();
+	bool linesChanged = false;
+	for (PictureEntry &e: pictures) {
+		auto it = pendingThumbnails.find(e.filename);
+		if (it == pendingThumbnails.end())
+			continue;
 
-	// If we didn't find a picture, it does either not belong to the current dive,
-	// or its timestamp is outside of the profile.
-	if (it != pictures.end()) {
 		// Replace the pixmap of the thumbnail with the newly calculated one.
-		int size = Thumbnailer::defaultThumbnailSize();
-		it->thumbnail->setPixmap(QPixmap::fromImage(thumbnail.scaled(size, size, Qt::KeepAspectRatio)));
+		e.thumbnail->setPixmap(QPixmap::fromImage(it->thumbnail.scaled(size, size, Qt::KeepAspectRatio)));
 
 		// If the duration changed, update the line
-		if (duration.seconds != it->duration.seconds) {
-			it->duration = duration;
-			updateDurationLine(*it);
-			// If we created / removed a duration line, we have to update the thumbnail paint order.
-			updateThumbnailPaintOrder();
+		if (it->duration.seconds != e.duration.seconds) {
+			e.duration = it->duration;
+			linesChanged |= updateDurationLine(e);
 		}
 	}
+	// Thumbnails of pictures we didn't find do either not belong to the current dive,
+	// or their timestamp is outside of the profile.
+	pendingThumbnails.clear();
+
+	// If we created / removed a duration line, we have to update the thumbnail paint order.
+	if (linesChanged)
+		updateThumbnailPaintOrder();
 }
 
 // Create a PictureEntry object and add its thumbnail to the scene if profile pictures are shown.
@@ -2079,7 +2553,8 @@ ProfileWidget2::PictureEntry::PictureEntry(offset_t offsetIn, const QString &fil
 	int size = Thumbnailer::defaultThumbnailSize();
 	scene->addItem(thumbnail.get());
 	thumbnail->setVisible(prefs.show_pictures_in_profile);
-	QImage img = Thumbnailer::instance()->fetchThumbnail(filename, synchronous).scaled(size, size, Qt::KeepAspectRatio);
+	Thumbnailer::Priority priority = prefs.show_pictures_in_profile ? Thumbnailer::VISIBLE : Thumbnailer::BACKGROUND;
+	QImage img = Thumbnailer::instance()->fetchThumbnail(filename, synchronous, priority).scaled(size, size, Qt::KeepAspectRatio);
 	thumbnail->setPixmap(QPixmap::fromImage(img));
 	thumbnail->setFileUrl(filename);
 }
@@ -2116,9 +2591,26 @@ void ProfileWidget2::updateThumbnailPaintOrder()
 // when items are added later to the scene. This is done using the QGraphicsItem::packBefore() function.
 // We can't use the z-value, because that will be modified on hoverEnter and hoverExit events.
 void ProfileWidget2::calculatePictureYPositions()
+{
+	calculatePictureYPositions(0, pictures.size());
+	updateThumbnailPaintOrder();
+}
+
+// Recalculate the y-coordinates after the pictures in the range [from, to) were
+// added, moved or had their x-coordinate changed. The position of a thumbnail only
+// depends on the previous thumbnail, therefore the pictures after that range only
+// have to be considered until the first one that doesn't move.
+// This does not update the paint order: the callers have to do that, since they
+// added, removed or reordered pictures anyway.
+void ProfileWidget2::calculatePictureYPositions(size_t from, size_t to)
 {
 	double lastX = -1.0, lastY = 0.0;
-	for (PictureEntry &e: pictures) {
+	if (from > 0 && from <= pictures.size()) {
+		lastX = pictures[from - 1].thumbnail->x();
+		lastY = pictures[from - 1].thumbnail->y();
+	}
+	for (size_t i = from; i < pictures.size(); ++i) {
+		PictureEntry &e = pictures[i];
 		// let's put the picture at the correct time, but at a fixed "depth" on the profile
 		// not sure this is ideal, but it seems to look right.
 		double x = e.thumbnail->x();
@@ -2127,12 +2619,13 @@ void ProfileWidget2::calculatePictureYPositions()
 			y = lastY + 3;
 		else
 			y = 10;
+		if (i >= to && y == e.thumbnail->y())
+			break;
 		lastX = x;
 		lastY = y;
 		e.thumbnail->setY(y);
 		updateDurationLine(e); // If we changed the y-position, we also have to change the duration-line.
 	}
-	updateThumbnailPaintOrder();
 }
 
 void ProfileWidget2::updateThumbnailXPos(PictureEntry &e)
@@ -2186,11 +2679,18 @@ void ProfileWidget2::picturesRemoved(dive *d, QVector<QString> fileUrls)
 	// end of the new range of non-deleted elements. A subsequent call to
 	// std::erase on the range of deleted elements then ultimately shrinks the vector.
 	// (c.f. erase-remove idiom: https://en.wikipedia.org/wiki/Erase%E2%80%93remove_idiom)
-	auto it = std::remove_if(pictures.begin(), pictures.end(), [&fileUrls](const PictureEntry &e)
+	auto isRemoved = [&fileUrls](const PictureEntry &e)
 			// Check whether filename of entry is in list of provided filenames
-			{ return std::find(fileUrls.begin(), fileUrls.end(), e.filename) != fileUrls.end(); });
+			{ return std::find(fileUrls.begin(), fileUrls.end(), e.filename) != fileUrls.end(); };
+	size_t from = std::find_if(pictures.begin(), pictures.end(), isRemoved) - pictures.begin();
+	if (from == pictures.size())
+		return;
+	auto it = std::remove_if(pictures.begin() + from, pictures.end(), isRemoved);
 	pictures.erase(it, pictures.end());
-	calculatePictureYPositions();
+
+	// Only the pictures after the first removed one can move.
+	calculatePictureYPositions(from, from);
+	updateThumbnailPaintOrder();
 }
 
 void ProfileWidget2::picturesAdded(dive *d, QVector<PictureObj> pics)
@@ -2198,18 +2698,26 @@ void ProfileWidget2::picturesAdded(dive *d, QVector<PictureObj> pics)
 	if (d->id != displayed_dive.id)
 		return;
 
+	size_t oldSize = pictures.size();
 	for (const PictureObj &pic: pics) {
 		if (pic.offset.seconds > 0 && pic.offset.seconds <= d->duration.seconds) {
 			pictures.emplace_back(pic.offset, QString::fromStdString(pic.filename), scene(), false);
 			updateThumbnailXPos(pictures.back());
 		}
 	}
+	if (pictures.size() == oldSize)
+		return;
 
 	// Sort pictures by timestamp (and filename if equal timestamps).
 	// This will allow for proper location of the pictures on the profile plot.
-	std::sort(pictures.begin(), pictures.end());
+	// The old pictures are already sorted, so it is sufficient to sort the new
+	// ones and merge them into the list.
+	std::sort(pictures.begin() + oldSize, pictures.end());
+	size_t from = std::upper_bound(pictures.begin(), pictures.begin() + oldSize, pictures[oldSize]) - pictures.begin();
+	std::inplace_merge(pictures.begin(), pictures.begin() + oldSize, pictures.end());
 
-	calculatePictureYPositions();
+	calculatePictureYPositions(from, pictures.size());
+	updateThumbnailPaintOrder();
 }
 
 void ProfileWidget2::profileChanged(dive *d)
@@ -2282,13 +2790,18 @@ void ProfileWidget2::pictureOffsetChanged(dive *d, QString filename, offset_t of
 			int oldIndex = oldPos - pictures.begin();
 			int newIndex = newPos - pictures.begin();
 			moveInVector(pictures, oldIndex, oldIndex + 1, newIndex);
+
+			// All pictures between the old and the new position changed their place in the list.
+			calculatePictureYPositions(std::min(oldIndex, newIndex), std::max(oldIndex + 1, newIndex));
 		} else {
 			// Case 1b): remove picture
+			int oldIndex = oldPos - pictures.begin();
 			pictures.erase(oldPos);
+			calculatePictureYPositions(oldIndex, oldIndex);
 		}
 
-		// In both cases the picture list changed, therefore we must recalculate the y-coordinatesA.
-		calculatePictureYPositions();
+		// In both cases the picture list changed, therefore we must update the paint order.
+		updateThumbnailPaintOrder();
 	} else {
 		// Cases 2a) and 2b): picture not on profile. We only have to take action for
 		// the first case: picture is moved into dive-time.
@@ -2305,7 +2818,9 @@ void ProfileWidget2::pictureOffsetChanged(dive *d, QString filename, offset_t of
 			// the old iterator, since the buffer might have been reallocated).
 			newPos = pictures.emplace(newPos, offset, filename, scene(), false);
 			updateThumbnailXPos(*newPos);
-			calculatePictureYPositions();
+			int newIndex = newPos - pictures.begin();
+			calculatePictureYPositions(newIndex, newIndex + 1);
+			updateThumbnailPaintOrder();
 		}
 	}
 }
@@ -3,6 +3,8 @@
 #define PROFILEWIDGET2_H
 
 #include <QGraphicsView>
+#include <QFutureWatcher>
+#include <QTimer>
 #include <vector>
 #include <memory>
 
@@ -25,6 +27,7 @@
 
 class RulerItem2;
 struct dive;
+struct mem_usage;
 struct plot_info;
 class ToolTipItem;
 class DiveReportedCeiling;
@@ -37,6 +40,7 @@ class DiveRectItem;
 class DepthAxis;
 class DiveCartesianAxis;
 class DiveProfileItem;
+class DiveComparisonItem;
 class TimeAxis;
 class DiveTemperatureItem;
 class DiveHeartrateItem;
@@ -52,6 +56,9 @@ class QGraphicsSimpleTextItem;
 class QModelIndex;
 class DivePictureItem;
 
+// Fingerprint of all preferences that influence the plot
+uint64_t plotPrefsHash();
+
 class ProfileWidget2 : public QGraphicsView {
 	Q_OBJECT
 public:
@@ -88,10 +95,16 @@ public:
 #ifndef SUBSURFACE_MOBILE
 	bool eventFilter(QObject *, QEvent *) override;
 	void clearHandlers();
+	// Overlay the depth curves of other dives on the profile of the current dive
+	void setComparisonDives(const QVector<dive *> &dives);
+	// Calculate the plot data of the first few of the given dives in parallel,
+	// for plotting them one after the other. Returns the number of dives calculated.
+	size_t calculatePlotInfos(const struct dive *const *dives, size_t nr);
 #endif
 	void setToolTipVisibile(bool visible);
 	State currentState;
 	int animSpeed;
+	qint64 lastPlotDuration; // ms, for the animation budget
 
 signals:
 	void fontPrintScaleChanged(double scale);
@@ -120,6 +133,10 @@ slots: // Necessary to call from QAction's signals.
 	void updateThumbnail(QString filename, QImage thumbnail, duration_t duration);
 	void profileChanged(dive *d);
 	void pictureOffsetChanged(dive *d, QString filename, offset_t offset);
+	void plotJobFinished();
+	void comparisonJobsFinished();
+	void stopComparison();
+	void applyPendingThumbnails();
 
 	/* this is called for every move on the handlers. maybe we can speed up this a bit? */
 	void recreatePlannedDive();
@@ -151,8 +168,25 @@ private:
 	void dragMoveEvent(QDragMoveEvent *event) override;
 
 	void replot();
+	void createPlotInfo(struct divecomputer *dc);
+	void clearPlotInfoCache();
+	void checkPlotInfoCacheGeneration();
+	bool isPlotInfoCached(int diveId, unsigned int dcNr, uint64_t prefsHash);
+	void addToPlotInfoCache(int diveId, unsigned int dcNr, uint64_t prefsHash, enum divemode_t divemode, const struct plot_info &info);
+	static void reportMemoryUsage(struct mem_usage *usage, void *data);
+#ifndef SUBSURFACE_MOBILE
+	void plotDiveInBackground(const struct dive *d, unsigned int dcNr);
+	struct PlotJob;
+	PlotJob *createPlotJob(const struct dive *d, unsigned int dcNr);
+	static void calculatePlotJob(PlotJob *job);
+	void startComparisonJobs();
+	void clearComparison();
+	void createComparisonItems();
+	void clearComparisonItems();
+#endif
 	void changeGas(int tank, int seconds);
 	void fixBackgroundPos();
+	void updateDecimation();
 	void scrollViewTo(const QPoint &pos);
 	void setupSceneAndFlags();
 	void setupItemSizes();
@@ -190,6 +224,37 @@ private:
 	// So it's esyer to replicate for more dives later.
 	// In the meantime, keep it here.
 	struct plot_info plotInfo;
+	// Plot data of recently shown dive computers, most recently used first
+	struct PlotInfoCacheEntry {
+		int diveId;
+		unsigned int dcNr;
+		uint64_t prefsHash;
+		enum divemode_t divemode;
+		struct plot_info info;
+	};
+	std::vector<PlotInfoCacheEntry> plotInfoCache;
+	unsigned int plotInfoGeneration;
+#ifndef SUBSURFACE_MOBILE
+	// Plot data that is being calculated in a worker thread
+	PlotJob *plotJob;
+	QFutureWatcher<void> plotJobWatcher;
+	// Dives whose depth curves are overlaid on the current dive. Their plot data
+	// is calculated in parallel in worker threads, one job per dive.
+	struct ComparisonJob;
+	struct ComparisonCurve {
+		int number;
+		int maxtime, maxdepth;
+		QVector<QPointF> depths;
+	};
+	QVector<int> comparisonDiveIds;
+	std::vector<ComparisonCurve> comparisonCurves;
+	QVector<ComparisonJob *> comparisonJobs;
+	bool comparisonPending; // the dives changed while the jobs were running
+	QFutureWatcher<void> comparisonWatcher;
+	std::vector<DiveComparisonItem *> comparisonItems;
+	static void calculateComparisonJob(ComparisonJob *job);
+	static void setComparisonCurve(const struct plot_info &pi, int number, ComparisonCurve &curve);
+#endif
 	DepthAxis *profileYAxis;
 	PartialGasPressureAxis *gasYAxis;
 	TemperatureAxis *temperatureAxis;
@@ -248,8 +313,17 @@ private:
 	void updateThumbnailXPos(PictureEntry &e);
 	std::vector<PictureEntry> pictures;
 	void calculatePictureYPositions();
-	void updateDurationLine(PictureEntry &e);
+	void calculatePictureYPositions(size_t from, size_t to);
+	bool updateDurationLine(PictureEntry &e);
 	void updateThumbnailPaintOrder();
+	// Thumbnails arrive one by one from the thumbnailer. They are collected
+	// and applied together, at most once per frame.
+	struct PendingThumbnail {
+		QImage thumbnail;
+		duration_t duration;
+	};
+	QHash<QString, PendingThumbnail> pendingThumbnails;
+	QTimer pendingThumbnailsTimer;
 
 	QList<DiveHandler *> handles;
 	void repositionDiveHandlers();
@@ -7,16 +7,68 @@
 #include <QTransform>
 #include <QScreen>
 #include <QElapsedTimer>
+#include <QImage>
+#include <list>
 
 const double fontScale = 0.6; // profile looks less cluttered with smaller font
 
+// Rendering the profile scene is slow on phones. Therefore, keep the images of the
+// recently shown profiles, so that swiping back to a dive doesn't render it again.
+// The cache is shared by all profile items, i.e. by all pages of the swipe view.
+// An image is only valid for the same dive, geometry, zoom and pan, as well as for
+// the same preferences and dive data.
+struct ProfileImageKey {
+	int diveId;
+	unsigned int dcNr;
+	QSize size;
+	qreal dpr, scale, xOffset, yOffset;
+	uint64_t prefsHash;
+	unsigned int generation;
+	bool operator==(const ProfileImageKey &k) const
+	{
+		return diveId == k.diveId && dcNr == k.dcNr && size == k.size && dpr == k.dpr && scale == k.scale &&
+		       xOffset == k.xOffset && yOffset == k.yOffset && prefsHash == k.prefsHash && generation == k.generation;
+	}
+};
+
+struct ProfileImage {
+	ProfileImageKey key;
+	QImage image;
+};
+
+// Every image takes a few MB, so only keep a handful. The most recently used image is at the front.
+static const size_t profileImageCacheSize = 6;
+static std::list<ProfileImage> profileImageCache;
+
+static const QImage *findProfileImage(const ProfileImageKey &key)
+{
+	for (auto it = profileImageCache.begin(); it != profileImageCache.end(); ++it) {
+		if (it->key == key) {
+			profileImageCache.splice(profileImageCache.begin(), profileImageCache, it);
+			return &profileImageCache.front().image;
+		}
+	}
+	return nullptr;
+}
+
+static void addProfileImage(const ProfileImageKey &key, const QImage &image)
+{
+	profileImageCache.push_front({ key, image });
+	if (profileImageCache.size() > profileImageCacheSize)
+		profileImageCache.pop_back();
+}
+
 QMLProfile::QMLProfile(QQuickItem *parent) :
 	QQuickPaintedItem(parent),
+	m_diveId(-1),
 	m_devicePixelRatio(1.0),
 	m_margin(0),
 	m_xOffset(0.0),
 	m_yOffset(0.0),
-	m_profileWidget(new ProfileWidget2)
+	m_profileWidget(new ProfileWidget2),
+	m_plottedDiveId(-1),
+	m_plottedGeneration(0),
+	m_plottedPrefsHash(0)
 {
 	setAntialiasing(true);
 	setFlags(QQuickItem::ItemClipsChildrenToShape | QQuickItem::ItemHasContents );
@@ -107,12 +159,38 @@ void QMLProfile::paint(QPainter *painter)
 		    .arg(painterTransform.m31()).arg(painterTransform.m32()).arg(painterTransform.m33()));
 	qDebug() << "exist profile transform" << m_profileWidget->transform() << "painter transform" << painter->transform();
 #endif
+	// The image is cached in device coordinates
+	ProfileImageKey key { m_diveId, dc_number, painterRect.size(), dpr, profileScale, m_xOffset, m_yOffset,
+			      plotPrefsHash(), dive_data_generation };
+	painter->save();
+	painter->resetTransform();
+	const QImage *cached = findProfileImage(key);
+	if (cached) {
+		painter->drawImage(painterRect.topLeft(), *cached);
+		painter->restore();
+		if (verbose)
+			qDebug() << "painted cached profile in" << timer.elapsed() << "ms";
+		return;
+	}
+
+	// The profile is only plotted when it is actually painted and not cached
+	if (m_plottedDiveId != m_diveId || m_plottedGeneration != key.generation || m_plottedPrefsHash != key.prefsHash)
+		updateProfile();
+
 	// apply the transformation
-	painter->setTransform(painterTransform);
+	QImage image(painterRect.size(), QImage::Format_ARGB32_Premultiplied);
+	image.fill(Qt::transparent);
+	QPainter imagePainter(&image);
+	imagePainter.setRenderHints(painter->renderHints());
+	imagePainter.setTransform(painterTransform * QTransform::fromTranslate(-painterRect.x(), -painterRect.y()));
 	m_profileWidget->setTransform(profileTransform);
 
 	// finally, render the profile
-	m_profileWidget->render(painter);
+	m_profileWidget->render(&imagePainter);
+	imagePainter.end();
+	painter->drawImage(painterRect.topLeft(), image);
+	painter->restore();
+	addProfileImage(key, image);
 	if (verbose)
 		qDebug() << "finished rendering profile with offset" << QString::number(m_xOffset, 'f', 1) << "/" << QString::number(m_yOffset, 'f', 1)  << "in" << timer.elapsed() << "ms";
 }
@@ -135,14 +213,17 @@ void QMLProfile::updateProfile()
 	if (verbose)
 		qDebug() << "update profile for dive #" << d->number << "offeset" << QString::number(m_xOffset, 'f', 1) << "/" << QString::number(m_yOffset, 'f', 1);
 	m_profileWidget->plotDive(d, true);
+	m_plottedDiveId = m_diveId;
+	m_plottedGeneration = dive_data_generation;
+	m_plottedPrefsHash = plotPrefsHash();
 }
 
+// The profile is plotted on demand in paint(), if no image is cached
 void QMLProfile::setDiveId(int diveId)
 {
 	m_diveId = diveId;
-	if (m_diveId < 0)
-		return;
-	updateProfile();
+	if (m_diveId >= 0)
+		update();
 }
 
 qreal QMLProfile::devicePixelRatio() const
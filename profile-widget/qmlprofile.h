@@ -36,6 +36,9 @@ private:
 	int m_margin;
 	qreal m_xOffset, m_yOffset;
 	QScopedPointer<ProfileWidget2> m_profileWidget;
+	int m_plottedDiveId;
+	unsigned int m_plottedGeneration;
+	uint64_t m_plottedPrefsHash;
 	void updateProfile();
 
 signals:
@@ -74,6 +74,7 @@ RulerItem2::RulerItem2() : source(new RulerNodeItem2()),
 	textItem(new QGraphicsSimpleTextItem(this))
 {
 	memset(&pInfo, 0, sizeof(pInfo));
+	memset(&ranges, 0, sizeof(ranges));
 	source->setRuler(this);
 	dest->setRuler(this);
 	textItem->setFlag(QGraphicsItem::ItemIgnoresTransformations);
@@ -86,6 +87,11 @@ RulerItem2::RulerItem2() : source(new RulerNodeItem2()),
 #endif
 }
 
+RulerItem2::~RulerItem2()
+{
+	free_plot_ranges(&ranges);
+}
+
 void RulerItem2::settingsChanged(bool value)
 {
 	ProfileWidget2 *profWidget = NULL;
@@ -116,7 +122,9 @@ void RulerItem2::recalculate()
 	}
 	QLineF line(startPoint, endPoint);
 	setLine(line);
-	compare_samples(&pInfo, source->idx, dest->idx, buffer, 500, 1);
+	if (!ranges.depth_time)
+		init_plot_ranges(&ranges, &pInfo);
+	compare_samples(&pInfo, &ranges, source->idx, dest->idx, buffer, 500, 1);
 	text = QString(buffer);
 
 	// draw text
@@ -154,6 +162,7 @@ RulerNodeItem2 *RulerItem2::destNode() const
 void RulerItem2::setPlotInfo(const plot_info &info)
 {
 	pInfo = info;
+	free_plot_ranges(&ranges);
 	dest->setPlotInfo(info);
 	source->setPlotInfo(info);
 	dest->recalculate();
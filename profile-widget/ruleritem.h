@@ -7,6 +7,7 @@
 #include <QGraphicsObject>
 #include "profile-widget/divecartesianaxis.h"
 #include "core/display.h"
+#include "core/profile.h"
 
 struct plot_data;
 class RulerItem2;
@@ -34,6 +35,7 @@ class RulerItem2 : public QObject, public QGraphicsLineItem {
 	Q_OBJECT
 public:
 	explicit RulerItem2();
+	~RulerItem2();
 	void recalculate();
 
 	void setPlotInfo(const struct plot_info &pInfo);
@@ -48,6 +50,7 @@ slots:
 
 private:
 	struct plot_info pInfo;
+	struct plot_ranges ranges;	// built on first use for pInfo
 	QPointF startPoint, endPoint;
 	RulerNodeItem2 *source, *dest;
 	QString text;
@@ -2,48 +2,142 @@
 #include "qt-models/completionmodels.h"
 #include "core/dive.h"
 #include "core/tag.h"
-#include <QSet>
+#include "core/subsurface-string.h"
 #include <QString>
 
-#define CREATE_UPDATE_METHOD(Class, diveStructMember)          \
-	void Class::updateModel()                              \
-	{                                                      \
-		QStringList list;                              \
-		struct dive *dive;                             \
-		int i = 0;                                     \
-		for_each_dive (i, dive)                        \
-		{                                              \
-			QString buddy(dive->diveStructMember); \
-			if (!list.contains(buddy)) {           \
-				list.append(buddy);            \
-			}                                      \
-		}                                              \
-		std::sort(list.begin(), list.end());           \
-		setStringList(list);                           \
+DiveStringCompletionModel::DiveStringCompletionModel() :
+	initialized(false),
+	listChanged(false)
+{
+	connect(&diveListNotifier, &DiveListNotifier::dataReset, this, &DiveStringCompletionModel::reset);
+	connect(&diveListNotifier, &DiveListNotifier::divesAdded, this, &DiveStringCompletionModel::divesAdded);
+	connect(&diveListNotifier, &DiveListNotifier::divesDeleted, this, &DiveStringCompletionModel::divesDeleted);
+	connect(&diveListNotifier, &DiveListNotifier::divesChanged, this, &DiveStringCompletionModel::divesChanged);
+}
+
+void DiveStringCompletionModel::updateModel()
+{
+	if (!initialized)
+		reset();
+}
+
+void DiveStringCompletionModel::addDive(const dive *d)
+{
+	QStringList list = diveValues(d);
+	for (const QString &value: list) {
+		if (counts[value]++ == 0)
+			listChanged = true;
+	}
+	values.insert(d, list);
+}
+
+void DiveStringCompletionModel::removeDive(const dive *d)
+{
+	auto it = values.find(d);
+	if (it == values.end())
+		return;
+	for (const QString &value: *it) {
+		auto count = counts.find(value);
+		if (count != counts.end() && --*count <= 0) {
+			counts.erase(count);
+			listChanged = true;
+		}
+	}
+	values.erase(it);
+}
+
+// Only reset the string list if a value was added or removed, not if only the counts changed
+void DiveStringCompletionModel::updateList()
+{
+	if (listChanged)
+		setStringList(counts.keys());
+	listChanged = false;
+}
+
+void DiveStringCompletionModel::reset()
+{
+	struct dive *dive;
+	int i;
+
+	counts.clear();
+	values.clear();
+	for_each_dive (i, dive)
+		addDive(dive);
+	listChanged = true;
+	initialized = true;
+	updateList();
+}
+
+void DiveStringCompletionModel::divesAdded(dive_trip *, bool, const QVector<dive *> &dives)
+{
+	if (!initialized)
+		return;
+	for (const dive *d: dives)
+		addDive(d);
+	updateList();
+}
+
+void DiveStringCompletionModel::divesDeleted(dive_trip *, bool, const QVector<dive *> &dives)
+{
+	if (!initialized)
+		return;
+	for (const dive *d: dives)
+		removeDive(d);
+	updateList();
+}
+
+void DiveStringCompletionModel::divesChanged(const QVector<dive *> &dives, DiveField field)
+{
+	if (!initialized || !isField(field))
+		return;
+	for (const dive *d: dives) {
+		removeDive(d);
+		addDive(d);
 	}
+	updateList();
+}
 
-#define CREATE_CSV_UPDATE_METHOD(Class, diveStructMember)                                        \
-	void Class::updateModel()                                                                \
-	{                                                                                        \
-		QSet<QString> set;                                                               \
-		struct dive *dive;                                                               \
-		int i = 0;                                                                       \
-		for_each_dive (i, dive)                                                          \
-		{                                                                                \
-			QString buddy(dive->diveStructMember);                                   \
-			foreach (const QString &value, buddy.split(",", QString::SkipEmptyParts)) \
-			{                                                                        \
-				set.insert(value.trimmed());                                     \
-			}                                                                        \
-		}                                                                                \
-		QStringList setList = set.values();                                              \
-		std::sort(setList.begin(), setList.end());                                       \
-		setStringList(setList);                                                     \
+// Buddies and divemasters are comma separated lists
+static QStringList splitValues(const char *s)
+{
+	QStringList res;
+	for (const QString &value: QString(s).split(",", QString::SkipEmptyParts)) {
+		QString trimmed = value.trimmed();
+		if (!trimmed.isEmpty())
+			res.append(trimmed);
 	}
+	return res;
+}
+
+QStringList BuddyCompletionModel::diveValues(const dive *d) const
+{
+	return splitValues(d->buddy);
+}
+
+bool BuddyCompletionModel::isField(DiveField field) const
+{
+	return field.buddy;
+}
 
-CREATE_CSV_UPDATE_METHOD(BuddyCompletionModel, buddy);
-CREATE_CSV_UPDATE_METHOD(DiveMasterCompletionModel, divemaster);
-CREATE_UPDATE_METHOD(SuitCompletionModel, suit);
+QStringList DiveMasterCompletionModel::diveValues(const dive *d) const
+{
+	return splitValues(d->divemaster);
+}
+
+bool DiveMasterCompletionModel::isField(DiveField field) const
+{
+	return field.divemaster;
+}
+
+QStringList SuitCompletionModel::diveValues(const dive *d) const
+{
+	return empty_string(d->suit) ? QStringList() : QStringList(QString(d->suit));
+}
+
+bool SuitCompletionModel::isField(DiveField field) const
+{
+	return field.suit;
+}
 
 void TagCompletionModel::updateModel()
 {
@@ -2,24 +2,58 @@
 #ifndef COMPLETIONMODELS_H
 #define COMPLETIONMODELS_H
 
+#include "core/subsurface-qt/divelistnotifier.h"
 #include <QStringListModel>
+#include <QHash>
+#include <QMap>
 
-class BuddyCompletionModel : public QStringListModel {
+struct dive;
+
+// Completion model for a string field of the dives. The number of dives using
+// each value is counted, so that the list can be kept current from the
+// DiveListNotifier signals instead of scanning the whole logbook after each edit.
+class DiveStringCompletionModel : public QStringListModel {
 	Q_OBJECT
 public:
-	void updateModel();
+	void updateModel();	// Builds the list on first use, afterwards it is kept up to date
+protected:
+	DiveStringCompletionModel();
+	virtual QStringList diveValues(const dive *d) const = 0;
+	virtual bool isField(DiveField field) const = 0;
+private slots:
+	void reset();
+	void divesAdded(dive_trip *trip, bool addTrip, const QVector<dive *> &dives);
+	void divesDeleted(dive_trip *trip, bool deleteTrip, const QVector<dive *> &dives);
+	void divesChanged(const QVector<dive *> &dives, DiveField field);
+private:
+	void addDive(const dive *d);
+	void removeDive(const dive *d);
+	void updateList();
+	bool initialized;
+	bool listChanged;
+	QMap<QString, int> counts;			// Number of dives per value, sorted
+	QHash<const dive *, QStringList> values;	// The values counted for each dive
 };
 
-class DiveMasterCompletionModel : public QStringListModel {
+class BuddyCompletionModel : public DiveStringCompletionModel {
 	Q_OBJECT
-public:
-	void updateModel();
+private:
+	QStringList diveValues(const dive *d) const override;
+	bool isField(DiveField field) const override;
 };
 
-class SuitCompletionModel : public QStringListModel {
+class DiveMasterCompletionModel : public DiveStringCompletionModel {
 	Q_OBJECT
-public:
-	void updateModel();
+private:
+	QStringList diveValues(const dive *d) const override;
+	bool isField(DiveField field) const override;
+};
+
+class SuitCompletionModel : public DiveStringCompletionModel {
+	Q_OBJECT
+private:
+	QStringList diveValues(const dive *d) const override;
+	bool isField(DiveField field) const override;
 };
 
 class TagCompletionModel : public QStringListModel {
@@ -9,6 +9,7 @@
 #include "core/gettextfromc.h"
 #include "core/subsurface-qt/divelistnotifier.h"
 #include "core/subsurface-string.h"
+#include "core/arena.h"
 #include <string>
 
 CylindersModel::CylindersModel(bool planner, QObject *parent) : CleanerTableModel(parent),
@@ -25,6 +26,11 @@ CylindersModel::CylindersModel(bool planner, QObject *parent) : CleanerTableMode
 	connect(&diveListNotifier, &DiveListNotifier::cylinderAdded, this, &CylindersModel::cylinderAdded);
 	connect(&diveListNotifier, &DiveListNotifier::cylinderRemoved, this, &CylindersModel::cylinderRemoved);
 	connect(&diveListNotifier, &DiveListNotifier::cylinderEdited, this, &CylindersModel::cylinderEdited);
+
+	// Rows are shifted or replaced: drop all cached volumes
+	connect(this, &QAbstractItemModel::modelReset, [this]() { volumeCache.clear(); });
+	connect(this, &QAbstractItemModel::rowsInserted, [this]() { volumeCache.clear(); });
+	connect(this, &QAbstractItemModel::rowsRemoved, [this]() { volumeCache.clear(); });
 }
 
 QVariant CylindersModel::headerData(int section, Qt::Orientation orientation, int role) const
@@ -72,52 +78,57 @@ static QString gas_volume_string(int ml, const char *tail)
 	return QString("%L1 %2 %3").arg(vol, 0, 'f', decimals).arg(unit).arg(tail);
 }
 
-static QVariant gas_wp_tooltip(const cylinder_t *cyl);
-
-static QVariant gas_usage_tooltip(const cylinder_t *cyl)
-{
-	pressure_t startp = cyl->start.mbar ? cyl->start : cyl->sample_start;
-	pressure_t endp = cyl->end.mbar ? cyl->end : cyl->sample_end;
-
-	int start, end, used;
-
-	start = gas_volume(cyl, startp);
-	end = gas_volume(cyl, endp);
-	used = (end && start > end) ? start - end : 0;
-
-	if (!used)
-		return gas_wp_tooltip(cyl);
-
-	return gas_volume_string(used, "(") +
-		gas_volume_string(start, " -> ") +
-		gas_volume_string(end, ")");
-}
-
-static QVariant gas_volume_tooltip(const cylinder_t *cyl, pressure_t p)
+static QVariant gas_volume_tooltip(int vol, double Z)
 {
-	int vol = gas_volume(cyl, p);
-	double Z;
-
 	if (!vol)
 		return QVariant();
 
-	Z = gas_compressibility_factor(cyl->gasmix, p.mbar / 1000.0);
 	return gas_volume_string(vol, "(Z=") + QString("%1)").arg(Z, 0, 'f', 3);
 }
 
-static QVariant gas_wp_tooltip(const cylinder_t *cyl)
+static void calculate_volume(const cylinder_t *cyl, pressure_t p, int &vol, double &Z)
 {
-	return gas_volume_tooltip(cyl, cyl->type.workingpressure);
+	vol = gas_volume(cyl, p);
+	Z = vol ? gas_compressibility_factor(cyl->gasmix, p.mbar / 1000.0) : 0.0;
 }
 
-static QVariant gas_start_tooltip(const cylinder_t *cyl)
+const CylindersModel::CylinderVolumes &CylindersModel::volumes(int row, const cylinder_t *cyl) const
 {
-	return gas_volume_tooltip(cyl, cyl->start.mbar ? cyl->start : cyl->sample_start);
+	pressure_t startp = cyl->start.mbar ? cyl->start : cyl->sample_start;
+	pressure_t endp = cyl->end.mbar ? cyl->end : cyl->sample_end;
+
+	if ((int)volumeCache.size() <= row)
+		volumeCache.resize(row + 1, CylinderVolumes { false });
+	CylinderVolumes &res = volumeCache[row];
+	if (res.valid && res.o2.permille == cyl->gasmix.o2.permille && res.he.permille == cyl->gasmix.he.permille &&
+	    res.size.mliter == cyl->type.size.mliter && res.wp.mbar == cyl->type.workingpressure.mbar &&
+	    res.startp.mbar == startp.mbar && res.endp.mbar == endp.mbar)
+		return res;
+
+	res.valid = true;
+	res.o2 = cyl->gasmix.o2;
+	res.he = cyl->gasmix.he;
+	res.size = cyl->type.size;
+	res.wp = cyl->type.workingpressure;
+	res.startp = startp;
+	res.endp = endp;
+	calculate_volume(cyl, res.wp, res.wpVolume, res.wpZ);
+	calculate_volume(cyl, startp, res.startVolume, res.startZ);
+	calculate_volume(cyl, endp, res.endVolume, res.endZ);
+	return res;
 }
 
-static QVariant gas_end_tooltip(const cylinder_t *cyl)
+QVariant CylindersModel::gasUsageTooltip(int row, const cylinder_t *cyl) const
 {
-	return gas_volume_tooltip(cyl, cyl->end.mbar ? cyl->end : cyl->sample_end);
+	const CylinderVolumes &v = volumes(row, cyl);
+	int used = (v.endVolume && v.startVolume > v.endVolume) ? v.startVolume - v.endVolume : 0;
+
+	if (!used)
+		return gas_volume_tooltip(v.wpVolume, v.wpZ);
+
+	return gas_volume_string(used, "(") +
+		gas_volume_string(v.startVolume, " -> ") +
+		gas_volume_string(v.endVolume, ")");
 }
 
 static QVariant percent_string(fraction_t fraction)
@@ -267,13 +278,19 @@ QVariant CylindersModel::data(const QModelIndex &index, int role) const
 			return tr("Clicking here will remove this cylinder.");
 		case TYPE:
 		case SIZE:
-			return gas_usage_tooltip(cyl);
-		case WORKINGPRESS:
-			return gas_wp_tooltip(cyl);
-		case START:
-			return gas_start_tooltip(cyl);
-		case END:
-			return gas_end_tooltip(cyl);
+			return gasUsageTooltip(index.row(), cyl);
+		case WORKINGPRESS: {
+			const CylinderVolumes &v = volumes(index.row(), cyl);
+			return gas_volume_tooltip(v.wpVolume, v.wpZ);
+		}
+		case START: {
+			const CylinderVolumes &v = volumes(index.row(), cyl);
+			return gas_volume_tooltip(v.startVolume, v.startZ);
+		}
+		case END: {
+			const CylinderVolumes &v = volumes(index.row(), cyl);
+			return gas_volume_tooltip(v.endVolume, v.endZ);
+		}
 		case DEPTH:
 			return tr("Switch depth for deco gas. Calculated using Deco pO₂ preference, unless set manually.");
 		case MOD:
@@ -319,7 +336,7 @@ bool CylindersModel::setData(const QModelIndex &index, const QVariant &value, in
 		case TYPE: {
 			QString type = value.toString();
 			if (!same_string(qPrintable(type), tempCyl.type.description)) {
-				free((void *)tempCyl.type.description);
+				arena_free((void *)tempCyl.type.description);
 				tempCyl.type.description = strdup(qPrintable(type));
 				dataChanged(index, index);
 			}
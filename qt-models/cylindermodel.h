@@ -6,6 +6,7 @@
 
 #include "cleanertablemodel.h"
 #include "core/equipment.h"
+#include <vector>
 
 /* Encapsulation of the Cylinder Model, that presents the
  * Current cylinders that are used on a dive. */
@@ -70,6 +71,22 @@ private:
 	int tempRow;
 	cylinder_t tempCyl;
 
+	// The gas volumes of the tooltips involve the compressibility model.
+	// They are cached per row, together with the cylinder data they were
+	// calculated from, so that changed cylinders are recalculated even
+	// if they are edited in place, as in the planner.
+	struct CylinderVolumes {
+		bool valid;
+		fraction_t o2, he;
+		volume_t size;
+		pressure_t wp, startp, endp;
+		int wpVolume, startVolume, endVolume; // in ml
+		double wpZ, startZ, endZ;
+	};
+	mutable std::vector<CylinderVolumes> volumeCache;
+	const CylinderVolumes &volumes(int row, const cylinder_t *cyl) const;
+	QVariant gasUsageTooltip(int row, const cylinder_t *cyl) const;
+
 	cylinder_t *cylinderAt(const QModelIndex &index);
 	void initTempCyl(int row);
 	void clearTempCyl();
@@ -4,7 +4,7 @@
 #include "core/divelist.h"
 
 DiveComputerModel::DiveComputerModel(QObject *parent) : CleanerTableModel(parent),
-	dcs(dcList.dcs)
+	dcs(dcList.getDCs())
 {
 	setHeaderDataStrings(QStringList() << "" << tr("Model") << tr("Device ID") << tr("Nickname"));
 }
@@ -75,7 +75,7 @@ void DiveComputerModel::remove(const QModelIndex &index)
 
 void DiveComputerModel::keepWorkingList()
 {
-	if (dcList.dcs != dcs)
+	if (dcList.getDCs() != dcs)
 		mark_divelist_changed(true);
-	dcList.dcs = dcs;
+	dcList.setDCs(dcs);
 }
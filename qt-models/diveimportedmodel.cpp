@@ -1,8 +1,11 @@
 #include "diveimportedmodel.h"
 #include "core/qthelper.h"
 #include "core/divelist.h"
+#include "core/downloadstats.h"
 #include "commands/command.h"
 
+#include <QDebug>
+
 DiveImportedModel::DiveImportedModel(QObject *o) : QAbstractTableModel(o),
 	diveTable(empty_dive_table),
 	sitesTable(empty_dive_site_table)
@@ -194,7 +197,10 @@ void DiveImportedModel::recordDives(int flags)
 	std::pair<struct dive_table, struct dive_site_table> tables = consumeTables();
 	if (tables.first.nr > 0) {
 		auto data = thread.data();
+		uint64_t start = download_stats_now();
 		Command::importDives(&tables.first, nullptr, &tables.second, nullptr, flags, data->devName());
+		download_stats_phase(DOWNLOAD_PROCESS, start);
+		qDebug() << "Download statistics after adding the dives:" << downloadStats();
 	} else {
 		clear_dive_site_table(&tables.second);
 	}
@@ -204,6 +210,14 @@ void DiveImportedModel::recordDives(int flags)
 	free(tables.second.dive_sites);
 }
 
+// The statistics of the current or last download
+QString DiveImportedModel::downloadStats() const
+{
+	struct download_stats stats;
+	download_stats_get(&stats);
+	return formatDownloadStats(stats);
+}
+
 QHash<int, QByteArray> DiveImportedModel::roleNames() const {
 	static QHash<int, QByteArray> roles = {
 		{ DateTime, "datetime"},
@@ -175,16 +175,45 @@ void LocationInformationModel::diveSiteDivesChanged(struct dive_site *ds)
 	dataChanged(createIndex(idx, NUM_DIVES), createIndex(idx, NUM_DIVES));
 }
 
+const DiveSiteSortedModel::SiteKeys &DiveSiteSortedModel::keys(const dive_site *ds) const
+{
+	std::unique_ptr<SiteKeys> &res = siteKeys[ds];
+	if (!res) {
+		QString name(ds->name);
+		QString text = name + QString(ds->description) + QString(ds->notes);
+		res.reset(new SiteKeys { collator.sortKey(name), text.toCaseFolded() });
+	}
+	return *res;
+}
+
+void DiveSiteSortedModel::invalidateSite(const dive_site *ds)
+{
+	siteKeys.erase(ds);
+	matches.erase(ds);
+	matchesValid = false;
+}
+
+void DiveSiteSortedModel::invalidateAllSites()
+{
+	siteKeys.clear();
+	matches.clear();
+	matchesValid = false;
+}
+
 bool DiveSiteSortedModel::filterAcceptsRow(int sourceRow, const QModelIndex &source_parent) const
 {
 	if (fullText.isEmpty())
 		return true;
 
-	if (sourceRow < 0 || sourceRow > dive_site_table.nr)
+	if (sourceRow < 0 || sourceRow >= dive_site_table.nr)
 		return false;
 	struct dive_site *ds = dive_site_table.dive_sites[sourceRow];
-	QString text = QString(ds->name) + QString(ds->description) + QString(ds->notes);
-	return text.contains(fullText, Qt::CaseInsensitive);
+	if (narrowing && !previousMatches.count(ds))
+		return false;
+	if (!keys(ds).searchText.contains(fullText))
+		return false;
+	matches.insert(ds);
+	return true;
 }
 
 bool DiveSiteSortedModel::lessThan(const QModelIndex &i1, const QModelIndex &i2) const
@@ -199,25 +228,41 @@ bool DiveSiteSortedModel::lessThan(const QModelIndex &i1, const QModelIndex &i2)
 	switch (i1.column()) {
 	case LocationInformationModel::NAME:
 	default:
-		return QString::localeAwareCompare(QString(ds1->name), QString(ds2->name)) < 0; // TODO: avoid copy
+		return keys(ds1).name.compare(keys(ds2).name) < 0;
 	case LocationInformationModel::DESCRIPTION: {
-		int cmp = QString::localeAwareCompare(QString(ds1->description), QString(ds2->description)); // TODO: avoid copy
-		return cmp != 0 ? cmp < 0 :
-		       QString::localeAwareCompare(QString(ds1->name), QString(ds2->name)) < 0; // TODO: avoid copy
+		// Sorting by description is rare: not worth a sort key
+		int cmp = QString::localeAwareCompare(QString(ds1->description), QString(ds2->description));
+		return cmp != 0 ? cmp < 0 : keys(ds1).name.compare(keys(ds2).name) < 0;
 	}
 	case LocationInformationModel::NUM_DIVES: {
 		int cmp = ds1->dives.nr - ds2->dives.nr;
 		// Since by default nr dives is descending, invert sort direction of names, such that
 		// the names are listed as ascending.
-		return cmp != 0 ? cmp < 0 :
-		       QString::localeAwareCompare(QString(ds1->name), QString(ds2->name)) < 0; // TODO: avoid copy
+		return cmp != 0 ? cmp < 0 : keys(ds1).name.compare(keys(ds2).name) < 0;
 	}
 	}
 }
 
-DiveSiteSortedModel::DiveSiteSortedModel()
+DiveSiteSortedModel::DiveSiteSortedModel() : matchesValid(false), narrowing(false)
 {
-	setSourceModel(LocationInformationModel::instance());
+	// Connect to the source model before it is set, so that the keys are dropped
+	// before QSortFilterProxyModel filters and sorts the changed rows again.
+	LocationInformationModel *source = LocationInformationModel::instance();
+	connect(source, &QAbstractItemModel::dataChanged, this, [this](const QModelIndex &from, const QModelIndex &to) {
+		if (from.column() > LocationInformationModel::NOTES || to.column() < LocationInformationModel::NAME)
+			return; // E.g. the number of dives
+		for (int row = from.row(); row <= to.row(); ++row)
+			invalidateSite(get_dive_site(row, &dive_site_table));
+	});
+	connect(source, &QAbstractItemModel::rowsInserted, this, [this](const QModelIndex &, int from, int to) {
+		// A new site may reuse the address of a deleted one
+		for (int row = from; row <= to; ++row)
+			invalidateSite(get_dive_site(row, &dive_site_table));
+	});
+	connect(source, &QAbstractItemModel::modelReset, this, &DiveSiteSortedModel::invalidateAllSites);
+	connect(&diveListNotifier, &DiveListNotifier::diveSiteDeleted, this,
+		[this](dive_site *ds, int) { invalidateSite(ds); });
+	setSourceModel(source);
 }
 
 QStringList DiveSiteSortedModel::allSiteNames() const
@@ -265,8 +310,16 @@ bool DiveSiteSortedModel::setData(const QModelIndex &index, const QVariant &valu
 
 void DiveSiteSortedModel::setFilter(const QString &text)
 {
-	fullText = text.trimmed();
+	QString newText = text.trimmed().toCaseFolded();
+	narrowing = matchesValid && !fullText.isEmpty() && newText.contains(fullText);
+	if (narrowing)
+		previousMatches.swap(matches);
+	matches.clear();
+	fullText = newText;
 	invalidateFilter();
+	previousMatches.clear();
+	narrowing = false;
+	matchesValid = !fullText.isEmpty();
 }
 
 GeoReferencingOptionsModel *GeoReferencingOptionsModel::instance()
@@ -5,6 +5,10 @@
 #include <QAbstractTableModel>
 #include <QStringListModel>
 #include <QSortFilterProxyModel>
+#include <QCollator>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include "core/units.h"
 
 #define RECENTLY_ADDED_DIVESITE ((struct dive_site *)~0)
@@ -44,7 +48,26 @@ class DiveSiteSortedModel : public QSortFilterProxyModel {
 private:
 	bool filterAcceptsRow(int sourceRow, const QModelIndex &source_parent) const override;
 	bool lessThan(const QModelIndex &i1, const QModelIndex &i2) const override;
-	QString fullText;
+	QString fullText; // case folded
+
+	// Sort keys and case folded search text of the dive sites, calculated
+	// when first needed and dropped when the site changes.
+	struct SiteKeys {
+		QCollatorSortKey name;
+		QString searchText;
+	};
+	QCollator collator;
+	mutable std::unordered_map<const dive_site *, std::unique_ptr<SiteKeys>> siteKeys;
+	const SiteKeys &keys(const dive_site *ds) const;
+
+	// The sites that passed the filter. When the user types on, i.e. the
+	// new filter text contains the old one, only these have to be checked.
+	mutable std::unordered_set<const dive_site *> matches;
+	std::unordered_set<const dive_site *> previousMatches;
+	bool matchesValid;
+	bool narrowing;
+	void invalidateSite(const dive_site *ds);
+	void invalidateAllSites();
 #ifndef SUBSURFACE_MOBILE
 	bool setData(const QModelIndex &index, const QVariant &value, int role) override;
 #endif // SUBSURFACE_MOBILE
@@ -3,6 +3,7 @@
 #include "core/divelist.h" // for comp_dives
 #include "core/metrics.h"
 #include "core/imagedownloader.h"
+#include "core/memusage.h"
 #include "core/picture.h"
 #include "core/qthelper.h"
 #include "core/subsurface-qt/divelistnotifier.h"
@@ -10,9 +11,13 @@
 
 #include <QFileInfo>
 #include <QPainter>
+#include <algorithm>
 
 PictureEntry::PictureEntry(dive *dIn, const PictureObj &p) : d(dIn),
 	filename(p.filename),
+	thumbnailRequested(false),
+	imageBytes(0),
+	lastUse(0),
 	offsetSeconds(p.offset.seconds),
 	length({ 0 })
 {
@@ -20,6 +25,9 @@ PictureEntry::PictureEntry(dive *dIn, const PictureObj &p) : d(dIn),
 
 PictureEntry::PictureEntry(dive *dIn, const picture &p) : d(dIn),
 	filename(p.filename),
+	thumbnailRequested(false),
+	imageBytes(0),
+	lastUse(0),
 	offsetSeconds(p.offset.seconds),
 	length({ 0 })
 {
@@ -43,7 +51,14 @@ DivePictureModel *DivePictureModel::instance()
 	return self;
 }
 
-DivePictureModel::DivePictureModel() : zoomLevel(0.0)
+// Default memory for the thumbnails of the model
+static const qint64 defaultMemoryBudget = 128 * 1024 * 1024;
+
+DivePictureModel::DivePictureModel() : pictureIndexValid(false),
+	zoomLevel(0.0),
+	memoryBudget(defaultMemoryBudget),
+	useCounter(0),
+	imageMemory(0)
 {
 	connect(Thumbnailer::instance(), &Thumbnailer::thumbnailChanged,
 		this, &DivePictureModel::updateThumbnail, Qt::QueuedConnection);
@@ -53,6 +68,16 @@ DivePictureModel::DivePictureModel() : zoomLevel(0.0)
 		this, &DivePictureModel::picturesRemoved);
 	connect(&diveListNotifier, &DiveListNotifier::picturesAdded,
 		this, &DivePictureModel::picturesAdded);
+	memusage_register(MEM_THUMBNAILS, &DivePictureModel::reportMemoryUsage, this);
+}
+
+// The loaded thumbnails, not counting the shared placeholder image
+void DivePictureModel::reportMemoryUsage(struct mem_usage *usage, void *data)
+{
+	const DivePictureModel *self = static_cast<const DivePictureModel *>(data);
+	usage->bytes = self->imageMemory;
+	usage->objects = std::count_if(self->pictures.begin(), self->pictures.end(),
+				       [](const PictureEntry &entry) { return entry.imageBytes > 0; });
 }
 
 void DivePictureModel::setZoomLevel(int level)
@@ -72,16 +97,56 @@ void DivePictureModel::updateZoom()
 	size = Thumbnailer::thumbnailSize(zoomLevel);
 }
 
+void DivePictureModel::setMemoryBudget(qint64 bytes)
+{
+	memoryBudget = bytes;
+	evictThumbnails();
+}
+
+// Thumbnails are only fetched when the view asks for them, see data(),
+// so that selecting thousands of pictures doesn't compute thousands of thumbnails.
 void DivePictureModel::updateThumbnails()
 {
 	updateZoom();
-	for (PictureEntry &entry: pictures)
-		entry.image = Thumbnailer::instance()->fetchThumbnail(QString::fromStdString(entry.filename), false);
+	imageMemory = 0;
+}
+
+void DivePictureModel::requestThumbnail(const PictureEntry &entry) const
+{
+	entry.thumbnailRequested = true;
+	entry.image = Thumbnailer::instance()->fetchThumbnail(QString::fromStdString(entry.filename), false, Thumbnailer::VISIBLE);
+	entry.imageBytes = 0;
+}
+
+// If the thumbnails take more than the budget, drop the least recently shown
+// ones until a quarter of the budget is free, so that this doesn't happen for
+// every new thumbnail. The view will fetch them again if they reappear.
+void DivePictureModel::evictThumbnails()
+{
+	if (imageMemory <= memoryBudget)
+		return;
+	std::vector<int> loaded;
+	for (int i = 0; i < (int)pictures.size(); ++i) {
+		if (pictures[i].imageBytes > 0)
+			loaded.push_back(i);
+	}
+	std::sort(loaded.begin(), loaded.end(),
+		  [this](int i1, int i2) { return pictures[i1].lastUse < pictures[i2].lastUse; });
+	for (int i: loaded) {
+		if (imageMemory <= memoryBudget / 4 * 3)
+			break;
+		PictureEntry &entry = pictures[i];
+		imageMemory -= entry.imageBytes;
+		entry.image = QImage();
+		entry.imageBytes = 0;
+		entry.thumbnailRequested = false;
+	}
 }
 
 void DivePictureModel::updateDivePictures()
 {
 	beginResetModel();
+	pictureIndexValid = false;
 	if (!pictures.empty()) {
 		pictures.clear();
 		Thumbnailer::instance()->clearWorkQueue();
@@ -122,6 +187,10 @@ QVariant DivePictureModel::data(const QModelIndex &index, int role) const
 		case Qt::ToolTipRole:
 			return QString::fromStdString(entry.filename);
 		case Qt::DecorationRole:
+			// The view only asks for the thumbnails it shows: fetch these on demand
+			entry.lastUse = ++useCounter;
+			if (!entry.thumbnailRequested)
+				requestThumbnail(entry);
 			return entry.image.scaled(size, size, Qt::KeepAspectRatio);
 		case Qt::DisplayRole:
 			return QFileInfo(QString::fromStdString(entry.filename)).fileName();
@@ -192,7 +261,10 @@ void DivePictureModel::picturesRemoved(dive *d, QVector<QString> filenamesIn)
 		// Qt's model-interface is surprisingly idiosyncratic: you don't pass [first last), but [first last] ranges.
 		// For example, an empty list would be [0 -1].
 		beginRemoveRows(QModelIndex(), i, j - 1);
+		for (size_t k = i; k < j; ++k)
+			imageMemory -= pictures[k].imageBytes;
 		pictures.erase(pictures.begin() + i, pictures.begin() + j);
+		pictureIndexValid = false;
 		endRemoveRows();
 		toIdx -= j - i;
 	}
@@ -229,9 +301,7 @@ void DivePictureModel::picturesAdded(dive *d, QVector<PictureObj> picsIn)
 		int batch_size = to - from;
 		beginInsertRows(QModelIndex(), dest, dest + batch_size - 1);
 		pictures.insert(pictures.begin() + dest, from, to);
-		// Get thumbnails of inserted pictures
-		for (auto it = pictures.begin() + dest; it < pictures.begin() + dest + batch_size; ++it)
-			it->image = Thumbnailer::instance()->fetchThumbnail(QString::fromStdString(it->filename), false);
+		pictureIndexValid = false;
 		endInsertRows();
 		from = to;
 		dest += batch_size;
@@ -245,10 +315,16 @@ int DivePictureModel::rowCount(const QModelIndex&) const
 
 int DivePictureModel::findPictureId(const std::string &filename)
 {
-	for (int i = 0; i < (int)pictures.size(); ++i)
-		if (pictures[i].filename == filename)
-			return i;
-	return -1;
+	if (!pictureIndexValid) {
+		pictureIndex.clear();
+		pictureIndex.reserve(pictures.size());
+		// emplace() doesn't overwrite: a picture shared by two dives maps to the first entry
+		for (int i = 0; i < (int)pictures.size(); ++i)
+			pictureIndex.emplace(pictures[i].filename, i);
+		pictureIndexValid = true;
+	}
+	auto it = pictureIndex.find(filename);
+	return it != pictureIndex.end() ? it->second : -1;
 }
 
 static void addDurationToThumbnail(QImage &img, duration_t duration)
@@ -282,12 +358,23 @@ void DivePictureModel::updateThumbnail(QString filename, QImage thumbnail, durat
 {
 	int i = findPictureId(filename.toStdString());
 	if (i >= 0) {
-		if (duration.seconds > 0) {
-			addDurationToThumbnail(thumbnail, duration);	// If we know the duration paint it on top of the thumbnail
-			pictures[i].length = duration;
+		PictureEntry &entry = pictures[i];
+		if (duration.seconds > 0)
+			entry.length = duration;
+		// Don't keep thumbnails that were evicted in the meantime
+		if (!entry.thumbnailRequested) {
+			emit dataChanged(createIndex(i, 0), createIndex(i, 1));
+			return;
 		}
-		pictures[i].image = thumbnail;
+		if (duration.seconds > 0)
+			addDurationToThumbnail(thumbnail, duration);	// If we know the duration paint it on top of the thumbnail
+		imageMemory -= entry.imageBytes;
+		entry.image = thumbnail;
+		entry.imageBytes = (qint64)thumbnail.bytesPerLine() * thumbnail.height();
+		imageMemory += entry.imageBytes;
+		entry.lastUse = ++useCounter;
 		emit dataChanged(createIndex(i, 0), createIndex(i, 1));
+		evictThumbnails();
 	}
 }
 
@@ -318,5 +405,6 @@ void DivePictureModel::pictureOffsetChanged(dive *d, const QString filenameIn, o
 		return;
 	beginMoveRows(QModelIndex(), oldIndex, oldIndex, QModelIndex(), newIndex);
 	moveInVector(pictures, oldIndex, oldIndex + 1, newIndex);
+	pictureIndexValid = false;
 	endMoveRows();
 }
@@ -7,14 +7,21 @@
 
 #include <QAbstractTableModel>
 #include <QImage>
+#include <unordered_map>
 
 // We use std::string instead of QString to use the same character-encoding
 // as in the C core (UTF-8). This is crucial to guarantee the same sort-order.
+// The thumbnail is only loaded once the view asks for it and may be evicted
+// later, therefore it is mutable.
 struct dive;
+struct mem_usage;
 struct PictureEntry {
 	dive *d;
 	std::string filename;
-	QImage image;
+	mutable QImage image;
+	mutable bool thumbnailRequested;
+	mutable qint64 imageBytes;	// 0 for the placeholder image
+	mutable uint64_t lastUse;
 	int offsetSeconds;
 	duration_t length;
 	PictureEntry(dive *, const PictureObj &);
@@ -31,6 +38,8 @@ public:
 	int rowCount(const QModelIndex &parent = QModelIndex()) const override;
 	void updateDivePictures();
 	void removePictures(const QModelIndexList &);
+	// Thumbnails beyond that memory are dropped, starting with the least recently shown
+	void setMemoryBudget(qint64 bytes);
 public slots:
 	void setZoomLevel(int level);
 	void updateThumbnail(QString filename, QImage thumbnail, duration_t duration);
@@ -41,10 +50,21 @@ private:
 	DivePictureModel();
 	std::vector<PictureEntry> pictures;
 	int findPictureId(const std::string &filename);	// Return -1 if not found
+	// Index of the first entry of each filename, rebuilt lazily after
+	// rows were inserted, removed or moved. Used for the thumbnails,
+	// which arrive one by one.
+	std::unordered_map<std::string, int> pictureIndex;
+	bool pictureIndexValid;
 	double zoomLevel;	// -1.0: minimum, 0.0: standard, 1.0: maximum
 	int size;
+	qint64 memoryBudget;
+	mutable uint64_t useCounter;
+	qint64 imageMemory;
+	void requestThumbnail(const PictureEntry &entry) const;
+	void evictThumbnails();
 	void updateThumbnails();
 	void updateZoom();
+	static void reportMemoryUsage(struct mem_usage *usage, void *data);
 };
 
 #endif
@@ -14,9 +14,11 @@
 #endif // !SUBSURFACE_TESTING
 #include "core/gettextfromc.h"
 #include "core/deco.h"
+#include "core/arena.h"
 #include <QApplication>
 #include <QTextDocument>
 #include <QtConcurrent>
+#include <numeric>
 
 #define VARIATIONS_IN_BACKGROUND 1
 
@@ -455,6 +457,7 @@ DivePlannerPointsModel::DivePlannerPointsModel(QObject *parent) : QAbstractTable
 	recalc(false)
 {
 	memset(&diveplan, 0, sizeof(diveplan));
+	diveplan.checkpoints = alloc_waypoint_checkpoints();
 	startTime.setTimeSpec(Qt::UTC);
 	// use a Qt-connection to send the variations text across thread boundary (in case we
 	// are calculating the variations in a background thread).
@@ -1012,10 +1015,12 @@ void DivePlannerPointsModel::createTemporaryPlan()
 #ifdef VARIATIONS_IN_BACKGROUND
 		// Since we're calling computeVariations asynchronously and plan_deco_state is allocated
 		// on the stack, it must be copied and freed by the worker-thread.
+		// The instance is taken here, so that variations of older drags that are still
+		// queued in the thread pool don't get calculated anymore.
 		struct deco_state *plan_deco_state_copy = new deco_state(plan_deco_state);
-		QtConcurrent::run(this, &DivePlannerPointsModel::computeVariationsFreeDeco, plan_copy, plan_deco_state_copy);
+		QtConcurrent::run(this, &DivePlannerPointsModel::computeVariationsFreeDeco, plan_copy, plan_deco_state_copy, ++instanceCounter);
 #else
-		computeVariations(plan_copy, &plan_deco_state);
+		computeVariations(plan_copy, &plan_deco_state, ++instanceCounter);
 #endif
 		final_deco_state = plan_deco_state;
 		emit calculatedPlanNotes(QString(displayed_dive.notes));
@@ -1050,6 +1055,8 @@ struct divedatapoint * DivePlannerPointsModel::cloneDiveplan(struct diveplan *pl
 
 	src = plan_src->dp;
 	*plan_copy = *plan_src;
+	// The copies are planned in other threads, they must not share the checkpoints
+	plan_copy->checkpoints = NULL;
 	dp = &plan_copy->dp;
 	while (src && (!src->time || src->entered)) {
 		*dp = (struct divedatapoint *)malloc(sizeof(struct divedatapoint));
@@ -1098,13 +1105,23 @@ int DivePlannerPointsModel::analyzeVariations(struct decostop *min, struct decos
 	return (leftsum + rightsum) / 2;
 }
 
-void DivePlannerPointsModel::computeVariationsFreeDeco(struct diveplan *original_plan, struct deco_state *previous_ds)
+void DivePlannerPointsModel::computeVariationsFreeDeco(struct diveplan *original_plan, struct deco_state *previous_ds, int my_instance)
 {
-	computeVariations(original_plan, previous_ds);
+	computeVariations(original_plan, previous_ds, my_instance);
 	delete previous_ds;
 }
 
-void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, const struct deco_state *previous_ds)
+// The variations of the plan, see computeVariations()
+enum Variation {
+	ORIGINAL,
+	DEEPER,
+	SHALLOWER,
+	LONGER,
+	SHORTER,
+	NUM_VARIATIONS
+};
+
+void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, const struct deco_state *previous_ds, int my_instance)
 {
 	// nothing to do unless there's an original plan
 	if (!original_plan)
@@ -1112,16 +1129,10 @@ void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, c
 
 	struct dive *dive = alloc_dive();
 	copy_dive(&displayed_dive, dive);
-	struct decostop original[60], deeper[60], shallower[60], shorter[60], longer[60];
-	struct deco_state *cache = NULL, *save = NULL;
+	struct decostop stoptables[NUM_VARIATIONS][60];
 	struct diveplan plan_copy;
-	struct divedatapoint *last_segment;
-	struct deco_state ds = *previous_ds;
 
 	if (in_planner() && prefs.display_variations && decoMode() != RECREATIONAL) {
-		int my_instance = ++instanceCounter;
-		cache_deco_state(&ds, &save);
-
 		duration_t delta_time = { .seconds = 60 };
 		QString time_units = tr("min");
 		depth_t delta_depth;
@@ -1135,53 +1146,54 @@ void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, c
 			depth_units = tr("ft");
 		}
 
-		last_segment = cloneDiveplan(original_plan, &plan_copy);
-		if (!last_segment)
-			goto finish;
-		if (my_instance != instanceCounter)
-			goto finish;
-		plan(&ds, &plan_copy, dive, 1, original, &cache, true, false);
-		free_dps(&plan_copy);
-		restore_deco_state(save, &ds, false);
-
-		last_segment = cloneDiveplan(original_plan, &plan_copy);
-		last_segment->depth.mm += delta_depth.mm;
-		last_segment->next->depth.mm += delta_depth.mm;
-		if (my_instance != instanceCounter)
-			goto finish;
-		plan(&ds, &plan_copy, dive, 1, deeper, &cache, true, false);
+		bool has_last_segment = cloneDiveplan(original_plan, &plan_copy) != NULL;
 		free_dps(&plan_copy);
-		restore_deco_state(save, &ds, false);
-
-		last_segment = cloneDiveplan(original_plan, &plan_copy);
-		last_segment->depth.mm -= delta_depth.mm;
-		last_segment->next->depth.mm -= delta_depth.mm;
-		if (my_instance != instanceCounter)
+		if (!has_last_segment)
 			goto finish;
-		plan(&ds, &plan_copy, dive, 1, shallower, &cache, true, false);
-		free_dps(&plan_copy);
-		restore_deco_state(save, &ds, false);
 
-		last_segment = cloneDiveplan(original_plan, &plan_copy);
-		last_segment->next->time += delta_time.seconds;
-		if (my_instance != instanceCounter)
-			goto finish;
-		plan(&ds, &plan_copy, dive, 1, longer, &cache, true, false);
-		free_dps(&plan_copy);
-		restore_deco_state(save, &ds, false);
-
-		last_segment = cloneDiveplan(original_plan, &plan_copy);
-		last_segment->next->time -= delta_time.seconds;
+		// The plans are independent of each other, so calculate them in parallel. Every
+		// plan gets its own copy of the plan, the dive and the deco state. Plans that
+		// didn't start yet are skipped if the user changed the plan in the meantime.
+		QVector<int> variations(NUM_VARIATIONS);
+		std::iota(variations.begin(), variations.end(), 0);
+		QtConcurrent::blockingMap(variations, [&](int variation) {
+			if (my_instance != instanceCounter)
+				return;
+			struct diveplan variation_plan;
+			struct divedatapoint *last_segment = cloneDiveplan(original_plan, &variation_plan);
+			switch (variation) {
+			case DEEPER:
+				last_segment->depth.mm += delta_depth.mm;
+				last_segment->next->depth.mm += delta_depth.mm;
+				break;
+			case SHALLOWER:
+				last_segment->depth.mm -= delta_depth.mm;
+				last_segment->next->depth.mm -= delta_depth.mm;
+				break;
+			case LONGER:
+				last_segment->next->time += delta_time.seconds;
+				break;
+			case SHORTER:
+				last_segment->next->time -= delta_time.seconds;
+				break;
+			}
+			struct dive *variation_dive = alloc_dive();
+			copy_dive(dive, variation_dive);
+			variation_plan.skip_notes = true;
+			struct deco_state ds = *previous_ds;
+			struct deco_state *cache = NULL;
+			plan(&ds, &variation_plan, variation_dive, 1, stoptables[variation], &cache, true, false);
+			free(cache);
+			free_dive(variation_dive);
+			free_dps(&variation_plan);
+		});
 		if (my_instance != instanceCounter)
 			goto finish;
-		plan(&ds, &plan_copy, dive, 1, shorter, &cache, true, false);
-		free_dps(&plan_copy);
-		restore_deco_state(save, &ds, false);
 
 		char buf[200];
 		sprintf(buf, ", %s: + %d:%02d /%s + %d:%02d /min", qPrintable(tr("Stop times")),
-			FRACTION(analyzeVariations(shallower, original, deeper, qPrintable(depth_units)), 60), qPrintable(depth_units),
-			FRACTION(analyzeVariations(shorter, original, longer, qPrintable(time_units)), 60));
+			FRACTION(analyzeVariations(stoptables[SHALLOWER], stoptables[ORIGINAL], stoptables[DEEPER], qPrintable(depth_units)), 60), qPrintable(depth_units),
+			FRACTION(analyzeVariations(stoptables[SHORTER], stoptables[ORIGINAL], stoptables[LONGER], qPrintable(time_units)), 60));
 
 		// By using a signal, we can transport the variations to the main thread.
 		emit variationsComputed(QString(buf));
@@ -1192,16 +1204,14 @@ void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, c
 finish:
 	free_dps(original_plan);
 	free(original_plan);
-	free(save);
-	free(cache);
-	free(dive);
+	free_dive(dive);
 //	setRecalc(oldRecalc);
 }
 
 void DivePlannerPointsModel::computeVariationsDone(QString variations)
 {
 	QString notes = QString(displayed_dive.notes);
-	free(displayed_dive.notes);
+	arena_free(displayed_dive.notes);
 	displayed_dive.notes = copy_qstring(notes.replace("VARIATIONS", variations));
 	emit calculatedPlanNotes(QString(displayed_dive.notes));
 }
@@ -1223,7 +1233,7 @@ void DivePlannerPointsModel::createPlan(bool replanCopy)
 	lock_planner();
 	cloneDiveplan(&diveplan, plan_copy);
 	unlock_planner();
-	computeVariations(plan_copy, &ds_after_previous_dives);
+	computeVariations(plan_copy, &ds_after_previous_dives, ++instanceCounter);
 
 	free(cache);
 
@@ -4,6 +4,7 @@
 
 #include <QAbstractTableModel>
 #include <QDateTime>
+#include <atomic>
 
 #include "core/deco.h"
 #include "core/planner.h"
@@ -127,15 +128,15 @@ private:
 	struct diveplan diveplan;
 	struct divedatapoint *cloneDiveplan(struct diveplan *plan_src, struct diveplan *plan_copy);
 	void computeVariationsDone(QString text);
-	void computeVariations(struct diveplan *diveplan, const struct deco_state *ds);
-	void computeVariationsFreeDeco(struct diveplan *diveplan, struct deco_state *ds);
+	void computeVariations(struct diveplan *diveplan, const struct deco_state *ds, int my_instance);
+	void computeVariationsFreeDeco(struct diveplan *diveplan, struct deco_state *ds, int my_instance);
 	int analyzeVariations(struct decostop *min, struct decostop *mid, struct decostop *max, const char *unit);
 	CylindersModel cylinders;
 	Mode mode;
 	bool recalc;
 	QVector<divedatapoint> divepoints;
 	QDateTime startTime;
-	int instanceCounter = 0;
+	std::atomic<int> instanceCounter { 0 };
 	struct deco_state ds_after_previous_dives;
 	duration_t preserved_until;
 };
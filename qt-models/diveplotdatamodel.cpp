@@ -28,7 +28,7 @@ QVariant DivePlotDataModel::data(const QModelIndex &index, int role) const
 	if ((!index.isValid()) || (index.row() >= pInfo.nr) || pInfo.entry == 0)
 		return QVariant();
 
-	plot_data item = pInfo.entry[index.row()];
+	const plot_data &item = pInfo.entry[index.row()];
 	if (role == Qt::DisplayRole) {
 		switch (index.column()) {
 		case DEPTH:
@@ -79,11 +79,11 @@ QVariant DivePlotDataModel::data(const QModelIndex &index, int role) const
 	}
 
 	if (role == Qt::DisplayRole && index.column() >= TISSUE_1 && index.column() <= TISSUE_16) {
-		return item.ceilings[index.column() - TISSUE_1];
+		return pInfo.tissues ? pInfo.tissues[index.row()].ceilings[index.column() - TISSUE_1] : 0;
 	}
 
 	if (role == Qt::DisplayRole && index.column() >= PERCENTAGE_1 && index.column() <= PERCENTAGE_16) {
-		return item.percentages[index.column() - PERCENTAGE_1];
+		return pInfo.tissues ? pInfo.tissues[index.row()].percentages[index.column() - PERCENTAGE_1] : 0;
 	}
 
 	if (role == Qt::BackgroundRole) {
@@ -95,6 +95,78 @@ QVariant DivePlotDataModel::data(const QModelIndex &index, int role) const
 	return QVariant();
 }
 
+// The same values as data() with Qt::DisplayRole, but without going through
+// QModelIndex and QVariant. Meant for the profile items, which read whole columns.
+double DivePlotDataModel::value(int row, int column) const
+{
+	if (row < 0 || row >= pInfo.nr || !pInfo.entry)
+		return 0.0;
+
+	const plot_data &item = pInfo.entry[row];
+	switch (column) {
+	case DEPTH:
+		return item.depth;
+	case TIME:
+		return item.sec;
+	case PRESSURE:
+	case SENSOR_PRESSURE:
+		return get_plot_sensor_pressure(&pInfo, row, 0);
+	case TEMPERATURE:
+		return item.temperature;
+	case COLOR:
+		return item.velocity;
+	case INTERPOLATED_PRESSURE:
+		return get_plot_interpolated_pressure(&pInfo, row, 0);
+	case CEILING:
+		return item.ceiling;
+	case SAC:
+		return item.sac;
+	case PN2:
+		return item.pressures.n2;
+	case PHE:
+		return item.pressures.he;
+	case PO2:
+		return item.pressures.o2;
+	case O2SETPOINT:
+		return item.o2setpoint.mbar / 1000.0;
+	case CCRSENSOR1:
+		return item.o2sensor[0].mbar / 1000.0;
+	case CCRSENSOR2:
+		return item.o2sensor[1].mbar / 1000.0;
+	case CCRSENSOR3:
+		return item.o2sensor[2].mbar / 1000.0;
+	case SCR_OC_PO2:
+		return item.scr_OC_pO2.mbar / 1000.0;
+	case HEARTBEAT:
+		return item.heartbeat;
+	case AMBPRESSURE:
+		return AMB_PERCENTAGE;
+	case GFLINE:
+		return item.gfline;
+	case INSTANT_MEANDEPTH:
+		return item.running_sum;
+	}
+	if (column >= TISSUE_1 && column <= TISSUE_16)
+		return pInfo.tissues ? pInfo.tissues[row].ceilings[column - TISSUE_1] : 0;
+	if (column >= PERCENTAGE_1 && column <= PERCENTAGE_16)
+		return pInfo.tissues ? pInfo.tissues[row].percentages[column - PERCENTAGE_1] : 0;
+	return 0.0;
+}
+
+// The first row at the given time, or -1 if there is none. The rows are ordered by time.
+int DivePlotDataModel::rowAtTime(int sec) const
+{
+	int lo = 0, hi = pInfo.nr;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (pInfo.entry[mid].sec < sec)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo < pInfo.nr && pInfo.entry[lo].sec == sec ? lo : -1;
+}
+
 const plot_info &DivePlotDataModel::data() const
 {
 	return pInfo;
@@ -184,13 +256,7 @@ void DivePlotDataModel::setDive(dive *d, const plot_info &info)
 {
 	beginResetModel();
 	dcNr = dc_number;
-	free(pInfo.entry);
-	free(pInfo.pressures);
-	pInfo = info;
-	pInfo.entry = (plot_data *)malloc(sizeof(plot_data) * pInfo.nr);
-	memcpy(pInfo.entry, info.entry, sizeof(plot_data) * pInfo.nr);
-	pInfo.pressures = (plot_pressure_data *)malloc(sizeof(plot_pressure_data) * pInfo.nr_cylinders * pInfo.nr);
-	memcpy(pInfo.pressures, info.pressures, sizeof(plot_pressure_data) * pInfo.nr_cylinders * pInfo.nr);
+	copy_plot_info(&pInfo, &info);
 	endResetModel();
 }
 
@@ -224,7 +290,7 @@ void DivePlotDataModel::calculateDecompression()
 {
 	struct divecomputer *dc = select_dc(&displayed_dive);
 	init_decompression(&plot_deco_state, &displayed_dive);
-	calculate_deco_information(&plot_deco_state, &(DivePlannerPointsModel::instance()->final_deco_state), &displayed_dive, dc, &pInfo, false);
+	calculate_deco_information(&plot_deco_state, &(DivePlannerPointsModel::instance()->final_deco_state), &displayed_dive, dc, &pInfo, false, nullptr);
 	dataChanged(index(0, CEILING), index(pInfo.nr - 1, TISSUE_16));
 }
 #endif
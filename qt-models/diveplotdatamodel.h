@@ -81,6 +81,8 @@ public:
 	void clear();
 	void setDive(struct dive *d, const plot_info &pInfo);
 	const plot_info &data() const;
+	double value(int row, int column) const;
+	int rowAtTime(int sec) const;
 	unsigned int dcShown() const;
 	double pheMax();
 	double pn2Max();
@@ -2,11 +2,22 @@
 #include "core/qthelper.h"
 #include "core/taxonomy.h"
 
+#include <QSet>
+#include <QtConcurrent>
+
 DivesiteImportedModel::DivesiteImportedModel(QObject *o) : QAbstractTableModel(o),
 	firstIndex(0),
 	lastIndex(-1),
+	calculated(false),
 	importedSitesTable(nullptr)
 {
+	connect(&matchWatcher, &QFutureWatcher<std::vector<Match>>::finished, this, &DivesiteImportedModel::matchesFinished);
+}
+
+DivesiteImportedModel::~DivesiteImportedModel()
+{
+	// The worker reads the dive site table
+	matchWatcher.waitForFinished();
 }
 
 int DivesiteImportedModel::columnCount(const QModelIndex &) const
@@ -64,25 +75,16 @@ QVariant DivesiteImportedModel::data(const QModelIndex &index, int role) const
 		case COUNTRY:
 			return taxonomy_get_country(&ds->taxonomy);
 		case NEAREST: {
-			// 40075000 is circumference of the earth in meters
-			struct dive_site *nearest_ds =
-				get_dive_site_by_gps_proximity(&ds->location,
-				40075000, &dive_site_table);
+			struct dive_site *nearest_ds = calculated ? matches[index.row()].nearest : nullptr;
 			if (nearest_ds)
 				return nearest_ds->name;
 			else
 				return QString();
 		}
-		case DISTANCE: {
-			unsigned int distance = 0;
-			struct dive_site *nearest_ds =
-				get_dive_site_by_gps_proximity(&ds->location,
-				40075000, &dive_site_table);
-			if (nearest_ds)
-				distance = get_distance(&ds->location,
-					&nearest_ds->location);
-			return distance_string(distance);
-		}
+		case DISTANCE:
+			if (!calculated)
+				return QString();
+			return distance_string(matches[index.row()].distance);
 		case SELECTED:
 			return checkStates[index.row()];
 		}
@@ -132,11 +134,58 @@ void DivesiteImportedModel::repopulate(struct dive_site_table *sites)
 	importedSitesTable = sites;
 	firstIndex = 0;
 	lastIndex = importedSitesTable->nr - 1;
-	checkStates.resize(importedSitesTable->nr);
-	for (int row = 0; row < importedSitesTable->nr; row++)
-		if (get_dive_site_by_gps(&importedSitesTable->dive_sites[row]->location, &dive_site_table))
-			checkStates[row] = false;
-		else
-			checkStates[row] = true;
+	checkStates.assign(importedSitesTable->nr, true);
+	matches.clear();
+	calculated = false;
 	endResetModel();
+
+	std::vector<location_t> locations;
+	locations.reserve(importedSitesTable->nr);
+	for (int row = 0; row < importedSitesTable->nr; row++)
+		locations.push_back(importedSitesTable->dive_sites[row]->location);
+	matchWatcher.setFuture(QtConcurrent::run(findMatches, locations));
+}
+
+// Find the nearest existing sites up front, the view asks for them on every repaint.
+// Runs on a worker thread: the dialog is modal, so the dive site table can't change.
+std::vector<DivesiteImportedModel::Match> DivesiteImportedModel::findMatches(std::vector<location_t> locations)
+{
+	std::vector<Match> res;
+	res.reserve(locations.size());
+
+	struct dive_site_gps_index index;
+	build_dive_site_gps_index(&index, &dive_site_table);
+	QSet<QPair<int, int>> existing;
+	int i;
+	struct dive_site *ds;
+	for_each_dive_site (i, ds, &dive_site_table)
+		existing.insert(qMakePair(ds->location.lat.udeg, ds->location.lon.udeg));
+
+	for (const location_t &loc: locations) {
+		// 40075000 is circumference of the earth in meters
+		struct dive_site *nearest = get_dive_site_by_gps_proximity_indexed(&loc, 40075000, &index);
+		unsigned int distance = nearest ? get_distance(&loc, &nearest->location) : 0;
+		res.push_back({ nearest, distance, existing.contains(qMakePair(loc.lat.udeg, loc.lon.udeg)) });
+	}
+	free_dive_site_gps_index(&index);
+	return res;
+}
+
+void DivesiteImportedModel::matchesFinished()
+{
+	std::vector<Match> res = matchWatcher.result();
+	if (!importedSitesTable || res.size() != checkStates.size())
+		return;
+	matches = std::move(res);
+	for (size_t row = 0; row < matches.size(); ++row)
+		checkStates[row] = !matches[row].exists;
+	calculated = true;
+	if (!matches.empty())
+		dataChanged(index(0, 0), index((int)matches.size() - 1, DISTANCE));
+	emit matchesReady();
+}
+
+bool DivesiteImportedModel::matchesCalculated() const
+{
+	return calculated;
 }
@@ -2,6 +2,7 @@
 #define DIVESITEIMPORTEDMODEL_H
 
 #include <QAbstractTableModel>
+#include <QFutureWatcher>
 #include <vector>
 #include "core/divesite.h"
 
@@ -11,13 +12,26 @@ class DivesiteImportedModel : public QAbstractTableModel
 public:
 	enum columnNames { NAME, LOCATION, COUNTRY, NEAREST, DISTANCE, SELECTED };
 
+	// The nearest existing site of each imported site
+	struct Match {
+		dive_site *nearest;
+		unsigned int distance; // in m
+		bool exists; // an existing site has the same location
+	};
+
 	DivesiteImportedModel(QObject *parent = 0);
+	~DivesiteImportedModel();
 	int columnCount(const QModelIndex& index = QModelIndex()) const;
 	int rowCount(const QModelIndex& index = QModelIndex()) const;
 	QVariant data(const QModelIndex& index, int role) const;
 	QVariant headerData(int section, Qt::Orientation orientation, int role) const;
 	Qt::ItemFlags flags(const QModelIndex &index) const;
 	void repopulate(dive_site_table_t *sites);
+	bool matchesCalculated() const;
+signals:
+	// The nearest sites are searched on a worker thread. Until they are found,
+	// the default selection of the imported sites is not known.
+	void matchesReady();
 public
 slots:
 	void changeSelected(QModelIndex clickedIndex);
@@ -25,10 +39,17 @@ slots:
 	void selectAll();
 	void selectNone();
 
+private slots:
+	void matchesFinished();
+
 private:
 	int firstIndex;
 	int lastIndex;
 	std::vector<char> checkStates; // char instead of bool to avoid silly pessimization of std::vector.
+	std::vector<Match> matches;
+	QFutureWatcher<std::vector<Match>> matchWatcher;
+	bool calculated;
+	static std::vector<Match> findMatches(std::vector<location_t> locations);
 	struct dive_site_table *importedSitesTable;
 };
 
@@ -2,6 +2,7 @@
 #include "qt-models/divesummarymodel.h"
 #include "core/dive.h"
 #include "core/qthelper.h"
+#include "core/subsurface-qt/divelistnotifier.h"
 
 #include <QLocale>
 #include <QDateTime>
@@ -155,19 +156,88 @@ static void calculateDive(struct dive *dive, Stats &stats)
 	}
 }
 
-// Returns a (first_dive, last_dive) pair
-static Stats loopDives(timestamp_t start)
+// The periods of the summary: all dives, the last month, three months, six months and year
+static const int numPeriods = 5;
+
+static timestamp_t periodStart(const QDateTime &currentTime, int period)
+{
+	QDateTime startTime;
+
+	switch (period) {
+	case 0:
+	default:
+		return 0;
+	case 1: startTime = currentTime.addMonths(-1);
+		break;
+	case 2: startTime = currentTime.addMonths(-3);
+		break;
+	case 3: startTime = currentTime.addMonths(-6);
+		break;
+	case 4: startTime = currentTime.addYears(-1);
+		break;
+	}
+	return dateTimeToTimestamp(startTime) + gettimezoneoffset();
+}
+
+// Calculate the statistics of all periods in one pass over the dives. The dive table is
+// sorted by time and the periods are nested. Therefore, walk the dives from the newest
+// and take a snapshot of the sums whenever the start of the next longer period is passed.
+static void calculatePeriods(Stats stats[numPeriods], const QDateTime &currentTime)
+{
+	static const int byStart[numPeriods] = { 1, 2, 3, 4, 0 }; // Latest start first
+	timestamp_t start[numPeriods];
+	for (int period = 0; period < numPeriods; ++period)
+		start[period] = periodStart(currentTime, period);
+
+	Stats sums;
+	int next = 0;
+	for (int i = dive_table.nr - 1; i >= 0 && next < numPeriods; --i) {
+		struct dive *dive = dive_table.dives[i];
+		while (next < numPeriods && dive->when <= start[byStart[next]])
+			stats[byStart[next++]] = sums;
+		if (next < numPeriods)
+			calculateDive(dive, sums);
+	}
+	while (next < numPeriods)
+		stats[byStart[next++]] = sums;
+}
+
+// The summary page creates a new model every time it is shown. Therefore, the statistics
+// are kept in a global cache, which is recalculated when the dives changed or at midnight.
+static struct {
+	bool valid = false;
+	QDate date;
+	Stats stats[numPeriods];
+} periodCache;
+
+static void invalidatePeriodCache()
 {
-	Stats stats;
-	struct dive *dive;
-	int i;
-
-	for_each_dive (i, dive) {
-		// check if dive is newer than primaryStart (add to first column)
-		if (dive->when > start)
-			calculateDive(dive, stats);
+	periodCache.valid = false;
+}
+
+static const Stats &periodStats(int period)
+{
+	static bool connected = false;
+	if (!connected) {
+		QObject::connect(&diveListNotifier, &DiveListNotifier::dataReset, &invalidatePeriodCache);
+		QObject::connect(&diveListNotifier, &DiveListNotifier::divesAdded, &invalidatePeriodCache);
+		QObject::connect(&diveListNotifier, &DiveListNotifier::divesDeleted, &invalidatePeriodCache);
+		QObject::connect(&diveListNotifier, &DiveListNotifier::divesChanged, &invalidatePeriodCache);
+		QObject::connect(&diveListNotifier, &DiveListNotifier::divesTimeChanged, &invalidatePeriodCache);
+		QObject::connect(&diveListNotifier, &DiveListNotifier::cylindersReset, &invalidatePeriodCache);
+		QObject::connect(&diveListNotifier, &DiveListNotifier::cylinderAdded, &invalidatePeriodCache);
+		QObject::connect(&diveListNotifier, &DiveListNotifier::cylinderRemoved, &invalidatePeriodCache);
+		QObject::connect(&diveListNotifier, &DiveListNotifier::cylinderEdited, &invalidatePeriodCache);
+		connected = true;
+	}
+
+	QDateTime currentTime = QDateTime::currentDateTime();
+	if (!periodCache.valid || periodCache.date != currentTime.date()) {
+		calculatePeriods(periodCache.stats, currentTime);
+		periodCache.date = currentTime.date();
+		periodCache.valid = true;
 	}
-	return stats;
+	return periodCache.stats[period];
 }
 
 static QString timeString(int64_t duration)
@@ -242,31 +312,11 @@ void DiveSummaryModel::calc(int column, int period)
 	if (column >= (int)results.size())
 		return;
 
-	QDateTime currentTime = QDateTime::currentDateTime();
-	QDateTime startTime = currentTime;
-
-	// Calculate Start of the periods.
-	switch (period) {
-	case 0: // having startTime == currentTime is used as special case below
-		break;
-	case 1: startTime = currentTime.addMonths(-1);
-		break;
-	case 2: startTime = currentTime.addMonths(-3);
-		break;
-	case 3: startTime = currentTime.addMonths(-6);
-		break;
-	case 4: startTime = currentTime.addYears(-1);
-		break;
-	default: qWarning("DiveSummaryModel::calc called with invalid period");
+	if (period < 0 || period >= numPeriods) {
+		qWarning("DiveSummaryModel::calc called with invalid period");
+		period = 0;
 	}
-	timestamp_t start;
-	if (startTime == currentTime)
-		start = 0;
-	else
-		start = dateTimeToTimestamp(startTime) + gettimezoneoffset();
-
-	// Loop over all dives and sum up data
-	Stats stats = loopDives(start);
+	const Stats &stats = periodStats(period);
 	results[column] = formatResults(stats);
 
 	// For QML always reload column 0, because that works via roles not columns
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "qt-models/divetripmodel.h"
 #include "core/divefilter.h"
+#include "core/divesummarytable.h"
 #ifdef SUBSURFACE_MOBILE
 #include "qt-models/mobilelistmodel.h"
 #endif
@@ -20,16 +21,11 @@
 #include <QDateTime>
 #include <memory>
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 
 // 1) Base functions
 
-static int nitrox_sort_value(const struct dive *dive)
-{
-	int o2, he, o2max;
-	get_dive_gas(dive, &o2, &he, &o2max);
-	return he * 1000 + o2;
-}
-
 static QVariant dive_table_alignment(int column)
 {
 	switch (column) {
@@ -68,12 +64,11 @@ QString DiveTripModelBase::tripShortDate(const dive_trip *trip)
 	return QStringLiteral("%1\n'%2").arg(firstMonth,firstTime.toString("yy"));
 }
 
-QString DiveTripModelBase::tripTitle(const dive_trip *trip)
+QString DiveTripModelBase::tripTitle(const dive_trip *trip, int shown)
 {
 	if (!trip)
 		return QString();
 	QString numDives = tr("(%n dive(s))", "", trip->dives.nr);
-	int shown = trip_shown_dives(trip);
 	QString shownDives = shown != trip->dives.nr ? QStringLiteral(" ") + tr("(%L1 shown)").arg(shown) : QString();
 	QString title(trip->location);
 
@@ -95,7 +90,7 @@ QString DiveTripModelBase::tripTitle(const dive_trip *trip)
 	return QStringLiteral("%1 %2%3").arg(title, numDives, shownDives);
 }
 
-QVariant DiveTripModelBase::tripData(const dive_trip *trip, int column, int role)
+QVariant DiveTripModelBase::tripData(const dive_trip *trip, int shown, int column, int role)
 {
 #ifdef SUBSURFACE_MOBILE
 	// Special roles for mobile
@@ -103,7 +98,7 @@ QVariant DiveTripModelBase::tripData(const dive_trip *trip, int column, int role
 	case MobileListModel::TripIdRole: return QString::number(trip->id);
 	case MobileListModel::TripNrDivesRole: return trip->dives.nr;
 	case MobileListModel::TripShortDateRole: return tripShortDate(trip);
-	case MobileListModel::TripTitleRole: return tripTitle(trip);
+	case MobileListModel::TripTitleRole: return tripTitle(trip, shown);
 	case MobileListModel::TripLocationRole: return QString(trip->location);
 	case MobileListModel::TripNotesRole: return QString(trip->notes);
 	}
@@ -120,9 +115,8 @@ QVariant DiveTripModelBase::tripData(const dive_trip *trip, int column, int role
 		case DiveTripModelBase::NR:
 			QString shownText;
 			bool oneDayTrip = trip_is_single_day(trip);
-			int countShown = trip_shown_dives(trip);
-			if (countShown < trip->dives.nr)
-				shownText = tr("(%1 shown)").arg(countShown);
+			if (shown < trip->dives.nr)
+				shownText = tr("(%1 shown)").arg(shown);
 			if (!empty_string(trip->location))
 				return QString(trip->location) + ", " + get_trip_date_string(trip_date(trip), trip->dives.nr, oneDayTrip) + " "+ shownText;
 			else
@@ -191,6 +185,88 @@ static QString displayWeight(const struct dive *d, bool units)
 		return s + gettextFromC::tr("lbs");
 }
 
+QVariant DiveTripModelBase::displayData(const struct dive *d, int column)
+{
+	switch (column) {
+	case NR:
+		return d->number;
+	case DATE:
+		return get_dive_date_string(d->when);
+	case DEPTH:
+		return get_depth_string(d->maxdepth, prefs.units.show_units_table);
+	case DURATION:
+		return displayDuration(d);
+	case TEMPERATURE:
+		return displayTemperature(d, prefs.units.show_units_table);
+	case TOTALWEIGHT:
+		return displayWeight(d, prefs.units.show_units_table);
+	case SUIT:
+		return QString(d->suit);
+	case CYLINDER:
+		return d->cylinders.nr > 0 ? QString(get_cylinder(d, 0)->type.description) : QString();
+	case SAC:
+		return displaySac(d, prefs.units.show_units_table);
+	case OTU:
+		return d->otu;
+	case MAXCNS:
+		if (prefs.units.show_units_table)
+			return QString("%1%").arg(d->maxcns);
+		else
+			return d->maxcns;
+	case TAGS:
+		return get_taglist_string(d->tag_list);
+	case PHOTOS:
+		break;
+	case COUNTRY:
+		return QString(get_dive_country(d));
+	case BUDDIES:
+		return QString(d->buddy);
+	case LOCATION:
+		return QString(get_dive_location(d));
+	case GAS:
+		char *gas_string = get_dive_gas_string(d);
+		QString ret(gas_string);
+		free(gas_string);
+		return ret;
+	}
+	return QVariant();
+}
+
+// Formatting the cells of the dive list is costly and the views request the data
+// over and over while scrolling and sorting. Therefore, the display data is cached
+// per dive and column. The cache is cleared if the dives are changed (see the
+// constructor) or if the units or the date format changed.
+QVariant DiveTripModelBase::cachedDisplayData(const struct dive *d, int column) const
+{
+	if (column < 0 || column >= COLUMNS)
+		return QVariant();
+	if (memcmp(&displayCacheUnits, &prefs.units, sizeof(prefs.units)) ||
+	    !same_string(displayCacheDateFormat.c_str(), prefs.date_format) ||
+	    !same_string(displayCacheTimeFormat.c_str(), prefs.time_format)) {
+		displayCache.clear();
+		memcpy(&displayCacheUnits, &prefs.units, sizeof(prefs.units));
+		displayCacheDateFormat = prefs.date_format ?: "";
+		displayCacheTimeFormat = prefs.time_format ?: "";
+	}
+	DisplayCacheEntry &entry = displayCache[d];
+	if (!entry.valid[column]) {
+		entry.values[column] = displayData(d, column);
+		entry.valid[column] = true;
+	}
+	return entry.values[column];
+}
+
+void DiveTripModelBase::invalidateDisplayCache(const QVector<dive *> &dives)
+{
+	for (const dive *d: dives)
+		displayCache.erase(d);
+}
+
+void DiveTripModelBase::clearDisplayCache()
+{
+	displayCache.clear();
+}
+
 QVariant DiveTripModelBase::diveData(const struct dive *d, int column, int role) const
 {
 #ifdef SUBSURFACE_MOBILE
@@ -247,49 +323,7 @@ QVariant DiveTripModelBase::diveData(const struct dive *d, int column, int role)
 	case Qt::TextAlignmentRole:
 		return dive_table_alignment(column);
 	case Qt::DisplayRole:
-		switch (column) {
-		case NR:
-			return d->number;
-		case DATE:
-			return get_dive_date_string(d->when);
-		case DEPTH:
-			return get_depth_string(d->maxdepth, prefs.units.show_units_table);
-		case DURATION:
-			return displayDuration(d);
-		case TEMPERATURE:
-			return displayTemperature(d, prefs.units.show_units_table);
-		case TOTALWEIGHT:
-			return displayWeight(d, prefs.units.show_units_table);
-		case SUIT:
-			return QString(d->suit);
-		case CYLINDER:
-			return d->cylinders.nr > 0 ? QString(get_cylinder(d, 0)->type.description) : QString();
-		case SAC:
-			return displaySac(d, prefs.units.show_units_table);
-		case OTU:
-			return d->otu;
-		case MAXCNS:
-			if (prefs.units.show_units_table)
-				return QString("%1%").arg(d->maxcns);
-			else
-				return d->maxcns;
-		case TAGS:
-			return get_taglist_string(d->tag_list);
-		case PHOTOS:
-			break;
-		case COUNTRY:
-			return QString(get_dive_country(d));
-		case BUDDIES:
-			return QString(d->buddy);
-		case LOCATION:
-			return QString(get_dive_location(d));
-		case GAS:
-			char *gas_string = get_dive_gas_string(d);
-			QString ret(gas_string);
-			free(gas_string);
-			return ret;
-		}
-		break;
+		return cachedDisplayData(d, column);
 	case Qt::DecorationRole:
 		switch (column) {
 		//TODO: ADD A FLAG
@@ -495,6 +529,28 @@ DiveTripModelBase::DiveTripModelBase(QObject *parent) : QAbstractItemModel(paren
 	invalidForeground(Qt::gray)
 {
 	invalidFont.setStrikeOut(true);
+	memcpy(&displayCacheUnits, &prefs.units, sizeof(prefs.units));
+
+	// Invalidate the cached display data. These connections are made before the
+	// derived classes connect to the signals, so that the views get fresh data.
+	connect(&diveListNotifier, &DiveListNotifier::dataReset, this, &DiveTripModelBase::clearDisplayCache);
+	connect(&diveListNotifier, &DiveListNotifier::diveSiteChanged, this, &DiveTripModelBase::clearDisplayCache);
+	connect(&diveListNotifier, &DiveListNotifier::divesDeleted, this,
+		[this](dive_trip *, bool, const QVector<dive *> &dives) { invalidateDisplayCache(dives); });
+	connect(&diveListNotifier, &DiveListNotifier::divesChanged, this,
+		[this](const QVector<dive *> &dives, DiveField) { invalidateDisplayCache(dives); });
+	connect(&diveListNotifier, &DiveListNotifier::divesTimeChanged, this,
+		[this](timestamp_t, const QVector<dive *> &dives) { invalidateDisplayCache(dives); });
+	connect(&diveListNotifier, &DiveListNotifier::cylindersReset, this, &DiveTripModelBase::invalidateDisplayCache);
+	connect(&diveListNotifier, &DiveListNotifier::weightsystemsReset, this, &DiveTripModelBase::invalidateDisplayCache);
+	auto invalidateDive = [this](dive *d) { displayCache.erase(d); };
+	connect(&diveListNotifier, &DiveListNotifier::cylinderAdded, this, invalidateDive);
+	connect(&diveListNotifier, &DiveListNotifier::cylinderRemoved, this, invalidateDive);
+	connect(&diveListNotifier, &DiveListNotifier::cylinderEdited, this, invalidateDive);
+	connect(&diveListNotifier, &DiveListNotifier::weightAdded, this, invalidateDive);
+	connect(&diveListNotifier, &DiveListNotifier::weightRemoved, this, invalidateDive);
+	connect(&diveListNotifier, &DiveListNotifier::weightEdited, this, invalidateDive);
+	connect(&diveListNotifier, &DiveListNotifier::eventsChanged, this, invalidateDive);
 }
 
 int DiveTripModelBase::columnCount(const QModelIndex&) const
@@ -652,8 +708,8 @@ void processRangesZip(Vector1 &items1, Vector2 &items2, Predicate cond, Action a
 
 // Add items from vector "v2" to vector "v1" in batches of contiguous objects.
 // The items are inserted at places according to a sort order determined by "comp".
-// "v1" and "v2" are supposed to be ordered accordingly.
-// TODO: We might use binary search with std::lower_bound(), but not sure if it's worth it.
+// "v1" and "v2" are supposed to be ordered accordingly. The insertion indices are
+// found by binary search, so that adding few items to a large vector is fast.
 // Input parameters:
 //	- v1: destination vector
 //	- v2: source vector
@@ -665,8 +721,7 @@ void addInBatches(Vector1 &v1, const Vector2 &v2, Comparator comp, Inserter inse
 	int idx = 0; // Index where dives will be inserted
 	int i, j; // Begin and end of range to insert
 	for (i = 0; i < (int)v2.size(); i = j) {
-		for (; idx < (int)v1.size() && !comp(v2[i], v1[idx]); ++idx)
-			; // Pass
+		idx = std::upper_bound(v1.begin() + idx, v1.end(), v2[i], comp) - v1.begin();
 
 		// We found the index of the first item to add.
 		// Now search how many items we should insert there.
@@ -718,9 +773,9 @@ void DiveTripModelTree::populate()
 	// we want this to be two calls as the second text is overwritten below by the lines starting with "\r"
 	uiNotification(QObject::tr("populate data model"));
 	uiNotification(QObject::tr("start processing"));
+	update_all_cylinder_related_info();
 	for (int i = 0; i < dive_table.nr; ++i) {
 		dive *d = get_dive(i);
-		update_cylinder_related_info(d);
 		if (d->hidden_by_filter)
 			continue;
 		dive_trip_t *trip = d->divetrip;
@@ -772,6 +827,7 @@ int DiveTripModelTree::rowCount(const QModelIndex &parent) const
 void DiveTripModelList::clearData()
 {
 	items.clear();
+	invalidateSortKeys();
 }
 
 static const quintptr noParent = ~(quintptr)0; // This is the "internalId" marker for top-level item
@@ -948,7 +1004,8 @@ QVariant DiveTripModelTree::data(const QModelIndex &index, int role) const
 		return std::find(item.dives.begin(), item.dives.end(), current_dive) != item.dives.end();
 	}
 	if (entry.trip) {
-		return tripData(entry.trip, index.column(), role);
+		// The items of the tree only contain the shown dives
+		return tripData(entry.trip, (int)items[index.row()].dives.size(), index.column(), role);
 	} else if (entry.dive) {
 #if defined(SUBSURFACE_MOBILE)
 		if (role == MobileListModel::TripAbove)
@@ -1008,6 +1065,7 @@ void DiveTripModelTree::addDivesToTrip(int trip, const QVector<dive *> &dives)
 		     [&](std::vector<dive *> &items, const QVector<dive *> &dives, int idx, int from, int to) { // inserter
 			beginInsertRows(parent, idx, idx + to - from - 1);
 			items.insert(items.begin() + idx, dives.begin() + from, dives.begin() + to);
+			invalidateSortKeys();
 			endInsertRows();
 		     });
 
@@ -1015,25 +1073,40 @@ void DiveTripModelTree::addDivesToTrip(int trip, const QVector<dive *> &dives)
 	topLevelChanged(trip);
 }
 
-int DiveTripModelTree::findTripIdx(const dive_trip *trip) const
+// Find a top-level item by binary search. The items are sorted according to dive_or_trip_less_than().
+// However, the sort key of an item may have changed without the item having been moved yet
+// (e.g. the time of a dive was edited). Therefore, if the item is not found at its expected
+// position, fall back to a linear search.
+int DiveTripModelTree::findTopLevelIdx(dive_or_trip d_or_t) const
 {
+	auto it = std::lower_bound(items.begin(), items.end(), d_or_t,
+				   [](const Item &e, dive_or_trip d_or_t) { return dive_or_trip_less_than(e.d_or_t, d_or_t); });
+	if (it != items.end() && it->d_or_t.dive == d_or_t.dive && it->d_or_t.trip == d_or_t.trip)
+		return it - items.begin();
 	for (int i = 0; i < (int)items.size(); ++i)
-		if (items[i].d_or_t.trip == trip)
+		if (items[i].d_or_t.dive == d_or_t.dive && items[i].d_or_t.trip == d_or_t.trip)
 			return i;
 	return -1;
 }
 
+int DiveTripModelTree::findTripIdx(const dive_trip *trip) const
+{
+	return findTopLevelIdx({ nullptr, (dive_trip *)trip });
+}
+
 int DiveTripModelTree::findDiveIdx(const dive *d) const
 {
-	for (int i = 0; i < (int)items.size(); ++i)
-		if (items[i].isDive(d))
-			return i;
-	return -1;
+	return findTopLevelIdx({ (dive *)d, nullptr });
 }
 
 int DiveTripModelTree::findDiveInTrip(int tripIdx, const dive *d) const
 {
+	// Same as findTopLevelIdx(): binary search with a linear fallback.
 	const Item &item = items[tripIdx];
+	auto it = std::lower_bound(item.dives.begin(), item.dives.end(), d,
+				   [](const dive *d1, const dive *d2) { return dive_less_than(d1, d2); });
+	if (it != item.dives.end() && *it == d)
+		return it - item.dives.begin();
 	for (int i = 0; i < (int)item.dives.size(); ++i)
 		if (item.dives[i] == d)
 			return i;
@@ -1043,11 +1116,8 @@ int DiveTripModelTree::findDiveInTrip(int tripIdx, const dive *d) const
 int DiveTripModelTree::findInsertionIndex(const dive_trip *trip) const
 {
 	dive_or_trip d_or_t{ nullptr, (dive_trip *)trip };
-	for (int i = 0; i < (int)items.size(); ++i) {
-		if (dive_or_trip_less_than(d_or_t, items[i].d_or_t))
-			return i;
-	}
-	return items.size();
+	return std::upper_bound(items.begin(), items.end(), d_or_t,
+				[](dive_or_trip d_or_t, const Item &e) { return dive_or_trip_less_than(d_or_t, e.d_or_t); }) - items.begin();
 }
 
 // This function is used to compare a dive to an arbitrary entry (dive or trip).
@@ -1068,6 +1138,7 @@ void DiveTripModelTree::addDivesTopLevel(const QVector<dive *> &dives)
 		     [&](std::vector<Item> &items, const QVector<dive *> &dives, int idx, int from, int to) { // inserter
 			beginInsertRows(QModelIndex(), idx, idx + to - from - 1);
 			items.insert(items.begin() + idx, dives.begin() + from, dives.begin() + to);
+			invalidateSortKeys();
 			endInsertRows();
 		     });
 }
@@ -1079,6 +1150,7 @@ void DiveTripModelTree::removeDivesTopLevel(const QVector<dive *> &dives)
 			 [&](std::vector<Item> &items, const QVector<dive *> &, int from, int to, int) -> int { // Action
 				beginRemoveRows(QModelIndex(), from, to - 1);
 				items.erase(items.begin() + from, items.begin() + to);
+				invalidateSortKeys();
 				endRemoveRows();
 				return from - to; // Delta: negate the number of items deleted
 				 });
@@ -1333,30 +1405,54 @@ void DiveTripModelTree::divesMovedBetweenTrips(dive_trip *from, dive_trip *to, b
 	divesDeletedInternal(from, deleteFrom, dives); // Use internal version to keep current dive
 }
 
-void DiveTripModelTree::divesTimeChanged(timestamp_t delta, const QVector<dive *> &dives)
-{
-	processByTrip(dives, [this, delta] (dive_trip *trip, const QVector<dive *> &divesInTrip)
-		      { divesTimeChangedTrip(trip, delta, divesInTrip); });
-}
-
-void DiveTripModelTree::divesTimeChangedTrip(dive_trip *trip, timestamp_t delta, const QVector<dive *> &divesIn)
+// Changing the time of dives doesn't add or remove any items, it only changes their order.
+// Therefore, resort the affected trips and the top level in one layout change, instead of
+// removing and re-adding the dives trip by trip. The persistent indexes, i.e. the selection
+// and the current dive, are mapped to the new positions via the dive and trip pointers.
+void DiveTripModelTree::divesTimeChanged(timestamp_t, const QVector<dive *> &divesIn)
 {
 	QVector <dive *> dives = visibleDives(divesIn);
 	if (dives.empty())
 		return;
 
-	// As in the case of divesMovedBetweenTrips(), this is a tricky, but solvable, problem.
-	// We have to consider the direction (delta < 0 or delta >0) and that dives at their destination
-	// position have different contiguous batches than at their original position. For now,
-	// cheat and simply do a remove/add pair. Note that for this to work it is crucial the the
-	// order of the dives don't change. This is indeed the case, as all starting-times were
-	// moved by the same delta.
-
-	// Cheating!
-	// Unfortunately, removing the dives means that their selection is lost.
-	// Thus, remember the selection and re-add it later.
-	divesDeletedInternal(trip, false, dives); // Use internal version to keep current dive
-	divesAdded(trip, false, dives);
+	emit layoutAboutToBeChanged();
+	QModelIndexList oldIndexes = persistentIndexList();
+	std::vector<dive_or_trip> entries;
+	entries.reserve(oldIndexes.size());
+	for (const QModelIndex &idx: oldIndexes)
+		entries.push_back(tripOrDive(idx));
+
+	std::unordered_set<const dive_trip *> trips;
+	for (const dive *d: dives) {
+		if (d->divetrip)
+			trips.insert(d->divetrip);
+	}
+	for (Item &item: items) {
+		if (item.d_or_t.trip && trips.count(item.d_or_t.trip))
+			std::stable_sort(item.dives.begin(), item.dives.end(),
+					 [](const dive *d1, const dive *d2) { return dive_less_than(d1, d2); });
+	}
+	std::stable_sort(items.begin(), items.end(),
+			 [](const Item &i1, const Item &i2) { return dive_or_trip_less_than(i1.d_or_t, i2.d_or_t); });
+
+	QModelIndexList newIndexes;
+	newIndexes.reserve(oldIndexes.size());
+	for (size_t i = 0; i < entries.size(); ++i) {
+		int column = oldIndexes[i].column();
+		QModelIndex idx;
+		if (entries[i].trip) {
+			int tripIdx = findTripIdx(entries[i].trip);
+			if (tripIdx >= 0)
+				idx = createIndex(tripIdx, column, noParent);
+		} else if (entries[i].dive) {
+			QModelIndex diveIdx = diveToIdx(entries[i].dive);
+			if (diveIdx.isValid())
+				idx = createIndex(diveIdx.row(), column, diveIdx.internalId());
+		}
+		newIndexes.push_back(idx);
+	}
+	changePersistentIndexList(oldIndexes, newIndexes);
+	emit layoutChanged();
 }
 
 QModelIndex DiveTripModelTree::diveToIdx(const dive *d) const
@@ -1455,7 +1551,8 @@ bool DiveTripModelTree::lessThan(const QModelIndex &i1, const QModelIndex &i2) c
 
 // 3) ListModel functions
 
-DiveTripModelList::DiveTripModelList(QObject *parent) : DiveTripModelBase(parent)
+DiveTripModelList::DiveTripModelList(QObject *parent) : DiveTripModelBase(parent),
+	sortKeyColumn(-1)
 {
 	// Stay informed of changes to the divelist
 	connect(&diveListNotifier, &DiveListNotifier::divesAdded, this, &DiveTripModelList::divesAdded);
@@ -1490,6 +1587,7 @@ void DiveTripModelList::populate()
 			continue;
 		items.push_back(d);
 	}
+	invalidateSortKeys();
 
 	// Remember the index of the current dive
 	oldCurrent = current_dive;
@@ -1559,6 +1657,7 @@ void DiveTripModelList::addDives(QVector<dive *> &dives)
 		     [&](std::vector<dive *> &items, const QVector<dive *> &dives, int idx, int from, int to) { // inserter
 			beginInsertRows(QModelIndex(), idx, idx + to - from - 1);
 			items.insert(items.begin() + idx, dives.begin() + from, dives.begin() + to);
+			invalidateSortKeys();
 			endInsertRows();
 		     });
 }
@@ -1571,6 +1670,7 @@ void DiveTripModelList::removeDives(QVector<dive *> dives)
 			 [&](std::vector<dive *> &items, const QVector<dive *> &, int from, int to, int) -> int { // Action
 				beginRemoveRows(QModelIndex(), from, to - 1);
 				items.erase(items.begin() + from, items.begin() + to);
+				invalidateSortKeys();
 				endRemoveRows();
 				return from - to; // Delta: negate the number of items deleted
 				 });
@@ -1611,6 +1711,10 @@ void DiveTripModelList::divesChanged(const QVector<dive *> &divesIn)
 	removeDives(shownChange.newHidden);
 	addDives(shownChange.newShown);
 
+	// The changed dives may sort differently
+	if (!dives.empty())
+		invalidateSortKeys();
+
 	// Since we know that the dive list is sorted, we will only ever search for the first element
 	// in dives as this must be the first that we encounter. Once we find a range, increase the
 	// index accordingly.
@@ -1639,11 +1743,31 @@ void DiveTripModelList::divesTimeChanged(timestamp_t delta, const QVector<dive *
 	QVector<dive *> dives = visibleDives(divesIn);
 	if (dives.empty())
 		return;
-	std::sort(dives.begin(), dives.end(), dive_less_than);
 
 	// See comment for DiveTripModelTree::divesTimeChanged above.
-	divesDeletedInternal(dives); // Use internal version to keep current dive
-	divesAdded(nullptr, false, dives);
+	emit layoutAboutToBeChanged();
+	QModelIndexList oldIndexes = persistentIndexList();
+	std::vector<dive *> oldDives;
+	oldDives.reserve(oldIndexes.size());
+	for (const QModelIndex &idx: oldIndexes)
+		oldDives.push_back(idx.isValid() ? items[idx.row()] : nullptr);
+
+	std::stable_sort(items.begin(), items.end(),
+			 [](const dive *d1, const dive *d2) { return dive_less_than(d1, d2); });
+	invalidateSortKeys();
+	std::unordered_map<const dive *, int> rows;
+	rows.reserve(items.size());
+	for (int i = 0; i < (int)items.size(); ++i)
+		rows[items[i]] = i;
+
+	QModelIndexList newIndexes;
+	newIndexes.reserve(oldIndexes.size());
+	for (int i = 0; i < oldIndexes.size(); ++i) {
+		auto it = rows.find(oldDives[i]);
+		newIndexes.push_back(it != rows.end() ? createIndex(it->second, oldIndexes[i].column()) : QModelIndex());
+	}
+	changePersistentIndexList(oldIndexes, newIndexes);
+	emit layoutChanged();
 }
 
 QModelIndex DiveTripModelList::diveToIdx(const dive *d) const
@@ -1695,13 +1819,95 @@ static bool lessThanHelper(int diff1, int diff2)
 	return diff1 < 0 || (diff1 == 0 && diff2 < 0);
 }
 
-static int strCmp(const char *s1, const char *s2)
+void DiveTripModelList::invalidateSortKeys()
+{
+	sortKeyColumn = -1;
+	sortKeys.clear();
+}
+
+static std::unique_ptr<QCollatorSortKey> collationKey(const QCollator &collator, const char *s)
+{
+	if (!s)
+		return {};
+	return std::make_unique<QCollatorSortKey>(collator.sortKey(QString(s)));
+}
+
+void DiveTripModelList::updateSortKeys(int column) const
+{
+	QCollator collator;
+	sortKeys.clear();
+	sortKeys.reserve(items.size());
+	for (const dive *d: items) {
+		SortKey key { 0, {} };
+		switch (column) {
+		case RATING:
+			key.value = d->rating;
+			break;
+		case DEPTH:
+			key.value = d->maxdepth.mm;
+			break;
+		case DURATION:
+			key.value = d->duration.seconds;
+			break;
+		case TEMPERATURE:
+			key.value = d->watertemp.mkelvin;
+			break;
+		case TOTALWEIGHT:
+			key.value = DiveSummaryTable::instance().value(d, DiveSummaryTable::WEIGHT);
+			break;
+		case SUIT:
+			key.string = collationKey(collator, d->suit);
+			break;
+		case CYLINDER:
+			key.value = d->cylinders.nr;
+			if (d->cylinders.nr > 0)
+				key.string = collationKey(collator, get_cylinder(d, 0)->type.description);
+			break;
+		case GAS:
+			// The gas is determined from the cylinder usage, which is expensive. Take it from the summary table.
+			key.value = DiveSummaryTable::instance().value(d, DiveSummaryTable::GAS);
+			break;
+		case SAC:
+			key.value = d->sac;
+			break;
+		case OTU:
+			key.value = d->otu;
+			break;
+		case MAXCNS:
+			key.value = d->maxcns;
+			break;
+		case TAGS: {
+			char *s = taglist_get_tagstring(d->tag_list);
+			key.string = collationKey(collator, s);
+			free(s);
+			break;
+		}
+		case PHOTOS:
+			key.value = countPhotos(d);
+			break;
+		case COUNTRY:
+			key.string = collationKey(collator, get_dive_country(d));
+			break;
+		case BUDDIES:
+			key.string = collationKey(collator, d->buddy);
+			break;
+		case LOCATION:
+			key.string = collationKey(collator, get_dive_location(d));
+			break;
+		}
+		sortKeys.push_back(std::move(key));
+	}
+	sortKeyColumn = column;
+}
+
+// Missing strings sort before all others, including empty strings.
+static int strCmp(const std::unique_ptr<QCollatorSortKey> &s1, const std::unique_ptr<QCollatorSortKey> &s2)
 {
 	if (!s1)
 		return !s2 ? 0 : -1;
 	if (!s2)
 		return 1;
-	return QString::localeAwareCompare(QString(s1), QString(s2)); // TODO: avoid copy
+	return s1->compare(*s2);
 }
 
 bool DiveTripModelList::lessThan(const QModelIndex &i1, const QModelIndex &i2) const
@@ -1711,54 +1917,28 @@ bool DiveTripModelList::lessThan(const QModelIndex &i1, const QModelIndex &i2) c
 	int row2 = i2.row();
 	if (row1 < 0 || row1 >= (int)items.size() || row2 < 0 || row2 >= (int)items.size())
 		return false;
-	const dive *d1 = items[row1];
-	const dive *d2 = items[row2];
 	// This is used as a second sort criterion: For equal values, sorting is chronologically *descending*.
 	int row_diff = row2 - row1;
-	switch (i1.column()) {
-	case NR:
-	case DATE:
-	default:
+	int column = i1.column();
+	if (column == NR || column == DATE || column < 0 || column >= COLUMNS)
 		return row1 < row2;
-	case RATING:
-		return lessThanHelper(d1->rating - d2->rating, row_diff);
-	case DEPTH:
-		return lessThanHelper(d1->maxdepth.mm - d2->maxdepth.mm, row_diff);
-	case DURATION:
-		return lessThanHelper(d1->duration.seconds - d2->duration.seconds, row_diff);
-	case TEMPERATURE:
-		return lessThanHelper(d1->watertemp.mkelvin - d2->watertemp.mkelvin, row_diff);
-	case TOTALWEIGHT:
-		return lessThanHelper(total_weight(d1) - total_weight(d2), row_diff);
+
+	if (column != sortKeyColumn || sortKeys.size() != items.size())
+		updateSortKeys(column);
+	const SortKey &k1 = sortKeys[row1];
+	const SortKey &k2 = sortKeys[row2];
+	switch (column) {
 	case SUIT:
-		return lessThanHelper(strCmp(d1->suit, d2->suit), row_diff);
-	case CYLINDER:
-		if (d1->cylinders.nr > 0 && d2->cylinders.nr > 0)
-			return lessThanHelper(strCmp(get_cylinder(d1, 0)->type.description, get_cylinder(d2, 0)->type.description), row_diff);
-		return d1->cylinders.nr - d2->cylinders.nr < 0;
-	case GAS:
-		return lessThanHelper(nitrox_sort_value(d1) - nitrox_sort_value(d2), row_diff);
-	case SAC:
-		return lessThanHelper(d1->sac - d2->sac, row_diff);
-	case OTU:
-		return lessThanHelper(d1->otu - d2->otu, row_diff);
-	case MAXCNS:
-		return lessThanHelper(d1->maxcns - d2->maxcns, row_diff);
-	case TAGS: {
-		char *s1 = taglist_get_tagstring(d1->tag_list);
-		char *s2 = taglist_get_tagstring(d2->tag_list);
-		int diff = strCmp(s1, s2);
-		free(s1);
-		free(s2);
-		return lessThanHelper(diff, row_diff);
-	}
-	case PHOTOS:
-		return lessThanHelper(countPhotos(d1) - countPhotos(d2), row_diff);
+	case TAGS:
 	case COUNTRY:
-		return lessThanHelper(strCmp(get_dive_country(d1), get_dive_country(d2)), row_diff);
 	case BUDDIES:
-		return lessThanHelper(strCmp(d1->buddy, d2->buddy), row_diff);
 	case LOCATION:
-		return lessThanHelper(strCmp(get_dive_location(d1), get_dive_location(d2)), row_diff);
+		return lessThanHelper(strCmp(k1.string, k2.string), row_diff);
+	case CYLINDER:
+		if (k1.value > 0 && k2.value > 0)
+			return lessThanHelper(strCmp(k1.string, k2.string), row_diff);
+		return k1.value - k2.value < 0;
+	default:
+		return lessThanHelper(k1.value - k2.value, row_diff);
 	}
 }
@@ -6,7 +6,12 @@
 #include "core/subsurface-qt/divelistnotifier.h"
 #include <QAbstractItemModel>
 #include <QBrush>
+#include <QCollator>
 #include <QFont>
+#include <bitset>
+#include <memory>
+#include <string>
+#include <unordered_map>
 
 class DiveFilter;
 
@@ -89,10 +94,26 @@ protected:
 	QBrush invalidForeground;
 	QFont invalidFont;
 
+	// Cache of the display data of the dives, see cachedDisplayData()
+	struct DisplayCacheEntry {
+		QVariant values[COLUMNS];
+		std::bitset<COLUMNS> valid;
+	};
+	mutable std::unordered_map<const dive *, DisplayCacheEntry> displayCache;
+	mutable units displayCacheUnits;
+	mutable std::string displayCacheDateFormat, displayCacheTimeFormat;
+
 	// Access trip and dive data
 	QVariant diveData(const struct dive *d, int column, int role) const;	// Not static because we have to access invalidFont
-	static QVariant tripData(const dive_trip *trip, int column, int role);
-	static QString tripTitle(const dive_trip *trip);
+	static QVariant displayData(const struct dive *d, int column);		// Formatted Qt::DisplayRole data
+	QVariant cachedDisplayData(const struct dive *d, int column) const;
+	void invalidateDisplayCache(const QVector<dive *> &dives);
+	void clearDisplayCache();
+	// The number of shown dives is passed in, since the tree model keeps
+	// track of it anyway. Counting it here costs a loop over the dives
+	// of the trip for every repaint of the trip row.
+	static QVariant tripData(const dive_trip *trip, int shown, int column, int role);
+	static QString tripTitle(const dive_trip *trip, int shown);
 	static QString tripShortDate(const dive_trip *trip);
 	void currentChanged();
 
@@ -133,7 +154,6 @@ private:
 	void divesChangedTrip(dive_trip *trip, const QVector<dive *> &dives);
 	void divesShown(dive_trip *trip, const QVector<dive *> &dives);
 	void divesHidden(dive_trip *trip, const QVector<dive *> &dives);
-	void divesTimeChangedTrip(dive_trip *trip, timestamp_t delta, const QVector<dive *> &dives);
 	void divesDeletedInternal(dive_trip *trip, bool deleteTrip, const QVector<dive *> &dives);
 
 	// The tree model has two levels. At the top level, we have either trips or dives
@@ -169,6 +189,7 @@ private:
 	void topLevelChanged(int idx);
 
 	// Access trips and dives
+	int findTopLevelIdx(dive_or_trip d_or_t) const;	// Find top-level dive or trip
 	int findTripIdx(const dive_trip *trip) const;
 	int findDiveIdx(const dive *d) const;			// Find _top_level_ dive
 	QModelIndex diveToIdx(const dive *d) const;		// Find _any_ dive
@@ -209,8 +230,21 @@ private:
 	void removeDives(QVector<dive *> dives);
 	QModelIndex diveToIdx(const dive *d) const;
 	void divesDeletedInternal(const QVector<dive *> &dives);
+	void invalidateSortKeys();
+	void updateSortKeys(int column) const;
 
 	std::vector<dive *> items;				// TODO: access core data directly
+
+	// Sorting compares the same dives over and over. Therefore, the sort keys of all
+	// items are extracted once for the sort column when lessThan() first needs them:
+	// numbers as int, strings as collation keys. They are thrown away whenever the
+	// items or the dives change.
+	struct SortKey {
+		int value;
+		std::unique_ptr<QCollatorSortKey> string; // null for missing strings
+	};
+	mutable int sortKeyColumn;				// -1: no valid keys
+	mutable std::vector<SortKey> sortKeys;
 };
 
 #endif
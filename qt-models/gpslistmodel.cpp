@@ -11,7 +11,12 @@ GpsListModel::GpsListModel()
 
 void GpsListModel::update()
 {
-	QVector<gpsTracker> trackers = QVector<gpsTracker>::fromList(GpsLocation::instance()->currentGPSInfo().values());
+	const std::vector<gpsTracker> &fixes = GpsLocation::instance()->currentGPSInfo();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+	QVector<gpsTracker> trackers(fixes.begin(), fixes.end());
+#else
+	QVector<gpsTracker> trackers = QVector<gpsTracker>::fromStdVector(fixes);
+#endif
 	beginResetModel();
 	m_gpsFixes = trackers;
 	endResetModel();
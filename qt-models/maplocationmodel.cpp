@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "maplocationmodel.h"
 #include "divelocationmodel.h"
+#include "core/dive.h"
 #include "core/divesite.h"
 #include "core/divefilter.h"
 #ifndef SUBSURFACE_MOBILE
@@ -8,10 +9,19 @@
 #include "desktop-widgets/mapwidget.h"
 #endif
 
+#include <QSet>
+#include <algorithm>
+#include <cmath>
+
 #define MIN_DISTANCE_BETWEEN_DIVE_SITES_M 50.0
+// Above that zoom level, dive sites are not clustered
+#define MAX_CLUSTER_LEVEL 15
+// Dive sites are clustered in cells of 2^-(zoom level + CLUSTER_CELL_SHIFT) of the
+// width of the world. With tiles of 256 pixels, that's cells of 64 pixels.
+#define CLUSTER_CELL_SHIFT 2
 
-MapLocation::MapLocation(struct dive_site *dsIn, QGeoCoordinate coordIn, QString nameIn, bool selectedIn) :
-    divesite(dsIn), coordinate(coordIn), name(nameIn), selected(selectedIn)
+MapLocation::MapLocation(struct dive_site *dsIn, QGeoCoordinate coordIn, QString nameIn, bool selectedIn, int countIn) :
+    divesite(dsIn), coordinate(coordIn), name(nameIn), selected(selectedIn), count(countIn)
 {
 }
 
@@ -44,12 +54,16 @@ QVariant MapLocation::getRole(int role) const
 		return selected ? 1 : 0;
 	case RoleIsSelected:
 		return QVariant::fromValue(selected);
+	case RoleCount:
+		return QVariant::fromValue(count);
 	default:
 		return QVariant();
 	}
 }
 
-MapLocationModel::MapLocationModel(QObject *parent) : QAbstractListModel(parent)
+MapLocationModel::MapLocationModel(QObject *parent) : QAbstractListModel(parent),
+	m_clusterLevel(MAX_CLUSTER_LEVEL + 1),
+	m_editMode(false)
 {
 	connect(&diveListNotifier, &DiveListNotifier::diveSiteChanged, this, &MapLocationModel::diveSiteChanged);
 }
@@ -76,6 +90,7 @@ QHash<int, QByteArray> MapLocationModel::roleNames() const
 	roles[MapLocation::RolePixmap] = "pixmap";
 	roles[MapLocation::RoleZ] = "z";
 	roles[MapLocation::RoleIsSelected] = "isSelected";
+	roles[MapLocation::RoleCount] = "count";
 	return roles;
 }
 
@@ -96,36 +111,182 @@ const QVector<dive_site *> &MapLocationModel::selectedDs() const
 	return m_selectedDs;
 }
 
-static bool hasVisibleDive(const dive_site *ds)
+// The number of visible and selected dives of a dive site
+struct SiteDives {
+	int visible = 0;
+	int selected = 0;
+};
+
+void MapLocationModel::selectionChanged()
 {
-	return std::any_of(&ds->dives.dives[0], &ds->dives.dives[ds->dives.nr],
-			   [] (const dive *d) { return !d->hidden_by_filter; });
+	QSet<const dive_site *> selectedDs;
+	for (const dive_site *ds: m_selectedDs)
+		selectedDs.insert(ds);
+	for (MapLocation &m: m_locations)
+		m.selected = selectedDs.contains(m.divesite);
+	// Selected sites are never clustered, therefore the clusters have to be recalculated
+	updateLocations(clusteredLocations());
 }
 
-static bool hasSelectedDive(const dive_site *ds)
+void MapLocationModel::setZoomLevel(double zoomLevel)
 {
-	return std::any_of(&ds->dives.dives[0], &ds->dives.dives[ds->dives.nr],
-			   [] (const dive *d) { return d->selected; });
+	int level = std::max(0, std::min((int)floor(zoomLevel), MAX_CLUSTER_LEVEL + 1));
+	if (level == m_clusterLevel)
+		return;
+	m_clusterLevel = level;
+	updateLocations(clusteredLocations());
 }
 
-void MapLocationModel::selectionChanged()
+// Position in the Web Mercator projection, in units of the width of the world
+static QPointF mercator(const QGeoCoordinate &coord)
 {
-	if (m_mapLocations.isEmpty())
-		return;
-	for(MapLocation *m: m_mapLocations)
-		m->selected = m_selectedDs.contains(m->divesite);
-	emit dataChanged(createIndex(0, 0), createIndex(m_mapLocations.size() - 1, 0));
+	double lat = std::max(-85.0, std::min(coord.latitude(), 85.0)) * M_PI / 180.0;
+	return QPointF((coord.longitude() + 180.0) / 360.0,
+		       (1.0 - log(tan(lat) + 1.0 / cos(lat)) / M_PI) / 2.0);
 }
 
-void MapLocationModel::reload(QObject *map)
+// Combine the locations that fall into the same cell of a grid, whose size depends on the zoom level.
+// Since the cells of a zoom level are split into four cells at the next zoom level, the clusters
+// form a hierarchy: zooming in splits a cluster, but never moves a site into a different cluster.
+// Selected dive sites are not clustered, nor are the sites in edit mode, because they may be dragged.
+std::vector<MapLocation> MapLocationModel::clusteredLocations() const
 {
-	beginResetModel();
+	if (m_clusterLevel > MAX_CLUSTER_LEVEL || inEditMode())
+		return m_locations;
 
-	qDeleteAll(m_mapLocations);
-	m_mapLocations.clear();
+	struct Cluster {
+		int first;	// Index of the first location in the cluster
+		int count;
+		double latitude, longitude;
+	};
+	double cellsPerWorld = (double)(1 << (m_clusterLevel + CLUSTER_CELL_SHIFT));
+	QHash<quint64, int> cellClusters;
+	std::vector<Cluster> clusters;
+	std::vector<int> locationClusters(m_locations.size(), -1);
+	for (int i = 0; i < (int)m_locations.size(); ++i) {
+		const MapLocation &location = m_locations[i];
+		if (location.selected)
+			continue;
+		QPointF pos = mercator(location.coordinate);
+		quint64 x = (quint64)std::max(0.0, pos.x() * cellsPerWorld);
+		quint64 y = (quint64)std::max(0.0, pos.y() * cellsPerWorld);
+		quint64 cell = (x << 32) | y;
+		auto it = cellClusters.find(cell);
+		if (it == cellClusters.end()) {
+			it = cellClusters.insert(cell, (int)clusters.size());
+			clusters.push_back({ i, 0, 0.0, 0.0 });
+		}
+		Cluster &cluster = clusters[*it];
+		++cluster.count;
+		cluster.latitude += location.coordinate.latitude();
+		cluster.longitude += location.coordinate.longitude();
+		locationClusters[i] = *it;
+	}
+
+	// Keep the order of the dive site table: a cluster is placed at its first dive site
+	std::vector<MapLocation> res;
+	for (int i = 0; i < (int)m_locations.size(); ++i) {
+		int idx = locationClusters[i];
+		if (idx < 0 || clusters[idx].count == 1) {
+			res.push_back(m_locations[i]);
+			continue;
+		}
+		const Cluster &cluster = clusters[idx];
+		if (cluster.first != i)
+			continue;
+		QGeoCoordinate center(cluster.latitude / cluster.count, cluster.longitude / cluster.count);
+		res.push_back(MapLocation(m_locations[i].divesite, center, QString(), false, cluster.count));
+	}
+	return res;
+}
+
+// Bring the model to the new list of locations. The locations are in the order of
+// the dive site table, therefore we can compute the difference in a single pass and
+// only the markers of the changed dive sites are recreated by the map.
+void MapLocationModel::updateLocations(const std::vector<MapLocation> &locations)
+{
+	bool editModeChanged = inEditMode() != m_editMode;
+	m_editMode = inEditMode();
+
+	QHash<const dive_site *, int> newRows;
+	for (int i = 0; i < (int)locations.size(); ++i)
+		newRows.insert(locations[i].divesite, i);
+
+	// Remove the dive sites that are not shown anymore, back to front to keep the indices valid
+	for (int row = m_mapLocations.size() - 1; row >= 0; --row) {
+		if (newRows.contains(m_mapLocations[row]->divesite))
+			continue;
+		int first = row;
+		while (first > 0 && !newRows.contains(m_mapLocations[first - 1]->divesite))
+			--first;
+		beginRemoveRows(QModelIndex(), first, row);
+		for (int i = first; i <= row; ++i)
+			delete m_mapLocations[i];
+		m_mapLocations.remove(first, row - first + 1);
+		endRemoveRows();
+		row = first;
+	}
+
+	// If the dive site table was reordered, don't bother with moving rows
+	for (int row = 1; row < m_mapLocations.size(); ++row) {
+		if (newRows[m_mapLocations[row]->divesite] < newRows[m_mapLocations[row - 1]->divesite]) {
+			beginResetModel();
+			qDeleteAll(m_mapLocations);
+			m_mapLocations.clear();
+			for (const MapLocation &location: locations)
+				m_mapLocations.append(new MapLocation(location));
+			endResetModel();
+			return;
+		}
+	}
+
+	// Update the remaining dive sites and insert the new ones in between
+	int row = 0;
+	for (int i = 0; i < (int)locations.size();) {
+		const MapLocation &location = locations[i];
+		if (row < m_mapLocations.size() && m_mapLocations[row]->divesite == location.divesite) {
+			MapLocation *old = m_mapLocations[row];
+			if (editModeChanged || old->coordinate != location.coordinate || old->name != location.name ||
+			    old->selected != location.selected || old->count != location.count) {
+				*old = location;
+				emit dataChanged(createIndex(row, 0), createIndex(row, 0));
+			}
+			++row;
+			++i;
+			continue;
+		}
+		int end = i + 1;
+		while (end < (int)locations.size() &&
+		       (row >= m_mapLocations.size() || locations[end].divesite != m_mapLocations[row]->divesite))
+			++end;
+		beginInsertRows(QModelIndex(), row, row + end - i - 1);
+		m_mapLocations.insert(row, end - i, nullptr);
+		for (; i < end; ++i)
+			m_mapLocations[row++] = new MapLocation(locations[i]);
+		endInsertRows();
+	}
+}
+
+void MapLocationModel::reload(QObject *map)
+{
 	m_selectedDs.clear();
 
-	QMap<QString, MapLocation *> locationNameMap;
+	std::vector<MapLocation> locations;
+	QMap<QString, int> locationNameMap;	// Index into locations
+
+	// Count the visible and selected dives of all dive sites in one pass over the dives
+	QHash<const dive_site *, SiteDives> siteDives;
+	int idx;
+	struct dive *d;
+	for_each_dive (idx, d) {
+		if (!d->dive_site)
+			continue;
+		SiteDives &counts = siteDives[d->dive_site];
+		if (!d->hidden_by_filter)
+			++counts.visible;
+		if (d->selected)
+			++counts.selected;
+	}
 
 #ifdef SUBSURFACE_MOBILE
 	bool diveSiteMode = false;
@@ -138,18 +299,23 @@ void MapLocationModel::reload(QObject *map)
 	if (diveSiteMode)
 		m_selectedDs = DiveFilter::instance()->filteredDiveSites();
 #endif
+	QSet<const dive_site *> selectedDs;
+	for (const dive_site *ds: m_selectedDs)
+		selectedDs.insert(ds);
+
 	for (int i = 0; i < dive_site_table.nr; ++i) {
 		struct dive_site *ds = dive_site_table.dive_sites[i];
 		QGeoCoordinate dsCoord;
+		SiteDives counts = siteDives.value(ds);
 
 		// Don't show dive sites of hidden dives, unless we're in dive site edit mode.
-		if (!diveSiteMode && !hasVisibleDive(ds))
+		if (!diveSiteMode && counts.visible == 0)
 			continue;
 		if (!dive_site_has_gps_location(ds)) {
 			// Dive sites that do not have a gps location are not shown in normal mode.
 			// In dive-edit mode, selected sites are placed at the center of the map,
 			// so that the user can drag them somewhere without having to enter coordinates.
-			if (!diveSiteMode || !m_selectedDs.contains(ds) || !map)
+			if (!diveSiteMode || !selectedDs.contains(ds) || !map)
 				continue;
 			dsCoord = map->property("center").value<QGeoCoordinate>();
 		} else {
@@ -157,27 +323,28 @@ void MapLocationModel::reload(QObject *map)
 			qreal longitude = ds->location.lon.udeg * 0.000001;
 			dsCoord = QGeoCoordinate(latitude, longitude);
 		}
-		if (!diveSiteMode && hasSelectedDive(ds) && !m_selectedDs.contains(ds))
+		if (!diveSiteMode && counts.selected > 0) {
 			m_selectedDs.append(ds);
+			selectedDs.insert(ds);
+		}
 		QString name(ds->name);
 		if (!diveSiteMode) {
 			// don't add dive locations with the same name, unless they are
 			// at least MIN_DISTANCE_BETWEEN_DIVE_SITES_M apart
 			if (locationNameMap.contains(name)) {
-				MapLocation *existingLocation = locationNameMap[name];
-				QGeoCoordinate coord = existingLocation->coordinate;
+				QGeoCoordinate coord = locations[locationNameMap[name]].coordinate;
 				if (dsCoord.distanceTo(coord) < MIN_DISTANCE_BETWEEN_DIVE_SITES_M)
 					continue;
 			}
 		}
-		bool selected = m_selectedDs.contains(ds);
-		MapLocation *location = new MapLocation(ds, dsCoord, name, selected);
-		m_mapLocations.append(location);
+		bool selected = selectedDs.contains(ds);
 		if (!diveSiteMode)
-			locationNameMap[name] = location;
+			locationNameMap[name] = (int)locations.size();
+		locations.push_back(MapLocation(ds, dsCoord, name, selected));
 	}
 
-	endResetModel();
+	m_locations = std::move(locations);
+	updateLocations(clusteredLocations());
 }
 
 void MapLocationModel::setSelected(struct dive_site *ds)
@@ -205,12 +372,9 @@ MapLocation *MapLocationModel::getMapLocation(const struct dive_site *ds)
 void MapLocationModel::diveSiteChanged(struct dive_site *ds, int field)
 {
 	// Find dive site
-	int row;
-	for (row = 0; row < m_mapLocations.size(); ++row) {
-		if (m_mapLocations[row]->divesite == ds)
-			break;
-	}
-	if (row == m_mapLocations.size())
+	auto it = std::find_if(m_locations.begin(), m_locations.end(),
+			       [ds](const MapLocation &location) { return location.divesite == ds; });
+	if (it == m_locations.end())
 		return;
 
 	switch (field) {
@@ -219,15 +383,16 @@ void MapLocationModel::diveSiteChanged(struct dive_site *ds, int field)
 			const qreal latitude_r = ds->location.lat.udeg * 0.000001;
 			const qreal longitude_r = ds->location.lon.udeg * 0.000001;
 			QGeoCoordinate coord(latitude_r, longitude_r);
-			m_mapLocations[row]->coordinate = coord;
+			it->coordinate = coord;
 		}
 		break;
 	case LocationInformationModel::NAME:
-		m_mapLocations[row]->name = ds->name;
+		it->name = ds->name;
 		break;
 	default:
-		break;
+		return;
 	}
 
-	emit dataChanged(createIndex(row, 0), createIndex(row, 0));
+	// The site may have moved into or out of a cluster
+	updateLocations(clusteredLocations());
 }
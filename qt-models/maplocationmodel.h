@@ -9,11 +9,12 @@
 #include <QByteArray>
 #include <QAbstractListModel>
 #include <QGeoCoordinate>
+#include <vector>
 
 class MapLocation
 {
 public:
-	explicit MapLocation(struct dive_site *ds, QGeoCoordinate coord, QString name, bool selected);
+	explicit MapLocation(struct dive_site *ds, QGeoCoordinate coord, QString name, bool selected, int count = 1);
 
 	QVariant getRole(int role) const;
 
@@ -23,13 +24,17 @@ public:
 		RoleName,
 		RolePixmap,
 		RoleZ,
-		RoleIsSelected
+		RoleIsSelected,
+		RoleCount
 	};
 
+	// A location with a count greater than one is a cluster of nearby dive sites,
+	// which is shown at their center. Then, divesite is the first of the sites.
 	struct dive_site *divesite;
 	QGeoCoordinate coordinate;
 	QString name;
 	bool selected;
+	int count;
 };
 
 class MapLocationModel : public QAbstractListModel
@@ -50,6 +55,8 @@ public:
 	MapLocation *getMapLocation(const struct dive_site *ds);
 	const QVector<dive_site *> &selectedDs() const;
 	void setSelected(struct dive_site *ds);
+	// Nearby dive sites are shown as clusters, depending on the zoom level of the map
+	void setZoomLevel(double zoomLevel);
 
 protected:
 	QHash<int, QByteArray> roleNames() const override;
@@ -58,8 +65,13 @@ private slots:
 	void diveSiteChanged(struct dive_site *ds, int field);
 
 private:
+	void updateLocations(const std::vector<MapLocation> &locations);
+	std::vector<MapLocation> clusteredLocations() const;
+	std::vector<MapLocation> m_locations;	// All locations, without clustering
+	int m_clusterLevel;
 	QVector<MapLocation *> m_mapLocations;
 	QVector<dive_site *> m_selectedDs;
+	bool m_editMode;	// The edit mode of the last reload, which determines the pixmaps
 };
 
 #endif
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "messagehandlermodel.h"
 #include "core/qthelper.h"
+#include <algorithm>
 
 #if defined(Q_OS_ANDROID) || defined(Q_OS_IOS)
 extern void writeToAppLogFile(QString logText);
@@ -17,52 +18,113 @@ MessageHandlerModel * MessageHandlerModel::self()
 	return self;
 }
 
-MessageHandlerModel::MessageHandlerModel(QObject*)
+MessageHandlerModel::MessageHandlerModel(QObject*) :
+	m_first(0),
+	m_total(0),
+	m_viewFirst(0),
+	m_viewCount(0)
 {
 	// no more than one message handler.
 	qInstallMessageHandler(logMessageHandler);
+
+	// While the log is shown, add the new messages a few times per second
+	m_updateTimer.setInterval(250);
+	connect(&m_updateTimer, &QTimer::timeout, this, &MessageHandlerModel::updateRows);
 }
 
 int MessageHandlerModel::rowCount(const QModelIndex&) const
 {
-	return m_data.size();
+	return m_viewCount;
 }
 
 #include <iostream>
 
 void MessageHandlerModel::addLog(QtMsgType type, const QString& message)
 {
-	if (!m_data.isEmpty()) {
-		struct MessageData *lm = &m_data.last();
-		QString lastMessage = lm->message.mid(lm->message.indexOf(':'));
-		QString newMessage = message.mid(message.indexOf(':'));
-		if (lastMessage == newMessage)
-			return;
+	{
+		QMutexLocker lock(&m_mutex);
+		if (!m_data.isEmpty()) {
+			const MessageData &lm = m_data[(m_first + m_data.size() - 1) % messageCapacity];
+			QString lastMessage = lm.message.mid(lm.message.indexOf(':'));
+			QString newMessage = message.mid(message.indexOf(':'));
+			if (lastMessage == newMessage)
+				return;
+		}
+		if (m_data.size() < messageCapacity) {
+			m_data.append({message, type});
+		} else {
+			m_data[m_first] = {message, type};
+			m_first = (m_first + 1) % messageCapacity;
+		}
+		++m_total;
 	}
-	beginInsertRows(QModelIndex(), rowCount(), rowCount());
-	m_data.append({message, type});
-	endInsertRows();
 	SSRF_INFO("%s", qPrintable(message));
 #if defined(Q_OS_ANDROID) || defined(Q_OS_IOS)
 	writeToAppLogFile(message);
 #endif
 }
 
+// Inform the views of the messages that were dropped from and added to the ring buffer
+void MessageHandlerModel::updateRows()
+{
+	qint64 oldest, total;
+	{
+		QMutexLocker lock(&m_mutex);
+		oldest = m_total - m_data.size();
+		total = m_total;
+	}
+
+	int dropped = (int)std::min(oldest - m_viewFirst, (qint64)m_viewCount);
+	if (dropped > 0) {
+		beginRemoveRows(QModelIndex(), 0, dropped - 1);
+		m_viewFirst += dropped;
+		m_viewCount -= dropped;
+		endRemoveRows();
+	}
+	if (m_viewCount == 0)
+		m_viewFirst = std::max(m_viewFirst, oldest);
+
+	int added = (int)(total - m_viewFirst - m_viewCount);
+	if (added > 0) {
+		beginInsertRows(QModelIndex(), m_viewCount, m_viewCount + added - 1);
+		m_viewCount += added;
+		endInsertRows();
+	}
+}
+
+void MessageHandlerModel::setActive(bool active)
+{
+	if (active) {
+		updateRows();
+		m_updateTimer.start();
+	} else {
+		m_updateTimer.stop();
+	}
+}
+
 const QString MessageHandlerModel::logAsString()
 {
+	QMutexLocker lock(&m_mutex);
 	QString copyString;
 
 	// Loop through m_data and build big string to be put on the clipboard
-	for(const MessageData &data: m_data)
-		copyString += data.message + "\n";
+	for (int i = 0; i < m_data.size(); ++i)
+		copyString += m_data[(m_first + i) % messageCapacity].message + "\n";
 	return copyString;
 }
 QVariant MessageHandlerModel::data(const QModelIndex& idx, int role) const
 {
 	switch(role) {
 		case Message:
-		case Qt::DisplayRole:
-			return m_data.at(idx.row()).message;
+		case Qt::DisplayRole: {
+			// Messages that were dropped since the last update are shown empty
+			QMutexLocker lock(&m_mutex);
+			qint64 seq = m_viewFirst + idx.row();
+			qint64 oldest = m_total - m_data.size();
+			if (seq < oldest || seq >= m_total)
+				return QString();
+			return m_data[(m_first + (int)(seq - oldest)) % messageCapacity].message;
+		}
 	}
 	return QVariant(QString("Role: %1").arg(role));
 };
@@ -77,8 +139,13 @@ QHash<int, QByteArray> MessageHandlerModel::roleNames() const {
 
 void MessageHandlerModel::reset()
 {
-	beginRemoveRows(QModelIndex(), 0, m_data.size()-1);
-	m_data.clear();
-	endRemoveRows();
-
+	beginResetModel();
+	{
+		QMutexLocker lock(&m_mutex);
+		m_data.clear();
+		m_first = 0;
+		m_viewFirst = m_total;
+		m_viewCount = 0;
+	}
+	endResetModel();
 }
@@ -3,8 +3,13 @@
 #define MESSAGEHANDLERMODEL_H
 
 #include <QAbstractListModel>
+#include <QMutex>
+#include <QTimer>
+#include <QVector>
 
-
+// Keeps the last messageCapacity log messages in a ring buffer. Messages may
+// be logged from any thread. The views are only informed of new messages while
+// the model is active, in batches.
 class MessageHandlerModel : public QAbstractListModel {
 	Q_OBJECT
 public:
@@ -19,13 +24,31 @@ public:
 	/* call this to clear the debug data */
 	Q_INVOKABLE void reset();
 
+	/* call this when the log is shown or hidden */
+	Q_INVOKABLE void setActive(bool active);
+
+private slots:
+	void updateRows();
+
 private:
 	MessageHandlerModel(QObject *parent = 0);
 	struct MessageData {
 		QString message;
 		QtMsgType type;
 	};
+	static const int messageCapacity = 5000;
+
+	// The messages are identified by a running sequence number.
+	// The ring buffer holds the messages [total - data.size(), total).
+	mutable QMutex m_mutex;
 	QVector<MessageData> m_data;
+	int m_first;			// index of the oldest message in m_data
+	qint64 m_total;			// number of messages added so far
+
+	// The messages the views know of: [m_viewFirst, m_viewFirst + m_viewCount)
+	qint64 m_viewFirst;
+	int m_viewCount;
+	QTimer m_updateTimer;
 };
 
 #endif
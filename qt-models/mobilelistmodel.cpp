@@ -92,6 +92,8 @@ MobileListModel::MobileListModel(DiveTripModelBase *source) : MobileListModelBas
 	connect(source, &DiveTripModelBase::rowsAboutToBeMoved, this, &MobileListModel::prepareMove);
 	connect(source, &DiveTripModelBase::rowsMoved, this, &MobileListModel::doneMove);
 	connect(source, &DiveTripModelBase::dataChanged, this, &MobileListModel::changed);
+	connect(source, &DiveTripModelBase::layoutAboutToBeChanged, this, &MobileListModel::prepareLayoutChange);
+	connect(source, &DiveTripModelBase::layoutChanged, this, &MobileListModel::doneLayoutChange);
 	connect(&diveListNotifier, &DiveListNotifier::numShownChanged, this, &MobileListModel::shownChanged);
 }
 
@@ -547,6 +549,22 @@ void MobileListModel::toggle(int row)
 		expand(row);
 }
 
+// The source model resorts its items in one go when the time of dives changes.
+// Since our rows depend on the expanded trip, simply reset the model, but remember
+// which trip was expanded by means of a persistent index into the source model.
+void MobileListModel::prepareLayoutChange()
+{
+	beginResetModel();
+	expandedSourceIdx = expandedRow >= 0 ? QPersistentModelIndex(sourceIndex(expandedRow, 0)) : QPersistentModelIndex();
+}
+
+void MobileListModel::doneLayoutChange()
+{
+	expandedRow = expandedSourceIdx.isValid() ? invertRow(QModelIndex(), expandedSourceIdx.row()) : -1;
+	expandedSourceIdx = QPersistentModelIndex();
+	endResetModel();
+}
+
 MobileSwipeModel::MobileSwipeModel(DiveTripModelBase *source) : MobileListModelBase(source)
 {
 	connect(source, &DiveTripModelBase::modelAboutToBeReset, this, &MobileSwipeModel::beginResetModel);
@@ -558,6 +576,8 @@ MobileSwipeModel::MobileSwipeModel(DiveTripModelBase *source) : MobileListModelB
 	connect(source, &DiveTripModelBase::rowsAboutToBeMoved, this, &MobileSwipeModel::prepareMove);
 	connect(source, &DiveTripModelBase::rowsMoved, this, &MobileSwipeModel::doneMove);
 	connect(source, &DiveTripModelBase::dataChanged, this, &MobileSwipeModel::changed);
+	connect(source, &DiveTripModelBase::layoutAboutToBeChanged, this, &MobileSwipeModel::beginResetModel);
+	connect(source, &DiveTripModelBase::layoutChanged, this, &MobileSwipeModel::doneReset);
 
 	initData();
 }
@@ -573,18 +593,96 @@ int MobileSwipeModel::topLevelRowCountInSource(int sourceRow) const
 		source->rowCount(index) : 1;
 }
 
+int MobileSwipeModel::ElementCounts::size() const
+{
+	return (int)counts.size();
+}
+
+bool MobileSwipeModel::ElementCounts::empty() const
+{
+	return counts.empty();
+}
+
+int MobileSwipeModel::ElementCounts::count(int idx) const
+{
+	return counts[idx];
+}
+
+int MobileSwipeModel::ElementCounts::first(int idx) const
+{
+	int res = 0;
+	for (int i = idx; i > 0; i -= i & -i)
+		res += tree[i];
+	return res;
+}
+
+int MobileSwipeModel::ElementCounts::find(int row) const
+{
+	// Descend the implicit tree: find the largest index whose prefix sum is <= row.
+	int n = size();
+	int step = 1;
+	while (step * 2 <= n)
+		step *= 2;
+	int pos = 0;
+	for (; step > 0; step /= 2) {
+		if (pos + step <= n && tree[pos + step] <= row) {
+			pos += step;
+			row -= tree[pos];
+		}
+	}
+	return pos;
+}
+
+void MobileSwipeModel::ElementCounts::add(int idx, int delta)
+{
+	counts[idx] += delta;
+	for (int i = idx + 1; i <= size(); i += i & -i)
+		tree[i] += delta;
+}
+
+void MobileSwipeModel::ElementCounts::assign(std::vector<int> countsIn)
+{
+	counts = std::move(countsIn);
+	rebuild();
+}
+
+void MobileSwipeModel::ElementCounts::insert(int idx, const std::vector<int> &countsIn)
+{
+	counts.insert(counts.begin() + idx, countsIn.begin(), countsIn.end());
+	rebuild();
+}
+
+void MobileSwipeModel::ElementCounts::erase(int begin, int end)
+{
+	counts.erase(counts.begin() + begin, counts.begin() + end);
+	rebuild();
+}
+
+// Build the tree in linear time by adding each node to its parent
+void MobileSwipeModel::ElementCounts::rebuild()
+{
+	int n = size();
+	tree.resize(n + 1);
+	tree[0] = 0;
+	std::copy(counts.begin(), counts.end(), tree.begin() + 1);
+	for (int i = 1; i <= n; ++i) {
+		int parent = i + (i & -i);
+		if (parent <= n)
+			tree[parent] += tree[i];
+	}
+}
+
 void MobileSwipeModel::initData()
 {
-	rows = 0;
-	int act = 0;
 	int topLevelRows = source->rowCount();
-	firstElement.resize(topLevelRows);
+	std::vector<int> counts(topLevelRows);
+	rows = 0;
 	for (int i = 0; i < topLevelRows; ++i) {
-		firstElement[i] = act;
 		// Note: we populate the model in reverse order, because we show the newest dives first.
-		act += topLevelRowCountInSource(topLevelRows - i - 1);
+		counts[i] = topLevelRowCountInSource(topLevelRows - i - 1);
+		rows += counts[i];
 	}
-	rows = act;
+	elements.assign(std::move(counts));
 	invalidateSourceRowCache();
 }
 
@@ -603,20 +701,17 @@ void MobileSwipeModel::invalidateSourceRowCache() const
 
 void MobileSwipeModel::updateSourceRowCache(int localRow) const
 {
-	if (firstElement.empty())
+	if (elements.empty() || localRow < 0)
+		return invalidateSourceRowCache(); // Huh? localRow was negative? Then index->isValid() should have returned true.
+
+	// Search the top-level item that contains the given row
+	int topLevelRow = elements.find(localRow);
+	if (topLevelRow >= elements.size())
 		return invalidateSourceRowCache();
 
 	cachedRow = localRow;
-
-	// Do a binary search for the first top-level item that starts after the given row
-	auto idx = std::upper_bound(firstElement.begin(), firstElement.end(), localRow);
-	if (idx == firstElement.begin())
-		return invalidateSourceRowCache(); // Huh? localRow was negative? Then index->isValid() should have returned true.
-
-	--idx;
-	int topLevelRow = idx - firstElement.begin();
-	int topLevelRowSource = firstElement.end() - idx - 1; // Reverse direction.
-	int indexInRow = localRow - *idx;
+	int topLevelRowSource = elements.size() - topLevelRow - 1; // Reverse direction.
+	int indexInRow = localRow - elements.first(topLevelRow);
 	if (indexInRow == 0) {
 		// This might be a top-level dive or a one-dive trip. Perhaps we should save which one it is.
 		if (!source->data(source->index(topLevelRowSource, 0), DiveTripModelBase::IS_TRIP_ROLE).value<bool>()) {
@@ -642,22 +737,19 @@ QModelIndex MobileSwipeModel::mapToSource(const QModelIndex &index) const
 
 int MobileSwipeModel::mapTopLevelFromSource(int row) const
 {
-	return firstElement.size() - row - 1;
+	return elements.size() - row - 1;
 }
 
 int MobileSwipeModel::mapTopLevelFromSourceForInsert(int row) const
 {
-	return firstElement.size() - row;
+	return elements.size() - row;
 }
 
 int MobileSwipeModel::elementCountInTopLevel(int row) const
 {
-	if (row < 0 || row >= (int)firstElement.size())
+	if (row < 0 || row >= elements.size())
 		return 0;
-	if (row + 1 < (int)firstElement.size())
-		return firstElement[row + 1] - firstElement[row];
-	else
-		return rows - firstElement[row];
+	return elements.count(row);
 }
 
 int MobileSwipeModel::mapRowFromSource(const QModelIndex &parent, int row) const
@@ -665,10 +757,10 @@ int MobileSwipeModel::mapRowFromSource(const QModelIndex &parent, int row) const
 	if (parent.isValid()) {
 		int topLevelRow = mapTopLevelFromSource(parent.row());
 		int count = elementCountInTopLevel(topLevelRow);
-		return firstElement[topLevelRow] + count - row - 1; // Note: we invert the direction!
+		return elements.first(topLevelRow) + count - row - 1; // Note: we invert the direction!
 	} else {
 		int topLevelRow = mapTopLevelFromSource(row);
-		return firstElement[topLevelRow];
+		return elements.first(topLevelRow);
 	}
 }
 
@@ -682,12 +774,12 @@ int MobileSwipeModel::mapRowFromSourceForInsert(const QModelIndex &parent, int r
 	if (parent.isValid()) {
 		int topLevelRow = mapTopLevelFromSource(parent.row());
 		int count = elementCountInTopLevel(topLevelRow);
-		return firstElement[topLevelRow] + count - row; // Note: we invert the direction!
+		return elements.first(topLevelRow) + count - row; // Note: we invert the direction!
 	} else {
 		if (row == 0)
 			return rows;	// Insert at the end
 		int topLevelRow = mapTopLevelFromSource(row - 1);
-		return firstElement[topLevelRow]; // Note: we invert the direction!
+		return elements.first(topLevelRow); // Note: we invert the direction!
 	}
 }
 
@@ -711,49 +803,29 @@ MobileSwipeModel::IndexRange MobileSwipeModel::mapRangeFromSource(const QModelIn
 // Remove top-level items. Parameters with standard range semantics (pointer to first and past last element).
 int MobileSwipeModel::removeTopLevel(int begin, int end)
 {
-	auto it1 = firstElement.begin() + begin;
-	auto it2 = firstElement.begin() + end;
-	int count = 0; // Number of items we have to subtract from rest
+	int count = 0; // Number of removed elements
 	for (int row = begin; row < end; ++row)
 		count += elementCountInTopLevel(row);
-	firstElement.erase(it1, it2); // Remove items
-	for (auto act = firstElement.begin() + begin; act != firstElement.end(); ++act)
-		*act -= count; // Subtract removed items
+	elements.erase(begin, end);
 	rows -= count;
 	return count;
 }
 
-// Add or remove subitems from top-level items
+// Add or remove subitems from top-level items.
+// Rows past the end refer to the last item.
 void MobileSwipeModel::updateTopLevel(int row, int delta)
 {
-	for (int i = row + 1; i < (int)firstElement.size(); ++i)
-		firstElement[i] += delta;
+	if (!elements.empty())
+		elements.add(std::min(std::max(row, 0), elements.size() - 1), delta);
 	rows += delta;
 }
 
 // Add items at top-level. The number of subelements of each items is given in the second parameter.
 void MobileSwipeModel::addTopLevel(int row, std::vector<int> items)
 {
-	// We get an array with the number of items per inserted row.
-	// Transform that to the first element in each row.
-	int nextEl = row < (int)firstElement.size() ? firstElement[row] : rows;
-	int count = 0;
-	for (int &item: items) {
-		int num = item;
-		item = nextEl;
-		nextEl += num;
-		count += num;
-	}
-
-	// Now, increase the first element of the items after the inserted range
-	// by the number of inserted items.
-	auto it = firstElement.begin() + row;
-	for (auto act = it; act != firstElement.end(); ++act)
-		*act += count;
-	rows += count;
-
-	// Insert the range
-	firstElement.insert(it, items.begin(), items.end());
+	for (int num: items)
+		rows += num;
+	elements.insert(row, items);
 }
 
 void MobileSwipeModel::prepareRemove(const QModelIndex &parent, int first, int last)
@@ -845,10 +917,8 @@ void MobileSwipeModel::doneMove(const QModelIndex &parent, int first, int last,
 			int count = endLocal - beginLocal;
 			std::vector<int> items;
 			items.reserve(count);
-			for (int row = beginLocal; row < endLocal; ++row) {
-				items.push_back(row < (int)firstElement.size() - 1 ? firstElement[row + 1] - firstElement[row]
-									      : rows - firstElement[row]);
-			}
+			for (int row = beginLocal; row < endLocal; ++row)
+				items.push_back(elementCountInTopLevel(row));
 			removeTopLevel(mapTopLevelFromSource(last), mapTopLevelFromSource(first) + 1);
 
 			if (destLocal >= beginLocal)
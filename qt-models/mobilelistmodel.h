@@ -107,6 +107,7 @@ private:
 	int shown() const;
 
 	int expandedRow;
+	QPersistentModelIndex expandedSourceIdx;		// Keeps track of the expanded trip during layout changes
 private slots:
 	void prepareRemove(const QModelIndex &parent, int first, int last);
 	void doneRemove(const QModelIndex &parent, int first, int last);
@@ -115,6 +116,8 @@ private slots:
 	void prepareMove(const QModelIndex &parent, int first, int last, const QModelIndex &dest, int destRow);
 	void doneMove(const QModelIndex &parent, int first, int last, const QModelIndex &dest, int destRow);
 	void changed(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles);
+	void prepareLayoutChange();
+	void doneLayoutChange();
 };
 
 class MobileSwipeModel : public MobileListModelBase {
@@ -129,7 +132,28 @@ private:
 		int first, last;
 	};
 	std::vector<IndexRange> rangeStack;
-	std::vector<int> firstElement; // First element of top level item.
+
+	// The number of elements of the top level items, stored as a Fenwick tree of prefix
+	// sums. Thus, the first element of a top level item and the top level item of an
+	// element are found in O(log n). Changing the number of elements of a top level item
+	// is O(log n), whereas inserting and removing top level items rebuilds the tree.
+	class ElementCounts {
+	public:
+		int size() const;
+		bool empty() const;
+		int count(int idx) const;
+		int first(int idx) const;	// Sum of the counts of the items before idx
+		int find(int row) const;	// Index of the item containing row. size() if past end.
+		void add(int idx, int delta);
+		void assign(std::vector<int> counts);
+		void insert(int idx, const std::vector<int> &counts);
+		void erase(int begin, int end);
+	private:
+		std::vector<int> counts;
+		std::vector<int> tree;		// One-based: tree[i] is the sum of the counts in (i - lowbit(i), i]
+		void rebuild();
+	};
+	ElementCounts elements;
 	int rows;
 	QVariant data(const QModelIndex &index, int role) const override;
 	int rowCount(const QModelIndex &parent) const override;
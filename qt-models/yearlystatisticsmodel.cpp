@@ -3,8 +3,11 @@
 #include "core/qthelper.h"
 #include "core/metrics.h"
 #include "core/statistics.h"
+#include "core/statisticsstore.h"
 #include "core/dive.h" // For NUM_DIVEMODE
 
+#include <vector>
+
 class YearStatisticsItem : public TreeItem {
 	Q_DECLARE_TR_FUNCTIONS(YearStatisticsItem)
 public:
@@ -28,31 +31,92 @@ public:
 		COLUMNS
 	};
 
+	// The depth and temperature buckets are labelled by their range
+	enum Range {
+		NO_RANGE,
+		DEPTH_RANGE,
+		TEMP_RANGE
+	};
+
+	// The data of a child that was not yet created
+	struct Entry {
+		stats_t stats;
+		Range range;
+		int bucket;
+	};
+
 	QVariant data(int column, int role) const;
-	YearStatisticsItem(const stats_t &interval);
+	YearStatisticsItem(const stats_t &interval, Range range = NO_RANGE, int bucket = 0);
+	YearStatisticsItem(const Entry &entry);
+
+	// Children are only created once the item is expanded
+	std::vector<Entry> pendingChildren;
 
 private:
+	QVariant formatData(int column) const;
+	QString rangeLabel() const;
+
 	stats_t stats_interval;
+	Range range;
+	int bucket;
+
+	// The strings are formatted on first access
+	mutable bool formatted;
+	mutable QVariant displayData[COLUMNS];
 };
 
-YearStatisticsItem::YearStatisticsItem(const stats_t &interval) : stats_interval(interval)
+YearStatisticsItem::YearStatisticsItem(const stats_t &interval, Range rangeIn, int bucketIn) :
+	stats_interval(interval),
+	range(rangeIn),
+	bucket(bucketIn),
+	formatted(false)
 {
 }
 
-QVariant YearStatisticsItem::data(int column, int role) const
+YearStatisticsItem::YearStatisticsItem(const Entry &entry) : YearStatisticsItem(entry.stats, entry.range, entry.bucket)
 {
-	QVariant ret;
+}
 
+QVariant YearStatisticsItem::data(int column, int role) const
+{
 	if (role == Qt::FontRole) {
 		QFont font = defaultModelFont();
 		font.setBold(stats_interval.is_year);
 		return font;
-	} else if (role != Qt::DisplayRole) {
-		return ret;
+	} else if (role != Qt::DisplayRole || column < 0 || column >= COLUMNS) {
+		return QVariant();
+	}
+	if (!formatted) {
+		for (int i = 0; i < COLUMNS; ++i)
+			displayData[i] = formatData(i);
+		formatted = true;
+	}
+	return displayData[column];
+}
+
+QString YearStatisticsItem::rangeLabel() const
+{
+	if (range == DEPTH_RANGE) {
+		return QString(tr("%1 - %2")).arg(get_depth_string((bucket - 1) * (STATS_DEPTH_BUCKET * 1000), true, false),
+			get_depth_string(bucket * (STATS_DEPTH_BUCKET * 1000), true, false));
+	} else {
+		temperature_t t_range_min, t_range_max;
+		t_range_min.mkelvin = C_to_mkelvin((bucket - 1) * STATS_TEMP_BUCKET);
+		t_range_max.mkelvin = C_to_mkelvin(bucket * STATS_TEMP_BUCKET);
+		return QString(tr("%1 - %2")).arg(get_temperature_string(t_range_min, true),
+			get_temperature_string(t_range_max, true));
 	}
+}
+
+QVariant YearStatisticsItem::formatData(int column) const
+{
+	QVariant ret;
+
 	switch (column) {
 	case YEAR:
-		if (stats_interval.is_trip) {
+		if (range != NO_RANGE) {
+			ret = rangeLabel();
+		} else if (stats_interval.is_trip) {
 			ret = stats_interval.location;
 		} else {
 			ret = stats_interval.period;
@@ -181,85 +245,98 @@ QVariant YearlyStatisticsModel::headerData(int section, Qt::Orientation orientat
 	return val;
 }
 
+// Add an item to the root item, its children are populated by fetchMore()
+static YearStatisticsItem *addTopLevelItem(TreeItem *root, const stats_t &stats)
+{
+	YearStatisticsItem *item = new YearStatisticsItem(stats);
+	root->children.append(item);
+	item->parent = root;
+	return item;
+}
+
 void YearlyStatisticsModel::update_yearly_stats()
 {
 	int i, month = 0;
 	unsigned int j, combined_months;
 	stats_summary_auto_free stats;
-	QString label;
-	temperature_t t_range_min,t_range_max;
-	calculate_stats_summary(&stats, false);
+	StatisticsStore::instance().summary(&stats);
 
 	for (i = 0; stats.stats_yearly != NULL && stats.stats_yearly[i].period; ++i) {
-		YearStatisticsItem *item = new YearStatisticsItem(stats.stats_yearly[i]);
+		YearStatisticsItem *item = addTopLevelItem(rootItem.get(), stats.stats_yearly[i]);
 		combined_months = 0;
 		for (j = 0; combined_months < stats.stats_yearly[i].selection_size; ++j) {
 			combined_months += stats.stats_monthly[month].selection_size;
-			YearStatisticsItem *iChild = new YearStatisticsItem(stats.stats_monthly[month]);
-			item->children.append(iChild);
-			iChild->parent = item;
+			item->pendingChildren.push_back({ stats.stats_monthly[month], YearStatisticsItem::NO_RANGE, 0 });
 			month++;
 		}
-		rootItem->children.append(item);
-		item->parent = rootItem.get();
 	}
 
 	if (stats.stats_by_trip != NULL && stats.stats_by_trip[0].is_trip == true) {
-		YearStatisticsItem *item = new YearStatisticsItem(stats.stats_by_trip[0]);
-		for (i = 1; stats.stats_by_trip != NULL && stats.stats_by_trip[i].is_trip; ++i) {
-			YearStatisticsItem *iChild = new YearStatisticsItem(stats.stats_by_trip[i]);
-			item->children.append(iChild);
-			iChild->parent = item;
-		}
-		rootItem->children.append(item);
-		item->parent = rootItem.get();
+		YearStatisticsItem *item = addTopLevelItem(rootItem.get(), stats.stats_by_trip[0]);
+		for (i = 1; stats.stats_by_trip != NULL && stats.stats_by_trip[i].is_trip; ++i)
+			item->pendingChildren.push_back({ stats.stats_by_trip[i], YearStatisticsItem::NO_RANGE, 0 });
 	}
 
 	/* Show the statistic sorted by dive type */
 	if (stats.stats_by_type != NULL && stats.stats_by_type[0].selection_size) {
-		YearStatisticsItem *item = new YearStatisticsItem(stats.stats_by_type[0]);
+		YearStatisticsItem *item = addTopLevelItem(rootItem.get(), stats.stats_by_type[0]);
 		for (i = 1; i <= NUM_DIVEMODE; ++i) {
 			if (stats.stats_by_type[i].selection_size == 0)
 				continue;
-			YearStatisticsItem *iChild = new YearStatisticsItem(stats.stats_by_type[i]);
-			item->children.append(iChild);
-			iChild->parent = item;
+			item->pendingChildren.push_back({ stats.stats_by_type[i], YearStatisticsItem::NO_RANGE, 0 });
 		}
-		rootItem->children.append(item);
-		item->parent = rootItem.get();
 	}
 
 	/* Show the statistic sorted by dive depth */
 	if (stats.stats_by_depth != NULL && stats.stats_by_depth[0].selection_size) {
-		YearStatisticsItem *item = new YearStatisticsItem(stats.stats_by_depth[0]);
+		YearStatisticsItem *item = addTopLevelItem(rootItem.get(), stats.stats_by_depth[0]);
 		for (i = 1; stats.stats_by_depth[i].is_trip; ++i)
-			if (stats.stats_by_depth[i].selection_size) {
-				label = QString(tr("%1 - %2")).arg(get_depth_string((i - 1) * (STATS_DEPTH_BUCKET * 1000), true, false),
-					get_depth_string(i * (STATS_DEPTH_BUCKET * 1000), true, false));
-				stats.stats_by_depth[i].location = strdup(label.toUtf8().data());
-				YearStatisticsItem *iChild = new YearStatisticsItem(stats.stats_by_depth[i]);
-				item->children.append(iChild);
-				iChild->parent = item;
-			}
-		rootItem->children.append(item);
-		item->parent = rootItem.get();
+			if (stats.stats_by_depth[i].selection_size)
+				item->pendingChildren.push_back({ stats.stats_by_depth[i], YearStatisticsItem::DEPTH_RANGE, i });
 	}
 
 	/* Show the statistic sorted by dive temperature */
 	if (stats.stats_by_temp != NULL && stats.stats_by_temp[0].selection_size) {
-		YearStatisticsItem *item = new YearStatisticsItem(stats.stats_by_temp[0]);
+		YearStatisticsItem *item = addTopLevelItem(rootItem.get(), stats.stats_by_temp[0]);
 		for (i = 1; stats.stats_by_temp[i].is_trip; ++i)
-			if (stats.stats_by_temp[i].selection_size) {
-				t_range_min.mkelvin = C_to_mkelvin((i - 1) * STATS_TEMP_BUCKET);
-				t_range_max.mkelvin = C_to_mkelvin(i * STATS_TEMP_BUCKET);
-				label = QString(tr("%1 - %2")).arg(get_temperature_string(t_range_min, true),
-					get_temperature_string(t_range_max, true));
-				stats.stats_by_temp[i].location = strdup(label.toUtf8().data());
-				YearStatisticsItem *iChild = new YearStatisticsItem(stats.stats_by_temp[i]);
-				item->children.append(iChild);
-				iChild->parent = item;
-			}
-		rootItem->children.append(item);
-		item->parent = rootItem.get();
+			if (stats.stats_by_temp[i].selection_size)
+				item->pendingChildren.push_back({ stats.stats_by_temp[i], YearStatisticsItem::TEMP_RANGE, i });
+	}
+}
+
+// Only top-level items have pending children
+static YearStatisticsItem *pendingItem(const QModelIndex &parent)
+{
+	if (!parent.isValid() || parent.parent().isValid())
+		return nullptr;
+	return static_cast<YearStatisticsItem *>(parent.internalPointer());
+}
+
+bool YearlyStatisticsModel::hasChildren(const QModelIndex &parent) const
+{
+	YearStatisticsItem *item = pendingItem(parent);
+	if (item && !item->pendingChildren.empty())
+		return true;
+	return TreeModel::hasChildren(parent);
+}
+
+bool YearlyStatisticsModel::canFetchMore(const QModelIndex &parent) const
+{
+	YearStatisticsItem *item = pendingItem(parent);
+	return item && !item->pendingChildren.empty();
+}
+
+void YearlyStatisticsModel::fetchMore(const QModelIndex &parent)
+{
+	YearStatisticsItem *item = pendingItem(parent);
+	if (!item || item->pendingChildren.empty())
+		return;
+	beginInsertRows(parent, item->children.size(), item->children.size() + (int)item->pendingChildren.size() - 1);
+	for (const YearStatisticsItem::Entry &entry: item->pendingChildren) {
+		YearStatisticsItem *iChild = new YearStatisticsItem(entry);
+		item->children.append(iChild);
+		iChild->parent = item;
 	}
+	item->pendingChildren.clear();
+	endInsertRows();
 }
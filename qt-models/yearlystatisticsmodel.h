@@ -30,6 +30,11 @@ public:
 	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 	YearlyStatisticsModel(QObject *parent = 0);
 	void update_yearly_stats();
+
+	// The children of the top-level items are created when they are expanded
+	bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+	bool canFetchMore(const QModelIndex &parent) const override;
+	void fetchMore(const QModelIndex &parent) override;
 };
 
 #endif
@@ -415,25 +415,66 @@ static void smtk_build_location(MdbHandle *mdb, char *idx, struct dive_site **lo
 	free(str);
 }
 
-static void smtk_build_tank_info(MdbHandle *mdb, cylinder_t *tank, char *idx)
+/*
+ * The Tank table is referenced by row number from the dives. Read it once
+ * into an array, instead of walking it for every tank of every dive.
+ * Tank format:
+ * | Idx | Text | Volume | ? | Working pressure | ...
+ */
+struct smtk_tank {
+	char *description;
+	int size, workingpressure;
+};
+
+static struct smtk_tank *smtk_build_tanks(MdbHandle *mdb, int *count)
 {
 	MdbTableDef *table;
-	MdbColumn *col[MDB_MAX_COLS];
 	char *bound_values[MDB_MAX_COLS];
-	int i;
+	struct smtk_tank *tanks_list = NULL;
+	int allocated = 0;
 
+	*count = 0;
 	table = smtk_open_table(mdb, "Tank", bound_values, NULL);
 	if (!table)
-		return;
+		return NULL;
 
-	for (i = 1; i <= atoi(idx); i++)
-		mdb_fetch_row(table);
-	tank->type.description = copy_string(bound_values[1]);
-	tank->type.size.mliter = lrint(strtod(bound_values[2], NULL) * 1000);
-	tank->type.workingpressure.mbar = lrint(strtod(bound_values[4], NULL) * 1000);
+	while (mdb_fetch_row(table)) {
+		if (*count == allocated) {
+			allocated = allocated ? allocated * 2 : 16;
+			tanks_list = realloc(tanks_list, allocated * sizeof(*tanks_list));
+		}
+		tanks_list[*count].description = copy_string(bound_values[1]);
+		tanks_list[*count].size = lrint(strtod(bound_values[2], NULL) * 1000);
+		tanks_list[*count].workingpressure = lrint(strtod(bound_values[4], NULL) * 1000);
+		(*count)++;
+	}
 
 	smtk_free(bound_values, table->num_cols);
 	mdb_free_tabledef(table);
+	return tanks_list;
+}
+
+static void smtk_free_tanks(struct smtk_tank *tanks_list, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		free(tanks_list[i].description);
+	free(tanks_list);
+}
+
+static void smtk_build_tank_info(struct smtk_tank *tanks_list, int count, cylinder_t *tank, char *idx)
+{
+	int i = atoi(idx);
+
+	if (i <= 0 || count == 0)
+		return;
+	/* Past the end of the table, we are left with the last row */
+	if (i > count)
+		i = count;
+	tank->type.description = copy_string(tanks_list[i - 1].description);
+	tank->type.size.mliter = tanks_list[i - 1].size;
+	tank->type.workingpressure.mbar = tanks_list[i - 1].workingpressure;
 }
 
 /*
@@ -621,34 +662,53 @@ static void smtk_build_list(MdbHandle *mdb,  char *table_name, char *array[])
 }
 
 /*
- * Parses a relation table and returns a list with the relations for a dive idx.
+ * Parses a relation table and returns an array, indexed by dive idx - 1, with
+ * the list of relations of every dive. Thus, the table is read only once and
+ * not for every single dive.
  * Use types_list items with text set to NULL.
- * Returns a pointer to the list head.
  * Table relation format:
  * | Diveidx | Idx |
  */
-static struct types_list *smtk_index_list(MdbHandle *mdb, char *table_name, char *dive_idx)
+static struct types_list **smtk_index_lists(MdbHandle *mdb, char *table_name, int dives_num)
 {
 	MdbTableDef *table;
 	char *bounders[MDB_MAX_COLS];
-	struct types_list *item, *head = NULL;
+	struct types_list **lists = calloc(dives_num + 1, sizeof(struct types_list *));
+	int i;
 
 	table = smtk_open_table(mdb, table_name, bounders, NULL);
 
 	/* Sanity check */
 	if (!table)
-		return NULL;
+		return lists;
 
-	/* Parse the table searching for dive_idx */
 	while (mdb_fetch_row(table)) {
-		if (!strcmp(dive_idx, bounders[0]))
-			smtk_head_insert(&head, atoi(bounders[1]), NULL);
+		i = atoi(bounders[0]) - 1;
+		if (i >= 0 && i < dives_num)
+			smtk_head_insert(&lists[i], atoi(bounders[1]), NULL);
 	}
 
 	/* Clean up and exit */
 	smtk_free(bounders, table->num_cols);
 	mdb_free_tabledef(table);
-	return head;
+	return lists;
+}
+
+/* Returns the list of a dive from an array built by smtk_index_lists() */
+static struct types_list *smtk_dive_list(struct types_list **lists, int dives_num, char *dive_idx)
+{
+	int i = atoi(dive_idx) - 1;
+
+	return i >= 0 && i < dives_num ? lists[i] : NULL;
+}
+
+static void smtk_lists_free(struct types_list **lists, int dives_num)
+{
+	int i;
+
+	for (i = 0; i < dives_num; i++)
+		smtk_list_free(lists[i]);
+	free(lists);
 }
 
 /*
@@ -691,20 +751,14 @@ static void smtk_build_buddies(MdbHandle *mdb, char *array[])
 /*
  * Returns string with buddies names as registered in smartrak (may be a nickname).
  */
-static char *smtk_locate_buddy(MdbHandle *mdb, char *dive_idx, char *buddies_list[])
+static char *smtk_locate_buddy(struct types_list *rel_head, char *buddies_list[])
 {
 	char *str = NULL;
-	struct types_list *rel, *rel_head;
-
-	rel_head = smtk_index_list(mdb, "BuddyRelation", dive_idx);
-	if (!rel_head)
-		return str;
+	struct types_list *rel;
 
 	for (rel = rel_head; rel; rel = rel->next)
 		str = smtk_concat_str(str, ", ", "%s", buddies_list[rel->idx - 1]);
 
-	/* Clean up and exit */
-	smtk_list_free(rel_head);
 	return str;
 }
 
@@ -714,14 +768,10 @@ static char *smtk_locate_buddy(MdbHandle *mdb, char *dive_idx, char *buddies_lis
  * The "tag" parameter is used to mark if we want this table to be imported
  * into tags or into notes.
  */
-static void smtk_parse_relations(MdbHandle *mdb, struct dive *dive, char *dive_idx, char *table_name, char *rel_table_name, char *list[], bool tag)
+static void smtk_parse_relations(struct dive *dive, struct types_list *diverel_head, char *table_name, char *list[], bool tag)
 {
 	char *tmp = NULL;
-	struct types_list *diverel_head, *d_runner;
-
-	diverel_head = smtk_index_list(mdb, rel_table_name, dive_idx);
-	if (!diverel_head)
-		return;
+	struct types_list *d_runner;
 
 	/* Get the text associated with the relations */
 	for (d_runner = diverel_head; d_runner; d_runner = d_runner->next) {
@@ -739,7 +789,6 @@ static void smtk_parse_relations(MdbHandle *mdb, struct dive *dive, char *dive_i
 	if (tmp)
 		dive->notes = smtk_concat_str(dive->notes, "\n", "Smartrak %s: %s", table_name, tmp);
 	free(tmp);
-	smtk_list_free(diverel_head);
 }
 
 /*
@@ -786,34 +835,55 @@ static struct event *find_bookmark(struct event *orig, unsigned int t)
  * XConnect irelevant
  * YConnect irelevant
  */
-static void smtk_parse_bookmarks(MdbHandle *mdb, struct dive *d, char *dive_idx)
+static struct types_list **smtk_build_markers(MdbHandle *mdb, int dives_num)
 {
 	MdbTableDef *table;
-	char *bound_values[MDB_MAX_COLS], *tmp = NULL;
-	unsigned int time;
-	struct event *ev;
+	char *bound_values[MDB_MAX_COLS];
+	struct types_list **lists = calloc(dives_num + 1, sizeof(struct types_list *));
+	struct types_list *head, *next;
+	int i;
 
 	table = smtk_open_table(mdb, "Marker", bound_values, NULL);
 	if (!table) {
-		report_error("[smtk-import] Error - Couldn't open table 'Marker', dive %d", d->number);
-		return;
+		report_error("[smtk-import] Error - Couldn't open table 'Marker'");
+		return lists;
 	}
 	while (mdb_fetch_row(table)) {
-		if (same_string(bound_values[0], dive_idx)) {
-			time = lrint(strtod(bound_values[4], NULL) * 60);
-			tmp = strdup(bound_values[2]);
-			ev = find_bookmark(d->dc.events, time);
-			if (ev)
-				update_event_name(d, ev, tmp);
-			else
-				if (!add_event(&d->dc, time, SAMPLE_EVENT_BOOKMARK, 0, 0, tmp))
-					report_error("[smtk-import] Error - Couldn't add bookmark, dive %d, Name = %s",
-						     d->number, tmp);
-		}
+		i = atoi(bound_values[0]) - 1;
+		if (i >= 0 && i < dives_num)
+			smtk_head_insert(&lists[i], lrint(strtod(bound_values[4], NULL) * 60), strdup(bound_values[2]));
 	}
-	free(tmp);
 	smtk_free(bound_values, table->num_cols);
 	mdb_free_tabledef(table);
+
+	/* Keep the markers in table order, later ones rename earlier ones */
+	for (i = 0; i < dives_num; i++) {
+		head = NULL;
+		while (lists[i]) {
+			next = lists[i]->next;
+			lists[i]->next = head;
+			head = lists[i];
+			lists[i] = next;
+		}
+		lists[i] = head;
+	}
+	return lists;
+}
+
+static void smtk_parse_bookmarks(struct dive *d, struct types_list *markers)
+{
+	struct types_list *marker;
+	struct event *ev;
+
+	for (marker = markers; marker; marker = marker->next) {
+		ev = find_bookmark(d->dc.events, marker->idx);
+		if (ev)
+			update_event_name(d, ev, marker->text);
+		else
+			if (!add_event(&d->dc, marker->idx, SAMPLE_EVENT_BOOKMARK, 0, 0, marker->text))
+				report_error("[smtk-import] Error - Couldn't add bookmark, dive %d, Name = %s",
+					     d->number, marker->text);
+	}
 }
 
 
@@ -942,7 +1012,9 @@ void smartrak_import(const char *file, struct dive_table *divetable)
 		weather_num = get_rows_num(mdb_clon, "Weather"),
 		underwater_num = get_rows_num(mdb_clon, "Underwater"),
 		surface_num = get_rows_num(mdb_clon, "Surface"),
-		buddy_num = get_rows_num(mdb_clon, "Buddy");
+		buddy_num = get_rows_num(mdb_clon, "Buddy"),
+		dives_num = get_rows_num(mdb_clon, "Dives"),
+		tank_num;
 
 	char	*type_list[type_num], *activity_list[activity_num], *gear_list[gear_num],
 		*fish_list[fish_num], *buddy_list[buddy_num], *suit_list[suit_num],
@@ -960,6 +1032,15 @@ void smartrak_import(const char *file, struct dive_table *divetable)
 	smtk_build_list(mdb_clon, "Underwater", underwater_list);
 	smtk_build_list(mdb_clon, "Surface", surface_list);
 	smtk_build_buddies(mdb_clon, buddy_list);
+	struct smtk_tank *tank_list = smtk_build_tanks(mdb_clon, &tank_num);
+
+	/* Load the relation tables, indexed by dive */
+	struct types_list **buddy_rel = smtk_index_lists(mdb_clon, "BuddyRelation", dives_num),
+			  **type_rel = smtk_index_lists(mdb_clon, "TypeRelation", dives_num),
+			  **activity_rel = smtk_index_lists(mdb_clon, "ActivityRelation", dives_num),
+			  **gear_rel = smtk_index_lists(mdb_clon, "GearRelation", dives_num),
+			  **fish_rel = smtk_index_lists(mdb_clon, "FishRelation", dives_num),
+			  **markers = smtk_build_markers(mdb_clon, dives_num);
 
 	/* Check Smarttrak version (different number of supported tanks, mixes and so) */
 	smtk_version = atoi(smtk_ver[0]);
@@ -1057,7 +1138,7 @@ void smartrak_import(const char *file, struct dive_table *divetable)
 			} else {
 				tmptank->gasmix.he.permille = 0;
 			}
-			smtk_build_tank_info(mdb_clon, tmptank, col[i + tankidxcol]->bind_ptr);
+			smtk_build_tank_info(tank_list, tank_num, tmptank, col[i + tankidxcol]->bind_ptr);
 		}
 		/* Check for duplicated cylinders and clean them */
 		smtk_clean_cylinders(smtkdive);
@@ -1083,21 +1164,28 @@ void smartrak_import(const char *file, struct dive_table *divetable)
 		add_cloned_weightsystem(&smtkdive->weightsystems, ws);
 		smtkdive->suit = copy_string(suit_list[atoi(col[coln(SUITIDX)]->bind_ptr) - 1]);
 		smtk_build_location(mdb_clon, col[coln(SITEIDX)]->bind_ptr, &smtkdive->dive_site);
-		smtkdive->buddy = smtk_locate_buddy(mdb_clon, col[0]->bind_ptr, buddy_list);
-		smtk_parse_relations(mdb_clon, smtkdive, col[0]->bind_ptr, "Type", "TypeRelation", type_list, true);
-		smtk_parse_relations(mdb_clon, smtkdive, col[0]->bind_ptr, "Activity", "ActivityRelation", activity_list, false);
-		smtk_parse_relations(mdb_clon, smtkdive, col[0]->bind_ptr, "Gear", "GearRelation", gear_list, false);
-		smtk_parse_relations(mdb_clon, smtkdive, col[0]->bind_ptr, "Fish", "FishRelation", fish_list, false);
+		smtkdive->buddy = smtk_locate_buddy(smtk_dive_list(buddy_rel, dives_num, col[0]->bind_ptr), buddy_list);
+		smtk_parse_relations(smtkdive, smtk_dive_list(type_rel, dives_num, col[0]->bind_ptr), "Type", type_list, true);
+		smtk_parse_relations(smtkdive, smtk_dive_list(activity_rel, dives_num, col[0]->bind_ptr), "Activity", activity_list, false);
+		smtk_parse_relations(smtkdive, smtk_dive_list(gear_rel, dives_num, col[0]->bind_ptr), "Gear", gear_list, false);
+		smtk_parse_relations(smtkdive, smtk_dive_list(fish_rel, dives_num, col[0]->bind_ptr), "Fish", fish_list, false);
 		smtk_parse_other(smtkdive, weather_list, "Weather", col[coln(WEATHERIDX)]->bind_ptr, false);
 		smtk_parse_other(smtkdive, underwater_list, "Underwater", col[coln(UNDERWATERIDX)]->bind_ptr, false);
 		smtk_parse_other(smtkdive, surface_list, "Surface", col[coln(SURFACEIDX)]->bind_ptr, false);
-		smtk_parse_bookmarks(mdb_clon, smtkdive, col[0]->bind_ptr);
+		smtk_parse_bookmarks(smtkdive, smtk_dive_list(markers, dives_num, col[0]->bind_ptr));
 		smtkdive->notes = smtk_concat_str(smtkdive->notes, "\n", "%s", col[coln(REMARKS)]->bind_ptr);
 
 		record_dive_to_table(smtkdive, divetable);
 		free(devdata);
 	}
 	mdb_free_tabledef(mdb_table);
+	smtk_lists_free(buddy_rel, dives_num);
+	smtk_lists_free(type_rel, dives_num);
+	smtk_lists_free(activity_rel, dives_num);
+	smtk_lists_free(gear_rel, dives_num);
+	smtk_lists_free(fish_rel, dives_num);
+	smtk_lists_free(markers, dives_num);
+	smtk_free_tanks(tank_list, tank_num);
 	mdb_free_catalog(mdb_clon);
 	mdb->catalog = NULL;
 	mdb_close(mdb_clon);
@@ -9,12 +9,16 @@
 #include "core/color.h"
 #include "core/downloadfromdcthread.h" // for fill_computer_list
 #include "core/errorhelper.h"
+#include "core/git-access.h"
 #include "core/parse.h"
 #include "core/qt-gui.h"
 #include "core/qthelper.h"
+#include "core/subsurface-string.h"
 #include "core/subsurfacestartup.h"
 #include "core/settings/qPref.h"
 #include "core/tag.h"
+#include "core/memusage.h"
+#include "core/trace.h"
 #include "desktop-widgets/diveplanner.h"
 #include "desktop-widgets/mainwindow.h"
 #include "desktop-widgets/preferences/preferencesdialog.h"
@@ -103,6 +107,16 @@ int main(int argc, char **argv)
 				files.push_back(cloudURL);
 		}
 	}
+	// Check the connection to the cloud while the main window is set up,
+	// the result is used when the cloud storage is synced in loadFiles().
+	if (!git_local_only && !same_string(prefs.cloud_git_url, "")) {
+		for (const QString &file: files) {
+			if (file.startsWith(prefs.cloud_git_url)) {
+				startCloudServerCheck();
+				break;
+			}
+		}
+	}
 	MainWindow *m = MainWindow::instance();
 	filesOnCommandLine = !files.isEmpty() || !importedFiles.isEmpty();
 	if (verbose && !files.isEmpty())
@@ -116,8 +130,12 @@ int main(int argc, char **argv)
 		print_files();
 	if (!quit)
 		run_ui();
+	if (trace_filename)
+		save_trace(trace_filename);
+	if (memory_usage_report)
+		print_memory_usage();
 	exit_ui();
-	taglist_free(g_tag_list);
+	taglist_free_global();
 	parse_xml_exit();
 	free((void *)default_directory);
 	free((void *)default_filename);
@@ -16,6 +16,8 @@
 #include "core/settings/qPref.h"
 #include "core/settings/qPrefDisplay.h"
 #include "core/tag.h"
+#include "core/memusage.h"
+#include "core/trace.h"
 #include "core/settings/qPrefCloudStorage.h"
 
 #include <QApplication>
@@ -76,8 +78,12 @@ int main(int argc, char **argv)
 
 	if (!quit)
 		run_ui();
+	if (trace_filename)
+		save_trace(trace_filename);
+	if (memory_usage_report)
+		print_memory_usage();
 	exit_ui();
-	taglist_free(g_tag_list);
+	taglist_free_global();
 	parse_xml_exit();
 	subsurface_console_exit();
 
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0
+// Write a synthetic logbook of a given size and shape, e.g.
+//	GenerateLogbook --dives 10000 --ccr-share 0.2 large.ssrf
+//	GenerateLogbook --dives 10000 --pictures 3 ./large-git[master]
+#include "logbookgenerator.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divesite.h"
+#include "core/pref.h"
+#include "core/trip.h"
+#include <git2.h>
+#include <stdio.h>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+
+int main(int argc, char **argv)
+{
+	QCoreApplication app(argc, argv);
+	QCommandLineParser parser;
+	LogbookShape shape;
+	parser.setApplicationDescription("Generate a synthetic logbook. An output name of the form "
+					 "directory[branch] creates a git repository in directory.");
+	parser.addHelpOption();
+	parser.addPositionalArgument("output", "The logbook to write");
+	QCommandLineOption dives("dives", "Number of dives", "n", QString::number(shape.dives));
+	QCommandLineOption interval("sample-interval", "Seconds between samples", "s", QString::number(shape.sampleInterval));
+	QCommandLineOption cylinders("cylinders", "Cylinders per dive", "n", QString::number(shape.cylinders));
+	QCommandLineOption sensors("pressure-sensors", "Cylinders with pressure samples", "n", QString::number(shape.pressureSensors));
+	QCommandLineOption o2Sensors("o2-sensors", "PO2 sensors of CCR dives", "n", QString::number(shape.o2Sensors));
+	QCommandLineOption ccrShare("ccr-share", "Fraction of CCR dives", "f", QString::number(shape.ccrShare));
+	QCommandLineOption pictures("pictures", "Pictures per dive", "n", QString::number(shape.pictures));
+	QCommandLineOption sites("sites", "Number of dive sites", "n", QString::number(shape.sites));
+	QCommandLineOption trips("trips", "Number of trips", "n", QString::number(shape.trips));
+	QCommandLineOption seed("seed", "Seed of the random numbers", "n", QString::number(shape.seed));
+	parser.addOptions({ dives, interval, cylinders, sensors, o2Sensors, ccrShare, pictures, sites, trips, seed });
+	parser.process(app);
+	if (parser.positionalArguments().size() != 1)
+		parser.showHelp(1);
+
+	shape.dives = parser.value(dives).toInt();
+	shape.sampleInterval = parser.value(interval).toInt();
+	shape.cylinders = parser.value(cylinders).toInt();
+	shape.pressureSensors = parser.value(sensors).toInt();
+	shape.o2Sensors = parser.value(o2Sensors).toInt();
+	shape.ccrShare = parser.value(ccrShare).toDouble();
+	shape.pictures = parser.value(pictures).toInt();
+	shape.sites = parser.value(sites).toInt();
+	shape.trips = parser.value(trips).toInt();
+	shape.seed = parser.value(seed).toUInt();
+
+	copy_prefs(&default_prefs, &prefs);
+	git_libgit2_init();
+	generateLogbook(shape, &dive_table, &trip_table, &dive_site_table);
+	process_loaded_dives();
+	QByteArray output = parser.positionalArguments().first().toLocal8Bit();
+	if (saveLogbook(output.constData())) {
+		fprintf(stderr, "Unable to write %s\n", output.constData());
+		return 1;
+	}
+	printf("Wrote %d dives to %s\n", dive_table.nr, output.constData());
+	return 0;
+}
@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "logbookgenerator.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divesite.h"
+#include "core/equipment.h"
+#include "core/picture.h"
+#include "core/qthelper.h"
+#include "core/subsurface-string.h"
+#include "core/trip.h"
+#include <git2.h>
+#include <algorithm>
+#include <random>
+#include <QDir>
+#include <QString>
+
+// Dives are added from the start of 2000 on
+#define FIRST_DIVE_TIME 946684800
+
+namespace {
+	class Generator {
+	public:
+		Generator(const LogbookShape &shape) : shape(shape), rng(shape.seed)
+		{
+		}
+		int uniform(int from, int to)
+		{
+			return std::uniform_int_distribution<int>(from, to)(rng);
+		}
+		double uniform(double from, double to)
+		{
+			return std::uniform_real_distribution<double>(from, to)(rng);
+		}
+		dive *generateDive(timestamp_t when, int number);
+	private:
+		void addCylinders(dive *d, bool ccr);
+		void addSamples(dive *d, bool ccr);
+		void addPictures(dive *d, int number);
+
+		const LogbookShape &shape;
+		std::mt19937 rng;
+	};
+}
+
+void Generator::addCylinders(dive *d, bool ccr)
+{
+	static const int o2[] = { 209, 320, 500, 1000 };
+	int nr = ccr ? std::max(shape.cylinders, 2) : std::max(shape.cylinders, 1);
+
+	for (int i = 0; i < nr; ++i) {
+		cylinder_t cyl = empty_cylinder;
+		cyl.type.description = copy_string(i == 0 ? "AL80" : "AL40");
+		cyl.type.size.mliter = i == 0 ? 11100 : 5700;
+		cyl.type.workingpressure.mbar = 207000;
+		cyl.gasmix.o2.permille = o2[i % 4];
+		cyl.start.mbar = uniform(180000, 220000);
+		cyl.end.mbar = uniform(30000, 80000);
+		if (ccr && i < 2) {
+			cyl.cylinder_use = i == 0 ? DILUENT : OXYGEN;
+			cyl.gasmix.o2.permille = i == 0 ? 209 : 1000;
+		}
+		add_cylinder(&d->cylinders, i, cyl);
+	}
+}
+
+// A square profile with a safety stop: descend at 18 m/min, ascend at 9 m/min
+void Generator::addSamples(dive *d, bool ccr)
+{
+	divecomputer *dc = &d->dc;
+	int maxdepth = uniform(8000, ccr ? 60000 : 40000);
+	int stop = maxdepth > 10000 ? 180 : 0;
+	int stopdepth = stop ? 5000 : 0;
+	int descent = maxdepth * 60 / 18000;
+	int bottom = uniform(20, 60) * 60;
+	int ascent = (maxdepth - stopdepth) * 60 / 9000;
+	int finalAscent = stopdepth * 60 / 9000;
+	int duration = descent + bottom + ascent + stop + finalAscent;
+	int interval = std::max(shape.sampleInterval, 1);
+	int sensors = std::min(std::min(shape.pressureSensors, MAX_SENSORS), d->cylinders.nr);
+	int temperature = uniform(275000, 303000);
+
+	for (int t = 0; t <= duration; t += interval) {
+		sample s = {};
+		int depth;
+		int t2 = t - descent - bottom;
+		if (t < descent)
+			depth = maxdepth * t / descent;
+		else if (t2 < 0)
+			depth = maxdepth - uniform(0, maxdepth / 10);
+		else if (t2 < ascent)
+			depth = maxdepth - (maxdepth - stopdepth) * t2 / ascent;
+		else if (t2 < ascent + stop)
+			depth = stopdepth;
+		else
+			depth = finalAscent ? stopdepth * (duration - t) / finalAscent : 0;
+		s.depth.mm = depth;
+		s.temperature.mkelvin = temperature - depth / 10;
+		for (int i = 0; i < sensors; ++i) {
+			const cylinder_t *cyl = get_cylinder(d, i);
+			add_sample_pressure(&s, i, cyl->start.mbar - (cyl->start.mbar - cyl->end.mbar) * t / duration);
+		}
+		if (ccr) {
+			s.setpoint.mbar = depth > 3000 ? 1300 : 700;
+			for (int i = 0; i < std::min(shape.o2Sensors, 3); ++i)
+				s.o2sensor[i].mbar = s.setpoint.mbar + uniform(-50, 50);
+		}
+		add_sample(&s, t, dc);
+	}
+	dc->duration.seconds = duration;
+}
+
+void Generator::addPictures(dive *d, int number)
+{
+	for (int i = 0; i < shape.pictures; ++i) {
+		picture pic = empty_picture;
+		pic.filename = copy_qstring(QString("/pictures/dive%1-%2.jpg").arg(number).arg(i));
+		pic.offset.seconds = uniform(0, d->dc.duration.seconds);
+		add_picture(&d->pictures, pic);
+	}
+}
+
+dive *Generator::generateDive(timestamp_t when, int number)
+{
+	dive *d = alloc_dive();
+	bool ccr = uniform(0.0, 1.0) < shape.ccrShare;
+
+	d->when = d->dc.when = when;
+	d->number = number;
+	d->rating = uniform(0, 5);
+	d->visibility = uniform(0, 5);
+	d->buddy = copy_qstring(QString("Buddy %1").arg(uniform(1, 50)));
+	d->notes = copy_qstring(QString("Generated dive %1").arg(number));
+	d->dc.model = copy_string(ccr ? "Generated CCR" : "Generated");
+	d->dc.deviceid = ccr ? 0x1002 : 0x1001;
+	d->dc.diveid = number;
+	if (ccr) {
+		d->dc.divemode = CCR;
+		d->dc.no_o2sensors = std::min(shape.o2Sensors, 3);
+	}
+	addCylinders(d, ccr);
+	addSamples(d, ccr);
+	addPictures(d, number);
+	return d;
+}
+
+void generateLogbook(const LogbookShape &shape, struct dive_table *table, struct trip_table *trips,
+		     struct dive_site_table *sites)
+{
+	Generator gen(shape);
+	std::vector<dive_site *> siteList;
+
+	for (int i = 0; i < shape.sites; ++i) {
+		location_t loc = create_location(gen.uniform(-60.0, 60.0), gen.uniform(-180.0, 180.0));
+		siteList.push_back(create_dive_site_with_gps(qPrintable(QString("Site %1").arg(i + 1)), &loc, sites));
+	}
+
+	// Two dives a day, with a few days in between the trips
+	int nrTrips = std::min(shape.trips, shape.dives);
+	dive_trip *trip = nullptr;
+	int tripNr = 0;
+	timestamp_t when = FIRST_DIVE_TIME;
+	for (int i = 0; i < shape.dives; ++i) {
+		when += i % 2 ? 3 * 3600 : 21 * 3600;
+		if (nrTrips > 0 && (long long)i * nrTrips / shape.dives >= tripNr) {
+			if (trip)
+				insert_trip(trip, trips);
+			trip = alloc_trip();
+			trip->location = copy_qstring(QString("Trip %1").arg(++tripNr));
+			when += gen.uniform(3, 30) * 24 * 3600;
+		}
+		dive *d = gen.generateDive(when + gen.uniform(0, 3600), i + 1);
+		if (!siteList.empty())
+			add_dive_to_dive_site(d, siteList[gen.uniform(0, (int)siteList.size() - 1)]);
+		fixup_dive(d);
+		record_dive_to_table(d, table);
+		if (trip)
+			add_dive_to_trip(d, trip);
+	}
+	if (trip)
+		insert_trip(trip, trips);
+	sort_dive_table(table);
+	sort_trip_table(trips);
+}
+
+int saveLogbook(const char *filename)
+{
+	QString name(filename);
+	if (name.endsWith(']')) {
+		QString dir = name.left(name.lastIndexOf('['));
+		git_repository *repo;
+		if (!QDir(dir).removeRecursively() || !QDir().mkpath(dir) ||
+		    git_repository_init(&repo, qPrintable(dir), false))
+			return -1;
+		git_repository_free(repo);
+	}
+	return save_dives(filename);
+}
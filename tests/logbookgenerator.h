@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-2.0
+// Synthetic logbooks for the scaling tests. The logbooks are deterministic
+// for a given shape, so that runs can be compared.
+#ifndef LOGBOOKGENERATOR_H
+#define LOGBOOKGENERATOR_H
+
+struct dive_table;
+struct trip_table;
+struct dive_site_table;
+
+struct LogbookShape {
+	int dives = 1000;
+	int sampleInterval = 10;	// Seconds between samples
+	int cylinders = 1;		// Per dive, CCR dives get at least a diluent and an oxygen cylinder
+	int pressureSensors = 1;	// Cylinders with pressure samples, at most MAX_SENSORS
+	int o2Sensors = 3;		// PO2 sensors of CCR dives, at most 3
+	double ccrShare = 0.0;		// Fraction of the dives that are CCR dives
+	int pictures = 0;		// Per dive
+	int sites = 100;
+	int trips = 100;		// Consecutive dives are grouped into that many trips
+	unsigned int seed = 1;
+};
+
+// Add the dives, trips and dive sites of a random logbook to the tables.
+// The dives are fixed up, sorted and numbered.
+void generateLogbook(const LogbookShape &shape, struct dive_table *table, struct trip_table *trips,
+		     struct dive_site_table *sites);
+
+// Save the global dive tables to filename. A filename of the form
+// "directory[branch]" creates a git repository in directory first.
+int saveLogbook(const char *filename);
+
+#endif
@@ -0,0 +1,365 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "planscenarios.h"
+#include "core/dive.h"
+#include "core/planner.h"
+#include "core/pref.h"
+#include "core/qthelper.h"
+#include "core/subsurfacestartup.h"
+#include "core/units.h"
+
+void setupPrefs()
+{
+	copy_prefs(&default_prefs, &prefs);
+	prefs.ascrate50 = feet_to_mm(30) / 60;
+	prefs.ascrate75 = prefs.ascrate50;
+	prefs.ascratestops = prefs.ascrate50;
+	prefs.ascratelast6m = feet_to_mm(10) / 60;
+	prefs.last_stop = true;
+}
+
+void setupPrefsVpmb()
+{
+	copy_prefs(&default_prefs, &prefs);
+	prefs.ascrate50 = 10000 / 60;
+	prefs.ascrate75 = prefs.ascrate50;
+	prefs.ascratestops = prefs.ascrate50;
+	prefs.ascratelast6m = prefs.ascrate50;
+	prefs.descrate = 99000 / 60;
+	prefs.last_stop = false;
+	prefs.planner_deco_mode = VPMB;
+	prefs.vpmb_conservatism = 0;
+}
+
+void setupPlan(struct diveplan *dp)
+{
+	dp->salinity = 10300;
+	dp->surface_pressure = 1013;
+	dp->gfhigh = 100;
+	dp->gflow = 100;
+	dp->bottomsac = prefs.bottomsac;
+	dp->decosac = prefs.decosac;
+
+	struct gasmix bottomgas = {{150}, {450}};
+	struct gasmix ean36 = {{360}, {0}};
+	struct gasmix oxygen = {{1000}, {0}};
+	pressure_t po2 = {1600};
+	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
+	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
+	cylinder_t *cyl2 = get_or_create_cylinder(&displayed_dive, 2);
+	cyl0->gasmix = bottomgas;
+	cyl0->type.size.mliter = 36000;
+	cyl0->type.workingpressure.mbar = 232000;
+	cyl1->gasmix = ean36;
+	cyl2->gasmix = oxygen;
+	reset_cylinders(&displayed_dive, true);
+	free_dps(dp);
+
+	int droptime = M_OR_FT(79, 260) * 60 / M_OR_FT(23, 75);
+	plan_add_segment(dp, 0, gas_mod(ean36, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
+	plan_add_segment(dp, 0, gas_mod(oxygen, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 2, 0, 1, OC);
+	plan_add_segment(dp, droptime, M_OR_FT(79, 260), 0, 0, 1, OC);
+	plan_add_segment(dp, 30 * 60 - droptime, M_OR_FT(79, 260), 0, 0, 1, OC);
+}
+
+void setupPlanVpmb45m30mTx(struct diveplan *dp)
+{
+	dp->salinity = 10300;
+	dp->surface_pressure = 1013;
+	dp->gfhigh = 100;
+	dp->gflow = 100;
+	dp->bottomsac = prefs.bottomsac;
+	dp->decosac = prefs.decosac;
+
+	struct gasmix bottomgas = {{210}, {350}};
+	struct gasmix ean50 = {{500}, {0}};
+	struct gasmix oxygen = {{1000}, {0}};
+	pressure_t po2 = {1600};
+	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
+	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
+	cylinder_t *cyl2 = get_or_create_cylinder(&displayed_dive, 2);
+	cyl0->gasmix = bottomgas;
+	cyl0->type.size.mliter = 24000;
+	cyl0->type.workingpressure.mbar = 232000;
+	cyl1->gasmix = ean50;
+	cyl2->gasmix = oxygen;
+	reset_cylinders(&displayed_dive, true);
+	free_dps(dp);
+
+	int droptime = M_OR_FT(45, 150) * 60 / M_OR_FT(23, 75);
+	plan_add_segment(dp, 0, gas_mod(ean50, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
+	plan_add_segment(dp, 0, gas_mod(oxygen, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 2, 0, 1, OC);
+	plan_add_segment(dp, droptime, M_OR_FT(45, 150), 0, 0, 1, OC);
+	plan_add_segment(dp, 30 * 60 - droptime, M_OR_FT(45, 150), 0, 0, 1, OC);
+}
+
+void setupPlanVpmb60m10mTx(struct diveplan *dp)
+{
+	dp->salinity = 10300;
+	dp->surface_pressure = 1013;
+	dp->gfhigh = 100;
+	dp->gflow = 100;
+	dp->bottomsac = prefs.bottomsac;
+	dp->decosac = prefs.decosac;
+
+	struct gasmix bottomgas = {{180}, {450}};
+	struct gasmix tx50_15 = {{500}, {150}};
+	struct gasmix oxygen = {{1000}, {0}};
+	pressure_t po2 = {1600};
+	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
+	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
+	cylinder_t *cyl2 = get_or_create_cylinder(&displayed_dive, 2);
+	cyl0->gasmix = bottomgas;
+	cyl0->type.size.mliter = 24000;
+	cyl0->type.workingpressure.mbar = 232000;
+	cyl1->gasmix = tx50_15;
+	cyl2->gasmix = oxygen;
+	reset_cylinders(&displayed_dive, true);
+	free_dps(dp);
+
+	int droptime = M_OR_FT(60, 200) * 60 / M_OR_FT(23, 75);
+	plan_add_segment(dp, 0, gas_mod(tx50_15, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
+	plan_add_segment(dp, 0, gas_mod(oxygen, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 2, 0, 1, OC);
+	plan_add_segment(dp, droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
+	plan_add_segment(dp, 10 * 60 - droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
+}
+
+void setupPlanVpmb60m30minAir(struct diveplan *dp)
+{
+	dp->salinity = 10300;
+	dp->surface_pressure = 1013;
+	dp->bottomsac = prefs.bottomsac;
+	dp->decosac = prefs.decosac;
+
+	struct gasmix bottomgas = {{210}, {0}};
+	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
+	cyl0->gasmix = bottomgas;
+	cyl0->type.size.mliter = 100000;
+	cyl0->type.workingpressure.mbar = 232000;
+	displayed_dive.surface_pressure.mbar = 1013;
+	reset_cylinders(&displayed_dive, true);
+	free_dps(dp);
+
+	int droptime = M_OR_FT(60, 200) * 60 / M_OR_FT(99, 330);
+	plan_add_segment(dp, droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
+	plan_add_segment(dp, 30 * 60 - droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
+}
+
+void setupPlanVpmb60m30minEan50(struct diveplan *dp)
+{
+	dp->salinity = 10300;
+	dp->surface_pressure = 1013;
+	dp->bottomsac = prefs.bottomsac;
+	dp->decosac = prefs.decosac;
+
+	struct gasmix bottomgas = {{210}, {0}};
+	struct gasmix ean50 = {{500}, {0}};
+	pressure_t po2 = {1600};
+	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
+	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
+	cyl0->gasmix = bottomgas;
+	cyl0->type.size.mliter = 36000;
+	cyl0->type.workingpressure.mbar = 232000;
+	cyl1->gasmix = ean50;
+	displayed_dive.surface_pressure.mbar = 1013;
+	reset_cylinders(&displayed_dive, true);
+	free_dps(dp);
+
+	int droptime = M_OR_FT(60, 200) * 60 / M_OR_FT(99, 330);
+	plan_add_segment(dp, 0, gas_mod(ean50, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
+	plan_add_segment(dp, droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
+	plan_add_segment(dp, 30 * 60 - droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
+}
+
+void setupPlanVpmb60m30minTx(struct diveplan *dp)
+{
+	dp->salinity = 10300;
+	dp->surface_pressure = 1013;
+	dp->bottomsac = prefs.bottomsac;
+	dp->decosac = prefs.decosac;
+
+	struct gasmix bottomgas = {{180}, {450}};
+	struct gasmix ean50 = {{500}, {0}};
+	pressure_t po2 = {1600};
+	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
+	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
+	cyl0->gasmix = bottomgas;
+	cyl0->type.size.mliter = 36000;
+	cyl0->type.workingpressure.mbar = 232000;
+	cyl1->gasmix = ean50;
+	displayed_dive.surface_pressure.mbar = 1013;
+	reset_cylinders(&displayed_dive, true);
+	free_dps(dp);
+
+	int droptime = M_OR_FT(60, 200) * 60 / M_OR_FT(99, 330);
+	plan_add_segment(dp, 0, gas_mod(ean50, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
+	plan_add_segment(dp, droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
+	plan_add_segment(dp, 30 * 60 - droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
+}
+
+void setupPlanVpmbMultiLevelAir(struct diveplan *dp)
+{
+	dp->salinity = 10300;
+	dp->surface_pressure = 1013;
+	dp->bottomsac = prefs.bottomsac;
+	dp->decosac = prefs.decosac;
+
+	struct gasmix bottomgas = {{210}, {0}};
+	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
+	cyl0->gasmix = bottomgas;
+	cyl0->type.size.mliter = 200000;
+	cyl0->type.workingpressure.mbar = 232000;
+	displayed_dive.surface_pressure.mbar = 1013;
+	reset_cylinders(&displayed_dive, true);
+	free_dps(dp);
+
+	int droptime = M_OR_FT(20, 66) * 60 / M_OR_FT(99, 330);
+	plan_add_segment(dp, droptime, M_OR_FT(20, 66), 0, 0, 1, OC);
+	plan_add_segment(dp, 10 * 60 - droptime, M_OR_FT(20, 66), 0, 0, 1, OC);
+	plan_add_segment(dp, 1 * 60, M_OR_FT(60, 200), 0, 0, 1, OC);
+	plan_add_segment(dp, 29 * 60, M_OR_FT(60, 200), 0, 0, 1, OC);
+}
+
+void setupPlanVpmb100m60min(struct diveplan *dp)
+{
+	dp->salinity = 10300;
+	dp->surface_pressure = 1013;
+	dp->bottomsac = prefs.bottomsac;
+	dp->decosac = prefs.decosac;
+
+	struct gasmix bottomgas = {{180}, {450}};
+	struct gasmix ean50 = {{500}, {0}};
+	struct gasmix oxygen = {{1000}, {0}};
+	pressure_t po2 = {1600};
+	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
+	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
+	cylinder_t *cyl2 = get_or_create_cylinder(&displayed_dive, 2);
+	cyl0->gasmix = bottomgas;
+	cyl0->type.size.mliter = 200000;
+	cyl0->type.workingpressure.mbar = 232000;
+	cyl1->gasmix = ean50;
+	cyl2->gasmix = oxygen;
+	displayed_dive.surface_pressure.mbar = 1013;
+	reset_cylinders(&displayed_dive, true);
+	free_dps(dp);
+
+	int droptime = M_OR_FT(100, 330) * 60 / M_OR_FT(99, 330);
+	plan_add_segment(dp, 0, gas_mod(ean50, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
+	plan_add_segment(dp, 0, gas_mod(oxygen, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 2, 0, 1, OC);
+	plan_add_segment(dp, droptime, M_OR_FT(100, 330), 0, 0, 1, OC);
+	plan_add_segment(dp, 60 * 60 - droptime, M_OR_FT(100, 330), 0, 0, 1, OC);
+}
+
+void setupPlanVpmb100m10min(struct diveplan *dp)
+{
+	dp->salinity = 10300;
+	dp->surface_pressure = 1013;
+	dp->bottomsac = prefs.bottomsac;
+	dp->decosac = prefs.decosac;
+
+	struct gasmix bottomgas = {{180}, {450}};
+	struct gasmix ean50 = {{500}, {0}};
+	struct gasmix oxygen = {{1000}, {0}};
+	pressure_t po2 = {1600};
+	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
+	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
+	cylinder_t *cyl2 = get_or_create_cylinder(&displayed_dive, 2);
+	cyl0->gasmix = bottomgas;
+	cyl0->type.size.mliter = 60000;
+	cyl0->type.workingpressure.mbar = 232000;
+	cyl1->gasmix = ean50;
+	cyl2->gasmix = oxygen;
+	displayed_dive.surface_pressure.mbar = 1013;
+	reset_cylinders(&displayed_dive, true);
+	free_dps(dp);
+
+	int droptime = M_OR_FT(100, 330) * 60 / M_OR_FT(99, 330);
+	plan_add_segment(dp, 0, gas_mod(ean50, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
+	plan_add_segment(dp, 0, gas_mod(oxygen, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 2, 0, 1, OC);
+	plan_add_segment(dp, droptime, M_OR_FT(100, 330), 0, 0, 1, OC);
+	plan_add_segment(dp, 10 * 60 - droptime, M_OR_FT(100, 330), 0, 0, 1, OC);
+}
+
+void setupPlanVpmb30m20min(struct diveplan *dp)
+{
+	dp->salinity = 10300;
+	dp->surface_pressure = 1013;
+	dp->bottomsac = prefs.bottomsac;
+	dp->decosac = prefs.decosac;
+
+	struct gasmix bottomgas = {{210}, {0}};
+	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
+	cyl0->gasmix = bottomgas;
+	cyl0->type.size.mliter = 36000;
+	cyl0->type.workingpressure.mbar = 232000;
+	displayed_dive.surface_pressure.mbar = 1013;
+	reset_cylinders(&displayed_dive, true);
+	free_dps(dp);
+
+	int droptime = M_OR_FT(30, 100) * 60 / M_OR_FT(18, 60);
+	plan_add_segment(dp, droptime, M_OR_FT(30, 100), 0, 0, 1, OC);
+	plan_add_segment(dp, 20 * 60 - droptime, M_OR_FT(30, 100), 0, 0, 1, OC);
+}
+
+void setupPlanVpmb100mTo70m30min(struct diveplan *dp)
+{
+	dp->salinity = 10300;
+	dp->surface_pressure = 1013;
+	dp->bottomsac = prefs.bottomsac;
+	dp->decosac = prefs.decosac;
+
+	struct gasmix bottomgas = {{120}, {650}};
+	struct gasmix tx21_35 = {{210}, {350}};
+	struct gasmix ean50 = {{500}, {0}};
+	struct gasmix oxygen = {{1000}, {0}};
+	pressure_t po2 = {1600};
+	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
+	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
+	cylinder_t *cyl2 = get_or_create_cylinder(&displayed_dive, 2);
+	cylinder_t *cyl3 = get_or_create_cylinder(&displayed_dive, 3);
+	cyl0->gasmix = bottomgas;
+	cyl0->type.size.mliter = 36000;
+	cyl0->type.workingpressure.mbar = 232000;
+	cyl1->gasmix = tx21_35;
+	cyl2->gasmix = ean50;
+	cyl3->gasmix = oxygen;
+	displayed_dive.surface_pressure.mbar = 1013;
+	reset_cylinders(&displayed_dive, true);
+	free_dps(dp);
+
+	int droptime = M_OR_FT(100, 330) * 60 / M_OR_FT(18, 60);
+	plan_add_segment(dp, 0, gas_mod(tx21_35, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
+	plan_add_segment(dp, 0, gas_mod(ean50, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 2, 0, 1, OC);
+	plan_add_segment(dp, 0, gas_mod(oxygen, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 3, 0, 1, OC);
+	plan_add_segment(dp, droptime, M_OR_FT(100, 330), 0, 0, 1, OC);
+	plan_add_segment(dp, 20 * 60 - droptime, M_OR_FT(100, 330), 0, 0, 1, OC);
+	plan_add_segment(dp, 3 * 60, M_OR_FT(70, 230), 0, 0, 1, OC);
+	plan_add_segment(dp, (30 - 20 - 3) * 60, M_OR_FT(70, 230), 0, 0, 1, OC);
+}
+
+/* This tests handling different gases in the manually entered part of the dive */
+
+void setupPlanSeveralGases(struct diveplan *dp)
+{
+	dp->salinity = 10300;
+	dp->surface_pressure = 1013;
+	dp->bottomsac = prefs.bottomsac;
+	dp->decosac = prefs.decosac;
+
+	struct gasmix ean36 = {{360}, {0}};
+	struct gasmix tx11_50 = {{110}, {500}};
+
+	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
+	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
+	cyl0->gasmix = ean36;
+	cyl0->type.size.mliter = 36000;
+	cyl0->type.workingpressure.mbar = 232000;
+	cyl1->gasmix = tx11_50;
+	displayed_dive.surface_pressure.mbar = 1013;
+	reset_cylinders(&displayed_dive, true);
+	free_dps(dp);
+
+	plan_add_segment(dp, 120, 40000, 0, 0, true, OC);
+	plan_add_segment(dp, 18 * 60, 40000, 0, 0, true, OC);
+	plan_add_segment(dp, 10 * 60, 10000, 1, 0, true, OC);
+	plan_add_segment(dp, 5 * 60, 10000, 0, 0, true, OC);
+}
@@ -0,0 +1,25 @@
+// SPDX-License-Identifier: GPL-2.0
+// The dive plans of TestPlan, shared with the deco benchmarks. The
+// setupPlan*() functions set up the cylinders of displayed_dive.
+#ifndef PLANSCENARIOS_H
+#define PLANSCENARIOS_H
+
+struct diveplan;
+
+void setupPrefs();
+void setupPrefsVpmb();
+
+void setupPlan(struct diveplan *dp);
+void setupPlanVpmb45m30mTx(struct diveplan *dp);
+void setupPlanVpmb60m10mTx(struct diveplan *dp);
+void setupPlanVpmb60m30minAir(struct diveplan *dp);
+void setupPlanVpmb60m30minEan50(struct diveplan *dp);
+void setupPlanVpmb60m30minTx(struct diveplan *dp);
+void setupPlanVpmbMultiLevelAir(struct diveplan *dp);
+void setupPlanVpmb100m60min(struct diveplan *dp);
+void setupPlanVpmb100m10min(struct diveplan *dp);
+void setupPlanVpmb30m20min(struct diveplan *dp);
+void setupPlanVpmb100mTo70m30min(struct diveplan *dp);
+void setupPlanSeveralGases(struct diveplan *dp);
+
+#endif
@@ -0,0 +1,323 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testdecoperformance.h"
+#include "logbookgenerator.h"
+#include "planscenarios.h"
+#include "core/applicationstate.h"
+#include "core/deco.h"
+#include "core/dive.h"
+#include "core/divelist.h"
+#include "core/divesite.h"
+#include "core/planner.h"
+#include "core/pref.h"
+#include "core/profile.h"
+#include "core/qthelper.h"
+#include "core/trip.h"
+#include "core/version.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+
+/*
+ * Micro-benchmarks of the deco code. The building blocks (add_segment(),
+ * tissue_tolerance_calc() and calculate_deco_information()) are timed on
+ * the profiles of a synthetic logbook, plan() is timed on the dive plans of
+ * TestPlan. The results are reported in ns per sample, or per plot entry.
+ *
+ * Every measurement is repeated BENCHMARK_ROUNDS times and the fastest run
+ * is reported, which is much less noisy than the mean. The results are
+ * written to SUBSURFACE_BENCHMARK_OUTPUT. If SUBSURFACE_BENCHMARK_BASELINE
+ * names the output of a previous run, the test fails if any result got
+ * slower than the baseline by more than SUBSURFACE_BENCHMARK_TOLERANCE
+ * percent (default 20). The decobenchmark target of the build compares
+ * against decobaseline.json, so that changes to deco.c and planner.c can
+ * be checked with
+ *	make decobenchmark			(on the old code)
+ *	cp decobenchmark.json decobaseline.json
+ *	make decobenchmark			(on the new code)
+ */
+#define BENCHMARK_ROUNDS 5
+#define BENCHMARK_DIVES 100
+
+static struct decostop stoptable[60];
+static struct deco_state bench_deco_state;
+
+static const struct {
+	const char *name;
+	enum deco_mode value;
+} decoModes[] = {
+	{ "buehlmann", BUEHLMANN },
+	{ "vpmb", VPMB }
+};
+
+static const int timesteps[] = { 60, 10, 2 };
+
+// A CCR dive with an open circuit bailout, the only plan not taken from TestPlan
+static void setupPlanCcr(struct diveplan *dp)
+{
+	dp->salinity = 10300;
+	dp->surface_pressure = 1013;
+	dp->gfhigh = 100;
+	dp->gflow = 100;
+	dp->bottomsac = prefs.bottomsac;
+	dp->decosac = prefs.decosac;
+
+	struct gasmix diluent = {{180}, {450}};
+	struct gasmix ean50 = {{500}, {0}};
+	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
+	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
+	cyl0->gasmix = diluent;
+	cyl0->cylinder_use = DILUENT;
+	cyl0->type.size.mliter = 3000;
+	cyl0->type.workingpressure.mbar = 200000;
+	cyl1->gasmix = ean50;
+	cyl1->type.size.mliter = 11100;
+	cyl1->type.workingpressure.mbar = 207000;
+	displayed_dive.dc.divemode = CCR;
+	reset_cylinders(&displayed_dive, true);
+	free_dps(dp);
+
+	int droptime = 70000 / (prefs.descrate ? prefs.descrate : 300);
+	plan_add_segment(dp, droptime, 70000, 0, 1300, 1, CCR);
+	plan_add_segment(dp, 40 * 60 - droptime, 70000, 0, 1300, 1, CCR);
+}
+
+static const struct {
+	const char *name;
+	void (*setupPrefs)();
+	void (*setupPlan)(struct diveplan *dp);
+} scenarios[] = {
+	{ "79m30min_tx", setupPrefs, setupPlan },
+	{ "45m30min_tx", setupPrefsVpmb, setupPlanVpmb45m30mTx },
+	{ "60m10min_tx", setupPrefsVpmb, setupPlanVpmb60m10mTx },
+	{ "60m30min_air", setupPrefsVpmb, setupPlanVpmb60m30minAir },
+	{ "60m30min_ean50", setupPrefsVpmb, setupPlanVpmb60m30minEan50 },
+	{ "60m30min_tx", setupPrefsVpmb, setupPlanVpmb60m30minTx },
+	{ "multilevel_air", setupPrefsVpmb, setupPlanVpmbMultiLevelAir },
+	{ "100m60min", setupPrefsVpmb, setupPlanVpmb100m60min },
+	{ "100m10min", setupPrefsVpmb, setupPlanVpmb100m10min },
+	{ "30m20min", setupPrefsVpmb, setupPlanVpmb30m20min },
+	{ "100m_to_70m30min", setupPrefsVpmb, setupPlanVpmb100mTo70m30min },
+	{ "several_gases", setupPrefs, setupPlanSeveralGases },
+	{ "ccr_70m40min", setupPrefsVpmb, setupPlanCcr }
+};
+
+// The number of samples of all logbook dives, the denominator of the building block timings
+static int total_samples()
+{
+	int i, samples = 0;
+	struct dive *d;
+	for_each_dive (i, d)
+		samples += d->dc.samples;
+	return samples;
+}
+
+// Outside of the planner, the deco code uses the display deco mode
+static void set_deco_mode(enum deco_mode mode)
+{
+	prefs.planner_deco_mode = mode;
+	prefs.display_deco_mode = mode;
+}
+
+static double surface_bar(const struct dive *d)
+{
+	return get_surface_pressure_in_mbar(d, true) / 1000.0;
+}
+
+void TestDecoPerformance::initTestCase()
+{
+	/* we need to manually tell that the resource exists, because we are using it as library. */
+	Q_INIT_RESOURCE(subsurface);
+	copy_prefs(&default_prefs, &prefs);
+
+	LogbookShape shape;
+	shape.dives = BENCHMARK_DIVES;
+	shape.sampleInterval = 10;
+	shape.cylinders = 2;
+	shape.ccrShare = 0.2;
+	shape.sites = 10;
+	shape.trips = 10;
+	generateLogbook(shape, &dive_table, &trip_table, &dive_site_table);
+	process_loaded_dives();
+	QVERIFY(total_samples() > 0);
+
+	tolerance = qEnvironmentVariable("SUBSURFACE_BENCHMARK_TOLERANCE", "20").toDouble() / 100.0;
+	QString baselineFile = qEnvironmentVariable("SUBSURFACE_BENCHMARK_BASELINE");
+	if (!baselineFile.isEmpty()) {
+		// A missing baseline is not an error: the first run is what creates it
+		QFile f(baselineFile);
+		if (!f.open(QFile::ReadOnly)) {
+			qDebug() << "No baseline in" << baselineFile;
+			return;
+		}
+		for (const QJsonValue &v: QJsonDocument::fromJson(f.readAll()).object()["benchmarks"].toArray()) {
+			QJsonObject o = v.toObject();
+			baseline[o["name"].toString()] = o;
+		}
+	}
+}
+
+void TestDecoPerformance::cleanupTestCase()
+{
+	clear_dive_file_data();
+
+	QString output = qEnvironmentVariable("SUBSURFACE_BENCHMARK_OUTPUT");
+	if (output.isEmpty())
+		return;
+	QJsonObject doc;
+	doc["version"] = subsurface_canonical_version();
+	doc["benchmarks"] = results;
+	QFile f(output);
+	QVERIFY(f.open(QFile::WriteOnly | QFile::Truncate));
+	f.write(QJsonDocument(doc).toJson());
+}
+
+void TestDecoPerformance::report(const QString &name, qint64 ns, int samples)
+{
+	double nsPerSample = samples > 0 ? (double)ns / samples : 0.0;
+	qDebug("%s: %.1f ns per sample, %.3f ms total", qPrintable(name), nsPerSample, ns / 1e6);
+
+	QJsonObject result;
+	result["name"] = name;
+	result["ns_per_sample"] = nsPerSample;
+	result["total_ms"] = ns / 1e6;
+	result["samples"] = samples;
+	results.append(result);
+
+	if (!baseline.contains(name))
+		return;
+	double old = baseline[name].toObject()["ns_per_sample"].toDouble();
+	QVERIFY2(old <= 0.0 || nsPerSample <= old * (1.0 + tolerance),
+		 qPrintable(QString("%1 got slower: %2 ns per sample, baseline %3 ns per sample")
+			    .arg(name).arg(nsPerSample, 0, 'f', 1).arg(old, 0, 'f', 1)));
+}
+
+void TestDecoPerformance::addSegment()
+{
+	int samples = total_samples();
+	for (const auto &mode: decoModes) {
+		set_deco_mode(mode.value);
+		qint64 best = -1;
+		for (int round = 0; round < BENCHMARK_ROUNDS; ++round) {
+			QElapsedTimer timer;
+			qint64 elapsed = 0;
+			int i;
+			struct dive *d;
+			for_each_dive (i, d) {
+				const struct divecomputer *dc = &d->dc;
+				struct gasmix gasmix = get_cylinder(d, 0)->gasmix;
+				clear_deco(&bench_deco_state, surface_bar(d));
+				timer.start();
+				for (int j = 1; j < dc->samples; ++j) {
+					const struct sample *s = dc->sample + j;
+					add_segment(&bench_deco_state, depth_to_bar(s->depth.mm, d), gasmix,
+						    s->time.seconds - s[-1].time.seconds, s->setpoint.mbar, dc->divemode, prefs.bottomsac);
+				}
+				elapsed += timer.nsecsElapsed();
+			}
+			if (best < 0 || elapsed < best)
+				best = elapsed;
+		}
+		report(QString("add_segment_%1").arg(mode.name), best, samples);
+	}
+}
+
+void TestDecoPerformance::tissueToleranceCalc()
+{
+	int samples = total_samples();
+	for (const auto &mode: decoModes) {
+		set_deco_mode(mode.value);
+		qint64 best = -1;
+		for (int round = 0; round < BENCHMARK_ROUNDS; ++round) {
+			QElapsedTimer timer;
+			qint64 elapsed = 0;
+			int i;
+			struct dive *d;
+			for_each_dive (i, d) {
+				const struct divecomputer *dc = &d->dc;
+				struct gasmix gasmix = get_cylinder(d, 0)->gasmix;
+				clear_deco(&bench_deco_state, surface_bar(d));
+				for (int j = 1; j < dc->samples; ++j) {
+					const struct sample *s = dc->sample + j;
+					double pressure = depth_to_bar(s->depth.mm, d);
+					add_segment(&bench_deco_state, pressure, gasmix,
+						    s->time.seconds - s[-1].time.seconds, s->setpoint.mbar, dc->divemode, prefs.bottomsac);
+					// Only the tolerance calculation is timed, the tissue loading is done by add_segment()
+					timer.start();
+					tissue_tolerance_calc(&bench_deco_state, d, pressure);
+					elapsed += timer.nsecsElapsed();
+				}
+			}
+			if (best < 0 || elapsed < best)
+				best = elapsed;
+		}
+		report(QString("tissue_tolerance_calc_%1").arg(mode.name), best, samples);
+	}
+}
+
+void TestDecoPerformance::decoInformation()
+{
+	setAppState(ApplicationState::Default);
+	for (const auto &mode: decoModes) {
+		set_deco_mode(mode.value);
+		qint64 best = -1;
+		int entries = 0;
+		for (int round = 0; round < BENCHMARK_ROUNDS; ++round) {
+			QElapsedTimer timer;
+			qint64 elapsed = 0;
+			int i;
+			struct dive *d;
+			entries = 0;
+			for_each_dive (i, d) {
+				struct plot_info pi;
+				init_plot_info(&pi);
+				create_plot_info_new(d, &d->dc, &pi, true, false, NULL);
+				init_decompression(&bench_deco_state, d);
+				// Without a previous plot info, the deco checkpoints can't be reused
+				timer.start();
+				calculate_deco_information(&bench_deco_state, NULL, d, &d->dc, &pi, false, NULL);
+				elapsed += timer.nsecsElapsed();
+				entries += pi.nr;
+				free_plot_info_data(&pi);
+			}
+			if (best < 0 || elapsed < best)
+				best = elapsed;
+		}
+		report(QString("calculate_deco_information_%1").arg(mode.name), best, entries);
+	}
+}
+
+void TestDecoPerformance::planScenarios()
+{
+	setAppState(ApplicationState::PlanDive);
+	for (const auto &scenario: scenarios) {
+		for (const auto &mode: decoModes) {
+			for (int timestep: timesteps) {
+				qint64 best = -1;
+				int samples = 0;
+				for (int round = 0; round < BENCHMARK_ROUNDS; ++round) {
+					struct deco_state *cache = NULL;
+					struct diveplan testPlan = {};
+					scenario.setupPrefs();
+					prefs.planner_deco_mode = mode.value;
+					displayed_dive.dc.divemode = OC;
+					scenario.setupPlan(&testPlan);
+
+					QElapsedTimer timer;
+					timer.start();
+					plan(&bench_deco_state, &testPlan, &displayed_dive, timestep, stoptable, &cache, true, false);
+					qint64 elapsed = timer.nsecsElapsed();
+
+					samples = displayed_dive.dc.samples;
+					free(cache);
+					free_dps(&testPlan);
+					if (best < 0 || elapsed < best)
+						best = elapsed;
+				}
+				report(QString("plan_%1_%2_%3s").arg(scenario.name).arg(mode.name).arg(timestep), best, samples);
+			}
+		}
+	}
+	setAppState(ApplicationState::Default);
+}
+
+QTEST_GUILESS_MAIN(TestDecoPerformance)
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTDECOPERFORMANCE_H
+#define TESTDECOPERFORMANCE_H
+
+#include <QtTest>
+#include <QJsonArray>
+#include <QJsonObject>
+
+class TestDecoPerformance : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+
+	void addSegment();
+	void tissueToleranceCalc();
+	void decoInformation();
+	void planScenarios();
+
+private:
+	void report(const QString &name, qint64 ns, int samples);
+	QJsonArray results;
+	QJsonObject baseline;
+	double tolerance;
+};
+
+#endif
@@ -211,6 +211,75 @@ void TestGitStorage::testGitStorageLocal()
 	QCOMPARE(readin, written);
 }
 
+void TestGitStorage::testGitStorageLazySamples()
+{
+	// the same round trip as above, but only parse the samples when the dives are saved
+	git_repository *repo;
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table, &dive_site_table, &filter_preset_table), 0);
+	QDir testDir("./gittestlazy");
+	QCOMPARE(testDir.removeRecursively(), true);
+	QCOMPARE(QDir().mkdir("./gittestlazy"), true);
+	QCOMPARE(git_repository_init(&repo, "./gittestlazy", false), 0);
+	QCOMPARE(save_dives("./gittestlazy[test]"), 0);
+	QCOMPARE(save_dives("./SampleDivesV3lazy.ssrf"), 0);
+	clear_dive_file_data();
+	git_lazy_samples = true;
+	QCOMPARE(parse_file("./gittestlazy[test]", &dive_table, &trip_table, &dive_site_table, &filter_preset_table), 0);
+	QCOMPARE(save_dives("./SampleDivesV3lazyviagit.ssrf"), 0);
+	git_lazy_samples = false;
+	QFile org("./SampleDivesV3lazy.ssrf");
+	org.open(QFile::ReadOnly);
+	QFile out("./SampleDivesV3lazyviagit.ssrf");
+	out.open(QFile::ReadOnly);
+	QTextStream orgS(&org);
+	QTextStream outS(&out);
+	QString readin = orgS.readAll();
+	QString written = outS.readAll();
+	QCOMPARE(readin, written);
+}
+
+void TestGitStorage::testGitStorageBinarySamples_data()
+{
+	QTest::addColumn<int>("format");
+	QTest::addColumn<bool>("lazy");
+	QTest::newRow("binary") << (int)GIT_SAMPLES_BINARY << false;
+	QTest::newRow("binary lazy") << (int)GIT_SAMPLES_BINARY << true;
+	QTest::newRow("binary+text") << (int)GIT_SAMPLES_BINARY_AND_TEXT << false;
+}
+
+void TestGitStorage::testGitStorageBinarySamples()
+{
+	// the same round trip with the binary samples, which must also be remembered by the repository
+	git_repository *repo;
+	QFETCH(int, format);
+	QFETCH(bool, lazy);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table, &dive_site_table, &filter_preset_table), 0);
+	QDir testDir("./gittestbinary");
+	QCOMPARE(testDir.removeRecursively(), true);
+	QCOMPARE(QDir().mkdir("./gittestbinary"), true);
+	QCOMPARE(git_repository_init(&repo, "./gittestbinary", false), 0);
+	git_sample_format = (enum git_sample_format)format;
+	QCOMPARE(save_dives("./gittestbinary[test]"), 0);
+	QCOMPARE(save_dives("./SampleDivesV3binary.ssrf"), 0);
+	clear_dive_file_data();
+	git_sample_format = GIT_SAMPLES_TEXT;
+	git_lazy_samples = lazy;
+	QCOMPARE(parse_file("./gittestbinary[test]", &dive_table, &trip_table, &dive_site_table, &filter_preset_table), 0);
+	QCOMPARE((int)git_sample_format, format);
+	QCOMPARE(save_dives("./SampleDivesV3binaryviagit.ssrf"), 0);
+	git_lazy_samples = false;
+	git_sample_format = saved_git_sample_format = GIT_SAMPLES_TEXT;
+	QFile org("./SampleDivesV3binary.ssrf");
+	org.open(QFile::ReadOnly);
+	QFile out("./SampleDivesV3binaryviagit.ssrf");
+	out.open(QFile::ReadOnly);
+	QTextStream orgS(&org);
+	QTextStream outS(&out);
+	QString readin = orgS.readAll();
+	QString written = outS.readAll();
+	QCOMPARE(readin, written);
+}
+
 void TestGitStorage::testGitStorageCloud()
 {
 	// test writing and reading back from cloud storage
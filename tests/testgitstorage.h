@@ -13,6 +13,9 @@ private slots:
 
 	void testGitStorageLocal_data();
 	void testGitStorageLocal();
+	void testGitStorageLazySamples();
+	void testGitStorageBinarySamples_data();
+	void testGitStorageBinarySamples();
 	void testGitStorageCloud();
 	void testGitStorageCloudOfflineSync();
 	void testGitStorageCloudMerge();
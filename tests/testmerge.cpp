@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "testmerge.h"
 #include "core/dive.h" // for save_dives()
+#include "core/divelist.h"
 #include "core/divesite.h"
 #include "core/file.h"
 #include "core/trip.h"
@@ -71,4 +72,48 @@ void TestMerge::testMergeBackwards()
 	}
 }
 
+void TestMerge::testFindDuplicates()
+{
+	/*
+	 * check that the duplicates found in a table of unmerged dives
+	 * are the same as when trying to merge every pair of dives
+	 */
+	struct dive_table table = empty_dive_table;
+	struct trip_table trips = empty_trip_table;
+	struct dive_site_table sites = empty_dive_site_table;
+	filter_preset_table_t filter_presets;
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/test47.xml", &table, &trips, &sites, &filter_presets), 0);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &table, &trips, &sites, &filter_presets), 0);
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/test48.xml", &table, &trips, &sites, &filter_presets), 0);
+
+	int expected = 0;
+	for (int i = 0; i < table.nr; ++i) {
+		for (int j = i + 1; j < table.nr; ++j) {
+			struct dive *merged = try_to_merge(table.dives[i], table.dives[j], false);
+			if (merged) {
+				++expected;
+				free_dive(merged);
+			}
+		}
+	}
+	QVERIFY(expected > 0);
+
+	struct dive **pairs;
+	int nr = find_duplicate_dives(&table, &pairs);
+	QCOMPARE(nr, expected);
+	bool found = false;
+	for (int i = 0; i < nr; ++i) {
+		QVERIFY(pairs[i * 2]->when <= pairs[i * 2 + 1]->when);
+		// test47 and test48 contain the same dive
+		if (pairs[i * 2]->when == pairs[i * 2 + 1]->when)
+			found = true;
+	}
+	QVERIFY(found);
+	free(pairs);
+
+	clear_dive_table(&table);
+	clear_trip_table(&trips);
+	clear_dive_site_table(&sites);
+}
+
 QTEST_GUILESS_MAIN(TestMerge)
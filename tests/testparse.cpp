@@ -575,5 +575,40 @@ void TestParse::parseDL7()
 	clear_dive_file_data();
 }
 
+static void writeFile(const char *name, const QByteArray &data)
+{
+	QFile f(name);
+	QVERIFY(f.open(QFile::WriteOnly));
+	QCOMPARE(f.write(data), (qint64)data.size());
+}
+
+void TestParse::parseTruncatedBinary()
+{
+	// The binary importers must stop at the end of the file, whatever
+	// the lengths and offsets in the file claim.
+	clear_dive_file_data();
+
+	// Liquivision: a name that is longer than the file
+	writeFile("./testtruncated.lvd", QByteArray("\xff\xff\xff\x7f" "name", 8));
+	parse_file("./testtruncated.lvd", &dive_table, &trip_table, &dive_site_table, &filter_preset_table);
+	QCOMPARE(dive_table.nr, 0);
+
+	// Liquivision: a dive whose location runs past the end of the file
+	writeFile("./testtruncated.lvd", QByteArray("\0\0\0\0\1\0\0\0" "\0" "\xff\xff\0\0", 13));
+	parse_file("./testtruncated.lvd", &dive_table, &trip_table, &dive_site_table, &filter_preset_table);
+	QCOMPARE(dive_table.nr, 0);
+
+	// Datatrak: the header announces a dive that isn't there
+	writeFile("./testtruncated.log", QByteArray("\xa1\0\0\0\0\0\1\0\0\0\0\0\xa0", 13));
+	parse_file("./testtruncated.log", &dive_table, &trip_table, &dive_site_table, &filter_preset_table);
+	QCOMPARE(dive_table.nr, 0);
+
+	// OSTCTools: shorter than the header
+	writeFile("./testtruncated.dive", QByteArray(300, '\0'));
+	parse_file("./testtruncated.dive", &dive_table, &trip_table, &dive_site_table, &filter_preset_table);
+	QCOMPARE(dive_table.nr, 0);
+
+	clear_dive_file_data();
+}
 
 QTEST_GUILESS_MAIN(TestParse)
@@ -1,16 +1,72 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "testparseperformance.h"
+#include "git2.h"
+#include "core/divefilter.h"
 #include "core/divesite.h"
 #include "core/trip.h"
 #include "core/file.h"
+#include "core/fulltext.h"
 #include "core/git-access.h"
+#include "core/profile.h"
+#include "core/version.h"
 #include "core/settings/qPrefProxy.h"
 #include "core/settings/qPrefCloudStorage.h"
 #include <QFile>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QNetworkProxy>
+#ifndef Q_OS_WIN
+#include <sys/resource.h>
+#endif
 
 #define LARGE_TEST_REPO "https://github.com/Subsurface/large-anonymous-sample-data"
+#define LARGE_SSRF_FILE SUBSURFACE_TEST_DATA "/dives/large-anon.ssrf"
+
+// Peak resident set size of the process in kilobytes, or -1 if unknown
+static long peakRss()
+{
+#ifndef Q_OS_WIN
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage))
+		return -1;
+#ifdef Q_OS_MACOS
+	return usage.ru_maxrss / 1024; // macOS reports bytes
+#else
+	return usage.ru_maxrss;
+#endif
+#else
+	return -1;
+#endif
+}
+
+// Run f once and record its wall time and the peak RSS afterwards
+template <typename Func>
+void TestParsePerformance::measure(const char *name, Func f)
+{
+	QElapsedTimer timer;
+	timer.start();
+	f();
+	qint64 elapsed = timer.elapsed();
+	long rss = peakRss();
+	qDebug() << name << elapsed << "ms, peak RSS" << rss << "kB";
+
+	QJsonObject result;
+	result["name"] = name;
+	result["wall_time_ms"] = elapsed;
+	result["peak_rss_kb"] = (qint64)rss;
+	result["dives"] = dive_table.nr;
+	results.append(result);
+}
+
+// The benchmarks other than the parsers work on the large sample file
+bool TestParsePerformance::loadLargeSsrf()
+{
+	if (!QFile::exists(LARGE_SSRF_FILE))
+		return false;
+	return parse_file(LARGE_SSRF_FILE, &dive_table, &trip_table, &dive_site_table, &filter_preset_table) == 0;
+}
 
 void TestParsePerformance::initTestCase()
 {
@@ -50,21 +106,38 @@ void TestParsePerformance::init()
 
 void TestParsePerformance::cleanup()
 {
+	fulltext_unregister_all();
 	clear_dive_file_data();
 }
 
+/*
+ * If SUBSURFACE_BENCHMARK_OUTPUT is set, the results are written to that
+ * file as JSON, so that they can be compared between releases.
+ */
+void TestParsePerformance::cleanupTestCase()
+{
+	QString output = qEnvironmentVariable("SUBSURFACE_BENCHMARK_OUTPUT");
+	if (output.isEmpty())
+		return;
+	QJsonObject doc;
+	doc["version"] = subsurface_canonical_version();
+	doc["benchmarks"] = results;
+	QFile f(output);
+	QVERIFY(f.open(QFile::WriteOnly | QFile::Truncate));
+	f.write(QJsonDocument(doc).toJson());
+}
+
 void TestParsePerformance::parseSsrf()
 {
 	// parsing of a V2 file should work
-	QFile largeSsrfFile(SUBSURFACE_TEST_DATA "/dives/large-anon.ssrf");
-	if (!largeSsrfFile.exists()) {
+	if (!QFile::exists(LARGE_SSRF_FILE)) {
 		qDebug() << "missing large sample data file - available at " LARGE_TEST_REPO;
-		qDebug() << "clone the repo, uncompress the file and copy it to " SUBSURFACE_TEST_DATA "/dives/large-anon.ssrf";
+		qDebug() << "clone the repo, uncompress the file and copy it to " LARGE_SSRF_FILE;
 		return;
 	}
-	QBENCHMARK {
-		parse_file(SUBSURFACE_TEST_DATA "/dives/large-anon.ssrf", &dive_table, &trip_table, &dive_site_table, &filter_preset_table);
-	}
+	measure("parse_xml", [] {
+		parse_file(LARGE_SSRF_FILE, &dive_table, &trip_table, &dive_site_table, &filter_preset_table);
+	});
 }
 
 void TestParsePerformance::parseGit()
@@ -78,9 +151,86 @@ void TestParsePerformance::parseGit()
 
 	cleanup();
 
-	QBENCHMARK {
+	measure("parse_git", [] {
 		parse_file(LARGE_TEST_REPO "[git]", &dive_table, &trip_table, &dive_site_table, &filter_preset_table);
-	}
+	});
+}
+
+void TestParsePerformance::saveSsrf()
+{
+	if (!loadLargeSsrf())
+		QSKIP("missing large sample data file");
+	measure("save_xml", [] {
+		QCOMPARE(save_dives("./large-anon-save.ssrf"), 0);
+	});
+}
+
+void TestParsePerformance::saveGit()
+{
+	git_repository *repo;
+
+	if (!loadLargeSsrf())
+		QSKIP("missing large sample data file");
+	QDir testDir("./large-anon-git");
+	QCOMPARE(testDir.removeRecursively(), true);
+	QCOMPARE(QDir().mkdir("./large-anon-git"), true);
+	QCOMPARE(git_repository_init(&repo, "./large-anon-git", false), 0);
+	git_repository_free(repo);
+	measure("save_git", [] {
+		QCOMPARE(save_dives("./large-anon-git[benchmark]"), 0);
+	});
+}
+
+void TestParsePerformance::fixupDives()
+{
+	if (!loadLargeSsrf())
+		QSKIP("missing large sample data file");
+	measure("fixup_dive", [] {
+		int i;
+		struct dive *d;
+		for_each_dive (i, d)
+			fixup_dive(d);
+	});
+}
+
+void TestParsePerformance::createPlotInfo()
+{
+	if (!loadLargeSsrf())
+		QSKIP("missing large sample data file");
+	measure("create_plot_info", [] {
+		int i;
+		struct dive *d;
+		for_each_dive (i, d) {
+			struct plot_info pi;
+			init_plot_info(&pi);
+			create_plot_info_new(d, &d->dc, &pi, false, false, nullptr);
+			free_plot_info_data(&pi);
+		}
+	});
+}
+
+void TestParsePerformance::filterDives()
+{
+	if (!loadLargeSsrf())
+		QSKIP("missing large sample data file");
+	fulltext_populate();
+	FilterData data;
+	data.fullText = QStringLiteral("a");
+	data.fulltextStringMode = StringFilterMode::SUBSTRING;
+	DiveFilter::instance()->setFilter(data);
+	measure("filter_update_all", [] {
+		DiveFilter::instance()->updateAll();
+	});
+	DiveFilter::instance()->setFilter(FilterData());
+}
+
+void TestParsePerformance::populateFulltext()
+{
+	if (!loadLargeSsrf())
+		QSKIP("missing large sample data file");
+	measure("fulltext_populate", [] {
+		fulltext_populate();
+	});
 }
 
 QTEST_GUILESS_MAIN(TestParsePerformance)
@@ -3,6 +3,7 @@
 #define TESTPARSEPERFORMANCE_H
 
 #include <QtTest>
+#include <QJsonArray>
 
 class TestParsePerformance : public QObject {
 	Q_OBJECT
@@ -10,9 +11,21 @@ private slots:
 	void initTestCase();
 	void init();
 	void cleanup();
+	void cleanupTestCase();
 
 	void parseSsrf();
 	void parseGit();
+	void saveSsrf();
+	void saveGit();
+	void fixupDives();
+	void createPlotInfo();
+	void filterDives();
+	void populateFulltext();
+
+private:
+	bool loadLargeSsrf();
+	template <typename Func> void measure(const char *name, Func f);
+	QJsonArray results;
 };
 
 #endif
@@ -1,7 +1,10 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "testplan.h"
+#include "planscenarios.h"
 #include "core/deco.h"
+#include "core/decotable.h"
 #include "core/dive.h"
+#include "core/membuffer.h"
 #include "core/planner.h"
 #include "core/qthelper.h"
 #include "core/subsurfacestartup.h"
@@ -15,362 +18,6 @@
 struct decostop stoptable[60];
 struct deco_state test_deco_state;
 extern bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, int timestep, struct decostop *decostoptable, struct deco_state **cached_datap, bool is_planner, bool show_disclaimer);
-void setupPrefs()
-{
-	copy_prefs(&default_prefs, &prefs);
-	prefs.ascrate50 = feet_to_mm(30) / 60;
-	prefs.ascrate75 = prefs.ascrate50;
-	prefs.ascratestops = prefs.ascrate50;
-	prefs.ascratelast6m = feet_to_mm(10) / 60;
-	prefs.last_stop = true;
-}
-
-void setupPrefsVpmb()
-{
-	copy_prefs(&default_prefs, &prefs);
-	prefs.ascrate50 = 10000 / 60;
-	prefs.ascrate75 = prefs.ascrate50;
-	prefs.ascratestops = prefs.ascrate50;
-	prefs.ascratelast6m = prefs.ascrate50;
-	prefs.descrate = 99000 / 60;
-	prefs.last_stop = false;
-	prefs.planner_deco_mode = VPMB;
-	prefs.vpmb_conservatism = 0;
-}
-
-void setupPlan(struct diveplan *dp)
-{
-	dp->salinity = 10300;
-	dp->surface_pressure = 1013;
-	dp->gfhigh = 100;
-	dp->gflow = 100;
-	dp->bottomsac = prefs.bottomsac;
-	dp->decosac = prefs.decosac;
-
-	struct gasmix bottomgas = {{150}, {450}};
-	struct gasmix ean36 = {{360}, {0}};
-	struct gasmix oxygen = {{1000}, {0}};
-	pressure_t po2 = {1600};
-	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
-	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
-	cylinder_t *cyl2 = get_or_create_cylinder(&displayed_dive, 2);
-	cyl0->gasmix = bottomgas;
-	cyl0->type.size.mliter = 36000;
-	cyl0->type.workingpressure.mbar = 232000;
-	cyl1->gasmix = ean36;
-	cyl2->gasmix = oxygen;
-	reset_cylinders(&displayed_dive, true);
-	free_dps(dp);
-
-	int droptime = M_OR_FT(79, 260) * 60 / M_OR_FT(23, 75);
-	plan_add_segment(dp, 0, gas_mod(ean36, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
-	plan_add_segment(dp, 0, gas_mod(oxygen, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 2, 0, 1, OC);
-	plan_add_segment(dp, droptime, M_OR_FT(79, 260), 0, 0, 1, OC);
-	plan_add_segment(dp, 30 * 60 - droptime, M_OR_FT(79, 260), 0, 0, 1, OC);
-}
-
-void setupPlanVpmb45m30mTx(struct diveplan *dp)
-{
-	dp->salinity = 10300;
-	dp->surface_pressure = 1013;
-	dp->gfhigh = 100;
-	dp->gflow = 100;
-	dp->bottomsac = prefs.bottomsac;
-	dp->decosac = prefs.decosac;
-
-	struct gasmix bottomgas = {{210}, {350}};
-	struct gasmix ean50 = {{500}, {0}};
-	struct gasmix oxygen = {{1000}, {0}};
-	pressure_t po2 = {1600};
-	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
-	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
-	cylinder_t *cyl2 = get_or_create_cylinder(&displayed_dive, 2);
-	cyl0->gasmix = bottomgas;
-	cyl0->type.size.mliter = 24000;
-	cyl0->type.workingpressure.mbar = 232000;
-	cyl1->gasmix = ean50;
-	cyl2->gasmix = oxygen;
-	reset_cylinders(&displayed_dive, true);
-	free_dps(dp);
-
-	int droptime = M_OR_FT(45, 150) * 60 / M_OR_FT(23, 75);
-	plan_add_segment(dp, 0, gas_mod(ean50, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
-	plan_add_segment(dp, 0, gas_mod(oxygen, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 2, 0, 1, OC);
-	plan_add_segment(dp, droptime, M_OR_FT(45, 150), 0, 0, 1, OC);
-	plan_add_segment(dp, 30 * 60 - droptime, M_OR_FT(45, 150), 0, 0, 1, OC);
-}
-
-void setupPlanVpmb60m10mTx(struct diveplan *dp)
-{
-	dp->salinity = 10300;
-	dp->surface_pressure = 1013;
-	dp->gfhigh = 100;
-	dp->gflow = 100;
-	dp->bottomsac = prefs.bottomsac;
-	dp->decosac = prefs.decosac;
-
-	struct gasmix bottomgas = {{180}, {450}};
-	struct gasmix tx50_15 = {{500}, {150}};
-	struct gasmix oxygen = {{1000}, {0}};
-	pressure_t po2 = {1600};
-	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
-	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
-	cylinder_t *cyl2 = get_or_create_cylinder(&displayed_dive, 2);
-	cyl0->gasmix = bottomgas;
-	cyl0->type.size.mliter = 24000;
-	cyl0->type.workingpressure.mbar = 232000;
-	cyl1->gasmix = tx50_15;
-	cyl2->gasmix = oxygen;
-	reset_cylinders(&displayed_dive, true);
-	free_dps(dp);
-
-	int droptime = M_OR_FT(60, 200) * 60 / M_OR_FT(23, 75);
-	plan_add_segment(dp, 0, gas_mod(tx50_15, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
-	plan_add_segment(dp, 0, gas_mod(oxygen, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 2, 0, 1, OC);
-	plan_add_segment(dp, droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
-	plan_add_segment(dp, 10 * 60 - droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
-}
-
-void setupPlanVpmb60m30minAir(struct diveplan *dp)
-{
-	dp->salinity = 10300;
-	dp->surface_pressure = 1013;
-	dp->bottomsac = prefs.bottomsac;
-	dp->decosac = prefs.decosac;
-
-	struct gasmix bottomgas = {{210}, {0}};
-	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
-	cyl0->gasmix = bottomgas;
-	cyl0->type.size.mliter = 100000;
-	cyl0->type.workingpressure.mbar = 232000;
-	displayed_dive.surface_pressure.mbar = 1013;
-	reset_cylinders(&displayed_dive, true);
-	free_dps(dp);
-
-	int droptime = M_OR_FT(60, 200) * 60 / M_OR_FT(99, 330);
-	plan_add_segment(dp, droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
-	plan_add_segment(dp, 30 * 60 - droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
-}
-
-void setupPlanVpmb60m30minEan50(struct diveplan *dp)
-{
-	dp->salinity = 10300;
-	dp->surface_pressure = 1013;
-	dp->bottomsac = prefs.bottomsac;
-	dp->decosac = prefs.decosac;
-
-	struct gasmix bottomgas = {{210}, {0}};
-	struct gasmix ean50 = {{500}, {0}};
-	pressure_t po2 = {1600};
-	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
-	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
-	cyl0->gasmix = bottomgas;
-	cyl0->type.size.mliter = 36000;
-	cyl0->type.workingpressure.mbar = 232000;
-	cyl1->gasmix = ean50;
-	displayed_dive.surface_pressure.mbar = 1013;
-	reset_cylinders(&displayed_dive, true);
-	free_dps(dp);
-
-	int droptime = M_OR_FT(60, 200) * 60 / M_OR_FT(99, 330);
-	plan_add_segment(dp, 0, gas_mod(ean50, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
-	plan_add_segment(dp, droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
-	plan_add_segment(dp, 30 * 60 - droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
-}
-
-void setupPlanVpmb60m30minTx(struct diveplan *dp)
-{
-	dp->salinity = 10300;
-	dp->surface_pressure = 1013;
-	dp->bottomsac = prefs.bottomsac;
-	dp->decosac = prefs.decosac;
-
-	struct gasmix bottomgas = {{180}, {450}};
-	struct gasmix ean50 = {{500}, {0}};
-	pressure_t po2 = {1600};
-	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
-	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
-	cyl0->gasmix = bottomgas;
-	cyl0->type.size.mliter = 36000;
-	cyl0->type.workingpressure.mbar = 232000;
-	cyl1->gasmix = ean50;
-	displayed_dive.surface_pressure.mbar = 1013;
-	reset_cylinders(&displayed_dive, true);
-	free_dps(dp);
-
-	int droptime = M_OR_FT(60, 200) * 60 / M_OR_FT(99, 330);
-	plan_add_segment(dp, 0, gas_mod(ean50, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
-	plan_add_segment(dp, droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
-	plan_add_segment(dp, 30 * 60 - droptime, M_OR_FT(60, 200), 0, 0, 1, OC);
-}
-
-void setupPlanVpmbMultiLevelAir(struct diveplan *dp)
-{
-	dp->salinity = 10300;
-	dp->surface_pressure = 1013;
-	dp->bottomsac = prefs.bottomsac;
-	dp->decosac = prefs.decosac;
-
-	struct gasmix bottomgas = {{210}, {0}};
-	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
-	cyl0->gasmix = bottomgas;
-	cyl0->type.size.mliter = 200000;
-	cyl0->type.workingpressure.mbar = 232000;
-	displayed_dive.surface_pressure.mbar = 1013;
-	reset_cylinders(&displayed_dive, true);
-	free_dps(dp);
-
-	int droptime = M_OR_FT(20, 66) * 60 / M_OR_FT(99, 330);
-	plan_add_segment(dp, droptime, M_OR_FT(20, 66), 0, 0, 1, OC);
-	plan_add_segment(dp, 10 * 60 - droptime, M_OR_FT(20, 66), 0, 0, 1, OC);
-	plan_add_segment(dp, 1 * 60, M_OR_FT(60, 200), 0, 0, 1, OC);
-	plan_add_segment(dp, 29 * 60, M_OR_FT(60, 200), 0, 0, 1, OC);
-}
-
-void setupPlanVpmb100m60min(struct diveplan *dp)
-{
-	dp->salinity = 10300;
-	dp->surface_pressure = 1013;
-	dp->bottomsac = prefs.bottomsac;
-	dp->decosac = prefs.decosac;
-
-	struct gasmix bottomgas = {{180}, {450}};
-	struct gasmix ean50 = {{500}, {0}};
-	struct gasmix oxygen = {{1000}, {0}};
-	pressure_t po2 = {1600};
-	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
-	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
-	cylinder_t *cyl2 = get_or_create_cylinder(&displayed_dive, 2);
-	cyl0->gasmix = bottomgas;
-	cyl0->type.size.mliter = 200000;
-	cyl0->type.workingpressure.mbar = 232000;
-	cyl1->gasmix = ean50;
-	cyl2->gasmix = oxygen;
-	displayed_dive.surface_pressure.mbar = 1013;
-	reset_cylinders(&displayed_dive, true);
-	free_dps(dp);
-
-	int droptime = M_OR_FT(100, 330) * 60 / M_OR_FT(99, 330);
-	plan_add_segment(dp, 0, gas_mod(ean50, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
-	plan_add_segment(dp, 0, gas_mod(oxygen, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 2, 0, 1, OC);
-	plan_add_segment(dp, droptime, M_OR_FT(100, 330), 0, 0, 1, OC);
-	plan_add_segment(dp, 60 * 60 - droptime, M_OR_FT(100, 330), 0, 0, 1, OC);
-}
-
-void setupPlanVpmb100m10min(struct diveplan *dp)
-{
-	dp->salinity = 10300;
-	dp->surface_pressure = 1013;
-	dp->bottomsac = prefs.bottomsac;
-	dp->decosac = prefs.decosac;
-
-	struct gasmix bottomgas = {{180}, {450}};
-	struct gasmix ean50 = {{500}, {0}};
-	struct gasmix oxygen = {{1000}, {0}};
-	pressure_t po2 = {1600};
-	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
-	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
-	cylinder_t *cyl2 = get_or_create_cylinder(&displayed_dive, 2);
-	cyl0->gasmix = bottomgas;
-	cyl0->type.size.mliter = 60000;
-	cyl0->type.workingpressure.mbar = 232000;
-	cyl1->gasmix = ean50;
-	cyl2->gasmix = oxygen;
-	displayed_dive.surface_pressure.mbar = 1013;
-	reset_cylinders(&displayed_dive, true);
-	free_dps(dp);
-
-	int droptime = M_OR_FT(100, 330) * 60 / M_OR_FT(99, 330);
-	plan_add_segment(dp, 0, gas_mod(ean50, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
-	plan_add_segment(dp, 0, gas_mod(oxygen, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 2, 0, 1, OC);
-	plan_add_segment(dp, droptime, M_OR_FT(100, 330), 0, 0, 1, OC);
-	plan_add_segment(dp, 10 * 60 - droptime, M_OR_FT(100, 330), 0, 0, 1, OC);
-}
-
-void setupPlanVpmb30m20min(struct diveplan *dp)
-{
-	dp->salinity = 10300;
-	dp->surface_pressure = 1013;
-	dp->bottomsac = prefs.bottomsac;
-	dp->decosac = prefs.decosac;
-
-	struct gasmix bottomgas = {{210}, {0}};
-	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
-	cyl0->gasmix = bottomgas;
-	cyl0->type.size.mliter = 36000;
-	cyl0->type.workingpressure.mbar = 232000;
-	displayed_dive.surface_pressure.mbar = 1013;
-	reset_cylinders(&displayed_dive, true);
-	free_dps(dp);
-
-	int droptime = M_OR_FT(30, 100) * 60 / M_OR_FT(18, 60);
-	plan_add_segment(dp, droptime, M_OR_FT(30, 100), 0, 0, 1, OC);
-	plan_add_segment(dp, 20 * 60 - droptime, M_OR_FT(30, 100), 0, 0, 1, OC);
-}
-
-void setupPlanVpmb100mTo70m30min(struct diveplan *dp)
-{
-	dp->salinity = 10300;
-	dp->surface_pressure = 1013;
-	dp->bottomsac = prefs.bottomsac;
-	dp->decosac = prefs.decosac;
-
-	struct gasmix bottomgas = {{120}, {650}};
-	struct gasmix tx21_35 = {{210}, {350}};
-	struct gasmix ean50 = {{500}, {0}};
-	struct gasmix oxygen = {{1000}, {0}};
-	pressure_t po2 = {1600};
-	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
-	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
-	cylinder_t *cyl2 = get_or_create_cylinder(&displayed_dive, 2);
-	cylinder_t *cyl3 = get_or_create_cylinder(&displayed_dive, 3);
-	cyl0->gasmix = bottomgas;
-	cyl0->type.size.mliter = 36000;
-	cyl0->type.workingpressure.mbar = 232000;
-	cyl1->gasmix = tx21_35;
-	cyl2->gasmix = ean50;
-	cyl3->gasmix = oxygen;
-	displayed_dive.surface_pressure.mbar = 1013;
-	reset_cylinders(&displayed_dive, true);
-	free_dps(dp);
-
-	int droptime = M_OR_FT(100, 330) * 60 / M_OR_FT(18, 60);
-	plan_add_segment(dp, 0, gas_mod(tx21_35, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 1, 0, 1, OC);
-	plan_add_segment(dp, 0, gas_mod(ean50, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 2, 0, 1, OC);
-	plan_add_segment(dp, 0, gas_mod(oxygen, po2, &displayed_dive, M_OR_FT(3, 10)).mm, 3, 0, 1, OC);
-	plan_add_segment(dp, droptime, M_OR_FT(100, 330), 0, 0, 1, OC);
-	plan_add_segment(dp, 20 * 60 - droptime, M_OR_FT(100, 330), 0, 0, 1, OC);
-	plan_add_segment(dp, 3 * 60, M_OR_FT(70, 230), 0, 0, 1, OC);
-	plan_add_segment(dp, (30 - 20 - 3) * 60, M_OR_FT(70, 230), 0, 0, 1, OC);
-}
-
-/* This tests handling different gases in the manually entered part of the dive */
-
-void setupPlanSeveralGases(struct diveplan *dp)
-{
-	dp->salinity = 10300;
-	dp->surface_pressure = 1013;
-	dp->bottomsac = prefs.bottomsac;
-	dp->decosac = prefs.decosac;
-
-	struct gasmix ean36 = {{360}, {0}};
-	struct gasmix tx11_50 = {{110}, {500}};
-
-	cylinder_t *cyl0 = get_or_create_cylinder(&displayed_dive, 0);
-	cylinder_t *cyl1 = get_or_create_cylinder(&displayed_dive, 1);
-	cyl0->gasmix = ean36;
-	cyl0->type.size.mliter = 36000;
-	cyl0->type.workingpressure.mbar = 232000;
-	cyl1->gasmix = tx11_50;
-	displayed_dive.surface_pressure.mbar = 1013;
-	reset_cylinders(&displayed_dive, true);
-	free_dps(dp);
-
-	plan_add_segment(dp, 120, 40000, 0, 0, true, OC);
-	plan_add_segment(dp, 18 * 60, 40000, 0, 0, true, OC);
-	plan_add_segment(dp, 10 * 60, 10000, 1, 0, true, OC);
-	plan_add_segment(dp, 5 * 60, 10000, 0, 0, true, OC);
-}
 
 /* We compare the calculated runtimes against two values:
  * - Known runtime calculated by Subsurface previously (to detect if anything has changed)
@@ -895,4 +542,112 @@ void TestPlan::testVpmbMetricRepeat()
 	QCOMPARE(finalDiveRunTimeSeconds, firstDiveRunTimeSeconds);
 }
 
+/* Dragging a waypoint replans the dive from the checkpoint at the last unchanged
+ * waypoint. This must give the same plan as calculating it from scratch. */
+static void moveLastWaypoint(struct diveplan *diveplan, int depth)
+{
+	struct divedatapoint *dp, *last = NULL;
+
+	for (dp = diveplan->dp; dp; dp = dp->next) {
+		if (dp->entered)
+			last = dp;
+	}
+	last->depth.mm = depth;
+}
+
+void TestPlan::testWaypointCheckpoints()
+{
+	struct deco_state *cache = NULL;
+	struct waypoint_checkpoints *checkpoints = alloc_waypoint_checkpoints();
+
+	setupPrefsVpmb();
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+	setAppState(ApplicationState::PlanDive);
+
+	struct diveplan testPlan = {};
+	setupPlanVpmbMultiLevelAir(&testPlan);
+	testPlan.checkpoints = checkpoints;
+	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	free(cache);
+	cache = NULL;
+
+	// move the last waypoint and replan with the checkpoints of the first plan
+	setupPlanVpmbMultiLevelAir(&testPlan);
+	moveLastWaypoint(&testPlan, 55000);
+	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	free(cache);
+	cache = NULL;
+	int checkpointRunTimeSeconds = displayed_dive.dc.duration.seconds;
+	int checkpointFirstCeiling = test_deco_state.first_ceiling_pressure.mbar;
+	struct decostop checkpointStoptable[60];
+	memcpy(checkpointStoptable, stoptable, sizeof(stoptable));
+
+	// the same plan without checkpoints
+	setupPlanVpmbMultiLevelAir(&testPlan);
+	moveLastWaypoint(&testPlan, 55000);
+	testPlan.checkpoints = NULL;
+	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	free(cache);
+
+	QCOMPARE(checkpointRunTimeSeconds, (int)displayed_dive.dc.duration.seconds);
+	QCOMPARE(checkpointFirstCeiling, test_deco_state.first_ceiling_pressure.mbar);
+	for (int i = 0; i < 60 && (stoptable[i].depth || checkpointStoptable[i].depth); i++) {
+		QCOMPARE(checkpointStoptable[i].depth, stoptable[i].depth);
+		QCOMPARE(checkpointStoptable[i].time, stoptable[i].time);
+	}
+	free_waypoint_checkpoints(checkpoints);
+}
+
+/* The plans of a deco table are calculated in parallel. Each of them must
+ * be the same as the plan calculated on its own. */
+void TestPlan::testDecoTable()
+{
+	struct deco_state *cache = NULL;
+
+	setupPrefsVpmb();
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+	setAppState(ApplicationState::PlanDive);
+
+	struct diveplan testPlan = {};
+	setupPlanVpmb60m30minAir(&testPlan);
+	plan(&test_deco_state, &testPlan, &displayed_dive, 60, stoptable, &cache, 1, 0);
+	free(cache);
+
+	const int depths[] = { 45000, 60000 };
+	const int times[] = { 20 * 60, 30 * 60 };
+	const struct gasmix gases[] = { { { 210 }, { 0 } } };
+	const struct decotable_gf gfs[] = { { 100, 100 } };
+	struct decotable_grid grid = {};
+	grid.nr_depths = 2;
+	grid.depths = depths;
+	grid.nr_times = 2;
+	grid.bottom_times = times;
+	grid.nr_gases = 1;
+	grid.gases = gases;
+	grid.nr_gfs = 1;
+	grid.gfs = gfs;
+	struct decotable table = {};
+	calculate_decotable(&table, &grid);
+
+	QCOMPARE(table.nr, 4);
+	const struct decotable_entry *entry = &table.entries[3];
+	QCOMPARE(entry->depth, 60000);
+	QCOMPARE(entry->bottom_time, 30 * 60);
+	QCOMPARE(entry->runtime, (int)displayed_dive.dc.duration.seconds);
+	for (int i = 0; i < 60 && (stoptable[i].depth || entry->stops[i].depth); i++) {
+		QCOMPARE(entry->stops[i].depth, stoptable[i].depth);
+		QCOMPARE(entry->stops[i].time, stoptable[i].time);
+	}
+	QVERIFY(table.entries[1].runtime > table.entries[0].runtime);
+	QVERIFY(table.entries[2].runtime > table.entries[0].runtime);
+
+	struct membuffer b = {};
+	decotable_to_csv(&b, &table);
+	QCOMPARE(QString::fromUtf8(mb_cstring(&b)).count('\n'), 5);
+	free_buffer(&b);
+	free_decotable(&table);
+}
+
 QTEST_GUILESS_MAIN(TestPlan)
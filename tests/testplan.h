@@ -19,6 +19,8 @@ private slots:
 	void testVpmbMetric100m10min();
 	void testVpmbMetricRepeat();
 	void testMultipleGases();
+	void testWaypointCheckpoints();
+	void testDecoTable();
 };
 
 #endif // TESTPLAN_H
@@ -4,6 +4,11 @@
 #include "core/trip.h"
 #include "core/file.h"
 #include "core/save-profiledata.h"
+#include "core/profile.h"
+#include "core/display.h"
+#include "core/divelist.h"
+#include <algorithm>
+#include <climits>
 
 // This test compares the content of struct profile against a known reference version for a list
 // of dives to prevent accidental regressions. Thus is you change anything in the profile this
@@ -16,7 +21,7 @@
 void TestProfile::testProfileExport()
 {
 	parse_file("../dives/abitofeverything.ssrf", &dive_table, &trip_table, &dive_site_table, &filter_preset_table);
-	save_profiledata("exportprofile.csv", false);
+	save_profiledata("exportprofile.csv", false, nullptr);
 	QFile org("../dives/exportprofilereference.csv");
 	org.open(QFile::ReadOnly);
 	QFile out("exportprofile.csv");
@@ -29,4 +34,133 @@ void TestProfile::testProfileExport()
 
 }
 
+// Exporting a subset of the columns must give the same values as the full export
+void TestProfile::testProfileExportColumns()
+{
+	clear_dive_file_data();
+	parse_file("../dives/abitofeverything.ssrf", &dive_table, &trip_table, &dive_site_table, &filter_preset_table);
+	save_profiledata("exportprofilecolumns.csv", false, "sec, depth,ceiling_*");
+	QFile org("../dives/exportprofilereference.csv");
+	QVERIFY(org.open(QFile::ReadOnly));
+	QFile out("exportprofilecolumns.csv");
+	QVERIFY(out.open(QFile::ReadOnly));
+	const QStringList orgLines = QString(org.readAll()).split('\n');
+	const QStringList outLines = QString(out.readAll()).split('\n');
+	QCOMPARE(outLines.size(), orgLines.size());
+
+	// Every dive starts with a header line
+	QVector<int> selected;
+	bool header = true;
+	for (int i = 0; i < orgLines.size(); i++) {
+		if (orgLines[i].isEmpty()) {
+			QCOMPARE(outLines[i], QString());
+			header = true;
+			continue;
+		}
+		const QStringList fields = orgLines[i].split(", ");
+		if (header) {
+			selected.clear();
+			for (int j = 0; j < fields.size(); j++) {
+				if (fields[j] == "\"sec\"" || fields[j] == "\"depth\"" || fields[j].startsWith("\"ceiling_"))
+					selected.append(j);
+			}
+			header = false;
+		}
+		QStringList expected;
+		for (int j: selected)
+			expected.append(fields[j]);
+		QCOMPARE(outLines[i], expected.join(", "));
+	}
+	clear_dive_file_data();
+}
+
+static void compareDecoResults(const struct plot_info &pi1, const struct plot_info &pi2)
+{
+	QCOMPARE(pi1.nr, pi2.nr);
+	for (int i = 0; i < pi1.nr; i++) {
+		const struct plot_data &e1 = pi1.entry[i];
+		const struct plot_data &e2 = pi2.entry[i];
+		QCOMPARE(e1.ceiling, e2.ceiling);
+		QCOMPARE(memcmp(&pi1.tissues[i], &pi2.tissues[i], sizeof(pi1.tissues[i])), 0);
+		QCOMPARE(e1.ndl_calc, e2.ndl_calc);
+		QCOMPARE(e1.tts_calc, e2.tts_calc);
+		QCOMPARE(e1.stoptime_calc, e2.stoptime_calc);
+		QCOMPARE(e1.stopdepth_calc, e2.stopdepth_calc);
+		QCOMPARE(e1.surface_gf, e2.surface_gf);
+		QCOMPARE(e1.current_gf, e2.current_gf);
+	}
+}
+
+// When recalculating the profile of a modified dive, the deco information before the
+// modification is taken from the old plot info. This must give the same result as
+// calculating everything from scratch.
+void TestProfile::testIncrementalDeco()
+{
+	clear_dive_file_data();
+	parse_file("../dives/abitofeverything.ssrf", &dive_table, &trip_table, &dive_site_table, &filter_preset_table);
+	bool calcndltts = prefs.calcndltts;
+	prefs.calcndltts = true;
+	for (int i = 0; i < dive_table.nr; i++) {
+		struct dive *d = get_dive(i);
+		struct divecomputer *dc = &d->dc;
+		struct plot_info reused, fresh;
+		init_plot_info(&reused);
+		init_plot_info(&fresh);
+		create_plot_info_new(d, dc, &reused, false, true, nullptr);
+		if (dc->samples > 2) {
+			dc->sample[dc->samples * 2 / 3].depth.mm += 1000;
+			invalidate_dive_cache(d);
+		}
+		create_plot_info_new(d, dc, &reused, false, true, nullptr);
+		create_plot_info_new(d, dc, &fresh, false, true, nullptr);
+		compareDecoResults(reused, fresh);
+		free_plot_info_data(&reused);
+		free_plot_info_data(&fresh);
+	}
+	prefs.calcndltts = calcndltts;
+	clear_dive_file_data();
+}
+
+// The ruler statistics are taken from prefix sums and sparse tables of the
+// plot entries. Check them against the plain entries.
+void TestProfile::testPlotRanges()
+{
+	clear_dive_file_data();
+	parse_file("../dives/abitofeverything.ssrf", &dive_table, &trip_table, &dive_site_table, &filter_preset_table);
+	for (int i = 0; i < dive_table.nr; i++) {
+		struct dive *d = get_dive(i);
+		struct plot_info pi;
+		struct plot_ranges r = { 0 };
+		init_plot_info(&pi);
+		create_plot_info_new(d, &d->dc, &pi, false, false, nullptr);
+		init_plot_ranges(&r, &pi);
+		QCOMPARE(r.nr, pi.nr);
+
+		int64_t depth_time = 0;
+		for (int j = 1; j < pi.nr; j++) {
+			depth_time += (int64_t)pi.entry[j].depth * (pi.entry[j].sec - pi.entry[j - 1].sec);
+			QCOMPARE(r.depth_time[j + 1], depth_time);
+		}
+		for (int l = 0; l < std::min(r.levels, 6); l++) {
+			int len = 1 << l;
+			for (int j = 0; j + len <= pi.nr; j++) {
+				int min_depth = INT_MAX, max_speed = INT_MIN;
+				for (int k = j; k < j + len; k++) {
+					min_depth = std::min(min_depth, pi.entry[k].depth);
+					max_speed = std::max(max_speed, pi.entry[k].speed);
+				}
+				QCOMPARE(r.min_depth[l * pi.nr + j], min_depth);
+				QCOMPARE(r.max_speed[l * pi.nr + j], max_speed);
+			}
+		}
+
+		char buf[500];
+		if (pi.nr > 2)
+			compare_samples(&pi, &r, 0, pi.nr - 1, buf, sizeof(buf), true);
+		free_plot_ranges(&r);
+		free_plot_info_data(&pi);
+	}
+	clear_dive_file_data();
+}
+
 QTEST_GUILESS_MAIN(TestProfile)
@@ -9,6 +9,9 @@ class TestProfile : public QObject {
 	Q_OBJECT
 private slots:
 	void testProfileExport();
+	void testProfileExportColumns();
+	void testIncrementalDeco();
+	void testPlotRanges();
 };
 
 #endif
@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "testscaling.h"
+#include "logbookgenerator.h"
+#include "core/divefilter.h"
+#include "core/divelist.h"
+#include "core/divesite.h"
+#include "core/file.h"
+#include "core/fulltext.h"
+#include "core/pref.h"
+#include "core/trip.h"
+#include "core/version.h"
+#include "qt-models/divetripmodel.h"
+#include <git2.h>
+#include <cmath>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+// Only compare timings that are long enough to not be dominated by noise
+#define MIN_SCALING_MS 50
+// Flag operations whose time grows faster than n^MAX_SCALING_EXPONENT
+#define MAX_SCALING_EXPONENT 1.5
+
+/*
+ * The logbook sizes are taken from SUBSURFACE_SCALING_SIZES, a comma separated
+ * list of numbers of dives. By default a single small logbook is used, so that
+ * this only checks that the operations work. The scaling target of the build
+ * runs 1k, 10k and 100k dives and writes the results to scaling.json.
+ */
+void TestScaling::initTestCase()
+{
+	/* we need to manually tell that the resource exists, because we are using it as library. */
+	Q_INIT_RESOURCE(subsurface);
+	copy_prefs(&default_prefs, &prefs);
+	git_libgit2_init();
+
+	QString env = qEnvironmentVariable("SUBSURFACE_SCALING_SIZES", "1000");
+	for (const QString &s: env.split(',', QString::SkipEmptyParts)) {
+		int n = s.trimmed().toInt();
+		if (n > 0)
+			sizes.push_back(n);
+	}
+	std::sort(sizes.begin(), sizes.end());
+}
+
+void TestScaling::cleanup()
+{
+	fulltext_unregister_all();
+	clear_dive_file_data();
+}
+
+void TestScaling::cleanupTestCase()
+{
+	QString output = qEnvironmentVariable("SUBSURFACE_BENCHMARK_OUTPUT");
+	if (output.isEmpty())
+		return;
+	QJsonObject doc;
+	doc["version"] = subsurface_canonical_version();
+	doc["benchmarks"] = results;
+	QFile f(output);
+	QVERIFY(f.open(QFile::WriteOnly | QFile::Truncate));
+	f.write(QJsonDocument(doc).toJson());
+}
+
+void TestScaling::generate(int dives)
+{
+	LogbookShape shape;
+	shape.dives = dives;
+	shape.cylinders = 2;
+	shape.pressureSensors = 2;
+	shape.ccrShare = 0.1;
+	shape.pictures = 1;
+	shape.sites = std::max(dives / 10, 1);
+	shape.trips = std::max(dives / 10, 1);
+	generateLogbook(shape, &dive_table, &trip_table, &dive_site_table);
+	process_loaded_dives();
+}
+
+template <typename Func>
+void TestScaling::measure(const char *name, int dives, Func f)
+{
+	QElapsedTimer timer;
+	timer.start();
+	f();
+	qint64 elapsed = timer.elapsed();
+	qDebug() << name << dives << "dives:" << elapsed << "ms";
+	timings[name].push_back({ dives, elapsed });
+
+	QJsonObject result;
+	result["name"] = name;
+	result["wall_time_ms"] = elapsed;
+	result["dives"] = dives;
+	results.append(result);
+}
+
+void TestScaling::checkScaling(const char *name)
+{
+	const QVector<Timing> &t = timings[name];
+	for (int i = 1; i < t.size(); ++i) {
+		if (t[i - 1].ms < MIN_SCALING_MS || t[i].dives <= t[i - 1].dives)
+			continue;
+		double exponent = log((double)t[i].ms / t[i - 1].ms) / log((double)t[i].dives / t[i - 1].dives);
+		QVERIFY2(exponent < MAX_SCALING_EXPONENT,
+			 qPrintable(QString("%1 scales with n^%2 from %3 to %4 dives").arg(name).arg(exponent, 0, 'f', 2)
+				    .arg(t[i - 1].dives).arg(t[i].dives)));
+	}
+}
+
+void TestScaling::xmlRoundTrip()
+{
+	for (int n: sizes) {
+		generate(n);
+		measure("scaling_save_xml", n, [] {
+			QCOMPARE(save_dives("./scaling.ssrf"), 0);
+		});
+		cleanup();
+		measure("scaling_parse_xml", n, [] {
+			QCOMPARE(parse_file("./scaling.ssrf", &dive_table, &trip_table, &dive_site_table, &filter_preset_table), 0);
+		});
+		QCOMPARE(dive_table.nr, n);
+		measure("scaling_process_loaded_dives", n, [] {
+			process_loaded_dives();
+		});
+		cleanup();
+	}
+	checkScaling("scaling_save_xml");
+	checkScaling("scaling_parse_xml");
+	checkScaling("scaling_process_loaded_dives");
+}
+
+void TestScaling::gitRoundTrip()
+{
+	for (int n: sizes) {
+		generate(n);
+		measure("scaling_save_git", n, [] {
+			QCOMPARE(saveLogbook("./scaling-git[scaling]"), 0);
+		});
+		cleanup();
+		measure("scaling_parse_git", n, [] {
+			QCOMPARE(parse_file("./scaling-git[scaling]", &dive_table, &trip_table, &dive_site_table, &filter_preset_table), 0);
+		});
+		QCOMPARE(dive_table.nr, n);
+		cleanup();
+	}
+	checkScaling("scaling_save_git");
+	checkScaling("scaling_parse_git");
+}
+
+// Import the same logbook again, so that every imported dive is merged with an existing one
+void TestScaling::importMerge()
+{
+	for (int n: sizes) {
+		generate(n);
+		struct dive_table table = empty_dive_table;
+		struct trip_table trips = empty_trip_table;
+		struct dive_site_table sites = empty_dive_site_table;
+		LogbookShape shape;
+		shape.dives = n;
+		shape.sites = std::max(n / 10, 1);
+		shape.trips = std::max(n / 10, 1);
+		generateLogbook(shape, &table, &trips, &sites);
+		measure("scaling_import_merge", n, [&] {
+			add_imported_dives(&table, &trips, &sites, IMPORT_MERGE_ALL_TRIPS);
+		});
+		QCOMPARE(dive_table.nr, n);
+		cleanup();
+	}
+	checkScaling("scaling_import_merge");
+}
+
+void TestScaling::filterDives()
+{
+	for (int n: sizes) {
+		generate(n);
+		fulltext_populate();
+		FilterData data;
+		data.fullText = QStringLiteral("Buddy 1");
+		data.fulltextStringMode = StringFilterMode::SUBSTRING;
+		DiveFilter::instance()->setFilter(data);
+		measure("scaling_filter_update_all", n, [] {
+			DiveFilter::instance()->updateAll();
+		});
+		DiveFilter::instance()->setFilter(FilterData());
+		cleanup();
+	}
+	checkScaling("scaling_filter_update_all");
+}
+
+void TestScaling::buildModels()
+{
+	for (int n: sizes) {
+		generate(n);
+		measure("scaling_build_models", n, [] {
+			DiveTripModelTree tree;
+			DiveTripModelList list;
+		});
+		cleanup();
+	}
+	checkScaling("scaling_build_models");
+}
+
+QTEST_GUILESS_MAIN(TestScaling)
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef TESTSCALING_H
+#define TESTSCALING_H
+
+#include <QtTest>
+#include <QJsonArray>
+#include <QVector>
+
+class TestScaling : public QObject {
+	Q_OBJECT
+private slots:
+	void initTestCase();
+	void cleanup();
+	void cleanupTestCase();
+
+	void xmlRoundTrip();
+	void gitRoundTrip();
+	void importMerge();
+	void filterDives();
+	void buildModels();
+
+private:
+	struct Timing {
+		int dives;
+		qint64 ms;
+	};
+	void generate(int dives);
+	template <typename Func> void measure(const char *name, int dives, Func f);
+	void checkScaling(const char *name);
+	QVector<int> sizes;
+	QMap<QString, QVector<Timing>> timings;
+	QJsonArray results;
+};
+
+#endif
@@ -10,8 +10,7 @@ void TestTagList::initTestCase()
 
 void TestTagList::cleanupTestCase()
 {
-	taglist_free(g_tag_list);
-	g_tag_list = NULL;
+	taglist_free_global();
 }
 
 void TestTagList::testGetTagstringNoTags()
@@ -80,4 +79,26 @@ void TestTagList::testGetTagstringEmptyTagOnly()
 	free(tagstring);
 }
 
+void TestTagList::testGlobalTagIds()
+{
+	struct tag_entry *tag_list = NULL;
+	struct divetag *a = taglist_add_tag(&tag_list, "id tag a");
+	struct divetag *b = taglist_add_tag(&tag_list, "id tag b");
+	QVERIFY(a->id >= 0 && a->id < taglist_nr_global_ids());
+	QVERIFY(b->id >= 0 && b->id < taglist_nr_global_ids());
+	QVERIFY(a->id != b->id);
+	QCOMPARE(taglist_get_global_tag("id tag a"), a);
+	QCOMPARE(taglist_add_tag(&tag_list, "id tag a"), a);
+	QVERIFY(taglist_get_global_tag("id tag c") == NULL);
+
+	// Copies keep the ids
+	struct tag_entry *copy = taglist_copy(tag_list);
+	QVERIFY(copy->tag != a);
+	QVERIFY(taglist_contains(copy, "id tag a"));
+	QVERIFY(taglist_contains(copy, "id tag b"));
+	QVERIFY(!taglist_contains(copy, "id tag c"));
+	taglist_free(copy);
+	taglist_free(tag_list);
+}
+
 QTEST_GUILESS_MAIN(TestTagList)
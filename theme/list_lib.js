@@ -822,6 +822,37 @@ var points;  //reference to the samples array of the shown dive.
 var ZERO_C_IN_MKELVIN = 273150;
 var plot1;
 
+/**
+*Compact exports store the samples of a dive as base64 encoded zigzag
+*varints of the difference to the previous sample: time, depth, pressure
+*and temperature. Decode them into the samples array when the dive is shown.
+*/
+function unpack_samples(dive)
+{
+	if (dive.samples || !dive.packed_samples)
+		return;
+	var bytes = atob(dive.packed_samples);
+	var values = [0, 0, 0, 0];
+	var samples = [];
+	var pos = 0;
+	while (pos < bytes.length) {
+		var sample = [];
+		for (var j = 0; j < 4; j++) {
+			var val = 0, factor = 1, c;
+			do {
+				c = bytes.charCodeAt(pos++);
+				val += (c & 0x7f) * factor;
+				factor *= 128;
+			} while (c & 0x80);
+			values[j] += (val % 2) ? -(val + 1) / 2 : val / 2;
+			sample.push(values[j]);
+		}
+		samples.push(sample);
+	}
+	dive.samples = samples;
+	delete dive.packed_samples;
+}
+
 function firstNonZero()
 {
 	for(var i = 0; i <= items[dive_id].samples.length-1; i++){
@@ -1359,6 +1390,7 @@ function showDiveDetails(dive)
 {
 	//set global variables
 	dive_id = dive;
+	unpack_samples(items[dive_id]);
 	points = items[dive_id].samples;
 
 	//draw the canvas and initialize the view